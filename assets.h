@@ -0,0 +1,79 @@
+/* The files the window loads: the font and the piece images. Built with -DEMBED_ASSETS they're compiled into the
+   executable (the assembler's .incbin, so there's no generated source to keep up to date) and read from memory,
+   which makes for a single-file program that does no file I/O to start. Otherwise they're read from disk, from the
+   working directory or, failing that, from next to the executable. */
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <SDL3/SDL.h>
+
+#define ASSET_FONT "external/resources/Roboto-Regular.ttf"
+#define ASSET_PIECES "external/resources/chess_pieces/"
+
+#if defined(EMBED_ASSETS)
+#if defined(_WIN32)
+#define ASSET_SECTION ".section .rdata,\"dr\"\n"
+#else
+#define ASSET_SECTION ".section .rodata\n"
+#endif
+
+// name[] is the file's bytes up to name##End; the path is relative to where the compiler runs, the repository root
+#define EMBED_ASSET(name, path)                                                                              \
+    extern const unsigned char name[], name##End[];                                                          \
+    __asm__(ASSET_SECTION ".balign 16\n.globl " #name "\n" #name ":\n.incbin \"" path "\"\n.globl " #name    \
+            "End\n" #name "End:\n.byte 0\n.previous\n")
+
+EMBED_ASSET(assetFont, ASSET_FONT);
+EMBED_ASSET(assetWhitePawn, ASSET_PIECES "wp.png");
+EMBED_ASSET(assetWhiteKnight, ASSET_PIECES "wn.png");
+EMBED_ASSET(assetWhiteBishop, ASSET_PIECES "wb.png");
+EMBED_ASSET(assetWhiteRook, ASSET_PIECES "wr.png");
+EMBED_ASSET(assetWhiteQueen, ASSET_PIECES "wq.png");
+EMBED_ASSET(assetWhiteKing, ASSET_PIECES "wk.png");
+EMBED_ASSET(assetBlackPawn, ASSET_PIECES "bp.png");
+EMBED_ASSET(assetBlackKnight, ASSET_PIECES "bn.png");
+EMBED_ASSET(assetBlackBishop, ASSET_PIECES "bb.png");
+EMBED_ASSET(assetBlackRook, ASSET_PIECES "br.png");
+EMBED_ASSET(assetBlackQueen, ASSET_PIECES "bq.png");
+EMBED_ASSET(assetBlackKing, ASSET_PIECES "bk.png");
+
+static const struct { const char* path; const unsigned char* data; const unsigned char* end; } EMBEDDED_ASSETS[] = {
+    { ASSET_FONT, assetFont, assetFontEnd },
+    { ASSET_PIECES "wp.png", assetWhitePawn, assetWhitePawnEnd },
+    { ASSET_PIECES "wn.png", assetWhiteKnight, assetWhiteKnightEnd },
+    { ASSET_PIECES "wb.png", assetWhiteBishop, assetWhiteBishopEnd },
+    { ASSET_PIECES "wr.png", assetWhiteRook, assetWhiteRookEnd },
+    { ASSET_PIECES "wq.png", assetWhiteQueen, assetWhiteQueenEnd },
+    { ASSET_PIECES "wk.png", assetWhiteKing, assetWhiteKingEnd },
+    { ASSET_PIECES "bp.png", assetBlackPawn, assetBlackPawnEnd },
+    { ASSET_PIECES "bn.png", assetBlackKnight, assetBlackKnightEnd },
+    { ASSET_PIECES "bb.png", assetBlackBishop, assetBlackBishopEnd },
+    { ASSET_PIECES "br.png", assetBlackRook, assetBlackRookEnd },
+    { ASSET_PIECES "bq.png", assetBlackQueen, assetBlackQueenEnd },
+    { ASSET_PIECES "bk.png", assetBlackKing, assetBlackKingEnd },
+};
+#endif
+
+// a stream over one of the files above, by its path; NULL with SDL_GetError() set when there's no such file
+static SDL_IOStream* openAsset(const char* path) {
+#if defined(EMBED_ASSETS)
+    for (size_t i = 0; i < SDL_arraysize(EMBEDDED_ASSETS); i++)
+        if (SDL_strcmp(EMBEDDED_ASSETS[i].path, path) == 0)
+            return SDL_IOFromConstMem(EMBEDDED_ASSETS[i].data, (size_t)(EMBEDDED_ASSETS[i].end - EMBEDDED_ASSETS[i].data));
+    SDL_SetError("%s isn't built in", path);
+    return NULL;
+#else
+    SDL_IOStream* io = SDL_IOFromFile(path, "rb");
+    const char* base = io ? NULL : SDL_GetBasePath(); // started from somewhere else
+    if (base) {
+        char* full = NULL;
+        if (SDL_asprintf(&full, "%s%s", base, path) >= 0) {
+            io = SDL_IOFromFile(full, "rb");
+            SDL_free(full);
+        }
+    }
+    return io;
+#endif
+}
+
+#endif
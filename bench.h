@@ -0,0 +1,239 @@
+/* The fixed positions `main bench` searches and microbench runs its kernels over, and the records of their results
+   both can write. Changing any of the positions changes the bench signature, so they stay as they are. */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <SDL3/SDL.h>
+#include "engine.h"
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// openings, middlegames and endgames down to a few men
+static const char* const BENCH_POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "rnbqkb1r/pp3ppp/4pn2/2pp4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 0 5",
+    "r1bqk2r/2ppbppp/p1n2n2/1p2p3/4P3/1B3N2/PPPP1PPP/RNBQR1K1 b kq - 1 7",
+    "rnbq1rk1/ppp1ppbp/3p1np1/8/2PPP3/2N2N2/PP2BPPP/R1BQK2R b KQ - 1 6",
+    "r2q1rk1/pp1nbppp/2p1pn2/3p4/2PP4/1PN1PN2/P2B1PPP/R2QKB1R w KQ - 1 9",
+    "2r2rk1/pp3pp1/1qn1p2p/3pP3/3P4/P1PQ1N2/5PPP/R4RK1 w - - 0 18",
+};
+
+/* Benchmark records: `main bench json FILE` and `microbench json FILE` write their results to a JSON file along with
+   the build and the machine they ran on (engineBuildInfo), and `main benchcompare` holds one against a baseline. A
+   result is a name, a value, its spread (the noise, in percent of the value) and which way is better. */
+#define BENCH_RECORD_MAX 32
+
+typedef struct {
+    char name[32];
+    double value;
+    double spread;
+    bool lowerIsBetter;
+} BenchResult;
+
+// a string as JSON; quotes and backslashes are all a version string or a processor name could bring
+static bool writeJsonText(SDL_IOStream* out, const char* text) {
+    bool ok = SDL_WriteU8(out, '"');
+    for (const char* c = text; *c && ok; c++) {
+        if (*c == '"' || *c == '\\') ok = SDL_WriteU8(out, '\\');
+        if (ok && (unsigned char)*c >= ' ') ok = SDL_WriteU8(out, (Uint8)*c);
+    }
+    return ok && SDL_WriteU8(out, '"');
+}
+
+// signature 0: none (the micro-benchmarks have none)
+static bool writeBenchRecord(const char* path, const char* kind, Uint64 signature, const BenchResult* results, int count) {
+    SDL_IOStream* out = SDL_IOFromFile(path, "w");
+    if (!out) return false;
+    EngineBuild build;
+    engineBuildInfo(&build);
+    const char* names[] = { "compiler", "built", "options", "kernels", "cpu" };
+    const char* values[] = { build.compiler, build.built, build.options, build.kernels, build.cpu };
+    bool ok = SDL_IOprintf(out, "{\n\"kind\": \"%s\",\n", kind) > 0;
+    for (int i = 0; i < (int)SDL_arraysize(names) && ok; i++)
+        ok = SDL_IOprintf(out, "\"%s\": ", names[i]) > 0 && writeJsonText(out, values[i]) && SDL_IOprintf(out, ",\n") > 0;
+    if (ok) ok = SDL_IOprintf(out, "\"cores\": %d,\n", build.cores) > 0;
+    if (ok && signature) ok = SDL_IOprintf(out, "\"signature\": %" SDL_PRIu64 ",\n", signature) > 0;
+    if (ok) ok = SDL_IOprintf(out, "\"results\": [\n") > 0;
+    for (int i = 0; i < count && ok; i++)
+        ok = SDL_IOprintf(out, "{\"name\": \"%s\", \"value\": %.4f, \"spread\": %.2f, \"lower\": %s}%s\n", results[i].name,
+                          results[i].value, results[i].spread, results[i].lowerIsBetter ? "true" : "false", i + 1 < count ? "," : "") > 0;
+    if (ok) ok = SDL_IOprintf(out, "]\n}\n") > 0;
+    return SDL_CloseIO(out) && ok;
+}
+
+/* Hardware counters: `main bench counters LIST` and `microbench counters LIST` count what the processor did over
+   the timed work, LIST being `all` or some of the names below separated by commas, and give it per node (bench)
+   or per call (each microbench kernel): a long way to memory shows as cache and TLB misses, a branchy loop as
+   mispredictions, and the two together with instructions per cycle say which of them the time is going on. The
+   counters come from perf_event_open, so only on Linux, and only this thread in user mode, so a
+   perf_event_paranoid of 2 allows them; a counter the processor or the virtual machine doesn't have is left
+   out. The kernel shares out the hardware when there are more counters than it has, and each count is scaled
+   up by the time it was actually counting. They're opened stopped at zero; countersResume and countersPause
+   take them through the work to be counted, as many times as it comes in pieces. */
+typedef enum {
+    COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_BRANCH_MISSES, COUNTER_L1D_MISSES, COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES, COUNTER_KINDS
+} HardwareCounter;
+
+static const char* const COUNTER_NAMES[COUNTER_KINDS] = {
+    "cycles", "instructions", "branch-misses", "l1d-misses", "llc-misses", "dtlb-misses"
+};
+
+typedef struct {
+    int fds[COUNTER_KINDS]; // -1 for a counter not asked for or not there
+    int count;              // the ones open
+} HardwareCounters;
+
+typedef struct {
+    double values[COUNTER_KINDS]; // negative for none
+} CounterValues;
+
+// the counters LIST names, as many as can be had; false with SDL_GetError() set when none can
+static bool countersOpen(HardwareCounters* counters, const char* list) {
+    counters->count = 0;
+    for (int i = 0; i < COUNTER_KINDS; i++) counters->fds[i] = -1;
+#if defined(__linux__)
+    static const struct { Uint32 type; Uint64 config; } EVENTS[COUNTER_KINDS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES }, // the last level's
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    };
+    bool all = SDL_strcmp(list, "all") == 0;
+    for (int i = 0; i < COUNTER_KINDS; i++) {
+        const char* at = all ? NULL : SDL_strstr(list, COUNTER_NAMES[i]);
+        size_t length = SDL_strlen(COUNTER_NAMES[i]);
+        if (!all && (!at || (at > list && at[-1] != ',') || (at[length] && at[length] != ','))) continue;
+        struct perf_event_attr attr;
+        SDL_zero(attr);
+        attr.size = sizeof(attr);
+        attr.type = EVENTS[i].type;
+        attr.config = EVENTS[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0); // this thread, any processor
+        if (counters->fds[i] >= 0) counters->count++;
+    }
+    if (counters->count == 0) return SDL_SetError("no hardware counters (perf_event_open: %s)", strerror(errno));
+    return true;
+#else
+    (void)list;
+    return SDL_SetError("hardware counters need Linux's perf_event_open");
+#endif
+}
+
+// PERF_EVENT_IOC_ENABLE, _DISABLE or _RESET on each of them
+static void countersControl(HardwareCounters* counters, unsigned long request) {
+#if defined(__linux__)
+    if (counters->count == 0) return; // never opened: the fds aren't -1
+    for (int i = 0; i < COUNTER_KINDS; i++)
+        if (counters->fds[i] >= 0) ioctl(counters->fds[i], request, 0);
+#else
+    (void)counters;
+    (void)request;
+#endif
+}
+
+#if defined(__linux__)
+#define countersResume(counters) countersControl(counters, PERF_EVENT_IOC_ENABLE)
+#define countersPause(counters) countersControl(counters, PERF_EVENT_IOC_DISABLE)
+#define countersReset(counters) countersControl(counters, PERF_EVENT_IOC_RESET)
+#else
+#define countersResume(counters) countersControl(counters, 0)
+#define countersPause(counters) countersControl(counters, 0)
+#define countersReset(counters) countersControl(counters, 0)
+#endif
+
+// what they've counted since they were opened or reset, paused
+static void countersRead(const HardwareCounters* counters, CounterValues* values) {
+    for (int i = 0; i < COUNTER_KINDS; i++) values->values[i] = -1;
+#if defined(__linux__)
+    if (counters->count == 0) return;
+    for (int i = 0; i < COUNTER_KINDS; i++) {
+        Uint64 read3[3]; // the count, the time enabled and the time it was running
+        if (counters->fds[i] < 0) continue;
+        if (read(counters->fds[i], read3, sizeof(read3)) != (ssize_t)sizeof(read3) || read3[2] == 0) continue;
+        values->values[i] = (double)read3[0] * ((double)read3[1] / (double)read3[2]);
+    }
+#else
+    (void)counters;
+#endif
+}
+
+static void countersClose(HardwareCounters* counters) {
+#if defined(__linux__)
+    if (counters->count == 0) return;
+    for (int i = 0; i < COUNTER_KINDS; i++)
+        if (counters->fds[i] >= 0) close(counters->fds[i]);
+#endif
+    counters->count = 0;
+}
+
+// "ipc 2.31 cycles 412.0 instructions 951.7 ..." per what (a node, a call), the ones there are; returns out
+static char* formatCounters(const CounterValues* values, Uint64 per, char* out, size_t size) {
+    size_t n = 0;
+    out[0] = '\0';
+    const double* v = values->values;
+    if (v[COUNTER_CYCLES] > 0 && v[COUNTER_INSTRUCTIONS] >= 0)
+        n += (size_t)SDL_snprintf(out, size, "ipc %.2f", v[COUNTER_INSTRUCTIONS] / v[COUNTER_CYCLES]);
+    for (int i = 0; i < COUNTER_KINDS && n < size; i++)
+        if (v[i] >= 0)
+            n += (size_t)SDL_snprintf(out + n, size - n, "%s%s %.2f", n ? " " : "", COUNTER_NAMES[i], v[i] / (double)SDL_max(per, 1));
+    return out;
+}
+
+#endif // BENCH_H
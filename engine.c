@@ -0,0 +1,8988 @@
+// CHESS ENGINE: everything but the window, see engine.h
+
+// standard includes
+#if defined(__linux__)
+#define _GNU_SOURCE // sched_setaffinity
+#include <sched.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h> // SetThreadAffinityMask, file mapping
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#if defined(__x86_64__)
+#include <immintrin.h> // _pext_u64 for the BMI2 slider lookup, AVX2/AVX-512 for the NNUE output layer
+#include <cpuid.h>     // the processor's name, for engineBuildInfo
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+//SDL (SDL3 stored in external)
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_atomic.h>
+
+#include "engine.h"
+
+#define TIME_CHECK_NODES 1024  // minimaxAB looks at the clock every this many nodes (power of two)
+
+/* The lookup tables below (keys, attacks, magics, piece-square values) are built at startup, unless tables.h is
+   there: gentables (the "tables" build task) writes them out from this same code, and included at the end of this
+   file they're const data with nothing left to compute, the init functions leaving them alone. TABLE is how each
+   is declared, const when it comes from the header. */
+#if !defined(GENERATING_TABLES) && defined(__has_include)
+#if __has_include("tables.h")
+#define TABLES_GENERATED
+#endif
+#endif
+#if defined(TABLES_GENERATED)
+#define TABLE static const
+#else
+#define TABLE static
+#endif
+
+static SDL_TLSID searchThreadSlot; // 1 + the pool worker index on pool threads, unset (0) elsewhere
+
+/* Tracing, in an engine built with SEARCH_TRACE defined; built without, the macros below are nothing at all. Every
+   thread that searches gets a ring buffer of its own, made the first time it traces anything, holding the last
+   TRACE_RING_SIZE phases it went through (a search, an iteration, a root move, a wait on the pool...) with their
+   start and end on the performance counter. Move generation, evaluation, make and unmake happen millions of times
+   a second, far too often for the ring, so they're timed but only summed: each phase carries the time its thread
+   spent in them while it lasted. engineTraceWrite turns the rings into a Chrome trace (chrome://tracing, Perfetto),
+   a row per thread, where the time a worker sat idle is the gaps in its row. */
+typedef enum { TRACE_MOVEGEN, TRACE_EVAL, TRACE_MAKE, TRACE_UNMAKE, TRACE_HOT_KINDS } TraceHot;
+
+typedef enum {
+    TRACE_SEARCH,     // one search from the top, arg = nothing
+    TRACE_ITERATION,  // findBestMove, arg = depth
+    TRACE_FIRST_MOVE, // the first root move, searched before the rest are split, arg = move
+    TRACE_ROOT_MOVE,  // root_worker, arg = move
+    TRACE_SPLIT_HELP, // a split helper helping at a node
+    TRACE_POOL_WAIT,  // waiting for the pool to finish a batch
+} TracePhaseKind;
+
+#if defined(SEARCH_TRACE)
+#define TRACE_RING_SIZE 32768 // phases per thread, a power of two
+#define TRACE_MAX_THREADS 256
+
+typedef struct {
+    Uint64 start, end;
+    Uint64 hot[TRACE_HOT_KINDS]; // counter ticks in each hot kind over the phase
+    Uint32 kind, arg;
+} TraceEvent;
+
+typedef struct {
+    Uint64 hotTicks[TRACE_HOT_KINDS], hotCalls[TRACE_HOT_KINDS]; // since the thread started tracing
+    Uint64 written;          // events ever written; the ring holds the last TRACE_RING_SIZE of them
+    SDL_ThreadID thread;
+    intptr_t slot;           // its searchThreadSlot
+    TraceEvent events[TRACE_RING_SIZE];
+} TraceRing;
+
+typedef struct {
+    Uint64 start;
+    Uint64 hot[TRACE_HOT_KINDS];
+} TracePhase;
+
+static SDL_TLSID traceSlot;
+static TraceRing* traceRings[TRACE_MAX_THREADS]; // never freed: a thread's row outlives the thread
+static SDL_AtomicInt traceRingCount;
+static Uint64 traceOrigin; // time 0 of the trace
+static char traceNoRing;   // the TLS of a thread that couldn't have a ring, so it doesn't ask again
+
+// the calling thread's ring, NULL if it couldn't have one
+static TraceRing* traceThreadRing(void) {
+    void* tls = SDL_GetTLS(&traceSlot);
+    if (tls) return tls == &traceNoRing ? NULL : tls;
+    int index = SDL_AddAtomicInt(&traceRingCount, 1);
+    TraceRing* ring = index < TRACE_MAX_THREADS ? SDL_calloc(1, sizeof(TraceRing)) : NULL;
+    if (!ring) { SDL_SetTLS(&traceSlot, &traceNoRing, NULL); return NULL; }
+    ring->thread = SDL_GetCurrentThreadID();
+    ring->slot = (intptr_t)SDL_GetTLS(&searchThreadSlot);
+    SDL_SetTLS(&traceSlot, ring, NULL);
+    SDL_SetAtomicPointer((void**)&traceRings[index], ring); // the writer reads it once the searches are over
+    return ring;
+}
+
+static inline void traceHot(TraceHot kind, Uint64 start) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    TraceRing* ring = traceThreadRing();
+    if (!ring) return;
+    ring->hotTicks[kind] += now - start;
+    ring->hotCalls[kind]++;
+}
+
+static TracePhase tracePhaseBegin(void) {
+    TracePhase phase = { SDL_GetPerformanceCounter(), { 0 } };
+    TraceRing* ring = traceThreadRing();
+    if (ring) SDL_memcpy(phase.hot, ring->hotTicks, sizeof(phase.hot));
+    return phase;
+}
+
+static void tracePhaseEnd(const TracePhase* phase, TracePhaseKind kind, Uint32 arg) {
+    TraceRing* ring = traceThreadRing();
+    if (!ring) return;
+    TraceEvent* event = &ring->events[ring->written++ & (TRACE_RING_SIZE - 1)];
+    event->start = phase->start;
+    event->end = SDL_GetPerformanceCounter();
+    for (int i = 0; i < TRACE_HOT_KINDS; i++) event->hot[i] = ring->hotTicks[i] - phase->hot[i];
+    event->kind = kind;
+    event->arg = arg;
+}
+
+// a statement timed as one of the hot kinds; or, for a function body, from a BEGIN to its END
+#define TRACE_HOT(kind, ...) do { Uint64 hotStart = SDL_GetPerformanceCounter(); __VA_ARGS__; traceHot(kind, hotStart); } while (0)
+#define TRACE_HOT_BEGIN(name) Uint64 name = SDL_GetPerformanceCounter()
+#define TRACE_HOT_END(name, kind) traceHot(kind, name)
+#define TRACE_BEGIN(name) TracePhase name = tracePhaseBegin()
+#define TRACE_END(name, kind, arg) tracePhaseEnd(&name, kind, (Uint32)(arg))
+#else
+#define TRACE_HOT(kind, ...) __VA_ARGS__
+#define TRACE_HOT_BEGIN(name) ((void)0)
+#define TRACE_HOT_END(name, kind) ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name, kind, arg) ((void)0)
+#endif
+
+// the search log (SearchLogRecord): a ring a thread, written by it and drained by the log's thread
+#define SEARCH_LOG_RING 4096 // records, a power of two
+#define SEARCH_LOG_MAX_THREADS 256
+#define SEARCH_LOG_FLUSH_MS 100
+
+typedef struct {
+    Uint64 head;     // records written, stored by the thread with release
+    Uint8 pad[56];   // so the two threads don't share a cache line
+    Uint64 tail;     // records drained, stored by the log's thread with release
+    Uint64 dropped;  // the thread's: records it had no room for since its last
+    SearchLogRecord records[SEARCH_LOG_RING];
+} SearchLogRing;
+
+static struct {
+    SDL_AtomicInt on;      // records are being taken
+    SDL_AtomicInt searches;
+    SDL_TLSID slot;        // the thread's ring
+    SearchLogRing* rings[SEARCH_LOG_MAX_THREADS]; // never freed, a thread's ring is there for the next log
+    SDL_AtomicInt ringCount;
+    SDL_IOStream* file;
+    bool failed;           // a write to the file failed; the rest are drained and thrown away
+    SDL_Thread* thread;
+    SDL_Mutex* lock;       // for wake
+    SDL_Condition* wake;   // the log closing
+    bool closing;          // under lock
+} searchLog;
+static char searchLogNoRing; // the TLS of a thread that couldn't have a ring
+
+static SearchLogRing* searchLogThreadRing(void) {
+    void* tls = SDL_GetTLS(&searchLog.slot);
+    if (tls) return tls == &searchLogNoRing ? NULL : tls;
+    int index = SDL_AddAtomicInt(&searchLog.ringCount, 1);
+    SearchLogRing* ring = index < SEARCH_LOG_MAX_THREADS ? SDL_calloc(1, sizeof(SearchLogRing)) : NULL;
+    if (!ring) { SDL_SetTLS(&searchLog.slot, &searchLogNoRing, NULL); return NULL; }
+    SDL_SetTLS(&searchLog.slot, ring, NULL);
+    SDL_SetAtomicPointer((void**)&searchLog.rings[index], ring);
+    return ring;
+}
+
+static void searchLogWrite(const Engine* engine, SearchLogKind kind, int depth, int score, Move move, Uint64 value) {
+    SearchLogRing* ring = searchLogThreadRing();
+    if (!ring) return;
+    Uint64 head = ring->head, room = SEARCH_LOG_RING - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+    if (room < 1 + (ring->dropped > 0)) { ring->dropped++; return; }
+    SearchLogRecord record = { .timeNS = SDL_GetTicksNS(), .search = engine->logSearch,
+                               .thread = (Uint8)(intptr_t)SDL_GetTLS(&searchThreadSlot) };
+    if (ring->dropped) {
+        record.kind = SEARCH_LOG_DROPPED;
+        record.value = ring->dropped;
+        ring->records[head++ & (SEARCH_LOG_RING - 1)] = record;
+        ring->dropped = 0;
+    }
+    record.kind = (Uint8)kind;
+    record.depth = (Sint16)depth;
+    record.score = score;
+    record.move = move;
+    record.value = value;
+    ring->records[head & (SEARCH_LOG_RING - 1)] = record;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// a record when the log is open; the arguments aren't worked out otherwise
+#define SEARCH_LOG(engine, ...) do { if (SDL_GetAtomicInt(&searchLog.on)) searchLogWrite(engine, __VA_ARGS__); } while (0)
+
+#if defined(SEARCH_TREE)
+// the search tree samples (SearchTreeRecord): an array a thread, grown as it fills
+#define SEARCH_TREE_MAX_THREADS 256
+#define SEARCH_TREE_MAX_RECORDS (1u << 22) // a thread's, 128 MB; past that they're counted as dropped
+
+typedef struct {
+    SearchTreeRecord* records;
+    Uint32 count, capacity;
+    Uint64 dropped;
+} SearchTreeBuffer;
+
+static struct {
+    Uint64 threshold;      // a node is kept when its hash, out of 2^32, comes under this
+    double sample;
+    SDL_AtomicInt searches;
+    SDL_TLSID slot;        // the thread's buffer
+    SearchTreeBuffer* buffers[SEARCH_TREE_MAX_THREADS]; // never freed, a thread's is there for the next samples
+    SDL_AtomicInt bufferCount;
+} searchTree = { .threshold = (Uint64)(SEARCH_TREE_SAMPLE * 4294967296.0), .sample = SEARCH_TREE_SAMPLE };
+static char searchTreeNoBuffer; // the TLS of a thread that couldn't have a buffer
+
+// on the position and the depth alone, so the same nodes come up whichever thread searches them, and when
+static inline bool searchTreeSampled(const ChessState* chess, int depth) {
+    return ((chess->hashKey ^ (Uint64)depth * 0x9E3779B97F4A7C15ULL) >> 32) < searchTree.threshold;
+}
+
+static void searchTreeKeep(const SearchTreeRecord* record) {
+    void* tls = SDL_GetTLS(&searchTree.slot);
+    if (!tls) {
+        int index = SDL_AddAtomicInt(&searchTree.bufferCount, 1);
+        tls = index < SEARCH_TREE_MAX_THREADS ? SDL_calloc(1, sizeof(SearchTreeBuffer)) : NULL;
+        if (tls) SDL_SetAtomicPointer((void**)&searchTree.buffers[index], tls);
+        else tls = &searchTreeNoBuffer;
+        SDL_SetTLS(&searchTree.slot, tls, NULL);
+    }
+    if (tls == &searchTreeNoBuffer) return;
+    SearchTreeBuffer* buffer = tls;
+    if (buffer->count == buffer->capacity) {
+        Uint32 capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        SearchTreeRecord* grown = capacity <= SEARCH_TREE_MAX_RECORDS
+                                  ? SDL_realloc(buffer->records, capacity * sizeof(SearchTreeRecord)) : NULL;
+        if (!grown) { buffer->dropped++; return; }
+        buffer->records = grown;
+        buffer->capacity = capacity;
+    }
+    buffer->records[buffer->count++] = *record;
+}
+
+// the search's number for its records
+#define SEARCH_TREE_NEW_SEARCH(engine) ((engine)->treeSearch = (Uint32)SDL_AddAtomicInt(&searchTree.searches, 1) + 1)
+#else
+#define SEARCH_TREE_NEW_SEARCH(engine) ((void)0)
+#endif
+
+// same order as PIECE TYPe, the unused codes between the colours 0
+int PIECE_VALUES[PIECE_TYPE_COUNT] = { 0,
+    1, 3, 4, 5, 9, 0, 0, 0,
+    1, 3, 4, 5, 9, 0
+};
+
+/* Move text goes into the caller's buffer, never a static one, so any thread can format moves at once: a worker
+   building its info line doesn't need the others to wait. */
+char* move2chars(Move move, char moveStr[MOVE_TEXT_MAX]) { // for printing moves; returns moveStr
+    int from = moveFrom(move), to = moveTo(move);
+    char fromFile = 'a' + (from & 7);
+    char fromRank = '1' + (from >> 3);
+    char toFile = 'a' + (to & 7);
+    char toRank = '1' + (to >> 3);
+    if (isCastlingMove(move)) {
+        if (moveFlags(move) == MOVE_CASTLE_KING) SDL_snprintf(moveStr, MOVE_TEXT_MAX, "O-O");
+        else SDL_snprintf(moveStr, MOVE_TEXT_MAX, "O-O-O");
+    } else if (isPromotionMove(move)) {
+        SDL_snprintf(moveStr, MOVE_TEXT_MAX, "%c%c%c%c%c=%c", fromFile, fromRank, isCaptureMove(move) ? 'x' : '-',
+                     toFile, toRank, "NBRQ"[moveFlags(move) & 3]);
+    } else if (isEnPassantMove(move)) {
+        SDL_snprintf(moveStr, MOVE_TEXT_MAX, "%c%c x %c%c e.p.", fromFile, fromRank, toFile, toRank);
+    } else if (isCaptureMove(move)) {
+        SDL_snprintf(moveStr, MOVE_TEXT_MAX, "%c%c x %c%c", fromFile, fromRank, toFile, toRank);
+    } else {
+        SDL_snprintf(moveStr, MOVE_TEXT_MAX, "%c%c-%c%c", fromFile, fromRank, toFile, toRank);
+    }
+    return moveStr;
+}
+
+// long algebraic as UCI and EPD tools write it: e2e4, e7e8q, castling as the king's move (e1g1); returns the length
+int moveToCoordinates(Move move, char out[6]) {
+    int from = moveFrom(move), to = moveTo(move);
+    out[0] = 'a' + (from & 7); out[1] = '1' + (from >> 3);
+    out[2] = 'a' + (to & 7);   out[3] = '1' + (to >> 3);
+    out[4] = isPromotionMove(move) ? "nbrq"[moveFlags(move) & 3] : '\0';
+    out[5] = '\0';
+    return isPromotionMove(move) ? 5 : 4;
+}
+
+// a legal move of the position in SAN (Nbd7, exd8=Q+, O-O#), the position as it was afterwards; returns the length
+int moveToSan(ChessState* chess, Move move, char out[MOVE_SAN_MAX]) {
+    static const char PIECE_LETTERS[] = "PNBRQK"; // in PieceType order
+    int from = moveFrom(move), to = moveTo(move), n = 0;
+    PieceType piece = chess->board[from];
+    int kind = pieceKind(piece) - WHITE_PAWN;
+    if (isCastlingMove(move)) {
+        n = (int)SDL_strlcpy(out, moveFlags(move) == MOVE_CASTLE_KING ? "O-O" : "O-O-O", MOVE_SAN_MAX);
+    } else {
+        if (kind > 0) {
+            out[n++] = PIECE_LETTERS[kind];
+            Bitboard others = moveOrigins(chess, piece, to) & ~(1ULL << from); // other pieces of the kind reaching the square
+            bool ambiguous = others != 0;
+            bool sameFile = (others & (0x0101010101010101ULL << (from & 7))) != 0;
+            bool sameRank = (others & (0xFFULL << (from & ~7))) != 0;
+            if (ambiguous && (!sameFile || sameRank)) out[n++] = (char)('a' + (from & 7));
+            if (ambiguous && sameFile) out[n++] = (char)('1' + (from >> 3));
+        } else if (isCaptureMove(move)) {
+            out[n++] = (char)('a' + (from & 7));
+        }
+        if (isCaptureMove(move)) out[n++] = 'x';
+        out[n++] = (char)('a' + (to & 7));
+        out[n++] = (char)('1' + (to >> 3));
+        if (isPromotionMove(move)) out[n++] = '=', out[n++] = "NBRQ"[moveFlags(move) & 3];
+    }
+    UndoInfo undo;
+    makeMove(chess, move, &undo);
+    if (isKingInCheck(chess, chess->whiteToMove)) out[n++] = hasLegalMove(chess) ? '+' : '#';
+    unmakeMove(chess, move, &undo);
+    out[n] = '\0';
+    return n;
+}
+
+/* A line of moves as text, separated by spaces: coordinates (UCI), or SAN played out from position. Fills out
+   with as many whole moves as fit in size and returns the length written, NUL not counted; no locks, no heap, so
+   info lines and result writers can call it from any thread. position is only read in SAN. */
+int formatPv(const ChessState* position, const Move* moves, int count, bool san, char* out, size_t size) {
+    if (size == 0) return 0;
+    ChessState chess;
+    if (san) chess = *position;
+    size_t n = 0;
+    for (int i = 0; i < count; i++) {
+        char move[MOVE_SAN_MAX];
+        int length = san ? moveToSan(&chess, moves[i], move) : moveToCoordinates(moves[i], move);
+        if (n + (i > 0) + (size_t)length >= size) break;
+        if (i > 0) out[n++] = ' ';
+        SDL_memcpy(out + n, move, (size_t)length);
+        n += (size_t)length;
+        if (san) makeMove(&chess, moves[i], NULL);
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+// engine thread; false (and nothing sent) when the UI has fallen that far behind
+static bool channelPush(EngineChannel* channel, const EngineEvent* event, int keepFree) {
+    int tail = SDL_GetAtomicInt(&channel->tail);
+    int used = tail - SDL_GetAtomicInt(&channel->head);
+    if (used + 1 + keepFree > ENGINE_EVENT_QUEUE) return false;
+    channel->events[tail & (ENGINE_EVENT_QUEUE - 1)] = *event;
+    SDL_SetAtomicInt(&channel->tail, tail + 1);
+    return true;
+}
+
+// UI thread; false when there is nothing waiting
+static bool channelPop(EngineChannel* channel, EngineEvent* event) {
+    int head = SDL_GetAtomicInt(&channel->head);
+    if (head == SDL_GetAtomicInt(&channel->tail)) return false;
+    *event = channel->events[head & (ENGINE_EVENT_QUEUE - 1)];
+    SDL_SetAtomicInt(&channel->head, head + 1);
+    return true;
+}
+// engine thread: to the callback when there is one, else into the channel for enginePollEvents
+static bool engineEmit(Engine* engine, const EngineEvent* event, int keepFree) {
+    if (engine->onEvent) {
+        engine->onEvent(event, engine->userData);
+        return true;
+    }
+    if (!channelPush(&engine->channel, event, keepFree)) return false;
+    if (engine->onQueued) engine->onQueued(event, engine->userData);
+    return true;
+}
+
+
+static inline Bitboard squareBB(int sq) { return 1ULL << sq; }
+static inline int popcount64(Bitboard b) { return __builtin_popcountll(b); }
+static inline int lsbIndex(Bitboard b) { return __builtin_ctzll(b); }
+static inline int popLsb(Bitboard* b) { int sq = __builtin_ctzll(*b); *b &= *b - 1; return sq; }
+// a piece as 1-6 white pawn to king and 7-12 black, without the unused codes: for the dense tables and the training records
+static inline int packedPiece(PieceType p) { return p - ((p & PIECE_BLACK) >> 2); }
+static inline PieceType unpackedPiece(int packed) { return (PieceType)(packed + (packed > WHITE_KING) * 2); }
+
+static const Bitboard FILE_A_BB = 0x0101010101010101ULL;
+static inline Bitboard fileBB(int c) { return FILE_A_BB << c; }
+
+// Zobrist keys, filled once by initZobristKeys()
+TABLE Uint64 ZOBRIST_PIECE[PIECE_TYPE_COUNT][64]; // [PieceType][square], EMPTY's and the unused codes' rows left zero
+TABLE Uint64 ZOBRIST_CASTLE[16];    // by castlingRights: the keys of white kingside, white queenside, black kingside and black queenside XORed
+TABLE Uint64 ZOBRIST_EP[8];         // en passant file
+TABLE Uint64 ZOBRIST_BLACK_TO_MOVE;
+static const Uint64 PAWN_KEY_MASK[PIECE_TYPE_COUNT] = { [WHITE_PAWN] = ~0ULL, [BLACK_PAWN] = ~0ULL }; // the pawns' keys make pawnKey
+
+#if !defined(TABLES_GENERATED)
+static Uint64 zobristRandom(Uint64* state) { // splitmix64
+    Uint64 z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+#endif
+
+void initZobristKeys(void) {
+#if !defined(TABLES_GENERATED)
+    Uint64 seed = 20240101; // fixed so keys are the same every run
+    for (int p = WHITE_PAWN; p <= BLACK_KING; p++) {
+        if (pieceKind(p) == EMPTY || pieceKind(p) > WHITE_KING) continue; // the unused codes
+        for (int sq = 0; sq < 64; sq++) ZOBRIST_PIECE[p][sq] = zobristRandom(&seed);
+    }
+    Uint64 castleKeys[4];
+    for (int i = 0; i < 4; i++) castleKeys[i] = zobristRandom(&seed);
+    for (int rights = 0; rights < 16; rights++) {
+        ZOBRIST_CASTLE[rights] = 0;
+        for (int i = 0; i < 4; i++) if (rights & 1 << i) ZOBRIST_CASTLE[rights] ^= castleKeys[i];
+    }
+    for (int i = 0; i < 8; i++) ZOBRIST_EP[i] = zobristRandom(&seed);
+    ZOBRIST_BLACK_TO_MOVE = zobristRandom(&seed);
+#endif
+}
+
+/* A middlegame and an endgame value in one int, endgame in the high half. Packed scores add and subtract as
+   pairs, as long as each half stays within 16 bits, so one running sum carries both. */
+typedef Sint32 PackedScore;
+#define PACK_SCORE(mg, eg) ((PackedScore)((Uint32)(eg) << 16) + (mg))
+static inline int mgValue(PackedScore s) { return (Sint16)(Uint16)(Uint32)s; }
+static inline int egValue(PackedScore s) { return (Sint16)(Uint16)((Uint32)(s + 0x8000) >> 16); }
+
+// game phase: minor pieces count 1, rooks 2, queens 4, so 24 for the starting set
+#define PHASE_MAX 24
+static const int PIECE_PHASE[PIECE_TYPE_COUNT] = { 0, 0, 1, 1, 2, 4, 0, 0, 0, 0, 1, 1, 2, 4, 0 };
+
+// evaluation terms per piece and square, white positive, filled once by initEvalTables()
+TABLE PackedScore PIECE_SQUARE_VALUE[PIECE_TYPE_COUNT][64]; // [PieceType][square], material included
+TABLE int PHASE_WEIGHT[PHASE_MAX + 1];          // the middlegame share of a tapered score, out of 256
+
+/* Optional neural evaluation (NNUE): 768 inputs, one per piece kind, colour and square as seen from one side, feed
+   an NNUE_HIDDEN-wide first layer per side, then a clipped ReLU and one output. The first layer is the
+   accumulator in ChessState, kept up to date by setSquare adding and subtracting weight columns, so a move costs
+   a few column updates and an evaluation just the output layer. Weights are quantised: the first layer int16
+   scaled by NNUE_QA, the output layer int8 scaled by NNUE_QB.
+   File (little-endian): "CHNN", Uint32 version, Uint32 NNUE_HIDDEN, then Sint16 featureBias[H],
+   Sint16 featureWeights[768][H], Sint8 outputWeights[2H] (side to move's half first), Sint32 outputBias. Version 1
+   packs them straight after the header; version 2 (nnueSave) starts each on a 64-byte boundary, the header
+   padded to NNUE_HEADER_BYTES, which is the layout the evaluation reads them in. A version 2 file is mapped and
+   used where it lies, so there's nothing to parse or convert and every process on the host that loads it shares
+   the one copy in the page cache; version 1, or any file on a big-endian machine, is copied into that layout. */
+#define NNUE_INPUTS 768
+#define NNUE_QA 255   // accumulator scale, also the clipped ReLU's ceiling
+#define NNUE_QB 64    // output weight scale
+#define NNUE_SCALE 400 // network output to centipawns
+#define NNUE_HEADER_BYTES 64
+#define NNUE_ALIGN(bytes) (((bytes) + 63) & ~(size_t)63)
+#define NNUE_BIAS_BYTES (NNUE_HIDDEN * sizeof(Sint16))
+#define NNUE_WEIGHT_BYTES (NNUE_INPUTS * NNUE_HIDDEN * sizeof(Sint16))
+#define NNUE_OUTPUT_BYTES (2 * NNUE_HIDDEN * sizeof(Sint8))
+#define NNUE_WEIGHT_OFFSET (NNUE_HEADER_BYTES + NNUE_ALIGN(NNUE_BIAS_BYTES))
+#define NNUE_OUTPUT_OFFSET (NNUE_WEIGHT_OFFSET + NNUE_ALIGN(NNUE_WEIGHT_BYTES))
+#define NNUE_OUTPUT_BIAS_OFFSET (NNUE_OUTPUT_OFFSET + NNUE_ALIGN(NNUE_OUTPUT_BYTES))
+#define NNUE_FILE_BYTES (NNUE_OUTPUT_BIAS_OFFSET + 64)             // version 2
+#define NNUE_PACKED_BYTES (12 + NNUE_BIAS_BYTES + NNUE_WEIGHT_BYTES + NNUE_OUTPUT_BYTES + sizeof(Sint32)) // version 1
+
+typedef struct {
+    bool loaded;
+    const Sint16* featureBias;                   // [NNUE_HIDDEN]
+    const Sint16 (*featureWeights)[NNUE_HIDDEN]; // [NNUE_INPUTS]
+    const Sint8* outputWeights;                  // [2 * NNUE_HIDDEN]
+    Sint32 outputBias;
+    MappedFile file;  // the version 2 file the pointers are into, or
+    Uint8* copy;      // NNUE_FILE_BYTES laid out the same way
+} NnueNet;
+
+static NnueNet nnueNet; // read-only once loaded, shared by every thread
+
+// input for piece p on square sq as perspective `side` sees it: own pieces first, board flipped for black
+static inline int nnueFeature(int side, PieceType p, int sq) {
+    int theirs = pieceColor(p) != side;
+    return theirs * 384 + (pieceKind(p) - 1) * 64 + (side ? sq ^ 56 : sq);
+}
+
+// plain loops: the compiler vectorises these for whatever the build targets
+static inline void nnueAddColumn(Sint16* acc, const Sint16* column) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) acc[i] += column[i];
+}
+static inline void nnueSubColumn(Sint16* acc, const Sint16* column) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) acc[i] -= column[i];
+}
+
+static inline void nnueUpdate(ChessState* chess, int sq, PieceType old, PieceType p) {
+    for (int side = 0; side < 2; side++) {
+        if (old != EMPTY) nnueSubColumn(chess->accumulator[side], nnueNet.featureWeights[nnueFeature(side, old, sq)]);
+        if (p != EMPTY) nnueAddColumn(chess->accumulator[side], nnueNet.featureWeights[nnueFeature(side, p, sq)]);
+    }
+}
+
+static void nnueRefresh(ChessState* chess) {
+    for (int side = 0; side < 2; side++) {
+        SDL_memcpy(chess->accumulator[side], nnueNet.featureBias, NNUE_BIAS_BYTES);
+        for (int sq = 0; sq < 64; sq++) {
+            PieceType p = chess->board[sq];
+            if (p != EMPTY) nnueAddColumn(chess->accumulator[side], nnueNet.featureWeights[nnueFeature(side, p, sq)]);
+        }
+    }
+}
+
+/* Output layer: sum of clamp(acc, 0, QA) * weight over one perspective. Each product is at most 255 * 128 and
+   adjacent pairs are added in 32 bits, so nothing saturates. Picked at load time like the PEXT lookup. */
+static Sint32 nnueDotScalar(const Sint16* acc, const Sint8* weights) {
+    Sint32 sum = 0;
+    for (int i = 0; i < NNUE_HIDDEN; i++) sum += SDL_clamp(acc[i], 0, NNUE_QA) * weights[i];
+    return sum;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static Sint32 nnueDotAvx2(const Sint16* acc, const Sint8* weights) {
+    const __m256i zero = _mm256_setzero_si256(), ceiling = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = zero;
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i a = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(acc + i)), zero), ceiling);
+        __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static Sint32 nnueDotAvx512(const Sint16* acc, const Sint8* weights) {
+    const __m512i zero = _mm512_setzero_si512(), ceiling = _mm512_set1_epi16(NNUE_QA);
+    __m512i sum = zero;
+    for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+        __m512i a = _mm512_min_epi16(_mm512_max_epi16(_mm512_loadu_si512(acc + i), zero), ceiling);
+        __m512i w = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(weights + i)));
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(a, w));
+    }
+    return _mm512_reduce_add_epi32(sum);
+}
+#elif defined(__ARM_NEON)
+static Sint32 nnueDotNeon(const Sint16* acc, const Sint8* weights) {
+    const int16x8_t zero = vdupq_n_s16(0), ceiling = vdupq_n_s16(NNUE_QA);
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+        int16x8_t a = vminq_s16(vmaxq_s16(vld1q_s16(acc + i), zero), ceiling);
+        int16x8_t w = vmovl_s8(vld1_s8(weights + i));
+        sum = vmlal_s16(sum, vget_low_s16(a), vget_low_s16(w));
+        sum = vmlal_s16(sum, vget_high_s16(a), vget_high_s16(w));
+    }
+    return vaddvq_s32(sum);
+}
+#endif
+
+static Sint32 (*nnueDot)(const Sint16* acc, const Sint8* weights) = nnueDotScalar; // see selectKernels
+static const char* nnueDotKind = "scalar";
+
+// a version 2 layout's 16-bit weights between little-endian and this machine's order, in place; either way round
+static void nnueSwapNet(Uint8* net) {
+    Sint16* words = (Sint16*)(net + NNUE_HEADER_BYTES);
+    for (int i = 0; i < NNUE_HIDDEN; i++) words[i] = (Sint16)SDL_Swap16LE((Uint16)words[i]);
+    words = (Sint16*)(net + NNUE_WEIGHT_OFFSET);
+    for (int i = 0; i < NNUE_INPUTS * NNUE_HIDDEN; i++) words[i] = (Sint16)SDL_Swap16LE((Uint16)words[i]);
+}
+
+// a version 1 or 2 file's weights copied into the version 2 layout, in this machine's byte order
+static void nnueCopyNet(Uint8* copy, const Uint8* data, Uint32 version) {
+    size_t bias = version == 1 ? 12 : NNUE_HEADER_BYTES;
+    size_t weights = version == 1 ? bias + NNUE_BIAS_BYTES : NNUE_WEIGHT_OFFSET;
+    size_t output = version == 1 ? weights + NNUE_WEIGHT_BYTES : NNUE_OUTPUT_OFFSET;
+    size_t outputBias = version == 1 ? output + NNUE_OUTPUT_BYTES : NNUE_OUTPUT_BIAS_OFFSET;
+    SDL_memset(copy, 0, NNUE_FILE_BYTES);
+    SDL_memcpy(copy + NNUE_HEADER_BYTES, data + bias, NNUE_BIAS_BYTES);
+    SDL_memcpy(copy + NNUE_WEIGHT_OFFSET, data + weights, NNUE_WEIGHT_BYTES);
+    SDL_memcpy(copy + NNUE_OUTPUT_OFFSET, data + output, NNUE_OUTPUT_BYTES);
+    SDL_memcpy(copy + NNUE_OUTPUT_BIAS_OFFSET, data + outputBias, sizeof(Sint32)); // left little-endian
+    nnueSwapNet(copy);
+}
+
+/* False (and the network, or the hand-written evaluation, kept) if the file is missing or doesn't match this
+   build's network. Not while anything is searching or evaluating: the old weights go. */
+bool nnueLoad(const char* path) {
+    MappedFile file;
+    if (!mapFile(&file, path)) {
+        SDL_Log("NNUE: can't read %s: %s", path, SDL_GetError());
+        return false;
+    }
+    const Uint8* data = (const Uint8*)file.data;
+    Uint32 version = 0, hidden = 0;
+    if (file.size >= 12) { SDL_memcpy(&version, data + 4, 4); SDL_memcpy(&hidden, data + 8, 4); }
+    version = SDL_Swap32LE(version);
+    if (file.size < 12 || SDL_memcmp(data, "CHNN", 4) != 0 || (version != 1 && version != 2) ||
+        SDL_Swap32LE(hidden) != NNUE_HIDDEN || file.size != (version == 1 ? NNUE_PACKED_BYTES : NNUE_FILE_BYTES)) {
+        SDL_Log("NNUE: %s is not a version 1 or 2 network with %d hidden units", path, NNUE_HIDDEN);
+        unmapFile(&file);
+        return false;
+    }
+    Uint8* copy = NULL;
+    if (version == 1 || SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+        if (!(copy = SDL_aligned_alloc(64, NNUE_FILE_BYTES))) {
+            SDL_Log("NNUE: no memory for %s", path);
+            unmapFile(&file);
+            return false;
+        }
+        nnueCopyNet(copy, data, version);
+        unmapFile(&file);
+        data = copy;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    else if (file.mapped) madvise((void*)file.data, file.size, MADV_WILLNEED); // read all over, not front to back
+#endif
+
+    unmapFile(&nnueNet.file);
+    SDL_aligned_free(nnueNet.copy);
+    nnueNet.file = file;
+    nnueNet.copy = copy;
+    nnueNet.featureBias = (const Sint16*)(data + NNUE_HEADER_BYTES);
+    nnueNet.featureWeights = (const Sint16(*)[NNUE_HIDDEN])(data + NNUE_WEIGHT_OFFSET);
+    nnueNet.outputWeights = (const Sint8*)(data + NNUE_OUTPUT_OFFSET);
+    Uint32 outputBias;
+    SDL_memcpy(&outputBias, data + NNUE_OUTPUT_BIAS_OFFSET, sizeof(outputBias));
+    nnueNet.outputBias = (Sint32)SDL_Swap32LE(outputBias);
+    nnueNet.loaded = true;
+    SDL_Log("NNUE: loaded %s (%d hidden units, %s output layer, %s)", path, NNUE_HIDDEN, nnueDotKind,
+            copy ? "copied" : file.mapped ? "mapped" : "read");
+    return true;
+}
+
+// the loaded network as a version 2 file; false (SDL_GetError) with none loaded or if the file can't be written
+bool nnueSave(const char* path) {
+    if (!nnueNet.loaded) return SDL_SetError("no network loaded");
+    Uint8* data = SDL_aligned_alloc(64, NNUE_FILE_BYTES);
+    if (!data) return false;
+    SDL_memset(data, 0, NNUE_FILE_BYTES);
+    Uint32 header[2] = { SDL_Swap32LE(2), SDL_Swap32LE(NNUE_HIDDEN) };
+    SDL_memcpy(data, "CHNN", 4);
+    SDL_memcpy(data + 4, header, sizeof(header));
+    SDL_memcpy(data + NNUE_HEADER_BYTES, nnueNet.featureBias, NNUE_BIAS_BYTES);
+    SDL_memcpy(data + NNUE_WEIGHT_OFFSET, nnueNet.featureWeights, NNUE_WEIGHT_BYTES);
+    SDL_memcpy(data + NNUE_OUTPUT_OFFSET, nnueNet.outputWeights, NNUE_OUTPUT_BYTES);
+    Uint32 outputBias = SDL_Swap32LE((Uint32)nnueNet.outputBias);
+    SDL_memcpy(data + NNUE_OUTPUT_BIAS_OFFSET, &outputBias, sizeof(outputBias));
+    if (SDL_BYTEORDER == SDL_BIG_ENDIAN) nnueSwapNet(data);
+    SDL_IOStream* out = SDL_IOFromFile(path, "wb");
+    bool written = out && SDL_WriteIO(out, data, NNUE_FILE_BYTES) == NNUE_FILE_BYTES;
+    if (out && !SDL_CloseIO(out)) written = false;
+    SDL_aligned_free(data);
+    return written;
+}
+
+// centipawns for the side to move; the accumulators must be current (a net loaded before the position was set up)
+static int nnueEvaluate(const ChessState* chess) {
+    int us = chess->whiteToMove ? 0 : 1;
+    Sint32 sum = nnueNet.outputBias + nnueDot(chess->accumulator[us], nnueNet.outputWeights) +
+                 nnueDot(chess->accumulator[us ^ 1], nnueNet.outputWeights + NNUE_HIDDEN);
+    int score = (int)((Sint64)sum * NNUE_SCALE / (NNUE_QA * NNUE_QB));
+    return SDL_clamp(score, -MATE_BOUND + 1, MATE_BOUND - 1);
+}
+
+// white's point of view, like evaluateBatch; false with no network loaded
+bool nnueEvaluateBatch(const ChessState* positions, int count, int* scores) {
+    if (!nnueNet.loaded) return false;
+    for (int i = 0; i < count; i++) scores[i] = positions[i].whiteToMove ? nnueEvaluate(&positions[i]) : -nnueEvaluate(&positions[i]);
+    return true;
+}
+
+/* The network on the GPU (SDL's GPU API and shaders/nnue_eval.comp), for scoring batches too big to be worth
+   doing a position at a time on the CPU. The weights go up once; a batch goes up as each position's piece list
+   and comes back as the output layer's sums, scaled here exactly as nnueEvaluate does. Two slots, each with its own
+   buffers and fence, so one batch can be in flight while the caller fills the next: submit doesn't wait, only
+   collecting a batch that hasn't finished does. */
+#define GPU_EVAL_POSITION_WORDS 17 // a header word and 32 pieces at two a word; the shader's POSITION_WORDS
+#define GPU_EVAL_SLOTS 2
+
+typedef struct {
+    SDL_GPUBuffer* positions;
+    SDL_GPUBuffer* scores;
+    SDL_GPUTransferBuffer* upload;
+    SDL_GPUTransferBuffer* download;
+    SDL_GPUFence* fence;     // NULL when the slot is free
+    int count;
+    Sint8 sign[GPU_EVAL_BATCH];  // 1 white to move, -1 black; 0: more than 32 pieces, scored on the CPU into cpu[]
+    int cpu[GPU_EVAL_BATCH];
+} GpuEvalSlot;
+
+struct GpuEvaluator {
+    SDL_GPUDevice* device;
+    SDL_GPUComputePipeline* pipeline;
+    SDL_GPUBuffer* weights;
+    SDL_GPUBuffer* net;      // biases and output weights widened to int32, then the output bias
+    GpuEvalSlot slots[GPU_EVAL_SLOTS];
+    int oldest, inFlight;
+};
+
+static SDL_GPUBuffer* gpuEvalBuffer(SDL_GPUDevice* device, SDL_GPUBufferUsageFlags usage, Uint32 size) {
+    return SDL_CreateGPUBuffer(device, &(SDL_GPUBufferCreateInfo){ .usage = usage, .size = size });
+}
+
+// the weights and biases copied into their buffers, waiting for the copy to finish
+static bool gpuEvalUploadNet(GpuEvaluator* gpu) {
+    const Uint32 weightBytes = NNUE_WEIGHT_BYTES, netBytes = (3 * NNUE_HIDDEN + 1) * sizeof(Sint32);
+    SDL_GPUTransferBuffer* transfer = SDL_CreateGPUTransferBuffer(gpu->device,
+        &(SDL_GPUTransferBufferCreateInfo){ .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, .size = weightBytes + netBytes });
+    Uint8* mapped = transfer ? SDL_MapGPUTransferBuffer(gpu->device, transfer, false) : NULL;
+    if (!mapped) {
+        if (transfer) SDL_ReleaseGPUTransferBuffer(gpu->device, transfer);
+        return false;
+    }
+    SDL_memcpy(mapped, nnueNet.featureWeights, weightBytes); // the shader pairs them up little-endian, as loaded
+    Sint32* net = (Sint32*)(mapped + weightBytes);
+    for (int i = 0; i < NNUE_HIDDEN; i++) net[i] = nnueNet.featureBias[i];
+    for (int i = 0; i < 2 * NNUE_HIDDEN; i++) net[NNUE_HIDDEN + i] = nnueNet.outputWeights[i];
+    net[3 * NNUE_HIDDEN] = nnueNet.outputBias;
+    SDL_UnmapGPUTransferBuffer(gpu->device, transfer);
+
+    SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(gpu->device);
+    bool ok = cmd != NULL;
+    if (ok) {
+        SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
+        SDL_UploadToGPUBuffer(copy, &(SDL_GPUTransferBufferLocation){ transfer, 0 },
+                              &(SDL_GPUBufferRegion){ gpu->weights, 0, weightBytes }, false);
+        SDL_UploadToGPUBuffer(copy, &(SDL_GPUTransferBufferLocation){ transfer, weightBytes },
+                              &(SDL_GPUBufferRegion){ gpu->net, 0, netBytes }, false);
+        SDL_EndGPUCopyPass(copy);
+        SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+        ok = fence && SDL_WaitForGPUFences(gpu->device, true, &fence, 1);
+        if (fence) SDL_ReleaseGPUFence(gpu->device, fence);
+    }
+    SDL_ReleaseGPUTransferBuffer(gpu->device, transfer);
+    return ok;
+}
+
+void gpuEvalDestroy(GpuEvaluator* gpu) {
+    if (!gpu) return;
+    if (gpu->device) {
+        for (int s = 0; s < GPU_EVAL_SLOTS; s++) {
+            GpuEvalSlot* slot = &gpu->slots[s];
+            if (slot->fence) {
+                SDL_WaitForGPUFences(gpu->device, true, &slot->fence, 1);
+                SDL_ReleaseGPUFence(gpu->device, slot->fence);
+            }
+            SDL_ReleaseGPUBuffer(gpu->device, slot->positions);
+            SDL_ReleaseGPUBuffer(gpu->device, slot->scores);
+            SDL_ReleaseGPUTransferBuffer(gpu->device, slot->upload);
+            SDL_ReleaseGPUTransferBuffer(gpu->device, slot->download);
+        }
+        SDL_ReleaseGPUBuffer(gpu->device, gpu->weights);
+        SDL_ReleaseGPUBuffer(gpu->device, gpu->net);
+        SDL_ReleaseGPUComputePipeline(gpu->device, gpu->pipeline);
+        SDL_DestroyGPUDevice(gpu->device);
+    }
+    SDL_free(gpu);
+}
+
+GpuEvaluator* gpuEvalCreate(const char* shaderPath) {
+    if (!nnueNet.loaded) {
+        SDL_Log("GPU: no network loaded to evaluate with");
+        return NULL;
+    }
+    size_t codeSize = 0;
+    Uint8* code = SDL_LoadFile(shaderPath, &codeSize);
+    if (!code) {
+        SDL_Log("GPU: can't read %s: %s", shaderPath, SDL_GetError());
+        return NULL;
+    }
+    GpuEvaluator* gpu = SDL_calloc(1, sizeof(GpuEvaluator));
+    if (gpu) gpu->device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, false, NULL);
+    if (gpu && gpu->device) {
+        gpu->pipeline = SDL_CreateGPUComputePipeline(gpu->device, &(SDL_GPUComputePipelineCreateInfo){
+            .code_size = codeSize, .code = code, .entrypoint = "main", .format = SDL_GPU_SHADERFORMAT_SPIRV,
+            .num_readonly_storage_buffers = 3, .num_readwrite_storage_buffers = 1,
+            .threadcount_x = NNUE_HIDDEN, .threadcount_y = 1, .threadcount_z = 1 });
+    }
+    SDL_free(code);
+    if (!gpu || !gpu->device || !gpu->pipeline) {
+        SDL_Log("GPU: no compute device for %s: %s", shaderPath, SDL_GetError());
+        gpuEvalDestroy(gpu);
+        return NULL;
+    }
+    const Uint32 positionBytes = GPU_EVAL_BATCH * GPU_EVAL_POSITION_WORDS * sizeof(Uint32), scoreBytes = GPU_EVAL_BATCH * sizeof(Sint32);
+    gpu->weights = gpuEvalBuffer(gpu->device, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, NNUE_WEIGHT_BYTES);
+    gpu->net = gpuEvalBuffer(gpu->device, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, (3 * NNUE_HIDDEN + 1) * sizeof(Sint32));
+    bool ok = gpu->weights && gpu->net;
+    for (int s = 0; s < GPU_EVAL_SLOTS && ok; s++) {
+        GpuEvalSlot* slot = &gpu->slots[s];
+        slot->positions = gpuEvalBuffer(gpu->device, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ, positionBytes);
+        slot->scores = gpuEvalBuffer(gpu->device, SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE, scoreBytes);
+        slot->upload = SDL_CreateGPUTransferBuffer(gpu->device,
+            &(SDL_GPUTransferBufferCreateInfo){ .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, .size = positionBytes });
+        slot->download = SDL_CreateGPUTransferBuffer(gpu->device,
+            &(SDL_GPUTransferBufferCreateInfo){ .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD, .size = scoreBytes });
+        ok = slot->positions && slot->scores && slot->upload && slot->download;
+    }
+    if (!ok || !gpuEvalUploadNet(gpu)) {
+        SDL_Log("GPU: can't set up the buffers: %s", SDL_GetError());
+        gpuEvalDestroy(gpu);
+        return NULL;
+    }
+    SDL_Log("GPU: evaluating on %s, %d positions a batch", SDL_GetGPUDeviceDriver(gpu->device), GPU_EVAL_BATCH);
+    return gpu;
+}
+
+bool gpuEvalSubmit(GpuEvaluator* gpu, const ChessState* const positions[], int count) {
+    if (gpu->inFlight == GPU_EVAL_SLOTS || count <= 0 || count > GPU_EVAL_BATCH) return false;
+    GpuEvalSlot* slot = &gpu->slots[(gpu->oldest + gpu->inFlight) % GPU_EVAL_SLOTS];
+    Uint32* words = SDL_MapGPUTransferBuffer(gpu->device, slot->upload, false); // free: its last batch was collected
+    if (!words) return false;
+    for (int i = 0; i < count; i++) {
+        const ChessState* chess = positions[i];
+        Uint32* out = words + i * GPU_EVAL_POSITION_WORDS;
+        int pieces = popcount64(chess->occupied);
+        slot->sign[i] = pieces > 32 ? 0 : chess->whiteToMove ? 1 : -1;
+        if (pieces > 32) { // an odd FEN; the GPU is told it's empty
+            slot->cpu[i] = chess->whiteToMove ? nnueEvaluate(chess) : -nnueEvaluate(chess);
+            out[0] = 0;
+            continue;
+        }
+        out[0] = (Uint32)pieces | (chess->whiteToMove ? 0u : 256u);
+        int k = 0;
+        for (Bitboard b = chess->occupied; b; k++) {
+            int sq = popLsb(&b);
+            Uint32 piece = (Uint32)chess->board[sq] << 6 | (Uint32)sq;
+            if (k & 1) out[1 + k / 2] |= piece << 16;
+            else out[1 + k / 2] = piece;
+        }
+    }
+    SDL_UnmapGPUTransferBuffer(gpu->device, slot->upload);
+
+    SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(gpu->device);
+    if (!cmd) return false;
+    Uint32 positionBytes = (Uint32)count * GPU_EVAL_POSITION_WORDS * sizeof(Uint32), scoreBytes = (Uint32)count * sizeof(Sint32);
+    SDL_GPUCopyPass* copy = SDL_BeginGPUCopyPass(cmd);
+    SDL_UploadToGPUBuffer(copy, &(SDL_GPUTransferBufferLocation){ slot->upload, 0 },
+                          &(SDL_GPUBufferRegion){ slot->positions, 0, positionBytes }, false);
+    SDL_EndGPUCopyPass(copy);
+    SDL_GPUComputePass* pass = SDL_BeginGPUComputePass(cmd, NULL, 0, &(SDL_GPUStorageBufferReadWriteBinding){ .buffer = slot->scores }, 1);
+    SDL_BindGPUComputePipeline(pass, gpu->pipeline);
+    SDL_BindGPUComputeStorageBuffers(pass, 0, (SDL_GPUBuffer* const[]){ gpu->weights, gpu->net, slot->positions }, 3);
+    SDL_DispatchGPUCompute(pass, (Uint32)count, 1, 1);
+    SDL_EndGPUComputePass(pass);
+    copy = SDL_BeginGPUCopyPass(cmd);
+    SDL_DownloadFromGPUBuffer(copy, &(SDL_GPUBufferRegion){ slot->scores, 0, scoreBytes },
+                              &(SDL_GPUTransferBufferLocation){ slot->download, 0 });
+    SDL_EndGPUCopyPass(copy);
+    slot->fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    if (!slot->fence) return false;
+    slot->count = count;
+    gpu->inFlight++;
+    return true;
+}
+
+int gpuEvalCollect(GpuEvaluator* gpu, int* scores) {
+    if (gpu->inFlight == 0) return 0;
+    GpuEvalSlot* slot = &gpu->slots[gpu->oldest];
+    bool done = SDL_WaitForGPUFences(gpu->device, true, &slot->fence, 1);
+    SDL_ReleaseGPUFence(gpu->device, slot->fence);
+    slot->fence = NULL;
+    gpu->oldest = (gpu->oldest + 1) % GPU_EVAL_SLOTS;
+    gpu->inFlight--;
+    const Sint32* sums = done ? SDL_MapGPUTransferBuffer(gpu->device, slot->download, false) : NULL;
+    if (!sums) return -1;
+    for (int i = 0; i < slot->count; i++) {
+        int score = (int)((Sint64)sums[i] * NNUE_SCALE / (NNUE_QA * NNUE_QB)); // as nnueEvaluate
+        score = SDL_clamp(score, -MATE_BOUND + 1, MATE_BOUND - 1);
+        scores[i] = slot->sign[i] ? slot->sign[i] * score : slot->cpu[i];
+    }
+    SDL_UnmapGPUTransferBuffer(gpu->device, slot->download);
+    return slot->count;
+}
+
+// the part of the key that isn't piece placement
+// the castling and en passant part of the key, for the full recompute and makeMove's incremental one alike
+static inline Uint64 stateKey(int castlingRights, int enPassantCol) {
+    Uint64 key = ZOBRIST_CASTLE[castlingRights];
+    if (enPassantCol >= 0) key ^= ZOBRIST_EP[enPassantCol];
+    return key;
+}
+
+/* castlingRights &= CASTLE_MASK[from] & CASTLE_MASK[to] after every move: a king or rook leaving its home square
+   takes its rights with it, and so does a rook captured on one */
+static const Uint8 CASTLE_MASK[64] = {
+    [0] = CASTLE_ALL & ~CASTLE_WHITE_QUEEN, [1 ... 3] = CASTLE_ALL, [4] = CASTLE_ALL & ~(CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN),
+    [5 ... 6] = CASTLE_ALL, [7] = CASTLE_ALL & ~CASTLE_WHITE_KING, [8 ... 55] = CASTLE_ALL,
+    [56] = CASTLE_ALL & ~CASTLE_BLACK_QUEEN, [57 ... 59] = CASTLE_ALL, [60] = CASTLE_ALL & ~(CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN),
+    [61 ... 62] = CASTLE_ALL, [63] = CASTLE_ALL & ~CASTLE_BLACK_KING,
+};
+
+// the right to castle on one side, as a castlingRights bit
+static inline int castleRight(int side, bool kingside) { return 1 << (side * 2 + (kingside ? 0 : 1)); }
+
+// keeps the mailbox, the bitboards and the hash key in sync, every board write goes through here
+static inline void setSquare(ChessState* chess, int r, int c, PieceType p) {
+    int sq = squareIndex(r, c);
+    Bitboard bit = squareBB(sq);
+    PieceType old = pieceAt(chess, r, c);
+    if (old != EMPTY) {
+        chess->pieceBB[old] &= ~bit;
+        chess->colorBB[pieceColor(old)] &= ~bit;
+        chess->occupied &= ~bit;
+    }
+    if (p != EMPTY) {
+        chess->pieceBB[p] |= bit;
+        chess->colorBB[pieceColor(p)] |= bit;
+        chess->occupied |= bit;
+    }
+    chess->hashKey ^= ZOBRIST_PIECE[old][sq] ^ ZOBRIST_PIECE[p][sq];
+    chess->pawnKey ^= (ZOBRIST_PIECE[old][sq] & PAWN_KEY_MASK[old]) ^ (ZOBRIST_PIECE[p][sq] & PAWN_KEY_MASK[p]);
+    chess->psq += PIECE_SQUARE_VALUE[p][sq] - PIECE_SQUARE_VALUE[old][sq];
+    chess->phase += PIECE_PHASE[p] - PIECE_PHASE[old];
+    if (nnueNet.loaded) nnueUpdate(chess, sq, old, p);
+    chess->board[squareIndex(r, c)] = p;
+}
+
+/* The whole-board sums behind psq and phase, which setSquare otherwise keeps up one square at a time. The scalar
+   loop is the reference; the AVX2 one widens eight squares of the mailbox at once and gathers their table entries
+   (packed scores add lane-wise like plain ints), and has to give the same bits. Picked in initEvalTables. */
+SDL_COMPILE_TIME_ASSERT(mailboxSize, sizeof(((ChessState*)0)->board) == 64); // the mailbox is loaded as bytes
+
+static bool useAvx2BoardSum = false; // see selectKernels
+
+static PackedScore boardSumScalar(const ChessState* chess, int* phase) {
+    PackedScore psq = 0;
+    *phase = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        PieceType p = chess->board[sq];
+        psq += PIECE_SQUARE_VALUE[p][sq]; // the EMPTY row is zero
+        *phase += PIECE_PHASE[p];
+    }
+    return psq;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static PackedScore boardSumAvx2(const ChessState* chess, int* phase) {
+    const Uint8* board = chess->board;
+    __m256i psq = _mm256_setzero_si256(), phases = _mm256_setzero_si256();
+    __m256i squares = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int sq = 0; sq < 64; sq += 8) {
+        __m256i pieces = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(board + sq)));
+        __m256i index = _mm256_add_epi32(_mm256_slli_epi32(pieces, 6), squares); // [p][sq] flattened
+        psq = _mm256_add_epi32(psq, _mm256_i32gather_epi32((const int*)PIECE_SQUARE_VALUE, index, 4));
+        phases = _mm256_add_epi32(phases, _mm256_i32gather_epi32(PIECE_PHASE, pieces, 4));
+        squares = _mm256_add_epi32(squares, _mm256_set1_epi32(8));
+    }
+    __m256i both = _mm256_hadd_epi32(psq, phases); // psq pairs in lanes 0-1 and 4-5, phase pairs in 2-3 and 6-7
+    both = _mm256_hadd_epi32(both, both);
+    __m128i sums = _mm_add_epi32(_mm256_castsi256_si128(both), _mm256_extracti128_si256(both, 1));
+    *phase = _mm_extract_epi32(sums, 1);
+    return _mm_cvtsi128_si32(sums);
+}
+#endif
+
+// rebuild every mask and the evaluation terms from the mailbox (after setting up a position by hand)
+static void refreshBitboards(ChessState* chess) {
+    memset(chess->pieceBB, 0, sizeof(chess->pieceBB));
+    memset(chess->colorBB, 0, sizeof(chess->colorBB));
+    chess->occupied = 0;
+    chess->pawnKey = 0;
+#if defined(__x86_64__)
+    if (useAvx2BoardSum) chess->psq = boardSumAvx2(chess, &chess->phase);
+    else
+#endif
+    chess->psq = boardSumScalar(chess, &chess->phase);
+    Uint64 key = 0;
+    for (int r = 0; r < 8; r++) for (int c = 0; c < 8; c++) {
+        PieceType p = pieceAt(chess, r, c);
+        if (p == EMPTY) continue;
+        int sq = squareIndex(r, c);
+        Bitboard bit = squareBB(sq);
+        chess->pieceBB[p] |= bit;
+        chess->colorBB[pieceColor(p)] |= bit;
+        chess->occupied |= bit;
+        key ^= ZOBRIST_PIECE[p][sq];
+        chess->pawnKey ^= ZOBRIST_PIECE[p][sq] & PAWN_KEY_MASK[p];
+    }
+    chess->kingSquare[0] = chess->pieceBB[WHITE_KING] ? lsbIndex(chess->pieceBB[WHITE_KING]) : -1;
+    chess->kingSquare[1] = chess->pieceBB[BLACK_KING] ? lsbIndex(chess->pieceBB[BLACK_KING]) : -1;
+    key ^= stateKey(chess->castlingRights, chess->enPassantCol);
+    chess->hashKey = chess->whiteToMove ? key : key ^ ZOBRIST_BLACK_TO_MOVE;
+    if (nnueNet.loaded) nnueRefresh(chess);
+}
+
+// leaper attack masks per square, filled once by initAttackTables()
+TABLE Bitboard KNIGHT_ATTACKS[64];
+TABLE Bitboard KING_ATTACKS[64];
+TABLE Bitboard PAWN_ATTACKS[2][64]; // [colour][square], diagonal captures only
+
+#if !defined(TABLES_GENERATED)
+static Bitboard leaperMask(int r, int c, const int offsets[][2], int count) {
+    Bitboard mask = 0;
+    for (int i = 0; i < count; i++) {
+        int tr = r + offsets[i][0], tc = c + offsets[i][1];
+        if (tr >= 0 && tr < 8 && tc >= 0 && tc < 8) mask |= squareBB(squareIndex(tr, tc));
+    }
+    return mask;
+}
+#endif
+
+TABLE Bitboard BETWEEN[64][64]; // squares strictly between two aligned squares, 0 otherwise
+
+#if defined(CHESS_LOW_MEMORY)
+/* Sliding attacks, classical: a direction's ray from the square on an empty board, cut at the first piece on it
+   by taking away that piece's own ray the same way. The rays are 4 KB where the lookups below are 841 KB. */
+TABLE Bitboard RAYS[8][64]; // [direction][square]; 0 to 3 go up the square numbers, 4 to 7 down
+static bool usePext = false; // no tables to index
+
+static inline Bitboard rayAttacks(int dir, int sq, Bitboard occ) {
+    Bitboard ray = RAYS[dir][sq], blockers = ray & occ;
+    if (!blockers) return ray;
+    int first = dir < 4 ? lsbIndex(blockers) : 63 - __builtin_clzll(blockers);
+    return ray ^ RAYS[dir][first];
+}
+static inline Bitboard rookAttacks(int sq, Bitboard occ) {
+    return rayAttacks(0, sq, occ) | rayAttacks(1, sq, occ) | rayAttacks(4, sq, occ) | rayAttacks(5, sq, occ);
+}
+static inline Bitboard bishopAttacks(int sq, Bitboard occ) {
+    return rayAttacks(2, sq, occ) | rayAttacks(3, sq, occ) | rayAttacks(6, sq, occ) | rayAttacks(7, sq, occ);
+}
+#else
+// sliding attacks: occupancy-indexed lookup, either fancy magics or BMI2 PEXT (picked at startup)
+typedef struct {
+    Bitboard mask;      // relevant occupancy (ray squares minus the board edge)
+    Bitboard magic;
+    const Bitboard* attacks; // this square's slice of the shared table
+    int shift;
+} SliderMagic;
+
+static SliderMagic ROOK_MAGICS[64]; // never const: PEXT points them at tables of its own
+static SliderMagic BISHOP_MAGICS[64];
+TABLE Bitboard rookAttackTable[102400]; // laid out for magics when generated
+TABLE Bitboard bishopAttackTable[5248];
+static bool usePext = false; // see selectKernels; the tables are laid out for one or the other
+
+#if defined(__x86_64__)
+__attribute__((target("bmi2"))) static unsigned pextIndex(Bitboard occ, Bitboard mask) {
+    return (unsigned)_pext_u64(occ, mask);
+}
+#endif
+
+static inline unsigned sliderIndex(const SliderMagic* m, Bitboard occ) {
+#if defined(__x86_64__)
+    if (usePext) return pextIndex(occ, m->mask);
+#endif
+    return (unsigned)(((occ & m->mask) * m->magic) >> m->shift);
+}
+static inline Bitboard rookAttacks(int sq, Bitboard occ) { return ROOK_MAGICS[sq].attacks[sliderIndex(&ROOK_MAGICS[sq], occ)]; }
+static inline Bitboard bishopAttacks(int sq, Bitboard occ) { return BISHOP_MAGICS[sq].attacks[sliderIndex(&BISHOP_MAGICS[sq], occ)]; }
+#endif
+static inline Bitboard queenAttacks(int sq, Bitboard occ) { return rookAttacks(sq, occ) | bishopAttacks(sq, occ); }
+
+#if !defined(TABLES_GENERATED) && defined(CHESS_LOW_MEMORY)
+static const int RAY_DIRS[8][2] = { {1,0}, {0,1}, {1,1}, {1,-1}, {-1,0}, {0,-1}, {-1,-1}, {-1,1} }; // RAYS' order
+#elif !defined(TABLES_GENERATED)
+static const int ROOK_DIRS[4][2]   = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+static const int BISHOP_DIRS[4][2] = { {1,1}, {1,-1}, {-1,1}, {-1,-1} };
+
+// slow ray walk, only used to fill the tables
+static Bitboard slidingAttacksSlow(int sq, Bitboard occ, const int dirs[4][2]) {
+    Bitboard attacks = 0;
+    for (int i = 0; i < 4; i++) {
+        int r = (sq >> 3) + dirs[i][0], c = (sq & 7) + dirs[i][1];
+        for (; r >= 0 && r < 8 && c >= 0 && c < 8; r += dirs[i][0], c += dirs[i][1]) {
+            Bitboard bit = squareBB(squareIndex(r, c));
+            attacks |= bit;
+            if (occ & bit) break;
+        }
+    }
+    return attacks;
+}
+
+static Uint64 magicSeed;
+static Uint64 magicRandom(void) { // xorshift64*, reseeded per rank so the magics are the same every run
+    magicSeed ^= magicSeed >> 12; magicSeed ^= magicSeed << 25; magicSeed ^= magicSeed >> 27;
+    return magicSeed * 2685821657736338717ULL;
+}
+
+// fills one piece type's table, returns the number of entries used
+static int initSliderMagics(SliderMagic magics[64], Bitboard* table, const int dirs[4][2]) {
+    static const Uint64 rankSeeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 }; // known to converge fast
+    static Bitboard occupancy[4096], reference[4096];
+    static int epoch[4096];
+    int offset = 0, attempt = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        int r = sq >> 3, c = sq & 7;
+        Bitboard edges = ((0xFFULL | (0xFFULL << 56)) & ~(0xFFULL << (r * 8))) |
+                         ((FILE_A_BB | (FILE_A_BB << 7)) & ~fileBB(c));
+        SliderMagic* m = &magics[sq];
+        m->mask = slidingAttacksSlow(sq, 0, dirs) & ~edges;
+        int bits = popcount64(m->mask);
+        m->shift = 64 - bits;
+        Bitboard* attacks = table + offset;
+        m->attacks = attacks;
+
+        // enumerate every subset of the mask (carry-rippler)
+        int size = 0;
+        Bitboard subset = 0;
+        do {
+            occupancy[size] = subset;
+            reference[size] = slidingAttacksSlow(sq, subset, dirs);
+            size++;
+            subset = (subset - m->mask) & m->mask;
+        } while (subset);
+
+        if (usePext) {
+#if defined(__x86_64__)
+            for (int i = 0; i < size; i++) attacks[pextIndex(occupancy[i], m->mask)] = reference[i];
+#endif
+        } else {
+            magicSeed = rankSeeds[r];
+            for (bool found = false; !found; ) {
+                do m->magic = magicRandom() & magicRandom() & magicRandom();
+                while (popcount64((m->mask * m->magic) >> 56) < 6);
+                attempt++;
+                found = true;
+                for (int i = 0; i < size; i++) {
+                    unsigned idx = sliderIndex(m, occupancy[i]);
+                    if (epoch[idx] < attempt) {
+                        epoch[idx] = attempt;
+                        attacks[idx] = reference[i];
+                    } else if (m->attacks[idx] != reference[i]) {
+                        found = false;
+                        break;
+                    }
+                }
+            }
+        }
+        offset += size;
+    }
+    return offset;
+}
+#elif defined(__x86_64__) && !defined(CHESS_LOW_MEMORY)
+/* The generated tables are laid out for magics; PEXT indexes the same slices (each square's 2^bits entries) in an
+   order of its own, so with it they're copied over once, square by square, and the magics pointed at the copy. */
+static Bitboard pextAttackTable[SDL_arraysize(rookAttackTable) + SDL_arraysize(bishopAttackTable)];
+
+static Bitboard* pextFromMagics(SliderMagic magics[64], Bitboard* table) {
+    for (int sq = 0; sq < 64; sq++) {
+        SliderMagic* m = &magics[sq];
+        Bitboard subset = 0;
+        do {
+            table[pextIndex(subset, m->mask)] = m->attacks[(subset * m->magic) >> m->shift];
+            subset = (subset - m->mask) & m->mask;
+        } while (subset);
+        m->attacks = table;
+        table += 1ULL << popcount64(m->mask);
+    }
+    return table;
+}
+#endif
+
+void initAttackTables(void) {
+#if defined(TABLES_GENERATED) && defined(CHESS_LOW_MEMORY)
+    SDL_Log("Slider attack tables (rays, generated): %d KB", (int)(sizeof(RAYS) / 1024));
+#elif defined(TABLES_GENERATED)
+#if defined(__x86_64__)
+    if (usePext) pextFromMagics(BISHOP_MAGICS, pextFromMagics(ROOK_MAGICS, pextAttackTable));
+#endif
+    SDL_Log("Slider attack tables (%s, generated): %d KB (rook %d + bishop %d entries)",
+            usePext ? "BMI2 PEXT" : "magic bitboards", (int)((sizeof(rookAttackTable) + sizeof(bishopAttackTable)) / 1024),
+            (int)SDL_arraysize(rookAttackTable), (int)SDL_arraysize(bishopAttackTable));
+#else
+    static const int knightOffsets[8][2] = { {2,1}, {1,2}, {-1,2}, {-2,1}, {-2,-1}, {-1,-2}, {1,-2}, {2,-1} };
+    static const int kingOffsets[8][2]   = { {1,0}, {1,1}, {0,1}, {-1,1}, {-1,0}, {-1,-1}, {0,-1}, {1,-1} };
+    static const int pawnOffsets[2][2][2] = { { {1,-1}, {1,1} }, { {-1,-1}, {-1,1} } };
+    for (int sq = 0; sq < 64; sq++) {
+        int r = sq >> 3, c = sq & 7;
+        KNIGHT_ATTACKS[sq]  = leaperMask(r, c, knightOffsets, 8);
+        KING_ATTACKS[sq]    = leaperMask(r, c, kingOffsets, 8);
+        PAWN_ATTACKS[0][sq] = leaperMask(r, c, pawnOffsets[0], 2);
+        PAWN_ATTACKS[1][sq] = leaperMask(r, c, pawnOffsets[1], 2);
+    }
+
+#if defined(CHESS_LOW_MEMORY)
+    for (int dir = 0; dir < 8; dir++)
+        for (int sq = 0; sq < 64; sq++) {
+            RAYS[dir][sq] = 0;
+            for (int r = (sq >> 3) + RAY_DIRS[dir][0], c = (sq & 7) + RAY_DIRS[dir][1]; r >= 0 && r < 8 && c >= 0 && c < 8;
+                 r += RAY_DIRS[dir][0], c += RAY_DIRS[dir][1])
+                RAYS[dir][sq] |= squareBB(squareIndex(r, c));
+        }
+#else
+    int rookEntries = initSliderMagics(ROOK_MAGICS, rookAttackTable, ROOK_DIRS);
+    int bishopEntries = initSliderMagics(BISHOP_MAGICS, bishopAttackTable, BISHOP_DIRS);
+#endif
+    for (int a = 0; a < 64; a++) for (int b = 0; b < 64; b++) {
+        Bitboard bits = squareBB(a) | squareBB(b);
+        if (a == b) BETWEEN[a][b] = 0;
+        else if (rookAttacks(a, 0) & squareBB(b)) BETWEEN[a][b] = rookAttacks(a, bits) & rookAttacks(b, bits);
+        else if (bishopAttacks(a, 0) & squareBB(b)) BETWEEN[a][b] = bishopAttacks(a, bits) & bishopAttacks(b, bits);
+        else BETWEEN[a][b] = 0;
+    }
+#if defined(CHESS_LOW_MEMORY)
+    SDL_Log("Slider attack tables (rays): %d KB", (int)(sizeof(RAYS) / 1024));
+#else
+    SDL_Log("Slider attack tables (%s): %d KB (rook %d + bishop %d entries)",
+            usePext ? "BMI2 PEXT" : "magic bitboards",
+            (int)(((rookEntries + bishopEntries) * sizeof(Bitboard)) / 1024), rookEntries, bishopEntries);
+#endif
+#endif
+}
+
+ChessState initChessState(void) {
+    ChessState chess;
+    memset(&chess, 0, sizeof(chess));
+    static const PieceType BACK_RANK[8] = { WHITE_ROOK, WHITE_KNIGHT, WHITE_BISHOP, WHITE_QUEEN, WHITE_KING, WHITE_BISHOP, WHITE_KNIGHT, WHITE_ROOK };
+    for (int c = 0; c < 8; ++c) { // black's PieceTypes are white's with the colour bit
+        chess.board[squareIndex(0, c)] = BACK_RANK[c];
+        chess.board[squareIndex(1, c)] = WHITE_PAWN;
+        chess.board[squareIndex(6, c)] = BLACK_PAWN;
+        chess.board[squareIndex(7, c)] = flipPiece(BACK_RANK[c]);
+    }
+    chess.whiteToMove = true;
+    chess.castlingRights = CASTLE_ALL;
+    chess.enPassantCol = -1;
+    chess.fullmoveNumber = 1;
+    refreshBitboards(&chess);
+    return chess;
+}
+
+// sets up the position from a FEN string, or the first four fields of an EPD line (the move counters then start
+// at 0 and 1). It allocates nothing, and a newline ends the string as well as a NUL, so lines can be read straight
+// out of a file buffer. The repetition history starts empty. Returns false, with the board untouched, on a malformed
+// string or a position the rest of the engine can't take: other than one king a side, a castling right without the
+// king and that rook at home, or an en passant square that isn't behind a pawn that has just moved two squares.
+bool loadFen(ChessState* chess, const char* fen) {
+    static const PieceType FEN_PIECES[128] = { // by letter, EMPTY for anything that isn't one
+        ['P'] = WHITE_PAWN, ['N'] = WHITE_KNIGHT, ['B'] = WHITE_BISHOP, ['R'] = WHITE_ROOK, ['Q'] = WHITE_QUEEN, ['K'] = WHITE_KING,
+        ['p'] = BLACK_PAWN, ['n'] = BLACK_KNIGHT, ['b'] = BLACK_BISHOP, ['r'] = BLACK_ROOK, ['q'] = BLACK_QUEEN, ['k'] = BLACK_KING
+    };
+    Uint8 board[64] = { EMPTY };
+    int row = 7, col = 0;
+    const char* p = fen;
+    for (; *p > ' '; p++) {
+        if (*p == '/') {
+            if (col != 8 || row == 0) return false;
+            row--; col = 0;
+        } else if (*p >= '1' && *p <= '8') {
+            col += *p - '0';
+            if (col > 8) return false;
+        } else {
+            PieceType piece = (unsigned char)*p < 128 ? FEN_PIECES[(unsigned char)*p] : EMPTY;
+            if (piece == EMPTY || col > 7) return false;
+            board[squareIndex(row, col++)] = piece;
+        }
+    }
+    if (row != 0 || col != 8 || *p != ' ') return false;
+    int kings[2] = { 0, 0 };
+    for (int sq = 0; sq < 64; sq++)
+        if (board[sq] == WHITE_KING || board[sq] == BLACK_KING) kings[board[sq] == BLACK_KING]++;
+    if (kings[0] != 1 || kings[1] != 1) return false;
+    p++;
+    if (*p != 'w' && *p != 'b') return false;
+    bool whiteToMove = *p++ == 'w';
+    while (*p == ' ') p++;
+    int rights = 0;
+    for (; *p > ' '; p++) {
+        switch (*p) {
+            case 'K': rights |= CASTLE_WHITE_KING; break;
+            case 'Q': rights |= CASTLE_WHITE_QUEEN; break;
+            case 'k': rights |= CASTLE_BLACK_KING; break;
+            case 'q': rights |= CASTLE_BLACK_QUEEN; break;
+            case '-': break;
+            default: return false;
+        }
+    }
+    if (((rights & CASTLE_WHITE_KING) && (board[4] != WHITE_KING || board[7] != WHITE_ROOK)) ||
+        ((rights & CASTLE_WHITE_QUEEN) && (board[4] != WHITE_KING || board[0] != WHITE_ROOK)) ||
+        ((rights & CASTLE_BLACK_KING) && (board[60] != BLACK_KING || board[63] != BLACK_ROOK)) ||
+        ((rights & CASTLE_BLACK_QUEEN) && (board[60] != BLACK_KING || board[56] != BLACK_ROOK)))
+        return false;
+    while (*p == ' ') p++;
+    int epCol = -1;
+    if (*p >= 'a' && *p <= 'h') {
+        // the square the pawn passed over: on the sixth rank with white to move, the pawn beyond it and both empty
+        epCol = *p++ - 'a';
+        int passed = whiteToMove ? 5 : 2, pawnRow = whiteToMove ? 4 : 3, startRow = whiteToMove ? 6 : 1;
+        if (*p != '1' + passed || board[squareIndex(pawnRow, epCol)] != (whiteToMove ? BLACK_PAWN : WHITE_PAWN) ||
+            board[squareIndex(passed, epCol)] != EMPTY || board[squareIndex(startRow, epCol)] != EMPTY)
+            return false;
+    } else if (*p && *p != '-') return false;
+    while (*p > ' ') p++;
+    while (*p == ' ') p++;
+    int halfmoves = 0, fullmoves = 1;
+    if (*p >= '0' && *p <= '9') { // EPD operations start with a letter
+        char* end;
+        halfmoves = (int)SDL_strtol(p, &end, 10);
+        while (*end == ' ') end++;
+        if (*end >= '0' && *end <= '9') fullmoves = (int)SDL_strtol(end, NULL, 10);
+    }
+
+    SDL_memcpy(chess->board, board, sizeof(board));
+    chess->whiteToMove = whiteToMove;
+    chess->castlingRights = (Uint8)rights;
+    chess->enPassantCol = epCol;
+    chess->halfmoveClock = halfmoves < 0 ? 0 : halfmoves;
+    chess->fullmoveNumber = fullmoves < 1 ? 1 : fullmoves;
+    chess->keyCount = 0;
+    refreshBitboards(chess);
+    return true;
+}
+
+/* The position as FEN, into out (FEN_MAX bytes is always enough); returns its length. The en passant square is
+   given after every double push, whether or not a capture is possible, like the engine's own key. */
+int writeFen(const ChessState* chess, char* out, size_t size) {
+    static const char PIECE_CHARS[] = " PNBRQK??pnbrqk"; // indexed by PieceType
+    char fen[FEN_MAX];
+    int n = 0;
+    for (int row = 7; row >= 0; row--) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            PieceType p = pieceAt(chess, row, col);
+            if (p == EMPTY) { empty++; continue; }
+            if (empty) fen[n++] = (char)('0' + empty), empty = 0;
+            fen[n++] = PIECE_CHARS[p];
+        }
+        if (empty) fen[n++] = (char)('0' + empty);
+        if (row > 0) fen[n++] = '/';
+    }
+    fen[n++] = ' ';
+    fen[n++] = chess->whiteToMove ? 'w' : 'b';
+    fen[n++] = ' ';
+    int rights = n;
+    for (int i = 0; i < 4; i++) if (chess->castlingRights & 1 << i) fen[n++] = "KQkq"[i];
+    if (n == rights) fen[n++] = '-';
+    fen[n++] = ' ';
+    if (chess->enPassantCol >= 0) {
+        fen[n++] = (char)('a' + chess->enPassantCol);
+        fen[n++] = chess->whiteToMove ? '6' : '3';
+    } else {
+        fen[n++] = '-';
+    }
+    const int counters[2] = { chess->halfmoveClock, chess->fullmoveNumber };
+    for (int i = 0; i < 2; i++) { // digits backwards into a scratch buffer, then forwards; cheaper than snprintf
+        char digits[12];
+        int d = 0;
+        unsigned value = counters[i] < 0 ? 0 : (unsigned)counters[i];
+        do digits[d++] = (char)('0' + value % 10); while ((value /= 10) > 0);
+        fen[n++] = ' ';
+        while (d > 0) fen[n++] = digits[--d];
+    }
+    fen[n] = '\0';
+    SDL_strlcpy(out, fen, size);
+    return n;
+}
+
+/* A position as a TRAINING_RECORD_SIZE-byte record (layout in engine.h), with its score and the game's result.
+   Everything is byte by byte, so shards read the same on any machine. */
+void trainingRecordPack(const ChessState* chess, int score, int result, Uint8 record[TRAINING_RECORD_SIZE]) {
+    SDL_memset(record, 0, TRAINING_RECORD_SIZE);
+    Bitboard occupied = chess->occupied;
+    for (int i = 0; i < 8; i++) record[i] = (Uint8)(occupied >> (8 * i));
+    int n = 0;
+    for (Bitboard b = occupied; b && n < 32; n++) { // a legal position has 32 pieces at most
+        int sq = popLsb(&b);
+        record[8 + n / 2] |= (Uint8)(packedPiece(chess->board[sq]) << (n % 2 * 4));
+    }
+    Sint16 clamped = (Sint16)SDL_clamp(score, -32767, 32767);
+    int ply = (chess->fullmoveNumber - 1) * 2 + (chess->whiteToMove ? 0 : 1);
+    record[24] = (Uint8)clamped; record[25] = (Uint8)((Uint16)clamped >> 8);
+    record[26] = (Uint8)SDL_min(ply, 65535); record[27] = (Uint8)(SDL_min(ply, 65535) >> 8);
+    record[28] = (Uint8)((chess->whiteToMove ? 0 : 1) | chess->castlingRights << 1);
+    record[29] = (Uint8)(chess->enPassantCol + 1);
+    record[30] = (Uint8)(Sint8)SDL_clamp(result, -1, 1);
+    record[31] = (Uint8)SDL_min(chess->halfmoveClock, 255);
+}
+
+// the other way; false (and the position untouched) for a record no position packs to, one king a side and all
+bool trainingRecordUnpack(const Uint8 record[TRAINING_RECORD_SIZE], ChessState* chess, int* score, int* result) {
+    Bitboard occupied = 0;
+    for (int i = 0; i < 8; i++) occupied |= (Bitboard)record[i] << (8 * i);
+    if (popcount64(occupied) > 32 || record[29] > 8 || (record[28] >> 5) != 0) return false;
+    Uint8 board[64] = { EMPTY };
+    int kings[2] = { 0, 0 }, n = 0;
+    for (Bitboard b = occupied; b; n++) {
+        int sq = popLsb(&b);
+        int packed = (record[8 + n / 2] >> (n % 2 * 4)) & 15;
+        if (packed == EMPTY || packed > 12) return false;
+        PieceType p = unpackedPiece(packed);
+        if (p == WHITE_KING || p == BLACK_KING) kings[p == BLACK_KING]++;
+        board[sq] = p;
+    }
+    if (kings[0] != 1 || kings[1] != 1) return false;
+    int ply = record[26] | record[27] << 8;
+    SDL_memcpy(chess->board, board, sizeof(board));
+    chess->whiteToMove = (record[28] & 1) == 0;
+    chess->castlingRights = (Uint8)(record[28] >> 1 & CASTLE_ALL);
+    chess->enPassantCol = record[29] - 1;
+    chess->halfmoveClock = record[31];
+    chess->fullmoveNumber = ply / 2 + 1;
+    chess->keyCount = 0;
+    refreshBitboards(chess);
+    *score = (Sint16)(record[24] | record[25] << 8);
+    *result = (Sint8)record[30];
+    return true;
+}
+
+static inline bool inBounds(int r, int c) { return r >= 0 && r < 8 && c >= 0 && c < 8; }
+// both pieces, and of one colour
+static inline bool sameColor(PieceType a, PieceType b) { return a != EMPTY && b != EMPTY && !((a ^ b) & PIECE_BLACK); }
+
+bool knightMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    (void)chess; // the same arguments as the other pieces' tests
+    return (KNIGHT_ATTACKS[squareIndex(fr, fc)] & squareBB(squareIndex(tr, tc))) != 0;
+}
+bool rookMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    return (rookAttacks(squareIndex(fr, fc), chess->occupied) & squareBB(squareIndex(tr, tc))) != 0;
+}
+bool bishopMove(const ChessState* chess, int fr, int fc, int tr, int tc) { // same lookup as rook but diagonal rays
+    return (bishopAttacks(squareIndex(fr, fc), chess->occupied) & squareBB(squareIndex(tr, tc))) != 0;
+}
+bool queenMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    return (queenAttacks(squareIndex(fr, fc), chess->occupied) & squareBB(squareIndex(tr, tc))) != 0;
+}
+bool pawnMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    PieceType p = pieceAt(chess, fr, fc);
+    int dir = isWhite(p) ? +1 : -1;
+    int startRow = isWhite(p) ? 1 : 6;
+    if (fc == tc && tr == fr + dir && pieceAt(chess, tr, tc) == EMPTY) return true;
+    if (fc == tc && fr == startRow && tr == fr + 2*dir && pieceAt(chess, fr + dir, fc) == EMPTY && pieceAt(chess, tr, tc) == EMPTY) return true;
+    Bitboard target = squareBB(squareIndex(tr, tc));
+    Bitboard capturable = chess->occupied;
+    if (chess->enPassantCol == tc && tr == (isWhite(p) ? 5 : 2) && isWhite(p) == chess->whiteToMove) capturable |= target; // en passant
+    return (PAWN_ATTACKS[pieceColor(p)][squareIndex(fr, fc)] & target & capturable) != 0;
+}
+
+
+bool canPieceAttackSquare(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    if (!inBounds(tr, tc)) return false;
+    PieceType p = pieceAt(chess, fr, fc);
+    if (p == EMPTY) return false;
+    switch (pieceKind(p)) {
+        case WHITE_PAWN: return pawnMove(chess, fr, fc, tr, tc);
+        case WHITE_KNIGHT: return knightMove(chess, fr, fc, tr, tc);
+        case WHITE_BISHOP: return bishopMove(chess, fr, fc, tr, tc);
+        case WHITE_ROOK: return rookMove(chess, fr, fc, tr, tc);
+        case WHITE_QUEEN: return queenMove(chess, fr, fc, tr, tc);
+        case WHITE_KING: return (KING_ATTACKS[squareIndex(fr, fc)] & squareBB(squareIndex(tr, tc))) != 0;
+        default: return false;
+    }
+}
+/* FORCE_INLINE functions are the ones written for a side that's a compile-time constant where they're used (see
+   GENERATE_FOR_SIDE); SIDE_PIECE is the piece of that side for a white PieceType. */
+#define FORCE_INLINE static inline __attribute__((always_inline))
+#define SIDE_PIECE(side, whitePiece) ((PieceType)((whitePiece) | (side) << 3))
+
+// works backwards from the target: cast each attack pattern out of sq and see if it lands on a matching piece of `by`
+FORCE_INLINE bool squareAttackedBy(const ChessState* chess, int sq, const int by) {
+    const Bitboard* bb = chess->pieceBB;
+    if (PAWN_ATTACKS[by ^ 1][sq] & bb[SIDE_PIECE(by, WHITE_PAWN)]) return true; // pawns sit where the other side's pawn on sq would capture
+    if (KNIGHT_ATTACKS[sq] & bb[SIDE_PIECE(by, WHITE_KNIGHT)]) return true;
+    if (KING_ATTACKS[sq] & bb[SIDE_PIECE(by, WHITE_KING)]) return true;
+    if (bishopAttacks(sq, chess->occupied) & (bb[SIDE_PIECE(by, WHITE_BISHOP)] | bb[SIDE_PIECE(by, WHITE_QUEEN)])) return true;
+    return (rookAttacks(sq, chess->occupied) & (bb[SIDE_PIECE(by, WHITE_ROOK)] | bb[SIDE_PIECE(by, WHITE_QUEEN)])) != 0;
+}
+
+bool isSquareAttacked(const ChessState* chess, int r, int c, bool byWhite) {
+    return byWhite ? squareAttackedBy(chess, squareIndex(r, c), 0) : squareAttackedBy(chess, squareIndex(r, c), 1);
+}
+bool isKingInCheck(const ChessState* chess, bool whiteKing) {
+    int sq = chess->kingSquare[whiteKing ? 0 : 1];
+    if (sq < 0) return false;
+    return isSquareAttacked(chess, sq >> 3, sq & 7, !whiteKing);
+}
+bool canCastle(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    (void)tr; // the king's own rank, like kingMove's other moves
+    PieceType king = pieceAt(chess, fr, fc);
+    bool white = isWhite(king);
+    if (white && fr != 0) return false;
+    if (!white && fr != 7) return false;
+    if (fc != 4) return false;
+    int rookCol = (tc == 6) ? 7 : 0;
+    int step = (tc > fc) ? 1 : -1;
+    if (!(chess->castlingRights & castleRight(white ? 0 : 1, tc == 6))) return false;
+    if (pieceAt(chess, fr, rookCol) != (white ? WHITE_ROOK : BLACK_ROOK)) return false;
+    for (int c = fc + step; c != rookCol; c += step) if (pieceAt(chess, fr, c) != EMPTY) return false;
+    if (isKingInCheck(chess, white)) return false;
+    for (int c = fc; c != tc + step; c += step) if (isSquareAttacked(chess, fr, c, !white)) return false;
+    return true;
+}
+bool kingMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    if (KING_ATTACKS[squareIndex(fr, fc)] & squareBB(squareIndex(tr, tc))) return true;
+    if (fr == tr && (tc == 6 || tc == 2)) return canCastle(chess, fr, fc, tr, tc);
+    return false;
+}
+// every attacker of either colour on sq, given an occupancy (so x-rays can be revealed by removing pieces)
+static Bitboard attackersTo(const ChessState* chess, int sq, Bitboard occ) {
+    const Bitboard* bb = chess->pieceBB;
+    return (PAWN_ATTACKS[1][sq] & bb[WHITE_PAWN]) | (PAWN_ATTACKS[0][sq] & bb[BLACK_PAWN])
+         | (KNIGHT_ATTACKS[sq] & (bb[WHITE_KNIGHT] | bb[BLACK_KNIGHT]))
+         | (KING_ATTACKS[sq] & (bb[WHITE_KING] | bb[BLACK_KING]))
+         | (bishopAttacks(sq, occ) & (bb[WHITE_BISHOP] | bb[BLACK_BISHOP] | bb[WHITE_QUEEN] | bb[BLACK_QUEEN]))
+         | (rookAttacks(sq, occ) & (bb[WHITE_ROOK] | bb[BLACK_ROOK] | bb[WHITE_QUEEN] | bb[BLACK_QUEEN]));
+}
+
+// the king's attackers on the occupancy after from-to, the captured piece left out; the position isn't touched
+static bool kingSafeAfter(const ChessState* chess, int from, int to) {
+    PieceType p = chess->board[from], target = chess->board[to];
+    int side = pieceColor(p);
+    Bitboard captured = target != EMPTY ? squareBB(to) : 0;
+    if (pieceKind(p) == WHITE_PAWN && ((from ^ to) & 7) && target == EMPTY) captured = squareBB((from & ~7) | (to & 7)); // en passant
+    Bitboard occ = (chess->occupied & ~squareBB(from) & ~captured) | squareBB(to);
+    int king = pieceKind(p) == WHITE_KING ? to : chess->kingSquare[side];
+    if (king < 0) return true;
+    return (attackersTo(chess, king, occ) & chess->colorBB[side ^ 1] & ~captured) == 0;
+}
+
+bool isLegalMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
+    if (!inBounds(tr, tc)) return false;
+    PieceType p = pieceAt(chess, fr, fc);
+    if (p == EMPTY) return false;
+    PieceType target = pieceAt(chess, tr, tc);
+    if (sameColor(p, target)) return false;
+    bool ok = false;
+    switch (pieceKind(p)) {
+        case WHITE_PAWN: ok = pawnMove(chess, fr, fc, tr, tc); break;
+        case WHITE_KNIGHT: ok = knightMove(chess, fr, fc, tr, tc); break;
+        case WHITE_BISHOP: ok = bishopMove(chess, fr, fc, tr, tc); break;
+        case WHITE_ROOK: ok = rookMove(chess, fr, fc, tr, tc); break;
+        case WHITE_QUEEN: ok = queenMove(chess, fr, fc, tr, tc); break;
+        case WHITE_KING: ok = kingMove(chess, fr, fc, tr, tc); break;
+        default: return false;
+    }
+    if (!ok) return false;
+    return kingSafeAfter(chess, squareIndex(fr, fc), squareIndex(tr, tc));
+}
+
+/* The squares holding piece that can legally move to to: its attack set looked at from the target square, pawn
+   pushes and en passant included, castling not. SAN is read and written with this, so neither needs the move list. */
+Bitboard moveOrigins(const ChessState* chess, PieceType piece, int to) {
+    int side = pieceColor(piece);
+    Bitboard pieces = chess->pieceBB[piece], target = squareBB(to);
+    if (chess->colorBB[side] & target) return 0;
+    Bitboard origins = 0;
+    switch (pieceKind(piece)) {
+        case WHITE_PAWN: {
+            int epSquare = chess->enPassantCol >= 0 ? squareIndex(side == 0 ? 5 : 2, chess->enPassantCol) : -1;
+            if ((chess->colorBB[side ^ 1] & target) || to == epSquare) {
+                origins = PAWN_ATTACKS[side ^ 1][to] & pieces;
+                break;
+            }
+            if (chess->occupied & target) break;
+            int back = side == 0 ? to - 8 : to + 8;
+            if (back < 0 || back > 63) break;
+            if (pieces & squareBB(back)) origins = squareBB(back);
+            else if (!(chess->occupied & squareBB(back)) && (to >> 3) == (side == 0 ? 3 : 4)) origins = pieces & squareBB(side == 0 ? to - 16 : to + 16);
+            break;
+        }
+        case WHITE_KNIGHT: origins = KNIGHT_ATTACKS[to] & pieces; break;
+        case WHITE_BISHOP: origins = bishopAttacks(to, chess->occupied) & pieces; break;
+        case WHITE_ROOK: origins = rookAttacks(to, chess->occupied) & pieces; break;
+        case WHITE_QUEEN: origins = queenAttacks(to, chess->occupied) & pieces; break;
+        case WHITE_KING: origins = KING_ATTACKS[to] & pieces; break;
+        default: break;
+    }
+    for (Bitboard b = origins; b; b &= b - 1)
+        if (!kingSafeAfter(chess, lsbIndex(b), to)) origins &= ~squareBB(lsbIndex(b));
+    return origins;
+}
+
+// every square the piece on (r, c) can reach, ignoring whether it leaves its own king in check
+static Bitboard pseudoTargets(const ChessState* chess, int r, int c) {
+    PieceType p = pieceAt(chess, r, c);
+    int side = pieceColor(p);
+    Bitboard targets = 0;
+    switch (pieceKind(p)) {
+        case WHITE_PAWN: {
+            int dir = side == 0 ? +1 : -1;
+            int startRow = side == 0 ? 1 : 6;
+            int tr = r + dir;
+            if (tr < 0 || tr > 7) break;
+            if (pieceAt(chess, tr, c) == EMPTY) {
+                targets |= squareBB(squareIndex(tr, c));
+                if (r == startRow && pieceAt(chess, tr + dir, c) == EMPTY) targets |= squareBB(squareIndex(tr + dir, c));
+            }
+            targets |= PAWN_ATTACKS[side][squareIndex(r, c)] & chess->colorBB[side ^ 1];
+            if (chess->enPassantCol >= 0 && r == (side == 0 ? 4 : 3) && side == (chess->whiteToMove ? 0 : 1))
+                targets |= PAWN_ATTACKS[side][squareIndex(r, c)] & squareBB(squareIndex(tr, chess->enPassantCol));
+            break;
+        }
+        case WHITE_KNIGHT: targets = KNIGHT_ATTACKS[squareIndex(r, c)]; break;
+        case WHITE_BISHOP: targets = bishopAttacks(squareIndex(r, c), chess->occupied); break;
+        case WHITE_ROOK: targets = rookAttacks(squareIndex(r, c), chess->occupied); break;
+        case WHITE_QUEEN: targets = queenAttacks(squareIndex(r, c), chess->occupied); break;
+        case WHITE_KING:
+            targets = KING_ATTACKS[squareIndex(r, c)];
+            if (c == 4 && r == (side == 0 ? 0 : 7)) {
+                if (canCastle(chess, r, c, r, 6)) targets |= squareBB(squareIndex(r, 6));
+                if (canCastle(chess, r, c, r, 2)) targets |= squareBB(squareIndex(r, 2));
+            }
+            break;
+        default: break;
+    }
+    return targets & ~chess->colorBB[side];
+}
+
+// packs the from/to pair with the flags the current position implies (queen for promotions)
+Move buildMove(const ChessState* chess, int from, int to) {
+    int r = from >> 3, c = from & 7, r2 = to >> 3, c2 = to & 7;
+    PieceType p = pieceAt(chess, r, c);
+    bool capture = pieceAt(chess, r2, c2) != EMPTY;
+    int flags = capture ? MOVE_CAPTURE : MOVE_QUIET;
+    if (p == WHITE_PAWN || p == BLACK_PAWN) {
+        if (r2 == 7 || r2 == 0) flags |= MOVE_PROMO_QUEEN;
+        else if (abs(r2 - r) == 2) flags = MOVE_DOUBLE_PUSH;
+        else if (c != c2 && !capture) flags = MOVE_EP_CAPTURE;
+    } else if ((p == WHITE_KING || p == BLACK_KING) && c == 4 && abs(c2 - c) == 2) {
+        flags = c2 == 6 ? MOVE_CASTLE_KING : MOVE_CASTLE_QUEEN;
+    }
+    return packMove(from, to, flags);
+}
+
+static inline bool moveLeavesKingSafe(ChessState* chess, Move mv) {
+    bool white = chess->whiteToMove;
+    UndoInfo u;
+    makeMove(chess, mv, &u);
+    bool legal = !isKingInCheck(chess, white);
+    unmakeMove(chess, mv, &u);
+    return legal;
+}
+
+// knight, bishop and rook versions of a queen promotion (buildMove and sideMove always pick the queen)
+static inline void addUnderPromotions(MoveList* list, Move queenPromo) {
+    for (int piece = 0; piece < 3 && list->count < 256; piece++)
+        list->moves[list->count++] = (Move)((queenPromo & ~(3 << 12)) | (piece << 12));
+}
+
+// pseudo-legal moves per piece, then make/test/unmake to drop the ones that leave the king in check
+void getAllMoves(ChessState* chess, MoveList* moves) {
+    moves->count = 0;
+    Bitboard own = chess->colorBB[chess->whiteToMove ? 0 : 1]; // own pieces only, no empty squares
+    while (own) {
+        int from = popLsb(&own);
+        Bitboard targets = pseudoTargets(chess, from >> 3, from & 7);
+        while (targets) {
+            Move mv = buildMove(chess, from, popLsb(&targets));
+            if (!moveLeavesKingSafe(chess, mv)) continue;
+            if (moves->count < 256) moves->moves[moves->count++] = mv;
+            if (isPromotionMove(mv)) addUnderPromotions(moves, mv); // same squares, so just as legal
+        }
+    }
+}
+
+/* The pseudo-legal moves of getAllMoves in its order, under-promotions included, with no legality test: what a
+   packed shard's move index counts in. The move a game went on with is among them, and no other one of them
+   leads to the same position, so there's no need for the test to tell them apart. */
+static void shardMoves(ChessState* chess, MoveList* moves) {
+    moves->count = 0;
+    Bitboard own = chess->colorBB[chess->whiteToMove ? 0 : 1];
+    while (own) {
+        int from = popLsb(&own);
+        Bitboard targets = pseudoTargets(chess, from >> 3, from & 7);
+        while (targets && moves->count < 256) {
+            Move mv = buildMove(chess, from, popLsb(&targets));
+            moves->moves[moves->count++] = mv;
+            if (isPromotionMove(mv)) addUnderPromotions(moves, mv);
+        }
+    }
+}
+
+/* Packed shards: training records squeezed for billions of positions. Consecutive records of a game are a move
+   apart, so all but a block's first record of each game are stored as the move's index in shardMoves' list
+   (one byte) and the score as its difference from the last one's negation; whatever that doesn't reproduce byte
+   for byte (a new game, a jump) is stored whole. The records are cut into blocks of SHARD_BLOCK_RECORDS, each
+   starting afresh and holding two streams, the moves and whole records in one, the scores as varints in the
+   other, each entropy-coded on its own with rANS under the block's byte frequencies. At the end an index of the
+   blocks' offsets and first records (for shardReaderSeek) and a footer. Little-endian throughout:
+     "CHSHARD1"
+     per block: varint records; per stream: varint raw bytes, varint coded bytes, 256 varint frequencies (when
+                raw bytes isn't 0), the coded bytes
+     per block: Uint64 offset, Uint64 first record
+     Uint64 index offset, Uint64 records, Uint32 blocks, "SIDX"
+   Decoding costs a pseudo-legal move generation and a make a record. */
+#define SHARD_INDEX_MAGIC "SIDX"
+#define SHARD_FOOTER_SIZE 24
+#define SHARD_BLOCK_RECORDS 8192
+#define SHARD_WHOLE 0 // a move byte: a whole record follows, less its score; otherwise the move's index + 1
+#define RANS_SCALE_BITS 12
+#define RANS_LOW (1u << 23) // the coder state stays in [RANS_LOW, RANS_LOW << 8)
+
+static size_t putVarint(Uint8* out, Uint64 value) {
+    size_t n = 0;
+    for (; value >= 0x80; value >>= 7) out[n++] = (Uint8)(value | 0x80);
+    out[n++] = (Uint8)value;
+    return n;
+}
+
+// false past the end or after ten bytes
+static bool getVarint(const Uint8** p, const Uint8* end, Uint64* value) {
+    Uint64 v = 0;
+    for (int shift = 0; *p < end && shift < 70; shift += 7) {
+        Uint8 byte = *(*p)++;
+        v |= (Uint64)(byte & 0x7F) << shift;
+        if (byte < 0x80) { *value = v; return true; }
+    }
+    return false;
+}
+
+static inline Uint32 zigzag(int v) { return v < 0 ? ~(Uint32)v * 2 + 1 : (Uint32)v * 2; }
+static inline int unzigzag(Uint32 v) { return v & 1 ? -(int)(v >> 1) - 1 : (int)(v >> 1); }
+
+// byte counts scaled to frequencies summing to 1 << RANS_SCALE_BITS, none that occurs brought down to 0
+static void ransFrequencies(const Uint8* data, size_t size, Uint32 freq[256]) {
+    Uint64 counts[256] = { 0 };
+    for (size_t i = 0; i < size; i++) counts[data[i]]++;
+    Uint32 total = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        freq[s] = counts[s] ? (Uint32)SDL_max(counts[s] * (1u << RANS_SCALE_BITS) / size, 1) : 0;
+        total += freq[s];
+        if (freq[s] > freq[largest]) largest = s;
+    }
+    if (total <= 1u << RANS_SCALE_BITS) freq[largest] += (1u << RANS_SCALE_BITS) - total;
+    else while (total > 1u << RANS_SCALE_BITS) // many rare bytes, each rounded up to 1: take it back off the common ones
+        for (int s = 0; s < 256 && total > 1u << RANS_SCALE_BITS; s++)
+            if (freq[s] > 1 && freq[s] * 16 >= freq[largest]) freq[s]--, total--;
+}
+
+/* data coded into out, which needs room for size + 4 bytes beyond what an incompressible stream takes (size * 2
+   + 4 covers anything); returns the coded length. rANS codes backwards, so the bytes are built from out's end
+   and moved down. */
+static size_t ransEncode(const Uint8* data, size_t size, const Uint32 freq[256], Uint8* out, size_t room) {
+    Uint32 start[256];
+    for (int s = 0, c = 0; s < 256; c += freq[s], s++) start[s] = (Uint32)c;
+    Uint8* p = out + room;
+    Uint32 x = RANS_LOW;
+    for (size_t i = size; i-- > 0;) {
+        Uint32 f = freq[data[i]];
+        Uint32 limit = ((RANS_LOW >> RANS_SCALE_BITS) << 8) * f;
+        while (x >= limit) { *--p = (Uint8)x; x >>= 8; }
+        x = ((x / f) << RANS_SCALE_BITS) + (x % f) + start[data[i]];
+    }
+    p -= 4;
+    for (int b = 0; b < 4; b++) p[b] = (Uint8)(x >> (8 * b));
+    size_t length = (size_t)(out + room - p);
+    SDL_memmove(out, p, length);
+    return length;
+}
+
+static bool ransDecode(const Uint8* in, size_t length, const Uint32 freq[256], Uint8* out, size_t size) {
+    Uint32 start[256];
+    Uint8 symbol[1 << RANS_SCALE_BITS];
+    for (int s = 0, c = 0; s < 256; c += freq[s], s++) {
+        start[s] = (Uint32)c;
+        SDL_memset(symbol + c, s, freq[s]);
+    }
+    if (length < 4) return false;
+    const Uint8* end = in + length;
+    Uint32 x = in[0] | (Uint32)in[1] << 8 | (Uint32)in[2] << 16 | (Uint32)in[3] << 24;
+    in += 4;
+    for (size_t i = 0; i < size; i++) {
+        Uint32 slot = x & ((1u << RANS_SCALE_BITS) - 1);
+        Uint8 s = symbol[slot];
+        out[i] = s;
+        x = freq[s] * (x >> RANS_SCALE_BITS) + slot - start[s];
+        while (x < RANS_LOW && in < end) x = x << 8 | *in++;
+    }
+    return in == end && x == RANS_LOW;
+}
+
+typedef struct {
+    Uint64 offset, first;
+} ShardBlockIndex;
+
+struct ShardWriter {
+    SDL_IOStream* out;
+    Uint64 offset, records;
+    ShardBlockIndex* index;
+    Uint32 blocks, indexCapacity;
+    Uint8* streams[2]; // the block's moves and scores, raw
+    size_t used[2];
+    Uint8* coded;
+    int blockRecords;
+    Uint8 last[TRAINING_RECORD_SIZE];
+    int lastScore;
+    ChessState chess; // the last record's position, as the reader will have it
+    bool failed;
+};
+
+#define SHARD_STREAM_MAX (SHARD_BLOCK_RECORDS * (TRAINING_RECORD_SIZE + 1)) // every record whole
+#define SHARD_CODED_MAX (SHARD_STREAM_MAX * 2 + 4 + 256 * 3 + 32)
+
+ShardWriter* shardWriterOpen(SDL_IOStream* out) {
+    ShardWriter* writer = SDL_calloc(1, sizeof(ShardWriter));
+    if (!writer) return NULL;
+    writer->out = out;
+    writer->streams[0] = SDL_malloc(SHARD_STREAM_MAX);
+    writer->streams[1] = SDL_malloc(SHARD_BLOCK_RECORDS * 5);
+    writer->coded = SDL_malloc(SHARD_CODED_MAX);
+    if (!writer->streams[0] || !writer->streams[1] || !writer->coded || SDL_WriteIO(out, SHARD_MAGIC, 8) != 8) {
+        shardWriterClose(writer);
+        return NULL;
+    }
+    writer->offset = 8;
+    return writer;
+}
+
+static bool shardWrite(ShardWriter* writer, const void* data, size_t size) {
+    if (writer->failed || SDL_WriteIO(writer->out, data, size) != size) {
+        writer->failed = true;
+        return false;
+    }
+    writer->offset += size;
+    return true;
+}
+
+static bool shardFlushBlock(ShardWriter* writer) {
+    if (writer->blockRecords == 0) return true;
+    if (writer->blocks == writer->indexCapacity) {
+        Uint32 capacity = writer->indexCapacity ? writer->indexCapacity * 2 : 64;
+        ShardBlockIndex* index = SDL_realloc(writer->index, capacity * sizeof(ShardBlockIndex));
+        if (!index) {
+            writer->failed = true;
+            return false;
+        }
+        writer->index = index;
+        writer->indexCapacity = capacity;
+    }
+    writer->index[writer->blocks++] = (ShardBlockIndex){ writer->offset, writer->records - (Uint64)writer->blockRecords };
+    Uint8* p = writer->coded;
+    p += putVarint(p, (Uint64)writer->blockRecords);
+    for (int s = 0; s < 2; s++) {
+        Uint32 freq[256];
+        size_t size = writer->used[s];
+        p += putVarint(p, size);
+        if (size == 0) { p += putVarint(p, 0); continue; }
+        ransFrequencies(writer->streams[s], size, freq);
+        Uint8 table[256 * 3];
+        size_t tableSize = 0;
+        for (int b = 0; b < 256; b++) tableSize += putVarint(table + tableSize, freq[b]);
+        Uint8* body = p + 10 + tableSize; // the coded length's varint goes in front, once it's known
+        size_t length = ransEncode(writer->streams[s], size, freq, body, (size_t)(writer->coded + SHARD_CODED_MAX - body));
+        p += putVarint(p, length);
+        SDL_memcpy(p, table, tableSize);
+        p += tableSize;
+        SDL_memmove(p, body, length);
+        p += length;
+    }
+    writer->blockRecords = 0;
+    writer->used[0] = writer->used[1] = 0;
+    return shardWrite(writer, writer->coded, (size_t)(p - writer->coded));
+}
+
+bool shardWriterAdd(ShardWriter* writer, const Uint8 record[TRAINING_RECORD_SIZE]) {
+    if (writer->failed) return false;
+    int score = (Sint16)(record[24] | record[25] << 8);
+    int moveIndex = -1;
+    if (writer->blockRecords > 0 && record[30] == writer->last[30]) { // the same game's next position?
+        MoveList moves;
+        shardMoves(&writer->chess, &moves);
+        for (int i = 0; i < SDL_min(moves.count, 255) && moveIndex < 0; i++) {
+            UndoInfo undo;
+            Uint8 packed[TRAINING_RECORD_SIZE];
+            makeMove(&writer->chess, moves.moves[i], &undo);
+            trainingRecordPack(&writer->chess, score, (Sint8)record[30], packed);
+            if (SDL_memcmp(packed, record, TRAINING_RECORD_SIZE) == 0) moveIndex = i;
+            else unmakeMove(&writer->chess, moves.moves[i], &undo);
+        }
+    }
+    Uint8* moveStream = writer->streams[0] + writer->used[0];
+    if (moveIndex >= 0) {
+        moveStream[0] = (Uint8)(moveIndex + 1);
+        writer->used[0]++;
+        writer->used[1] += putVarint(writer->streams[1] + writer->used[1], zigzag(score + writer->lastScore));
+    } else {
+        int ignoredScore, ignoredResult;
+        if (!trainingRecordUnpack(record, &writer->chess, &ignoredScore, &ignoredResult)) {
+            SDL_SetError("not a training record");
+            return false;
+        }
+        moveStream[0] = SHARD_WHOLE;
+        SDL_memcpy(moveStream + 1, record, 24); // all but the score, which goes with the others
+        SDL_memcpy(moveStream + 25, record + 26, TRAINING_RECORD_SIZE - 26);
+        writer->used[0] += TRAINING_RECORD_SIZE - 1;
+        writer->used[1] += putVarint(writer->streams[1] + writer->used[1], zigzag(score));
+    }
+    SDL_memcpy(writer->last, record, TRAINING_RECORD_SIZE);
+    writer->lastScore = score;
+    writer->records++;
+    if (++writer->blockRecords == SHARD_BLOCK_RECORDS) return shardFlushBlock(writer);
+    return true;
+}
+
+bool shardWriterClose(ShardWriter* writer) {
+    if (!writer) return false;
+    bool ok = !writer->failed && writer->out && shardFlushBlock(writer);
+    Uint64 indexOffset = writer->offset;
+    for (Uint32 b = 0; b < writer->blocks && ok; b++) {
+        Uint8 entry[16];
+        for (int i = 0; i < 8; i++) entry[i] = (Uint8)(writer->index[b].offset >> (8 * i)), entry[8 + i] = (Uint8)(writer->index[b].first >> (8 * i));
+        ok = shardWrite(writer, entry, sizeof(entry));
+    }
+    Uint8 footer[SHARD_FOOTER_SIZE];
+    for (int i = 0; i < 8; i++) footer[i] = (Uint8)(indexOffset >> (8 * i)), footer[8 + i] = (Uint8)(writer->records >> (8 * i));
+    for (int i = 0; i < 4; i++) footer[16 + i] = (Uint8)(writer->blocks >> (8 * i));
+    SDL_memcpy(footer + 20, SHARD_INDEX_MAGIC, 4);
+    ok = ok && shardWrite(writer, footer, sizeof(footer));
+    SDL_free(writer->streams[0]);
+    SDL_free(writer->streams[1]);
+    SDL_free(writer->coded);
+    SDL_free(writer->index);
+    SDL_free(writer);
+    return ok;
+}
+
+struct ShardReader {
+    const Uint8* data;
+    size_t size;
+    const Uint8* index;
+    Uint64 records;
+    Uint32 blocks, block; // the next block to decode
+    Uint8* streams[2];
+    const Uint8* next[2]; // where the block's next record is in each stream
+    const Uint8* end[2];
+    int left;             // records of the block not read yet
+    int lastScore;
+    Sint8 result;
+    ChessState chess;
+};
+
+static Uint64 readLe64(const Uint8* p) {
+    Uint64 v = 0;
+    for (int i = 7; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+ShardReader* shardReaderOpen(const void* data, size_t size) {
+    const Uint8* bytes = data;
+    if (size < 8 + SHARD_FOOTER_SIZE || SDL_memcmp(bytes, SHARD_MAGIC, 8) != 0
+        || SDL_memcmp(bytes + size - 4, SHARD_INDEX_MAGIC, 4) != 0) {
+        SDL_SetError("not a packed shard");
+        return NULL;
+    }
+    const Uint8* footer = bytes + size - SHARD_FOOTER_SIZE;
+    Uint64 indexOffset = readLe64(footer);
+    Uint32 blocks = footer[16] | (Uint32)footer[17] << 8 | (Uint32)footer[18] << 16 | (Uint32)footer[19] << 24;
+    if (indexOffset > size - SHARD_FOOTER_SIZE || (size - SHARD_FOOTER_SIZE - indexOffset) != (Uint64)blocks * 16) {
+        SDL_SetError("packed shard index damaged");
+        return NULL;
+    }
+    ShardReader* reader = SDL_calloc(1, sizeof(ShardReader));
+    if (!reader) return NULL;
+    reader->data = bytes;
+    reader->size = size;
+    reader->index = bytes + indexOffset;
+    reader->records = readLe64(footer + 8);
+    reader->blocks = blocks;
+    reader->streams[0] = SDL_malloc(SHARD_STREAM_MAX);
+    reader->streams[1] = SDL_malloc(SHARD_BLOCK_RECORDS * 5);
+    if (!reader->streams[0] || !reader->streams[1]) {
+        shardReaderClose(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+void shardReaderClose(ShardReader* reader) {
+    if (!reader) return;
+    SDL_free(reader->streams[0]);
+    SDL_free(reader->streams[1]);
+    SDL_free(reader);
+}
+
+Uint64 shardReaderRecords(const ShardReader* reader) { return reader->records; }
+
+// the next block's streams decoded; false for a damaged one
+static bool shardDecodeBlock(ShardReader* reader) {
+    Uint64 offset = readLe64(reader->index + (size_t)reader->block * 16);
+    const Uint8* end = reader->index;
+    if (offset >= (Uint64)(end - reader->data)) return false;
+    const Uint8* p = reader->data + offset;
+    Uint64 records;
+    if (!getVarint(&p, end, &records) || records == 0 || records > SHARD_BLOCK_RECORDS) return false;
+    static const size_t ROOM[2] = { SHARD_STREAM_MAX, SHARD_BLOCK_RECORDS * 5 };
+    for (int s = 0; s < 2; s++) {
+        Uint64 size, length;
+        if (!getVarint(&p, end, &size) || !getVarint(&p, end, &length) || size > ROOM[s]) return false;
+        reader->next[s] = reader->streams[s];
+        reader->end[s] = reader->streams[s] + size;
+        if (size == 0) continue;
+        Uint32 freq[256], total = 0;
+        for (int b = 0; b < 256; b++) {
+            Uint64 f;
+            if (!getVarint(&p, end, &f) || f > 1u << RANS_SCALE_BITS) return false;
+            freq[b] = (Uint32)f;
+            total += freq[b];
+        }
+        if (total != 1u << RANS_SCALE_BITS || length > (Uint64)(end - p)) return false;
+        if (!ransDecode(p, (size_t)length, freq, reader->streams[s], (size_t)size)) return false;
+        p += length;
+    }
+    reader->left = (int)records;
+    reader->block++;
+    return true;
+}
+
+bool shardReaderSeek(ShardReader* reader, Uint64 record) {
+    if (record >= reader->records) {
+        reader->block = reader->blocks;
+        reader->left = 0;
+        return record == reader->records;
+    }
+    Uint32 low = 0, high = reader->blocks - 1; // the last block starting at or before the record
+    while (low < high) {
+        Uint32 mid = low + (high - low + 1) / 2;
+        if (readLe64(reader->index + (size_t)mid * 16 + 8) <= record) low = mid;
+        else high = mid - 1;
+    }
+    reader->block = low;
+    reader->left = 0;
+    Uint64 skip = record - readLe64(reader->index + (size_t)low * 16 + 8);
+    Uint8 discard[TRAINING_RECORD_SIZE];
+    for (Uint64 i = 0; i < skip; i++)
+        if (shardReaderRead(reader, discard, 1) != 1) return false;
+    return true;
+}
+
+int shardReaderRead(ShardReader* reader, Uint8* records, int max) {
+    int n = 0;
+    for (; n < max; n++) {
+        if (reader->left == 0) {
+            if (reader->block == reader->blocks) break;
+            if (!shardDecodeBlock(reader)) { SDL_SetError("packed shard block %u damaged", reader->block); return -1; }
+        }
+        Uint8* record = records + (size_t)n * TRAINING_RECORD_SIZE;
+        Uint64 scoreCode;
+        if (reader->next[0] == reader->end[0] || !getVarint(&reader->next[1], reader->end[1], &scoreCode)) return -1;
+        int moveByte = *reader->next[0]++;
+        int score = unzigzag((Uint32)scoreCode);
+        if (moveByte == SHARD_WHOLE) {
+            if (reader->end[0] - reader->next[0] < TRAINING_RECORD_SIZE - 2) return -1;
+            SDL_memcpy(record, reader->next[0], 24);
+            record[24] = (Uint8)score; record[25] = (Uint8)((Uint16)score >> 8);
+            SDL_memcpy(record + 26, reader->next[0] + 24, TRAINING_RECORD_SIZE - 26);
+            reader->next[0] += TRAINING_RECORD_SIZE - 2;
+            int ignoredScore, result;
+            if (!trainingRecordUnpack(record, &reader->chess, &ignoredScore, &result)) return -1;
+            reader->result = (Sint8)result;
+        } else {
+            MoveList moves;
+            shardMoves(&reader->chess, &moves);
+            if (moveByte > moves.count) return -1;
+            makeMove(&reader->chess, moves.moves[moveByte - 1], NULL);
+            score -= reader->lastScore;
+            trainingRecordPack(&reader->chess, score, reader->result, record);
+        }
+        reader->lastScore = score;
+        reader->left--;
+    }
+    return n;
+}
+
+/* Position filters are split-block Bloom filters: a key picks one 64-byte block, a cache line, and sets a bit in
+   each of its eight words, so an add is at most eight atomic ORs to one cache line. A key is new when
+   one of the ORs changes a bit; two threads adding the same key at once may both be told it's new, the cost of
+   taking no lock. */
+#define FILTER_BLOCK_WORDS 8
+
+struct PositionFilter {
+    Uint64* words;
+    Uint64 blockMask;
+};
+
+// multipliers that spread a key's bits over each word's six-bit position (odd, from the splitmix/xxhash families)
+static const Uint64 FILTER_SALTS[FILTER_BLOCK_WORDS] = {
+    0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull, 0x94D049BB133111EBull, 0xC2B2AE3D27D4EB4Full,
+    0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull, 0xD6E8FEB86659FD93ull, 0xFF51AFD7ED558CCDull,
+};
+
+PositionFilter* positionFilterCreate(size_t bytes) {
+    size_t blocks = 1;
+    while (blocks * 2 * FILTER_BLOCK_WORDS * sizeof(Uint64) <= bytes) blocks *= 2;
+    PositionFilter* filter = SDL_malloc(sizeof(PositionFilter));
+    Uint64* words = SDL_aligned_alloc(64, blocks * FILTER_BLOCK_WORDS * sizeof(Uint64));
+    if (!filter || !words) {
+        SDL_free(filter);
+        SDL_aligned_free(words);
+        return NULL;
+    }
+    SDL_memset(words, 0, blocks * FILTER_BLOCK_WORDS * sizeof(Uint64));
+    filter->words = words;
+    filter->blockMask = blocks - 1;
+    return filter;
+}
+
+void positionFilterDestroy(PositionFilter* filter) {
+    if (!filter) return;
+    SDL_aligned_free(filter->words);
+    SDL_free(filter);
+}
+
+bool positionFilterAdd(PositionFilter* filter, Uint64 key) {
+    // the block from the key's low bits, like the hash table's bucket; the bits from its high ones, mixed
+    Uint64* block = filter->words + (key & filter->blockMask) * FILTER_BLOCK_WORDS;
+    Uint64 fresh = 0;
+    for (int i = 0; i < FILTER_BLOCK_WORDS; i++) {
+        Uint64 bit = 1ull << ((key * FILTER_SALTS[i]) >> 58);
+        if (!(__atomic_load_n(&block[i], __ATOMIC_RELAXED) & bit)) // set already: no write, the line stays shared
+            fresh |= ~__atomic_fetch_or(&block[i], bit, __ATOMIC_RELAXED) & bit;
+    }
+    return fresh != 0;
+}
+
+size_t positionFilterBytes(const PositionFilter* filter) {
+    return (size_t)(filter->blockMask + 1) * FILTER_BLOCK_WORDS * sizeof(Uint64);
+}
+
+// exact for a random key: the mean over the blocks of the chance that all eight of its bits are set already
+double positionFilterFalsePositiveRate(const PositionFilter* filter) {
+    double sum = 0;
+    for (Uint64 b = 0; b <= filter->blockMask; b++) {
+        double p = 1;
+        for (int i = 0; i < FILTER_BLOCK_WORDS && p > 0; i++)
+            p *= __builtin_popcountll(__atomic_load_n(&filter->words[b * FILTER_BLOCK_WORDS + i], __ATOMIC_RELAXED)) / 64.0;
+        sum += p;
+    }
+    return sum / (double)(filter->blockMask + 1);
+}
+
+/* Every square one side attacks, own pieces included, from one pass over its pieces, and how many squares the
+   pieces other than pawns attack between them (the evaluation's mobility). occupied is the board the sliders see:
+   legalMoveCount takes the king off it, so a king stepping back along a checking line is seen to stay in check.
+   The evaluation's mobility and centre terms and the legal king moves read this instead of each casting their own
+   attacks. */
+typedef struct {
+    Bitboard attacked[2];
+    int pieceMobility[2];
+} AttackMap;
+
+FORCE_INLINE void addSideAttacks(const ChessState* chess, AttackMap* map, int side, Bitboard occupied) {
+    const Bitboard* bb = chess->pieceBB;
+    Bitboard pawns = bb[SIDE_PIECE(side, WHITE_PAWN)], notFileA = ~fileBB(0), notFileH = ~fileBB(7);
+    Bitboard attacked = side == 0 ? ((pawns & notFileA) << 7) | ((pawns & notFileH) << 9)
+                                  : ((pawns & notFileA) >> 9) | ((pawns & notFileH) >> 7);
+    int mobility = 0;
+    for (Bitboard b = bb[SIDE_PIECE(side, WHITE_KNIGHT)]; b;) { Bitboard a = KNIGHT_ATTACKS[popLsb(&b)]; attacked |= a; mobility += popcount64(a); }
+    for (Bitboard b = bb[SIDE_PIECE(side, WHITE_BISHOP)]; b;) { Bitboard a = bishopAttacks(popLsb(&b), occupied); attacked |= a; mobility += popcount64(a); }
+    for (Bitboard b = bb[SIDE_PIECE(side, WHITE_ROOK)]; b;) { Bitboard a = rookAttacks(popLsb(&b), occupied); attacked |= a; mobility += popcount64(a); }
+    for (Bitboard b = bb[SIDE_PIECE(side, WHITE_QUEEN)]; b;) { Bitboard a = queenAttacks(popLsb(&b), occupied); attacked |= a; mobility += popcount64(a); }
+    for (Bitboard b = bb[SIDE_PIECE(side, WHITE_KING)]; b;) { Bitboard a = KING_ATTACKS[popLsb(&b)]; attacked |= a; mobility += popcount64(a); }
+    map->attacked[side] = attacked;
+    map->pieceMobility[side] = mobility;
+}
+
+/* The legal moves of the position counted, up to limit, with no list written. A piece not pinned to its king can
+   make any of its pseudo-legal moves out of check, and in a single check those that take or block the checker, so
+   its moves are counted off the target bitboard, and the king's steps off the other side's attack map (castling
+   is checked square by square by canCastle already); only pinned pieces and en passant (which can uncover the
+   king along the rank) get the make/test/unmake of getAllMoves. The king goes first: in check its steps are the
+   likeliest way out, and hasLegalMove stops at the first. */
+static int legalMoveCount(ChessState* chess, int limit) {
+    int side = chess->whiteToMove ? 0 : 1, ksq = chess->kingSquare[side], count = 0;
+    if (ksq < 0) { // no king to be pinned to or checked: every move getAllMoves gives
+        MoveList moves;
+        getAllMoves(chess, &moves);
+        return moves.count;
+    }
+    Bitboard own = chess->colorBB[side], enemy = chess->colorBB[side ^ 1];
+    AttackMap map;
+    addSideAttacks(chess, &map, side ^ 1, chess->occupied & ~squareBB(ksq));
+    Bitboard kingTargets = pseudoTargets(chess, ksq >> 3, ksq & 7);
+    count += popcount64(kingTargets & (~KING_ATTACKS[ksq] | ~map.attacked[side ^ 1]));
+    Bitboard checkers = attackersTo(chess, ksq, chess->occupied) & enemy;
+    if (count >= limit || popcount64(checkers) > 1) return count; // double check: only the king can move
+    Bitboard allowed = checkers ? checkers | BETWEEN[ksq][lsbIndex(checkers)] : ~(Bitboard)0;
+    const Bitboard* bb = chess->pieceBB;
+    Bitboard queens = bb[SIDE_PIECE(side ^ 1, WHITE_QUEEN)];
+    Bitboard snipers = (rookAttacks(ksq, 0) & (bb[SIDE_PIECE(side ^ 1, WHITE_ROOK)] | queens))
+                     | (bishopAttacks(ksq, 0) & (bb[SIDE_PIECE(side ^ 1, WHITE_BISHOP)] | queens));
+    Bitboard pinned = 0;
+    while (snipers) {
+        Bitboard between = BETWEEN[ksq][popLsb(&snipers)] & chess->occupied;
+        if (popcount64(between) == 1) pinned |= between & own;
+    }
+    Bitboard epSquare = chess->enPassantCol >= 0 ? squareBB(squareIndex(side == 0 ? 5 : 2, chess->enPassantCol)) : 0;
+    Bitboard lastRank = side == 0 ? 0xFFULL << 56 : 0xFFULL;
+    Bitboard pieces = own & ~squareBB(ksq);
+    while (pieces && count < limit) {
+        int from = popLsb(&pieces);
+        bool pawn = chess->board[from] == SIDE_PIECE(side, WHITE_PAWN);
+        Bitboard targets = pseudoTargets(chess, from >> 3, from & 7);
+        Bitboard tested = (pinned & squareBB(from)) ? targets : pawn ? targets & epSquare : 0;
+        targets &= allowed & ~tested;
+        count += popcount64(targets) + (pawn ? 3 * popcount64(targets & lastRank) : 0); // a promotion is four moves
+        while (tested) {
+            Move mv = buildMove(chess, from, popLsb(&tested));
+            if (moveLeavesKingSafe(chess, mv)) count += isPromotionMove(mv) ? 4 : 1;
+        }
+    }
+    return count;
+}
+
+int countLegalMoves(ChessState* chess) { return legalMoveCount(chess, SDL_MAX_SINT32); }
+
+bool hasLegalMove(ChessState* chess) { return legalMoveCount(chess, 1) > 0; }
+
+// check and the end of the game, for the side to move: one king scan and one hasLegalMove
+GameStatus getGameStatus(ChessState* chess) {
+    bool inCheck = isKingInCheck(chess, chess->whiteToMove);
+    if (hasLegalMove(chess)) return inCheck ? GAME_CHECK : GAME_ONGOING;
+    return inCheck ? GAME_CHECKMATE : GAME_STALEMATE;
+}
+
+/* What givesCheck needs to know about the side to move's moves, worked out once a node: the squares each kind of
+   piece would check the other king from, the pieces that uncover a check by stepping off the line between one of
+   their own sliders and that king, and the pieces pinned to their own king (for surelyLegal). */
+typedef struct {
+    Bitboard checkSquares[WHITE_KING + 1]; // by kind; none for the king, which can only uncover a check
+    Bitboard discoverers;
+    Bitboard pinned;
+    int theirKing;                         // -1 with no king on the board
+} CheckInfo;
+
+// side's pieces standing alone between a slider of `snipersSide` and the king on ksq
+static Bitboard lineBlockers(const ChessState* chess, int ksq, int snipersSide, int side) {
+    const Bitboard* bb = chess->pieceBB;
+    Bitboard queens = bb[SIDE_PIECE(snipersSide, WHITE_QUEEN)];
+    Bitboard snipers = (rookAttacks(ksq, 0) & (bb[SIDE_PIECE(snipersSide, WHITE_ROOK)] | queens))
+                     | (bishopAttacks(ksq, 0) & (bb[SIDE_PIECE(snipersSide, WHITE_BISHOP)] | queens));
+    Bitboard blockers = 0;
+    while (snipers) {
+        Bitboard between = BETWEEN[ksq][popLsb(&snipers)] & chess->occupied;
+        if (popcount64(between) == 1) blockers |= between & chess->colorBB[side];
+    }
+    return blockers;
+}
+
+static void initCheckInfo(const ChessState* chess, CheckInfo* info) {
+    int side = chess->whiteToMove ? 0 : 1, ksq = chess->kingSquare[side ^ 1];
+    info->theirKing = ksq;
+    info->pinned = chess->kingSquare[side] >= 0 ? lineBlockers(chess, chess->kingSquare[side], side ^ 1, side) : 0;
+    if (ksq < 0) return;
+    Bitboard bishop = bishopAttacks(ksq, chess->occupied), rook = rookAttacks(ksq, chess->occupied);
+    info->checkSquares[EMPTY] = 0;
+    info->checkSquares[WHITE_PAWN] = PAWN_ATTACKS[side ^ 1][ksq];
+    info->checkSquares[WHITE_KNIGHT] = KNIGHT_ATTACKS[ksq];
+    info->checkSquares[WHITE_BISHOP] = bishop;
+    info->checkSquares[WHITE_ROOK] = rook;
+    info->checkSquares[WHITE_QUEEN] = bishop | rook;
+    info->checkSquares[WHITE_KING] = 0;
+    info->discoverers = lineBlockers(chess, ksq, side, side);
+}
+
+static inline bool aligned(int a, int b, int c) { // on one rank, file or diagonal
+    return (BETWEEN[a][c] & squareBB(b)) || (BETWEEN[a][b] & squareBB(c)) || (BETWEEN[b][c] & squareBB(a));
+}
+
+/* Whether a pseudo-legal move of the side to move checks the other king, without making it: a direct check is a
+   mask test, a discovered one a second. Promotions, castling and en passant, which change more than one square,
+   look at the sliders again on the occupancy the move leaves. */
+static bool givesCheck(const ChessState* chess, const CheckInfo* info, Move move) {
+    int ksq = info->theirKing;
+    if (ksq < 0) return false;
+    int from = moveFrom(move), to = moveTo(move), side = chess->whiteToMove ? 0 : 1;
+    PieceType kind = isPromotionMove(move) ? EMPTY : pieceKind(chess->board[from]); // a promoting pawn is looked at below
+    if (info->checkSquares[kind] & squareBB(to)) return true;
+    if ((info->discoverers & squareBB(from)) && !aligned(from, to, ksq)) return true;
+    if (!isPromotionMove(move) && !isCastlingMove(move) && !isEnPassantMove(move)) return false;
+    Bitboard occ = (chess->occupied & ~squareBB(from)) | squareBB(to);
+    const Bitboard* bb = chess->pieceBB;
+    Bitboard rooks = bb[SIDE_PIECE(side, WHITE_ROOK)] | bb[SIDE_PIECE(side, WHITE_QUEEN)];
+    Bitboard bishops = bb[SIDE_PIECE(side, WHITE_BISHOP)] | bb[SIDE_PIECE(side, WHITE_QUEEN)];
+    if (isPromotionMove(move)) {
+        switch (promotionPiece(move, true)) {
+            case WHITE_KNIGHT: return (KNIGHT_ATTACKS[to] & squareBB(ksq)) != 0;
+            case WHITE_BISHOP: bishops |= squareBB(to); break;
+            case WHITE_ROOK: rooks |= squareBB(to); break;
+            default: bishops |= squareBB(to); rooks |= squareBB(to); break;
+        }
+    } else if (isCastlingMove(move)) {
+        int rookFrom = to > from ? from + 3 : from - 4, rookTo = to > from ? from + 1 : from - 1;
+        occ = (occ & ~squareBB(rookFrom)) | squareBB(rookTo);
+        rooks = (rooks & ~squareBB(rookFrom)) | squareBB(rookTo);
+    } else {
+        occ &= ~squareBB(squareIndex(from >> 3, to & 7)); // the pawn taken en passant
+    }
+    return ((rookAttacks(ksq, occ) & rooks) | (bishopAttacks(ksq, occ) & bishops)) != 0;
+}
+
+// legal without making it, out of check: not the king's, not a pinned piece's and not en passant
+static inline bool surelyLegal(const ChessState* chess, const CheckInfo* info, Move move) {
+    int from = moveFrom(move);
+    return !(info->pinned & squareBB(from)) && pieceKind(chess->board[from]) != WHITE_KING && !isEnPassantMove(move);
+}
+
+/* The staged generators below are written once for a side given as a constant, and GENERATE_FOR_SIDE makes a
+   white and a black copy for each, so every colour test in them (pawn direction and ranks, castling squares, which
+   bitboards are whose) is settled by the compiler and the loops over the pieces carry none. pseudoTargets and
+   getAllMoves stay as the plain reference they're checked against: perft, move vetting, the GUI. */
+// canCastle for the king on its home square, with the side known
+FORCE_INLINE bool castlingOpen(const ChessState* chess, const int side, const bool kingside) {
+    const int home = side == 0 ? 4 : 60;
+    if (!(chess->castlingRights & castleRight(side, kingside)) || chess->board[kingside ? home + 3 : home - 4] != SIDE_PIECE(side, WHITE_ROOK)) return false;
+    Bitboard between = kingside ? squareBB(home + 1) | squareBB(home + 2) : squareBB(home - 1) | squareBB(home - 2) | squareBB(home - 3);
+    if (chess->occupied & between) return false;
+    for (int sq = home, step = kingside ? 1 : -1; sq != home + 3 * step; sq += step) // the king's path, its square included
+        if (squareAttackedBy(chess, sq, side ^ 1)) return false;
+    return true;
+}
+
+// pseudoTargets for a piece of the side to move, its kind (the white PieceType) known
+FORCE_INLINE Bitboard sideTargets(const ChessState* chess, int from, PieceType kind, const int side) {
+    Bitboard targets = 0;
+    switch (kind) {
+        case WHITE_PAWN: {
+            const int push = side == 0 ? 8 : -8;
+            int to = from + push;
+            if (chess->board[to] == EMPTY) {
+                targets |= squareBB(to);
+                if ((from >> 3) == (side == 0 ? 1 : 6) && chess->board[to + push] == EMPTY) targets |= squareBB(to + push);
+            }
+            targets |= PAWN_ATTACKS[side][from] & chess->colorBB[side ^ 1];
+            if (chess->enPassantCol >= 0 && (from >> 3) == (side == 0 ? 4 : 3))
+                targets |= PAWN_ATTACKS[side][from] & squareBB(squareIndex(to >> 3, chess->enPassantCol));
+            break;
+        }
+        case WHITE_KNIGHT: targets = KNIGHT_ATTACKS[from]; break;
+        case WHITE_BISHOP: targets = bishopAttacks(from, chess->occupied); break;
+        case WHITE_ROOK: targets = rookAttacks(from, chess->occupied); break;
+        case WHITE_QUEEN: targets = queenAttacks(from, chess->occupied); break;
+        default:
+            targets = KING_ATTACKS[from];
+            if (from == (side == 0 ? 4 : 60)) {
+                if (castlingOpen(chess, side, true)) targets |= squareBB(from + 2);
+                if (castlingOpen(chess, side, false)) targets |= squareBB(from - 2);
+            }
+            break;
+    }
+    return targets & ~chess->colorBB[side];
+}
+
+// buildMove with the piece's kind and side known
+FORCE_INLINE Move sideMove(const ChessState* chess, int from, int to, PieceType kind, const int side) {
+    bool capture = chess->board[to] != EMPTY;
+    int flags = capture ? MOVE_CAPTURE : MOVE_QUIET;
+    if (kind == WHITE_PAWN) {
+        if ((to >> 3) == (side == 0 ? 7 : 0)) flags |= MOVE_PROMO_QUEEN;
+        else if (to - from == (side == 0 ? 16 : -16)) flags = MOVE_DOUBLE_PUSH;
+        else if (((from ^ to) & 7) && !capture) flags = MOVE_EP_CAPTURE;
+    } else if (kind == WHITE_KING && (from & 7) == 4 && abs(to - from) == 2) {
+        flags = to > from ? MOVE_CASTLE_KING : MOVE_CASTLE_QUEEN;
+    }
+    return packMove(from, to, flags);
+}
+
+// pseudo-legal moves of `pieces` (side to move) landing on `targets`, in square order like the reference
+FORCE_INLINE void addSideMoves(const ChessState* chess, MoveList* list, Bitboard pieces, Bitboard targets, const int side) {
+    while (pieces) {
+        int from = popLsb(&pieces);
+        PieceType kind = pieceKind(chess->board[from]);
+        Bitboard t = sideTargets(chess, from, kind, side) & targets;
+        while (t && list->count < 256) list->moves[list->count++] = sideMove(chess, from, popLsb(&t), kind, side);
+    }
+}
+
+// captures plus pawn pushes that promote (the "tactical" moves)
+FORCE_INLINE void generateCapturesFor(const ChessState* chess, MoveList* list, const int side) {
+    list->count = 0;
+    addSideMoves(chess, list, chess->colorBB[side], chess->colorBB[side ^ 1], side);
+    addSideMoves(chess, list, chess->pieceBB[SIDE_PIECE(side, WHITE_PAWN)], (side == 0 ? 0xFFULL << 56 : 0xFFULL) & ~chess->occupied, side);
+}
+
+// quiet moves: everything to an empty square except promoting pushes (castling included)
+FORCE_INLINE void generateQuietsFor(const ChessState* chess, MoveList* list, const int side) {
+    Bitboard pawns = chess->pieceBB[SIDE_PIECE(side, WHITE_PAWN)];
+    list->count = 0;
+    addSideMoves(chess, list, chess->colorBB[side] & ~pawns, ~chess->occupied, side);
+    addSideMoves(chess, list, pawns, ~chess->occupied & ~(side == 0 ? 0xFFULL << 56 : 0xFFULL), side);
+}
+
+// knight, bishop and rook promotions (pushes and captures); kept out of the other stages so they pay nothing for them
+FORCE_INLINE void generateUnderPromotionsFor(const ChessState* chess, MoveList* list, const int side) {
+    Bitboard pawns = chess->pieceBB[SIDE_PIECE(side, WHITE_PAWN)] & (side == 0 ? 0xFFULL << 48 : 0xFFULL << 8);
+    list->count = 0;
+    while (pawns) {
+        int from = popLsb(&pawns);
+        Bitboard t = sideTargets(chess, from, WHITE_PAWN, side);
+        while (t) addUnderPromotions(list, sideMove(chess, from, popLsb(&t), WHITE_PAWN, side));
+    }
+}
+
+// side to move is in check: king steps, plus (single check only) captures of the checker or blocks on its ray
+FORCE_INLINE void generateEvasionsFor(const ChessState* chess, MoveList* list, const int side) {
+    int ksq = chess->kingSquare[side];
+    list->count = 0;
+    addSideMoves(chess, list, squareBB(ksq), ~chess->colorBB[side], side);
+    Bitboard checkers = attackersTo(chess, ksq, chess->occupied) & chess->colorBB[side ^ 1];
+    if (popcount64(checkers) != 1) return; // double check, only the king can move
+    int csq = lsbIndex(checkers);
+    addSideMoves(chess, list, chess->colorBB[side] & ~squareBB(ksq), checkers | BETWEEN[ksq][csq], side);
+    if (chess->enPassantCol >= 0 && csq == squareIndex(side == 0 ? 4 : 3, chess->enPassantCol)) // the pawn that just pushed, taken en passant
+        addSideMoves(chess, list, chess->pieceBB[SIDE_PIECE(side, WHITE_PAWN)], squareBB(squareIndex(side == 0 ? 5 : 2, chess->enPassantCol)), side);
+    for (int i = 0, n = list->count; i < n; i++) // rare enough here to append in place
+        if (isPromotionMove(list->moves[i])) addUnderPromotions(list, list->moves[i]);
+}
+
+// the white and black copies of a generator, and the entry point that picks one per call rather than per piece
+#define GENERATE_FOR_SIDE(name)                                                                        \
+    static void name##White(const ChessState* chess, MoveList* list) { name##For(chess, list, 0); }   \
+    static void name##Black(const ChessState* chess, MoveList* list) { name##For(chess, list, 1); }   \
+    void name(const ChessState* chess, MoveList* list) {                                               \
+        if (chess->whiteToMove) name##White(chess, list);                                              \
+        else name##Black(chess, list);                                                                 \
+    }
+
+GENERATE_FOR_SIDE(generateCaptures)
+GENERATE_FOR_SIDE(generateQuiets)
+GENERATE_FOR_SIDE(generateUnderPromotions)
+GENERATE_FOR_SIDE(generateEvasions)
+
+// true when m could be played here (right piece on from-square, reachable target, same flags); used to vet stored moves
+static bool isPseudoLegalMove(const ChessState* chess, Move m) {
+    if (m == MOVE_NONE) return false;
+    int from = moveFrom(m), to = moveTo(m);
+    PieceType p = chess->board[from];
+    if (p == EMPTY || isWhite(p) != chess->whiteToMove) return false;
+    if (!(pseudoTargets(chess, from >> 3, from & 7) & squareBB(to))) return false;
+    Move expected = buildMove(chess, from, to);
+    if (isPromotionMove(expected)) expected = (Move)((expected & ~(3 << 12)) | (m & (3 << 12))); // any promotion piece
+    return expected == m;
+}
+
+// material a tactical move wins outright (PIECE_VALUES units): the victim, plus what a promotion adds
+static inline int captureValue(const ChessState* chess, Move m) {
+    int to = moveTo(m);
+    int value = isEnPassantMove(m) ? PIECE_VALUES[WHITE_PAWN] : PIECE_VALUES[chess->board[to]];
+    if (isPromotionMove(m)) value += PIECE_VALUES[promotionPiece(m, true)] - PIECE_VALUES[WHITE_PAWN];
+    return value;
+}
+
+// most valuable victim first, cheapest attacker breaking ties
+static inline int mvvLvaScore(const ChessState* chess, Move m) {
+    int from = moveFrom(m);
+    return captureValue(chess, m) * 16 - PIECE_VALUES[chess->board[from]];
+}
+
+/* Static exchange evaluation: what a capture wins once every capture and recapture on its square has been
+   played out, cheapest attacker first, each side free to stop when going on would lose more. Pieces are taken
+   off a copy of the occupancy, so sliders lined up behind one another join in, and nothing is made or unmade.
+   Pins are ignored. Centipawns, on evaluatePosition's material scale. */
+#define SEE_KING_VALUE 10000 // the king can only take last: anything after it costs the game
+
+static inline int seeValue(PieceType p) {
+    return pieceKind(p) == WHITE_KING ? SEE_KING_VALUE : PIECE_VALUES[p] * 100;
+}
+
+static int staticExchange(const ChessState* chess, Move m) {
+    int from = moveFrom(m), to = moveTo(m);
+    PieceType moving = chess->board[from];
+    int gain[32];
+    int d = 0;
+    gain[0] = captureValue(chess, m) * 100;
+    int onSquare = seeValue(isPromotionMove(m) ? promotionPiece(m, isWhite(moving)) : moving);
+    Bitboard occ = chess->occupied ^ squareBB(from);
+    if (isEnPassantMove(m)) occ ^= squareBB(isWhite(moving) ? to - 8 : to + 8);
+    int side = pieceColor(moving) ^ 1;
+    for (;;) {
+        Bitboard attackers = attackersTo(chess, to, occ) & occ & chess->colorBB[side];
+        if (!attackers || d == 31) break;
+        PieceType first = side == 0 ? WHITE_PAWN : BLACK_PAWN, p = first;
+        while (!(attackers & chess->pieceBB[p])) p++; // cheapest first, the king last
+        d++;
+        gain[d] = onSquare - gain[d - 1]; // side's score if it takes and that is the end of it
+        onSquare = seeValue(p);
+        occ ^= squareBB(lsbIndex(attackers & chess->pieceBB[p]));
+        side ^= 1;
+    }
+    // back up: each capture is only made if it beats stopping before it
+    for (; d > 0; d--) gain[d - 1] = -SDL_max(-gain[d - 1], gain[d]);
+    return gain[0];
+}
+
+// a capture that gives away more than it takes; the cheap test first, as most captures take something bigger
+static inline bool isLosingCapture(const ChessState* chess, Move m) {
+    if (!isCaptureMove(m)) return false;
+    int from = moveFrom(m);
+    if (captureValue(chess, m) * 100 >= seeValue(chess->board[from])) return false;
+    return staticExchange(chess, m) < 0;
+}
+
+/* Staged move picker: hash move, then captures (queen promotions included) by MVV-LVA, then killers and the
+   counter-move, then quiets by history and continuation history score, then the captures SEE says lose material, then underpromotions (or hash move then
+   evasions when in check). Each stage is only generated once the previous one is used up, so a cutoff early on means the
+   quiet moves are never generated. Moves come out pseudo-legal; the caller does make/test/unmake. */
+typedef enum {
+    STAGE_HASH_MOVE,
+    STAGE_GEN_CAPTURES, STAGE_CAPTURES,
+    STAGE_KILLERS,
+    STAGE_GEN_QUIETS, STAGE_QUIETS,
+    STAGE_BAD_CAPTURES,
+    STAGE_GEN_UNDERPROMOTIONS, STAGE_UNDERPROMOTIONS,
+    STAGE_GEN_EVASIONS, STAGE_EVASIONS,
+    STAGE_DONE
+} MoveStage;
+
+typedef struct {
+    ChessState* chess;
+    MoveList list;
+    int scores[256];             // ordering score per list entry, picked best-first without a full sort
+    const int (*history)[64];    // [from][to] history for the side to move, NULL = no history ordering
+    const Sint16* continuation[2]; // by the moved piece and to square after the last move and the one before, or NULL
+    int index;
+    MoveStage stage;
+    Move hashMove;
+    Move killers[3];             // the ply's two killers, then the counter-move to the last move
+    int killerIndex;
+    Move badCaptures[64];        // losing captures held back from the capture stage, in the order they came up
+    int badCount, badIndex;
+    int ready;                   // list entries before this are already in picking order (peekMoves)
+} MovePicker;
+
+void initMovePicker(MovePicker* mp, ChessState* chess, Move hashMove, const Move* killers, Move counterMove,
+                    const int (*history)[64], const Sint16* const* continuation) {
+    mp->chess = chess;
+    mp->history = history;
+    mp->continuation[0] = continuation ? continuation[0] : NULL;
+    mp->continuation[1] = continuation ? continuation[1] : NULL;
+    mp->list.count = 0;
+    mp->index = 0;
+    mp->killerIndex = 0;
+    mp->badCount = mp->badIndex = 0;
+    mp->ready = 0;
+    mp->hashMove = isPseudoLegalMove(chess, hashMove) ? hashMove : MOVE_NONE;
+    mp->killers[0] = killers ? killers[0] : MOVE_NONE;
+    mp->killers[1] = killers ? killers[1] : MOVE_NONE;
+    mp->killers[2] = counterMove;
+    mp->stage = STAGE_HASH_MOVE;
+}
+
+static inline bool isQuietMove(Move m) { return !isCaptureMove(m) && !isPromotionMove(m); }
+
+// a move's index into the continuation history and the counter-moves: the piece moved, then its to square
+static inline int pieceToIndex(int piece, int to) { return packedPiece(piece) * 64 + to; }
+
+// tactical moves above every quiet one, quiets by history and by how well they followed the last two moves
+static void scoreMoves(MovePicker* mp) {
+    for (int i = 0; i < mp->list.count; i++) {
+        Move m = mp->list.moves[i];
+        if (!isQuietMove(m)) { mp->scores[i] = (1 << 20) + mvvLvaScore(mp->chess, m); continue; }
+        int score = mp->history ? mp->history[moveFrom(m)][moveTo(m)] : 0;
+        int index = pieceToIndex(mp->chess->board[moveFrom(m)], moveTo(m));
+        if (mp->continuation[0]) score += mp->continuation[0][index];
+        if (mp->continuation[1]) score += mp->continuation[1][index];
+        mp->scores[i] = score;
+    }
+}
+
+// lazy selection sort: swap the best remaining move to the front and hand it out
+static inline void selectMove(MovePicker* mp, int at) {
+    int best = at;
+    for (int i = at + 1; i < mp->list.count; i++) if (mp->scores[i] > mp->scores[best]) best = i;
+    Move m = mp->list.moves[best];
+    int s = mp->scores[best];
+    mp->list.moves[best] = mp->list.moves[at];
+    mp->scores[best] = mp->scores[at];
+    mp->list.moves[at] = m;
+    mp->scores[at] = s;
+}
+
+static inline Move pickBestMove(MovePicker* mp) {
+    if (mp->index >= mp->ready) selectMove(mp, mp->index); // else peekMoves has put it there
+    return mp->list.moves[mp->index++];
+}
+
+/* Up to n of the moves the current stage will hand out next, selected ahead of time so the order doesn't change:
+   their children's buckets can be prefetched while the move before them is searched. Some may be skipped when
+   their turn comes (already tried, held back as losing captures); none from stages not generated yet. */
+#define PREFETCH_AHEAD_MAX 4
+
+static int peekMoves(MovePicker* mp, Move* out, int n) {
+    if (mp->stage != STAGE_CAPTURES && mp->stage != STAGE_QUIETS && mp->stage != STAGE_UNDERPROMOTIONS
+        && mp->stage != STAGE_EVASIONS) return 0;
+    int count = 0;
+    for (int at = mp->index; count < n && at < mp->list.count; at++) {
+        if (at >= mp->ready) selectMove(mp, at), mp->ready = at + 1;
+        out[count++] = mp->list.moves[at];
+    }
+    return count;
+}
+
+// already handed out by the hash or killer stage?
+static inline bool pickedEarlier(const MovePicker* mp, Move m) {
+    if (m == mp->hashMove) return true;
+    if (mp->stage == STAGE_QUIETS && (m == mp->killers[0] || m == mp->killers[1] || m == mp->killers[2])) return true;
+    return false;
+}
+
+bool nextMove(MovePicker* mp, Move* out) {
+    for (;;) {
+        switch (mp->stage) {
+            case STAGE_HASH_MOVE:
+                mp->stage = isKingInCheck(mp->chess, mp->chess->whiteToMove) ? STAGE_GEN_EVASIONS : STAGE_GEN_CAPTURES;
+                if (mp->hashMove != MOVE_NONE) { *out = mp->hashMove; return true; }
+                break;
+            case STAGE_GEN_CAPTURES:
+                TRACE_HOT(TRACE_MOVEGEN, generateCaptures(mp->chess, &mp->list));
+                scoreMoves(mp);
+                mp->index = mp->ready = 0;
+                mp->stage = STAGE_CAPTURES;
+                break;
+            case STAGE_CAPTURES:
+            case STAGE_QUIETS:
+            case STAGE_UNDERPROMOTIONS:
+            case STAGE_EVASIONS:
+                while (mp->index < mp->list.count) {
+                    Move m = pickBestMove(mp);
+                    if (pickedEarlier(mp, m)) continue;
+                    if (mp->stage == STAGE_CAPTURES && mp->badCount < 64 && isLosingCapture(mp->chess, m)) {
+                        mp->badCaptures[mp->badCount++] = m;
+                        continue;
+                    }
+                    *out = m;
+                    return true;
+                }
+                mp->stage = mp->stage == STAGE_CAPTURES ? STAGE_KILLERS
+                          : mp->stage == STAGE_QUIETS ? STAGE_BAD_CAPTURES : STAGE_DONE;
+                break;
+            case STAGE_BAD_CAPTURES:
+                if (mp->badIndex < mp->badCount) { *out = mp->badCaptures[mp->badIndex++]; return true; }
+                mp->stage = STAGE_GEN_UNDERPROMOTIONS;
+                break;
+            case STAGE_KILLERS:
+                while (mp->killerIndex < 3) {
+                    Move k = mp->killers[mp->killerIndex++];
+                    bool repeat = (mp->killerIndex >= 2 && k == mp->killers[0]) || (mp->killerIndex == 3 && k == mp->killers[1]);
+                    if (!repeat && k != MOVE_NONE && k != mp->hashMove && isQuietMove(k) && isPseudoLegalMove(mp->chess, k)) {
+                        *out = k;
+                        return true;
+                    }
+                    mp->killers[mp->killerIndex - 1] = MOVE_NONE; // don't skip it again in the quiet stage
+                }
+                mp->stage = STAGE_GEN_QUIETS;
+                break;
+            case STAGE_GEN_QUIETS:
+                TRACE_HOT(TRACE_MOVEGEN, generateQuiets(mp->chess, &mp->list));
+                scoreMoves(mp);
+                mp->index = mp->ready = 0;
+                mp->stage = STAGE_QUIETS;
+                break;
+            case STAGE_GEN_UNDERPROMOTIONS:
+                TRACE_HOT(TRACE_MOVEGEN, generateUnderPromotions(mp->chess, &mp->list));
+                scoreMoves(mp);
+                mp->index = mp->ready = 0;
+                mp->stage = STAGE_UNDERPROMOTIONS;
+                break;
+            case STAGE_GEN_EVASIONS:
+                TRACE_HOT(TRACE_MOVEGEN, generateEvasions(mp->chess, &mp->list));
+                scoreMoves(mp);
+                mp->index = mp->ready = 0;
+                mp->stage = STAGE_EVASIONS;
+                break;
+            default:
+                return false;
+        }
+    }
+}
+
+#if !defined(TABLES_GENERATED) // in tables.h, already mirrored and summed with the material
+// for preferred board placements of each piece
+// https://www.reddit.com/r/ComputerChess/comments/17v6dux/piece_position_in_evaluation/
+// tweaked from https://www.chessprogramming.org/PeSTO%27s_Evaluation_Function
+static const int PAWN_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored
+    0,  0,  0,  0,  0,  0,  0,  0,
+    50, 50, 50, 50, 50, 50, 50, 50,
+    10, 10, 20, 30, 30, 20, 10, 10,
+    5,  5, 10, 25, 25, 10,  5,  5,
+    0,  0,  0, 20, 20,  0,  0,  0,
+    5, -5,-10,  0,  0,-10, -5,  5,
+    5, 10, 10,-20,-20, 10, 10,  5,
+    0,  0,  0,  0,  0,  0,  0,  0
+};
+
+static const int KNIGHT_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored
+    -50,-40,-30,-30,-30,-30,-40,-50,
+    -40,-20,  0,  0,  0,  0,-20,-40,
+    -30,  0, 10, 15, 15, 10,  0,-30,
+    -30,  5, 15, 20, 20, 15,  5,-30,
+    -30,  0, 15, 20, 20, 15,  0,-30,
+    -30,  5, 10, 15, 15, 10,  5,-30,
+    -40,-20,  0,  5,  5,  0,-20,-40,
+    -50,-40,-30,-30,-30,-30,-40,-50
+};
+
+static const int BISHOP_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored
+    -20,-10,-10,-10,-10,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5, 10, 10,  5,  0,-10,
+    -10,  5,  5, 10, 10,  5,  5,-10,
+    -10,  0, 10, 10, 10, 10,  0,-10,
+    -10, 10, 10, 10, 10, 10, 10,-10,
+    -10,  5,  0,  0,  0,  0,  5,-10,
+    -20,-10,-10,-10,-10,-10,-10,-20
+};
+
+static const int ROOK_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored
+    0,  0,  0,  0,  0,  0,  0,  0,
+    5, 10, 10, 10, 10, 10, 10,  5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    0,  0,  0,  5,  5,  0,  0,  0
+};
+
+static const int QUEEN_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored
+    -20,-10,-10, -5, -5,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5,  5,  5,  5,  0,-10,
+    -5,  0,  5,  5,  5,  5,  0, -5,
+    0,  0,  5,  5,  5,  5,  0, -5,
+    -10,  5,  5,  5,  5,  5,  0,-10,
+    -10,  0,  5,  0,  0,  0,  0,-10,
+    -20,-10,-10, -5, -5,-10,-10,-20
+};
+
+
+static const int KING_MIDDLE_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -20,-30,-30,-40,-40,-30,-30,-20,
+    -10,-20,-20,-20,-20,-20,-20,-10,
+    20, 20,  0,  0,  0,  0, 20, 20,
+    20, 30, 10,  0,  0, 10, 30, 20
+};
+// otherwise king doesnt get used offensively in endgame
+
+static const int KING_END_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored
+    -50,-40,-30,-20,-20,-30,-40,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-30,  0,  0,  0,  0,-30,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50
+};
+
+// per piece kind (PieceType of the white piece), [0] middlegame [1] endgame: only the king's differ
+static const int* const PIECE_TABLES[2][7] = {
+    { NULL, PAWN_TABLE, KNIGHT_TABLE, BISHOP_TABLE, ROOK_TABLE, QUEEN_TABLE, KING_MIDDLE_TABLE },
+    { NULL, PAWN_TABLE, KNIGHT_TABLE, BISHOP_TABLE, ROOK_TABLE, QUEEN_TABLE, KING_END_TABLE }
+};
+#endif
+
+/* Fills PIECE_SQUARE_VALUE, which setSquare keeps the running sum with, and PHASE_WEIGHT. Done at startup like the
+   attack tables, C has no way to mirror the tables for black at compile time; gentables does it ahead of time. */
+void initEvalTables(void) {
+#if !defined(TABLES_GENERATED)
+    for (PieceType p = WHITE_PAWN; p <= BLACK_KING; p++) {
+        bool white = isWhite(p);
+        int kind = pieceKind(p);
+        if (kind == EMPTY || kind > WHITE_KING) continue; // the unused codes
+        int material = PIECE_VALUES[p] * 100; // Scale up material values
+        for (int sq = 0; sq < 64; sq++) {
+            int tableSq = white ? sq : sq ^ 56; // black's pieces see the board with the ranks flipped
+            int mg = material + PIECE_TABLES[0][kind][tableSq];
+            int eg = material + PIECE_TABLES[1][kind][tableSq];
+            PIECE_SQUARE_VALUE[p][sq] = white ? PACK_SCORE(mg, eg) : PACK_SCORE(-mg, -eg);
+        }
+    }
+    for (int phase = 0; phase <= PHASE_MAX; phase++) PHASE_WEIGHT[phase] = (phase * 256 + PHASE_MAX / 2) / PHASE_MAX;
+#endif
+}
+
+// blends the two halves by the game phase instead of switching at a threshold, so trades move the score smoothly
+static inline int taperedValue(PackedScore s, int phase) {
+    int w = PHASE_WEIGHT[phase < PHASE_MAX ? phase : PHASE_MAX]; // promotions can take it past the maximum
+    return (mgValue(s) * w + egValue(s) * (256 - w)) >> 8;
+}
+
+/* KPK bitbase: whether king and pawn beat a lone king, one bit a position, for every position with the pawn's side
+   as white and the pawn on files a to d (the others mirror onto them): 24 pawn squares, the side to move and the
+   two kings, 24 KB. Worked out backwards to a fixed point from the positions decided outright (a promotion that
+   can't be stopped, stalemate, the pawn taken) like the tablebases, but with no distances to keep, so it's cheap
+   enough to build at startup and the evaluation and the search can always ask it; gentables builds it ahead. */
+#define KPK_SIZE (24 * 2 * 64 * 64)
+
+static inline int squareDistance(int a, int b) { return SDL_max(abs((a >> 3) - (b >> 3)), abs((a & 7) - (b & 7))); }
+static inline int edgeDistance(int sq) { return SDL_min(SDL_min(sq >> 3, 7 - (sq >> 3)), SDL_min(sq & 7, 7 - (sq & 7))); }
+
+TABLE Uint64 KPK_BITBASE[KPK_SIZE / 64];
+
+static inline int kpkIndex(bool strongToMove, int sk, int wk, int ps) { // ps on files a-d, ranks 2-7
+    return ((((ps >> 3) - 1) * 4 + (ps & 7)) * 2 + (strongToMove ? 0 : 1)) * 4096 + sk * 64 + wk;
+}
+
+// the position as the bitbase holds it: the pawn's side white, the pawn on files a to d
+static bool kpkWon(bool strongToMove, int sk, int wk, int ps) {
+    if ((ps & 7) > 3) sk ^= 7, wk ^= 7, ps ^= 7;
+    int index = kpkIndex(strongToMove, sk, wk, ps);
+    return (KPK_BITBASE[index >> 6] >> (index & 63)) & 1;
+}
+
+#if !defined(TABLES_GENERATED)
+enum { KPK_UNKNOWN, KPK_DRAW, KPK_WIN, KPK_INVALID };
+
+static Uint8 kpkClassifyOutright(bool strongToMove, int sk, int wk, int ps) {
+    Bitboard pawnAttacks = PAWN_ATTACKS[0][ps];
+    if (squareDistance(sk, wk) <= 1 || sk == ps || wk == ps || (strongToMove && (pawnAttacks & squareBB(wk)))) return KPK_INVALID;
+    int push = ps + 8;
+    if (strongToMove && ps >= 48 && sk != push && wk != push && (squareDistance(wk, push) > 1 || squareDistance(sk, push) == 1))
+        return KPK_WIN; // promotes and the queen can't be taken
+    if (!strongToMove) {
+        if ((KING_ATTACKS[wk] & squareBB(ps)) && !(KING_ATTACKS[sk] & squareBB(ps))) return KPK_DRAW; // takes the pawn
+        if (!(KING_ATTACKS[wk] & ~KING_ATTACKS[sk] & ~pawnAttacks & ~squareBB(ps))) return KPK_DRAW; // stalemate
+    }
+    return KPK_UNKNOWN;
+}
+
+/* One pass: the strong side wins if a move reaches a win, the weak side draws if a move reaches a draw, and a
+   position every one of whose moves is decided the other way is decided too. Promotions that aren't won outright
+   count as draws, which only errs on the cautious side (a stalemating queen could have been a rook). */
+static Uint8 kpkClassify(const Uint8* db, bool strongToMove, int sk, int wk, int ps) {
+    Uint8 seen = 0; // KPK_DRAW and KPK_WIN bits of the moves' results, KPK_UNKNOWN's as 4
+    if (strongToMove) {
+        for (Bitboard b = KING_ATTACKS[sk] & ~KING_ATTACKS[wk] & ~squareBB(ps); b;) {
+            Uint8 r = db[kpkIndex(false, popLsb(&b), wk, ps)];
+            seen |= r == KPK_UNKNOWN ? 4 : r;
+        }
+        int push = ps + 8;
+        if (push < 56 && push != sk && push != wk) {
+            Uint8 r = db[kpkIndex(false, sk, wk, push)];
+            seen |= r == KPK_UNKNOWN ? 4 : r;
+            if (ps < 16 && push + 8 != sk && push + 8 != wk) {
+                r = db[kpkIndex(false, sk, wk, push + 8)];
+                seen |= r == KPK_UNKNOWN ? 4 : r;
+            }
+        }
+        return (seen & KPK_WIN) ? KPK_WIN : (seen & 4) ? KPK_UNKNOWN : KPK_DRAW;
+    }
+    for (Bitboard b = KING_ATTACKS[wk] & ~KING_ATTACKS[sk] & ~PAWN_ATTACKS[0][ps] & ~squareBB(ps); b;) {
+        Uint8 r = db[kpkIndex(true, sk, popLsb(&b), ps)];
+        seen |= r == KPK_UNKNOWN ? 4 : r;
+    }
+    return (seen & KPK_DRAW) ? KPK_DRAW : (seen & 4) ? KPK_UNKNOWN : KPK_WIN;
+}
+#endif
+
+static void initKpkBitbase(void) {
+#if !defined(TABLES_GENERATED)
+    static Uint8 db[KPK_SIZE]; // a KPK_* a position while it's worked out
+    for (int i = 0; i < KPK_SIZE; i++) {
+        int pawn = i / 8192, ps = (pawn / 4 + 1) * 8 + pawn % 4;
+        db[i] = kpkClassifyOutright((i & 4096) == 0, (i >> 6) & 63, i & 63, ps);
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int i = 0; i < KPK_SIZE; i++) {
+            if (db[i] != KPK_UNKNOWN) continue;
+            int pawn = i / 8192, ps = (pawn / 4 + 1) * 8 + pawn % 4;
+            db[i] = kpkClassify(db, (i & 4096) == 0, (i >> 6) & 63, i & 63, ps);
+            changed |= db[i] != KPK_UNKNOWN;
+        }
+    }
+    SDL_memset(KPK_BITBASE, 0, sizeof(KPK_BITBASE)); // what's still unknown can't be forced: a draw
+    for (int i = 0; i < KPK_SIZE; i++) if (db[i] == KPK_WIN) KPK_BITBASE[i >> 6] |= 1ULL << (i & 63);
+#endif
+}
+
+/* Pawn hash table: the pawn structure terms depend on the pawns alone and the pawns hardly change from one node
+   to the next, so each search thread caches them by pawnKey. A zeroed entry has key 0 and score 0, which is also
+   the right answer for the one position with that key, no pawns at all. The material table beside it is kept the
+   same way, by materialKey. */
+#if defined(CHESS_LOW_MEMORY)
+#define PAWN_HASH_ENTRIES 1024
+#define MATERIAL_HASH_ENTRIES 256
+#else
+#define PAWN_HASH_ENTRIES 4096     // per thread, power of two
+#define MATERIAL_HASH_ENTRIES 1024 // likewise
+#endif
+
+typedef struct {
+    Uint64 key;
+    int score;   // pawn structure, white minus black
+} PawnEntry;
+
+// how evaluateWith scores a material balance: the general evaluation, or an ending that needs (or has) its own
+enum {
+    ENDING_GENERAL,
+    ENDING_DRAWN, // no pawns, no rooks or queens, and too few minor pieces to mate with
+    ENDING_KXK,   // a lone king against a rook or queen at least: drive it to the edge
+    ENDING_KBNK,  // bishop and knight: drive it to a corner of the bishop's colour
+    ENDING_KPK    // the KPK bitbase's answer
+};
+
+typedef struct {
+    Uint64 key;       // materialKey; 0 is the bare kings, which a zeroed entry would get wrong, so never kept
+    Sint16 imbalance; // the material terms besides the piece values, the bishop pair: white minus black
+    Uint8 ending;     // ENDING_*
+    Uint8 strong;     // the side with the material in a KXK, KBNK or KPK ending, 0 white
+} MaterialEntry;
+
+typedef struct {
+    PawnEntry entries[PAWN_HASH_ENTRIES];
+    MaterialEntry materials[MATERIAL_HASH_ENTRIES];
+#if defined(EVAL_PROFILE)
+    EvalProfile profile;     // the thread's, see engineEvalProfile
+#endif
+} PawnTable;
+
+#if defined(EVAL_PROFILE)
+#if defined(__x86_64__)
+#define PROFILE_CLOCK() __rdtsc()
+#else
+#define PROFILE_CLOCK() SDL_GetPerformanceCounter()
+#endif
+// a term's cost since start and what it added, into the thread's profile when there's a pawn table to hold it
+#define PROFILE_START(name) Uint64 name = PROFILE_CLOCK()
+#define PROFILE_TERM(pawns, term, start, score) \
+    do { if (pawns) { EvalProfile* profile_ = &(pawns)->profile; profile_->cycles[term] += PROFILE_CLOCK() - (start); \
+                      profile_->evaluated[term]++; profile_->magnitude[term] += (Uint64)abs(score); } } while (0)
+#define PROFILE_COUNT(pawns, counter) do { if (pawns) (pawns)->profile.counter++; } while (0)
+#else
+#define PROFILE_START(name) ((void)0)
+#define PROFILE_TERM(pawns, term, start, score) ((void)0)
+#define PROFILE_COUNT(pawns, counter) ((void)0)
+#endif
+
+static PawnTable pawnTables[MAX_POOL_THREADS + 1]; // one per search thread, indexed like the node counters
+
+/* The weights of the evaluation's terms besides the piece-square tables, per EVAL_TERM_* count (engine.h): the
+   king shield is a middlegame term, the others count whatever the phase. `main tune` fits them. */
+static const int EVAL_TERM_WEIGHTS[EVAL_TERM_COUNT] = { 2, 10, -10, -15, 8, -8, 10, 50, 15 };
+
+/* One side's pawns sorted by the structure terms, with shifts and ORs over the whole side rather than a walk over
+   its files. Both sides are given as white sees the board (black's ranks swapped, SDL_Swap64), so own pawns go up.
+   The front span is the squares ahead of a side's pawns on their files, the attack span every square one of them
+   could ever take on: a pawn outside the other side's front and attack spans is passed, one whose stop square is
+   hit by an enemy pawn and outside its own side's attack span (no neighbour at or behind it) is backward, and one
+   on a file the other has no pawn ahead on whose stop square is held at least as well as it's hit is a candidate.
+   The rear pawn of a doubled pair is neither passed nor a candidate. */
+typedef struct {
+    Bitboard files;      // the rank-1 fold: a bit per file with a pawn on it
+    Bitboard isolated, passed, backward, candidate;
+} PawnSpans;
+
+// the relative ranks of the passed pawns summed, 1 on the second rank to 6 on the seventh, as three counts
+#define PASSED_RANK_1 0xFF00FF00FF00FF00ULL
+#define PASSED_RANK_2 0xFFFF0000FFFF0000ULL
+#define PASSED_RANK_4 0xFFFFFFFF00000000ULL
+
+FORCE_INLINE PawnSpans pawnSpans(Bitboard own, Bitboard other) {
+    const Bitboard notA = ~fileBB(0), notH = ~fileBB(7);
+    PawnSpans s;
+    Bitboard files = own | own >> 32;
+    files |= files >> 16;
+    s.files = (files | files >> 8) & 0xFF;
+    Bitboard isolated = s.files & ~((s.files << 1) | (s.files >> 1));
+    isolated |= isolated << 8;
+    isolated |= isolated << 16;
+    isolated |= isolated << 32;
+    s.isolated = own & isolated;
+
+    Bitboard ownFront = own << 8, otherFront = other >> 8; // filled up the board, and down it
+    ownFront |= ownFront << 8;
+    ownFront |= ownFront << 16;
+    ownFront |= ownFront << 32;
+    otherFront |= otherFront >> 8;
+    otherFront |= otherFront >> 16;
+    otherFront |= otherFront >> 32;
+    Bitboard ownFill = own | ownFront;
+    Bitboard ownAttackSpan = (ownFill & notA) << 7 | (ownFill & notH) << 9;
+    Bitboard otherSpan = otherFront | (otherFront & notA) >> 1 | (otherFront & notH) << 1;
+    s.passed = own & ~otherSpan & ~ownFront;
+
+    Bitboard ownLeft = (own & notA) << 7, ownRight = (own & notH) << 9;
+    Bitboard otherLeft = (other & notA) >> 9, otherRight = (other & notH) >> 7;
+    Bitboard otherAttacks = otherLeft | otherRight;
+    Bitboard unsafe = (otherAttacks & ~(ownLeft | ownRight)) | (otherLeft & otherRight & ~(ownLeft & ownRight));
+    s.backward = ((own << 8) & otherAttacks & ~ownAttackSpan) >> 8 & ~s.isolated;
+    s.candidate = own & ~otherFront & ~ownFront & ~s.passed & ~(unsafe >> 8);
+    return s;
+}
+
+static int evaluatePawnStructure(const ChessState* chess) {
+    int pawnStructure = 0;
+    for (int side = 0; side < 2; side++) {
+        Bitboard own = chess->pieceBB[SIDE_PIECE(side, WHITE_PAWN)], other = chess->pieceBB[SIDE_PIECE(side ^ 1, WHITE_PAWN)];
+        if (side == 1) own = SDL_Swap64(own), other = SDL_Swap64(other);
+        PawnSpans s = pawnSpans(own, other);
+        int passedRanks = popcount64(s.passed & PASSED_RANK_1) + 2 * popcount64(s.passed & PASSED_RANK_2)
+                        + 4 * popcount64(s.passed & PASSED_RANK_4);
+        int score = (popcount64(own) - popcount64(s.files)) * EVAL_TERM_WEIGHTS[EVAL_TERM_DOUBLED]
+                  + popcount64(s.isolated) * EVAL_TERM_WEIGHTS[EVAL_TERM_ISOLATED]
+                  + passedRanks * EVAL_TERM_WEIGHTS[EVAL_TERM_PASSED]
+                  + popcount64(s.backward) * EVAL_TERM_WEIGHTS[EVAL_TERM_BACKWARD]
+                  + popcount64(s.candidate) * EVAL_TERM_WEIGHTS[EVAL_TERM_CANDIDATE];
+        pawnStructure += side == 0 ? score : -score;
+    }
+    return pawnStructure;
+}
+
+// pawns = NULL to evaluate without the cache
+static int probePawnStructure(const ChessState* chess, PawnTable* pawns) {
+    if (!pawns) return evaluatePawnStructure(chess);
+    PawnEntry* e = &pawns->entries[chess->pawnKey & (PAWN_HASH_ENTRIES - 1)];
+    if (e->key != chess->pawnKey) {
+        e->key = chess->pawnKey;
+        e->score = evaluatePawnStructure(chess);
+    }
+    return e->score;
+}
+
+/* The piece counts, four bits each: white's pawns, knights, bishops, rooks and queens, then black's. Counted
+   when the evaluation needs it rather than kept by setSquare: it's ten popcounts, and only leaves pay them. */
+static inline Uint64 materialKey(const ChessState* chess) {
+    Uint64 key = 0;
+    for (int kind = WHITE_PAWN; kind < WHITE_KING; kind++)
+        key |= (Uint64)popcount64(chess->pieceBB[kind]) << (4 * (kind - WHITE_PAWN))
+             | (Uint64)popcount64(chess->pieceBB[kind | PIECE_BLACK]) << (4 * (kind - WHITE_PAWN + 5));
+    return key;
+}
+
+static inline int materialCount(Uint64 key, int side, PieceType kind) { // kind: a white PieceType
+    return (int)(key >> (4 * (kind - WHITE_PAWN + side * 5)) & 15);
+}
+
+static MaterialEntry evaluateMaterial(Uint64 key) {
+    MaterialEntry e = { .key = key, .imbalance = 0, .ending = ENDING_GENERAL, .strong = 0 };
+    int pawns[2], minors[2], knights[2], bishops[2], majors[2];
+    for (int side = 0; side < 2; side++) {
+        pawns[side] = materialCount(key, side, WHITE_PAWN);
+        knights[side] = materialCount(key, side, WHITE_KNIGHT);
+        bishops[side] = materialCount(key, side, WHITE_BISHOP);
+        minors[side] = knights[side] + bishops[side];
+        majors[side] = materialCount(key, side, WHITE_ROOK) + materialCount(key, side, WHITE_QUEEN);
+    }
+    // Bonus for bishop pair
+    if (bishops[0] >= 2) e.imbalance += EVAL_TERM_WEIGHTS[EVAL_TERM_BISHOP_PAIR];
+    if (bishops[1] >= 2) e.imbalance -= EVAL_TERM_WEIGHTS[EVAL_TERM_BISHOP_PAIR];
+
+    for (int side = 0; side < 2; side++) {
+        int other = side ^ 1;
+        if (pawns[other] + minors[other] + majors[other] > 0) continue; // a lone king on the other side only
+        if (majors[side] > 0) { e.ending = ENDING_KXK; e.strong = (Uint8)side; }
+        else if (pawns[side] == 0 && knights[side] == 1 && bishops[side] == 1) { e.ending = ENDING_KBNK; e.strong = (Uint8)side; }
+        else if (pawns[side] == 1 && minors[side] == 0) { e.ending = ENDING_KPK; e.strong = (Uint8)side; }
+    }
+    // two knights can't force mate, and nor can one minor piece against another or against nothing
+    if (pawns[0] + pawns[1] + majors[0] + majors[1] == 0
+        && ((minors[0] <= 1 && minors[1] <= 1) || (bishops[0] + bishops[1] == 0 && knights[0] + knights[1] <= 2)))
+        e.ending = ENDING_DRAWN;
+    return e;
+}
+
+// pawns = NULL to work it out without the table
+static inline MaterialEntry probeMaterial(const ChessState* chess, PawnTable* pawns) {
+    Uint64 key = materialKey(chess);
+    if (!pawns) return evaluateMaterial(key);
+    MaterialEntry* e = &pawns->materials[key & (MATERIAL_HASH_ENTRIES - 1)];
+    if (e->key != key || key == 0) *e = evaluateMaterial(key);
+    return *e;
+}
+
+/* The endings evaluateMaterial picks out, white's point of view. The terms on top of material and the piece-square
+   sum stay inside LAZY_EVAL_MARGIN, so lazy bounds taken before them still hold. */
+static int evaluateEnding(const ChessState* chess, const MaterialEntry* e, int material) {
+    if (e->ending == ENDING_DRAWN) return DRAW_SCORE;
+    int strong = e->strong, sign = strong == 0 ? 1 : -1;
+    int strongKing = chess->kingSquare[strong], weakKing = chess->kingSquare[strong ^ 1];
+    if (strongKing < 0 || weakKing < 0) return material;
+    int closer = 10 * (7 - squareDistance(strongKing, weakKing)); // the strong king has to help
+    switch (e->ending) {
+        case ENDING_KXK: return material + sign * (40 * (3 - edgeDistance(weakKing)) + closer);
+        case ENDING_KBNK: {
+            bool lightBishop = (chess->pieceBB[SIDE_PIECE(strong, WHITE_BISHOP)] & 0x55AA55AA55AA55AAULL) != 0;
+            int corner = SDL_min(squareDistance(weakKing, lightBishop ? 7 : 0), squareDistance(weakKing, lightBishop ? 56 : 63));
+            return material + sign * (20 * (7 - corner) + closer);
+        }
+        case ENDING_KPK: {
+            int flip = strong == 0 ? 0 : 56, pawn = lsbIndex(chess->pieceBB[SIDE_PIECE(strong, WHITE_PAWN)]);
+            bool won = kpkWon(chess->whiteToMove == (strong == 0), strongKing ^ flip, weakKing ^ flip, pawn ^ flip);
+            return won ? material + sign * 200 : DRAW_SCORE;
+        }
+        default: return material;
+    }
+}
+
+/* Evaluation cache: full evaluations by hash key, so a leaf that quiescence or the next iteration reaches again
+   costs one load. Direct-mapped, one 8-byte slot per position: the low key bits pick the slot and the high 32
+   are kept to check it. Lazy (bound only) results aren't stored. */
+#if defined(CHESS_LOW_MEMORY)
+#define EVAL_CACHE_ENTRIES 2048
+#else
+#define EVAL_CACHE_ENTRIES 8192 // per thread, power of two
+#endif
+
+typedef struct {
+    Uint64 slots[EVAL_CACHE_ENTRIES]; // key >> 32 in the high half, the score in the low, 0 = empty
+    Uint64 probes, hits;              // for measuring it; only the owning thread writes them
+} EvalCache;
+
+static EvalCache evalCaches[MAX_POOL_THREADS + 1]; // one per search thread, like the pawn tables
+
+/* The terms after material and the piece-square tables never added up to more than about 280 over ~380k
+   positions from random games; with this much room a score that far outside the window stays outside it. */
+#define LAZY_EVAL_MARGIN 300
+
+/* White's point of view. pawns: the calling thread's pawn hash table, or NULL. alpha and beta, also white's point
+   of view, are the window the caller cares about: when material and the piece-square tables alone are more than
+   LAZY_EVAL_MARGIN outside it, the rest isn't computed and the bound they give is returned, still outside the
+   window (so fail-soft callers and delta pruning see no more than they would have). -INF, INF for the full score.
+   cache: the calling thread's evaluation cache, or NULL. */
+FORCE_INLINE int evaluateWith(ChessState* chess, PawnTable* pawns, EvalCache* cache, int alpha, int beta) {
+    Uint64* slot = NULL;
+    PROFILE_COUNT(pawns, calls);
+    if (cache) {
+        slot = &cache->slots[chess->hashKey & (EVAL_CACHE_ENTRIES - 1)];
+        cache->probes++;
+        if (*slot && (Uint32)(*slot >> 32) == (Uint32)(chess->hashKey >> 32)) {
+            cache->hits++;
+            PROFILE_COUNT(pawns, cacheHits);
+            return (Sint32)(Uint32)*slot;
+        }
+    }
+    PROFILE_START(psqStart);
+    int lazy = taperedValue(chess->psq, chess->phase);
+    PROFILE_TERM(pawns, EVAL_PROFILE_PSQ, psqStart, lazy);
+    PROFILE_START(materialStart);
+    MaterialEntry material = probeMaterial(chess, pawns); // the endings with their own evaluation skip the rest
+    PROFILE_TERM(pawns, EVAL_PROFILE_MATERIAL, materialStart, material.imbalance);
+    if (material.ending != ENDING_GENERAL) {
+        int score = evaluateEnding(chess, &material, lazy);
+        if (slot) *slot = (chess->hashKey & 0xFFFFFFFF00000000ULL) | (Uint32)score;
+        PROFILE_COUNT(pawns, endings);
+        return score;
+    }
+    if (lazy - LAZY_EVAL_MARGIN >= beta || lazy + LAZY_EVAL_MARGIN <= alpha) PROFILE_COUNT(pawns, lazyExits);
+    if (lazy - LAZY_EVAL_MARGIN >= beta) return lazy - LAZY_EVAL_MARGIN;
+    if (lazy + LAZY_EVAL_MARGIN <= alpha) return lazy + LAZY_EVAL_MARGIN;
+    PROFILE_START(mobilityStart);
+
+    // Each side's attack map and its mobility: the squares each piece attacks, own pieces included, and for pawns
+    // their pushes and the captures open to them
+    const Bitboard* bb = chess->pieceBB;
+    Bitboard occupied = chess->occupied, empty = ~occupied;
+    AttackMap map;
+    addSideAttacks(chess, &map, 0, occupied);
+    addSideAttacks(chess, &map, 1, occupied);
+    int mobility[2] = { map.pieceMobility[0], map.pieceMobility[1] };
+    {
+        const Bitboard notFileA = ~fileBB(0), notFileH = ~fileBB(7);
+        Bitboard whiteLeft = (bb[WHITE_PAWN] & notFileA) << 7, whiteRight = (bb[WHITE_PAWN] & notFileH) << 9;
+        Bitboard blackLeft = (bb[BLACK_PAWN] & notFileA) >> 9, blackRight = (bb[BLACK_PAWN] & notFileH) >> 7;
+        Bitboard whiteTargets = occupied, blackTargets = occupied;
+        if (chess->enPassantCol >= 0) {
+            if (chess->whiteToMove) whiteTargets |= squareBB(squareIndex(5, chess->enPassantCol));
+            else blackTargets |= squareBB(squareIndex(2, chess->enPassantCol));
+        }
+        Bitboard whitePush = (bb[WHITE_PAWN] << 8) & empty, blackPush = (bb[BLACK_PAWN] >> 8) & empty;
+        Bitboard whiteDouble = ((whitePush & (0xFFULL << 16)) << 8) & empty;
+        Bitboard blackDouble = ((blackPush & (0xFFULL << 40)) >> 8) & empty;
+        // counted per direction so two pawns hitting one square both count it
+        mobility[0] += popcount64(whitePush) + popcount64(whiteDouble)
+                    + popcount64(whiteLeft & whiteTargets) + popcount64(whiteRight & whiteTargets);
+        mobility[1] += popcount64(blackPush) + popcount64(blackDouble)
+                    + popcount64(blackLeft & blackTargets) + popcount64(blackRight & blackTargets);
+    }
+    int mobilityScore = (mobility[0] - mobility[1]) * EVAL_TERM_WEIGHTS[EVAL_TERM_MOBILITY];
+    PROFILE_TERM(pawns, EVAL_PROFILE_MOBILITY, mobilityStart, mobilityScore); // the attack maps' cost included
+
+    // Bonus for controlling center squares, off the same attack maps
+    PROFILE_START(centerStart);
+    int centerControl = 0;
+    const Bitboard centerSquares = squareBB(squareIndex(3, 3)) | squareBB(squareIndex(3, 4))
+                                 | squareBB(squareIndex(4, 3)) | squareBB(squareIndex(4, 4));
+    centerControl += EVAL_TERM_WEIGHTS[EVAL_TERM_CENTER] * popcount64(map.attacked[0] & centerSquares);
+    centerControl -= EVAL_TERM_WEIGHTS[EVAL_TERM_CENTER] * popcount64(map.attacked[1] & centerSquares);
+    PROFILE_TERM(pawns, EVAL_PROFILE_CENTER, centerStart, centerControl);
+    
+    // Pawn structure evaluation
+    PROFILE_START(pawnsStart);
+    int pawnStructure = probePawnStructure(chess, pawns);
+    PROFILE_TERM(pawns, EVAL_PROFILE_PAWNS, pawnsStart, pawnStructure);
+    Bitboard whitePawnsBB = chess->pieceBB[WHITE_PAWN];
+    Bitboard blackPawnsBB = chess->pieceBB[BLACK_PAWN];
+    
+    // King safety, a middlegame term: fades out with the pieces
+    PROFILE_START(kingStart);
+    int kingSafety = 0;
+    // Check pawn shield on the three squares in front of each king
+    if (chess->kingSquare[0] >= 0) {
+        int sq = chess->kingSquare[0];
+        int r = sq >> 3, c = sq & 7;
+        if (r < 7) {
+            Bitboard shield = fileBB(c) | (c > 0 ? fileBB(c - 1) : 0) | (c < 7 ? fileBB(c + 1) : 0);
+            shield &= 0xFFULL << ((r + 1) * 8);
+            kingSafety += EVAL_TERM_WEIGHTS[EVAL_TERM_SHIELD] * popcount64(shield & whitePawnsBB);
+        }
+    }
+    if (chess->kingSquare[1] >= 0) {
+        int sq = chess->kingSquare[1];
+        int r = sq >> 3, c = sq & 7;
+        if (r > 0) {
+            Bitboard shield = fileBB(c) | (c > 0 ? fileBB(c - 1) : 0) | (c < 7 ? fileBB(c + 1) : 0);
+            shield &= 0xFFULL << ((r - 1) * 8);
+            kingSafety -= EVAL_TERM_WEIGHTS[EVAL_TERM_SHIELD] * popcount64(shield & blackPawnsBB);
+        }
+    }
+
+    PROFILE_TERM(pawns, EVAL_PROFILE_KING, kingStart, taperedValue(PACK_SCORE(kingSafety, 0), chess->phase));
+
+    // Material and piece-square tables (summed as the pieces moved; the king has one table for each phase) and
+    // king safety, tapered together
+    int materialAndPosition = taperedValue(chess->psq + PACK_SCORE(kingSafety, 0), chess->phase);
+
+    // Combine all factors
+    int score = materialAndPosition + material.imbalance +
+                centerControl + mobilityScore + pawnStructure;
+    if (slot) *slot = (chess->hashKey & 0xFFFFFFFF00000000ULL) | (Uint32)score;
+    return score;
+}
+
+/* The evaluation counts bits everywhere, and the x86-64 baseline has no POPCNT instruction, so a copy compiled
+   for it is picked at startup where the processor has one (selectKernels). */
+static int evaluateBaseline(ChessState* chess, PawnTable* pawns, EvalCache* cache, int alpha, int beta) {
+    return evaluateWith(chess, pawns, cache, alpha, beta);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt"))) static int evaluatePopcnt(ChessState* chess, PawnTable* pawns, EvalCache* cache, int alpha, int beta) {
+    return evaluateWith(chess, pawns, cache, alpha, beta);
+}
+#endif
+
+static int (*evaluateKernel)(ChessState* chess, PawnTable* pawns, EvalCache* cache, int alpha, int beta) = evaluateBaseline;
+
+int evaluatePosition(ChessState* chess, PawnTable* pawns, EvalCache* cache, int alpha, int beta) {
+    return evaluateKernel(chess, pawns, cache, alpha, beta);
+}
+
+/* Batched evaluation (evaluateBatch): the score evaluatePosition gives with no window and no caches, worked out a
+   group of EVAL_BATCH_LANES positions at a time. The group's bitboards are copied into a structure of arrays, a
+   row per piece type with a position per column, and the terms are taken along the rows with shifts, masks and
+   adds only, so the compiler keeps one position in each vector lane: sliders by occluded fills (Kogge-Stone)
+   rather than the magic tables, knights and kings by their eight steps, pawn files by folding the ranks together,
+   and squares counted a byte at a time (SWAR) rather than with POPCNT, which has no vector form before AVX-512.
+   A slider's ray stops at the first piece in its way, where the ray of a slider behind it ends, so one fill over
+   all of a side's sliders counts each piece's squares once and the directions' counts add up to the per-piece
+   mobility addSideAttacks sums; a step taken by every knight at once likewise. Only the positions that might be
+   one of the endings with their own evaluation go through the material table, one at a time. The terms come out
+   as counts (EVAL_TERM_*), which is also what evalFeatures hands the tuner. */
+typedef struct {
+    Bitboard pieces[PIECE_TYPE_COUNT][EVAL_BATCH_LANES];
+    Bitboard occupied[EVAL_BATCH_LANES];
+    Bitboard pawnTargets[2][EVAL_BATCH_LANES]; // what each side's pawns can take: the pieces, and en passant
+    int terms[EVAL_TERM_COUNT][EVAL_BATCH_LANES]; // the counts, white minus black
+    int general[EVAL_BATCH_LANES];             // can't be one of the endings evaluateMaterial picks out
+} EvalLanes;
+
+#define LANE_SHIFT(b, s) ((s) > 0 ? (b) << (s) : (b) >> -(s))
+
+// the squares sliders attack in one direction, s a step of it; mask drops the steps that wrapped round an edge
+FORCE_INLINE Bitboard slideAttacks(Bitboard sliders, Bitboard empty, int s, Bitboard mask) {
+    empty &= mask;
+    sliders |= empty & LANE_SHIFT(sliders, s);
+    empty &= LANE_SHIFT(empty, s);
+    sliders |= empty & LANE_SHIFT(sliders, 2 * s);
+    empty &= LANE_SHIFT(empty, 2 * s);
+    sliders |= empty & LANE_SHIFT(sliders, 4 * s);
+    return LANE_SHIFT(sliders, s) & mask;
+}
+
+// each byte's bits counted into that byte, at most 8, so 31 of these add up without a byte overflowing
+FORCE_INLINE Bitboard byteCounts(Bitboard b) {
+    b -= (b >> 1) & 0x5555555555555555ULL;
+    b = (b & 0x3333333333333333ULL) + ((b >> 2) & 0x3333333333333333ULL);
+    return (b + (b >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+}
+
+FORCE_INLINE int byteSum(Bitboard counts) { // without the multiply, which AVX2 has no 64-bit form of
+    counts = (counts & 0x00FF00FF00FF00FFULL) + ((counts >> 8) & 0x00FF00FF00FF00FFULL);
+    counts = (counts & 0x0000FFFF0000FFFFULL) + ((counts >> 16) & 0x0000FFFF0000FFFFULL);
+    return (int)((counts & 0xFFFFFFFFULL) + (counts >> 32));
+}
+
+FORCE_INLINE void addAttacks(Bitboard attacks, Bitboard* attacked, Bitboard* mobility) {
+    *attacked |= attacks;
+    *mobility += byteCounts(attacks);
+}
+
+// one side of one lane
+FORCE_INLINE void laneTerms(const EvalLanes* lanes, int side, int l, int counts[EVAL_TERM_COUNT]) {
+    const Bitboard notA = ~fileBB(0), notH = ~fileBB(7), notAB = notA & ~fileBB(1), notGH = notH & ~fileBB(6);
+    const Bitboard centerSquares = squareBB(squareIndex(3, 3)) | squareBB(squareIndex(3, 4))
+                                 | squareBB(squareIndex(4, 3)) | squareBB(squareIndex(4, 4));
+    Bitboard empty = ~lanes->occupied[l];
+    Bitboard pawns = lanes->pieces[SIDE_PIECE(side, WHITE_PAWN)][l], knights = lanes->pieces[SIDE_PIECE(side, WHITE_KNIGHT)][l];
+    Bitboard bishops = lanes->pieces[SIDE_PIECE(side, WHITE_BISHOP)][l], queens = lanes->pieces[SIDE_PIECE(side, WHITE_QUEEN)][l];
+    Bitboard king = lanes->pieces[SIDE_PIECE(side, WHITE_KING)][l];
+    Bitboard diagonal = bishops | queens, straight = lanes->pieces[SIDE_PIECE(side, WHITE_ROOK)][l] | queens;
+
+    Bitboard left = side == 0 ? (pawns & notA) << 7 : (pawns & notA) >> 9;
+    Bitboard right = side == 0 ? (pawns & notH) << 9 : (pawns & notH) >> 7;
+    Bitboard push = (side == 0 ? pawns << 8 : pawns >> 8) & empty;
+    Bitboard doublePush = (side == 0 ? (push & (0xFFULL << 16)) << 8 : (push & (0xFFULL << 40)) >> 8) & empty;
+    Bitboard targets = lanes->pawnTargets[side][l];
+    Bitboard attacked = left | right, mobility = byteCounts(push) + byteCounts(doublePush)
+                                               + byteCounts(left & targets) + byteCounts(right & targets);
+    // 21 sets in all, at most 168 a byte
+    addAttacks(slideAttacks(straight, empty, 8, ~(Bitboard)0), &attacked, &mobility);
+    addAttacks(slideAttacks(straight, empty, -8, ~(Bitboard)0), &attacked, &mobility);
+    addAttacks(slideAttacks(straight, empty, 1, notA), &attacked, &mobility);
+    addAttacks(slideAttacks(straight, empty, -1, notH), &attacked, &mobility);
+    addAttacks(slideAttacks(diagonal, empty, 9, notA), &attacked, &mobility);
+    addAttacks(slideAttacks(diagonal, empty, 7, notH), &attacked, &mobility);
+    addAttacks(slideAttacks(diagonal, empty, -7, notA), &attacked, &mobility);
+    addAttacks(slideAttacks(diagonal, empty, -9, notH), &attacked, &mobility);
+    addAttacks((knights << 17) & notA, &attacked, &mobility);
+    addAttacks((knights << 15) & notH, &attacked, &mobility);
+    addAttacks((knights << 10) & notAB, &attacked, &mobility);
+    addAttacks((knights << 6) & notGH, &attacked, &mobility);
+    addAttacks((knights >> 6) & notAB, &attacked, &mobility);
+    addAttacks((knights >> 10) & notGH, &attacked, &mobility);
+    addAttacks((knights >> 15) & notA, &attacked, &mobility);
+    addAttacks((knights >> 17) & notH, &attacked, &mobility);
+    addAttacks(king << 8 | king >> 8 | ((king << 1 | king << 9 | king >> 7) & notA) | ((king >> 1 | king >> 9 | king << 7) & notH),
+               &attacked, &mobility);
+
+    // evaluatePawnStructure's spans: a doubled pawn is one more pawn than files with pawns on
+    Bitboard otherPawns = lanes->pieces[SIDE_PIECE(side ^ 1, WHITE_PAWN)][l];
+    PawnSpans spans = side == 0 ? pawnSpans(pawns, otherPawns) : pawnSpans(SDL_Swap64(pawns), SDL_Swap64(otherPawns));
+    Bitboard front = side == 0 ? king << 8 | (king & notH) << 9 | (king & notA) << 7
+                               : king >> 8 | (king & notA) >> 9 | (king & notH) >> 7;
+    counts[EVAL_TERM_MOBILITY] = byteSum(mobility);
+    counts[EVAL_TERM_CENTER] = byteSum(byteCounts(attacked & centerSquares));
+    counts[EVAL_TERM_DOUBLED] = byteSum(byteCounts(pawns)) - byteSum(byteCounts(spans.files));
+    counts[EVAL_TERM_ISOLATED] = byteSum(byteCounts(spans.isolated));
+    counts[EVAL_TERM_PASSED] = byteSum(byteCounts(spans.passed & PASSED_RANK_1) + 2 * byteCounts(spans.passed & PASSED_RANK_2)
+                                       + 4 * byteCounts(spans.passed & PASSED_RANK_4));
+    counts[EVAL_TERM_BACKWARD] = byteSum(byteCounts(spans.backward));
+    counts[EVAL_TERM_CANDIDATE] = byteSum(byteCounts(spans.candidate));
+    counts[EVAL_TERM_BISHOP_PAIR] = byteSum(byteCounts(bishops)) >= 2;
+    counts[EVAL_TERM_SHIELD] = byteSum(byteCounts(front & pawns));
+}
+
+// positions[0..n) into the lanes and their terms counted, n at most EVAL_BATCH_LANES
+FORCE_INLINE void fillLanes(EvalLanes* lanes, const ChessState* positions, int n) {
+    for (int l = 0; l < EVAL_BATCH_LANES; l++) { // a short group fills its spare lanes with its last position
+        const ChessState* chess = &positions[SDL_min(l, n - 1)];
+        for (int p = 0; p < PIECE_TYPE_COUNT; p++) lanes->pieces[p][l] = chess->pieceBB[p];
+        lanes->occupied[l] = chess->occupied;
+        Bitboard passant = chess->enPassantCol < 0 ? 0 : squareBB(squareIndex(chess->whiteToMove ? 5 : 2, chess->enPassantCol));
+        lanes->pawnTargets[0][l] = chess->occupied | (chess->whiteToMove ? passant : 0);
+        lanes->pawnTargets[1][l] = chess->occupied | (chess->whiteToMove ? 0 : passant);
+    }
+    for (int l = 0; l < EVAL_BATCH_LANES; l++) {
+        int white[EVAL_TERM_COUNT], black[EVAL_TERM_COUNT];
+        laneTerms(lanes, 0, l, white);
+        laneTerms(lanes, 1, l, black);
+        for (int t = 0; t < EVAL_TERM_COUNT; t++) lanes->terms[t][l] = white[t] - black[t];
+        // every one of the endings has a lone king, or no pawns, rooks or queens
+        Bitboard whitePieces = lanes->pieces[WHITE_PAWN][l] | lanes->pieces[WHITE_KNIGHT][l] | lanes->pieces[WHITE_BISHOP][l]
+                             | lanes->pieces[WHITE_ROOK][l] | lanes->pieces[WHITE_QUEEN][l];
+        Bitboard blackPieces = lanes->pieces[BLACK_PAWN][l] | lanes->pieces[BLACK_KNIGHT][l] | lanes->pieces[BLACK_BISHOP][l]
+                             | lanes->pieces[BLACK_ROOK][l] | lanes->pieces[BLACK_QUEEN][l];
+        Bitboard heavy = lanes->pieces[WHITE_PAWN][l] | lanes->pieces[WHITE_ROOK][l] | lanes->pieces[WHITE_QUEEN][l]
+                       | lanes->pieces[BLACK_PAWN][l] | lanes->pieces[BLACK_ROOK][l] | lanes->pieces[BLACK_QUEEN][l];
+        lanes->general[l] = heavy != 0 && whitePieces != 0 && blackPieces != 0;
+    }
+}
+
+// whether a position's score is the linear sum: not one of the endings evaluateMaterial picks out
+static bool laneIsGeneral(const EvalLanes* lanes, int l, const ChessState* chess, MaterialEntry* material) {
+    if (lanes->general[l]) return true;
+    *material = probeMaterial(chess, NULL);
+    return material->ending == ENDING_GENERAL;
+}
+
+FORCE_INLINE void evaluateBatchWith(const ChessState* positions, int count, int* scores) {
+    EvalLanes lanes;
+    for (int first = 0; first < count; first += EVAL_BATCH_LANES) {
+        int n = SDL_min(count - first, EVAL_BATCH_LANES);
+        fillLanes(&lanes, positions + first, n);
+        for (int l = 0; l < n; l++) {
+            const ChessState* chess = &positions[first + l];
+            MaterialEntry material;
+            if (!laneIsGeneral(&lanes, l, chess, &material)) {
+                scores[first + l] = evaluateEnding(chess, &material, taperedValue(chess->psq, chess->phase));
+                continue;
+            }
+            int untapered = 0;
+            for (int t = 0; t < EVAL_TERM_SHIELD; t++) untapered += EVAL_TERM_WEIGHTS[t] * lanes.terms[t][l];
+            PackedScore shield = PACK_SCORE(EVAL_TERM_WEIGHTS[EVAL_TERM_SHIELD] * lanes.terms[EVAL_TERM_SHIELD][l], 0);
+            scores[first + l] = taperedValue(chess->psq + shield, chess->phase) + untapered;
+        }
+    }
+}
+
+static void evaluateBatchBaseline(const ChessState* positions, int count, int* scores) {
+    evaluateBatchWith(positions, count, scores);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static void evaluateBatchAvx2(const ChessState* positions, int count, int* scores) {
+    evaluateBatchWith(positions, count, scores);
+}
+#endif
+
+static void (*evaluateBatchKernel)(const ChessState* positions, int count, int* scores) = evaluateBatchBaseline;
+
+void evaluateBatch(const ChessState* positions, int count, int* scores) {
+    evaluateBatchKernel(positions, count, scores);
+}
+
+// the lanes' counts, and the pieces by the entries of the tables they score with (see EVAL_TABLE_PARAMS)
+void evalFeatures(const ChessState* positions, int count, EvalFeatures* features) {
+    EvalLanes lanes;
+    for (int first = 0; first < count; first += EVAL_BATCH_LANES) {
+        int n = SDL_min(count - first, EVAL_BATCH_LANES);
+        fillLanes(&lanes, positions + first, n);
+        for (int l = 0; l < n; l++) {
+            const ChessState* chess = &positions[first + l];
+            EvalFeatures* f = &features[first + l];
+            MaterialEntry material;
+            *f = (EvalFeatures){ .linear = laneIsGeneral(&lanes, l, chess, &material) };
+            f->weight = (Uint16)PHASE_WEIGHT[SDL_min(chess->phase, PHASE_MAX)];
+            for (int t = 0; t < EVAL_TERM_COUNT; t++) f->terms[t] = (Sint16)lanes.terms[t][l];
+            int materialSum = 0;
+            for (PieceType p = WHITE_PAWN; p <= BLACK_KING; p++) {
+                int kind = pieceKind(p);
+                if (kind == EMPTY || kind > WHITE_KING) continue;
+                for (Bitboard b = chess->pieceBB[p]; b;) {
+                    int sq = popLsb(&b);
+                    materialSum += isWhite(p) ? PIECE_VALUES[p] * 100 : -PIECE_VALUES[p] * 100;
+                    if (f->pieceCount == SDL_arraysize(f->pieces)) { f->linear = false; continue; }
+                    int entry = (kind - 1) * 64 + (isWhite(p) ? sq : sq ^ 56);
+                    f->pieces[f->pieceCount++] = (Sint16)(isWhite(p) ? entry : ~entry);
+                }
+            }
+            f->material = (Sint16)materialSum;
+        }
+    }
+}
+
+void evalParams(int params[EVAL_PARAM_COUNT]) {
+    for (int kind = WHITE_PAWN; kind <= WHITE_KING; kind++)
+        for (int sq = 0; sq < 64; sq++) { // PIECE_SQUARE_VALUE rather than PIECE_TABLES, which gentables builds leave out
+            PackedScore s = PIECE_SQUARE_VALUE[kind][sq];
+            params[(kind - 1) * 64 + sq] = mgValue(s) - PIECE_VALUES[kind] * 100;
+            params[6 * 64 + (kind - 1) * 64 + sq] = egValue(s) - PIECE_VALUES[kind] * 100;
+        }
+    for (int t = 0; t < EVAL_TERM_COUNT; t++) params[EVAL_TABLE_PARAMS + t] = EVAL_TERM_WEIGHTS[t];
+}
+
+void makeMove(ChessState* chess, Move move, void* _undo) {
+    TRACE_HOT_BEGIN(making);
+    UndoInfo undoLocal;
+    UndoInfo* undo = (UndoInfo*)_undo;
+    if (!undo) undo = &undoLocal;
+    undo->castlingRights = chess->castlingRights;
+    undo->enPassantCol = chess->enPassantCol;
+    undo->hashKey = chess->hashKey;
+    undo->halfmoveClock = chess->halfmoveClock;
+    undo->pawnKey = chess->pawnKey;
+    undo->psq = chess->psq;
+    undo->phase = chess->phase;
+    chess->keyHistory[chess->keyCount & (KEY_HISTORY_SIZE - 1)] = chess->hashKey;
+    chess->keyCount++;
+    chess->hashKey ^= stateKey(chess->castlingRights, chess->enPassantCol); // state part re-added below
+    int from = moveFrom(move), to = moveTo(move);
+    int fromRow = from >> 3, fromCol = from & 7, toRow = to >> 3, toCol = to & 7;
+    undo->capturedPiece = chess->board[to];
+    PieceType moving = chess->board[from];
+    bool irreversible = moving == WHITE_PAWN || moving == BLACK_PAWN || undo->capturedPiece != EMPTY || isEnPassantMove(move);
+    chess->halfmoveClock = irreversible ? 0 : chess->halfmoveClock + 1;
+    if (isCastlingMove(move)) {
+        int rookFromCol = (toCol == 6) ? 7 : 0;
+        int rookToCol   = (toCol == 6) ? 5 : 3;
+        setSquare(chess, fromRow, rookToCol, pieceAt(chess, fromRow, rookFromCol));
+        setSquare(chess, fromRow, rookFromCol, EMPTY);
+    }
+
+    if (isEnPassantMove(move)) {
+        int capturedRow = isWhite(moving) ? toRow - 1 : toRow + 1;
+        undo->capturedRow = capturedRow;
+        undo->capturedCol = toCol;
+        undo->capturedPiece = pieceAt(chess, capturedRow, toCol);
+        setSquare(chess, capturedRow, toCol, EMPTY);
+    }
+
+    if (isPromotionMove(move)) moving = promotionPiece(move, isWhite(moving));
+
+    chess->enPassantCol = moveFlags(move) == MOVE_DOUBLE_PUSH ? fromCol : -1;
+
+    if (moving == WHITE_KING) chess->kingSquare[0] = to;
+    else if (moving == BLACK_KING) chess->kingSquare[1] = to;
+    chess->castlingRights &= CASTLE_MASK[from] & CASTLE_MASK[to];
+
+    setSquare(chess, toRow, toCol, moving);
+    setSquare(chess, fromRow, fromCol, EMPTY);
+    if (!chess->whiteToMove) chess->fullmoveNumber++;
+    chess->whiteToMove = !chess->whiteToMove;
+    chess->hashKey ^= stateKey(chess->castlingRights, chess->enPassantCol) ^ ZOBRIST_BLACK_TO_MOVE;
+    TRACE_HOT_END(making, TRACE_MAKE);
+}
+
+void unmakeMove(ChessState* chess, Move move, void* _undo) {
+    UndoInfo* undo = (UndoInfo*)_undo;
+    if (!undo) return;
+    TRACE_HOT_BEGIN(unmaking);
+    chess->whiteToMove = !chess->whiteToMove;
+    if (!chess->whiteToMove) chess->fullmoveNumber--;
+    int from = moveFrom(move), to = moveTo(move);
+    int fromRow = from >> 3, fromCol = from & 7, toRow = to >> 3, toCol = to & 7;
+    PieceType moving = chess->board[to];
+    if (isPromotionMove(move)) moving = isWhite(moving) ? WHITE_PAWN : BLACK_PAWN;
+    setSquare(chess, fromRow, fromCol, moving);
+    setSquare(chess, toRow, toCol, isEnPassantMove(move) ? EMPTY : undo->capturedPiece);
+    if (moving == WHITE_KING) chess->kingSquare[0] = from;
+    else if (moving == BLACK_KING) chess->kingSquare[1] = from;
+    if (isCastlingMove(move)) {
+        int rookFromCol = (toCol == 6) ? 7 : 0;
+        int rookToCol   = (toCol == 6) ? 5 : 3;
+        setSquare(chess, fromRow, rookFromCol, pieceAt(chess, fromRow, rookToCol));
+        setSquare(chess, fromRow, rookToCol, EMPTY);
+    }
+    if (isEnPassantMove(move)) setSquare(chess, undo->capturedRow, undo->capturedCol, undo->capturedPiece);
+    chess->castlingRights = undo->castlingRights;
+    chess->enPassantCol = undo->enPassantCol;
+    chess->hashKey = undo->hashKey; // setSquare above touched it, the saved key is exact
+    chess->pawnKey = undo->pawnKey; // likewise the pawn key and the evaluation terms
+    chess->psq = undo->psq;
+    chess->phase = undo->phase;
+    chess->halfmoveClock = undo->halfmoveClock;
+    chess->keyCount--;
+    TRACE_HOT_END(unmaking, TRACE_UNMAKE);
+}
+
+// passes the turn for null-move pruning: only the side to move, the en passant file and the key change
+static void makeNullMove(ChessState* chess, UndoInfo* undo) {
+    undo->enPassantCol = chess->enPassantCol;
+    undo->hashKey = chess->hashKey;
+    undo->halfmoveClock = chess->halfmoveClock;
+    chess->keyHistory[chess->keyCount & (KEY_HISTORY_SIZE - 1)] = chess->hashKey;
+    chess->keyCount++;
+    chess->halfmoveClock = 0; // a repetition can't reach back across the pass
+    if (chess->enPassantCol >= 0) chess->hashKey ^= ZOBRIST_EP[chess->enPassantCol];
+    chess->enPassantCol = -1;
+    chess->whiteToMove = !chess->whiteToMove;
+    chess->hashKey ^= ZOBRIST_BLACK_TO_MOVE;
+}
+
+static void unmakeNullMove(ChessState* chess, const UndoInfo* undo) {
+    chess->whiteToMove = !chess->whiteToMove;
+    chess->enPassantCol = undo->enPassantCol;
+    chess->hashKey = undo->hashKey;
+    chess->halfmoveClock = undo->halfmoveClock;
+    chess->keyCount--;
+}
+
+/* Copy-make: the part of the position a move can change is copied aside before makeMove and copied back to take
+   the move back, where unmakeMove reverses it square by square from an UndoInfo. That part is everything before
+   the NNUE accumulators, four cache lines (keyCount is among them, so the repetition ring needs nothing), and the
+   accumulators too once a net is loaded, since setSquare then keeps them current. */
+#define COPY_MAKE_MAX_BYTES offsetof(ChessState, keyHistory)
+
+static inline size_t copyMakeBytes(void) {
+    return nnueNet.loaded ? offsetof(ChessState, keyHistory) : offsetof(ChessState, accumulator);
+}
+
+static inline void copyMake(ChessState* chess, Move move, Uint8 saved[COPY_MAKE_MAX_BYTES]) {
+    SDL_memcpy(saved, chess, copyMakeBytes());
+    makeMove(chess, move, NULL);
+}
+
+static inline void copyUnmake(ChessState* chess, const Uint8 saved[COPY_MAKE_MAX_BYTES]) {
+    SDL_memcpy(chess, saved, copyMakeBytes());
+}
+
+// the current position already occurred since the last irreversible move (same side to move, so every other key)
+static bool isRepetition(const ChessState* chess) {
+    int oldest = SDL_max(chess->keyCount - SDL_min(chess->halfmoveClock, KEY_HISTORY_SIZE), 0);
+    for (int i = chess->keyCount - 2; i >= oldest; i -= 2)
+        if (chess->keyHistory[i & (KEY_HISTORY_SIZE - 1)] == chess->hashKey) return true;
+    return false;
+}
+
+/* Upcoming repetitions, by cuckoo tables (Marcel van Kervinck's method): every move of a knight, bishop, rook, queen
+   or king between two squares on an empty board, 3668 of them, by the change it makes to the key (the piece off one
+   square and onto the other, and the side to move). The change is the same either way round, so each is kept once,
+   from the lower square. Two slots a key, CUCKOO_SIZE of them; a key that finds both taken pushes one out to its
+   other slot. */
+#define CUCKOO_SIZE 8192
+
+TABLE Uint64 CUCKOO_KEYS[CUCKOO_SIZE];
+TABLE Move CUCKOO_MOVES[CUCKOO_SIZE];
+
+static inline int cuckooSlot1(Uint64 key) { return (int)(key & (CUCKOO_SIZE - 1)); }
+static inline int cuckooSlot2(Uint64 key) { return (int)((key >> 16) & (CUCKOO_SIZE - 1)); }
+
+static void initCuckooTables(void) {
+#if !defined(TABLES_GENERATED)
+    for (PieceType p = WHITE_KNIGHT; p <= BLACK_KING; p++) {
+        int kind = pieceKind(p);
+        if (kind == EMPTY || kind == WHITE_PAWN || kind > WHITE_KING) continue;
+        for (int s1 = 0; s1 < 64; s1++) {
+            Bitboard targets = kind == WHITE_KNIGHT ? KNIGHT_ATTACKS[s1] : kind == WHITE_BISHOP ? bishopAttacks(s1, 0)
+                             : kind == WHITE_ROOK ? rookAttacks(s1, 0) : kind == WHITE_QUEEN ? queenAttacks(s1, 0) : KING_ATTACKS[s1];
+            for (Bitboard t = targets & ~(squareBB(s1) | (squareBB(s1) - 1)); t;) {
+                int s2 = popLsb(&t);
+                Uint64 key = ZOBRIST_PIECE[p][s1] ^ ZOBRIST_PIECE[p][s2] ^ ZOBRIST_BLACK_TO_MOVE;
+                Move move = packMove(s1, s2, MOVE_QUIET);
+                for (int slot = cuckooSlot1(key);;) {
+                    Uint64 oldKey = CUCKOO_KEYS[slot];
+                    Move oldMove = CUCKOO_MOVES[slot];
+                    CUCKOO_KEYS[slot] = key;
+                    CUCKOO_MOVES[slot] = move;
+                    if (oldMove == MOVE_NONE) break;
+                    key = oldKey, move = oldMove;
+                    slot = slot == cuckooSlot1(key) ? cuckooSlot2(key) : cuckooSlot1(key);
+                }
+            }
+        }
+    }
+#endif
+}
+
+/* The side to move has a reversible move back into a position of the last halfmoveClock plies, with the same side
+   to move, which isRepetition then scores as a draw: the key an odd number of plies back differs from this one by
+   one piece's move and the side, which the cuckoo tables know. The squares between have to be clear and the piece
+   the mover's; whether the move leaves its king in check isn't asked. O(1) a key looked back over, no moves made. */
+static bool upcomingRepetition(const ChessState* chess) {
+    int end = SDL_min(SDL_min(chess->halfmoveClock, KEY_HISTORY_SIZE), chess->keyCount);
+    for (int i = 3; i <= end; i += 2) {
+        Uint64 moveKey = chess->hashKey ^ chess->keyHistory[(chess->keyCount - i) & (KEY_HISTORY_SIZE - 1)];
+        int slot = cuckooSlot1(moveKey);
+        if (CUCKOO_KEYS[slot] != moveKey && CUCKOO_KEYS[slot = cuckooSlot2(moveKey)] != moveKey) continue;
+        int s1 = moveFrom(CUCKOO_MOVES[slot]), s2 = moveTo(CUCKOO_MOVES[slot]);
+        if (BETWEEN[s1][s2] & chess->occupied) continue;
+        PieceType piece = chess->board[chess->board[s1] != EMPTY ? s1 : s2];
+        if (piece != EMPTY && (pieceColor(piece) == 0) == chess->whiteToMove) return true;
+    }
+    return false;
+}
+
+/* Transposition table shared by every thread of a search. Lockless: each entry stores key ^ data next to data,
+   so a torn write from two threads racing on one slot just fails the key check on the next probe. A key maps to
+   a bucket of four entries filling one cache line, so a probe costs a single miss however many it looks at.
+   CHESS_LOW_MEMORY packs an entry into one word instead, the key's top 16 bits beside a 16-bit score, eight to
+   the line: twice the entries in the same memory, and a write that can't tear, for more false hits on the key. */
+typedef enum { TT_NONE, TT_EXACT, TT_LOWER, TT_UPPER } TTBound;
+
+#define TT_GENERATIONS 64 // the generation wraps around in its 6 bits
+
+#if defined(CHESS_LOW_MEMORY)
+struct TTEntry {
+    Uint64 data; // move (16) | score (16) | depth (8) | bound (2) | generation (6) | key >> 48 (16)
+};
+
+#define TT_BUCKET_ENTRIES 8
+SDL_COMPILE_TIME_ASSERT(ttScoreBits, MATE_SCORE + MAX_PLY <= SDL_MAX_SINT16);
+
+static inline Uint64 ttPack(Move move, int score, int depth, TTBound bound, int generation) {
+    score = SDL_clamp(score, -SDL_MAX_SINT16, SDL_MAX_SINT16);
+    return (Uint64)move | ((Uint64)(Uint16)score << 16) | ((Uint64)(depth & 0xFF) << 32) | ((Uint64)bound << 40)
+           | ((Uint64)(generation & (TT_GENERATIONS - 1)) << 42);
+}
+static inline int ttEntryScore(Uint64 data) { return (Sint16)(Uint16)(data >> 16); }
+static inline int ttEntryDepth(Uint64 data) { return (int)((data >> 32) & 0xFF); }
+static inline TTBound ttEntryBound(Uint64 data) { return (TTBound)((data >> 40) & 3); }
+static inline int ttEntryGeneration(Uint64 data) { return (int)((data >> 42) & (TT_GENERATIONS - 1)); }
+
+// the entry's data, and whether it's key's; data is 0 for an empty slot
+static inline bool ttRead(TTEntry* entry, Uint64 key, Uint64* data) {
+    *data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    return *data != 0 && (*data >> 48) == (key >> 48);
+}
+static inline void ttWrite(TTEntry* entry, Uint64 key, Uint64 data) {
+    __atomic_store_n(&entry->data, data | (key & 0xFFFF000000000000ULL), __ATOMIC_RELAXED);
+}
+#else
+struct TTEntry {
+    Uint64 check; // key ^ data
+    Uint64 data;  // move (16) | score (32) | depth (8) | bound (2) | generation (6)
+};
+
+#define TT_BUCKET_ENTRIES 4
+
+static inline Uint64 ttPack(Move move, int score, int depth, TTBound bound, int generation) {
+    return (Uint64)move | ((Uint64)(Uint32)score << 16) | ((Uint64)(depth & 0xFF) << 48) | ((Uint64)bound << 56)
+           | ((Uint64)(generation & (TT_GENERATIONS - 1)) << 58);
+}
+static inline int ttEntryScore(Uint64 data) { return (int)(Sint32)(Uint32)(data >> 16); }
+static inline int ttEntryDepth(Uint64 data) { return (int)((data >> 48) & 0xFF); }
+static inline TTBound ttEntryBound(Uint64 data) { return (TTBound)((data >> 56) & 3); }
+static inline int ttEntryGeneration(Uint64 data) { return (int)(data >> 58); }
+
+static inline bool ttRead(TTEntry* entry, Uint64 key, Uint64* data) {
+    *data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    Uint64 check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+    return (check ^ *data) == key && *data != 0;
+}
+static inline void ttWrite(TTEntry* entry, Uint64 key, Uint64 data) {
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+}
+#endif
+static inline Move ttEntryMove(Uint64 data) { return (Move)(data & 0xFFFF); }
+SDL_COMPILE_TIME_ASSERT(ttBucketSize, sizeof(TTEntry) * TT_BUCKET_ENTRIES == 64);
+
+static inline TTEntry* ttBucket(const TransTable* tt, Uint64 key) {
+    return &tt->entries[key & tt->mask & ~(Uint64)(TT_BUCKET_ENTRIES - 1)];
+}
+
+// starts fetching the line a probe of key will read, for a child whose key makeMove has just worked out
+static inline void ttPrefetch(const TransTable* tt, Uint64 key) {
+    if (tt && tt->entries) __builtin_prefetch(ttBucket(tt, key));
+}
+
+// the hash key makeMove would leave, without making the move: for prefetching a child's bucket before its turn
+static inline Uint64 keyAfterMove(const ChessState* chess, Move move) {
+    int from = moveFrom(move), to = moveTo(move);
+    PieceType moving = chess->board[from], captured = chess->board[to];
+    PieceType placed = isPromotionMove(move) ? promotionPiece(move, isWhite(moving)) : moving;
+    int rights = chess->castlingRights & CASTLE_MASK[from] & CASTLE_MASK[to];
+    int enPassantCol = moveFlags(move) == MOVE_DOUBLE_PUSH ? (from & 7) : -1;
+    Uint64 key = chess->hashKey ^ stateKey(chess->castlingRights, chess->enPassantCol) ^ stateKey(rights, enPassantCol)
+                 ^ ZOBRIST_BLACK_TO_MOVE ^ ZOBRIST_PIECE[moving][from] ^ ZOBRIST_PIECE[captured][to] ^ ZOBRIST_PIECE[placed][to];
+    if (isCastlingMove(move)) {
+        int row = from & ~7, rook = chess->board[row + ((to & 7) == 6 ? 7 : 0)];
+        key ^= ZOBRIST_PIECE[rook][row + ((to & 7) == 6 ? 7 : 0)] ^ ZOBRIST_PIECE[rook][row + ((to & 7) == 6 ? 5 : 3)];
+    }
+    if (isEnPassantMove(move)) {
+        int taken = isWhite(moving) ? to - 8 : to + 8;
+        key ^= ZOBRIST_PIECE[chess->board[taken]][taken];
+    }
+    return key;
+}
+
+/* Called as each search starts: what the last ones stored is now older, and the first to go. The table is never
+   cleared between the moves of a game, only by engineNewGame: the last move's results stay to be probed, at
+   their depth, and are written over first as this search needs the room (ttStore). */
+static void ttNewSearch(TransTable* tt) {
+    int next = tt->sharedGeneration ? SDL_AddAtomicInt(tt->sharedGeneration, 1) + 1 : tt->generation + 1;
+    tt->generation = (Uint8)(next & (TT_GENERATIONS - 1));
+}
+
+/* How full the table is, in permille, as UCI's hashfull has it: the share of the first thousand entries written
+   to by the current search. A sample, and read without care for the threads writing as it's taken. */
+#define TT_HASHFULL_SAMPLE 1000
+
+static int ttHashfull(const TransTable* tt) {
+    if (!tt || !tt->entries) return 0;
+    int sample = (int)SDL_min((Uint64)TT_HASHFULL_SAMPLE, tt->mask + 1), used = 0;
+    for (int i = 0; i < sample; i++) {
+        Uint64 data = tt->entries[i].data;
+        if (ttEntryBound(data) != TT_NONE && ttEntryGeneration(data) == tt->generation) used++;
+    }
+    return used * 1000 / sample;
+}
+
+/* The table's memory, zero-filled. Probes land anywhere in it, so with a big table nearly every one misses the
+   TLB; 2 MB pages cover it with 512 times fewer entries. Linux takes them from the reserved pool (MAP_HUGETLB)
+   if there are enough, else asks for transparent huge pages on a 2 MB-aligned mapping; Windows asks for large
+   pages, which needs the "Lock pages in memory" right, and falls back to ordinary ones. Elsewhere, the heap. */
+#define TT_LARGE_PAGE (2 * 1024 * 1024)
+
+static size_t ttMappedSize(size_t bytes) { return (bytes + TT_LARGE_PAGE - 1) & ~(size_t)(TT_LARGE_PAGE - 1); }
+
+#if defined(_WIN32)
+// SeLockMemoryPrivilege: the account has to hold it before the process can switch it on
+static bool enableLockMemoryPrivilege(void) {
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+    TOKEN_PRIVILEGES privileges = { .PrivilegeCount = 1 };
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool ok = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)
+              && AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) && GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return ok;
+}
+#endif
+
+static void* ttAllocPages(size_t bytes, TTPages* pages) {
+#if defined(_WIN32)
+    static int privileged = -1; // looked up the first time
+    if (privileged < 0) privileged = enableLockMemoryPrivilege();
+    SIZE_T large = GetLargePageMinimum();
+    if (privileged && large > 0) {
+        void* p = VirtualAlloc(NULL, (bytes + large - 1) & ~(large - 1), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p) { *pages = TT_PAGES_LARGE; return p; }
+    }
+    *pages = TT_PAGES_NORMAL;
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(__linux__)
+    size_t size = ttMappedSize(bytes);
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) { *pages = TT_PAGES_LARGE; return p; }
+    char* raw = mmap(NULL, size + TT_LARGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char* start = (char*)(((uintptr_t)raw + TT_LARGE_PAGE - 1) & ~(uintptr_t)(TT_LARGE_PAGE - 1));
+    if (start > raw) munmap(raw, (size_t)(start - raw)); // trimmed to the aligned part, so every page can be huge
+    if (raw + TT_LARGE_PAGE > start) munmap(start + size, (size_t)(raw + TT_LARGE_PAGE - start));
+    *pages = madvise(start, size, MADV_HUGEPAGE) == 0 ? TT_PAGES_TRANSPARENT : TT_PAGES_NORMAL;
+    return start;
+#else
+    *pages = TT_PAGES_HEAP;
+    void* p = SDL_aligned_alloc(64, bytes); // on a line of its own, as the buckets need
+    if (p) SDL_memset(p, 0, bytes);
+    return p;
+#endif
+}
+
+static void ttFreePages(void* p, size_t bytes, TTPages pages) {
+    if (!p) return;
+#if defined(_WIN32)
+    (void)bytes; (void)pages;
+    VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    (void)pages;
+    munmap(p, ttMappedSize(bytes));
+#else
+    (void)bytes; (void)pages;
+    SDL_aligned_free(p);
+#endif
+}
+
+/* Shared tables (ttShare): a named shared-memory segment holding a header and then the entries, mapped by every
+   engine process on the host that names it, which then probe and store into it with the same lockless scheme the
+   threads of one process use. The first process creates it at the size it asks for; later ones take it at the
+   size it has. The segment outlasts its processes until the host restarts (or someone removes /dev/shm/NAME),
+   Windows' until the last process unmaps it. */
+#define TT_SHARE_MAGIC 0x48534159414C43ULL // "CLAYSH"
+#define TT_SHARE_VERSION 1
+
+typedef struct {
+    Uint64 magic; // stored last by the creator, so a reader that sees it sees the rest
+    Uint32 version;
+    Uint32 entrySize;
+    Uint64 entries;
+    SDL_AtomicInt generation; // the table's ttNewSearch count
+    Uint8 reserved[36];
+} TTShareHeader;
+SDL_COMPILE_TIME_ASSERT(ttShareHeader, sizeof(TTShareHeader) == 64);
+
+// the creator's header, or the wait for it; false with the error set if the segment isn't one of ours
+static bool ttShareReady(TTShareHeader* header, bool created, Uint64 entries, size_t mappedSize) {
+    if (created) {
+        header->version = TT_SHARE_VERSION;
+        header->entrySize = sizeof(TTEntry);
+        header->entries = entries;
+        __atomic_store_n(&header->magic, TT_SHARE_MAGIC, __ATOMIC_RELEASE);
+        return true;
+    }
+    for (int wait = 0; __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != TT_SHARE_MAGIC; wait++) {
+        if (wait == 1000) return SDL_SetError("shared hash table never finished being set up");
+        SDL_Delay(1);
+    }
+    if (header->version != TT_SHARE_VERSION || header->entrySize != sizeof(TTEntry))
+        return SDL_SetError("shared hash table belongs to another version of the engine");
+    if (header->entries < TT_BUCKET_ENTRIES || (header->entries & (header->entries - 1))
+        || mappedSize < sizeof(TTShareHeader) + header->entries * sizeof(TTEntry))
+        return SDL_SetError("shared hash table is damaged");
+    return true;
+}
+
+static void ttRelease(TransTable* tt) {
+    if (tt->entries && tt->pages == TT_PAGES_SHARED) {
+        TTShareHeader* header = (TTShareHeader*)tt->entries - 1;
+#if defined(_WIN32)
+        UnmapViewOfFile(header);
+        CloseHandle(tt->sharedHandle);
+#elif defined(__unix__) || defined(__APPLE__)
+        munmap(header, sizeof(TTShareHeader) + (size_t)(tt->mask + 1) * sizeof(TTEntry));
+#endif
+    } else if (tt->entries) {
+        ttFreePages(tt->entries, (size_t)(tt->mask + 1) * sizeof(TTEntry), tt->pages);
+    }
+    tt->entries = NULL;
+    tt->mask = 0;
+    tt->sharedGeneration = NULL;
+    tt->sharedHandle = NULL;
+}
+
+// moves the table into the segment called name, megabytes in size if this creates it; false keeps the old table
+bool ttShare(TransTable* tt, const char* name, size_t megabytes) {
+    Uint64 entries = 1;
+    while (entries * 2 * sizeof(TTEntry) <= (Uint64)megabytes * 1024 * 1024) entries *= 2;
+    entries = SDL_max(entries, TT_BUCKET_ENTRIES);
+    size_t size = sizeof(TTShareHeader) + (size_t)entries * sizeof(TTEntry);
+    TTShareHeader* header = NULL;
+    bool created;
+    void* handle = NULL;
+#if defined(_WIN32)
+    char path[96];
+    SDL_snprintf(path, sizeof(path), "Local\\sdl-clay-chess-%s", name);
+    handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((Uint64)size >> 32), (DWORD)size, path);
+    if (!handle) return SDL_SetError("can't open shared memory %s (error %lu)", path, GetLastError());
+    created = GetLastError() != ERROR_ALREADY_EXISTS;
+    header = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0); // all of it, whatever size its creator gave it
+    MEMORY_BASIC_INFORMATION region;
+    if (!header || !VirtualQuery(header, &region, sizeof(region))) {
+        if (header) UnmapViewOfFile(header);
+        CloseHandle(handle);
+        return SDL_SetError("can't map shared memory %s (error %lu)", path, GetLastError());
+    }
+    size_t mappedSize = region.RegionSize;
+#elif defined(__unix__) || defined(__APPLE__)
+    char path[96];
+    SDL_snprintf(path, sizeof(path), "/sdl-clay-chess-%s", name);
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    created = fd >= 0;
+    if (!created && errno == EEXIST) fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0) return SDL_SetError("can't open shared memory %s: %s", path, strerror(errno));
+    struct stat st;
+    if (created ? ftruncate(fd, (off_t)size) != 0 : fstat(fd, &st) != 0) {
+        SDL_SetError("can't size shared memory %s: %s", path, strerror(errno));
+        close(fd);
+        if (created) shm_unlink(path);
+        return false;
+    }
+    for (int wait = 0; !created && st.st_size < (off_t)sizeof(TTShareHeader) && wait < 1000; wait++) {
+        SDL_Delay(1); // the creator hasn't sized it yet
+        fstat(fd, &st);
+    }
+    size_t mappedSize = created ? size : (size_t)st.st_size;
+    void* view = mappedSize >= sizeof(TTShareHeader) ? mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (view == MAP_FAILED) return SDL_SetError("can't map shared memory %s", path);
+    header = view;
+#if defined(MADV_HUGEPAGE)
+    madvise(view, mappedSize, MADV_HUGEPAGE); // honoured if the host allows huge pages in shared memory
+#endif
+#else
+    (void)size; (void)created; (void)handle;
+    return SDL_SetError("no shared memory on this platform");
+#endif
+#if defined(_WIN32) || defined(__unix__) || defined(__APPLE__)
+    if (!ttShareReady(header, created, entries, mappedSize)) {
+#if defined(_WIN32)
+        UnmapViewOfFile(header);
+        CloseHandle(handle);
+#else
+        munmap(header, mappedSize);
+#endif
+        return false;
+    }
+    ttRelease(tt);
+    tt->entries = (TTEntry*)(header + 1);
+    tt->mask = header->entries - 1;
+    tt->pages = TT_PAGES_SHARED;
+    tt->sharedGeneration = &header->generation;
+    tt->sharedHandle = handle;
+    tt->generation = (Uint8)(SDL_GetAtomicInt(&header->generation) & (TT_GENERATIONS - 1));
+    SDL_Log("Hash table: %d MB shared as %s (%s)", (int)(header->entries * sizeof(TTEntry) >> 20), name,
+            created ? "created" : "joined");
+    return true;
+#endif
+}
+
+// (re)allocates the table, returns false (and keeps the old one) if the memory isn't there
+bool ttResize(TransTable* tt, size_t megabytes) {
+    static const char* const PAGE_NAMES[] = { "heap", "4 KB", "transparent huge", "2 MB large" };
+    static SDL_AtomicInt reported = { -1 }; // the kind last logged, so a batch of engines logs it once
+    Uint64 entries = 1;
+    while (entries * 2 * sizeof(TTEntry) <= (Uint64)megabytes * 1024 * 1024) entries *= 2;
+    entries = SDL_max(entries, TT_BUCKET_ENTRIES);
+    TTPages pages;
+    TTEntry* table = ttAllocPages((size_t)entries * sizeof(TTEntry), &pages);
+    if (!table) return false;
+    ttRelease(tt);
+    tt->entries = table;
+    tt->mask = entries - 1;
+    tt->pages = pages;
+    if (SDL_SetAtomicInt(&reported, (int)pages) != (int)pages)
+        SDL_Log("Hash table: %d MB in %s pages", (int)(entries * sizeof(TTEntry) >> 20), PAGE_NAMES[pages]);
+    return true;
+}
+
+void ttClear(TransTable* tt) {
+    if (tt->entries) SDL_memset(tt->entries, 0, (size_t)(tt->mask + 1) * sizeof(TTEntry));
+}
+
+void ttFree(TransTable* tt) {
+    ttRelease(tt);
+}
+
+/* Hash files (engineSaveHash): a header, then the entries exactly as they are in memory, so loading one is a
+   copy of the page-ins with nothing to parse. The version changes with the entry layout or the keys; the byte
+   order and entry size are checked too, the file being native. The checksum covers the bytes as written, which
+   lets a table be saved while searches go on writing to it: what lands in the file is a consistent snapshot of
+   each chunk, and any entry torn in the copy just fails its key check later, as in memory. */
+#define TT_FILE_MAGIC "CLAYHASH"
+#define TT_FILE_VERSION 1
+#define TT_FILE_CHUNK (1 << 20)
+
+typedef struct {
+    char magic[8];
+    Uint32 version;
+    Uint32 byteOrder; // 0x01020304 as the writer stored it
+    Uint32 entrySize;
+    Uint32 generation;
+    Uint64 entries;
+    Uint64 checksum; // ttChecksum of the entries
+    Uint8 reserved[24];
+} TTFileHeader;
+SDL_COMPILE_TIME_ASSERT(ttFileHeader, sizeof(TTFileHeader) == 64); // the entries stay line-aligned in the file
+
+// one multiply a word; catches a damaged or truncated file, which is all it is for
+static Uint64 ttChecksum(Uint64 hash, const void* data, size_t bytes) {
+    const Uint8* p = data;
+    for (size_t i = 0; i + 8 <= bytes; i += 8) {
+        Uint64 word;
+        SDL_memcpy(&word, p + i, 8);
+        hash = ((hash << 5 | hash >> 59) ^ word) * 0x9E3779B97F4A7C15ULL;
+    }
+    return hash;
+}
+
+bool ttSave(const TransTable* tt, const char* path) {
+    if (!tt->entries) return SDL_SetError("no hash table");
+    SDL_IOStream* out = SDL_IOFromFile(path, "wb");
+    Uint8* chunk = SDL_malloc(TT_FILE_CHUNK);
+    if (!out || !chunk) {
+        if (out) SDL_CloseIO(out);
+        SDL_free(chunk);
+        return false;
+    }
+    TTFileHeader header = { .version = TT_FILE_VERSION, .byteOrder = 0x01020304, .entrySize = sizeof(TTEntry),
+                            .generation = tt->generation, .entries = tt->mask + 1 };
+    SDL_memcpy(header.magic, TT_FILE_MAGIC, sizeof(header.magic));
+    bool ok = SDL_WriteIO(out, &header, sizeof(header)) == sizeof(header); // filled in once the checksum is known
+    const Uint8* table = (const Uint8*)tt->entries;
+    size_t size = (size_t)header.entries * sizeof(TTEntry);
+    for (size_t done = 0; ok && done < size; done += TT_FILE_CHUNK) {
+        size_t n = SDL_min(size - done, (size_t)TT_FILE_CHUNK);
+        SDL_memcpy(chunk, table + done, n);
+        header.checksum = ttChecksum(header.checksum, chunk, n);
+        ok = SDL_WriteIO(out, chunk, n) == n;
+    }
+    ok = ok && SDL_SeekIO(out, 0, SDL_IO_SEEK_SET) == 0 && SDL_WriteIO(out, &header, sizeof(header)) == sizeof(header);
+    SDL_free(chunk);
+    return SDL_CloseIO(out) && ok;
+}
+
+// replaces the table with the file's, whatever its size; false (and the table left as it was) if it won't do
+bool ttLoad(TransTable* tt, const char* path) {
+    MappedFile file;
+    if (!mapFile(&file, path)) return false;
+    TTFileHeader header;
+    bool ok = file.size >= sizeof(header);
+    if (ok) SDL_memcpy(&header, file.data, sizeof(header));
+    Uint64 entries = ok ? header.entries : 0;
+    if (!ok || SDL_memcmp(header.magic, TT_FILE_MAGIC, sizeof(header.magic)) != 0) ok = SDL_SetError("not a hash file");
+    else if (header.version != TT_FILE_VERSION || header.byteOrder != 0x01020304 || header.entrySize != sizeof(TTEntry))
+        ok = SDL_SetError("hash file from another version of the engine or another machine");
+    else if (entries < TT_BUCKET_ENTRIES || (entries & (entries - 1)) || file.size - sizeof(header) != entries * sizeof(TTEntry))
+        ok = SDL_SetError("hash file is truncated or damaged");
+    TTPages pages;
+    size_t size = (size_t)entries * sizeof(TTEntry);
+    Uint8* table = ok ? ttAllocPages(size, &pages) : NULL;
+    if (ok && !table) ok = SDL_OutOfMemory();
+    Uint64 checksum = 0;
+    for (size_t done = 0; ok && done < size; done += TT_FILE_CHUNK) { // checked as it is copied, one pass over the file
+        size_t n = SDL_min(size - done, (size_t)TT_FILE_CHUNK);
+        checksum = ttChecksum(checksum, file.data + sizeof(header) + done, n);
+        SDL_memcpy(table + done, file.data + sizeof(header) + done, n);
+    }
+    unmapFile(&file);
+    if (ok && checksum != header.checksum) ok = SDL_SetError("hash file checksum doesn't match");
+    if (!ok) {
+        if (table) ttFreePages(table, size, pages);
+        return false;
+    }
+    ttRelease(tt);
+    tt->entries = (TTEntry*)table;
+    tt->mask = entries - 1;
+    tt->pages = pages;
+    tt->generation = (Uint8)(header.generation & (TT_GENERATIONS - 1));
+    return true;
+}
+
+/* Mate scores are stored relative to the node ("mate in n from here") rather than the root, so an entry stays
+   right when the position turns up again at a different ply. */
+static inline int scoreToTT(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static inline int scoreFromTT(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+// true on a hit; *move, *score, *depth and *bound are only written then
+static bool ttProbe(const TransTable* tt, Uint64 key, int ply, Move* move, int* score, int* depth, TTBound* bound) {
+    if (!tt || !tt->entries) return false;
+    TTEntry* bucket = ttBucket(tt, key);
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        Uint64 data;
+        if (!ttRead(&bucket[i], key, &data)) continue;
+        *move = ttEntryMove(data);
+        *score = scoreFromTT(ttEntryScore(data), ply);
+        *depth = ttEntryDepth(data);
+        *bound = ttEntryBound(data);
+        return true;
+    }
+    return false;
+}
+
+/* Goes in the bucket's slot for the same position, which keeps a deeper result from this search; otherwise over
+   the entry worth least, an empty one first, then by depth less eight plies for every search since it was
+   stored, so a deep line from an old search doesn't hold its slot forever. */
+static void ttStore(TransTable* tt, Uint64 key, int ply, Move move, int score, int depth, TTBound bound) {
+    if (!tt || !tt->entries) return;
+    TTEntry* bucket = ttBucket(tt, key);
+    TTEntry* victim = NULL;
+    int victimWorth = SDL_MAX_SINT32;
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        Uint64 oldData;
+        bool same = ttRead(&bucket[i], key, &oldData);
+        int oldDepth = ttEntryDepth(oldData);
+        int age = (tt->generation - ttEntryGeneration(oldData)) & (TT_GENERATIONS - 1);
+        if (same) {
+            if (age == 0 && oldDepth > depth) return;
+            victim = &bucket[i];
+            break;
+        }
+        int worth = oldData == 0 ? SDL_MIN_SINT32 : oldDepth - 8 * age;
+        if (worth < victimWorth) { victim = &bucket[i]; victimWorth = worth; }
+    }
+    ttWrite(victim, key, ttPack(move, scoreToTT(score, ply), depth, bound, tt->generation));
+}
+
+// called every TIME_CHECK_NODES nodes, raises the stop flag once the hard deadline has passed
+static void checkSearchTime(Engine* engine) {
+    if (engine->hardTimeNS == 0) return;
+    if (SDL_GetAtomicInt(&engine->pondering)) return; // the user's time: no deadline until the ponder hit
+    Uint64 elapsed = SDL_GetTicksNS() - engine->startNS;
+    bool outOfTime = elapsed >= engine->hardTimeNS;
+    if (outOfTime) SDL_SetAtomicInt(&engine->stop, 1);
+    SEARCH_LOG(engine, SEARCH_LOG_TIME_CHECK, 0, outOfTime, MOVE_NONE, elapsed);
+}
+
+#define HISTORY_MAX (1 << 16) // history scores are halved once one passes this, staying below the capture scores
+#define CONTINUATION_MAX (1 << 14) // continuation history scores tend to +/- this, so they fit an Sint16
+#define HISTORY_REDUCTION_STEP 8192 // a late quiet move is reduced a ply less (more) for each this much (continuation) history
+#define PIECE_TO_COUNT (13 * 64)  // pieceToIndex's range
+
+typedef struct SplitPoint SplitPoint;
+
+#if defined(CHESS_LOW_MEMORY)
+#define SEARCH_STACK_PLIES (MAX_PLY + 16)
+#else
+#define SEARCH_STACK_PLIES (MAX_PLY + 32) // minimaxAB stops at MAX_PLY, quiescence below it at this
+#endif
+#define EXTENSION_LIMIT 16  // plies of check and singular extensions one line can have, so they can't run away
+#define SINGULAR_MARGIN 2   // the singular test's bound: the hash move's score less this many centipawns a ply of depth
+#define PROBCUT_REDUCTION 4 // ProbCut's searches are this much shallower than the node
+
+/* How the search takes its moves back: 1 copy-make (copyMake), 0 make/unmake. The microbench's copymake and
+   makeunmake kernels come out about even, but on x86-64 (v2 and v3 alike) bench searches a fifth faster with
+   make/unmake: the saved copies, one a ply, cost more in cache than unmakeMove's work. So that's the default;
+   -DCOPY_MAKE=1 is there for a processor where it comes out the other way. */
+#if !defined(COPY_MAKE)
+#define COPY_MAKE 0
+#endif
+
+/* A ply's share of the search stack: what a node at this distance from the root works with, kept in the
+   SearchContext rather than in minimaxAB's or quiescence's frame so the frames stay small and nothing is zeroed
+   per node. Each node fills its entry before reading it; only the killers carry over from node to node. */
+typedef struct {
+    Move killers[2];          // quiet moves that caused a beta cutoff at this ply, newest first
+    int moved;                // pieceToIndex of the move being searched from this ply, 0 for a null move
+    Move quiets[64];          // the quiet moves searched here so far without a cutoff, for the history penalty
+    int quietCount;
+#if COPY_MAKE
+    Uint8 saved[COPY_MAKE_MAX_BYTES]; // the position before the move being searched from this ply (searchMakeMove)
+#else
+    UndoInfo undo;            // or what unmakeMove needs to take it back
+#endif
+    Move excluded;            // the hash move, while the node searches the others to see if it's singular
+    MovePicker picker;        // a minimaxAB node's moves
+    MoveList captures;        // or a quiescence node's, with their MVV-LVA scores
+    int order[256];
+} SearchPly;
+
+/* Per-thread search state. Nothing in here is shared between threads, so none of it needs locking. Each engine
+   keeps one for every thread that has searched for it (threadSearchContext), so what it learns carries over. */
+struct SearchContext {
+    SearchPly stack[SEARCH_STACK_PLIES]; // by ply
+    int history[2][64][64];   // [side][from][to], raised by depth^2 whenever that quiet move cuts off
+    Move counterMoves[PIECE_TO_COUNT]; // by the last move's pieceToIndex: the quiet reply that last cut off after it
+    // [earlier move][move], both by pieceToIndex: how well a quiet move did one ply and two plies after another
+    Sint16 continuation[PIECE_TO_COUNT][PIECE_TO_COUNT];
+    int ply;                  // distance of the current node from the root
+    int extensions;           // plies the line to the current node was extended by, at most EXTENSION_LIMIT
+    bool afterNull;           // the move into the current node was a null move (no two in a row)
+    int threadId;             // which split deque is this thread's: 0 for the engine thread
+    SplitPoint* sp;           // innermost split point this thread is working under, NULL if none
+    SDL_AtomicInt* sharedAlpha; // root_worker only: best root score so far, raised by the other root threads
+    int rootAlpha;            // the sharedAlpha the current root move search was started against
+    SDL_AtomicInt* resolved;  // aspiration_worker only: set once another window has the iteration's exact score
+    bool speculative;         // lazy_helper pondering on a reply other than the expected one, done once pondering ends
+    Uint64* nodes;            // this thread's NodeCounter, see bindSearchThread
+    int* selDepth;            // and its deepest ply
+    NodeCounter* counter;     // the whole of it, for the lifetime counts
+    PawnTable* pawns;         // this thread's pawn hash table, likewise
+    EvalCache* evals;         // this thread's evaluation cache, NULL when switched off
+    bool nnue;                // a network is loaded and switched on: it replaces evaluatePosition
+    bool tablebases;          // probe the endgame tablebases
+#if defined(SEARCH_STATS)
+    SearchStats* stats;       // this thread's block of the engine's statistics
+#endif
+#if defined(SEARCH_TREE)
+    SearchTreeRecord* tree;   // the record of the minimaxAB node under way, sampled or not
+#endif
+    Uint32 searchId;          // the engine's search it was last taken for
+};
+
+#if defined(SEARCH_STATS)
+#define STAT(ctx, counter) ((ctx)->stats->counter++)
+#else
+#define STAT(ctx, counter) ((void)0)
+#endif
+
+// what the node under way did, for its search tree record
+#if defined(SEARCH_TREE)
+#define TREE_END(ctx, how) ((ctx)->tree->outcome = (Uint8)(how))
+#define TREE_FLAG(ctx, flag) ((ctx)->tree->flags |= (Uint8)(flag))
+#define TREE_MOVES(ctx, legal) ((ctx)->tree->moves = (Uint8)SDL_min(legal, 255))
+#define TREE_PRUNED(ctx) ((ctx)->tree->pruned += (ctx)->tree->pruned < 255)
+#define TREE_CUT(ctx, index, picker, move) \
+    ((ctx)->tree->cutIndex = (Uint8)SDL_min(index, 255), (ctx)->tree->cutSource = searchTreeSource(picker, move))
+#else
+#define TREE_END(ctx, how) ((void)0)
+#define TREE_FLAG(ctx, flag) ((void)0)
+#define TREE_MOVES(ctx, legal) ((void)0)
+#define TREE_PRUNED(ctx) ((void)0)
+#define TREE_CUT(ctx, index, picker, move) ((void)0)
+#endif
+
+// a move the node at ctx->ply searches, made and taken back the COPY_MAKE way; one at a time per ply
+static inline void searchMakeMove(SearchContext* ctx, ChessState* chess, Move move) {
+#if COPY_MAKE
+    copyMake(chess, move, ctx->stack[ctx->ply].saved);
+#else
+    makeMove(chess, move, &ctx->stack[ctx->ply].undo);
+#endif
+}
+
+static inline void searchUnmakeMove(SearchContext* ctx, ChessState* chess, Move move) {
+#if COPY_MAKE
+    (void)move;
+    copyUnmake(chess, ctx->stack[ctx->ply].saved);
+#else
+    unmakeMove(chess, move, &ctx->stack[ctx->ply].undo);
+#endif
+}
+
+// which of the engine's node counters the calling thread owns
+static Uint64* searchThreadCounter(Engine* engine) {
+    return &engine->nodeCounters[(intptr_t)SDL_GetTLS(&searchThreadSlot)].nodes;
+}
+
+// every SearchContext is bound to the thread about to use it before it searches
+static void bindSearchThread(SearchContext* ctx, Engine* engine) {
+    ctx->nodes = searchThreadCounter(engine);
+    ctx->selDepth = &engine->nodeCounters[(intptr_t)SDL_GetTLS(&searchThreadSlot)].selDepth;
+    ctx->counter = &engine->nodeCounters[(intptr_t)SDL_GetTLS(&searchThreadSlot)];
+    ctx->pawns = &pawnTables[(intptr_t)SDL_GetTLS(&searchThreadSlot)];
+    ctx->evals = engine->options.evalCache ? &evalCaches[(intptr_t)SDL_GetTLS(&searchThreadSlot)] : NULL;
+    ctx->nnue = engine->options.nnue && nnueNet.loaded;
+    ctx->tablebases = engine->options.tablebases;
+#if defined(SEARCH_STATS)
+    ctx->stats = &engine->stats[(intptr_t)SDL_GetTLS(&searchThreadSlot)];
+#endif
+}
+
+/* Forgets the killers, and with keepHistory false the history, counter-moves and continuation history too (a new
+   game); otherwise both histories are halved and the counter-moves kept. */
+static void clearSearchContext(SearchContext* ctx, bool keepHistory) {
+    for (int p = 0; p < SEARCH_STACK_PLIES; p++) ctx->stack[p].killers[0] = ctx->stack[p].killers[1] = MOVE_NONE;
+    if (!keepHistory) {
+        SDL_memset(ctx->history, 0, sizeof(ctx->history));
+        SDL_memset(ctx->counterMoves, 0, sizeof(ctx->counterMoves));
+        SDL_memset(ctx->continuation, 0, sizeof(ctx->continuation));
+        return;
+    }
+    for (int s = 0; s < 2; s++) for (int f = 0; f < 64; f++) for (int t = 0; t < 64; t++) ctx->history[s][f][t] /= 2;
+    Sint16* c = &ctx->continuation[0][0];
+    for (int i = 0; i < PIECE_TO_COUNT * PIECE_TO_COUNT; i++) c[i] /= 2;
+}
+
+/* The calling thread's context for engine, bound to it and at ply 0; made the first time the thread searches
+   for the engine (so it is local to that thread's core) and kept, so the killers and history carry over from
+   iteration to iteration and root move to root move. Taken for the first time in a new search, it ages them:
+   the killers are of plies that have moved on, the history counts half. NULL without the memory. */
+static SearchContext* threadSearchContext(Engine* engine) {
+    intptr_t slot = (intptr_t)SDL_GetTLS(&searchThreadSlot);
+    SearchContext* ctx = engine->contexts[slot];
+    if (!ctx) {
+        ctx = engine->contexts[slot] = SDL_calloc(1, sizeof(SearchContext));
+        if (!ctx) return NULL;
+    } else if (ctx->searchId != engine->searchId) {
+        clearSearchContext(ctx, true);
+    }
+    ctx->searchId = engine->searchId;
+    ctx->ply = 0;
+    ctx->extensions = 0;
+    ctx->afterNull = false;
+    ctx->threadId = 0;
+    ctx->sp = NULL;
+    ctx->sharedAlpha = NULL;
+    ctx->resolved = NULL;
+    bindSearchThread(ctx, engine);
+    return ctx;
+}
+
+Uint64 engineNodeCount(Engine* engine) {
+    Uint64 total = 0;
+    for (int i = 0; i <= MAX_POOL_THREADS; i++) total += __atomic_load_n(&engine->nodeCounters[i].nodes, __ATOMIC_RELAXED);
+    return total;
+}
+
+void engineCounters(Engine* engine, EngineCounters* counters) {
+    *counters = (EngineCounters){ 0 };
+    for (int i = 0; i <= MAX_POOL_THREADS; i++) {
+        const NodeCounter* c = &engine->nodeCounters[i];
+        counters->nodes += __atomic_load_n(&c->lifetimeNodes, __ATOMIC_RELAXED);
+        counters->ttProbes += __atomic_load_n(&c->ttProbes, __ATOMIC_RELAXED);
+        counters->ttHits += __atomic_load_n(&c->ttHits, __ATOMIC_RELAXED);
+        counters->tbHits += __atomic_load_n(&c->tbHits, __ATOMIC_RELAXED);
+    }
+}
+
+int engineSelDepth(Engine* engine) {
+    int deepest = 0;
+    for (int i = 0; i <= MAX_POOL_THREADS; i++) deepest = SDL_max(deepest, __atomic_load_n(&engine->nodeCounters[i].selDepth, __ATOMIC_RELAXED));
+    return deepest;
+}
+
+static void resetNodeCounts(Engine* engine) {
+    for (int i = 0; i <= MAX_POOL_THREADS; i++) {
+        __atomic_store_n(&engine->nodeCounters[i].nodes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&engine->nodeCounters[i].selDepth, 0, __ATOMIC_RELAXED);
+    }
+#if defined(SEARCH_STATS)
+    SDL_memset(engine->stats, 0, sizeof(engine->stats));
+#endif
+}
+
+/* an iteration is complete: the nodes it took, for the branching factor. Only the searching thread's own, which
+   are the iteration's alone; the helpers' are spread over iterations of their own. */
+static void statIteration(Engine* engine, int depth) {
+#if defined(SEARCH_STATS)
+    intptr_t slot = (intptr_t)SDL_GetTLS(&searchThreadSlot);
+    SearchStats* stats = &engine->stats[slot];
+    Uint64 earlier = 0;
+    for (int d = 1; d < depth; d++) earlier += stats->iterationNodes[d];
+    stats->depth = depth;
+    stats->iterationNodes[depth] = __atomic_load_n(&engine->nodeCounters[slot].nodes, __ATOMIC_RELAXED) - earlier;
+#else
+    (void)engine; (void)depth;
+#endif
+}
+
+/* counts a node for this thread; the clock is looked at every TIME_CHECK_NODES of them. A node limit is checked
+   against this thread's own count at every node, so a search on one thread stops on exactly the limit's node;
+   with helpers, whose nodes count too, it is checked against the total every TIME_CHECK_NODES as well. */
+// one more on a counter only this thread writes; the store only has to be untorn for the readers
+static inline void countEvent(Uint64* counter) {
+    __atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+static inline void countNode(SearchContext* ctx, Engine* engine) {
+    Uint64 visited = *ctx->nodes + 1;
+    __atomic_store_n(ctx->nodes, visited, __ATOMIC_RELAXED); // single writer, the store only has to be untorn
+    countEvent(&ctx->counter->lifetimeNodes);
+    if (ctx->ply > *ctx->selDepth) __atomic_store_n(ctx->selDepth, ctx->ply, __ATOMIC_RELAXED);
+    if (engine->nodeLimit && visited >= engine->nodeLimit) SDL_SetAtomicInt(&engine->stop, 1);
+    if ((visited & (TIME_CHECK_NODES - 1)) == 0) {
+        checkSearchTime(engine);
+        if (engine->nodeLimit && engineNodeCount(engine) >= engine->nodeLimit) SDL_SetAtomicInt(&engine->stop, 1);
+    }
+}
+
+/* Endgame tablebases for the three-piece endings with something to win: king and queen, rook or pawn against a
+   lone king. Every position's exact distance to mate is worked out backwards from the mates (retrograde analysis)
+   the first time a search gets down to three pieces, so an engine that never does pays nothing; positions are
+   stored with the stronger side as white, black-strong ones are flipped top to bottom when probed. */
+enum { TB_KQK, TB_KRK, TB_KPK, TB_COUNT };
+#define TB_MAX_PIECES 3
+#define TB_SIZE (2 * 64 * 64 * 64) // [side to move: 0 the strong side][strong king][weak king][piece]
+#define TB_ILLEGAL 255             // otherwise 0 = draw and d + 1 = mate d plies away
+
+static Uint8* tablebases[TB_COUNT];
+static SDL_AtomicInt tablebaseState; // 0 not built, 1 being built, 2 ready, 3 no memory for them
+
+static inline int tbIndex(int strongToMove, int strongKing, int weakKing, int piece) {
+    return (((strongToMove ? 0 : 1) * 64 + strongKing) * 64 + weakKing) * 64 + piece;
+}
+
+// squares the strong side's queen, rook or pawn on sq attacks
+static Bitboard tbPieceAttacks(int kind, int sq, Bitboard occ) {
+    if (kind == TB_KQK) return queenAttacks(sq, occ);
+    if (kind == TB_KRK) return rookAttacks(sq, occ);
+    return PAWN_ATTACKS[0][sq];
+}
+
+static bool tbLegal(int kind, int strongToMove, int sk, int wk, int ps) {
+    if (sk == wk || sk == ps || wk == ps || (KING_ATTACKS[sk] & (1ull << wk))) return false;
+    if (kind == TB_KPK && (ps < 8 || ps >= 56)) return false;
+    // the weak king can't be in check with the strong side to move
+    return !(strongToMove && (tbPieceAttacks(kind, ps, (1ull << sk) | (1ull << wk)) & (1ull << wk)));
+}
+
+// the weak side's moves from (sk, wk, ps); false if one of them takes the piece, a draw
+static bool tbWeakMoves(int kind, int sk, int wk, int ps, int* to, int* count) {
+    *count = 0;
+    for (Bitboard b = KING_ATTACKS[wk] & ~KING_ATTACKS[sk]; b;) {
+        int sq = popLsb(&b);
+        if (sq == ps) { if (!(KING_ATTACKS[sk] & (1ull << ps))) return false; continue; }
+        if (tbPieceAttacks(kind, ps, 1ull << sk) & (1ull << sq)) continue; // the king doesn't block a slider's line behind it
+        to[(*count)++] = sq;
+    }
+    return true;
+}
+
+// the value of a strong-side move from (sk, wk, ps): the position it leaves for the weak side to move
+typedef struct { const Uint8* table; int index; } TbChild;
+
+static int tbStrongMoves(const Uint8* table, int kind, int sk, int wk, int ps, TbChild* children) {
+    int count = 0;
+    Bitboard occ = (1ull << sk) | (1ull << wk) | (1ull << ps);
+    for (Bitboard b = KING_ATTACKS[sk] & ~KING_ATTACKS[wk] & ~(1ull << ps); b;)
+        children[count++] = (TbChild){ table, tbIndex(false, popLsb(&b), wk, ps) };
+    if (kind != TB_KPK) {
+        for (Bitboard b = tbPieceAttacks(kind, ps, occ) & ~occ; b;)
+            children[count++] = (TbChild){ table, tbIndex(false, sk, wk, popLsb(&b)) };
+        return count;
+    }
+    int push = ps + 8;
+    if (occ & (1ull << push)) return count;
+    if (push >= 56) { // minor promotions can't win against a bare king
+        children[count++] = (TbChild){ tablebases[TB_KQK], tbIndex(false, sk, wk, push) };
+        children[count++] = (TbChild){ tablebases[TB_KRK], tbIndex(false, sk, wk, push) };
+        return count;
+    }
+    children[count++] = (TbChild){ table, tbIndex(false, sk, wk, push) };
+    if (ps < 16 && !(occ & (1ull << (push + 8)))) children[count++] = (TbChild){ table, tbIndex(false, sk, wk, push + 8) };
+    return count;
+}
+
+static void buildTablebase(Uint8* table, int kind) {
+    SDL_memset(table, 0, TB_SIZE);
+    int to[8];
+    for (int i = 0; i < TB_SIZE; i++) {
+        int strongToMove = i < TB_SIZE / 2, sk = (i >> 12) & 63, wk = (i >> 6) & 63, ps = i & 63, count;
+        if (!tbLegal(kind, strongToMove, sk, wk, ps)) { table[i] = TB_ILLEGAL; continue; }
+        if (!strongToMove && tbWeakMoves(kind, sk, wk, ps, to, &count) && count == 0 &&
+            (tbPieceAttacks(kind, ps, (1ull << sk) | (1ull << wk)) & (1ull << wk)))
+            table[i] = 1; // checkmated: mate 0 plies away
+    }
+    // past the longest mate in the tables KPK promotes into, two idle passes in a row mean nothing more will change
+    int promoted = 0;
+    for (int k = 0; kind == TB_KPK && k < TB_KPK; k++)
+        for (int i = 0; i < TB_SIZE; i++) if (tablebases[k][i] != TB_ILLEGAL && tablebases[k][i] > promoted) promoted = tablebases[k][i];
+    /* Pass d settles the positions d plies from mate: a strong-side one is won if a move reaches a loss in d - 1, a
+       weak-side one lost if every move reaches a win (all of which are d - 1 or fewer by then). Only the positions
+       a move away from the ones the last pass settled can change, so each pass works back from those. */
+    for (int d = 1, idle = 0; d < TB_ILLEGAL - 1 && (idle < 2 || d <= promoted); d++) {
+        bool changed = false;
+        bool strong = d & 1;
+        for (int i = strong ? TB_SIZE / 2 : 0; i < (strong ? TB_SIZE : TB_SIZE / 2); i++) {
+            if (table[i] != d) continue;
+            int sk = (i >> 12) & 63, wk = (i >> 6) & 63, ps = i & 63, count = 0;
+            int from[27 + 8]; // a queen's moves and the king's
+            if (strong) { // king and piece moves go back the way they came; illegal squares are TB_ILLEGAL already
+                for (Bitboard b = KING_ATTACKS[sk]; b;) from[count++] = tbIndex(true, popLsb(&b), wk, ps);
+                Bitboard occ = (1ull << sk) | (1ull << wk);
+                if (kind != TB_KPK) {
+                    for (Bitboard b = tbPieceAttacks(kind, ps, occ) & ~occ; b;) from[count++] = tbIndex(true, sk, wk, popLsb(&b));
+                } else if (ps >= 16) {
+                    from[count++] = tbIndex(true, sk, wk, ps - 8);
+                    if (ps < 32 && ps >= 24 && !(occ & (1ull << (ps - 8)))) from[count++] = tbIndex(true, sk, wk, ps - 16);
+                }
+                for (int m = 0; m < count; m++) if (table[from[m]] == 0) table[from[m]] = (Uint8)(d + 1), changed = true;
+                continue;
+            }
+            for (Bitboard b = KING_ATTACKS[wk]; b;) {
+                int p = tbIndex(false, sk, popLsb(&b), ps), moves;
+                if (table[p] != 0 || !tbWeakMoves(kind, (p >> 12) & 63, (p >> 6) & 63, p & 63, to, &moves)) continue;
+                bool lost = true;
+                for (int m = 0; m < moves && lost; m++) {
+                    Uint8 v = table[tbIndex(true, sk, to[m], ps)];
+                    lost = v != 0 && v != TB_ILLEGAL;
+                }
+                if (lost) table[p] = (Uint8)(d + 1), changed = true;
+            }
+        }
+        // promotions lead into the other tables, where nothing works back from
+        for (int i = 0; strong && kind == TB_KPK && i < TB_SIZE / 2; i += 64) {
+            for (int ps = 48; ps < 56; ps++) {
+                TbChild children[8 + 2];
+                if (table[i + ps] != 0) continue;
+                int count = tbStrongMoves(table, kind, (i >> 12) & 63, (i >> 6) & 63, ps, children);
+                for (int m = 0; m < count; m++)
+                    if (children[m].table[children[m].index] == d) { table[i + ps] = (Uint8)(d + 1), changed = true; break; }
+            }
+        }
+        idle = changed ? 0 : idle + 1;
+    }
+}
+
+// builds the tables on the first call; true once they're there, false while another thread is still building them
+static bool tablebasesReady(void) {
+    int state = SDL_GetAtomicInt(&tablebaseState);
+    if (state == 2) return true;
+    if (state != 0 || !SDL_CompareAndSwapAtomicInt(&tablebaseState, 0, 1)) return false;
+    Uint8* tables = SDL_malloc((size_t)TB_COUNT * TB_SIZE);
+    if (!tables) { SDL_SetAtomicInt(&tablebaseState, 3); return false; }
+    for (int kind = 0; kind < TB_COUNT; kind++) tablebases[kind] = tables + (size_t)kind * TB_SIZE;
+    for (int kind = 0; kind < TB_COUNT; kind++) buildTablebase(tablebases[kind], kind); // KPK promotes into the others
+    SDL_SetAtomicInt(&tablebaseState, 2);
+    return true;
+}
+
+// builds the tablebases now, on the calling thread, instead of in the first search to reach a three-man ending
+void engineBuildTablebases(void) {
+    tablebasesReady();
+}
+
+/* The exact score of a position with at most TB_MAX_PIECES men, from the side to move's point of view, with mates
+   counted from the root like minimaxAB's. False when it isn't covered: two minor pieces' worth of material, castling
+   still possible, a mate the fifty-move rule might get to first, or the tables not built yet. */
+static bool probeTablebases(const ChessState* chess, int ply, int* score) {
+    Bitboard kings = chess->pieceBB[WHITE_KING] | chess->pieceBB[BLACK_KING];
+    Bitboard others = chess->occupied & ~kings;
+    if (!others) { *score = DRAW_SCORE; return true; }
+    if (others & (others - 1)) return false;
+    int sq = lsbIndex(others);
+    PieceType piece = chess->board[sq];
+    bool whiteStrong = isWhite(piece);
+    int kind;
+    switch (pieceKind(piece)) {
+    case WHITE_QUEEN: kind = TB_KQK; break;
+    case WHITE_ROOK:
+        kind = TB_KRK;
+        if (chess->castlingRights & (whiteStrong ? CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN : CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN)) return false;
+        break;
+    case WHITE_PAWN: kind = TB_KPK; break;
+    default: *score = DRAW_SCORE; return true; // a lone minor piece can't mate
+    }
+    int flip = whiteStrong ? 0 : 56;
+    int sk = chess->kingSquare[whiteStrong ? 0 : 1] ^ flip, wk = chess->kingSquare[whiteStrong ? 1 : 0] ^ flip;
+    bool strongToMove = chess->whiteToMove == whiteStrong;
+    // the bitbase settles the draws without the tables, which a win still needs for its distance
+    if (kind == TB_KPK && !kpkWon(strongToMove, sk, wk, sq ^ flip)) { *score = DRAW_SCORE; return true; }
+    if (!tablebasesReady()) return false;
+    Uint8 v = tablebases[kind][tbIndex(strongToMove, sk, wk, sq ^ flip)];
+    if (v == TB_ILLEGAL) return false;
+    if (v == 0) { *score = DRAW_SCORE; return true; }
+    int distance = v - 1;
+    if (chess->halfmoveClock + distance > 100 || ply + distance >= MAX_PLY) return false;
+    *score = strongToMove ? MATE_SCORE - (ply + distance) : -MATE_SCORE + ply + distance;
+    return true;
+}
+
+/* Syzygy tablebases, for the endings past the built-in three: win, draw or loss with the fifty-move rule in mind
+   (WDL, the .rtbw files) and the distance to the next capture or pawn move (DTZ, .rtbz), as Ronald de Man's
+   generator writes them, probed the way Fathom and Stockfish do. engineSetSyzygyPath only notes which tables there
+   are; a file is mapped the first time a probe needs it, so a search that never gets down to TB_LARGEST men (the
+   most in any table found) never touches one. WDL is only exact with the fifty-move count at zero and no castling
+   left, so that's when the search asks; the root ranks its moves by DTZ (by WDL without the .rtbz files) instead. */
+#define SYZYGY_MEN 7       // the most men in any table
+#define SYZYGY_HASH 8192   // material keys: both colourings of every table up to seven men fit with room to spare
+#define SYZYGY_WIN_SCORE (MATE_BOUND - 1) // less the ply: a won ending, never taken for a mate
+#define SYZYGY_MAX_DTZ (1 << 18)          // a root move's rank for a sure win, above any DTZ with the fifty moves added
+#if defined(_WIN32)
+#define SYZYGY_PATH_SEPARATOR ';'
+#else
+#define SYZYGY_PATH_SEPARATOR ':'
+#endif
+
+enum { SYZYGY_WDL, SYZYGY_DTZ };
+enum { WDL_LOSS = -2, WDL_BLESSED_LOSS, WDL_DRAW, WDL_CURSED_WIN, WDL_WIN }; // blessed and cursed: the fifty moves run out first
+typedef enum { SYZYGY_FAIL, SYZYGY_OK, SYZYGY_CHANGE_STM, SYZYGY_ZEROING_BEST } SyzygyResult;
+enum { SYZYGY_STM = 1, SYZYGY_MAPPED = 2, SYZYGY_WIN_PLIES = 4, SYZYGY_LOSS_PLIES = 8, SYZYGY_WIDE = 16, SYZYGY_SINGLE_VALUE = 128 };
+
+/* One compressed table of a file: a WDL file has one per side to move (one in all when both sides have the same
+   men), a DTZ file one for a single side to move, each again per file a to d of the leading pawn when there are
+   pawns. Values are Huffman-coded symbols, a symbol standing for a pair of others (Recursive Pairing) down to the
+   leaves that hold them; the blocks are found through a sparse index into their lengths. */
+typedef struct {
+    Uint8 flags;                     // SYZYGY_STM ... SYZYGY_SINGLE_VALUE
+    Uint8 maxSymLen, minSymLen;      // code lengths in bits; the value itself for SYZYGY_SINGLE_VALUE
+    Uint32 numBlocks, blockLengthSize;
+    Uint64 blockSize, span;          // bytes a block; values between sparse index entries
+    Uint64 sparseIndexSize;
+    const Uint8* lowestSym;          // [length - minSymLen]: the lowest symbol with a code that long, 16 bits each
+    const Uint8* btree;              // [symbol]: the two it pairs, 12 bits each
+    const Uint8* blockLength;        // [block]: the values in it less one, 16 bits each
+    const Uint8* sparseIndex;        // [value / span]: a 32-bit block and a 16-bit offset into it
+    const Uint8* data;               // the blocks
+    Uint64* base64;                  // [length - minSymLen]: the lowest code that long, left-aligned in 64 bits
+    Uint8* symlen;                   // [symbol]: the values it stands for, less one
+    Uint8 pieces[SYZYGY_MEN];        // the men in the order they're indexed, as PieceTypes with the strong side white
+    int groupLen[SYZYGY_MEN + 1];    // the men indexed together, 0 after the last group: KRvKN is 3, 1
+    Uint64 groupIdx[SYZYGY_MEN + 1]; // each group's index multiplier, the table's size after the last
+    Uint16 mapIdx[4];                // DTZ: where the value map for a win, a loss, a cursed win and a blessed loss starts
+} SyzygyPairs;
+
+typedef struct {
+    SDL_AtomicInt state;         // 0 not mapped, 1 being mapped, 2 ready, 3 no file or a damaged one
+    MappedFile file;
+    const Uint8* map;            // DTZ: the value maps mapIdx points into
+    SyzygyPairs items[2][4];     // [side to move, 0 for DTZ][leading pawn's file, 0 without pawns]
+} SyzygyFile;
+
+typedef struct {
+    char name[SYZYGY_MEN + 2];   // KRvKP, say: the first side is the one the table has as white
+    Uint32 key, key2;            // syzygyKey with the first side white, and with it black; equal when they match
+    int men;
+    bool hasPawns, hasUniquePieces;
+    Uint8 pawnCount[2];          // the leading side's pawns (the one with fewer, but some), the other's
+    SyzygyFile files[2];         // SYZYGY_WDL, SYZYGY_DTZ
+} SyzygyTable;
+
+static struct {
+    char* paths;                 // as engineSetSyzygyPath was given them
+    SyzygyTable* tables;
+    int count;
+    int largest;                 // the most men in any table, 0 with none
+    Uint16 hash[SYZYGY_HASH];    // 1 + a table by its keys, open addressing; 0 empty
+} syzygy;
+
+#define TB_LARGEST SDL_max(TB_MAX_PIECES, syzygy.largest) // no position with more men than this is ever probed
+
+// what the position index is made of, filled in the first time engineSetSyzygyPath is given a path
+static int syzygyMapPawns[64];       // a2-h7 to 47..0, the pawn with the highest the leading one
+static int syzygyMapB1H1H7[64];      // below the a1-h8 diagonal to 0..27
+static int syzygyMapA1D1D4[64];      // the a1-d1-d4 triangle to 0..9, the diagonal last
+static int syzygyMapKK[10][64];      // the 462 king pairs with the first in the triangle
+static int syzygyBinomial[6][64];    // [k][n]: k of n
+static int syzygyLeadPawnIdx[6][64]; // [leading pawns][square of the first]
+static int syzygyLeadPawnsSize[6][4]; // [leading pawns][file a to d]
+
+static inline Uint32 syzygyRead16(const Uint8* p) { return (Uint32)p[0] | (Uint32)p[1] << 8; }
+static inline Uint32 syzygyRead32(const Uint8* p) { return syzygyRead16(p) | syzygyRead16(p + 2) << 16; }
+static inline Uint32 syzygyRead32BE(const Uint8* p) { return (Uint32)p[0] << 24 | (Uint32)p[1] << 16 | (Uint32)p[2] << 8 | p[3]; }
+static inline int syzygyLeft(const SyzygyPairs* d, int sym) { return (d->btree[3 * sym + 1] & 0xF) << 8 | d->btree[3 * sym]; }
+static inline int syzygyRight(const SyzygyPairs* d, int sym) { return d->btree[3 * sym + 2] << 4 | d->btree[3 * sym + 1] >> 4; }
+static inline int offA1H8(int sq) { return (sq >> 3) - (sq & 7); }
+static inline int signOf(int x) { return (x > 0) - (x < 0); }
+
+// the men other than kings, three bits a kind and colour: what Syzygy calls the material key, without collisions
+static Uint32 syzygyKey(const ChessState* chess) {
+    Uint32 key = 0;
+    for (int kind = WHITE_PAWN; kind < WHITE_KING; kind++)
+        key |= (Uint32)popcount64(chess->pieceBB[kind]) << (3 * (kind - 1))
+             | (Uint32)popcount64(chess->pieceBB[kind | PIECE_BLACK]) << (15 + 3 * (kind - 1));
+    return key;
+}
+
+static void syzygyInitIndex(void) {
+    int code = 0;
+    for (int sq = 0; sq < 64; sq++) if (offA1H8(sq) < 0) syzygyMapB1H1H7[sq] = code++;
+    code = 0;
+    int diagonal[4], onDiagonal = 0;
+    for (int sq = 0; sq <= 27; sq++) {
+        if ((sq & 7) > 3) continue;
+        if (offA1H8(sq) < 0) syzygyMapA1D1D4[sq] = code++;
+        else if (offA1H8(sq) == 0) diagonal[onDiagonal++] = sq;
+    }
+    for (int i = 0; i < onDiagonal; i++) syzygyMapA1D1D4[diagonal[i]] = code++;
+    // both kings on the diagonal come last; the second king mustn't be above it when the first is on it
+    int both[10 * 64][2], bothCount = 0;
+    code = 0;
+    for (int idx = 0; idx < 10; idx++)
+        for (int s1 = 0; s1 <= 27; s1++) {
+            if ((s1 & 7) > 3 || syzygyMapA1D1D4[s1] != idx || (idx == 0 && s1 != 1)) continue; // b1 is 0
+            for (int s2 = 0; s2 < 64; s2++) {
+                if ((KING_ATTACKS[s1] | squareBB(s1)) & squareBB(s2)) continue;
+                if (!offA1H8(s1) && offA1H8(s2) > 0) continue;
+                if (!offA1H8(s1) && !offA1H8(s2)) { both[bothCount][0] = idx; both[bothCount++][1] = s2; }
+                else syzygyMapKK[idx][s2] = code++;
+            }
+        }
+    for (int i = 0; i < bothCount; i++) syzygyMapKK[both[i][0]][both[i][1]] = code++;
+    syzygyBinomial[0][0] = 1;
+    for (int n = 1; n < 64; n++)
+        for (int k = 0; k < 6 && k <= n; k++)
+            syzygyBinomial[k][n] = (k > 0 ? syzygyBinomial[k - 1][n - 1] : 0) + (k < n ? syzygyBinomial[k][n - 1] : 0);
+    int available = 47;
+    for (int lead = 1; lead <= 5; lead++)
+        for (int file = 0; file < 4; file++) {
+            int idx = 0;
+            for (int rank = 1; rank <= 6; rank++) {
+                int sq = rank * 8 + file;
+                if (lead == 1) {
+                    syzygyMapPawns[sq] = available--;
+                    syzygyMapPawns[sq ^ 7] = available--;
+                }
+                syzygyLeadPawnIdx[lead][sq] = idx;
+                idx += syzygyBinomial[lead - 1][syzygyMapPawns[sq]];
+            }
+            syzygyLeadPawnsSize[lead][file] = idx;
+        }
+}
+
+static SyzygyTable* syzygyFind(Uint32 key) {
+    for (int h = (int)(key * 0x9E3779B1u >> 19); syzygy.hash[h]; h = (h + 1) & (SYZYGY_HASH - 1)) {
+        SyzygyTable* t = &syzygy.tables[syzygy.hash[h] - 1];
+        if (t->key == key || t->key2 == key) return t;
+    }
+    return NULL;
+}
+
+static void syzygyInsert(Uint32 key, int table) {
+    int h = (int)(key * 0x9E3779B1u >> 19);
+    while (syzygy.hash[h]) h = (h + 1) & (SYZYGY_HASH - 1);
+    syzygy.hash[h] = (Uint16)(table + 1);
+}
+
+/* A table from its file name, KQvKR.rtbw say, if it is one: the two sides' men from a king down, the strong
+   side first. False for anything else in the directory. */
+static bool syzygyParseName(const char* file, SyzygyTable* t) {
+    static const char MEN[] = "PNBRQK";
+    size_t length = SDL_strlen(file);
+    if (length < 8 || length - 5 > SYZYGY_MEN + 1 || SDL_strcmp(file + length - 5, ".rtbw") != 0) return false;
+    int counts[2][7] = { { 0 } }, side = 0;
+    for (size_t i = 0; i < length - 5; i++) {
+        if (file[i] == 'v' && side == 0 && i > 0) { side = 1; continue; }
+        const char* man = SDL_strchr(MEN, file[i]);
+        if (!man) return false;
+        counts[side][man - MEN + 1]++;
+    }
+    if (side != 1 || counts[0][6] != 1 || counts[1][6] != 1 || file[0] != 'K' || file[SDL_strchr(file, 'v') - file + 1] != 'K')
+        return false;
+    SDL_zerop(t);
+    SDL_memcpy(t->name, file, length - 5);
+    for (int kind = 1; kind <= 5; kind++) {
+        t->key |= (Uint32)counts[0][kind] << (3 * (kind - 1)) | (Uint32)counts[1][kind] << (15 + 3 * (kind - 1));
+        t->key2 |= (Uint32)counts[1][kind] << (3 * (kind - 1)) | (Uint32)counts[0][kind] << (15 + 3 * (kind - 1));
+        for (int s = 0; s < 2; s++) {
+            t->men += counts[s][kind];
+            if (counts[s][kind] == 1) t->hasUniquePieces = true;
+        }
+    }
+    t->men += 2;
+    t->hasPawns = counts[0][1] + counts[1][1] > 0;
+    // the side with fewer pawns leads, it compresses better; either with none
+    bool whiteLeads = !counts[1][1] || (counts[0][1] && counts[1][1] >= counts[0][1]);
+    t->pawnCount[0] = (Uint8)counts[whiteLeads ? 0 : 1][1];
+    t->pawnCount[1] = (Uint8)counts[whiteLeads ? 1 : 0][1];
+    return true;
+}
+
+/* The groups a table's men are indexed in: men of a kind and colour together, and first either the leading
+   pawns, three unique men (kings included) or the two kings. order says which group the index counts first. */
+static void syzygySetGroups(const SyzygyTable* t, SyzygyPairs* d, const int order[2], int file) {
+    int n = 0, firstLen = t->hasPawns ? 0 : t->hasUniquePieces ? 3 : 2;
+    d->groupLen[n] = 1;
+    for (int i = 1; i < t->men; i++)
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1]) d->groupLen[n]++;
+        else d->groupLen[++n] = 1;
+    d->groupLen[++n] = 0;
+    bool bothPawns = t->hasPawns && t->pawnCount[1];
+    int next = bothPawns ? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - (bothPawns ? d->groupLen[1] : 0);
+    Uint64 idx = 1;
+    for (int k = 0; next < n || k == order[0] || k == order[1]; k++)
+        if (k == order[0]) {
+            d->groupIdx[0] = idx;
+            idx *= t->hasPawns ? syzygyLeadPawnsSize[d->groupLen[0]][file] : t->hasUniquePieces ? 31332 : 462;
+        } else if (k == order[1]) { // the other side's pawns
+            d->groupIdx[1] = idx;
+            idx *= syzygyBinomial[d->groupLen[1]][48 - d->groupLen[0]];
+        } else {
+            d->groupIdx[next] = idx;
+            idx *= syzygyBinomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next++];
+        }
+    d->groupIdx[n] = idx;
+}
+
+// how many values less one a symbol stands for, its pair's first
+static Uint8 syzygySymlen(SyzygyPairs* d, int sym, Uint8* visited) {
+    visited[sym] = 1;
+    int right = syzygyRight(d, sym);
+    if (right == 0xFFF) return 0;
+    int left = syzygyLeft(d, sym);
+    if (!visited[left]) d->symlen[left] = syzygySymlen(d, left, visited);
+    if (!visited[right]) d->symlen[right] = syzygySymlen(d, right, visited);
+    return (Uint8)(d->symlen[left] + d->symlen[right] + 1);
+}
+
+// a table's Huffman code and pairs, at data; what follows them, or NULL past end or without the memory
+static const Uint8* syzygySetSizes(SyzygyPairs* d, const Uint8* data, const Uint8* end) {
+    d->flags = *data++;
+    if (d->flags & SYZYGY_SINGLE_VALUE) {
+        d->minSymLen = *data++; // every position has the one value
+        return data;
+    }
+    int groups = 0;
+    while (d->groupLen[groups]) groups++;
+    Uint64 size = d->groupIdx[groups];
+    if (data + 10 > end) return NULL;
+    d->blockSize = 1ULL << (data[0] & 63);
+    d->span = 1ULL << (data[1] & 63);
+    d->sparseIndexSize = (size + d->span - 1) / d->span;
+    int padding = data[2];
+    d->numBlocks = syzygyRead32(data + 3);
+    d->blockLengthSize = d->numBlocks + padding; // so the sparse index can't point past the end
+    d->maxSymLen = data[7];
+    d->minSymLen = data[8];
+    data += 9;
+    int lengths = d->maxSymLen - d->minSymLen + 1;
+    if (lengths < 1 || d->minSymLen < 1 || d->maxSymLen > 32 || data + 2 * lengths + 2 > end) return NULL;
+    d->lowestSym = data;
+    d->base64 = SDL_calloc((size_t)lengths, sizeof(Uint64));
+    if (!d->base64) return NULL;
+    // longer codes are numerically lower, so base64 falls with the length; shifted left, it's a code's lower bound
+    for (int i = lengths - 2; i >= 0; i--)
+        d->base64[i] = (d->base64[i + 1] + syzygyRead16(d->lowestSym + 2 * i) - syzygyRead16(d->lowestSym + 2 * (i + 1))) / 2;
+    for (int i = 0; i < lengths; i++) d->base64[i] <<= 64 - i - d->minSymLen;
+    data += 2 * lengths;
+    int symbols = (int)syzygyRead16(data);
+    data += 2;
+    if (symbols > 4096 || data + 3 * symbols > end) return NULL; // twelve bits a symbol
+    d->btree = data;
+    d->symlen = SDL_calloc(4096, 1);
+    Uint8 visited[4096] = { 0 };
+    if (!d->symlen) return NULL;
+    for (int sym = 0; sym < symbols; sym++)
+        if (!visited[sym]) d->symlen[sym] = syzygySymlen(d, sym, visited);
+    return data + 3 * symbols + (symbols & 1);
+}
+
+// where each of a DTZ file's value maps starts; what follows them
+static const Uint8* syzygySetDtzMap(SyzygyTable* t, const Uint8* data, const Uint8* end, int maxFile) {
+    SyzygyFile* f = &t->files[SYZYGY_DTZ];
+    f->map = data;
+    for (int file = 0; file <= maxFile; file++) {
+        SyzygyPairs* d = &f->items[0][file];
+        if (!(d->flags & SYZYGY_MAPPED)) continue;
+        if (d->flags & SYZYGY_WIDE) {
+            data += (data - (const Uint8*)f->file.data) & 1;
+            for (int i = 0; i < 4 && data + 2 <= end; i++) {
+                d->mapIdx[i] = (Uint16)((data - f->map) / 2 + 1);
+                data += 2 * syzygyRead16(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4 && data < end; i++) {
+                d->mapIdx[i] = (Uint16)(data - f->map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+    return data + ((data - (const Uint8*)f->file.data) & 1);
+}
+
+// a mapped file's tables, after the magic; false if it doesn't fit the table it's named for
+static bool syzygySetup(SyzygyTable* t, int type) {
+    SyzygyFile* f = &t->files[type];
+    const Uint8* base = (const Uint8*)f->file.data;
+    const Uint8* end = base + f->file.size;
+    const Uint8* data = base + 4;
+    bool split = t->key != t->key2;
+    if (((data[0] & 2) != 0) != t->hasPawns || ((data[0] & 1) != 0) != split) return false;
+    data++;
+    int sides = type == SYZYGY_WDL && split ? 2 : 1;
+    int maxFile = t->hasPawns ? 3 : 0;
+    bool bothPawns = t->hasPawns && t->pawnCount[1];
+    for (int file = 0; file <= maxFile; file++) {
+        if (data + 1 + bothPawns + t->men > end) return false;
+        int order[2][2] = { { data[0] & 0xF, bothPawns ? data[1] & 0xF : 0xF }, { data[0] >> 4, bothPawns ? data[1] >> 4 : 0xF } };
+        data += 1 + bothPawns;
+        for (int k = 0; k < t->men; k++, data++)
+            for (int i = 0; i < sides; i++) f->items[i][file].pieces[k] = i ? *data >> 4 : *data & 0xF;
+        for (int i = 0; i < sides; i++) syzygySetGroups(t, &f->items[i][file], order[i], file);
+    }
+    data += (data - base) & 1;
+    for (int file = 0; file <= maxFile; file++)
+        for (int i = 0; i < sides; i++)
+            if (!(data = syzygySetSizes(&f->items[i][file], data, end))) return false;
+    if (type == SYZYGY_DTZ) data = syzygySetDtzMap(t, data, end, maxFile);
+    for (int file = 0; file <= maxFile; file++)
+        for (int i = 0; i < sides; i++) {
+            f->items[i][file].sparseIndex = data;
+            data += f->items[i][file].sparseIndexSize * 6;
+        }
+    for (int file = 0; file <= maxFile; file++)
+        for (int i = 0; i < sides; i++) {
+            f->items[i][file].blockLength = data;
+            data += (size_t)f->items[i][file].blockLengthSize * 2;
+        }
+    for (int file = 0; file <= maxFile; file++)
+        for (int i = 0; i < sides; i++) {
+            data = base + ((data - base + 63) & ~(ptrdiff_t)63); // the blocks start on a cache line
+            f->items[i][file].data = data;
+            data += (size_t)f->items[i][file].numBlocks * f->items[i][file].blockSize;
+        }
+    return data <= end;
+}
+
+static void syzygyFreeFile(SyzygyFile* f) {
+    for (int i = 0; i < 2; i++)
+        for (int file = 0; file < 4; file++) {
+            SDL_free(f->items[i][file].base64);
+            SDL_free(f->items[i][file].symlen);
+        }
+    unmapFile(&f->file);
+    SDL_zerop(f);
+}
+
+// maps a table's WDL or DTZ file, from the first of the directories that has it
+static bool syzygyOpen(SyzygyTable* t, int type) {
+    static const Uint8 MAGIC[2][4] = { { 0x71, 0xE8, 0x23, 0x5D }, { 0xD7, 0x66, 0x0C, 0xA5 } };
+    SyzygyFile* f = &t->files[type];
+    for (const char* dir = syzygy.paths; *dir;) {
+        const char* stop = SDL_strchr(dir, SYZYGY_PATH_SEPARATOR);
+        int length = stop ? (int)(stop - dir) : (int)SDL_strlen(dir);
+        char path[4096];
+        SDL_snprintf(path, sizeof(path), "%.*s/%s%s", length, dir, t->name, type == SYZYGY_WDL ? ".rtbw" : ".rtbz");
+        dir += length + (stop != NULL);
+        if (!mapFile(&f->file, path)) continue;
+#if defined(__unix__) || defined(__APPLE__)
+        if (f->file.mapped) madvise((void*)f->file.data, f->file.size, MADV_RANDOM); // probes go anywhere in it
+#endif
+        if (f->file.size >= 16 && SDL_memcmp(f->file.data, MAGIC[type], 4) == 0 && syzygySetup(t, type)) return true;
+        SDL_Log("Syzygy: %s is damaged or not the table it's named for", path);
+        syzygyFreeFile(f);
+        return false;
+    }
+    return false;
+}
+
+// a table's file ready to probe, mapped now if this is its first probe; false while another thread maps it
+static bool syzygyReady(SyzygyTable* t, int type) {
+    SDL_AtomicInt* state = &t->files[type].state;
+    int now = SDL_GetAtomicInt(state);
+    if (now == 2) return true;
+    if (now != 0 || !SDL_CompareAndSwapAtomicInt(state, 0, 1)) return false;
+    bool ok = syzygyOpen(t, type);
+    SDL_SetAtomicInt(state, ok ? 2 : 3);
+    return ok;
+}
+
+// the value at idx of one of a file's tables: find its block, then its symbol in there, then the leaf it's under
+static int syzygyDecompress(const SyzygyPairs* d, Uint64 idx) {
+    if (d->flags & SYZYGY_SINGLE_VALUE) return d->minSymLen;
+    // the sparse index has an entry for every span values, at the middle of each
+    Uint32 k = (Uint32)(idx / d->span);
+    Uint32 block = syzygyRead32(d->sparseIndex + 6 * (size_t)k);
+    int offset = (int)syzygyRead16(d->sparseIndex + 6 * (size_t)k + 4) + (int)(idx % d->span) - (int)(d->span / 2);
+    while (offset < 0) offset += (int)syzygyRead16(d->blockLength + 2 * (size_t)--block) + 1;
+    while (offset > (int)syzygyRead16(d->blockLength + 2 * (size_t)block)) offset -= (int)syzygyRead16(d->blockLength + 2 * (size_t)block++) + 1;
+    const Uint8* ptr = d->data + block * d->blockSize;
+    Uint64 buf64 = (Uint64)syzygyRead32BE(ptr) << 32 | syzygyRead32BE(ptr + 4);
+    ptr += 8;
+    int buf64Size = 64;
+    Uint16 sym;
+    for (;;) {
+        int len = 0; // the code's length less minSymLen, from where it falls among base64
+        while (buf64 < d->base64[len]) len++;
+        sym = (Uint16)((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+        sym = (Uint16)(sym + syzygyRead16(d->lowestSym + 2 * len));
+        if (offset < d->symlen[sym] + 1) break;
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+        if (buf64Size <= 32) {
+            buf64Size += 32;
+            buf64 |= (Uint64)syzygyRead32BE(ptr) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+    while (d->symlen[sym]) { // a pair's values are its first symbol's and then its second's
+        int left = syzygyLeft(d, sym);
+        if (offset < d->symlen[left] + 1) {
+            sym = (Uint16)left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = (Uint16)syzygyRight(d, sym);
+        }
+    }
+    return syzygyLeft(d, sym);
+}
+
+// a value from the table as WDL (-2 to 2), or DTZ in plies
+static int syzygyMapScore(const SyzygyTable* t, int type, int file, int value, int wdl) {
+    static const int WDL_MAP[] = { 1, 3, 0, 2, 0 }; // mapIdx for a loss, blessed loss, draw, cursed win, win
+    if (type == SYZYGY_WDL) return value - 2;
+    const SyzygyFile* f = &t->files[SYZYGY_DTZ];
+    const SyzygyPairs* d = &f->items[0][file];
+    if (d->flags & SYZYGY_MAPPED) {
+        int at = d->mapIdx[WDL_MAP[wdl + 2]] + value;
+        value = d->flags & SYZYGY_WIDE ? (int)syzygyRead16(f->map + 2 * at) : f->map[at];
+    }
+    // stored in moves unless the flags say plies
+    if ((wdl == WDL_WIN && !(d->flags & SYZYGY_WIN_PLIES)) || (wdl == WDL_LOSS && !(d->flags & SYZYGY_LOSS_PLIES)) ||
+        wdl == WDL_CURSED_WIN || wdl == WDL_BLESSED_LOSS)
+        value *= 2;
+    return value + 1;
+}
+
+/* The table's value for the position: its men mapped to the table's colours (the strong side white) and squares
+   (the leading man on the queen side, low in the a1-d1-d4 triangle without pawns), then indexed group by group.
+   A DTZ table with only the other side to move sets SYZYGY_CHANGE_STM instead. */
+static int syzygyProbeTable(const ChessState* chess, SyzygyTable* t, int type, int wdl, SyzygyResult* result) {
+    int squares[SYZYGY_MEN], pieces[SYZYGY_MEN];
+    int size = 0, leadPawns = 0, file = 0;
+    Bitboard leadPawnsBB = 0;
+    bool blackToMove = !chess->whiteToMove;
+    // tables with the same men both sides only have white to move; otherwise the strong side is white
+    bool flip = (t->key == t->key2 && blackToMove) || syzygyKey(chess) != t->key;
+    int flipColor = flip ? PIECE_BLACK : 0, flipSquares = flip ? 56 : 0;
+    int stm = flip ^ blackToMove;
+    SyzygyFile* f = &t->files[type];
+    if (t->hasPawns) { // the leading pawns first, the one furthest from the centre and back at the front
+        int pawn = f->items[0][0].pieces[0] ^ flipColor;
+        Bitboard b = leadPawnsBB = chess->pieceBB[pawn];
+        do squares[size++] = popLsb(&b) ^ flipSquares; while (b); // the key says there's one
+        leadPawns = size;
+        int lead = 0;
+        for (int i = 1; i < leadPawns; i++) if (syzygyMapPawns[squares[i]] > syzygyMapPawns[squares[lead]]) lead = i;
+        int s = squares[0]; squares[0] = squares[lead]; squares[lead] = s;
+        file = (squares[0] & 7) > 3 ? 7 - (squares[0] & 7) : squares[0] & 7;
+    }
+    if (type == SYZYGY_DTZ && (f->items[0][file].flags & SYZYGY_STM) != stm && !(t->key == t->key2 && !t->hasPawns)) {
+        *result = SYZYGY_CHANGE_STM;
+        return 0;
+    }
+    for (Bitboard b = chess->occupied ^ leadPawnsBB; b;) {
+        int sq = popLsb(&b);
+        squares[size] = sq ^ flipSquares;
+        pieces[size++] = chess->board[sq] ^ flipColor;
+    }
+    const SyzygyPairs* d = &f->items[type == SYZYGY_WDL ? stm : 0][file];
+    for (int i = leadPawns; i < size - 1; i++) // into the table's order
+        for (int j = i + 1; j < size; j++)
+            if (d->pieces[i] == pieces[j]) {
+                int p = pieces[i]; pieces[i] = pieces[j]; pieces[j] = p;
+                int s = squares[i]; squares[i] = squares[j]; squares[j] = s;
+                break;
+            }
+    if ((squares[0] & 7) > 3) for (int i = 0; i < size; i++) squares[i] ^= 7;
+    Uint64 idx;
+    if (t->hasPawns) {
+        idx = (Uint64)syzygyLeadPawnIdx[leadPawns][squares[0]];
+        for (int i = 2; i < leadPawns; i++) // the rest of them by syzygyMapPawns, lowest first
+            for (int j = i; j > 1 && syzygyMapPawns[squares[j]] < syzygyMapPawns[squares[j - 1]]; j--) {
+                int s = squares[j]; squares[j] = squares[j - 1]; squares[j - 1] = s;
+            }
+        for (int i = 1; i < leadPawns; i++) idx += (Uint64)syzygyBinomial[i][syzygyMapPawns[squares[i]]];
+    } else {
+        if ((squares[0] >> 3) > 3) for (int i = 0; i < size; i++) squares[i] ^= 56;
+        for (int i = 0; i < d->groupLen[0]; i++) { // the first of the leading group off the diagonal goes below it
+            if (!offA1H8(squares[i])) continue;
+            if (offA1H8(squares[i]) > 0)
+                for (int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            break;
+        }
+        if (t->hasUniquePieces) { // three men together: placed in turn, each off the squares of those before
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (offA1H8(squares[0]))
+                idx = ((Uint64)syzygyMapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            else if (offA1H8(squares[1]))
+                idx = ((Uint64)6 * 63 + (squares[0] >> 3) * 28 + syzygyMapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            else if (offA1H8(squares[2]))
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 + ((squares[1] >> 3) - adjust1) * 28 +
+                      syzygyMapB1H1H7[squares[2]];
+            else
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6 + ((squares[1] >> 3) - adjust1) * 6 +
+                      ((squares[2] >> 3) - adjust2);
+        } else {
+            idx = (Uint64)syzygyMapKK[syzygyMapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+    idx *= d->groupIdx[0];
+    // the other groups, each man on the squares the groups before it leave
+    int* group = squares + d->groupLen[0];
+    bool remainingPawns = t->hasPawns && t->pawnCount[1];
+    for (int next = 1; d->groupLen[next]; next++) {
+        int length = d->groupLen[next];
+        for (int i = 1; i < length; i++)
+            for (int j = i; j > 0 && group[j] < group[j - 1]; j--) { int s = group[j]; group[j] = group[j - 1]; group[j - 1] = s; }
+        Uint64 n = 0;
+        for (int i = 0; i < length; i++) {
+            int adjust = 0;
+            for (int* s = squares; s < group; s++) adjust += group[i] > *s;
+            n += (Uint64)syzygyBinomial[i + 1][group[i] - adjust - 8 * remainingPawns];
+        }
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        group += length;
+    }
+    return syzygyMapScore(t, type, file, syzygyDecompress(d, idx), wdl);
+}
+
+static int syzygyProbeFile(const ChessState* chess, int type, int wdl, SyzygyResult* result) {
+    int men = popcount64(chess->occupied);
+    if (men == 2) return WDL_DRAW;
+    SyzygyTable* t = men <= syzygy.largest ? syzygyFind(syzygyKey(chess)) : NULL;
+    if (!t || !syzygyReady(t, type)) {
+        *result = SYZYGY_FAIL;
+        return 0;
+    }
+    return syzygyProbeTable(chess, t, type, wdl, result);
+}
+
+static inline bool syzygyZeroing(const ChessState* chess, Move move) {
+    return isCaptureMove(move) || pieceKind(chess->board[moveFrom(move)]) == WHITE_PAWN;
+}
+
+/* WDL with the captures (and, for DTZ's sake, the pawn moves) tried too: the tables hold don't-care values where
+   one wins, and nothing for an en passant capture. SYZYGY_ZEROING_BEST when such a move is the best there is. */
+static int syzygySearch(ChessState* chess, bool pawnMoves, SyzygyResult* result) {
+    MoveList moves;
+    getAllMoves(chess, &moves);
+    int best = WDL_LOSS, value, tried = 0;
+    for (int i = 0; i < moves.count; i++) {
+        Move move = moves.moves[i];
+        if (!isCaptureMove(move) && !(pawnMoves && syzygyZeroing(chess, move))) continue;
+        tried++;
+        UndoInfo undo;
+        makeMove(chess, move, &undo);
+        value = -syzygySearch(chess, false, result);
+        unmakeMove(chess, move, &undo);
+        if (*result == SYZYGY_FAIL) return WDL_DRAW;
+        if (value > best) {
+            best = value;
+            if (value >= WDL_WIN) {
+                *result = SYZYGY_ZEROING_BEST;
+                return value;
+            }
+        }
+    }
+    bool onlyThose = tried && tried == moves.count; // then the table's value may not be there at all
+    if (onlyThose) {
+        value = best;
+    } else {
+        value = syzygyProbeFile(chess, SYZYGY_WDL, WDL_DRAW, result);
+        if (*result == SYZYGY_FAIL) return WDL_DRAW;
+    }
+    if (best >= value) {
+        *result = best > WDL_DRAW || onlyThose ? SYZYGY_ZEROING_BEST : SYZYGY_OK;
+        return best;
+    }
+    *result = SYZYGY_OK;
+    return value;
+}
+
+// -2 lost ... 2 won for the side to move, valid with the fifty-move count at zero; SYZYGY_FAIL in result if not known
+static int syzygyProbeWdl(ChessState* chess, SyzygyResult* result) {
+    *result = SYZYGY_OK;
+    return syzygySearch(chess, false, result);
+}
+
+// the DTZ of the move before a capture or pawn move that leads to wdl
+static int dtzBeforeZeroing(int wdl) {
+    return wdl == WDL_WIN ? 1 : wdl == WDL_CURSED_WIN ? 101 : wdl == WDL_BLESSED_LOSS ? -101 : wdl == WDL_LOSS ? -1 : 0;
+}
+
+/* Plies to the next capture or pawn move with the best play, signed like WDL: above 100 (below -100) for a win
+   (loss) the fifty-move rule takes away, -1 checkmated, 0 drawn. It can be one ply long (a table that counts in
+   moves); a win with DTZ plus the fifty-move count at most 99 is certain. */
+static int syzygyProbeDtz(ChessState* chess, SyzygyResult* result) {
+    *result = SYZYGY_OK;
+    int wdl = syzygySearch(chess, true, result);
+    if (*result == SYZYGY_FAIL || wdl == WDL_DRAW) return 0;
+    if (*result == SYZYGY_ZEROING_BEST) return dtzBeforeZeroing(wdl);
+    int dtz = syzygyProbeFile(chess, SYZYGY_DTZ, wdl, result);
+    if (*result == SYZYGY_FAIL) return 0;
+    if (*result != SYZYGY_CHANGE_STM) return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * signOf(wdl);
+    // the table has the other side to move: the best reply's, a ply on
+    int minDtz = 0xFFFF;
+    MoveList moves;
+    getAllMoves(chess, &moves);
+    for (int i = 0; i < moves.count; i++) {
+        Move move = moves.moves[i];
+        bool zeroing = syzygyZeroing(chess, move);
+        UndoInfo undo;
+        makeMove(chess, move, &undo);
+        dtz = zeroing ? -dtzBeforeZeroing(syzygySearch(chess, false, result)) : -syzygyProbeDtz(chess, result);
+        if (dtz == 1 && isKingInCheck(chess, chess->whiteToMove) && !hasLegalMove(chess)) minDtz = 1; // mates
+        if (!zeroing) dtz += signOf(dtz);
+        if (dtz < minDtz && signOf(dtz) == signOf(wdl)) minDtz = dtz;
+        unmakeMove(chess, move, &undo);
+        if (*result == SYZYGY_FAIL) return 0;
+    }
+    return minDtz == 0xFFFF ? -1 : minDtz;
+}
+
+/* The search's score for a position the Syzygy tables have: a won or lost ending a little inside the mates,
+   sooner better, and a draw for one the fifty-move rule saves. False for one they don't, or that isn't safe to ask
+   them about (a move since the last capture or pawn move, castling still possible). */
+static bool probeSyzygy(ChessState* chess, int ply, int* score) {
+    if (chess->halfmoveClock != 0 || chess->castlingRights) return false;
+    SyzygyResult result;
+    int wdl = syzygyProbeWdl(chess, &result);
+    if (result == SYZYGY_FAIL) return false;
+    *score = wdl == WDL_WIN ? SYZYGY_WIN_SCORE - ply : wdl == WDL_LOSS ? -SYZYGY_WIN_SCORE + ply : DRAW_SCORE + 2 * wdl;
+    return true;
+}
+
+// a root move's position is drawn already: fifty moves without a mate, or the third time it's come round
+static bool syzygyDrawnAfter(ChessState* chess) {
+    if (chess->halfmoveClock >= 100) return !isKingInCheck(chess, chess->whiteToMove) || hasLegalMove(chess);
+    int repeats = 0, oldest = SDL_max(chess->keyCount - SDL_min(chess->halfmoveClock, KEY_HISTORY_SIZE), 0);
+    for (int i = chess->keyCount - 2; i >= oldest; i -= 2)
+        if (chess->keyHistory[i & (KEY_HISTORY_SIZE - 1)] == chess->hashKey && ++repeats == 2) return true;
+    return false;
+}
+
+/* Leaves the root only the moves the tables rank best, when they have the position: by DTZ, so a win is kept
+   within the fifty moves (and made progress with once the count gets close, or the position has come round
+   before) and a loss dragged out; by WDL where there's no DTZ file. A move into a draw the tables don't see (a
+   third time round, the fifty moves up) ranks as one. The search then picks among those. */
+static void syzygyRankRootMoves(ChessState* chess, RootMoves* root) {
+    static const int WDL_RANK[] = { -SYZYGY_MAX_DTZ, -SYZYGY_MAX_DTZ + 101, 0, SYZYGY_MAX_DTZ - 101, SYZYGY_MAX_DTZ };
+    if (!syzygy.largest || chess->castlingRights || popcount64(chess->occupied) > syzygy.largest) return;
+    int ranks[256];
+    int fifty = chess->halfmoveClock;
+    bool repeated = isRepetition(chess);
+    bool byDtz = true;
+    for (int i = 0; byDtz && i < root->count; i++) {
+        SyzygyResult result = SYZYGY_OK;
+        UndoInfo undo;
+        makeMove(chess, root->moves[i], &undo);
+        int dtz;
+        if (chess->halfmoveClock == 0) {
+            dtz = dtzBeforeZeroing(-syzygyProbeWdl(chess, &result));
+        } else if (syzygyDrawnAfter(chess)) {
+            dtz = 0;
+        } else {
+            dtz = -syzygyProbeDtz(chess, &result);
+            dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+        }
+        if (dtz == 2 && isKingInCheck(chess, chess->whiteToMove) && !hasLegalMove(chess)) dtz = 1;
+        unmakeMove(chess, root->moves[i], &undo);
+        byDtz = result != SYZYGY_FAIL;
+        ranks[i] = dtz > 0 ? (dtz + fifty <= 99 && !repeated ? SYZYGY_MAX_DTZ : SYZYGY_MAX_DTZ - (dtz + fifty))
+                 : dtz < 0 ? (-dtz * 2 + fifty < 100 ? -SYZYGY_MAX_DTZ : -SYZYGY_MAX_DTZ + (-dtz + fifty))
+                           : 0;
+    }
+    for (int i = 0; !byDtz && i < root->count; i++) { // no DTZ file: WDL alone
+        SyzygyResult result = SYZYGY_OK;
+        UndoInfo undo;
+        makeMove(chess, root->moves[i], &undo);
+        int wdl = syzygyDrawnAfter(chess) ? WDL_DRAW : -syzygyProbeWdl(chess, &result);
+        unmakeMove(chess, root->moves[i], &undo);
+        if (result == SYZYGY_FAIL) return;
+        ranks[i] = WDL_RANK[wdl + 2];
+    }
+    int best = ranks[0], kept = 0;
+    for (int i = 1; i < root->count; i++) best = SDL_max(best, ranks[i]);
+    for (int i = 0; i < root->count; i++) // in the order they were in, the hash move still first if it's kept
+        if (ranks[i] == best) root->moves[kept++] = root->moves[i];
+    root->count = kept;
+}
+
+static void syzygyFree(void) {
+    for (int i = 0; i < syzygy.count; i++)
+        for (int type = 0; type < 2; type++) syzygyFreeFile(&syzygy.tables[i].files[type]);
+    SDL_free(syzygy.tables);
+    SDL_free(syzygy.paths);
+    SDL_zero(syzygy);
+}
+
+/* The Syzygy tables in the directories in paths (':' between them, ';' on Windows), replacing any found before;
+   NULL, "" or "<empty>" for none. Only the names are read now, the files when a probe first needs them. Returns
+   how many tables there are. Not while anything is searching. */
+int engineSetSyzygyPath(const char* paths) {
+    syzygyFree();
+    if (!paths || !*paths || SDL_strcmp(paths, "<empty>") == 0) return 0;
+    static bool indexReady;
+    if (!indexReady) { syzygyInitIndex(); indexReady = true; }
+    syzygy.paths = SDL_strdup(paths);
+    if (!syzygy.paths) return 0;
+    int capacity = 0;
+    for (const char* dir = paths; *dir;) {
+        const char* stop = SDL_strchr(dir, SYZYGY_PATH_SEPARATOR);
+        int length = stop ? (int)(stop - dir) : (int)SDL_strlen(dir);
+        char path[4096];
+        SDL_snprintf(path, sizeof(path), "%.*s", length, dir);
+        dir += length + (stop != NULL);
+        int found = 0;
+        char** names = length > 0 ? SDL_GlobDirectory(path, "*.rtbw", 0, &found) : NULL;
+        for (int i = 0; i < found; i++) {
+            SyzygyTable t;
+            if (!syzygyParseName(names[i], &t) || t.men > SYZYGY_MEN || syzygyFind(t.key)) continue;
+            if (syzygy.count == capacity) {
+                capacity = capacity ? 2 * capacity : 64;
+                SyzygyTable* grown = capacity <= SYZYGY_HASH / 2 ? SDL_realloc(syzygy.tables, capacity * sizeof(SyzygyTable)) : NULL;
+                if (!grown) break;
+                syzygy.tables = grown;
+            }
+            syzygy.tables[syzygy.count] = t;
+            syzygyInsert(t.key, syzygy.count);
+            if (t.key2 != t.key) syzygyInsert(t.key2, syzygy.count);
+            syzygy.largest = SDL_max(syzygy.largest, t.men);
+            syzygy.count++;
+        }
+        SDL_free(names);
+    }
+    return syzygy.count;
+}
+
+// probeTablebases (probeSyzygy past three men) at the root, for anyone outside a search: the self-play and match adjudication
+bool engineProbeTablebases(const ChessState* chess, int* score) {
+    int men = popcount64(chess->occupied);
+    if (men <= TB_MAX_PIECES) return probeTablebases(chess, 0, score);
+    ChessState position = *chess; // the probe makes and takes back the captures
+    return men <= syzygy.largest && probeSyzygy(&position, 0, score);
+}
+
+#define DELTA_MARGIN 200 // a capture that can't get within this of alpha even winning the piece isn't tried
+
+/* The side to move's evaluation, the network's when there is one; evaluatePosition may stop short once the
+   material and piece-square sum is far enough outside [alpha, beta], and takes it from the evaluation cache when
+   the position is in it. */
+static inline int staticEvaluation(ChessState* chess, int alpha, int beta, SearchContext* ctx) {
+    if (ctx->nnue) return nnueEvaluate(chess);
+    return chess->whiteToMove ? evaluatePosition(chess, ctx->pawns, ctx->evals, alpha, beta)
+                              : -evaluatePosition(chess, ctx->pawns, ctx->evals, -beta, -alpha);
+}
+
+/* Capture-only search below the horizon so leaves aren't scored half way through an exchange. The side to move
+   may stand pat on the static eval; scores are from the side to move's point of view, like minimaxAB. */
+static int quiescence(ChessState* chess, int alpha, int beta, Engine* engine, SearchContext* ctx) {
+    if (SDL_GetAtomicInt(&engine->stop)) return 0; // before the count, so a node limit is hit exactly
+    countNode(ctx, engine);
+    STAT(ctx, qnodes);
+    int tbScore; // a capture down to three men
+    if (ctx->tablebases && popcount64(chess->occupied) <= TB_MAX_PIECES && probeTablebases(chess, ctx->ply, &tbScore)) {
+        countEvent(&ctx->counter->tbHits);
+        return tbScore;
+    }
+    bool white = chess->whiteToMove;
+    int standPat;
+    TRACE_HOT(TRACE_EVAL, standPat = staticEvaluation(chess, alpha, beta, ctx));
+    if (standPat >= beta || ctx->ply >= SEARCH_STACK_PLIES) return standPat;
+    if (standPat > alpha) alpha = standPat;
+    MoveList* captures = &ctx->stack[ctx->ply].captures;
+    int* order = ctx->stack[ctx->ply].order;
+    TRACE_HOT(TRACE_MOVEGEN, generateCaptures(chess, captures));
+    for (int i = 0; i < captures->count; i++) order[i] = mvvLvaScore(chess, captures->moves[i]);
+    int best = standPat;
+    for (int i = 0; i < captures->count; i++) {
+        int pick = i; // selection sort, a cutoff usually comes after the first couple
+        for (int j = i + 1; j < captures->count; j++) if (order[j] > order[pick]) pick = j;
+        Move move = captures->moves[pick];
+        captures->moves[pick] = captures->moves[i]; order[pick] = order[i];
+        int gain = captureValue(chess, move) * 100; // same scale as evaluatePosition's material
+        if (standPat + gain + DELTA_MARGIN <= alpha) { // keep the fail-soft bound honest about what was skipped
+            if (standPat + gain + DELTA_MARGIN > best) best = standPat + gain + DELTA_MARGIN;
+            continue;
+        }
+        if (isLosingCapture(chess, move)) continue; // the exchange loses material: standing pat is better
+        searchMakeMove(ctx, chess, move);
+        if (isKingInCheck(chess, white)) { searchUnmakeMove(ctx, chess, move); continue; }
+        ctx->ply++; // only the tablebase mates need it counted down here
+        int score = -quiescence(chess, -beta, -alpha, engine, ctx);
+        ctx->ply--;
+        searchUnmakeMove(ctx, chess, move);
+        if (SDL_GetAtomicInt(&engine->stop)) return 0;
+        if (score > best) best = score;
+        if (best > alpha) alpha = best;
+        if (alpha >= beta) break;
+    }
+    return best;
+}
+
+
+// moves it, less the more extreme it already is, so a score settles within CONTINUATION_MAX of zero
+static inline void updateContinuation(Sint16* score, int bonus) {
+    *score = (Sint16)(*score + bonus - *score * abs(bonus) / CONTINUATION_MAX);
+}
+
+// the continuation history rows of a node at ply: after the move into it and the one before that (NULL: none)
+static inline void continuationRows(SearchContext* ctx, int ply, Sint16* rows[2]) {
+    for (int back = 1; back <= 2; back++) {
+        int earlier = ply >= back ? ctx->stack[ply - back].moved : 0;
+        rows[back - 1] = earlier ? ctx->continuation[earlier] : NULL;
+    }
+}
+
+/* A quiet move produced a cutoff at chess (the node, before the move): remember it as a killer for this ply and
+   as the counter-move to the last one, credit its history, and its continuation history after the last two moves.
+   The quiet moves searched before it without a cutoff lose as much continuation history as it gains. */
+static void recordQuietCutoff(SearchContext* ctx, const SearchOptions* opt, const ChessState* chess, int side,
+                              Move move, int depth, const Move* quiets, int quietCount) {
+    Move* killers = ctx->stack[ctx->ply].killers;
+    if (killers[0] != move) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+    int* h = &ctx->history[side][moveFrom(move)][moveTo(move)];
+    *h += depth * depth;
+    if (*h > HISTORY_MAX)
+        for (int from = 0; from < 64; from++) for (int to = 0; to < 64; to++) ctx->history[side][from][to] /= 2;
+    int last = ctx->ply > 0 ? ctx->stack[ctx->ply - 1].moved : 0;
+    if (opt->counterMoves && last) ctx->counterMoves[last] = move;
+    if (!opt->continuationHistory) return;
+    Sint16* rows[2];
+    continuationRows(ctx, ctx->ply, rows);
+    int bonus = SDL_min(32 * depth * depth, CONTINUATION_MAX / 4);
+    for (int r = 0; r < 2; r++) {
+        if (!rows[r]) continue;
+        updateContinuation(&rows[r][pieceToIndex(chess->board[moveFrom(move)], moveTo(move))], bonus);
+        for (int i = 0; i < quietCount; i++)
+            updateContinuation(&rows[r][pieceToIndex(chess->board[moveFrom(quiets[i])], moveTo(quiets[i]))], -bonus);
+    }
+}
+
+// pieces besides pawns and the king; with none, passing may really be the best move (zugzwang)
+static inline bool hasNonPawnMaterial(const ChessState* chess, int side) {
+    const Bitboard* bb = chess->pieceBB;
+    Bitboard pawnsAndKing = side == 0 ? bb[WHITE_PAWN] | bb[WHITE_KING] : bb[BLACK_PAWN] | bb[BLACK_KING];
+    return (chess->colorBB[side] & ~pawnsAndKing) != 0;
+}
+
+/* Young Brothers Wait split points. Once a node's first move has been searched without a cutoff, the rest of
+   its moves can be shared: the owner puts a SplitPoint on its own deque and idle helpers join the oldest open
+   one they can find (the biggest subtree left), taking moves from it until it runs dry. A cutoff found by any
+   of them marks the split point, and every thread working below it gives up. */
+#define MAX_SPLITS_PER_THREAD 8
+
+struct SplitPoint {
+    ChessState position;   // the node itself, for helpers to copy
+    Move moves[256];       // the moves left after the first, in picker order
+    int count;
+    int next;              // index of the next move to hand out
+    int legalMoves;        // legal moves taken so far, for the late move reductions
+    int depth, ply, extensions, beta;
+    int moved[2];          // the owner's SearchPly.moved of the two plies before, for the helpers' continuation history
+    bool white, inCheck;
+    int alpha, best;       // raised as results come in
+    Move bestMove;
+    SDL_SpinLock lock;     // guards next, legalMoves, alpha, best and bestMove
+    SDL_AtomicInt cutoff;  // 1 = beta cutoff, the rest of the work is pointless
+    SDL_AtomicInt helpers; // threads besides the owner still working here
+    SplitPoint* parent;    // split point the owner was working under, NULL at the top
+    Engine* engine;
+};
+
+// open split points of one searching thread, oldest first
+typedef struct {
+    SDL_SpinLock lock;
+    SplitPoint* items[MAX_SPLITS_PER_THREAD];
+    int count;
+} SplitDeque;
+
+static SplitDeque splitDeques[MAX_POOL_THREADS + 1]; // [0] is the engine thread's, then one per helper
+static int splitThreadCount;                         // deques in use
+static SDL_AtomicInt idleHelpers;                    // helpers looking for work; nodes are only split while > 0
+
+int minimaxAB(ChessState* chess, int depth, int alpha, int beta, Engine* engine, SearchContext* ctx);
+
+/* The search was stopped, or its result no longer matters: a cutoff at a split point this thread is working
+   under, or another root thread raising the best root score past the bound this root move is being tested
+   against (root_worker then tests it again against the new one). Checked at every node, so it's cheap. */
+static bool searchAborted(Engine* engine, const SearchContext* ctx) {
+    if (SDL_GetAtomicInt(&engine->stop)) return true;
+    if (ctx->speculative && !SDL_GetAtomicInt(&engine->pondering)) return true;
+    if (ctx->sharedAlpha && SDL_GetAtomicInt(ctx->sharedAlpha) > ctx->rootAlpha) return true;
+    if (ctx->resolved && SDL_GetAtomicInt(ctx->resolved)) return true;
+    for (SplitPoint* sp = ctx->sp; sp; sp = sp->parent)
+        if (SDL_GetAtomicInt(&sp->cutoff)) return true;
+    return false;
+}
+
+/* Score of a legal move already made on chess, moveNumber counting from 1: the first gets the full window, the
+   rest a null window (reduced first if late and quiet, or a losing capture) that is only widened when it fails
+   high. losingCapture: isLosingCapture, taken before the move was made. singular: it's the hash move and the only
+   good one (minimaxAB), extended like a check is; a line gets no more than EXTENSION_LIMIT plies of either. */
+static int searchChild(ChessState* chess, Move move, int moveNumber, int depth, int alpha, int beta, bool inCheck,
+                       bool losingCapture, bool singular, Engine* engine, SearchContext* ctx) {
+    const SearchOptions* opt = &engine->options;
+    bool white = !chess->whiteToMove; // the side that just moved
+    bool givesCheck = isKingInCheck(chess, !white);
+    int extension = 0;
+    if (ctx->extensions < EXTENSION_LIMIT) {
+        if (singular) extension = 1;
+        else if (givesCheck && opt->checkExtensions && !losingCapture) { extension = 1; STAT(ctx, checkExtensions); }
+    }
+    int newDepth = depth - 1 + extension;
+    int moved = pieceToIndex(chess->board[moveTo(move)], moveTo(move));
+    ctx->stack[ctx->ply].moved = moved;
+    ctx->ply++;
+    ctx->extensions += extension;
+    int score;
+    if (moveNumber == 1) {
+        score = -minimaxAB(chess, newDepth, -beta, -alpha, engine, ctx);
+    } else {
+        // late quiet moves and losing captures are probably bad: look at them shallower first, and at full depth
+        // only if they surprise
+        int reduction = 0;
+        if (opt->lateMoveReductions && depth >= opt->lmrMinDepth && moveNumber > opt->lmrMinMoves && !inCheck
+            && (isQuietMove(move) || losingCapture) && !givesCheck)
+            reduction = (moveNumber > 2 * opt->lmrMinMoves + 3 && depth >= 6) ? 2 : 1;
+        if (reduction > 0 && opt->continuationHistory && isQuietMove(move)) { // less for a proven follow-up, more for a poor one
+            Sint16* rows[2];
+            continuationRows(ctx, ctx->ply - 1, rows);
+            int score = (rows[0] ? rows[0][moved] : 0) + (rows[1] ? rows[1][moved] : 0);
+            reduction -= score / HISTORY_REDUCTION_STEP;
+            if (reduction > newDepth - 1) reduction = newDepth - 1;
+            if (reduction < 0) reduction = 0;
+        }
+        if (reduction > 0) STAT(ctx, lmrReductions);
+        score = -minimaxAB(chess, newDepth - reduction, -alpha - 1, -alpha, engine, ctx);
+        if (reduction > 0 && score > alpha) {
+            STAT(ctx, lmrResearches);
+            score = -minimaxAB(chess, newDepth, -alpha - 1, -alpha, engine, ctx);
+        }
+        if (score > alpha && score < beta) // beat the PV move: find out by how much
+            score = -minimaxAB(chess, newDepth, -beta, -alpha, engine, ctx);
+    }
+    ctx->extensions -= extension;
+    ctx->ply--;
+    return score;
+}
+
+// takes moves from sp until there are none left or one cuts off; chess is this thread's copy of sp's node
+static void searchSplitMoves(SplitPoint* sp, ChessState* chess, SearchContext* ctx) {
+    int side = sp->white ? 0 : 1;
+    while (!searchAborted(sp->engine, ctx)) {
+        SDL_LockSpinlock(&sp->lock);
+        if (sp->next >= sp->count) { SDL_UnlockSpinlock(&sp->lock); break; }
+        Move move = sp->moves[sp->next++];
+        SDL_UnlockSpinlock(&sp->lock);
+        bool losingCapture = isLosingCapture(chess, move);
+        searchMakeMove(ctx, chess, move);
+        if (isKingInCheck(chess, sp->white)) { searchUnmakeMove(ctx, chess, move); continue; }
+        ttPrefetch(sp->engine->tt, chess->hashKey);
+        SDL_LockSpinlock(&sp->lock);
+        int moveNumber = ++sp->legalMoves;
+        int alpha = sp->alpha; // may be stale by the time the result is in; the score is still a valid bound
+        SDL_UnlockSpinlock(&sp->lock);
+        int score = searchChild(chess, move, moveNumber, sp->depth, alpha, sp->beta, sp->inCheck, losingCapture,
+                                false, sp->engine, ctx);
+        searchUnmakeMove(ctx, chess, move);
+        if (searchAborted(sp->engine, ctx)) break;
+        SDL_LockSpinlock(&sp->lock);
+        if (score > sp->best) { sp->best = score; sp->bestMove = move; }
+        if (sp->best > sp->alpha) sp->alpha = sp->best;
+        bool cut = sp->alpha >= sp->beta;
+        SDL_UnlockSpinlock(&sp->lock);
+        if (cut) {
+            SDL_SetAtomicInt(&sp->cutoff, 1);
+            if (isQuietMove(move)) recordQuietCutoff(ctx, &sp->engine->options, &sp->position, side, move, sp->depth, NULL, 0);
+            break;
+        }
+    }
+}
+
+static bool isBelow(SplitPoint* sp, SplitPoint* ancestor) {
+    for (; sp; sp = sp->parent) if (sp == ancestor) return true;
+    return false;
+}
+
+// the oldest open split point of another thread (one under 'within', if given), already counted as joined
+static SplitPoint* joinSplitPoint(int self, SplitPoint* within) {
+    for (int t = 0; t < splitThreadCount; t++) {
+        SplitDeque* dq = &splitDeques[t];
+        if (t == self || dq->count == 0) continue;
+        SDL_LockSpinlock(&dq->lock);
+        for (int i = 0; i < dq->count; i++) {
+            SplitPoint* sp = dq->items[i];
+            if (sp->next < sp->count && !SDL_GetAtomicInt(&sp->cutoff) && (!within || isBelow(sp, within))) {
+                SDL_AddAtomicInt(&sp->helpers, 1); // under the deque lock, so the owner can't free it in between
+                SDL_UnlockSpinlock(&dq->lock);
+                return sp;
+            }
+        }
+        SDL_UnlockSpinlock(&dq->lock);
+    }
+    return NULL;
+}
+
+static void helpSplitPoint(SplitPoint* sp, SearchContext* ctx) {
+    ChessState position = sp->position;
+    SplitPoint* savedSp = ctx->sp;
+    int savedPly = ctx->ply, savedExtensions = ctx->extensions;
+    int savedMoved[2] = { 0, 0 };
+    ctx->sp = sp;
+    ctx->ply = sp->ply;
+    ctx->extensions = sp->extensions;
+    for (int back = 1; back <= 2 && back <= sp->ply; back++) {
+        savedMoved[back - 1] = ctx->stack[sp->ply - back].moved;
+        ctx->stack[sp->ply - back].moved = sp->moved[back - 1];
+    }
+    searchSplitMoves(sp, &position, ctx);
+    for (int back = 1; back <= 2 && back <= sp->ply; back++) ctx->stack[sp->ply - back].moved = savedMoved[back - 1];
+    ctx->sp = savedSp;
+    ctx->ply = savedPly;
+    ctx->extensions = savedExtensions;
+    SDL_AddAtomicInt(&sp->helpers, -1);
+}
+
+/* Shares the rest of the node's moves, the owner searching them alongside the helpers. Returns false, with the
+   picker untouched, if it couldn't; otherwise best, bestMove and legalMoves hold the node's result. */
+static bool splitNode(ChessState* chess, MovePicker* picker, int depth, int alpha, int beta, bool inCheck,
+                      int* best, Move* bestMove, int* legalMoves, Engine* engine, SearchContext* ctx) {
+    SplitDeque* dq = &splitDeques[ctx->threadId];
+    if (dq->count == MAX_SPLITS_PER_THREAD) return false;
+    SplitPoint* sp = SDL_malloc(sizeof(SplitPoint));
+    if (!sp) return false;
+    sp->position = *chess;
+    sp->count = 0;
+    Move move;
+    while (nextMove(picker, &move)) sp->moves[sp->count++] = move;
+    sp->next = 0;
+    sp->legalMoves = *legalMoves;
+    sp->depth = depth;
+    sp->ply = ctx->ply;
+    sp->extensions = ctx->extensions;
+    for (int back = 1; back <= 2; back++) sp->moved[back - 1] = ctx->ply >= back ? ctx->stack[ctx->ply - back].moved : 0;
+    sp->beta = beta;
+    sp->white = chess->whiteToMove;
+    sp->inCheck = inCheck;
+    sp->alpha = alpha;
+    sp->best = *best;
+    sp->bestMove = *bestMove;
+    sp->lock = 0;
+    SDL_SetAtomicInt(&sp->cutoff, 0);
+    SDL_SetAtomicInt(&sp->helpers, 0);
+    sp->parent = ctx->sp;
+    sp->engine = engine;
+
+    SDL_LockSpinlock(&dq->lock);
+    dq->items[dq->count++] = sp;
+    SDL_UnlockSpinlock(&dq->lock);
+    ctx->sp = sp;
+    searchSplitMoves(sp, chess, ctx);
+    SDL_LockSpinlock(&dq->lock);
+    dq->count--; // always the newest: any split further down has been taken off already
+    SDL_UnlockSpinlock(&dq->lock);
+    while (SDL_GetAtomicInt(&sp->helpers) > 0) { // rather than sit idle, help out the helpers still busy
+        SplitPoint* below = joinSplitPoint(ctx->threadId, sp);
+        if (below) helpSplitPoint(below, ctx);
+        else SDL_CPUPauseInstruction();
+    }
+    ctx->sp = sp->parent;
+    *best = sp->best;
+    *bestMove = sp->bestMove;
+    *legalMoves = sp->legalMoves;
+    SDL_free(sp);
+    return true;
+}
+
+#if defined(SEARCH_TREE)
+static SearchTreeSource searchTreeSource(const MovePicker* picker, Move move) {
+    if (move == picker->hashMove) return SEARCH_TREE_FROM_HASH;
+    switch (picker->stage) {
+    case STAGE_CAPTURES: return SEARCH_TREE_FROM_CAPTURE;
+    case STAGE_KILLERS: return picker->killerIndex == 3 ? SEARCH_TREE_FROM_COUNTER : SEARCH_TREE_FROM_KILLER;
+    case STAGE_QUIETS: return SEARCH_TREE_FROM_QUIET;
+    case STAGE_BAD_CAPTURES: return SEARCH_TREE_FROM_BAD_CAPTURE;
+    case STAGE_UNDERPROMOTIONS: return SEARCH_TREE_FROM_UNDERPROMOTION;
+    default: return SEARCH_TREE_FROM_EVASION;
+    }
+}
+
+static int searchTreeNode(ChessState* chess, int depth, int alpha, int beta, Engine* engine, SearchContext* ctx);
+
+/* minimaxAB in a SEARCH_TREE build: the node below, with a record for it to fill in as it goes, kept if the node
+   is one of the sample and wasn't given up part way. */
+int minimaxAB(ChessState* chess, int depth, int alpha, int beta, Engine* engine, SearchContext* ctx) {
+    SearchTreeRecord node = { .alpha = alpha, .beta = beta, .ply = (Uint8)ctx->ply, .depth = (Uint8)SDL_min(depth, 255),
+                              .flags = beta - alpha > 1 ? SEARCH_TREE_PV : 0 };
+    SearchTreeRecord* parent = ctx->tree;
+    Uint64 nodes = *ctx->nodes;
+    ctx->tree = &node;
+    int score = searchTreeNode(chess, depth, alpha, beta, engine, ctx);
+    ctx->tree = parent;
+    if (searchTreeSampled(chess, depth) && !searchAborted(engine, ctx)) {
+        node.nodes = *ctx->nodes - nodes;
+        node.score = score;
+        node.search = (Uint16)engine->treeSearch;
+        node.thread = (Uint8)(intptr_t)SDL_GetTLS(&searchThreadSlot);
+        searchTreeKeep(&node);
+    }
+    return score;
+}
+#define MINIMAX_NODE searchTreeNode
+#else
+#define MINIMAX_NODE minimaxAB
+#endif
+
+/* Negamax alpha-beta with principal variation search; scores are from the side to move's point of view. The
+   first move gets the full window, the rest a null window that is only re-searched when it fails high. With the
+   ply's excluded move set it's the singular test instead: the same node less that move, kept out of the table. */
+int MINIMAX_NODE(ChessState* chess, int depth, int alpha, int beta, Engine* engine, SearchContext* ctx) {
+    Move excluded = ctx->stack[ctx->ply].excluded;
+    bool afterNull = ctx->afterNull;
+    ctx->afterNull = false;
+    if (searchAborted(engine, ctx)) return 0; // the whole iteration (or split point) gets thrown away
+    countNode(ctx, engine); // only nodes that get searched count
+    // one repeat inside the search is scored as the draw it can be forced into
+    if (ctx->ply > 0 && (chess->halfmoveClock >= 100 || isRepetition(chess))) {
+        TREE_END(ctx, SEARCH_TREE_DRAW);
+        return DRAW_SCORE;
+    }
+    // a move back into an earlier position holds the draw, so the node scores at least that: above beta, a cutoff
+    if (ctx->ply > 0 && alpha < DRAW_SCORE && excluded == MOVE_NONE && engine->options.upcomingRepetition && upcomingRepetition(chess)) {
+        alpha = DRAW_SCORE;
+        if (alpha >= beta) {
+            STAT(ctx, cycleCutoffs);
+            TREE_END(ctx, SEARCH_TREE_DRAW);
+            return alpha;
+        }
+    }
+    int tbScore, men = popcount64(chess->occupied); // the piece count keeps all but the last few men from looking
+    if (ctx->ply > 0 && ctx->tablebases && men <= TB_LARGEST &&
+        (men <= TB_MAX_PIECES ? probeTablebases(chess, ctx->ply, &tbScore) : probeSyzygy(chess, ctx->ply, &tbScore))) {
+        countEvent(&ctx->counter->tbHits);
+        TREE_END(ctx, SEARCH_TREE_TABLEBASE);
+        return tbScore;
+    }
+    if (depth == 0 || ctx->ply >= MAX_PLY) {
+        TREE_END(ctx, SEARCH_TREE_QUIESCENCE);
+        return quiescence(chess, alpha, beta, engine, ctx);
+    }
+    bool white = chess->whiteToMove;
+    // mate distance pruning: even mating right now can't beat a mate already found closer to the root
+    if (alpha < -MATE_SCORE + ctx->ply) alpha = -MATE_SCORE + ctx->ply;
+    if (beta > MATE_SCORE - ctx->ply - 1) beta = MATE_SCORE - ctx->ply - 1;
+    if (alpha >= beta) {
+        TREE_END(ctx, SEARCH_TREE_MATE_DISTANCE);
+        return alpha;
+    }
+    int alphaOrig = alpha;
+    Move ttMove = MOVE_NONE, bestMove = MOVE_NONE;
+    int ttScore = 0, ttDepth = 0;
+    TTBound ttBound = TT_UPPER;
+    STAT(ctx, ttProbes);
+    countEvent(&ctx->counter->ttProbes);
+    if (ttProbe(engine->tt, chess->hashKey, ctx->ply, &ttMove, &ttScore, &ttDepth, &ttBound)) {
+        STAT(ctx, ttHits);
+        countEvent(&ctx->counter->ttHits);
+        if (excluded == MOVE_NONE && ttDepth >= depth && (ttBound == TT_EXACT || (ttBound == TT_LOWER && ttScore >= beta) || (ttBound == TT_UPPER && ttScore <= alpha))) {
+            STAT(ctx, ttCutoffs);
+            TREE_END(ctx, SEARCH_TREE_HASH_CUT);
+            return ttScore;
+        }
+    }
+    int side = white ? 0 : 1;
+    bool inCheck = isKingInCheck(chess, white);
+    const SearchOptions* opt = &engine->options;
+    if (inCheck) TREE_FLAG(ctx, SEARCH_TREE_IN_CHECK);
+    if (excluded != MOVE_NONE) TREE_FLAG(ctx, SEARCH_TREE_EXCLUDED);
+
+    /* Internal iterative reduction: with no hash move the picker's first guess is often poor, and a full-depth
+       search of a badly ordered PV node costs the most. It's searched a ply shallower instead; that search stores
+       a best move, so the next iteration finds the node ordered and at its full depth. (At null-window nodes it
+       tested worse: they're cheap, and reducing them loses more than it saves.) */
+    if (opt->internalReductions && ttMove == MOVE_NONE && depth >= opt->iirMinDepth && beta - alpha > 1) {
+        STAT(ctx, iirReductions);
+        TREE_FLAG(ctx, SEARCH_TREE_REDUCED);
+        depth--;
+    }
+
+    /* Near the leaves, at null-window nodes out of check, the static evaluation is trusted: far above beta the
+       node is taken as failing high (reverse futility), far below alpha it gets only quiescence (razoring) or
+       only its captures, promotions and checks (futility pruning, in the move loop). */
+    bool pruneOnEval = !inCheck && beta - alpha == 1 && excluded == MOVE_NONE && ctx->ply > 0 && alpha > -MATE_BOUND
+                       && beta < MATE_BOUND;
+    int staticEval = 0;
+    if (pruneOnEval && ((opt->reverseFutility && depth <= opt->reverseFutilityDepth) || (opt->razoring && depth <= opt->razorDepth)
+                        || (opt->futilityPruning && depth <= opt->futilityDepth)))
+        staticEval = staticEvaluation(chess, alpha, beta, ctx); // a lazy bound is on the safe side of both tests
+    else
+        pruneOnEval = false;
+    if (pruneOnEval && opt->reverseFutility && depth <= opt->reverseFutilityDepth
+        && staticEval - opt->reverseFutilityMargin * depth >= beta && hasNonPawnMaterial(chess, side)) {
+        STAT(ctx, reverseFutilityCutoffs);
+        TREE_END(ctx, SEARCH_TREE_REVERSE_FUTILITY);
+        return staticEval - opt->reverseFutilityMargin * depth;
+    }
+    if (pruneOnEval && opt->razoring && depth <= opt->razorDepth && staticEval + opt->razorMargin * depth < alpha) {
+        STAT(ctx, razorTries);
+        int score = quiescence(chess, alpha, beta, engine, ctx);
+        if (searchAborted(engine, ctx)) return 0;
+        if (score <= alpha) {
+            STAT(ctx, razorCutoffs);
+            TREE_END(ctx, SEARCH_TREE_RAZOR);
+            return score;
+        }
+    }
+    bool futile = pruneOnEval && opt->futilityPruning && depth <= opt->futilityDepth
+                  && staticEval + opt->futilityMargin * depth <= alpha;
+    CheckInfo checks = { .theirKing = -1 };
+    if (futile) initCheckInfo(chess, &checks);
+
+    // null move: if handing the opponent a free move still fails high, a real move would too
+    if (opt->nullMove && !afterNull && excluded == MOVE_NONE && !inCheck && depth >= opt->nullMoveMinDepth && beta < MATE_BOUND
+        && hasNonPawnMaterial(chess, side)) {
+        UndoInfo u;
+        STAT(ctx, nullTries);
+        TREE_FLAG(ctx, SEARCH_TREE_NULL_TRIED);
+        makeNullMove(chess, &u);
+        ttPrefetch(engine->tt, chess->hashKey);
+        ctx->stack[ctx->ply].moved = 0;
+        ctx->ply++;
+        ctx->afterNull = true;
+        int reduced = depth - 1 - opt->nullMoveReduction;
+        int score = -minimaxAB(chess, reduced > 0 ? reduced : 0, -beta, -beta + 1, engine, ctx);
+        ctx->afterNull = false;
+        ctx->ply--;
+        unmakeNullMove(chess, &u);
+        if (searchAborted(engine, ctx)) return 0;
+        if (score >= beta) {
+            STAT(ctx, nullCutoffs);
+            TREE_END(ctx, SEARCH_TREE_NULL_MOVE);
+            return score >= MATE_BOUND ? beta : score; // don't trust a mate found by passing
+        }
+    }
+
+    /* ProbCut: a capture that beats beta by the margin when searched PROBCUT_REDUCTION plies shallower will
+       almost surely beat beta at full depth, so the node fails high on it. Only captures SEE doesn't call losing
+       are tried, each first in quiescence, which turns most of them down for next to nothing; skipped when the
+       hash table already says the raised bound isn't reached at about this depth. */
+    int probBeta = beta + opt->probCutMargin;
+    if (opt->probCut && beta - alpha == 1 && !inCheck && excluded == MOVE_NONE && depth >= opt->probCutMinDepth
+        && beta > -MATE_BOUND && probBeta < MATE_BOUND
+        && !(ttDepth >= depth - PROBCUT_REDUCTION && ttBound != TT_LOWER && ttScore < probBeta)) {
+        MoveList* captures = &ctx->stack[ctx->ply].captures; // free here: quiescence only has it at its own plies
+        int* order = ctx->stack[ctx->ply].order;
+        generateCaptures(chess, captures);
+        for (int i = 0; i < captures->count; i++) order[i] = mvvLvaScore(chess, captures->moves[i]);
+        for (int i = 0; i < captures->count; i++) {
+            int pick = i;
+            for (int j = i + 1; j < captures->count; j++) if (order[j] > order[pick]) pick = j;
+            Move move = captures->moves[pick];
+            captures->moves[pick] = captures->moves[i]; order[pick] = order[i];
+            if (isLosingCapture(chess, move)) continue;
+            searchMakeMove(ctx, chess, move);
+            if (isKingInCheck(chess, white)) { searchUnmakeMove(ctx, chess, move); continue; }
+            STAT(ctx, probCutTries);
+            TREE_FLAG(ctx, SEARCH_TREE_PROBCUT_TRIED);
+            ctx->stack[ctx->ply].moved = pieceToIndex(chess->board[moveTo(move)], moveTo(move));
+            ctx->ply++;
+            int score = -quiescence(chess, -probBeta, -probBeta + 1, engine, ctx);
+            if (score >= probBeta)
+                score = -minimaxAB(chess, depth - 1 - PROBCUT_REDUCTION, -probBeta, -probBeta + 1, engine, ctx);
+            ctx->ply--;
+            searchUnmakeMove(ctx, chess, move);
+            if (searchAborted(engine, ctx)) return 0;
+            if (score >= probBeta) {
+                STAT(ctx, probCutCutoffs);
+                TREE_END(ctx, SEARCH_TREE_PROBCUT);
+                ttStore(engine->tt, chess->hashKey, ctx->ply, move, score, depth - PROBCUT_REDUCTION, TT_LOWER);
+                return score;
+            }
+        }
+    }
+
+    /* Singular extension: the hash move scored well enough, and deep enough, to be the likely best. If every other
+       move, searched to half the depth, fails low against a bound a little under its score, it's the only move
+       that holds and gets a ply more; a single forced line is then seen as deep as the rest of the tree. */
+    bool singular = false;
+    if (opt->singularExtensions && excluded == MOVE_NONE && ctx->ply > 0 && depth >= opt->singularMinDepth
+        && ttMove != MOVE_NONE && ttBound != TT_UPPER && ttDepth >= depth - 3 && ttScore > -MATE_BOUND
+        && ttScore < MATE_BOUND && ctx->extensions < EXTENSION_LIMIT) {
+        int singularBeta = ttScore - SINGULAR_MARGIN * depth;
+        STAT(ctx, singularTries);
+        ctx->stack[ctx->ply].excluded = ttMove;
+        int score = minimaxAB(chess, (depth - 1) / 2, singularBeta - 1, singularBeta, engine, ctx);
+        ctx->stack[ctx->ply].excluded = MOVE_NONE;
+        if (searchAborted(engine, ctx)) return 0;
+        if (score < singularBeta) {
+            STAT(ctx, singularExtensions);
+            TREE_FLAG(ctx, SEARCH_TREE_SINGULAR);
+            singular = true;
+        } else if (opt->multiCut && singularBeta >= beta) { // another move besides the hash move beats beta too
+            STAT(ctx, multiCuts);
+            TREE_END(ctx, SEARCH_TREE_MULTICUT);
+            return singularBeta;
+        }
+    }
+
+    SearchPly* here = &ctx->stack[ctx->ply];
+    int last = ctx->ply > 0 ? ctx->stack[ctx->ply - 1].moved : 0;
+    Move counterMove = opt->counterMoves && last ? ctx->counterMoves[last] : MOVE_NONE;
+    Sint16* rows[2] = { NULL, NULL };
+    if (opt->continuationHistory) continuationRows(ctx, ctx->ply, rows);
+    MovePicker* picker = &here->picker;
+    initMovePicker(picker, chess, ttMove, here->killers, counterMove, ctx->history[side], (const Sint16* const*)rows);
+    here->quietCount = 0;
+    int best = -INF;
+    int legalMoves = 0;
+    Move move;
+    while (nextMove(picker, &move)) {
+        if (move == excluded) continue;
+        bool losingCapture = picker->stage == STAGE_BAD_CAPTURES; // the picker has already run SEE on them
+        // can't raise the score the margin needs; counted as its bound, and not made at all when that's safe
+        bool prune = futile && legalMoves > 0 && isQuietMove(move) && !givesCheck(chess, &checks, move);
+        if (prune && surelyLegal(chess, &checks, move)) {
+            STAT(ctx, futilityPrunes);
+            TREE_PRUNED(ctx);
+            legalMoves++;
+            if (staticEval + opt->futilityMargin * depth > best) best = staticEval + opt->futilityMargin * depth;
+            continue;
+        }
+        if (opt->prefetchAhead > 0) { // the moves after this one, their buckets on the way while it's searched
+            Move ahead[PREFETCH_AHEAD_MAX];
+            int count = peekMoves(picker, ahead, SDL_min(opt->prefetchAhead, PREFETCH_AHEAD_MAX));
+            for (int i = 0; i < count; i++) ttPrefetch(engine->tt, keyAfterMove(chess, ahead[i]));
+        }
+        searchMakeMove(ctx, chess, move);
+        if (isKingInCheck(chess, white)) { searchUnmakeMove(ctx, chess, move); continue; }
+        if (prune) {
+            searchUnmakeMove(ctx, chess, move);
+            STAT(ctx, futilityPrunes);
+            TREE_PRUNED(ctx);
+            legalMoves++;
+            if (staticEval + opt->futilityMargin * depth > best) best = staticEval + opt->futilityMargin * depth;
+            continue;
+        }
+        ttPrefetch(engine->tt, chess->hashKey); // searchChild's bookkeeping covers some of the wait
+        legalMoves++;
+        int score = searchChild(chess, move, legalMoves, depth, alpha, beta, inCheck, losingCapture,
+                                singular && move == ttMove, engine, ctx);
+        searchUnmakeMove(ctx, chess, move);
+        if (searchAborted(engine, ctx)) return 0; // don't let a cut-short score into the table
+        if (score > best) { best = score; bestMove = move; }
+        if (best > alpha) alpha = best;
+        if (alpha >= beta) {
+            STAT(ctx, betaCutoffs);
+            if (legalMoves == 1) STAT(ctx, firstMoveCutoffs);
+            if (picker->stage == STAGE_KILLERS && picker->killerIndex == 3) STAT(ctx, counterMoveCutoffs);
+            TREE_CUT(ctx, legalMoves, picker, move);
+            if (isQuietMove(move)) recordQuietCutoff(ctx, opt, chess, side, move, depth, here->quiets, here->quietCount);
+            break;
+        }
+        if (isQuietMove(move) && here->quietCount < (int)SDL_arraysize(here->quiets)) here->quiets[here->quietCount++] = move;
+        // the eldest brother is done and didn't cut off: the rest may go in parallel
+        if (legalMoves == 1 && opt->splitPoints && excluded == MOVE_NONE && depth >= opt->splitMinDepth && SDL_GetAtomicInt(&idleHelpers) > 0
+            && splitNode(chess, picker, depth, alpha, beta, inCheck, &best, &bestMove, &legalMoves, engine, ctx)) {
+            TREE_FLAG(ctx, SEARCH_TREE_SPLIT);
+            if (searchAborted(engine, ctx)) return 0;
+            break;
+        }
+    }
+    TREE_MOVES(ctx, legalMoves);
+    if (legalMoves == 0) {
+        TREE_END(ctx, excluded != MOVE_NONE ? SEARCH_TREE_FAIL_LOW : SEARCH_TREE_NO_MOVES);
+        if (excluded != MOVE_NONE) return alpha; // the excluded move was the only one
+        if (inCheck)
+            return -MATE_SCORE + ctx->ply;
+        return DRAW_SCORE; // stalemate
+    }
+    TTBound bound = best <= alphaOrig ? TT_UPPER : best >= beta ? TT_LOWER : TT_EXACT;
+    TREE_END(ctx, bound == TT_UPPER ? SEARCH_TREE_FAIL_LOW : bound == TT_LOWER ? SEARCH_TREE_BETA_CUT : SEARCH_TREE_EXACT);
+    if (excluded != MOVE_NONE) return best; // not the node's score, so not for the table
+    ttStore(engine->tt, chess->hashKey, ctx->ply, bestMove, best, depth, bound);
+    return best;
+}
+
+typedef struct {
+    const ChessState* root; // copied by the thread that searches it, so the copy is in that core's memory
+    Move move;
+    int depth;
+    int score;
+    Engine* enginePtr;
+    SearchContext* ctx;     // NULL: the worker allocates its own
+
+    SDL_AtomicInt* sharedAlpha; // best root score so far, from the root side's point of view
+} RootThread;
+
+int SDLCALL root_worker(void* data) {
+    RootThread* rt = (RootThread*)data;
+    TRACE_BEGIN(rootMove);
+    SearchContext* ctx = rt->ctx ? rt->ctx : threadSearchContext(rt->enginePtr);
+    if (!ctx) { rt->score = -INF; return 0; } // never picked, and the iteration goes on without it
+    ChessState position = *rt->root;
+    UndoInfo u;
+    makeMove(&position, rt->move, &u);
+    ctx->stack[0].moved = pieceToIndex(position.board[moveTo(rt->move)], moveTo(rt->move));
+    ctx->sharedAlpha = rt->sharedAlpha;
+    int score;
+    for (;;) {
+        ctx->ply = 1;
+        int alpha = SDL_GetAtomicInt(rt->sharedAlpha);
+        ctx->rootAlpha = alpha;
+        // null window first: most root moves only need to be shown no better than the current best
+        score = -minimaxAB(&position, rt->depth - 1, -alpha - 1, -alpha, rt->enginePtr, ctx);
+        if (!searchAborted(rt->enginePtr, ctx) && score > alpha)
+            score = -minimaxAB(&position, rt->depth - 1, -INF, -alpha, rt->enginePtr, ctx);
+        if (SDL_GetAtomicInt(&rt->enginePtr->stop) || !searchAborted(rt->enginePtr, ctx)) break;
+        // another thread raised the best score while this one was searching: ask again with the new bound
+    }
+    ctx->sharedAlpha = NULL;
+    int old;
+    do {
+        old = SDL_GetAtomicInt(rt->sharedAlpha);
+        if (score <= old) break;
+    } while (!SDL_CompareAndSwapAtomicInt(rt->sharedAlpha, old, score));
+    rt->score = score;
+    TRACE_END(rootMove, TRACE_ROOT_MOVE, rt->move);
+    return 0;
+}
+
+/* Persistent worker pool for the search: created at startup, sized to the core count, and grown or shrunk between
+   searches (threadPoolResize). It runs the Lazy SMP helpers, findBestMove's root moves or the parallel aspiration windows, one job each, and
+   the caller waits for the batch. An idle worker first spins for a while (engineSetThreadSpin), so the next
+   batch of a run of short searches, or the next iteration's, starts without a wake-up, then sleeps on a condition
+   variable; it doesn't spin when the workers and the caller are more than there are cores, as it would then only
+   hold up the thread it waits for. With no workers (pool not started, or thread creation failed) jobs just run on
+   the caller. */
+#define POOL_QUEUE_SIZE 256
+#define POOL_SPIN_PAUSES 32 // pause instructions between two looks at the clock
+
+typedef struct {
+    SDL_ThreadFunction func;
+    void* data;
+    Uint64 submitted; // SDL_GetTicksNS, for the start latency
+} PoolJob;
+
+typedef struct ThreadPool ThreadPool;
+
+// what a worker is started with: threads[slot - 1] is its thread, slot its searchThreadSlot
+typedef struct {
+    ThreadPool* pool;
+    int slot;
+} PoolWorker;
+
+struct ThreadPool {
+    SDL_Thread* threads[MAX_POOL_THREADS];
+    PoolWorker workers[MAX_POOL_THREADS];
+    int threadCount;
+    SDL_Mutex* mutex;
+    SDL_Condition* workAvailable;
+    SDL_Condition* batchDone;
+    PoolJob jobs[POOL_QUEUE_SIZE]; // ring buffer
+    int head;
+    int queued;                    // jobs waiting in the ring
+    int pending;                   // jobs submitted and not finished yet
+    int keep;                      // workers with a higher slot leave (threadPoolResize)
+    int sleeping;                  // workers waiting on workAvailable, the only ones a submit has to signal
+    int cores;                     // logical cores, for whether spinning can pay
+    bool pinned;                   // worker n runs on logical core n only
+    bool quit;
+    Uint64 busyNS[MAX_POOL_THREADS + 1]; // time worker n spent on search work, by searchThreadSlot (atomic)
+    Uint64 waitNS;                 // time threadPoolWait's callers spent waiting (atomic)
+    ThreadWakeups wakeups;         // spinNS atomic, the rest under the mutex
+};
+
+static ThreadPool searchPool;
+static SDL_ThreadPriority searchPriority = SDL_THREAD_PRIORITY_NORMAL; // engineSetThreadPriority
+static Uint64 searchSpinNS = (Uint64)POOL_SPIN_US * 1000;              // engineSetThreadSpin (atomic)
+
+// each thread that searches, as it starts: below the window's, if asked, so a redraw never waits on a worker
+static void applySearchPriority(void) {
+    if (searchPriority != SDL_THREAD_PRIORITY_NORMAL && !SDL_SetCurrentThreadPriority(searchPriority))
+        SDL_Log("Could not change a search thread's priority: %s", SDL_GetError());
+}
+
+/* The stack of every thread that searches. The move lists are on the SearchContext's search stack, so even the
+   deepest search, MAX_PLY plies of minimaxAB, quiescence below them and split points nested in between, needs a
+   small part of it; the rest is for the unoptimised debug build, which CHESS_LOW_MEMORY doesn't leave room for. */
+#if defined(CHESS_LOW_MEMORY)
+#define SEARCH_THREAD_STACK (256 * 1024)
+#else
+#define SEARCH_THREAD_STACK (1024 * 1024)
+#endif
+
+static SDL_Thread* createSearchThread(SDL_ThreadFunction func, const char* name, void* data) {
+    SDL_PropertiesID props = SDL_CreateProperties();
+    if (!props) return NULL;
+    SDL_SetPointerProperty(props, SDL_PROP_THREAD_CREATE_ENTRY_FUNCTION_POINTER, (void*)func);
+    SDL_SetStringProperty(props, SDL_PROP_THREAD_CREATE_NAME_STRING, name);
+    SDL_SetPointerProperty(props, SDL_PROP_THREAD_CREATE_USERDATA_POINTER, data);
+    SDL_SetNumberProperty(props, SDL_PROP_THREAD_CREATE_STACKSIZE_NUMBER, SEARCH_THREAD_STACK);
+    SDL_Thread* thread = SDL_CreateThreadWithProperties(props);
+    SDL_DestroyProperties(props);
+    return thread;
+}
+
+// pins the calling thread to one logical core; false where that isn't supported
+static bool pinCurrentThread(int core) {
+#if defined(_WIN32)
+    if (core >= 64) return false; // one processor group only
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+static int SDLCALL poolWorker(void* arg) {
+    PoolWorker* worker = arg;
+    ThreadPool* pool = worker->pool;
+    int slot = worker->slot;
+    SDL_SetTLS(&searchThreadSlot, (void*)(intptr_t)slot, NULL);
+    // worker n on core n (wrapping round), so no two share a core and none wander between sockets
+    if (pool->pinned && !pinCurrentThread(slot % SDL_GetNumLogicalCPUCores()))
+        SDL_Log("Could not pin search thread %d", slot);
+    applySearchPriority();
+    SDL_LockMutex(pool->mutex);
+    for (;;) {
+        bool spun = false, parked = false;
+        Uint64 spin = __atomic_load_n(&searchSpinNS, __ATOMIC_RELAXED);
+        if (pool->queued == 0 && !pool->quit && slot <= pool->keep && spin > 0 && pool->threadCount < pool->cores) {
+            // spin first: watched without the lock, which the submit takes and the look after it takes again
+            SDL_UnlockMutex(pool->mutex);
+            Uint64 start = SDL_GetTicksNS(), now = start;
+            while (__atomic_load_n(&pool->queued, __ATOMIC_ACQUIRE) == 0 && !__atomic_load_n(&pool->quit, __ATOMIC_RELAXED) &&
+                   slot <= __atomic_load_n(&pool->keep, __ATOMIC_RELAXED) && now - start < spin) {
+                for (int i = 0; i < POOL_SPIN_PAUSES; i++) SDL_CPUPauseInstruction();
+                now = SDL_GetTicksNS();
+            }
+            __atomic_fetch_add(&pool->wakeups.spinNS, now - start, __ATOMIC_RELAXED);
+            SDL_LockMutex(pool->mutex);
+            spun = true;
+        }
+        while (pool->queued == 0 && !pool->quit && slot <= pool->keep) {
+            if (!parked) pool->sleeping++, pool->wakeups.parks++;
+            parked = true;
+            SDL_WaitCondition(pool->workAvailable, pool->mutex);
+        }
+        if (parked) pool->sleeping--;
+        if (pool->quit || slot > pool->keep) break;
+        PoolJob job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % POOL_QUEUE_SIZE;
+        pool->queued--;
+        pool->wakeups.jobs++;
+        if (spun && !parked) pool->wakeups.spunJobs++;
+        pool->wakeups.latencyNS += SDL_GetTicksNS() - job.submitted;
+        SDL_UnlockMutex(pool->mutex);
+        Uint64 start = SDL_GetTicksNS();
+        job.func(job.data);
+        __atomic_fetch_add(&pool->busyNS[slot], SDL_GetTicksNS() - start, __ATOMIC_RELAXED);
+        SDL_LockMutex(pool->mutex);
+        if (--pool->pending == 0) SDL_BroadcastCondition(pool->batchDone);
+    }
+    SDL_UnlockMutex(pool->mutex);
+    return 0;
+}
+
+// more workers, up to threadCount; false if not one more could be started
+static bool threadPoolGrow(ThreadPool* pool, int threadCount) {
+    int before = pool->threadCount;
+    pool->keep = SDL_min(threadCount, MAX_POOL_THREADS);
+    while (pool->threadCount < pool->keep) {
+        PoolWorker* worker = &pool->workers[pool->threadCount];
+        *worker = (PoolWorker){ pool, pool->threadCount + 1 };
+        SDL_Thread* t = createSearchThread(poolWorker, "search", worker);
+        if (!t) break; // run with however many we got
+        pool->threads[pool->threadCount++] = t;
+    }
+    pool->keep = pool->threadCount;
+    return pool->threadCount > before || threadCount <= before;
+}
+
+bool threadPoolInit(ThreadPool* pool, int threadCount, bool pinned) {
+    SDL_memset(pool, 0, sizeof(*pool));
+    pool->pinned = pinned;
+    pool->cores = SDL_GetNumLogicalCPUCores();
+    pool->mutex = SDL_CreateMutex();
+    pool->workAvailable = SDL_CreateCondition();
+    pool->batchDone = SDL_CreateCondition();
+    if (!pool->mutex || !pool->workAvailable || !pool->batchDone) return false;
+    threadPoolGrow(pool, threadCount);
+    return pool->threadCount > 0;
+}
+
+/* Grows or shrinks a started pool to threadCount workers, with nothing submitted; the workers kept stay as they
+   are, their slots and anything per slot (search contexts, node counters) with them. The last ones leave first. */
+bool threadPoolResize(ThreadPool* pool, int threadCount) {
+    threadCount = SDL_clamp(threadCount, 0, MAX_POOL_THREADS);
+    if (threadCount >= pool->threadCount) return threadPoolGrow(pool, threadCount);
+    SDL_LockMutex(pool->mutex);
+    pool->keep = threadCount;
+    SDL_BroadcastCondition(pool->workAvailable);
+    SDL_UnlockMutex(pool->mutex);
+    for (int i = threadCount; i < pool->threadCount; i++) SDL_WaitThread(pool->threads[i], NULL);
+    pool->threadCount = threadCount;
+    return true;
+}
+
+void threadPoolSubmit(ThreadPool* pool, SDL_ThreadFunction func, void* data) {
+    if (pool->threadCount == 0) { func(data); return; }
+    SDL_LockMutex(pool->mutex);
+    if (pool->queued == POOL_QUEUE_SIZE) { // can't happen with <= 255 root moves, but don't drop the job
+        SDL_UnlockMutex(pool->mutex);
+        func(data);
+        return;
+    }
+    pool->jobs[(pool->head + pool->queued) % POOL_QUEUE_SIZE] = (PoolJob){ func, data, SDL_GetTicksNS() };
+    pool->queued++;
+    pool->pending++;
+    if (pool->sleeping > 0) SDL_SignalCondition(pool->workAvailable); // a spinning worker sees the job by itself
+    SDL_UnlockMutex(pool->mutex);
+}
+
+// blocks until every submitted job has finished
+void threadPoolWait(ThreadPool* pool) {
+    if (pool->threadCount == 0) return;
+    TRACE_BEGIN(waiting);
+    Uint64 start = SDL_GetTicksNS();
+    SDL_LockMutex(pool->mutex);
+    while (pool->pending > 0) SDL_WaitCondition(pool->batchDone, pool->mutex);
+    SDL_UnlockMutex(pool->mutex);
+    __atomic_fetch_add(&pool->waitNS, SDL_GetTicksNS() - start, __ATOMIC_RELAXED);
+    TRACE_END(waiting, TRACE_POOL_WAIT, 0);
+}
+
+void threadPoolShutdown(ThreadPool* pool) {
+    if (pool->mutex) {
+        SDL_LockMutex(pool->mutex);
+        pool->quit = true;
+        SDL_BroadcastCondition(pool->workAvailable);
+        SDL_UnlockMutex(pool->mutex);
+    }
+    for (int i = 0; i < pool->threadCount; i++) SDL_WaitThread(pool->threads[i], NULL);
+    pool->threadCount = 0;
+    SDL_DestroyCondition(pool->workAvailable);
+    SDL_DestroyCondition(pool->batchDone);
+    SDL_DestroyMutex(pool->mutex);
+    SDL_memset(pool, 0, sizeof(*pool));
+}
+
+typedef struct {
+    TTEntry* entries;
+    size_t first, count;
+} TTSlice;
+
+static int SDLCALL ttClearSlice(void* data) {
+    TTSlice* slice = data;
+    SDL_memset(slice->entries + slice->first, 0, slice->count * sizeof(TTEntry));
+    return 0;
+}
+
+/* Writes a word of every page of the slice without changing it: the page is faulted in by the worker doing this
+   rather than by the first search to probe it, and safely so while one is already writing entries. */
+static int SDLCALL ttPrefaultSlice(void* data) {
+    TTSlice* slice = data;
+    Uint8* end = (Uint8*)(slice->entries + slice->first + slice->count);
+    for (Uint8* p = (Uint8*)(slice->entries + slice->first); p < end; p += 4096)
+        __atomic_fetch_or((Uint64*)p, 0, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// func over the table, a slice for each of the pool's workers
+static void ttSubmitSlices(TransTable* tt, ThreadPool* pool, SDL_ThreadFunction func, TTSlice slices[MAX_POOL_THREADS]) {
+    int n = pool->threadCount > 0 ? pool->threadCount : 1;
+    size_t entries = (size_t)(tt->mask + 1), per = (entries + n - 1) / n;
+    for (int i = 0; i < n; i++) {
+        slices[i].entries = tt->entries;
+        slices[i].first = per * i < entries ? per * i : entries;
+        slices[i].count = slices[i].first + per <= entries ? per : entries - slices[i].first;
+        threadPoolSubmit(pool, func, &slices[i]);
+    }
+}
+
+/* Clears the table from all the pool's workers at once. Pages belong to the NUMA node of the thread that first
+   writes them, so with the workers pinned this also interleaves a fresh table across the nodes they run on,
+   rather than leaving it all on the node of the thread that allocated it. */
+void ttClearParallel(TransTable* tt, ThreadPool* pool) {
+    if (!tt->entries) return;
+    TTSlice slices[MAX_POOL_THREADS];
+    ttSubmitSlices(tt, pool, ttClearSlice, slices);
+    threadPoolWait(pool);
+}
+
+/* The same for a table just allocated, which is zeroes already: its pages are touched on the workers and this
+   returns at once. Whatever next waits on the pool waits for that too; the table mustn't be let go of before. */
+static TTSlice prefaultSlices[MAX_POOL_THREADS];
+
+static void ttPrefault(TransTable* tt, ThreadPool* pool) {
+    if (tt->entries && pool->threadCount > 0) ttSubmitSlices(tt, pool, ttPrefaultSlice, prefaultSlices);
+}
+
+void initRootMoves(ChessState* chess, RootMoves* root, const TransTable* tt) {
+    MoveList legal;
+    getAllMoves(chess, &legal);
+    root->count = legal.count;
+    root->lastScore = 0;
+    root->depthDone = 0;
+    Move ttMove = MOVE_NONE;
+    int ttScore, ttDepth;
+    TTBound ttBound;
+    ttProbe(tt, chess->hashKey, 0, &ttMove, &ttScore, &ttDepth, &ttBound); // an earlier search of this position, if any
+    for (int i = 0; i < legal.count; i++) {
+        root->moves[i] = legal.moves[i];
+        root->scores[i] = 0;
+        if (legal.moves[i] == ttMove && i > 0) { // hash move first
+            root->moves[i] = root->moves[0];
+            root->moves[0] = ttMove;
+        }
+    }
+}
+
+// best first; insertion sort keeps equal scores in their previous order
+static void sortRootMoves(RootMoves* root) {
+    for (int i = 1; i < root->count; i++) {
+        Move m = root->moves[i];
+        int s = root->scores[i];
+        int j = i - 1;
+        while (j >= 0 && root->scores[j] < s) {
+            root->moves[j + 1] = root->moves[j];
+            root->scores[j + 1] = root->scores[j];
+            j--;
+        }
+        root->moves[j + 1] = m;
+        root->scores[j + 1] = s;
+    }
+}
+
+/* Searches root->moves[first..] and fills in their scores; returns the index of the best, or -1 if the search
+   was stopped part way. The first of them gets an aspiration window around its score from the last iteration;
+   the rest are split over the pool, unless Lazy SMP or split points are on (then the pool belongs to the
+   helpers), the search is a pool job itself or deterministic: then they are walked one after another. */
+static int searchRootFrom(ChessState* chess, int depth, Engine* engine, RootMoves* root, int first) {
+    const SearchOptions* opt = &engine->options;
+    bool split = !engine->poolJob && !opt->lazySmp && !opt->splitPoints && !opt->deterministic;
+    SearchContext* ctx = threadSearchContext(engine); // split root workers take their own
+    if (!ctx) return -1;
+    int best = first;
+    int bestScore;
+    {
+        TRACE_BEGIN(firstMove);
+        ctx->ply = 1;
+        ChessState tmp = *chess;
+        UndoInfo u;
+        makeMove(&tmp, root->moves[first], &u);
+        ctx->stack[0].moved = pieceToIndex(tmp.board[moveTo(root->moves[first])], moveTo(root->moves[first]));
+        if (root->depthDone > 0) {
+            int lo = root->scores[first] - opt->aspirationWindow, hi = root->scores[first] + opt->aspirationWindow;
+            bestScore = -minimaxAB(&tmp, depth - 1, -hi, -lo, engine, ctx);
+            if (bestScore <= lo || bestScore >= hi) // fell outside the window, only a bound: search it properly
+                bestScore = -minimaxAB(&tmp, depth - 1, -INF, INF, engine, ctx);
+        } else {
+            bestScore = -minimaxAB(&tmp, depth - 1, -INF, INF, engine, ctx);
+        }
+        TRACE_END(firstMove, TRACE_FIRST_MOVE, root->moves[first]);
+        if (searchAborted(engine, ctx)) return -1;
+    }
+    SDL_AtomicInt sharedAlpha;
+    SDL_SetAtomicInt(&sharedAlpha, bestScore);
+
+    RootThread* threads = SDL_calloc((size_t)root->count, sizeof(RootThread));
+    if (!threads) return -1;
+    for (int i = first + 1; i < root->count; i++) {
+        threads[i].root = chess;
+        threads[i].move = root->moves[i];
+        threads[i].depth = depth;
+        threads[i].enginePtr = engine;
+        threads[i].ctx = split ? NULL : ctx;
+        threads[i].sharedAlpha = &sharedAlpha;
+
+        if (split) threadPoolSubmit(&searchPool, root_worker, &threads[i]);
+        else root_worker(&threads[i]);
+    }
+    if (split) threadPoolWait(&searchPool);
+    if (SDL_GetAtomicInt(&engine->stop) || (ctx->speculative && !SDL_GetAtomicInt(&engine->pondering))) {
+        SDL_free(threads);
+        return -1;
+    }
+    root->scores[first] = bestScore;
+    for (int i = first + 1; i < root->count; i++) {
+        int s = threads[i].score;
+        root->scores[i] = s;
+        if (s > bestScore) {
+            bestScore = s;
+            best = i;
+        }
+    }
+    SDL_free(threads);
+    return best;
+}
+
+/* One iteration; returns MOVE_NONE when the search was stopped part way.
+   With engine->multiPv = N the N best moves end up in root->moves[0..N) with exact scores: each is the best of
+   the moves left after taking out the ones before it, so none of them needs a full-window search of its own. */
+Move findBestMove(ChessState* chess, int depth, Engine* engine, RootMoves* root) {
+    if (root->count == 0) return MOVE_NONE;
+    TRACE_BEGIN(iteration);
+    if (root->depthDone > 0) sortRootMoves(root);
+    int lines = engine->multiPv < 1 ? 1 : engine->multiPv < root->count ? engine->multiPv : root->count;
+    for (int k = 0; k < lines; k++) {
+        int best = searchRootFrom(chess, depth, engine, root, k);
+        if (best < 0) { TRACE_END(iteration, TRACE_ITERATION, depth); return MOVE_NONE; }
+        Move m = root->moves[best];
+        int s = root->scores[best];
+        root->moves[best] = root->moves[k];
+        root->scores[best] = root->scores[k];
+        root->moves[k] = m;
+        root->scores[k] = s;
+    }
+    root->lastScore = root->scores[0];
+    root->depthDone = depth;
+    ttStore(engine->tt, chess->hashKey, 0, root->moves[0], root->lastScore, depth, TT_EXACT); // seeds the next search that reaches this position
+    TRACE_END(iteration, TRACE_ITERATION, depth);
+    return root->moves[0];
+}
+
+/* Parallel aspiration (SearchOptions.parallelAspiration), a root strategy of its own in place of Lazy SMP and split
+   points: from the second iteration on, each of up to ASPIRATION_JOBS threads searches the whole root within a
+   window of its own about the last iteration's score. The first is aspirationWindow either side of it, the others
+   step out below and above it in turn, twice as wide every step, and the last is the full window. The first thread
+   back with a score inside its window has the iteration's exact answer: the others are called off
+   (SearchContext.resolved) and its scores taken. A score that moved since the last iteration is found by whichever
+   window it moved into, with no narrow search to fail first and a wider one to start after it. */
+#define ASPIRATION_JOBS 8
+
+typedef struct {
+    const ChessState* position;
+    RootMoves root;          // its own copy in the iteration's order, its scores filled in as it goes
+    Engine* engine;
+    int depth, lo, hi;       // the window, root side's point of view
+    SDL_AtomicInt* resolved; // 1 + the job with the exact score, 0 until one has it
+    int id;
+    int best;                // index of its best move, -1 if it was called off
+} AspirationJob;
+
+// the whole root within the job's window, PVS over the moves in order on the calling thread
+static int SDLCALL aspiration_worker(void* data) {
+    AspirationJob* job = data;
+    Engine* engine = job->engine;
+    RootMoves* root = &job->root;
+    job->best = -1;
+    SearchContext* ctx = threadSearchContext(engine);
+    if (!ctx) return 0;
+    ctx->resolved = job->resolved;
+    int alpha = job->lo, bestScore = -INF, best = 0;
+    for (int i = 0; i < root->count && alpha < job->hi; i++) {
+        ChessState position = *job->position;
+        UndoInfo u;
+        makeMove(&position, root->moves[i], &u);
+        ctx->ply = 1;
+        ctx->stack[0].moved = pieceToIndex(position.board[moveTo(root->moves[i])], moveTo(root->moves[i]));
+        int score = 0;
+        if (i > 0) score = -minimaxAB(&position, job->depth - 1, -alpha - 1, -alpha, engine, ctx);
+        if (i == 0 || (score > alpha && !searchAborted(engine, ctx)))
+            score = -minimaxAB(&position, job->depth - 1, -job->hi, -alpha, engine, ctx);
+        if (searchAborted(engine, ctx)) {
+            ctx->resolved = NULL;
+            return 0;
+        }
+        root->scores[i] = score;
+        if (score > bestScore) bestScore = score, best = i;
+        if (score > alpha) alpha = score;
+    }
+    ctx->resolved = NULL;
+    job->best = best;
+    if (bestScore > job->lo && bestScore < job->hi) SDL_CompareAndSwapAtomicInt(job->resolved, 0, job->id + 1);
+    return 0;
+}
+
+/* findBestMove for one line, the root searched by parallel aspiration over `jobs` threads, the calling one
+   included; the first iteration, or one with a single thread, is findBestMove's own. */
+static Move findBestMoveAspirated(ChessState* chess, int depth, Engine* engine, RootMoves* root, int jobs) {
+    AspirationJob* job = root->depthDone > 0 && jobs > 1 ? SDL_malloc(sizeof(AspirationJob) * (size_t)jobs) : NULL;
+    if (!job) return findBestMove(chess, depth, engine, root);
+    TRACE_BEGIN(iteration);
+    sortRootMoves(root);
+    SDL_AtomicInt resolved;
+    SDL_SetAtomicInt(&resolved, 0);
+    int width = SDL_max(engine->options.aspirationWindow, 1), below = root->lastScore, above = root->lastScore;
+    for (int j = 0; j < jobs; j++) {
+        int lo, hi; // a score on the edge of one window is inside the next
+        if (j == jobs - 1) lo = -INF, hi = INF;
+        else if (j == 0) lo = below = root->lastScore - width, hi = above = root->lastScore + width, width *= 2;
+        else if (j % 2) hi = below + 1, lo = below = below - width;
+        else lo = above - 1, hi = above = above + width, width *= 2;
+        job[j] = (AspirationJob){ .position = chess, .root = *root, .engine = engine, .depth = depth,
+                                  .lo = SDL_max(lo, -INF), .hi = SDL_min(hi, INF), .resolved = &resolved, .id = j };
+    }
+    for (int j = 1; j < jobs; j++) threadPoolSubmit(&searchPool, aspiration_worker, &job[j]);
+    aspiration_worker(&job[0]);
+    threadPoolWait(&searchPool);
+    int winner = SDL_GetAtomicInt(&resolved) - 1;
+    if (winner < 0) { // stopped before any had its answer
+        SDL_free(job);
+        TRACE_END(iteration, TRACE_ITERATION, depth);
+        return MOVE_NONE;
+    }
+    *root = job[winner].root;
+    int best = job[winner].best;
+    SDL_free(job);
+    Move m = root->moves[best];
+    int s = root->scores[best];
+    root->moves[best] = root->moves[0];
+    root->scores[best] = root->scores[0];
+    root->moves[0] = m;
+    root->scores[0] = s;
+    root->lastScore = s;
+    root->depthDone = depth;
+    ttStore(engine->tt, chess->hashKey, 0, m, s, depth, TT_EXACT);
+    TRACE_END(iteration, TRACE_ITERATION, depth);
+    return m;
+}
+
+/* The line after first, read back from the hash moves in the TT (the search keeps no PV of its own). Stops at a
+   missing or stale entry and at a repetition, which would otherwise loop for ever. */
+static int extractPv(const ChessState* chess, const TransTable* tt, Move first, Move* pv, int maxLength) {
+    ChessState pos = *chess;
+    int length = 0;
+    Move move = first;
+    while (move != MOVE_NONE && length < maxLength) {
+        pv[length++] = move;
+        makeMove(&pos, move, NULL);
+        if (isRepetition(&pos)) break;
+        Move next = MOVE_NONE;
+        int score, depth;
+        TTBound bound;
+        if (!ttProbe(tt, pos.hashKey, 0, &next, &score, &depth, &bound) || next == MOVE_NONE) break;
+        MoveList legal;
+        getAllMoves(&pos, &legal);
+        move = MOVE_NONE;
+        for (int i = 0; i < legal.count; i++)
+            if (legal.moves[i] == next) { move = next; break; }
+    }
+    return length;
+}
+
+/* A search to depth with nothing to do: an earlier one (the ponder search, another query of the analysis server)
+   has already stored an exact score for the root at least that deep. root is made that iteration, with the stored
+   move first. Not with more than one line wanted, nor near the fifty-move rule, which the entry knows nothing of. */
+#define ROOT_TABLE_HALFMOVES 90
+
+static bool rootFromTable(Engine* engine, const ChessState* chess, RootMoves* root, int depth) {
+    Move move;
+    int score, ttDepth;
+    TTBound bound;
+    if (depth <= 0 || engine->multiPv > 1 || root->count == 0 || chess->halfmoveClock >= ROOT_TABLE_HALFMOVES ||
+        !ttProbe(engine->tt, chess->hashKey, 0, &move, &score, &ttDepth, &bound) || bound != TT_EXACT ||
+        ttDepth < depth || move != root->moves[0]) // initRootMoves put it first, if it's legal
+        return false;
+    root->scores[0] = root->lastScore = score;
+    root->depthDone = ttDepth;
+    return true;
+}
+
+// sends the lines of the iteration that just finished to the UI, one info event each
+static void publishLines(Engine* engine, const ChessState* chess, const RootMoves* root, int depth) {
+    int count = engine->multiPv < 1 ? 1 : engine->multiPv;
+    if (count > MAX_MULTI_PV) count = MAX_MULTI_PV;
+    if (count > root->count) count = root->count;
+    Uint64 elapsed = SDL_GetTicksNS() - engine->startNS;
+    EngineEvent info = { .type = ENGINE_EVENT_INFO, .depth = depth, .lineCount = count };
+    info.nodes = engineNodeCount(engine);
+    info.nps = elapsed > 0 ? info.nodes * 1000000000 / elapsed : 0;
+    info.elapsedMs = (int)(elapsed / 1000000);
+    info.selDepth = engineSelDepth(engine);
+    info.hashfull = engineHashfull(engine);
+    for (int k = 0; k < count; k++) {
+        info.lineIndex = k;
+        info.line.score = root->scores[k];
+        info.line.length = extractPv(chess, engine->tt, root->moves[k], info.line.moves, MAX_PV_LENGTH);
+        if (!engineEmit(engine, &info, 1)) break; // the slot left over is for the best move
+    }
+}
+
+/* Search helper running on the pool alongside the engine thread until it raises the stop flag. */
+typedef struct {
+    const ChessState* position; // the helper works on its own copy (lazy SMP only)
+    const ChessState* reply;    // lazy SMP, pondering: another reply's position to search first, or NULL
+    Engine* engine;
+    int id;
+} SearchHelper;
+
+/* Lazy SMP: its own iterative deepening over the same position, talking to the other threads only through the
+   transposition table. Odd helpers run a ply ahead so the threads don't all fill in the same entries at the
+   same time. Its moves are never played. */
+static int SDLCALL lazy_helper(void* data) {
+    SearchHelper* h = (SearchHelper*)data;
+    SEARCH_LOG(h->engine, SEARCH_LOG_THREAD_START, 0, 0, MOVE_NONE, 0);
+    RootMoves root;
+    SearchContext* ctx = h->reply ? threadSearchContext(h->engine) : NULL;
+    if (ctx) { // its results stay in the hash table for when the user plays it; a ponder hit ends it
+        ChessState reply = *h->reply;
+        initRootMoves(&reply, &root, h->engine->tt);
+        ctx->speculative = true;
+        for (int d = 1 + (h->id & 1); d <= MOVE_DEPTH; d++)
+            if (findBestMove(&reply, d, h->engine, &root) == MOVE_NONE) break;
+        ctx->speculative = false;
+    }
+    ChessState position = *h->position; // then it helps with the search that counts
+    initRootMoves(&position, &root, h->engine->tt);
+    for (int d = 1 + (h->id & 1); d <= MOVE_DEPTH; d++)
+        if (findBestMove(&position, d, h->engine, &root) == MOVE_NONE) break;
+    SEARCH_LOG(h->engine, SEARCH_LOG_THREAD_STOP, 0, 0, MOVE_NONE, *searchThreadCounter(h->engine));
+    return 0;
+}
+
+// split points: waits for a node to be shared, helps with it, and goes back to waiting
+static int SDLCALL split_helper(void* data) {
+    SearchHelper* h = (SearchHelper*)data;
+    SearchContext* ctx = threadSearchContext(h->engine);
+    if (!ctx) return 0;
+    SEARCH_LOG(h->engine, SEARCH_LOG_THREAD_START, 0, 0, MOVE_NONE, 0);
+    ctx->threadId = h->id;
+    SDL_AddAtomicInt(&idleHelpers, 1);
+    Uint64 idleSince = SDL_GetTicksNS(), idle = 0; // the pool counts the whole job as busy, the waiting isn't
+    while (!SDL_GetAtomicInt(&h->engine->stop)) {
+        SplitPoint* sp = joinSplitPoint(h->id, NULL);
+        if (!sp) { SDL_CPUPauseInstruction(); continue; }
+        idle += SDL_GetTicksNS() - idleSince;
+        SDL_AddAtomicInt(&idleHelpers, -1);
+        TRACE_BEGIN(helping);
+        helpSplitPoint(sp, ctx);
+        TRACE_END(helping, TRACE_SPLIT_HELP, 0);
+        SDL_AddAtomicInt(&idleHelpers, 1);
+        idleSince = SDL_GetTicksNS();
+    }
+    idle += SDL_GetTicksNS() - idleSince;
+    __atomic_fetch_sub(&searchPool.busyNS[(intptr_t)SDL_GetTLS(&searchThreadSlot)], idle, __ATOMIC_RELAXED);
+    SDL_AddAtomicInt(&idleHelpers, -1);
+    SEARCH_LOG(h->engine, SEARCH_LOG_THREAD_STOP, 0, 0, MOVE_NONE, *ctx->nodes);
+    return 0;
+}
+
+/* Monte-Carlo tree search (SearchOptions.mcts), an experimental alternative to iterative deepening: PUCT over a
+   tree kept in one arena, MCTS_NODE_BYTES of nodes allocated for the search and handed out by an atomic counter,
+   so there's nothing to free node by node and no pointers, just indices. Each descent follows the child with the
+   best value plus an exploration bonus for a high prior and few visits; the leaf it reaches is expanded (its
+   children get priors from a quick look at each move: captures by their exchange, checks and promotions) and
+   queued. A thread collects MCTS_BATCH leaves before evaluating them together, then backs the results up the
+   paths. Every thread of the pool descends the same tree without a lock: a descent counts its visit on the way
+   down, before any result is in, which scores the path as a loss until one is (virtual loss) and so sends the
+   other threads, and this thread's own next descents in the batch, down other lines. Values are win
+   probabilities, fixed point, from the point of view of the side that made the move into the node. */
+#define MCTS_NODE_BYTES ((size_t)128 << 20)
+#define MCTS_BATCH 16         // leaves per evaluation batch and thread
+#define MCTS_CPUCT 1.5        // exploration constant
+#define MCTS_FPU_REDUCTION 0.2 // an unvisited child starts at its parent's value less this
+#define MCTS_VALUE_ONE 65536  // a win; values are summed in these units
+#define MCTS_INFO_MS 1000
+
+enum { MCTS_UNEXPANDED, MCTS_EXPANDING, MCTS_EXPANDED, MCTS_MATED, MCTS_DRAWN };
+
+typedef struct {
+    Sint64 value;       // results backed up through the node, MCTS_VALUE_ONE each at most (atomic)
+    Uint32 firstChild;  // index of the first of childCount, once expanded
+    Sint32 visits;      // descents through the node, the ones still waiting for a result included (atomic)
+    Uint16 childCount;
+    Move move;          // into this node
+    Uint16 prior;       // policy, out of 65535
+    Uint8 state;        // MCTS_*; expanding is one thread's claim, expanded publishes the children (atomic)
+} MctsNode;
+
+typedef struct {
+    MctsNode* nodes;    // [0] is the root
+    Uint32 capacity;
+    Uint32 used;        // nodes handed out (atomic), may run past capacity once the arena is full
+    const ChessState* root;
+    Engine* engine;
+} MctsTree;
+
+// a descent waiting for its leaf's value
+typedef struct {
+    Uint32 path[MAX_PLY + 1]; // node indices from the root
+    int length;
+} MctsPath;
+
+// centipawns for the side to move as the probability of winning, and back
+static inline Sint64 mctsValueOf(int score) {
+    if (score >= MATE_BOUND) return MCTS_VALUE_ONE;
+    if (score <= -MATE_BOUND) return 0;
+    return (Sint64)(MCTS_VALUE_ONE / (1.0 + SDL_pow(10.0, -score / 400.0)));
+}
+
+static inline int mctsScoreOf(double q) {
+    q = SDL_clamp(q, 0.001, 0.999);
+    return (int)(-400.0 * SDL_log10(1.0 / q - 1.0));
+}
+
+// a node's value from the point of view of the side that moved into it, unvisited = fallback
+static inline double mctsQ(const MctsNode* node, double fallback) {
+    Sint32 visits = __atomic_load_n(&node->visits, __ATOMIC_RELAXED);
+    if (visits <= 0) return fallback;
+    return (double)__atomic_load_n(&node->value, __ATOMIC_RELAXED) / ((double)visits * MCTS_VALUE_ONE);
+}
+
+static Uint32 mctsSelect(const MctsTree* tree, const MctsNode* parent) {
+    Sint32 parentVisits = __atomic_load_n(&parent->visits, __ATOMIC_RELAXED);
+    double explore = MCTS_CPUCT * SDL_sqrt((double)SDL_max(parentVisits, 1));
+    double fpu = 1.0 - mctsQ(parent, 0.5) - MCTS_FPU_REDUCTION; // the parent's value for its own side to move
+    Uint32 best = parent->firstChild;
+    double bestScore = -1e9;
+    for (Uint32 i = parent->firstChild; i < parent->firstChild + parent->childCount; i++) {
+        const MctsNode* child = &tree->nodes[i];
+        Sint32 visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+        double score = mctsQ(child, fpu) + explore * (child->prior / 65535.0) / (1 + visits);
+        if (score > bestScore) { bestScore = score; best = i; }
+    }
+    return best;
+}
+
+/* The children of the node for chess, claimed by this thread: their moves and priors, a softmax over a quick
+   score of each move. False when the arena is full, leaving the node a leaf. */
+static bool mctsExpand(MctsTree* tree, MctsNode* node, ChessState* chess, const MoveList* moves) {
+    Uint32 first = __atomic_fetch_add(&tree->used, (Uint32)moves->count, __ATOMIC_RELAXED);
+    if (first + (Uint64)moves->count > tree->capacity) return false;
+    CheckInfo checks;
+    initCheckInfo(chess, &checks);
+    double logits[256], total = 0, highest = -1e9;
+    for (int i = 0; i < moves->count; i++) {
+        Move m = moves->moves[i];
+        double logit = 0;
+        if (isCaptureMove(m)) logit += SDL_clamp(staticExchange(chess, m), -400, 900) / 150.0 + 0.5;
+        if (isPromotionMove(m)) logit += promotionPiece(m, true) == WHITE_QUEEN ? 2.0 : -1.0;
+        if (givesCheck(chess, &checks, m)) logit += 1.0;
+        logits[i] = logit;
+        highest = SDL_max(highest, logit);
+    }
+    for (int i = 0; i < moves->count; i++) total += logits[i] = SDL_exp(logits[i] - highest);
+    for (int i = 0; i < moves->count; i++) {
+        MctsNode* child = &tree->nodes[first + i];
+        *child = (MctsNode){ .move = moves->moves[i], .prior = (Uint16)SDL_max(logits[i] / total * 65535.0, 1.0) };
+    }
+    node->firstChild = first;
+    node->childCount = (Uint16)moves->count;
+    __atomic_store_n(&node->state, MCTS_EXPANDED, __ATOMIC_RELEASE);
+    return true;
+}
+
+// a result for the side to move at the path's end, up to the root; the visits were counted on the way down
+static void mctsBackup(MctsTree* tree, const MctsPath* path, Sint64 value) {
+    for (int i = path->length - 1; i >= 0; i--) {
+        value = MCTS_VALUE_ONE - value;
+        __atomic_fetch_add(&tree->nodes[path->path[i]].value, value, __ATOMIC_RELAXED);
+    }
+}
+
+static void mctsTakeBack(MctsTree* tree, const MctsPath* path) { // a descent that came to nothing
+    for (int i = 0; i < path->length; i++) __atomic_fetch_sub(&tree->nodes[path->path[i]].visits, 1, __ATOMIC_RELAXED);
+}
+
+/* One descent from the root, chess being the root position, which it is again on return. True when the leaf is to
+   be evaluated, copied to leaf; a game's end is backed up at once, and a node another thread is expanding makes it
+   give up. */
+static bool mctsDescend(MctsTree* tree, ChessState* chess, MctsPath* path, ChessState* leaf) {
+    UndoInfo undo[MAX_PLY];
+    Move played[MAX_PLY];
+    Uint32 index = 0;
+    path->length = 0;
+    bool evaluate = false;
+    for (;;) {
+        MctsNode* node = &tree->nodes[index];
+        __atomic_fetch_add(&node->visits, 1, __ATOMIC_RELAXED); // the virtual loss
+        path->path[path->length++] = index;
+        Uint8 state = __atomic_load_n(&node->state, __ATOMIC_ACQUIRE);
+        if (state == MCTS_EXPANDED && path->length <= MAX_PLY) {
+            index = mctsSelect(tree, node);
+            played[path->length - 1] = tree->nodes[index].move;
+            makeMove(chess, played[path->length - 1], &undo[path->length - 1]);
+            continue;
+        }
+        if (state == MCTS_MATED || state == MCTS_DRAWN) {
+            mctsBackup(tree, path, state == MCTS_MATED ? 0 : MCTS_VALUE_ONE / 2);
+        } else if (state == MCTS_EXPANDING) {
+            mctsTakeBack(tree, path);
+        } else if (state == MCTS_UNEXPANDED && __atomic_compare_exchange_n(&node->state, &state, MCTS_EXPANDING, false,
+                                                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            MoveList moves;
+            getAllMoves(chess, &moves);
+            Uint8 end = moves.count == 0 ? (isKingInCheck(chess, chess->whiteToMove) ? MCTS_MATED : MCTS_DRAWN)
+                      : index > 0 && (chess->halfmoveClock >= 100 || isRepetition(chess)) ? MCTS_DRAWN : MCTS_UNEXPANDED;
+            if (end != MCTS_UNEXPANDED) {
+                __atomic_store_n(&node->state, end, __ATOMIC_RELEASE);
+                mctsBackup(tree, path, end == MCTS_MATED ? 0 : MCTS_VALUE_ONE / 2);
+            } else {
+                if (!mctsExpand(tree, node, chess, &moves)) __atomic_store_n(&node->state, MCTS_UNEXPANDED, __ATOMIC_RELEASE);
+                evaluate = true;
+            }
+        } else if (state == MCTS_UNEXPANDED) {
+            mctsTakeBack(tree, path); // lost the race for it
+        } else {
+            evaluate = true; // MAX_PLY deep
+        }
+        break;
+    }
+    if (evaluate) SDL_memcpy(leaf, chess, copyMakeBytes()); // what the evaluation looks at, not the key ring
+    for (int i = path->length - 2; i >= 0; i--) unmakeMove(chess, played[i], &undo[i]);
+    return evaluate;
+}
+
+/* The leaves' values for their side to move, all at once: the network's output layer over the batch while its
+   weights are in cache, or the evaluation, one after another. A wider evaluator would slot in here. */
+static void mctsEvaluateBatch(ChessState* leaves, int count, SearchContext* ctx, Sint64 values[MCTS_BATCH]) {
+    for (int i = 0; i < count; i++) {
+        ChessState* leaf = &leaves[i];
+        int score = ctx->nnue ? nnueEvaluate(leaf)
+                  : leaf->whiteToMove ? evaluatePosition(leaf, ctx->pawns, NULL, -INF, INF) : -evaluatePosition(leaf, ctx->pawns, NULL, -INF, INF);
+        values[i] = mctsValueOf(score);
+    }
+}
+
+// the most visited child of a node, or none yet
+static Uint32 mctsMostVisited(const MctsTree* tree, const MctsNode* node) {
+    if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != MCTS_EXPANDED) return 0;
+    Uint32 best = 0;
+    Sint32 most = 0;
+    for (Uint32 i = node->firstChild; i < node->firstChild + node->childCount; i++) {
+        Sint32 visits = __atomic_load_n(&tree->nodes[i].visits, __ATOMIC_RELAXED);
+        if (visits > most) { most = visits; best = i; }
+    }
+    return best;
+}
+
+// the root's most visited moves with their lines, most visited first; the depth is the best line's length
+static int mctsPublish(MctsTree* tree) {
+    Engine* engine = tree->engine;
+    const MctsNode* root = &tree->nodes[0];
+    if (__atomic_load_n(&root->state, __ATOMIC_ACQUIRE) != MCTS_EXPANDED) return 0;
+    Uint32 lines[MAX_MULTI_PV];
+    int count = 0, want = SDL_clamp(engine->multiPv, 1, MAX_MULTI_PV);
+    bool taken[256] = { false };
+    for (; count < want && count < root->childCount; count++) {
+        Sint32 most = -1;
+        for (int i = 0; i < root->childCount; i++) {
+            Sint32 visits = __atomic_load_n(&tree->nodes[root->firstChild + i].visits, __ATOMIC_RELAXED);
+            if (!taken[i] && visits > most) { most = visits; lines[count] = root->firstChild + i; }
+        }
+        taken[lines[count] - root->firstChild] = true;
+    }
+    Uint64 elapsed = SDL_GetTicksNS() - engine->startNS;
+    EngineEvent info = { .type = ENGINE_EVENT_INFO, .lineCount = count };
+    info.nodes = engineNodeCount(engine);
+    info.nps = elapsed > 0 ? info.nodes * 1000000000 / elapsed : 0;
+    info.elapsedMs = (int)(elapsed / 1000000);
+    info.selDepth = engineSelDepth(engine);
+    info.hashfull = (int)(SDL_min(__atomic_load_n(&tree->used, __ATOMIC_RELAXED), tree->capacity) * 1000ULL / tree->capacity); // the arena's
+    for (int k = 0; k < count; k++) {
+        info.lineIndex = k;
+        info.line.score = mctsScoreOf(mctsQ(&tree->nodes[lines[k]], 0.5));
+        info.line.length = 0;
+        for (Uint32 n = lines[k]; n && info.line.length < MAX_PV_LENGTH; n = mctsMostVisited(tree, &tree->nodes[n]))
+            info.line.moves[info.line.length++] = tree->nodes[n].move;
+        if (k == 0) info.depth = info.line.length;
+        if (!engineEmit(engine, &info, 1)) break;
+    }
+    return info.depth;
+}
+
+// one searching thread: batches of descents until the engine stops
+static void mctsRun(MctsTree* tree, bool reporting) {
+    Engine* engine = tree->engine;
+    SearchContext* ctx = threadSearchContext(engine);
+    ChessState* leaves = SDL_malloc(MCTS_BATCH * sizeof(ChessState));
+    ChessState* chess = SDL_malloc(sizeof(ChessState));
+    MctsPath* paths = SDL_malloc(MCTS_BATCH * sizeof(MctsPath));
+    Uint64 reportedNS = SDL_GetTicksNS();
+    while (ctx && leaves && chess && paths && !SDL_GetAtomicInt(&engine->stop)) {
+        *chess = *tree->root;
+        int count = 0;
+        for (int b = 0; b < MCTS_BATCH && !SDL_GetAtomicInt(&engine->stop); b++) {
+            MctsPath* path = &paths[count];
+            if (mctsDescend(tree, chess, path, &leaves[count])) count++;
+            ctx->ply = path->length - 1;
+            countNode(ctx, engine);
+        }
+        Sint64 values[MCTS_BATCH];
+        mctsEvaluateBatch(leaves, count, ctx, values);
+        for (int i = 0; i < count; i++) mctsBackup(tree, &paths[i], values[i]);
+        if (reporting && SDL_GetTicksNS() - reportedNS >= (Uint64)MCTS_INFO_MS * 1000000) {
+            int depth = mctsPublish(tree);
+            if (engine->depthLimit > 0 && depth >= engine->depthLimit) SDL_SetAtomicInt(&engine->stop, 1);
+            reportedNS = SDL_GetTicksNS();
+        }
+        if (__atomic_load_n(&tree->used, __ATOMIC_RELAXED) >= tree->capacity && !engine->infinite) SDL_SetAtomicInt(&engine->stop, 1); // nothing more to learn
+    }
+    if (ctx) ctx->ply = 0;
+    SDL_free(paths);
+    SDL_free(chess);
+    SDL_free(leaves);
+}
+
+static int SDLCALL mcts_helper(void* data) {
+    MctsTree* tree = data;
+    SEARCH_LOG(tree->engine, SEARCH_LOG_THREAD_START, 0, 0, MOVE_NONE, 0);
+    mctsRun(tree, false);
+    SEARCH_LOG(tree->engine, SEARCH_LOG_THREAD_STOP, 0, 0, MOVE_NONE, *searchThreadCounter(tree->engine));
+    return 0;
+}
+
+/* The MCTS search of chess on the engine thread and the pool's, till the engine stops: its move is the root's
+   most visited. MOVE_NONE without the memory for the tree. */
+static Move mctsSearch(Engine* engine, const ChessState* chess) {
+    MctsTree tree = { .nodes = SDL_malloc(MCTS_NODE_BYTES), .capacity = (Uint32)(MCTS_NODE_BYTES / sizeof(MctsNode)),
+                      .used = 1, .root = chess, .engine = engine };
+    if (!tree.nodes) return MOVE_NONE;
+    tree.nodes[0] = (MctsNode){ .state = MCTS_UNEXPANDED };
+    int helperCount = engine->options.deterministic ? 0 : searchPool.threadCount - 1;
+    if (engine->threadLimit > 0) helperCount = SDL_min(helperCount, engine->threadLimit - 1);
+    for (int i = 0; i < helperCount; i++) threadPoolSubmit(&searchPool, mcts_helper, &tree);
+    mctsRun(&tree, true);
+    SDL_SetAtomicInt(&engine->stop, 1);
+    if (helperCount > 0) threadPoolWait(&searchPool);
+    mctsPublish(&tree);
+    Uint32 best = mctsMostVisited(&tree, &tree.nodes[0]);
+    Move move = best ? tree.nodes[best].move : tree.nodes[0].childCount ? tree.nodes[tree.nodes[0].firstChild].move : MOVE_NONE;
+    SDL_free(tree.nodes);
+    return move;
+}
+
+/* Searches the position beginSearch copied in, with the pool's help, sending its progress through the channel (or
+   the callback), and returns its move. When pondering it searches the position after ponderMove instead; the UI
+   holds that move back until a ponder hit. */
+/* Easy moves: a search on the clock whose position the last one foresaw (its move, then the reply it expected)
+   and whose best move is still the one it foresaw, with the score holding up, stops at a share of its soft time
+   instead of all of it: a recapture, or a move the hash table already had searched deep. The time saved goes to
+   the moves that need it. */
+#define EASY_MOVE_MIN_DEPTH 6       // iterations before the best move counts as confirmed
+#define EASY_MOVE_MARGIN 30         // how far below the foreseen score it may come
+#define EASY_MOVE_DIVISOR 4         // of the soft time
+#define EASY_RECAPTURE_DIVISOR 8
+
+// what the search of position will expect to play two plies on, from best's line in the hash table
+static void rememberExpectedLine(Engine* engine, const ChessState* position, Move best, int score) {
+    Move pv[MAX_PV_LENGTH];
+    engine->expectedKey = 0;
+    if (best == MOVE_NONE || extractPv(position, engine->tt, best, pv, MAX_PV_LENGTH) < 3) return;
+    ChessState chess = *position;
+    makeMove(&chess, pv[0], NULL);
+    makeMove(&chess, pv[1], NULL);
+    engine->expectedKey = chess.hashKey;
+    engine->expectedMove = pv[2];
+    engine->expectedScore = score;
+    engine->expectedRecapture = isCaptureMove(pv[1]) && isCaptureMove(pv[2]) && moveTo(pv[1]) == moveTo(pv[2]);
+}
+
+/* Time management on a clock (a soft time below the hard one): the soft time is what a move gets on average, and
+   after each iteration it's stretched or shrunk by how settled the search looks. A change of best move adds to
+   the instability, which halves every iteration; a score that fell since the last iteration stretches it too; a
+   best move that has held for TM_STABLE_DEPTHS iterations running shrinks it. Never past the hard time, where
+   the iteration under way is still abandoned. */
+#define TM_STABLE_DEPTHS 4
+#define TM_STABLE_PERCENT 60 // of the soft time, once the best move is stable
+#define TM_MIN_PERCENT 40
+#define TM_MAX_PERCENT 300
+
+typedef struct {
+    Move best;         // the last iteration's
+    int score;
+    int instability;   // percent of the soft time added for best move changes
+    int stableDepths;  // iterations in a row with the same best move
+} TimeManager;
+
+// the soft time to go by after an iteration that found best with score
+static Uint64 timeManagerUpdate(TimeManager* tm, const Engine* engine, Move best, int score, int depth) {
+    tm->instability /= 2;
+    if (depth > 1 && best != tm->best) {
+        tm->instability += 100;
+        tm->stableDepths = 0;
+    } else tm->stableDepths++;
+    int percent = 100 + tm->instability;
+    if (depth > 1 && score < tm->score && abs(score) < MATE_BOUND && abs(tm->score) < MATE_BOUND)
+        percent += SDL_min(tm->score - score, 100); // a centipawn lost, a percent more
+    if (tm->stableDepths >= TM_STABLE_DEPTHS) percent = percent * TM_STABLE_PERCENT / 100;
+    tm->best = best;
+    tm->score = score;
+    if (!engine->softTimeNS || engine->softTimeNS >= engine->hardTimeNS) return engine->softTimeNS; // no clock, or movetime
+    return SDL_min(engine->softTimeNS / 100 * (Uint64)SDL_clamp(percent, TM_MIN_PERCENT, TM_MAX_PERCENT), engine->hardTimeNS);
+}
+
+/* Multi-move pondering: the replies to the move just played (position) that the hash table has the best scores
+   for from the replying side's point of view, expected left out, best first; returns how many, up to max. */
+static int likelyReplies(ChessState* position, const TransTable* tt, Move expected, Move* replies, int max) {
+    MoveList legal;
+    getAllMoves(position, &legal);
+    int scores[PONDER_REPLIES_MAX], count = 0;
+    for (int i = 0; i < legal.count; i++) {
+        if (legal.moves[i] == expected) continue;
+        UndoInfo undo;
+        makeMove(position, legal.moves[i], &undo);
+        Move move;
+        int score, depth;
+        TTBound bound;
+        bool known = ttProbe(tt, position->hashKey, 0, &move, &score, &depth, &bound) && depth > 0;
+        unmakeMove(position, legal.moves[i], &undo);
+        if (!known) continue;
+        int j = count < max ? count++ : max; // insertion by score, the lowest for the side to move there first
+        while (j > 0 && scores[j - 1] > score) {
+            if (j < max) { scores[j] = scores[j - 1]; replies[j] = replies[j - 1]; }
+            j--;
+        }
+        if (j < max) { scores[j] = score; replies[j] = legal.moves[i]; }
+    }
+    return count;
+}
+
+static Move runEngineSearch(Engine* engine) {
+    TRACE_BEGIN(search);
+    resetNodeCounts(engine);
+    engine->searchId++; // the threads' contexts age what they learned in the last one
+    if (!engine->borrowedHash) ttNewSearch(engine->tt);
+    SEARCH_TREE_NEW_SEARCH(engine);
+    if (SDL_GetAtomicInt(&searchLog.on)) {
+        engine->logSearch = (Uint32)SDL_AddAtomicInt(&searchLog.searches, 1) + 1;
+        searchLogWrite(engine, SEARCH_LOG_START, engine->depthLimit, (int)(engine->softTimeNS / 1000000), MOVE_NONE,
+                       engine->hardTimeNS / 1000000);
+    }
+
+    ChessState snapshot = engine->position;
+    if (engine->ponderMove != MOVE_NONE) makeMove(&snapshot, engine->ponderMove, NULL);
+
+    Move best = MOVE_NONE;
+    RootMoves root;
+    initRootMoves(&snapshot, &root, engine->tt);
+    if (engine->options.tablebases) syzygyRankRootMoves(&snapshot, &root);
+    if (engine->ponderMove == MOVE_NONE && !engine->nodeLimit && rootFromTable(engine, &snapshot, &root, engine->depthLimit)) {
+        best = root.moves[0];
+        publishLines(engine, &snapshot, &root, root.depthDone);
+    }
+    Move easyMove = MOVE_NONE;
+    Uint64 easyTimeNS = 0;
+    if (engine->softTimeNS && engine->softTimeNS < engine->hardTimeNS && engine->expectedKey == snapshot.hashKey) // a clock, not movetime
+        for (int i = 0; i < root.count; i++)
+            if (root.moves[i] == engine->expectedMove) {
+                easyMove = engine->expectedMove;
+                easyTimeNS = engine->softTimeNS / (engine->expectedRecapture ? EASY_RECAPTURE_DIVISOR : EASY_MOVE_DIVISOR);
+            }
+
+    // the engine thread is one of the searchers, so one pool thread stays idle and the count matches the cores
+    const SearchOptions* opt = &engine->options;
+    if (best == MOVE_NONE && opt->mcts && root.count > 1) best = mctsSearch(engine, &snapshot); // MOVE_NONE: no memory for the tree
+    int aspirationJobs = best == MOVE_NONE && opt->parallelAspiration && root.count > 1 && !opt->deterministic &&
+                         !engine->poolJob && engine->multiPv <= 1 ? SDL_min(searchPool.threadCount, ASPIRATION_JOBS) : 0;
+    if (engine->threadLimit > 0) aspirationJobs = SDL_min(aspirationJobs, engine->threadLimit);
+    bool useHelpers = best == MOVE_NONE && (opt->lazySmp || opt->splitPoints) && root.count > 1 && !opt->deterministic && aspirationJobs < 2;
+    int helperCount = useHelpers ? searchPool.threadCount - 1 : 0;
+    if (engine->threadLimit > 0) helperCount = SDL_min(helperCount, engine->threadLimit - 1);
+    SearchHelper* helpers = helperCount > 0 ? SDL_calloc((size_t)helperCount, sizeof(SearchHelper)) : NULL;
+    if (!helpers) helperCount = 0;
+    splitThreadCount = helperCount + 1;
+    // pondering with lazy SMP: the helpers spread over the likeliest other replies too, every so many of them on each
+    ChessState* others = NULL;
+    int otherCount = 0;
+    if (helperCount > 0 && opt->lazySmp && engine->ponderMove != MOVE_NONE && engine->ponderReplies > 1) {
+        Move replies[PONDER_REPLIES_MAX];
+        ChessState before = engine->position;
+        otherCount = likelyReplies(&before, engine->tt, engine->ponderMove, replies,
+                                   SDL_min(SDL_min(engine->ponderReplies, PONDER_REPLIES_MAX) - 1, helperCount / 2));
+        others = otherCount > 0 ? SDL_malloc((size_t)otherCount * sizeof(ChessState)) : NULL;
+        if (!others) otherCount = 0;
+        for (int i = 0; i < otherCount; i++) {
+            others[i] = engine->position;
+            makeMove(&others[i], replies[i], NULL);
+        }
+    }
+    for (int i = 0; i < helperCount; i++) {
+        int other = i % (otherCount + 1) - 1; // -1: the expected reply, with the engine thread
+        helpers[i].position = &snapshot;
+        helpers[i].reply = other >= 0 ? &others[other] : NULL;
+        helpers[i].engine = engine;
+        helpers[i].id = i + 1;
+        threadPoolSubmit(&searchPool, opt->lazySmp ? lazy_helper : split_helper, &helpers[i]);
+    }
+
+    int maxDepth = best != MOVE_NONE ? 0 : engine->depthLimit > 0 ? SDL_min(engine->depthLimit, MOVE_DEPTH) : MOVE_DEPTH;
+    TimeManager tm = { 0 };
+    for (int d = 1; d <= maxDepth; d++) { // none once MCTS or the table has answered
+        Move m = aspirationJobs > 1 ? findBestMoveAspirated(&snapshot, d, engine, &root, aspirationJobs)
+                                    : findBestMove(&snapshot, d, engine, &root);
+        if (m == MOVE_NONE) { // stopped: keep the last completed iteration's move
+            if (root.count > 0)
+                SEARCH_LOG(engine, SEARCH_LOG_ABORT, d,
+                           engine->nodeLimit && engineNodeCount(engine) >= engine->nodeLimit ? SEARCH_LOG_OUT_OF_NODES
+                           : engine->hardTimeNS && SDL_GetTicksNS() - engine->startNS >= engine->hardTimeNS ? SEARCH_LOG_OUT_OF_TIME
+                           : SEARCH_LOG_STOPPED, MOVE_NONE, engineNodeCount(engine));
+            break;
+        }
+        if (d > 1 && m != best) SEARCH_LOG(engine, SEARCH_LOG_PV_CHANGE, d, root.lastScore, m, best);
+        best = m;
+        statIteration(engine, d);
+        SEARCH_LOG(engine, SEARCH_LOG_ITERATION, d, root.lastScore, best, engineNodeCount(engine));
+        publishLines(engine, &snapshot, &root, d);
+        Uint64 elapsed = SDL_GetTicksNS() - engine->startNS, softTimeNS = timeManagerUpdate(&tm, engine, best, root.lastScore, d);
+        bool outOfTime = softTimeNS && elapsed >= softTimeNS && !SDL_GetAtomicInt(&engine->pondering);
+        if (outOfTime || root.count == 1) break; // a forced reply needs no more thought
+        if (easyMove != MOVE_NONE && best == easyMove && d >= EASY_MOVE_MIN_DEPTH && elapsed >= easyTimeNS &&
+            root.lastScore > engine->expectedScore - EASY_MOVE_MARGIN && !SDL_GetAtomicInt(&engine->pondering)) break;
+        int mateDistance = MATE_SCORE - abs(root.lastScore); // plies to the mate, if the score is one
+        if (abs(root.lastScore) >= MATE_BOUND && mateDistance <= d) break; // found within full depth, nothing shorter left
+    }
+    if (best == MOVE_NONE && root.count > 0) best = root.moves[0]; // not even depth 1 finished
+    rememberExpectedLine(engine, &snapshot, best, root.lastScore);
+    EngineResult* result = &engine->results[snapshot.hashKey & (ENGINE_RESULTS - 1)];
+    if (root.depthDone > 0 && (result->key != snapshot.hashKey || result->depth <= root.depthDone))
+        *result = (EngineResult){ snapshot.hashKey, best, root.lastScore, root.depthDone };
+    if (helperCount > 0) {
+        SDL_SetAtomicInt(&engine->stop, 1); // the engine thread's answer is the one that counts
+        threadPoolWait(&searchPool);
+        SDL_free(helpers);
+    }
+    SDL_free(others);
+    SEARCH_LOG(engine, SEARCH_LOG_END, root.depthDone, root.lastScore, best, engineNodeCount(engine));
+    while (engine->infinite && !SDL_GetAtomicInt(&engine->stop)) SDL_Delay(1);
+    TRACE_END(search, TRACE_SEARCH, 0);
+    return best;
+}
+
+// engineStartSearch's thread: one search, then its move
+static int SDLCALL engine_thread_func(void* arg) {
+    Engine* engine = arg;
+    applySearchPriority();
+    EngineEvent done = { .type = ENGINE_EVENT_BEST_MOVE, .move = runEngineSearch(engine) };
+    if (!engineEmit(engine, &done, 0)) SDL_Log("Engine event queue full, move lost");
+    return 0;
+}
+
+/* Mate solver (solveMate): whether the side to move can force mate within a number of moves, and how. It's an
+   AND/OR search of its own rather than minimaxAB with no evaluation at all: at the attacker's nodes one move has
+   to work, at the defender's every reply has to lose, and nothing but proved and disproved is ever worked out.
+   The attacker's moves are tried in proof-number order, fewest replies first (the cheapest to prove), and with
+   checksOnly only checking moves are tried at all, which is what makes long mates cheap to find. Each result goes
+   into a table of its own, keyed by position, with the moves it was searched to; iterative deepening on the number
+   of moves then gives the shortest mate, every iteration reusing the last one's disproofs. Repetitions and the
+   fifty-move rule aren't looked at. */
+typedef struct {
+    Uint32 check;  // the key's high half
+    Move move;     // proved: the attacker's mating move
+    Uint8 moves;   // proved: a mate in at most this many; disproved: none in this many
+    Uint8 proven;
+} MateEntry;
+
+typedef struct {
+    MateEntry* entries;
+    Uint64 mask;
+    bool checksOnly;
+    Uint64 nodes, nodeLimit;
+    bool stopped;     // out of nodes: nothing more is stored, and the answer so far is no answer
+} MateSolver;
+
+static MateEntry* mateProbe(MateSolver* s, const ChessState* chess) {
+    MateEntry* e = &s->entries[chess->hashKey & s->mask];
+    return e->check == (Uint32)(chess->hashKey >> 32) && e->moves ? e : NULL;
+}
+
+static void mateStore(MateSolver* s, const ChessState* chess, int moves, bool proven, Move move) {
+    if (s->stopped) return;
+    MateEntry* e = &s->entries[chess->hashKey & s->mask];
+    *e = (MateEntry){ (Uint32)(chess->hashKey >> 32), move, (Uint8)moves, proven };
+}
+
+static bool mateAttack(MateSolver* s, ChessState* chess, int n);
+
+// every reply of the defender, to move in chess, loses within n - 1 more attacking moves
+static bool mateDefend(MateSolver* s, ChessState* chess, int n) {
+    MoveList replies;
+    getAllMoves(chess, &replies);
+    for (int i = 0; i < replies.count; i++) {
+        UndoInfo undo;
+        makeMove(chess, replies.moves[i], &undo);
+        s->nodes++;
+        bool lost = mateAttack(s, chess, n - 1);
+        unmakeMove(chess, replies.moves[i], &undo);
+        if (!lost) return false;
+    }
+    return true;
+}
+
+// the side to move forces mate within n moves
+static bool mateAttack(MateSolver* s, ChessState* chess, int n) {
+    const MateEntry* e = mateProbe(s, chess);
+    if (e && e->proven && e->moves <= n) return true;
+    if (e && !e->proven && e->moves >= n) return false;
+    if (s->nodeLimit && s->nodes >= s->nodeLimit) s->stopped = true;
+    if (s->stopped) return false;
+
+    CheckInfo checks = { .theirKing = -1 };
+    if (s->checksOnly) initCheckInfo(chess, &checks);
+    MoveList moves;
+    getAllMoves(chess, &moves);
+    Move candidates[256];
+    int replyCounts[256], count = 0;
+    for (int i = 0; i < moves.count; i++) {
+        Move m = moves.moves[i];
+        if (s->checksOnly && !givesCheck(chess, &checks, m)) continue;
+        UndoInfo undo;
+        makeMove(chess, m, &undo);
+        s->nodes++;
+        int replies = countLegalMoves(chess);
+        bool mated = replies == 0 && isKingInCheck(chess, chess->whiteToMove);
+        unmakeMove(chess, m, &undo);
+        if (mated) {
+            mateStore(s, chess, 1, true, m);
+            return true;
+        }
+        if (replies == 0) continue; // stalemate
+        int j = count++; // insertion sort, fewest replies first
+        for (; j > 0 && replyCounts[j - 1] > replies; j--) {
+            candidates[j] = candidates[j - 1];
+            replyCounts[j] = replyCounts[j - 1];
+        }
+        candidates[j] = m;
+        replyCounts[j] = replies;
+    }
+    for (int i = 0; n > 1 && i < count && !s->stopped; i++) {
+        UndoInfo undo;
+        makeMove(chess, candidates[i], &undo);
+        bool won = mateDefend(s, chess, n);
+        unmakeMove(chess, candidates[i], &undo);
+        if (won) {
+            mateStore(s, chess, n, true, candidates[i]);
+            return true;
+        }
+    }
+    mateStore(s, chess, n, false, MOVE_NONE);
+    return false;
+}
+
+// the shortest mate from here for the side to move, within n, or 0; cheap once the table has the answer
+static int mateDistance(MateSolver* s, ChessState* chess, int n) {
+    for (int k = 1; k <= n && !s->stopped; k++)
+        if (mateAttack(s, chess, k)) return k;
+    return 0;
+}
+
+bool solveMate(const ChessState* position, const MateQuery* query, MateResult* result) {
+    SDL_zerop(result);
+    size_t bytes = (query->hashMB ? query->hashMB : MATE_HASH_MB) << 20, count = 1;
+    while (count * 2 * sizeof(MateEntry) <= bytes) count *= 2;
+    MateSolver s = { .entries = SDL_calloc(count, sizeof(MateEntry)), .mask = count - 1,
+                     .checksOnly = query->checksOnly, .nodeLimit = query->nodeLimit };
+    if (!s.entries) return false;
+    ChessState chess = *position;
+    int maxMoves = SDL_clamp(query->maxMoves, 1, MATE_MAX_MOVES);
+    result->mateIn = mateDistance(&s, &chess, maxMoves);
+    result->complete = !s.stopped;
+
+    // the line: the attacker's move from the table, the defender's reply the one that holds out longest
+    for (int n = result->mateIn; n > 0 && !s.stopped; n--) {
+        if (!mateAttack(&s, &chess, n)) break; // from the table, unless it's been overwritten since
+        const MateEntry* e = mateProbe(&s, &chess);
+        if (!e || !e->proven) break;
+        UndoInfo undo;
+        result->pv[result->pvLength++] = e->move;
+        makeMove(&chess, e->move, &undo);
+        if (n == 1) break;
+        MoveList replies;
+        getAllMoves(&chess, &replies);
+        Move longest = MOVE_NONE;
+        int longestDistance = 0;
+        for (int i = 0; i < replies.count; i++) {
+            makeMove(&chess, replies.moves[i], &undo);
+            int d = mateDistance(&s, &chess, n - 1);
+            unmakeMove(&chess, replies.moves[i], &undo);
+            if (d > longestDistance) { longest = replies.moves[i]; longestDistance = d; }
+        }
+        if (longest == MOVE_NONE) break;
+        result->pv[result->pvLength++] = longest;
+        makeMove(&chess, longest, &undo);
+        n = longestDistance + 1;
+    }
+    result->nodes = s.nodes;
+    SDL_free(s.entries);
+    return true;
+}
+
+/* Opening books in Polyglot's format: BOOK_ENTRY_SIZE-byte entries sorted by key, big-endian Uint64 key, Uint16
+   move, Uint16 weight and Uint32 learn (unused). A move is the to file, to row, from file and from row in 3 bits
+   each, then the promotion (1-4 = N, B, R, Q); castling is written as the king taking its own rook. Keys follow
+   Polyglot's scheme: a number per piece kind (black pawn, white pawn, black knight, ...) and square, one per
+   castling right, the en passant file only when a pawn can take there, and one for white to move, the numbers
+   being Polyglot's published Random64 table (BOOK_KEYS), so any Polyglot book is read and the books `main book`
+   builds are read by any Polyglot tool; `perft suite` checks the keys against the format's test positions. An
+   opening explorer index (`main explorer`) is read as a book too: a BOOK_EXPLORER_MAGIC header, then
+   BOOK_EXPLORER_ENTRY_SIZE-byte entries, each a Polyglot entry followed by the games that played the move and
+   how many of them white won, drew and lost, big-endian Uint32s. */
+#define BOOK_ENTRY_SIZE 16
+#define BOOK_EXPLORER_MAGIC "chessexp"
+#define BOOK_EXPLORER_HEADER 16 // the magic and 8 bytes kept at zero
+#define BOOK_EXPLORER_ENTRY_SIZE 32
+#define BOOK_KEY_COUNT 781 // 12 * 64 pieces, 4 castling rights, 8 en passant files, white to move
+#define BOOK_MAX_MOVES 64  // choices kept for one position; a real book has a handful
+
+// Polyglot's Random64, by the index bookKey works out; fixed data rather than a generated table
+static const Uint64 BOOK_KEYS[BOOK_KEY_COUNT] = {
+    // black pawn, a1 to h8
+    0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+    0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+    0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+    0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+    0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+    0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+    0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+    0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+    0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+    0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+    0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+    0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+    0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+    0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+    0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+    0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+    // white pawn, a1 to h8
+    0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+    0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+    0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+    0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+    0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+    0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+    0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+    0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+    0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+    0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+    0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+    0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+    0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+    0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+    0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+    0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+    // black knight, a1 to h8
+    0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+    0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+    0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+    0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+    0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+    0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+    0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+    0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+    0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+    0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+    0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+    0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+    0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+    0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+    0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+    0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+    // white knight, a1 to h8
+    0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+    0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+    0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+    0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+    0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+    0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+    0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+    0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+    0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+    0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+    0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+    0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+    0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+    0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+    0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+    0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+    // black bishop, a1 to h8
+    0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+    0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+    0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+    0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+    0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+    0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+    0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+    0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+    0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+    0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+    0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+    0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+    0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+    0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+    0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+    0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+    // white bishop, a1 to h8
+    0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+    0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+    0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+    0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+    0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+    0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+    0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+    0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+    0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+    0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+    0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+    0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+    0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+    0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+    0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+    0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+    // black rook, a1 to h8
+    0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+    0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+    0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+    0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+    0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+    0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+    0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+    0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+    0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+    0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+    0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+    0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+    0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+    0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+    0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+    0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+    // white rook, a1 to h8
+    0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+    0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+    0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+    0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+    0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+    0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+    0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+    0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+    0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+    0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+    0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+    0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+    0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+    0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+    0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+    0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+    // black queen, a1 to h8
+    0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+    0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+    0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+    0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+    0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+    0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+    0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+    0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+    0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+    0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+    0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+    0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x1B6BACA2AE4E125BULL, 0x758F450C88572E0BULL,
+    0x959F587D507A8359ULL, 0xB063E962E045F54DULL, 0x60E8ED72C0DFF5D1ULL, 0x7B64978555326F9FULL,
+    0xFD080D236DA814BAULL, 0x8C90FD9B083F4558ULL, 0x106F72FE81E2C590ULL, 0x7976033A39F7D952ULL,
+    0xA4EC0132764CA04BULL, 0x733EA705FAE4FA77ULL, 0xB4D8F77BC3E56167ULL, 0x9E21F4F903B33FD9ULL,
+    0x9D765E419FB69F6DULL, 0xD30C088BA61EA5EFULL, 0x5D94337FBFAF7F5BULL, 0x1A4E4822EB4D7A59ULL,
+    // white queen, a1 to h8
+    0x6FFE73E81B637FB3ULL, 0xDDF957BC36D8B9CAULL, 0x64D0E29EEA8838B3ULL, 0x08DD9BDFD96B9F63ULL,
+    0x087E79E5A57D1D13ULL, 0xE328E230E3E2B3FBULL, 0x1C2559E30F0946BEULL, 0x720BF5F26F4D2EAAULL,
+    0xB0774D261CC609DBULL, 0x443F64EC5A371195ULL, 0x4112CF68649A260EULL, 0xD813F2FAB7F5C5CAULL,
+    0x660D3257380841EEULL, 0x59AC2C7873F910A3ULL, 0xE846963877671A17ULL, 0x93B633ABFA3469F8ULL,
+    0xC0C0F5A60EF4CDCFULL, 0xCAF21ECD4377B28CULL, 0x57277707199B8175ULL, 0x506C11B9D90E8B1DULL,
+    0xD83CC2687A19255FULL, 0x4A29C6465A314CD1ULL, 0xED2DF21216235097ULL, 0xB5635C95FF7296E2ULL,
+    0x22AF003AB672E811ULL, 0x52E762596BF68235ULL, 0x9AEBA33AC6ECC6B0ULL, 0x944F6DE09134DFB6ULL,
+    0x6C47BEC883A7DE39ULL, 0x6AD047C430A12104ULL, 0xA5B1CFDBA0AB4067ULL, 0x7C45D833AFF07862ULL,
+    0x5092EF950A16DA0BULL, 0x9338E69C052B8E7BULL, 0x455A4B4CFE30E3F5ULL, 0x6B02E63195AD0CF8ULL,
+    0x6B17B224BAD6BF27ULL, 0xD1E0CCD25BB9C169ULL, 0xDE0C89A556B9AE70ULL, 0x50065E535A213CF6ULL,
+    0x9C1169FA2777B874ULL, 0x78EDEFD694AF1EEDULL, 0x6DC93D9526A50E68ULL, 0xEE97F453F06791EDULL,
+    0x32AB0EDB696703D3ULL, 0x3A6853C7E70757A7ULL, 0x31865CED6120F37DULL, 0x67FEF95D92607890ULL,
+    0x1F2B1D1F15F6DC9CULL, 0xB69E38A8965C6B65ULL, 0xAA9119FF184CCCF4ULL, 0xF43C732873F24C13ULL,
+    0xFB4A3D794A9A80D2ULL, 0x3550C2321FD6109CULL, 0x371F77E76BB8417EULL, 0x6BFA9AAE5EC05779ULL,
+    0xCD04F3FF001A4778ULL, 0xE3273522064480CAULL, 0x9F91508BFFCFC14AULL, 0x049A7F41061A9E60ULL,
+    0xFCB6BE43A9F2FE9BULL, 0x08DE8A1C7797DA9BULL, 0x8F9887E6078735A1ULL, 0xB5B4071DBFC73A66ULL,
+    // black king, a1 to h8
+    0x230E343DFBA08D33ULL, 0x43ED7F5A0FAE657DULL, 0x3A88A0FBBCB05C63ULL, 0x21874B8B4D2DBC4FULL,
+    0x1BDEA12E35F6A8C9ULL, 0x53C065C6C8E63528ULL, 0xE34A1D250E7A8D6BULL, 0xD6B04D3B7651DD7EULL,
+    0x5E90277E7CB39E2DULL, 0x2C046F22062DC67DULL, 0xB10BB459132D0A26ULL, 0x3FA9DDFB67E2F199ULL,
+    0x0E09B88E1914F7AFULL, 0x10E8B35AF3EEAB37ULL, 0x9EEDECA8E272B933ULL, 0xD4C718BC4AE8AE5FULL,
+    0x81536D601170FC20ULL, 0x91B534F885818A06ULL, 0xEC8177F83F900978ULL, 0x190E714FADA5156EULL,
+    0xB592BF39B0364963ULL, 0x89C350C893AE7DC1ULL, 0xAC042E70F8B383F2ULL, 0xB49B52E587A1EE60ULL,
+    0xFB152FE3FF26DA89ULL, 0x3E666E6F69AE2C15ULL, 0x3B544EBE544C19F9ULL, 0xE805A1E290CF2456ULL,
+    0x24B33C9D7ED25117ULL, 0xE74733427B72F0C1ULL, 0x0A804D18B7097475ULL, 0x57E3306D881EDB4FULL,
+    0x4AE7D6A36EB5DBCBULL, 0x2D8D5432157064C8ULL, 0xD1E649DE1E7F268BULL, 0x8A328A1CEDFE552CULL,
+    0x07A3AEC79624C7DAULL, 0x84547DDC3E203C94ULL, 0x990A98FD5071D263ULL, 0x1A4FF12616EEFC89ULL,
+    0xF6F7FD1431714200ULL, 0x30C05B1BA332F41CULL, 0x8D2636B81555A786ULL, 0x46C9FEB55D120902ULL,
+    0xCCEC0A73B49C9921ULL, 0x4E9D2827355FC492ULL, 0x19EBB029435DCB0FULL, 0x4659D2B743848A2CULL,
+    0x963EF2C96B33BE31ULL, 0x74F85198B05A2E7DULL, 0x5A0F544DD2B1FB18ULL, 0x03727073C2E134B1ULL,
+    0xC7F6AA2DE59AEA61ULL, 0x352787BAA0D7C22FULL, 0x9853EAB63B5E0B35ULL, 0xABBDCDD7ED5C0860ULL,
+    0xCF05DAF5AC8D77B0ULL, 0x49CAD48CEBF4A71EULL, 0x7A4C10EC2158C4A6ULL, 0xD9E92AA246BF719EULL,
+    0x13AE978D09FE5557ULL, 0x730499AF921549FFULL, 0x4E4B705B92903BA4ULL, 0xFF577222C14F0A3AULL,
+    // white king, a1 to h8
+    0x55B6344CF97AAFAEULL, 0xB862225B055B6960ULL, 0xCAC09AFBDDD2CDB4ULL, 0xDAF8E9829FE96B5FULL,
+    0xB5FDFC5D3132C498ULL, 0x310CB380DB6F7503ULL, 0xE87FBB46217A360EULL, 0x2102AE466EBB1148ULL,
+    0xF8549E1A3AA5E00DULL, 0x07A69AFDCC42261AULL, 0xC4C118BFE78FEAAEULL, 0xF9F4892ED96BD438ULL,
+    0x1AF3DBE25D8F45DAULL, 0xF5B4B0B0D2DEEEB4ULL, 0x962ACEEFA82E1C84ULL, 0x046E3ECAAF453CE9ULL,
+    0xF05D129681949A4CULL, 0x964781CE734B3C84ULL, 0x9C2ED44081CE5FBDULL, 0x522E23F3925E319EULL,
+    0x177E00F9FC32F791ULL, 0x2BC60A63A6F3B3F2ULL, 0x222BBFAE61725606ULL, 0x486289DDCC3D6780ULL,
+    0x7DC7785B8EFDFC80ULL, 0x8AF38731C02BA980ULL, 0x1FAB64EA29A2DDF7ULL, 0xE4D9429322CD065AULL,
+    0x9DA058C67844F20CULL, 0x24C0E332B70019B0ULL, 0x233003B5A6CFE6ADULL, 0xD586BD01C5C217F6ULL,
+    0x5E5637885F29BC2BULL, 0x7EBA726D8C94094BULL, 0x0A56A5F0BFE39272ULL, 0xD79476A84EE20D06ULL,
+    0x9E4C1269BAA4BF37ULL, 0x17EFEE45B0DEE640ULL, 0x1D95B0A5FCF90BC6ULL, 0x93CBE0B699C2585DULL,
+    0x65FA4F227A2B6D79ULL, 0xD5F9E858292504D5ULL, 0xC2B5A03F71471A6FULL, 0x59300222B4561E00ULL,
+    0xCE2F8642CA0712DCULL, 0x7CA9723FBB2E8988ULL, 0x2785338347F2BA08ULL, 0xC61BB3A141E50E8CULL,
+    0x150F361DAB9DEC26ULL, 0x9F6A419D382595F4ULL, 0x64A53DC924FE7AC9ULL, 0x142DE49FFF7A7C3DULL,
+    0x0C335248857FA9E7ULL, 0x0A9C32D5EAE45305ULL, 0xE6C42178C4BBB92EULL, 0x71F1CE2490D20B07ULL,
+    0xF1BCC3D275AFE51AULL, 0xE728E8C83C334074ULL, 0x96FBF83A12884624ULL, 0x81A1549FD6573DA5ULL,
+    0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+    // castling: white kingside, white queenside, black kingside, black queenside
+    0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A0ULL, 0x1EF6E6DBB1961EC9ULL,
+    // en passant, files a to h
+    0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+    0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+    // white to move
+    0xF8D626AAAF278509ULL,
+};
+
+struct OpeningBook {
+    MappedFile file;
+    const Uint8* entries;
+    size_t count, entrySize;
+};
+
+Uint64 bookKey(const ChessState* chess) {
+    Uint64 key = 0;
+    for (Bitboard b = chess->occupied; b;) {
+        int sq = popLsb(&b);
+        PieceType p = chess->board[sq];
+        int kind = 2 * (pieceKind(p) - WHITE_PAWN) + isWhite(p);
+        key ^= BOOK_KEYS[64 * kind + sq];
+    }
+    for (int i = 0; i < 4; i++) if (chess->castlingRights & 1 << i) key ^= BOOK_KEYS[768 + i];
+    if (chess->enPassantCol >= 0) {
+        int row = chess->whiteToMove ? 4 : 3, col = chess->enPassantCol; // where the capturing pawns would stand
+        PieceType pawn = chess->whiteToMove ? WHITE_PAWN : BLACK_PAWN;
+        if ((col > 0 && pieceAt(chess, row, col - 1) == pawn) || (col < 7 && pieceAt(chess, row, col + 1) == pawn))
+            key ^= BOOK_KEYS[772 + col];
+    }
+    if (chess->whiteToMove) key ^= BOOK_KEYS[780];
+    return key;
+}
+
+// a legal move of the position the way a book stores it
+Uint16 bookEncodeMove(Move move) {
+    int from = moveFrom(move), to = moveTo(move);
+    if (isCastlingMove(move)) to = (from & ~7) | (moveFlags(move) == MOVE_CASTLE_KING ? 7 : 0);
+    int promotion = isPromotionMove(move) ? (moveFlags(move) & 3) + 1 : 0;
+    return (Uint16)((to & 7) | (to >> 3) << 3 | (from & 7) << 6 | (from >> 3) << 9 | promotion << 12);
+}
+
+// NULL, with the reason logged, for a file that can't be read or isn't a whole number of entries
+OpeningBook* bookOpen(const char* path) {
+    OpeningBook* book = SDL_calloc(1, sizeof(OpeningBook));
+    if (!book) return NULL;
+    if (!mapFile(&book->file, path)) {
+        SDL_Log("book: can't read %s: %s", path, SDL_GetError());
+        SDL_free(book);
+        return NULL;
+    }
+    bool explorer = book->file.size >= BOOK_EXPLORER_HEADER && SDL_memcmp(book->file.data, BOOK_EXPLORER_MAGIC, 8) == 0;
+    size_t header = explorer ? BOOK_EXPLORER_HEADER : 0;
+    book->entrySize = explorer ? BOOK_EXPLORER_ENTRY_SIZE : BOOK_ENTRY_SIZE;
+    if ((book->file.size - header) % book->entrySize != 0) {
+        SDL_Log("book: %s is not a Polyglot book or an explorer index", path);
+        bookClose(book);
+        return NULL;
+    }
+    book->entries = (const Uint8*)book->file.data + header;
+    book->count = (book->file.size - header) / book->entrySize;
+    return book;
+}
+
+void bookClose(OpeningBook* book) {
+    if (!book) return;
+    unmapFile(&book->file);
+    SDL_free(book);
+}
+
+static Uint64 bookEntryKey(const OpeningBook* book, size_t i) {
+    const Uint8* p = book->entries + i * book->entrySize;
+    Uint64 key = 0;
+    for (int b = 0; b < 8; b++) key = key << 8 | p[b];
+    return key;
+}
+
+static Uint32 bookEntryCount(const Uint8* p) {
+    return (Uint32)p[0] << 24 | (Uint32)p[1] << 16 | (Uint32)p[2] << 8 | p[3];
+}
+
+// the first entry of the key, or where it would be: a binary search
+static size_t bookFirstEntry(const OpeningBook* book, Uint64 key) {
+    size_t low = 0, high = book->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (bookEntryKey(book, mid) < key) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/* The book's moves for the position, most played first, up to max of them, with their games and results (the
+   results zero in a Polyglot book, whose weight is all it has); 0 when the position isn't in it. */
+int bookStats(const OpeningBook* book, ChessState* chess, BookMoveStats* stats, int max) {
+    if (!book) return 0;
+    Uint64 key = bookKey(chess);
+    MoveList legal;
+    getAllMoves(chess, &legal);
+    int count = 0;
+    for (size_t i = bookFirstEntry(book, key); i < book->count && count < max && bookEntryKey(book, i) == key; i++) {
+        const Uint8* p = book->entries + i * book->entrySize;
+        Uint16 encoded = (Uint16)(p[8] << 8 | p[9]);
+        for (int m = 0; m < legal.count; m++) {
+            if (bookEncodeMove(legal.moves[m]) != encoded) continue;
+            BookMoveStats* s = &stats[count++];
+            s->move = legal.moves[m];
+            bool explorer = book->entrySize == BOOK_EXPLORER_ENTRY_SIZE;
+            s->games = explorer ? bookEntryCount(p + 16) : (Uint32)(p[10] << 8 | p[11]);
+            s->whiteWins = explorer ? bookEntryCount(p + 20) : 0;
+            s->draws = explorer ? bookEntryCount(p + 24) : 0;
+            s->blackWins = explorer ? bookEntryCount(p + 28) : 0;
+            break;
+        }
+    }
+    return count;
+}
+
+/* One of the book's moves for the position, picked at random in proportion to the weights, or MOVE_NONE when the
+   position isn't in the book. Only the entries of the position are touched: a binary search finds the first. */
+Move bookProbe(const OpeningBook* book, ChessState* chess, Uint64* random) {
+    if (!book) return MOVE_NONE;
+    Uint64 key = bookKey(chess);
+    size_t low = bookFirstEntry(book, key);
+    MoveList legal;
+    getAllMoves(chess, &legal);
+    Move choices[BOOK_MAX_MOVES];
+    int weights[BOOK_MAX_MOVES], count = 0, total = 0;
+    for (size_t i = low; i < book->count && count < BOOK_MAX_MOVES && bookEntryKey(book, i) == key; i++) {
+        const Uint8* p = book->entries + i * book->entrySize;
+        Uint16 encoded = (Uint16)(p[8] << 8 | p[9]);
+        int weight = p[10] << 8 | p[11];
+        for (int m = 0; m < legal.count && weight > 0; m++) {
+            if (bookEncodeMove(legal.moves[m]) != encoded) continue;
+            choices[count] = legal.moves[m];
+            weights[count++] = weight;
+            total += weight;
+            break; // an entry for a move that isn't legal here (a key collision) is just skipped
+        }
+    }
+    if (total == 0) return MOVE_NONE;
+    int pick = SDL_rand_r(random, total);
+    for (int i = 0; i < count; i++)
+        if ((pick -= weights[i]) < 0) return choices[i];
+    return choices[count - 1];
+}
+
+// read-only, or read into memory where it can't be mapped (or is empty); false if it can't be read at all
+bool mapFile(MappedFile* mf, const char* path) {
+    SDL_memset(mf, 0, sizeof(*mf));
+    mf->data = "";
+#if defined(_WIN32)
+    mf->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER size;
+    if (mf->file != INVALID_HANDLE_VALUE && GetFileSizeEx(mf->file, &size)) {
+        mf->size = (size_t)size.QuadPart;
+        if (mf->size == 0) { // nothing to map
+            CloseHandle(mf->file);
+            mf->file = NULL;
+            return true;
+        }
+        mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const void* view = mf->mapping ? MapViewOfFile(mf->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (view) {
+            mf->data = view;
+            mf->mapped = true;
+            return true;
+        }
+        if (mf->mapping) CloseHandle(mf->mapping);
+    }
+    if (mf->file != INVALID_HANDLE_VALUE) CloseHandle(mf->file);
+    mf->mapping = NULL;
+    mf->file = INVALID_HANDLE_VALUE;
+#elif defined(__unix__) || defined(__APPLE__)
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0) {
+        mf->size = (size_t)st.st_size;
+        void* view = mf->size > 0 ? mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mf->size == 0) return true;
+        if (view != MAP_FAILED) {
+            madvise(view, mf->size, MADV_SEQUENTIAL); // read ahead, and let pages go once they're behind us
+            mf->data = view;
+            mf->mapped = true;
+            return true;
+        }
+    } else if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    size_t size = 0;
+    void* text = SDL_LoadFile(path, &size);
+    if (!text) return false;
+    if (size == 0) { SDL_free(text); return true; }
+    mf->data = text;
+    mf->size = size;
+    return true;
+}
+
+void unmapFile(MappedFile* mf) {
+    if (!mf->mapped) {
+        if (mf->size > 0) SDL_free((void*)mf->data);
+    } else {
+#if defined(_WIN32)
+        UnmapViewOfFile(mf->data);
+        CloseHandle(mf->mapping);
+        CloseHandle(mf->file);
+#elif defined(__unix__) || defined(__APPLE__)
+        munmap((void*)mf->data, mf->size);
+#endif
+    }
+    SDL_memset(mf, 0, sizeof(*mf));
+}
+
+/* Processor features beyond the baseline the engine is compiled for, looked up once, and the hot paths that have
+   a version for them bound to it: the slider lookup (BMI2 PEXT), the board sum (AVX2), the NNUE output layer
+   (AVX2, AVX-512) and the evaluation (POPCNT). One binary then runs on any x86-64 and at full speed on a new one.
+   CHESS_KERNELS=baseline in the environment keeps to the baseline, to try the fallbacks on a machine that
+   doesn't need them. Before the attack tables are built, which are laid out for the lookup that's chosen. */
+typedef struct {
+    bool popcnt, bmi2, avx2, avx512bw;
+} CpuFeatures;
+
+static void selectKernels(void) {
+    CpuFeatures cpu = { 0 };
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    cpu.popcnt = __builtin_cpu_supports("popcnt");
+    cpu.bmi2 = __builtin_cpu_supports("bmi2");
+    cpu.avx2 = SDL_HasAVX2(); // which also asks whether the OS saves the registers
+    cpu.avx512bw = SDL_HasAVX512F() && __builtin_cpu_supports("avx512bw");
+#endif
+    const char* only = SDL_getenv("CHESS_KERNELS");
+    if (only && SDL_strcmp(only, "baseline") == 0) cpu = (CpuFeatures){ 0 };
+    usePext = cpu.bmi2;
+    useAvx2BoardSum = cpu.avx2;
+#if defined(__x86_64__)
+    if (cpu.popcnt) evaluateKernel = evaluatePopcnt;
+    if (cpu.avx2) evaluateBatchKernel = evaluateBatchAvx2;
+    if (cpu.avx512bw) nnueDot = nnueDotAvx512, nnueDotKind = "AVX-512";
+    else if (cpu.avx2) nnueDot = nnueDotAvx2, nnueDotKind = "AVX2";
+#elif defined(__ARM_NEON)
+    nnueDot = nnueDotNeon, nnueDotKind = "NEON";
+#endif
+}
+
+void engineInitTables(void) {
+    static bool done = false;
+    if (done) return;
+    selectKernels();
+    initAttackTables();
+    initZobristKeys();
+    initCuckooTables();
+    initEvalTables();
+    initKpkBitbase();
+#if defined(SEARCH_TRACE)
+    traceOrigin = SDL_GetPerformanceCounter();
+#endif
+    done = true;
+}
+
+// the search threads every engine shares; false when none could be started, searches then run on one thread
+bool engineStartThreads(int threadCount, bool pinned) {
+    return threadPoolInit(&searchPool, threadCount, pinned);
+}
+
+/* Between searches, the pool grown or shrunk to threadCount workers without stopping the rest, or started (not
+   pinned) if it wasn't; false when it's left with none. A change of thread count wants engineSetMemoryLimit again. */
+bool engineSetThreads(int threadCount) {
+    if (!searchPool.mutex) return engineStartThreads(threadCount, false);
+    threadPoolWait(&searchPool); // a hash pre-fault still going finishes on the workers it's spread over
+    threadPoolResize(&searchPool, threadCount);
+    return searchPool.threadCount > 0;
+}
+
+/* The priority of every thread that searches (the pool's workers, the engine and request threads), from the next
+   one started: engineStartThreads' workers only if it's set first. Normal unless a program with a window of its
+   own to keep drawing asks for less. */
+void engineSetThreadPriority(SDL_ThreadPriority priority) {
+    searchPriority = priority;
+}
+
+/* What the pool's threads have done since they were started: busyNS[n] the time worker n (from 0) spent searching,
+   a split helper's wait for a node to share not included, and *waitNS the time searches spent waiting for the
+   workers to finish a batch. Returns the worker count. */
+int engineThreadActivity(Uint64 busyNS[MAX_POOL_THREADS], Uint64* waitNS) {
+    int count = searchPool.threadCount;
+    for (int i = 0; i < count; i++) busyNS[i] = __atomic_load_n(&searchPool.busyNS[i + 1], __ATOMIC_RELAXED);
+    *waitNS = __atomic_load_n(&searchPool.waitNS, __ATOMIC_RELAXED);
+    return count;
+}
+
+/* How long an idle worker spins, watching for the next job, before it goes to sleep: from the next time each one
+   runs out of work. 0 parks at once, the least CPU between searches and the slowest start to the next; the
+   default is POOL_SPIN_US. */
+void engineSetThreadSpin(int microseconds) {
+    __atomic_store_n(&searchSpinNS, (Uint64)SDL_max(microseconds, 0) * 1000, __ATOMIC_RELAXED);
+}
+
+// how the pool's workers have waited for their jobs since they were started (ThreadWakeups)
+void engineThreadWakeups(ThreadWakeups* wakeups) {
+    SDL_zerop(wakeups);
+    if (!searchPool.mutex) return;
+    SDL_LockMutex(searchPool.mutex);
+    *wakeups = searchPool.wakeups;
+    SDL_UnlockMutex(searchPool.mutex);
+    wakeups->spinNS = __atomic_load_n(&searchPool.wakeups.spinNS, __ATOMIC_RELAXED);
+}
+
+// each thread's nodes in this search, the engine thread's first and then the pool's workers; returns how many
+int engineThreadNodes(Engine* engine, Uint64 nodes[MAX_POOL_THREADS + 1]) {
+    int count = searchPool.threadCount + 1;
+    for (int i = 0; i < count; i++) nodes[i] = __atomic_load_n(&engine->nodeCounters[i].nodes, __ATOMIC_RELAXED);
+    return count;
+}
+
+/* The engine's memory, as near as it can be told: what it allocated or keeps in tables, and the stacks reserved
+   for its threads (SEARCH_THREAD_STACK each, committed only as far as they're used). */
+void engineMemoryUsage(Engine* engine, EngineMemory* memory) {
+    size_t threads = (size_t)searchPool.threadCount + 1; // the workers, and whichever thread runs the search
+    *memory = (EngineMemory){ 0 };
+    if (engine->tt->entries) memory->hash = (size_t)(engine->tt->mask + 1) * sizeof(TTEntry);
+    memory->pawnTables = threads * sizeof(PawnTable);
+    memory->evalCaches = engine->options.evalCache ? threads * sizeof(EvalCache) : 0;
+    memory->searchContexts = threads * sizeof(SearchContext);
+    memory->rootSplit = 256 * sizeof(RootThread);
+    memory->threadStacks = ((size_t)searchPool.threadCount + 1 + (engine->requestThread ? 1 : 0)) * SEARCH_THREAD_STACK;
+#if defined(CHESS_LOW_MEMORY)
+    memory->tables = sizeof(RAYS) + sizeof(BETWEEN) + sizeof(KPK_BITBASE) + sizeof(Engine)
+#else
+    memory->tables = sizeof(rookAttackTable) + sizeof(bishopAttackTable) + sizeof(BETWEEN) + sizeof(KPK_BITBASE) + sizeof(Engine)
+#endif
+                   + (nnueNet.copy ? NNUE_FILE_BYTES : 0) // a mapped network is the page cache's, shared
+                   + (SDL_GetAtomicInt(&tablebaseState) == 2 ? (size_t)TB_COUNT * TB_SIZE : 0)
+                   + (size_t)syzygy.count * sizeof(SyzygyTable); // its files are mapped, the page cache's too
+    memory->total = memory->hash + memory->pawnTables + memory->evalCaches + memory->searchContexts
+                  + memory->rootSplit + memory->threadStacks + memory->tables;
+}
+
+/* The build and the machine, for benchmark records; engineInitTables must have run, it picks the kernels. The
+   processor's name is its CPUID brand string on x86-64, "unknown" elsewhere. */
+void engineBuildInfo(EngineBuild* build) {
+    *build = (EngineBuild){ 0 };
+#if defined(__clang__)
+    SDL_strlcpy(build->compiler, "clang " __clang_version__, sizeof(build->compiler));
+#elif defined(__GNUC__)
+    SDL_strlcpy(build->compiler, "gcc " __VERSION__, sizeof(build->compiler));
+#else
+    SDL_strlcpy(build->compiler, "unknown", sizeof(build->compiler));
+#endif
+    SDL_strlcpy(build->built, __DATE__ " " __TIME__, sizeof(build->built));
+#if defined(__OPTIMIZE__)
+    SDL_strlcpy(build->options, "optimised", sizeof(build->options));
+#else
+    SDL_strlcpy(build->options, "unoptimised", sizeof(build->options));
+#endif
+#if defined(SEARCH_STATS)
+    SDL_strlcat(build->options, " SEARCH_STATS", sizeof(build->options));
+#endif
+#if defined(SEARCH_TRACE)
+    SDL_strlcat(build->options, " SEARCH_TRACE", sizeof(build->options));
+#endif
+#if COPY_MAKE
+    SDL_strlcat(build->options, " COPY_MAKE", sizeof(build->options));
+#endif
+#if defined(CHESS_LOW_MEMORY)
+    SDL_strlcat(build->options, " CHESS_LOW_MEMORY", sizeof(build->options));
+    const char* sliders = "rays";
+#else
+    const char* sliders = usePext ? "BMI2 PEXT" : "magic bitboards";
+#endif
+    SDL_snprintf(build->kernels, sizeof(build->kernels), "%s, %s board sum, %s eval, %s NNUE", sliders,
+                 useAvx2BoardSum ? "AVX2" : "scalar", evaluateKernel == evaluateBaseline ? "baseline" : "POPCNT", nnueDotKind);
+    SDL_strlcpy(build->cpu, "unknown", sizeof(build->cpu));
+#if defined(__x86_64__)
+    unsigned int brand[12];
+    if (__get_cpuid(0x80000004, &brand[0], &brand[1], &brand[2], &brand[3])) {
+        for (unsigned int leaf = 0; leaf < 3; leaf++)
+            __get_cpuid(0x80000002 + leaf, &brand[leaf * 4], &brand[leaf * 4 + 1], &brand[leaf * 4 + 2], &brand[leaf * 4 + 3]);
+        char name[sizeof(brand) + 1];
+        SDL_memcpy(name, brand, sizeof(brand));
+        name[sizeof(brand)] = '\0';
+        const char* start = name;
+        while (*start == ' ') start++; // some pad it on the left
+        if (*start) SDL_strlcpy(build->cpu, start, sizeof(build->cpu));
+    }
+#endif
+    build->cores = SDL_GetNumLogicalCPUCores();
+}
+
+void engineStopThreads(void) {
+    threadPoolShutdown(&searchPool);
+}
+
+/* Runs func(data) once on every search thread at the same time, or once on this thread if there are none, and
+   waits for them all. For jobs that run searches of their own (batch analysis); returns how many ran. */
+int engineRunOnThreads(SDL_ThreadFunction func, void* data) {
+    int workers = SDL_max(searchPool.threadCount, 1);
+    for (int i = 0; i < workers; i++) threadPoolSubmit(&searchPool, func, data);
+    threadPoolWait(&searchPool);
+    return workers;
+}
+
+// default options, one line, no hash table until engineSetHash; NULL without the memory
+Engine* engineCreate(void) {
+    Engine* engine = SDL_calloc(1, sizeof(Engine));
+    TransTable* tt = SDL_calloc(1, sizeof(TransTable));
+    SDL_Mutex* lock = SDL_CreateMutex();
+    SDL_Condition* signal = SDL_CreateCondition();
+    if (!engine || !tt || !lock || !signal) {
+        SDL_free(engine);
+        SDL_free(tt);
+        SDL_DestroyMutex(lock);
+        SDL_DestroyCondition(signal);
+        return NULL;
+    }
+    engine->requestLock = lock;
+    engine->requestSignal = signal;
+    engine->options = DEFAULT_SEARCH_OPTIONS;
+    engine->multiPv = 1;
+    engine->tt = tt;
+    engine->memoryLimit = (size_t)MEMORY_CEILING_MB * 1024 * 1024;
+    engine->bookRandom = SDL_GetTicksNS();
+    return engine;
+}
+
+void engineDestroy(Engine* engine) {
+    if (!engine) return;
+    engineStopSearch(engine);
+    if (!SDL_GetTLS(&searchThreadSlot)) threadPoolWait(&searchPool); // its table's pre-fault, if that's still going
+    if (engine->requestThread) { // requests still queued are answered MOVE_NONE on its way out
+        SDL_LockMutex(engine->requestLock);
+        engine->requestQuit = true;
+        SDL_SetAtomicInt(&engine->stop, 1);
+        SDL_BroadcastCondition(engine->requestSignal);
+        SDL_UnlockMutex(engine->requestLock);
+        SDL_WaitThread(engine->requestThread, NULL);
+    }
+    SDL_DestroyMutex(engine->requestLock);
+    SDL_DestroyCondition(engine->requestSignal);
+    arenaDestroy(&engine->interleaveArena);
+    if (!engine->borrowedHash) {
+        ttFree(engine->tt);
+        SDL_free(engine->tt);
+    }
+    for (int i = 0; i <= MAX_POOL_THREADS; i++) SDL_free(engine->contexts[i]);
+    SDL_free(engine);
+}
+
+// permille of the hash table the current (or last) search has written to; 0 without a table
+int engineHashfull(const Engine* engine) {
+    return ttHashfull(engine->tt);
+}
+
+// not while it is searching; false (and the old table kept) if the memory isn't there
+/* The hash table, megabytes in size or, with a memory limit, as much of that as fits beside everything else
+   (never less than 1 MB); false when it couldn't be allocated, the old table is kept then. */
+/* A new table is faulted in on the pool's workers in the background (ttPrefault), unless this is called on one of
+   them, so the first search doesn't pay for it; the next search or resize waits for what's left of that. */
+bool engineSetHash(Engine* engine, size_t megabytes) {
+    if (engine->borrowedHash) return SDL_SetError("the hash table is another engine's");
+    bool poolFree = !SDL_GetTLS(&searchThreadSlot); // a game running on a worker can't wait on the workers
+    if (poolFree) threadPoolWait(&searchPool); // the old table's pre-fault finished before it goes
+    engine->hashMB = megabytes;
+    if (engine->memoryLimit > 0) {
+        EngineMemory memory;
+        engineMemoryUsage(engine, &memory);
+        size_t others = memory.total - memory.hash;
+        size_t room = engine->memoryLimit > others ? (engine->memoryLimit - others) / (1024 * 1024) : 0;
+        megabytes = SDL_clamp(room, 1, megabytes);
+    }
+    if (engine->hashShareName[0]) return ttShare(engine->tt, engine->hashShareName, megabytes);
+    if (!ttResize(engine->tt, megabytes)) return false;
+    if (poolFree) ttPrefault(engine->tt, &searchPool);
+    return true;
+}
+
+/* Puts the table in the shared-memory segment called name (ttShare), joining it if another engine process on
+   the host has made it, or with an empty name back in memory of its own; later engineSetHash calls keep to
+   that. A failure is logged and leaves the engine where it was. */
+bool engineShareHash(Engine* engine, const char* name) {
+    char previous[sizeof(engine->hashShareName)];
+    SDL_strlcpy(previous, engine->hashShareName, sizeof(previous));
+    SDL_strlcpy(engine->hashShareName, name ? name : "", sizeof(engine->hashShareName));
+    if (engineSetHash(engine, engine->hashMB > 0 ? engine->hashMB : TT_SIZE_MB)) return true;
+    SDL_Log("Can't share the hash table as %s: %s", name ? name : "", SDL_GetError());
+    SDL_strlcpy(engine->hashShareName, previous, sizeof(engine->hashShareName));
+    return false;
+}
+
+/* Searches with owner's hash table in place of one of its own, so engines searching side by side on the pool's
+   workers (`main annotate`) find what the others have stored; owner has to outlive it and not resize the table.
+   Its searches leave the table's generation alone (ttNewSearch), or every one of them would age the others'
+   entries; engineNewGame leaves the table be. For good: the engine's own table is freed. */
+bool engineBorrowHash(Engine* engine, Engine* owner) {
+    if (engine->borrowedHash || engine == owner) return SDL_SetError("the engine has no table of its own to give up");
+    ttFree(engine->tt);
+    SDL_free(engine->tt);
+    engine->tt = owner->tt;
+    engine->borrowedHash = true;
+    engine->hashMB = owner->hashMB;
+    return true;
+}
+
+/* Hash files, to keep what analysis has learnt across restarts: the table written out as it is, and read back in
+   place of the current one, at the size it was saved with. Not while the engine is searching to load; saving
+   during a search is fine. False, with SDL_GetError saying why, on failure; a failed load keeps the old table. */
+bool engineSaveHash(Engine* engine, const char* path) {
+    return ttSave(engine->tt, path);
+}
+
+bool engineLoadHash(Engine* engine, const char* path) {
+    if (!SDL_GetTLS(&searchThreadSlot)) threadPoolWait(&searchPool); // a pre-fault of the old table done first
+    if (!ttLoad(engine->tt, path)) return false;
+    engine->hashMB = (size_t)((engine->tt->mask + 1) * sizeof(TTEntry) >> 20);
+    return true;
+}
+
+/* A result found elsewhere, an analysis store's say, for the position with this key put in the hash table: the
+   exact score for the side to move at depth, with the best move, stored as the search stores a root result, so
+   it takes a slot only on the terms a search's own result would. Any thread, a search under way or not, as the
+   helpers store; not alongside engineSetHash or engineLoadHash. */
+void engineWarmHash(Engine* engine, Uint64 key, Move move, int score, int depth) {
+    ttStore(engine->tt, key, 0, move, score, SDL_clamp(depth, 0, MOVE_DEPTH), TT_EXACT);
+}
+
+/* Keeps the engine within megabytes in all (0 = no limit) by sizing its hash table to what the rest leaves, at
+   once and whenever engineSetHash is called again; a change of thread count needs this called again. A build
+   with a MEMORY_CEILING_MB never goes above that, no limit included. */
+bool engineSetMemoryLimit(Engine* engine, size_t megabytes) {
+    if (MEMORY_CEILING_MB > 0 && (megabytes == 0 || megabytes > MEMORY_CEILING_MB)) megabytes = MEMORY_CEILING_MB;
+    engine->memoryLimit = megabytes * 1024 * 1024;
+    return engineSetHash(engine, engine->hashMB > 0 ? engine->hashMB : TT_SIZE_MB);
+}
+
+/* Forgets what earlier searches learnt. The table is cleared from all the search threads at once (unless called
+   on one of them): pages belong to the NUMA node of the thread that first writes them, so with the threads pinned
+   a fresh table is spread across the nodes they run on. */
+void engineNewGame(Engine* engine) {
+    if (engine->tt->pages != TT_PAGES_SHARED && !engine->borrowedHash) { // other processes are still using a shared one: it ages out instead
+        if (SDL_GetTLS(&searchThreadSlot) || searchPool.threadCount == 0) ttClear(engine->tt);
+        else ttClearParallel(engine->tt, &searchPool);
+    }
+    for (int i = 0; i <= MAX_POOL_THREADS; i++)
+        if (engine->contexts[i]) clearSearchContext(engine->contexts[i], false);
+    engine->expectedKey = 0;
+    SDL_memset(engine->results, 0, sizeof(engine->results));
+}
+
+/* Copies the position, so the caller is free to change its own as soon as this returns; false if no thread started.
+   A position in engine->book is answered at once from the book, with no thread: a callback is then called before
+   this returns, on the caller's own thread. */
+// what runEngineSearch is to search, and for how long
+static void beginSearch(Engine* engine, const ChessState* position, const SearchLimits* limits) {
+    engine->position = *position;
+    SDL_SetAtomicInt(&engine->stop, 0);
+    SDL_SetAtomicInt(&engine->pondering, limits->ponderMove != MOVE_NONE);
+    engine->ponderMove = limits->ponderMove;
+    engine->startNS = SDL_GetTicksNS(); // set here rather than on the thread, a ponder hit may look at it any time
+    engine->softTimeNS = limits->softTimeNS;
+    engine->hardTimeNS = limits->hardTimeNS;
+    engine->depthLimit = limits->depth;
+    engine->nodeLimit = limits->nodes;
+    engine->infinite = limits->infinite;
+    engine->threadLimit = limits->batch ? engine->batchThreads : 0;
+    engine->poolJob = false; // searched on a thread of its own, which may hand work to the pool
+}
+
+// the book's answer for the position beginSearch copied in, MOVE_NONE when it has none or a search is wanted
+static Move bookAnswer(Engine* engine, const SearchLimits* limits) {
+    bool fromBook = limits->ponderMove == MOVE_NONE && !limits->infinite; // analysis and pondering want a search
+    return fromBook ? bookProbe(engine->book, &engine->position, &engine->bookRandom) : MOVE_NONE;
+}
+
+/* A finished search's answer for the position beginSearch copied in (Engine.reuseResults), NULL when there's none
+   or a search is wanted. Not for a position the game has been in before: it may be a repetition now. */
+static const EngineResult* reusedAnswer(Engine* engine, const SearchLimits* limits) {
+    ChessState* chess = &engine->position;
+    const EngineResult* result = &engine->results[chess->hashKey & (ENGINE_RESULTS - 1)];
+    if (!engine->reuseResults || limits->ponderMove != MOVE_NONE || limits->infinite || limits->depth || limits->nodes ||
+        result->key != chess->hashKey || isRepetition(chess))
+        return NULL;
+    MoveList legal; // and never an illegal move, whatever a key collision says
+    getAllMoves(chess, &legal);
+    for (int i = 0; i < legal.count; i++)
+        if (legal.moves[i] == result->move) return result;
+    return NULL;
+}
+
+bool engineStartSearch(Engine* engine, const ChessState* position, const SearchLimits* limits) {
+    beginSearch(engine, position, limits);
+    engine->ponderDone = false;
+    engine->hasMove = false;
+    engine->lineCount = 0;
+    SDL_memset(&engine->info, 0, sizeof(engine->info));
+    engine->searching = true;
+    Move bookMove = bookAnswer(engine, limits);
+    const EngineResult* known = bookMove == MOVE_NONE ? reusedAnswer(engine, limits) : NULL;
+    if (known) { // its line, as the search that found it last reported it
+        EngineEvent info = { .type = ENGINE_EVENT_INFO, .depth = known->depth, .lineCount = 1,
+                             .line = { .moves = { known->move }, .length = 1, .score = known->score } };
+        engineEmit(engine, &info, 1);
+        bookMove = known->move;
+    }
+    if (bookMove != MOVE_NONE) { // answered at once, no thread needed
+        EngineEvent done = { .type = ENGINE_EVENT_BEST_MOVE, .move = bookMove };
+        engineEmit(engine, &done, 0);
+        return true;
+    }
+    engine->thread = createSearchThread(engine_thread_func, "engine", engine);
+    if (!engine->thread) {
+        SDL_Log("Failed to create engine thread: %s", SDL_GetError());
+        SDL_SetAtomicInt(&engine->pondering, 0);
+        engine->searching = false;
+        return false;
+    }
+    return true;
+}
+
+/* Ends the search and waits for the engine thread. A move still queued is thrown away; with a callback, the
+   search's best move has been passed to it by the time this returns. */
+void engineStopSearch(Engine* engine) {
+    SDL_SetAtomicInt(&engine->stop, 1);
+    if (engine->thread) {
+        SDL_WaitThread(engine->thread, NULL);
+        engine->thread = NULL;
+    }
+    EngineEvent event;
+    while (channelPop(&engine->channel, &event)) {} // with its producer gone the rest is stale
+    SDL_SetAtomicInt(&engine->pondering, 0);
+    engine->ponderDone = false;
+    engine->hasMove = false;
+    engine->searching = false;
+}
+
+// answer now with the best move so far, without waiting for it
+void engineMoveNow(Engine* engine) {
+    SDL_SetAtomicInt(&engine->stop, 1);
+}
+
+/* The opponent has just played move. If that is the one being pondered on, the ponder search simply becomes the
+   real one: its clock started when it did, so if it has already used the move's budget it answers at once. False
+   when it isn't, and the caller has to start a search of its own. */
+bool enginePonderHit(Engine* engine, Move move) {
+    if (!SDL_GetAtomicInt(&engine->pondering) || move != engine->ponderMove) return false;
+    SDL_SetAtomicInt(&engine->pondering, 0); // a move still on its way now arrives as the real one
+    if (engine->ponderDone) engine->hasMove = true;
+    else if (SDL_GetTicksNS() - engine->startNS >= engine->softTimeNS) SDL_SetAtomicInt(&engine->stop, 1);
+    return true;
+}
+
+// UI thread: takes in whatever the engine thread has sent since the last look, and never waits on it
+void enginePollEvents(Engine* engine) {
+    EngineEvent event;
+    while (channelPop(&engine->channel, &event)) {
+        if (event.type == ENGINE_EVENT_INFO) {
+            if (event.lineIndex == 0) engine->info = event;
+            engine->lines[event.lineIndex] = event.line;
+            engine->lineCount = event.lineCount;
+        } else {
+            engine->searching = false;
+            engine->resultMove = event.move;
+            if (engine->thread) { // it has nothing left to do but return
+                SDL_WaitThread(engine->thread, NULL);
+                engine->thread = NULL;
+            }
+            // only this thread clears pondering, so this can't cross a ponder hit
+            if (SDL_GetAtomicInt(&engine->pondering)) engine->ponderDone = true;
+            else engine->hasMove = true;
+        }
+    }
+}
+
+// the best line from the position starting with first, as far as the hash table still has it; returns its length
+int engineLine(Engine* engine, const ChessState* position, Move first, Move pv[MAX_PV_LENGTH]) {
+    return first == MOVE_NONE ? 0 : extractPv(position, engine->tt, first, pv, MAX_PV_LENGTH);
+}
+
+// the reply the last search expected: the hash move of the position, if it is legal here
+Move engineExpectedReply(Engine* engine, ChessState* chess) {
+    Move move = MOVE_NONE;
+    int score, depth;
+    TTBound bound;
+    if (!ttProbe(engine->tt, chess->hashKey, 0, &move, &score, &depth, &bound)) return MOVE_NONE;
+    MoveList legal;
+    getAllMoves(chess, &legal);
+    for (int i = 0; i < legal.count; i++)
+        if (legal.moves[i] == move) return move;
+    return MOVE_NONE;
+}
+
+/* The search of engineStartSearch run on the calling thread, without helpers: root holds the last completed
+   iteration when it returns. With an onEvent callback each iteration's lines go to it, on this thread, as
+   ENGINE_EVENT_INFO; otherwise there are no events. On a pool thread (engineRunOnThreads) it leaves the pool
+   alone. limits->ponderMove and limits->infinite don't apply. */
+Move engineSearch(Engine* engine, ChessState* position, const SearchLimits* limits, RootMoves* root) {
+    TRACE_BEGIN(search);
+    engine->poolJob = SDL_GetTLS(&searchThreadSlot) != NULL;
+    resetNodeCounts(engine);
+    engine->searchId++;
+    SEARCH_TREE_NEW_SEARCH(engine);
+    if (!engine->borrowedHash) ttNewSearch(engine->tt);
+    SDL_SetAtomicInt(&engine->stop, 0);
+    SDL_SetAtomicInt(&engine->pondering, 0);
+    engine->startNS = SDL_GetTicksNS();
+    engine->softTimeNS = limits->softTimeNS;
+    engine->hardTimeNS = limits->hardTimeNS;
+    engine->nodeLimit = limits->nodes;
+    int maxDepth = limits->depth > 0 ? SDL_min(limits->depth, MOVE_DEPTH) : MOVE_DEPTH;
+    initRootMoves(position, root, engine->tt);
+    if (engine->options.tablebases) syzygyRankRootMoves(position, root);
+    if (!limits->nodes && rootFromTable(engine, position, root, limits->depth)) maxDepth = 0; // answered already
+    for (int d = 1; d <= maxDepth && root->count > 0; d++) {
+        if (findBestMove(position, d, engine, root) == MOVE_NONE) break; // out of nodes or time: keep the last iteration
+        statIteration(engine, d);
+        if (engine->onEvent) publishLines(engine, position, root, d);
+        if (engine->softTimeNS && (SDL_GetTicksNS() - engine->startNS >= engine->softTimeNS || root->count == 1)) break; // on a clock, a forced reply is played at once
+        int mateDistance = MATE_SCORE - abs(root->lastScore);
+        if (abs(root->lastScore) >= MATE_BOUND && mateDistance <= d) break;
+    }
+    TRACE_END(search, TRACE_SEARCH, 0);
+    return root->count > 0 ? root->moves[0] : MOVE_NONE;
+}
+
+bool arenaCreate(Arena* arena, size_t size) {
+    size = (size + 63) & ~(size_t)63;
+    arena->base = SDL_aligned_alloc(64, size);
+    arena->size = arena->base ? size : 0;
+    arena->used = 0;
+    return arena->base != NULL;
+}
+
+void arenaDestroy(Arena* arena) {
+    SDL_aligned_free(arena->base);
+    *arena = (Arena){ 0 };
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = (size + 63) & ~(size_t)63;
+    if (size > arena->size - arena->used) return NULL;
+    void* memory = arena->base + arena->used;
+    arena->used += size;
+    return SDL_memset(memory, 0, size);
+}
+
+/* Queued searches. engineSubmit copies the position and limits and returns a handle at once; the engine's request
+   thread searches the requests one after another, first in first out, each with all the engine's options, hash
+   table and the pool's help, exactly as engineStartSearch would. The caller either polls the handle or takes its
+   events by callback, called on the request thread: INFO as each iteration completes, then one BEST_MOVE. A
+   request can live in the caller's arena, which is then the caller's to rewind once the request is freed.
+   Requests come in two classes: interactive ones go ahead of every batch request (SearchLimits.batch) in the
+   queue, and one arriving while a batch request is being searched stops that search at its next node check; the
+   batch request goes back to the front of the batch requests, to be searched again (with what its first try left
+   in the hash table) once the interactive ones are answered. So a batch job only ever has the time nothing else
+   wants, and Engine.batchThreads keeps some of the pool out of its reach besides. An
+   engine taking requests isn't to be used with engineStartSearch or engineSetHash until they're all answered. */
+struct EngineRequest {
+    Engine* engine;
+    ChessState position;
+    SearchLimits limits;           // infinite and ponder searches run until cancelled
+    EngineEventCallback onEvent;   // NULL = poll
+    void* userData;
+    EngineEvent info;              // the latest INFO for the best line
+    Move move;                     // the answer, once done
+    bool cancelled;
+    bool done;
+    bool inArena;                  // engineRequestFree leaves the memory alone
+    bool preempted;                // a batch request's search stopped for an interactive one, to be run again
+    EngineRequest* next;
+};
+
+/* Into the queue, under the lock: an interactive request after the interactive ones already in it, a batch one at
+   the end, or with front (a preempted one) at the front of the batch requests. */
+static void queueRequest(Engine* engine, EngineRequest* request, bool front) {
+    EngineRequest* previous = NULL;
+    if (!request->limits.batch || front) {
+        for (EngineRequest* r = engine->requestHead; r && !r->limits.batch; r = r->next) previous = r;
+    } else {
+        previous = engine->requestTail;
+    }
+    request->next = previous ? previous->next : engine->requestHead;
+    if (previous) previous->next = request;
+    else engine->requestHead = request;
+    if (!request->next) engine->requestTail = request;
+}
+
+// runEngineSearch's events while it works on a request
+static void requestEvent(const EngineEvent* event, void* userData) {
+    EngineRequest* request = userData;
+    if (event->type == ENGINE_EVENT_INFO && event->lineIndex == 0) {
+        SDL_LockMutex(request->engine->requestLock);
+        request->info = *event;
+        SDL_UnlockMutex(request->engine->requestLock);
+    }
+    if (request->onEvent) request->onEvent(event, request->userData);
+}
+
+/* Interleaved searches (Engine.interleave). A server's small requests, a few plies each, spend most of their time
+   waiting on the transposition table, the pawn table and the evaluation cache. The request thread can take
+   several at once and run them as state machines side by side: an alpha-beta with quiescence whose stack is an
+   array, not the C stack, so a search can stop at any node. Each one runs until it comes to a new node, starts
+   the loads that node will need with a prefetch, and yields; the thread goes on with the next search and comes
+   back once the lines are, with luck, in cache. It keeps to the pruning that pays most at a few plies (null move,
+   principal variation search, late move reductions, killers) and uses no other thread: the point is the
+   throughput of many shallow searches, not the depth of one. */
+#define INTERLEAVE_MAX_DEPTH 6 // only requests with a depth limit up to this are interleaved
+#define INTERLEAVE_QS_PLIES 16 // quiescence below the depth limit
+#define INTERLEAVE_PLIES (INTERLEAVE_MAX_DEPTH + INTERLEAVE_QS_PLIES + 1)
+
+enum { IFRAME_ENTER, IFRAME_PROBE, IFRAME_MOVES };
+enum { IMOVE_FULL, IMOVE_ZERO_WINDOW, IMOVE_REDUCED, IMOVE_NULL }; // how a node's current move is being searched
+
+// a node of an interleaved search
+typedef struct {
+    MoveList moves;
+    int order[256];
+    int next;            // the next move to try
+    int alpha, beta, originalAlpha, best, depth;
+    int standPat;        // quiescence only
+    Move ttMove, bestMove, current;
+    UndoInfo undo;       // to take current back
+    Uint8 phase;         // IFRAME_*
+    Uint8 stage;         // IMOVE_*
+    bool quiescence;
+    bool inCheck;
+} InterleavedFrame;
+
+typedef struct {
+    EngineRequest* request;
+    ChessState chess;
+    InterleavedFrame stack[INTERLEAVE_PLIES];
+    Move killers[INTERLEAVE_PLIES][2];
+    int ply;             // the frame being worked on, -1 between iterations
+    int depth;           // the iteration under way
+    Move best;           // of the last completed iteration (the first legal move before that)
+    Uint64 nodes, deadline;
+    bool done;
+} InterleavedSearch;
+
+// the thread has given up on it: out of nodes or time, cancelled, or the engine shutting down
+static bool interleavedStopped(InterleavedSearch* s, Engine* engine) {
+    const SearchLimits* limits = &s->request->limits;
+    if (limits->nodes && s->nodes >= limits->nodes) return true;
+    if (s->deadline && (s->nodes & (TIME_CHECK_NODES - 1)) == 0 && SDL_GetTicksNS() >= s->deadline) return true;
+    return __atomic_load_n(&s->request->cancelled, __ATOMIC_RELAXED) || __atomic_load_n(&engine->requestQuit, __ATOMIC_RELAXED);
+}
+
+static void interleavedPush(InterleavedSearch* s, int alpha, int beta, int depth, bool quiescence) {
+    InterleavedFrame* f = &s->stack[++s->ply];
+    f->phase = IFRAME_ENTER;
+    f->alpha = f->originalAlpha = alpha;
+    f->beta = beta;
+    f->depth = depth;
+    f->quiescence = quiescence;
+}
+
+// the node's current move searched (again) as its stage says
+static void interleavedSearchCurrent(InterleavedSearch* s, int depth) {
+    InterleavedFrame* f = &s->stack[s->ply];
+    bool zero = f->stage == IMOVE_ZERO_WINDOW || f->stage == IMOVE_REDUCED;
+    interleavedPush(s, zero ? -f->alpha - 1 : -f->beta, -f->alpha, depth, f->quiescence);
+}
+
+// the iteration just completed: its move, and an INFO for it
+static void interleavedIteration(InterleavedSearch* s, Engine* engine, int score) {
+    s->best = s->stack[0].bestMove;
+    EngineEvent info = { .type = ENGINE_EVENT_INFO, .depth = s->depth, .lineCount = 1, .nodes = s->nodes,
+                         .selDepth = s->depth };
+    info.line.score = score;
+    info.line.length = extractPv(&s->request->position, engine->tt, s->best, info.line.moves, MAX_PV_LENGTH);
+    requestEvent(&info, s->request);
+}
+
+/* The frame at s->ply is resolved with score: it goes, and its parent takes the score in, which may resolve that
+   one in turn, or search its move again: a reduced or null-window search that beat alpha. At the root the
+   iteration is over. */
+static void interleavedReturn(InterleavedSearch* s, Engine* engine, int score) {
+    for (;;) {
+        InterleavedFrame* f = &s->stack[s->ply];
+        if (!f->quiescence && f->phase == IFRAME_MOVES) {
+            TTBound bound = score <= f->originalAlpha ? TT_UPPER : score >= f->beta ? TT_LOWER : TT_EXACT;
+            ttStore(engine->tt, s->chess.hashKey, s->ply, f->bestMove, score, f->depth, bound);
+        }
+        if (s->ply-- == 0) {
+            interleavedIteration(s, engine, score);
+            return;
+        }
+        InterleavedFrame* parent = &s->stack[s->ply];
+        score = -score;
+        if (parent->stage == IMOVE_NULL) {
+            unmakeNullMove(&s->chess, &parent->undo);
+            if (score < parent->beta) return; // on to the moves
+            score = score >= MATE_BOUND ? parent->beta : score; // no unproven mates
+            parent->phase = IFRAME_PROBE; // resolved before any move: nothing to store
+            continue;
+        }
+        if (parent->stage == IMOVE_REDUCED && score > parent->alpha) {
+            parent->stage = IMOVE_ZERO_WINDOW;
+            interleavedSearchCurrent(s, parent->depth - 1);
+            return;
+        }
+        if (parent->stage == IMOVE_ZERO_WINDOW && score > parent->alpha && score < parent->beta) {
+            parent->stage = IMOVE_FULL;
+            interleavedSearchCurrent(s, parent->depth - 1);
+            return;
+        }
+        unmakeMove(&s->chess, parent->current, &parent->undo);
+        if (score > parent->best) { parent->best = score; parent->bestMove = parent->current; }
+        if (score > parent->alpha) parent->alpha = score;
+        if (parent->alpha < parent->beta) return; // on to its next move
+        Move* killers = s->killers[s->ply];
+        if (!parent->quiescence && isQuietMove(parent->current) && killers[0] != parent->current) {
+            killers[1] = killers[0];
+            killers[0] = parent->current;
+        }
+        score = parent->best;
+    }
+}
+
+/* A new node, the cache lines in by now: drawn, a hash cutoff or a stand-pat resolve it at once, otherwise its
+   moves are generated and ordered. False when it was resolved, or it has pushed a null-move search to try first. */
+static bool interleavedNode(InterleavedSearch* s, Engine* engine, SearchContext* ctx) {
+    InterleavedFrame* f = &s->stack[s->ply];
+    ChessState* chess = &s->chess;
+    if (s->ply > 0 && (chess->halfmoveClock >= 100 || isRepetition(chess))) { interleavedReturn(s, engine, DRAW_SCORE); return false; }
+    f->ttMove = MOVE_NONE;
+    if (!f->quiescence) {
+        int ttScore, ttDepth;
+        TTBound bound;
+        if (ttProbe(engine->tt, chess->hashKey, s->ply, &f->ttMove, &ttScore, &ttDepth, &bound) && s->ply > 0 && ttDepth >= f->depth &&
+            (bound == TT_EXACT || (bound == TT_LOWER && ttScore >= f->beta) || (bound == TT_UPPER && ttScore <= f->alpha))) {
+            interleavedReturn(s, engine, ttScore);
+            return false;
+        }
+        f->quiescence = f->depth <= 0;
+    }
+    f->inCheck = isKingInCheck(chess, chess->whiteToMove);
+    if (f->quiescence) {
+        int standPat = staticEvaluation(chess, f->alpha, f->beta, ctx);
+        if (standPat >= f->beta || s->ply >= INTERLEAVE_PLIES - 1) { interleavedReturn(s, engine, standPat); return false; }
+        if (standPat > f->alpha) f->alpha = standPat;
+        f->best = f->standPat = standPat;
+        generateCaptures(chess, &f->moves);
+        for (int i = 0; i < f->moves.count; i++) f->order[i] = mvvLvaScore(chess, f->moves.moves[i]);
+    } else {
+        getAllMoves(chess, &f->moves);
+        if (f->moves.count == 0) {
+            interleavedReturn(s, engine, f->inCheck ? -MATE_SCORE + s->ply : DRAW_SCORE);
+            return false;
+        }
+        f->best = -INF;
+        f->bestMove = f->moves.moves[0];
+        const Move* killers = s->killers[s->ply];
+        for (int i = 0; i < f->moves.count; i++) {
+            Move m = f->moves.moves[i];
+            f->order[i] = m == f->ttMove ? 1 << 30 : !isQuietMove(m) ? (1 << 20) + mvvLvaScore(chess, m)
+                        : m == killers[0] ? 2 : m == killers[1] ? 1 : 0;
+        }
+    }
+    f->next = 0;
+    f->phase = IFRAME_MOVES;
+    bool nullMove = !f->quiescence && s->ply > 0 && f->depth >= 3 && !f->inCheck && f->beta < MATE_BOUND &&
+                    s->stack[s->ply - 1].stage != IMOVE_NULL && hasNonPawnMaterial(chess, chess->whiteToMove ? 0 : 1);
+    if (nullMove) { // the moves wait until it has failed
+        f->stage = IMOVE_NULL;
+        makeNullMove(chess, &f->undo);
+        interleavedPush(s, -f->beta, -f->beta + 1, f->depth - 3, false);
+        return false;
+    }
+    return true;
+}
+
+// the node's next move made and its child pushed; false when it has none left
+static bool interleavedNextMove(InterleavedSearch* s) {
+    InterleavedFrame* f = &s->stack[s->ply];
+    ChessState* chess = &s->chess;
+    bool white = chess->whiteToMove;
+    while (f->next < f->moves.count) {
+        int i = f->next++, pick = i; // selection sort, a cutoff usually comes after the first couple
+        for (int j = i + 1; j < f->moves.count; j++) if (f->order[j] > f->order[pick]) pick = j;
+        Move move = f->moves.moves[pick];
+        int order = f->order[pick];
+        f->moves.moves[pick] = f->moves.moves[i]; f->order[pick] = f->order[i];
+        f->current = move;
+        if (f->quiescence) {
+            if (f->standPat + captureValue(chess, move) * 100 + DELTA_MARGIN <= f->alpha || isLosingCapture(chess, move)) continue;
+            makeMove(chess, move, &f->undo);
+            if (isKingInCheck(chess, white)) { unmakeMove(chess, move, &f->undo); continue; }
+            f->stage = IMOVE_FULL;
+            interleavedSearchCurrent(s, 0);
+            return true;
+        }
+        // the first move with the full window, the others with a null one, late quiet ones a ply shallower first
+        bool late = i >= 3 && f->depth >= 3 && !f->inCheck && isQuietMove(move) && order == 0;
+        makeMove(chess, move, &f->undo);
+        late = late && !isKingInCheck(chess, chess->whiteToMove);
+        f->stage = i == 0 ? IMOVE_FULL : late ? IMOVE_REDUCED : IMOVE_ZERO_WINDOW;
+        interleavedSearchCurrent(s, f->depth - 1 - (late ? 1 : 0));
+        return true;
+    }
+    return false;
+}
+
+/* Runs the search up to its next new node and starts that node's loads; false once it has finished, its move
+   in s->best. */
+static bool interleavedStep(InterleavedSearch* s, Engine* engine, SearchContext* ctx) {
+    for (;;) {
+        if (s->ply < 0) { // between iterations
+            if (s->depth >= s->request->limits.depth || abs(s->stack[0].best) >= MATE_BOUND) return false;
+            s->depth++;
+            interleavedPush(s, -INF, INF, s->depth, false);
+        }
+        InterleavedFrame* f = &s->stack[s->ply];
+        if (f->phase == IFRAME_ENTER) {
+            if (interleavedStopped(s, engine)) return false; // the last completed iteration's move stands
+            s->nodes++;
+            ttPrefetch(engine->tt, s->chess.hashKey);
+            __builtin_prefetch(&ctx->pawns->entries[s->chess.pawnKey & (PAWN_HASH_ENTRIES - 1)]);
+            if (ctx->evals) __builtin_prefetch(&ctx->evals->slots[s->chess.hashKey & (EVAL_CACHE_ENTRIES - 1)]);
+            f->phase = IFRAME_PROBE;
+            return true;
+        }
+        if (f->phase == IFRAME_PROBE) {
+            if (!interleavedNode(s, engine, ctx)) continue;
+        }
+        if (!interleavedNextMove(s)) interleavedReturn(s, engine, s->stack[s->ply].best);
+    }
+}
+
+// the request can be interleaved: a plain search with a shallow depth limit
+static bool interleavable(const EngineRequest* request) {
+    const SearchLimits* limits = &request->limits;
+    return limits->depth >= 1 && limits->depth <= INTERLEAVE_MAX_DEPTH && !limits->infinite && limits->ponderMove == MOVE_NONE;
+}
+
+/* The requests' searches, interleaved on the calling thread, their moves in moves; false without the memory,
+   nothing searched. */
+static bool runInterleaved(Engine* engine, EngineRequest** requests, int count, Move* moves) {
+    SearchContext* ctx = threadSearchContext(engine);
+    Arena* arena = &engine->interleaveArena;
+    if (ctx && !arena->base) arenaCreate(arena, INTERLEAVE_MAX * ((sizeof(InterleavedSearch) + 63) & ~(size_t)63));
+    arenaReset(arena);
+    InterleavedSearch* searches = ctx ? arenaAlloc(arena, (size_t)count * sizeof(InterleavedSearch)) : NULL;
+    if (!searches) return false;
+    if (!engine->borrowedHash) ttNewSearch(engine->tt);
+    int active = 0;
+    Uint64 start = SDL_GetTicksNS();
+    for (int i = 0; i < count; i++) {
+        InterleavedSearch* s = &searches[i];
+        ChessState position = requests[i]->position;
+        moves[i] = bookProbe(engine->book, &position, &engine->bookRandom);
+        s->request = requests[i];
+        s->chess = requests[i]->position;
+        s->ply = -1;
+        s->depth = 0;
+        s->nodes = 0;
+        s->deadline = requests[i]->limits.hardTimeNS ? start + requests[i]->limits.hardTimeNS : 0;
+        s->stack[0].best = 0;
+        MoveList legal;
+        getAllMoves(&s->chess, &legal);
+        s->best = legal.count ? legal.moves[0] : MOVE_NONE;
+        s->done = moves[i] != MOVE_NONE || legal.count == 0 || __atomic_load_n(&s->request->cancelled, __ATOMIC_RELAXED);
+        if (!s->done) active++;
+    }
+    while (active > 0) {
+        for (int i = 0; i < count; i++) {
+            InterleavedSearch* s = &searches[i];
+            if (s->done || interleavedStep(s, engine, ctx)) continue;
+            s->done = true;
+            active--;
+        }
+    }
+    NodeCounter* counter = &engine->nodeCounters[(intptr_t)SDL_GetTLS(&searchThreadSlot)];
+    for (int i = 0; i < count; i++) {
+        if (moves[i] == MOVE_NONE) moves[i] = searches[i].best;
+        __atomic_store_n(&counter->lifetimeNodes, counter->lifetimeNodes + searches[i].nodes, __ATOMIC_RELAXED);
+    }
+    return true;
+}
+
+// the answer to a request, under the lock
+static void answerRequest(Engine* engine, EngineRequest* request, Move move) {
+    EngineEvent done = { .type = ENGINE_EVENT_BEST_MOVE, .move = move };
+    if (request->onEvent) { // unlocked: the callback may well submit the next request
+        SDL_UnlockMutex(engine->requestLock);
+        request->onEvent(&done, request->userData);
+        SDL_LockMutex(engine->requestLock);
+    }
+    request->move = move;
+    request->done = true; // the caller may free it from here on
+    SDL_BroadcastCondition(engine->requestSignal);
+}
+
+/* With interleave on and request small enough to interleave, the queue's other such requests join it, up to
+   engine->interleave of them, and they're searched and answered together; false for a request to search alone.
+   Under the lock, which the searches are run without. */
+static bool answerInterleaved(Engine* engine, EngineRequest* request) {
+    if (engine->interleave < 2 || !interleavable(request) || request->cancelled || engine->requestQuit) return false;
+    EngineRequest* batch[INTERLEAVE_MAX];
+    Move moves[INTERLEAVE_MAX];
+    int count = 0, limit = SDL_min(engine->interleave, INTERLEAVE_MAX);
+    batch[count++] = request;
+    for (EngineRequest *r = engine->requestHead, *previous = NULL, *next; r && count < limit; r = next) {
+        next = r->next;
+        if (!interleavable(r) || r->cancelled || r->limits.batch != request->limits.batch) { previous = r; continue; }
+        if (previous) previous->next = next;
+        else engine->requestHead = next;
+        if (engine->requestTail == r) engine->requestTail = previous;
+        batch[count++] = r;
+    }
+    SDL_UnlockMutex(engine->requestLock);
+    bool searched = runInterleaved(engine, batch, count, moves);
+    SDL_LockMutex(engine->requestLock);
+    if (!searched) { // no memory: the others go back to the head of the queue, to be searched one at a time
+        for (int i = count - 1; i >= 1; i--) {
+            batch[i]->next = engine->requestHead;
+            engine->requestHead = batch[i];
+            if (!engine->requestTail) engine->requestTail = batch[i];
+        }
+        return false;
+    }
+    for (int i = 0; i < count; i++) answerRequest(engine, batch[i], moves[i]);
+    return true;
+}
+
+static int SDLCALL request_thread_func(void* arg) {
+    Engine* engine = arg;
+    applySearchPriority();
+    SDL_LockMutex(engine->requestLock);
+    for (;;) {
+        while (!engine->requestHead && !engine->requestQuit) SDL_WaitCondition(engine->requestSignal, engine->requestLock);
+        EngineRequest* request = engine->requestHead;
+        if (!request) break; // told to quit, and nothing left to answer
+        engine->requestHead = request->next;
+        if (!engine->requestHead) engine->requestTail = NULL;
+        if (answerInterleaved(engine, request)) continue;
+        Move move = MOVE_NONE; // a request cancelled before it started
+        if (!request->cancelled && !engine->requestQuit) {
+            // set up under the lock, so a cancel can't land before the stop flag is cleared and get lost
+            beginSearch(engine, &request->position, &request->limits);
+            EngineEventCallback onEvent = engine->onEvent;
+            void* userData = engine->userData;
+            engine->onEvent = requestEvent;
+            engine->userData = request;
+            engine->requestCurrent = request;
+            SDL_UnlockMutex(engine->requestLock);
+            move = bookAnswer(engine, &request->limits);
+            if (move == MOVE_NONE) move = runEngineSearch(engine);
+            SDL_LockMutex(engine->requestLock);
+            engine->onEvent = onEvent;
+            engine->userData = userData;
+            engine->requestCurrent = NULL;
+            if (request->preempted && !request->cancelled && !engine->requestQuit) {
+                request->preempted = false;
+                queueRequest(engine, request, true);
+                continue;
+            }
+        }
+        answerRequest(engine, request, move);
+    }
+    SDL_UnlockMutex(engine->requestLock);
+    return 0;
+}
+
+/* queues a search and returns without waiting for it, the request taken from arena (NULL for the heap); NULL
+   without the memory or a thread to search it on */
+EngineRequest* engineSubmit(Engine* engine, const ChessState* position, const SearchLimits* limits,
+                            EngineEventCallback onEvent, void* userData, Arena* arena) {
+    EngineRequest* request = arena ? arenaAlloc(arena, sizeof(EngineRequest)) : SDL_calloc(1, sizeof(EngineRequest));
+    if (!request) return NULL;
+    request->inArena = arena != NULL;
+    request->engine = engine;
+    request->position = *position;
+    request->limits = *limits;
+    request->onEvent = onEvent;
+    request->userData = userData;
+    SDL_LockMutex(engine->requestLock);
+    if (!engine->requestThread) engine->requestThread = createSearchThread(request_thread_func, "engine requests", engine);
+    if (!engine->requestThread) {
+        SDL_UnlockMutex(engine->requestLock);
+        SDL_Log("Failed to create engine request thread: %s", SDL_GetError());
+        if (!request->inArena) SDL_free(request);
+        return NULL;
+    }
+    queueRequest(engine, request, false);
+    EngineRequest* current = engine->requestCurrent;
+    if (!limits->batch && current && current->limits.batch && !current->preempted) {
+        current->preempted = true;
+        engine->preemptions++;
+        SDL_SetAtomicInt(&engine->stop, 1);
+    }
+    SDL_BroadcastCondition(engine->requestSignal);
+    SDL_UnlockMutex(engine->requestLock);
+    return request;
+}
+
+/* Never waits for the search: true once the request is answered (engineRequestWait then has the move at once).
+   progress, if not NULL, gets the latest INFO for the best line, depth 0 until the first iteration completes. */
+bool engineRequestPoll(EngineRequest* request, EngineEvent* progress) {
+    SDL_LockMutex(request->engine->requestLock);
+    bool done = request->done;
+    if (progress) *progress = request->info;
+    SDL_UnlockMutex(request->engine->requestLock);
+    return done;
+}
+
+// blocks until the request is answered, then its move
+Move engineRequestWait(EngineRequest* request) {
+    Engine* engine = request->engine;
+    SDL_LockMutex(engine->requestLock);
+    while (!request->done) SDL_WaitCondition(engine->requestSignal, engine->requestLock);
+    Move move = request->move;
+    SDL_UnlockMutex(engine->requestLock);
+    return move;
+}
+
+/* Answers the request soon: with the best move so far if it is being searched, MOVE_NONE if it is still queued.
+   Doesn't wait for it. */
+void engineRequestCancel(EngineRequest* request) {
+    Engine* engine = request->engine;
+    SDL_LockMutex(engine->requestLock);
+    request->cancelled = true;
+    if (engine->requestCurrent == request) SDL_SetAtomicInt(&engine->stop, 1);
+    SDL_UnlockMutex(engine->requestLock);
+}
+
+// cancels the request if it hasn't been answered and waits for the answer, which is thrown away
+void engineRequestFree(EngineRequest* request) {
+    if (!request) return;
+    engineRequestCancel(request);
+    engineRequestWait(request);
+    if (!request->inArena) SDL_free(request);
+}
+
+// the calling thread's evaluation cache: emptied, so a search's result doesn't depend on what ran before it
+void engineClearEvalCache(void) {
+    SDL_memset(evalCaches[(intptr_t)SDL_GetTLS(&searchThreadSlot)].slots, 0, sizeof(evalCaches[0].slots));
+}
+
+/* The statistics of the engine's last search, all threads together; false (and stats zeroed) in an engine built
+   without SEARCH_STATS. Not while it is searching. */
+bool engineSearchStats(Engine* engine, SearchStats* stats) {
+    SDL_memset(stats, 0, sizeof(*stats));
+#if defined(SEARCH_STATS)
+    for (int i = 0; i <= MAX_POOL_THREADS; i++) engineAddSearchStats(stats, &engine->stats[i]);
+    stats->nodes = engineNodeCount(engine);
+    return true;
+#else
+    (void)engine;
+    return false;
+#endif
+}
+
+/* Writes what every thread traced so far (see TRACE_RING_SIZE) to path as a Chrome trace, and false if the engine
+   wasn't built with SEARCH_TRACE or the file couldn't be written. To be called while nothing is searching. */
+bool engineTraceWrite(const char* path) {
+#if defined(SEARCH_TRACE)
+    static const char* const PHASE_NAMES[] = { "search", "iteration", "first move", "root move", "split point", "pool wait" };
+    SDL_IOStream* out = SDL_IOFromFile(path, "w");
+    if (!out) return false;
+    double usPerTick = 1e6 / (double)SDL_GetPerformanceFrequency();
+    bool ok = SDL_IOprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n") > 0;
+    int rings = SDL_min(SDL_GetAtomicInt(&traceRingCount), TRACE_MAX_THREADS);
+    const char* separator = "";
+    for (int t = 0; t < rings && ok; t++) {
+        const TraceRing* ring = SDL_GetAtomicPointer((void**)&traceRings[t]);
+        if (!ring) continue;
+        char name[32];
+        if (ring->slot > 0) SDL_snprintf(name, sizeof(name), "search worker %d", (int)ring->slot);
+        else SDL_snprintf(name, sizeof(name), "thread %" SDL_PRIu64, (Uint64)ring->thread);
+        ok = SDL_IOprintf(out, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                          separator, t, name) > 0;
+        separator = ",\n";
+        Uint64 first = ring->written > TRACE_RING_SIZE ? ring->written - TRACE_RING_SIZE : 0;
+        for (Uint64 i = first; i < ring->written && ok; i++) {
+            const TraceEvent* event = &ring->events[i & (TRACE_RING_SIZE - 1)];
+            char arg[16] = "";
+            if (event->kind == TRACE_ROOT_MOVE || event->kind == TRACE_FIRST_MOVE) {
+                char move[6];
+                moveToCoordinates((Move)event->arg, move);
+                SDL_snprintf(arg, sizeof(arg), "\"move\":\"%s\",", move);
+            } else if (event->kind == TRACE_ITERATION) {
+                SDL_snprintf(arg, sizeof(arg), "\"depth\":%u,", (unsigned)event->arg);
+            }
+            ok = SDL_IOprintf(out, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f,"
+                              "\"args\":{%s\"movegen_us\":%.1f,\"eval_us\":%.1f,\"make_us\":%.1f,\"unmake_us\":%.1f}}",
+                              t, PHASE_NAMES[event->kind], (double)(Sint64)(event->start - traceOrigin) * usPerTick,
+                              (double)(event->end - event->start) * usPerTick, arg, event->hot[TRACE_MOVEGEN] * usPerTick,
+                              event->hot[TRACE_EVAL] * usPerTick, event->hot[TRACE_MAKE] * usPerTick,
+                              event->hot[TRACE_UNMAKE] * usPerTick) > 0;
+        }
+    }
+    if (ok) ok = SDL_IOprintf(out, "\n]}\n") > 0;
+    return SDL_CloseIO(out) && ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+/* The search tree samples (SearchTreeRecord): sample sets the fraction of nodes kept from here on and forgets the
+   ones kept so far, write writes them all to path. Both false when the engine wasn't built with SEARCH_TREE, and
+   write when the file couldn't be written. To be called while nothing is searching. */
+bool engineSearchTreeSample(double fraction) {
+#if defined(SEARCH_TREE)
+    fraction = SDL_clamp(fraction, 0.0, 1.0);
+    searchTree.sample = fraction;
+    searchTree.threshold = (Uint64)(fraction * 4294967296.0);
+    SDL_SetAtomicInt(&searchTree.searches, 0);
+    int buffers = SDL_min(SDL_GetAtomicInt(&searchTree.bufferCount), SEARCH_TREE_MAX_THREADS);
+    for (int t = 0; t < buffers; t++) {
+        SearchTreeBuffer* buffer = SDL_GetAtomicPointer((void**)&searchTree.buffers[t]);
+        if (buffer) buffer->count = 0, buffer->dropped = 0;
+    }
+    return true;
+#else
+    (void)fraction;
+    return false;
+#endif
+}
+
+bool engineSearchTreeWrite(const char* path) {
+#if defined(SEARCH_TREE)
+    SDL_IOStream* out = SDL_IOFromFile(path, "wb");
+    if (!out) return false;
+    SearchTreeHeader header = { .magic = "CHESSTRE", .version = SEARCH_TREE_VERSION,
+                                .recordSize = sizeof(SearchTreeRecord), .sample = searchTree.sample };
+    int buffers = SDL_min(SDL_GetAtomicInt(&searchTree.bufferCount), SEARCH_TREE_MAX_THREADS);
+    for (int t = 0; t < buffers; t++) {
+        const SearchTreeBuffer* buffer = SDL_GetAtomicPointer((void**)&searchTree.buffers[t]);
+        if (buffer) header.dropped += buffer->dropped;
+    }
+    bool ok = SDL_WriteIO(out, &header, sizeof(header)) == sizeof(header);
+    for (int t = 0; t < buffers && ok; t++) {
+        const SearchTreeBuffer* buffer = SDL_GetAtomicPointer((void**)&searchTree.buffers[t]);
+        size_t bytes = buffer ? buffer->count * sizeof(SearchTreeRecord) : 0;
+        if (bytes) ok = SDL_WriteIO(out, buffer->records, bytes) == bytes;
+    }
+    return SDL_CloseIO(out) && ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+// the log's thread: everything the rings hold, to the file
+static void searchLogDrain(void) {
+    int rings = SDL_min(SDL_GetAtomicInt(&searchLog.ringCount), SEARCH_LOG_MAX_THREADS);
+    for (int i = 0; i < rings; i++) {
+        SearchLogRing* ring = SDL_GetAtomicPointer((void**)&searchLog.rings[i]);
+        if (!ring) continue; // still being made
+        Uint64 tail = ring->tail, head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        while (tail < head) { // up to the end of the ring at a time
+            size_t at = (size_t)(tail & (SEARCH_LOG_RING - 1)), count = (size_t)SDL_min(head - tail, SEARCH_LOG_RING - at);
+            size_t bytes = count * sizeof(SearchLogRecord);
+            if (!searchLog.failed && SDL_WriteIO(searchLog.file, &ring->records[at], bytes) != bytes) {
+                SDL_Log("search log: can't write, the rest is lost: %s", SDL_GetError());
+                searchLog.failed = true;
+            }
+            tail += count;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    if (!searchLog.failed) SDL_FlushIO(searchLog.file);
+}
+
+static int SDLCALL searchLogThread(void* data) {
+    (void)data;
+    bool closing = false;
+    while (!closing) {
+        SDL_LockMutex(searchLog.lock);
+        if (!searchLog.closing) SDL_WaitConditionTimeout(searchLog.wake, searchLog.lock, SEARCH_LOG_FLUSH_MS);
+        closing = searchLog.closing;
+        SDL_UnlockMutex(searchLog.lock);
+        searchLogDrain(); // the last one after the records stopped
+    }
+    return 0;
+}
+
+/* Starts the search log (SearchLogRecord) in path, a new file, for every engine's searches till
+   engineSearchLogClose. Not to be called while another thread opens or closes it. */
+bool engineSearchLogOpen(const char* path) {
+    if (searchLog.file) return SDL_SetError("a search log is open already");
+    SDL_IOStream* file = SDL_IOFromFile(path, "wb");
+    if (!file) return false;
+    SearchLogHeader header = { .magic = "CHESSLOG", .version = SEARCH_LOG_VERSION, .recordSize = sizeof(SearchLogRecord) };
+    if (SDL_WriteIO(file, &header, sizeof(header)) != sizeof(header)) { SDL_CloseIO(file); return false; }
+    int rings = SDL_min(SDL_GetAtomicInt(&searchLog.ringCount), SEARCH_LOG_MAX_THREADS);
+    for (int i = 0; i < rings; i++) { // what an earlier log left behind
+        SearchLogRing* ring = SDL_GetAtomicPointer((void**)&searchLog.rings[i]);
+        if (ring) __atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+    searchLog.file = file;
+    searchLog.failed = searchLog.closing = false;
+    searchLog.lock = SDL_CreateMutex();
+    searchLog.wake = SDL_CreateCondition();
+    searchLog.thread = searchLog.lock && searchLog.wake ? SDL_CreateThread(searchLogThread, "search log", NULL) : NULL;
+    if (!searchLog.thread) {
+        SDL_DestroyCondition(searchLog.wake);
+        SDL_DestroyMutex(searchLog.lock);
+        SDL_CloseIO(file);
+        searchLog.file = NULL;
+        return false;
+    }
+    SDL_SetAtomicInt(&searchLog.searches, 0);
+    SDL_SetAtomicInt(&searchLog.on, 1);
+    return true;
+}
+
+void engineSearchLogClose(void) {
+    if (!searchLog.file) return;
+    SDL_SetAtomicInt(&searchLog.on, 0);
+    SDL_LockMutex(searchLog.lock);
+    searchLog.closing = true;
+    SDL_SignalCondition(searchLog.wake);
+    SDL_UnlockMutex(searchLog.lock);
+    SDL_WaitThread(searchLog.thread, NULL);
+    SDL_DestroyCondition(searchLog.wake);
+    SDL_DestroyMutex(searchLog.lock);
+    if (!SDL_CloseIO(searchLog.file) && !searchLog.failed) SDL_Log("search log: can't close the file: %s", SDL_GetError());
+    searchLog.file = NULL;
+}
+
+// sums statistics, of threads or of searches: the iterations depth by depth, the deepest search's depth
+void engineAddSearchStats(SearchStats* total, const SearchStats* stats) {
+    total->nodes += stats->nodes;
+    total->qnodes += stats->qnodes;
+    total->betaCutoffs += stats->betaCutoffs;
+    total->firstMoveCutoffs += stats->firstMoveCutoffs;
+    total->ttProbes += stats->ttProbes;
+    total->ttHits += stats->ttHits;
+    total->ttCutoffs += stats->ttCutoffs;
+    total->nullTries += stats->nullTries;
+    total->nullCutoffs += stats->nullCutoffs;
+    total->lmrReductions += stats->lmrReductions;
+    total->lmrResearches += stats->lmrResearches;
+    total->checkExtensions += stats->checkExtensions;
+    total->singularTries += stats->singularTries;
+    total->singularExtensions += stats->singularExtensions;
+    total->reverseFutilityCutoffs += stats->reverseFutilityCutoffs;
+    total->razorTries += stats->razorTries;
+    total->razorCutoffs += stats->razorCutoffs;
+    total->futilityPrunes += stats->futilityPrunes;
+    total->probCutTries += stats->probCutTries;
+    total->probCutCutoffs += stats->probCutCutoffs;
+    total->multiCuts += stats->multiCuts;
+    total->iirReductions += stats->iirReductions;
+    total->counterMoveCutoffs += stats->counterMoveCutoffs;
+    total->cycleCutoffs += stats->cycleCutoffs;
+    total->depth = SDL_max(total->depth, stats->depth);
+    for (int d = 0; d <= MAX_PLY; d++) total->iterationNodes[d] += stats->iterationNodes[d];
+}
+
+// the calling thread's evaluation cache counters, since the thread started
+void engineEvalCacheStats(Uint64* probes, Uint64* hits) {
+    const EvalCache* cache = &evalCaches[(intptr_t)SDL_GetTLS(&searchThreadSlot)];
+    *probes = cache->probes;
+    *hits = cache->hits;
+}
+
+/* Every thread's evaluation profile summed, counted since the program started (see EvalProfile); false, and all
+   zeros, if the engine wasn't built with EVAL_PROFILE. To be called while nothing is searching. */
+bool engineEvalProfile(EvalProfile* profile) {
+    SDL_memset(profile, 0, sizeof(*profile));
+#if defined(EVAL_PROFILE)
+    for (int i = 0; i <= MAX_POOL_THREADS; i++) {
+        const EvalProfile* thread = &pawnTables[i].profile;
+        profile->calls += thread->calls;
+        profile->cacheHits += thread->cacheHits;
+        profile->endings += thread->endings;
+        profile->lazyExits += thread->lazyExits;
+        for (int t = 0; t < EVAL_PROFILE_TERMS; t++) {
+            profile->cycles[t] += thread->cycles[t];
+            profile->evaluated[t] += thread->evaluated[t];
+            profile->magnitude[t] += thread->magnitude[t];
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if defined(TABLES_GENERATED)
+#include "tables.h"
+#endif
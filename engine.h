@@ -0,0 +1,787 @@
+/* Chess engine core: board, move generation, evaluation and the threaded search, with no window, fonts or layout
+   code in it. It needs SDL's core library for threads, atomics and the clock, and nothing else from SDL.
+
+   The front ends talk to an Engine through a handful of calls: engineCreate and engineDestroy, engineStartSearch
+   with a position and SearchLimits, engineStopSearch, and either enginePollEvents from the caller's own loop or an
+   EngineEventCallback called on the engine thread. engineSearch is the same search run on the calling thread, and
+   engineSubmit queues searches for a caller that can't wait on any of them. */
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+#define INF 1000000 // cant use INFINITY from math.h include coz it doesnt convert to integer
+/* CHESS_LOW_MEMORY (the CMake option of that name) is the profile for small devices: half the search stack, one
+   pool thread besides the engine thread, 8-byte hash entries, ray lookups in place of the slider attack tables,
+   smaller per-thread caches, and the whole engine held under MEMORY_CEILING_MB (engineSetMemoryLimit). */
+#if defined(CHESS_LOW_MEMORY)
+#define MAX_PLY 64
+#else
+#define MAX_PLY 128
+#endif
+// scores are centipawns for the side to move; mate scores carry their distance so a faster mate scores higher
+#define MATE_SCORE 30000                  // -MATE_SCORE + ply: checkmated at that ply
+#define MATE_BOUND (MATE_SCORE - MAX_PLY) // anything at or beyond +/-MATE_BOUND is a forced mate
+#define DRAW_SCORE 0
+#define MOVE_DEPTH 64          // iterative deepening cap; the time budget below normally ends the search first
+#define MOVE_SOFT_TIME_MS 1500 // no new iteration is started after this
+#define MOVE_HARD_TIME_MS 5000 // the iteration in progress is abandoned at this point
+#define MOVE_SOFT_TIME_NS ((Uint64)MOVE_SOFT_TIME_MS * 1000000)
+#define MOVE_HARD_TIME_NS ((Uint64)MOVE_HARD_TIME_MS * 1000000)
+#if defined(CHESS_LOW_MEMORY)
+#define TT_SIZE_MB 1
+#define MAX_POOL_THREADS 1
+#define MEMORY_CEILING_MB 8 // the memory limit an engine starts with, and the most it can be raised to
+#else
+#define TT_SIZE_MB 64 // transposition table size, rounded down to a power-of-two entry count
+#define MAX_POOL_THREADS 64 // search threads besides the engine thread; more cores than this go unused
+#define MEMORY_CEILING_MB 0 // none
+#endif
+#define POOL_SPIN_US 100 // how long an idle search worker spins before it sleeps, by default (engineSetThreadSpin)
+#define FEN_MAX 128 // room for any FEN writeFen produces, with its NUL, whatever the move counters
+#define MOVE_TEXT_MAX 16 // move2chars's longest, "e5 x d6 e.p.", with its NUL
+#define MOVE_SAN_MAX 8   // moveToSan's, "exd8=Q+"
+
+/* A piece is its kind in the low three bits (the white PieceType, pawn 1 to king 6) and its colour in bit 3, set for
+   black: the colour is a shift, the kind a mask and the other side's piece an XOR. Codes 7, 8 and 15 are unused. */
+typedef enum {
+    EMPTY = 0,
+    WHITE_PAWN = 1, WHITE_KNIGHT, WHITE_BISHOP, WHITE_ROOK, WHITE_QUEEN, WHITE_KING,
+    BLACK_PAWN = 9, BLACK_KNIGHT, BLACK_BISHOP, BLACK_ROOK, BLACK_QUEEN, BLACK_KING
+} PieceType;
+#define PIECE_BLACK 8      // the colour bit
+#define PIECE_KIND_MASK 7
+#define PIECE_TYPE_COUNT 15 // the size of a table indexed by PieceType, EMPTY to BLACK_KING
+
+static inline int pieceColor(PieceType p) { return p >> 3; } // 0 white, 1 black; 0 for EMPTY too
+static inline PieceType pieceKind(PieceType p) { return (PieceType)(p & PIECE_KIND_MASK); } // the white piece of its kind
+static inline PieceType flipPiece(PieceType p) { return (PieceType)(p ^ PIECE_BLACK); }      // the other side's, not for EMPTY
+
+/* Packed 16-bit move: bits 0-5 from square, 6-11 to square (row * 8 + col), 12-15 flags.
+   Flag layout: bit 2 = capture, bit 3 = promotion (low two bits then pick N/B/R/Q),
+   otherwise 1 = double pawn push, 2/3 = king/queen side castle, 5 = en passant. */
+typedef Uint16 Move;
+
+enum {
+    MOVE_QUIET = 0, MOVE_DOUBLE_PUSH = 1, MOVE_CASTLE_KING = 2, MOVE_CASTLE_QUEEN = 3,
+    MOVE_CAPTURE = 4, MOVE_EP_CAPTURE = 5,
+    MOVE_PROMO_KNIGHT = 8, MOVE_PROMO_BISHOP = 9, MOVE_PROMO_ROOK = 10, MOVE_PROMO_QUEEN = 11
+    // 12-15: promotion captures (promotion flag | MOVE_CAPTURE)
+};
+#define MOVE_NONE ((Move)0) // a1-a1, never a real move
+
+static inline Move packMove(int from, int to, int flags) { return (Move)(from | (to << 6) | (flags << 12)); }
+static inline int moveFrom(Move m) { return m & 63; }
+static inline int moveTo(Move m) { return (m >> 6) & 63; }
+static inline int moveFlags(Move m) { return m >> 12; }
+static inline bool isCaptureMove(Move m) { return (moveFlags(m) & MOVE_CAPTURE) != 0; }
+static inline bool isPromotionMove(Move m) { return (moveFlags(m) & 8) != 0; }
+static inline bool isCastlingMove(Move m) { return moveFlags(m) == MOVE_CASTLE_KING || moveFlags(m) == MOVE_CASTLE_QUEEN; }
+static inline bool isEnPassantMove(Move m) { return moveFlags(m) == MOVE_EP_CAPTURE; }
+// promotion piece for the mover's colour (N, B, R, Q from the two low flag bits)
+static inline PieceType promotionPiece(Move m, bool white) {
+    return (PieceType)((WHITE_KNIGHT + (moveFlags(m) & 3)) | (white ? 0 : PIECE_BLACK));
+}
+typedef struct {
+    Move moves[256];
+    int count;
+} MoveList;
+
+// the side to move's situation (getGameStatus)
+typedef enum { GAME_ONGOING, GAME_CHECK, GAME_CHECKMATE, GAME_STALEMATE } GameStatus;
+
+// castling rights, a bit each while that castle is still allowed (ChessState.castlingRights)
+enum { CASTLE_WHITE_KING = 1, CASTLE_WHITE_QUEEN = 2, CASTLE_BLACK_KING = 4, CASTLE_BLACK_QUEEN = 8, CASTLE_ALL = 15 };
+
+typedef struct {
+    Uint8 castlingRights;
+    int enPassantCol;
+    PieceType capturedPiece;
+    int capturedRow;
+    int capturedCol;
+    Uint64 hashKey;
+    int halfmoveClock;
+    Uint64 pawnKey;
+    Sint32 psq;        // the running evaluation terms, restored as they were rather than undone
+    int phase;
+} UndoInfo;
+
+#define KEY_HISTORY_SIZE 256 // a ring (power of two): more than the hundred plies a repetition can reach back
+
+#define NNUE_HIDDEN 256 // accumulator width per perspective; a network file has to match it
+
+typedef Uint64 Bitboard; // one bit per square, bit index = row * 8 + col (a1 = 0, h8 = 63)
+
+/* The position, engine data only (the window's selection and textures are the AppState's). What move generation,
+   make/unmake and the evaluation touch at every node comes first, in four cache lines with the mailbox; the NNUE
+   accumulators and the repetition ring, used less or only in part, come after. */
+typedef struct {
+    Bitboard pieceBB[PIECE_TYPE_COUNT]; // one mask per PieceType (EMPTY and the unused codes left empty)
+    Bitboard colorBB[2];       // 0 = white pieces, 1 = black pieces
+    Bitboard occupied;         // colorBB[0] | colorBB[1]; the colour masks double as per-side piece lists
+    Uint64 hashKey;            // Zobrist key of board, side, castling rights and en passant file
+    Uint64 pawnKey;            // Zobrist key of the pawns alone, for the pawn hash table
+    Sint32 psq;                // material and piece-square sum, white minus black, as a PackedScore; see setSquare
+    int phase;                 // PIECE_PHASE summed over the board: PHASE_MAX with every piece on, 0 with only pawns
+    int kingSquare[2];         // cached king squares (row * 8 + col), kept current by makeMove/unmakeMove
+    int halfmoveClock;         // plies since the last capture or pawn move (fifty-move rule)
+    int enPassantCol;
+    bool whiteToMove;
+    Uint8 castlingRights;      // CASTLE_* bits, cleared by makeMove through CASTLE_MASK
+    Uint8 board[64];           // the mailbox, a PieceType a square by squareIndex; pieceAt reads it by row and column
+    int fullmoveNumber;        // starts at 1, goes up after each black move (FEN's last field)
+    int keyCount;              // keys pushed so far; only the last KEY_HISTORY_SIZE are kept
+    Sint16 accumulator[2][NNUE_HIDDEN]; // NNUE first layer from white's and from black's side, only kept with a net loaded
+    Uint64 keyHistory[KEY_HISTORY_SIZE]; // hashKey before each move of the game and the search, at keyCount's low bits
+} ChessState;
+
+/* Search features that can be switched off or retuned, so they can be A/B tested */
+typedef struct {
+    bool nullMove;           // null-move pruning
+    int nullMoveReduction;   // R: the null move is searched to depth - 1 - R
+    int nullMoveMinDepth;    // only try it with at least this much depth left
+    bool lateMoveReductions; // search late quiet moves one ply (or two) shallower first
+    int lmrMinDepth;         // only reduce with at least this much depth left
+    int lmrMinMoves;         // moves searched at full depth before reductions start
+    bool checkExtensions;    // search a move that gives check a ply deeper
+    bool singularExtensions; // ... and the hash move, when a search without it shows every other move well below it
+    int singularMinDepth;    // only test for a singular move with at least this much depth left
+    // shallow pruning on the static evaluation, at null-window nodes out of check; margins in centipawns a ply
+    bool reverseFutility;    // return the evaluation when it beats beta by the margin anyway (static null move)
+    int reverseFutilityDepth, reverseFutilityMargin;
+    bool razoring;           // drop straight into quiescence when the evaluation is this far below alpha
+    int razorDepth, razorMargin;
+    bool futilityPruning;    // leave out the quiet moves that don't give check when even the margin can't reach alpha
+    int futilityDepth, futilityMargin;
+    bool probCut;            // a good capture that beats beta by the margin at a shallow depth fails the node high
+    int probCutMinDepth, probCutMargin;
+    bool multiCut;           // the singular test failing high shows beta beaten by several moves: take it as a cutoff
+    bool internalReductions; // a PV node with no hash move is searched a ply shallower (internal iterative reduction)
+    int iirMinDepth;         // only with at least this much depth left
+    bool counterMoves;       // try the quiet move that last refuted the opponent's move right after the killers
+    bool continuationHistory; // order quiets, and set their reductions, by how they did after the last two moves
+    bool lazySmp;            // helpers search the whole tree alongside the engine thread, instead of splitting the root
+    bool splitPoints;        // helpers share the moves of interior nodes (Young Brothers Wait), if lazySmp is off
+    int splitMinDepth;       // only nodes with at least this much depth left are shared
+    int aspirationWindow;    // centipawns each side of the last iteration's score the first root move is searched with
+    bool parallelAspiration; // threads search the whole root at staggered windows about that score instead, the
+                             // first exact one winning; takes the place of lazySmp and splitPoints
+    int prefetchAhead;       // moves after the current one whose hash buckets minimaxAB prefetches, 0 for none
+    bool evalCache;          // per-thread cache of leaf evaluations by hash key
+    bool nnue;               // evaluate with the neural network when one is loaded
+    bool tablebases;         // probe the built-in endgame tablebases (three men, exact) and any Syzygy tables found
+    bool upcomingRepetition; // a node with a move back into an earlier position scores at least the draw (cuckoo tables)
+    bool deterministic;      // one thread, root moves in order: the nodes and the move depend only on the position,
+                             // the hash table's contents and a depth or node limit, never on timing (bench)
+    bool mcts;               // experimental: Monte-Carlo tree search (PUCT) in place of alpha-beta; a node is a descent
+} SearchOptions;
+
+static const SearchOptions DEFAULT_SEARCH_OPTIONS = {
+    .nullMove = true, .nullMoveReduction = 2, .nullMoveMinDepth = 3,
+    .lateMoveReductions = true, .lmrMinDepth = 3, .lmrMinMoves = 3,
+    .checkExtensions = true, .singularExtensions = true, .singularMinDepth = 6,
+    .reverseFutility = true, .reverseFutilityDepth = 3, .reverseFutilityMargin = 120,
+    .razoring = true, .razorDepth = 2, .razorMargin = 300,
+    .futilityPruning = true, .futilityDepth = 2, .futilityMargin = 150,
+    .probCut = true, .probCutMinDepth = 5, .probCutMargin = 200, .multiCut = true,
+    .internalReductions = true, .iirMinDepth = 4, .counterMoves = true, .continuationHistory = true,
+    .lazySmp = true, .splitPoints = false, .splitMinDepth = 4, .aspirationWindow = 50, .parallelAspiration = false,
+    .prefetchAhead = 2, .evalCache = true, .nnue = true, .tablebases = true, .upcomingRepetition = true, .deterministic = false, .mcts = false
+};
+
+#define MAX_MULTI_PV 8
+#define MAX_PV_LENGTH 24
+
+// one analysis line: a root move and the play expected after it
+typedef struct {
+    Move moves[MAX_PV_LENGTH];
+    int length;
+    int score;  // centipawns (or mate) for the side to move at the root
+} PvLine;
+
+/* Nodes searched by one thread. Only that thread writes it, so there is nothing to lock, and the padding keeps
+   each counter on its own cache line; readers add them all up (engineNodeCount). */
+typedef struct {
+    Uint64 nodes;
+    Uint64 lifetimeNodes, ttProbes, ttHits, tbHits; // since the engine was made, never reset (engineCounters)
+    int selDepth; // the deepest ply this thread has reached in the search, quiescence included
+    Uint8 pad[64 - 5 * sizeof(Uint64) - sizeof(int)];
+} NodeCounter;
+
+// what an engine has done since it was made, all its threads' NodeCounters added up when asked
+typedef struct {
+    Uint64 nodes;
+    Uint64 ttProbes, ttHits; // hash table lookups in the main search, and entries found
+    Uint64 tbHits;           // positions scored from the endgame tablebases
+} EngineCounters;
+
+typedef struct TTEntry TTEntry; // see the transposition table code
+
+/* Search statistics, for tuning the pruning. They're only counted in an engine built with SEARCH_STATS defined,
+   each thread into its own block with plain increments, and summed by engineSearchStats once the search is over;
+   built without, there is no trace of them in the search. */
+typedef struct {
+    Uint64 nodes;            // every node, quiescence included (all threads)
+    Uint64 qnodes;           // quiescence nodes
+    Uint64 betaCutoffs;      // nodes a move failed high at
+    Uint64 firstMoveCutoffs; // ... with the first move tried
+    Uint64 ttProbes, ttHits, ttCutoffs; // hash table lookups in minimaxAB, entries found, scores returned from them
+    Uint64 nullTries, nullCutoffs;      // null-move searches, and those that failed high
+    Uint64 lmrReductions, lmrResearches; // reduced late moves, and those searched again at full depth
+    Uint64 checkExtensions;  // moves searched a ply deeper for giving check
+    Uint64 singularTries, singularExtensions; // searches without the hash move, and hash moves found singular by them
+    Uint64 reverseFutilityCutoffs;   // nodes returned their static evaluation from
+    Uint64 razorTries, razorCutoffs; // quiescence searches razoring asked for, and those that stayed below alpha
+    Uint64 futilityPrunes;   // quiet moves left out as futile
+    Uint64 probCutTries, probCutCutoffs; // captures ProbCut searched, and nodes it failed high
+    Uint64 multiCuts;        // nodes the singular test failed high
+    Uint64 iirReductions;    // nodes searched a ply shallower for having no hash move
+    Uint64 counterMoveCutoffs; // cutoffs by the counter-move
+    Uint64 cycleCutoffs;     // nodes cut off by the draw a move back into an earlier position holds
+    int depth;               // iterations completed
+    Uint64 iterationNodes[MAX_PLY + 1]; // nodes each iteration took on the searching thread, [depth]
+} SearchStats;
+
+/* Evaluation profile, for weighing a term's cost against what it brings. In an engine built with EVAL_PROFILE
+   defined, evaluatePosition times each term with the processor's cycle counter (the time stamp counter on x86-64,
+   the performance counter elsewhere) and sums the size of what the term added to the score, each thread into the
+   block of its own pawn table, with plain adds; engineEvalProfile sums the blocks. Built without, there is no
+   trace of it in the evaluation. Reading the counter costs more than some terms do, so the cycles rank the terms
+   against one another rather than give what an evaluation costs without the profile. */
+enum { EVAL_PROFILE_PSQ, EVAL_PROFILE_MATERIAL, EVAL_PROFILE_MOBILITY, EVAL_PROFILE_CENTER, EVAL_PROFILE_PAWNS,
+       EVAL_PROFILE_KING, EVAL_PROFILE_TERMS };
+
+typedef struct {
+    Uint64 calls;            // evaluations with a pawn table
+    Uint64 cacheHits;        // answered from the evaluation cache
+    Uint64 endings;          // by an ending's own evaluation
+    Uint64 lazyExits;        // cut short outside the window by LAZY_EVAL_MARGIN
+    Uint64 cycles[EVAL_PROFILE_TERMS];    // spent on each term
+    Uint64 evaluated[EVAL_PROFILE_TERMS]; // times each was worked out
+    Uint64 magnitude[EVAL_PROFILE_TERMS]; // the sum of the size of what it added, centipawns
+} EvalProfile;
+
+/* Search log (engineSearchLogOpen): a record of what each search did, kept while it runs for working out afterwards
+   why one lost on time or blundered. Each thread writes its records into a ring of its own, no lock and no system
+   call, and the log's own thread drains the rings to the file every SEARCH_LOG_FLUSH_MS; a ring that fills up in
+   between loses the records it has no room for, and says how many in a SEARCH_LOG_DROPPED. The file is a
+   SearchLogHeader and then the records as they are, this machine's byte order, in the order they were drained;
+   `main searchlog FILE` prints them in time order. */
+#define SEARCH_LOG_VERSION 1
+
+typedef enum {
+    SEARCH_LOG_START,        // depth = the depth limit (0 none), score = the soft time in ms, value = the hard time in ms (0 no clock)
+    SEARCH_LOG_ITERATION,    // one done: depth, score, move = its best, value = nodes so far
+    SEARCH_LOG_PV_CHANGE,    // it changed the best move: depth, score, move, value = the move it replaced
+    SEARCH_LOG_TIME_CHECK,   // value = ns since the start, score = 1 when it ran out the hard time
+    SEARCH_LOG_ABORT,        // an iteration given up: depth, score = why (SearchLogAbort), value = nodes so far
+    SEARCH_LOG_THREAD_START, // a helper joining the search
+    SEARCH_LOG_THREAD_STOP,  // and leaving it, value = the nodes it searched
+    SEARCH_LOG_END,          // depth = the last one done, score, move = the answer, value = nodes
+    SEARCH_LOG_DROPPED,      // value = records this thread had no room for just before
+    SEARCH_LOG_KINDS
+} SearchLogKind;
+
+typedef enum { SEARCH_LOG_STOPPED, SEARCH_LOG_OUT_OF_TIME, SEARCH_LOG_OUT_OF_NODES } SearchLogAbort;
+
+typedef struct {
+    Uint64 timeNS;   // SDL_GetTicksNS
+    Uint64 value;
+    Uint32 search;   // numbered from 1 over every engine since the log was opened
+    Sint32 score;
+    Move move;
+    Sint16 depth;
+    Uint8 kind;      // SearchLogKind
+    Uint8 thread;    // 0 the engine's own thread, 1 + n pool worker n
+    Uint16 unused;
+} SearchLogRecord;
+
+typedef struct {
+    char magic[8];   // "CHESSLOG"
+    Uint32 version;  // SEARCH_LOG_VERSION
+    Uint32 recordSize;
+} SearchLogHeader;
+
+/* Search tree samples (engineSearchTreeWrite), for seeing where the nodes go. In an engine built with SEARCH_TREE
+   defined, minimaxAB keeps a record of a fraction of its nodes (engineSearchTreeSample), picked by a hash of the
+   position and the depth, so a deterministic run samples the same nodes every time: where the node stood, the
+   window it had, how it ended (the pruning that took it, or which move cut off and where the picker found it)
+   and what its subtree cost. Each thread keeps its own, with plain writes. The file is a SearchTreeHeader and then
+   the records, this machine's byte order; `main searchtree FILE` sums them up. Built without, there is no trace of
+   it in the search. */
+#define SEARCH_TREE_VERSION 1
+#define SEARCH_TREE_SAMPLE 0.01 // the fraction of nodes kept until engineSearchTreeSample says otherwise
+
+typedef enum {
+    SEARCH_TREE_QUIESCENCE,        // depth 0, handed to quiescence
+    SEARCH_TREE_DRAW,              // a repetition or the fifty-move rule
+    SEARCH_TREE_TABLEBASE,
+    SEARCH_TREE_MATE_DISTANCE,     // the window closed by mate distance pruning
+    SEARCH_TREE_HASH_CUT,          // the hash table's score
+    SEARCH_TREE_REVERSE_FUTILITY,
+    SEARCH_TREE_RAZOR,
+    SEARCH_TREE_NULL_MOVE,
+    SEARCH_TREE_PROBCUT,
+    SEARCH_TREE_MULTICUT,
+    SEARCH_TREE_BETA_CUT,          // a move failed high: cutIndex, cutSource
+    SEARCH_TREE_FAIL_LOW,          // no move raised alpha
+    SEARCH_TREE_EXACT,             // a score inside the window
+    SEARCH_TREE_NO_MOVES,          // mate or stalemate
+    SEARCH_TREE_OUTCOMES
+} SearchTreeOutcome;
+
+// where the move that cut off came from (the move picker's stages)
+typedef enum {
+    SEARCH_TREE_FROM_HASH, SEARCH_TREE_FROM_CAPTURE, SEARCH_TREE_FROM_KILLER, SEARCH_TREE_FROM_COUNTER,
+    SEARCH_TREE_FROM_QUIET, SEARCH_TREE_FROM_BAD_CAPTURE, SEARCH_TREE_FROM_UNDERPROMOTION, SEARCH_TREE_FROM_EVASION,
+    SEARCH_TREE_SOURCES
+} SearchTreeSource;
+
+enum {
+    SEARCH_TREE_PV = 1,            // a full window, beta - alpha > 1
+    SEARCH_TREE_IN_CHECK = 2,
+    SEARCH_TREE_REDUCED = 4,       // internal iterative reduction took a ply off
+    SEARCH_TREE_NULL_TRIED = 8,
+    SEARCH_TREE_PROBCUT_TRIED = 16,
+    SEARCH_TREE_SINGULAR = 32,     // the hash move came out singular and was extended
+    SEARCH_TREE_EXCLUDED = 64,     // the singular test itself: the node less its hash move
+    SEARCH_TREE_SPLIT = 128,       // its later moves went to a split point
+};
+
+typedef struct {
+    Uint64 nodes;      // the subtree's, counted on this thread (a split point's helpers count on theirs)
+    Sint32 alpha, beta; // the window it was given
+    Sint32 score;
+    Uint16 search;     // numbered from 1 since the samples were last cleared
+    Uint8 thread;      // 0 the engine's own thread, 1 + n pool worker n
+    Uint8 ply;
+    Uint8 depth;       // as it was given, before any reduction
+    Uint8 outcome;     // SearchTreeOutcome
+    Uint8 flags;
+    Uint8 moves;       // legal moves looked at, futility-pruned ones included; at most 255, as are the next two
+    Uint8 pruned;      // of them, futility-pruned
+    Uint8 cutIndex;    // SEARCH_TREE_BETA_CUT: the move that cut off, from 1; 0 when a split point's did
+    Uint8 cutSource;   // and where it came from, SearchTreeSource
+    Uint8 unused;
+} SearchTreeRecord;
+
+typedef struct {
+    char magic[8];     // "CHESSTRE"
+    Uint32 version;    // SEARCH_TREE_VERSION
+    Uint32 recordSize;
+    double sample;     // the fraction of nodes kept
+    Uint64 dropped;    // records a thread had no room for
+} SearchTreeHeader;
+
+// where the hash table's memory came from (ttResize), each freed its own way
+typedef enum { TT_PAGES_HEAP, TT_PAGES_NORMAL, TT_PAGES_TRANSPARENT, TT_PAGES_LARGE, TT_PAGES_SHARED } TTPages;
+
+typedef struct {
+    TTEntry* entries; // in buckets of TT_BUCKET_ENTRIES, one to a cache line
+    Uint64 mask;      // entries - 1
+    TTPages pages;
+    Uint8 generation; // stamped on what each search stores, so the next ones can tell it's stale (ttNewSearch)
+    SDL_AtomicInt* sharedGeneration; // TT_PAGES_SHARED: the segment's, counted by every process's searches
+    void* sharedHandle; // TT_PAGES_SHARED on Windows: the file mapping's HANDLE
+} TransTable;
+
+/* Where an engine's memory goes, in bytes (engineMemoryUsage). The per-thread tables, the stacks and the lookup
+   tables belong to the process and are shared by its engines; they're counted for the search threads running. */
+typedef struct {
+    size_t hash;           // this engine's transposition table
+    size_t pawnTables;     // one per search thread
+    size_t evalCaches;     // likewise
+    size_t searchContexts; // search stack, killers and history, one per searching thread
+    size_t rootSplit;      // the jobs of a root split for a full move list; each job's copy of the position is on its worker's stack
+    size_t threadStacks;   // reserved for the pool's workers, the engine thread and the request thread
+    size_t tables;         // attack tables, the NNUE net once loaded, the tablebases once built, the Engine itself
+    size_t total;
+} EngineMemory;
+
+// what a benchmark ran (engineBuildInfo), kept with its results so they're only compared like with like
+typedef struct {
+    char compiler[80];    // the compiler's own version string
+    char built[24];       // date and time engine.c was compiled
+    char options[64];     // optimised or not, and the compile-time options that change the speed
+    char kernels[64];     // the hot paths picked for this processor at start-up
+    char cpu[64];         // the processor's name, where it can be asked
+    int cores;            // logical
+} EngineBuild;
+
+typedef enum { ENGINE_EVENT_INFO, ENGINE_EVENT_BEST_MOVE } EngineEventType;
+
+// what the engine thread tells the UI (or the EngineEventCallback)
+typedef struct {
+    EngineEventType type;
+    Move move;        // BEST_MOVE: the search's answer
+    int depth;        // INFO: the iteration just completed
+    int lineIndex;    // INFO: which Multi-PV line this is, 0 = the best
+    int lineCount;    // INFO: lines in the iteration
+    PvLine line;
+    Uint64 nodes;     // INFO: all threads, so far
+    Uint64 nps;
+    int elapsedMs;
+    int selDepth;     // INFO: the deepest any thread has gone
+    int hashfull;     // INFO: permille of the transposition table written to by this search
+} EngineEvent;
+
+#define ENGINE_EVENT_QUEUE 64 // power of two; no more than MAX_MULTI_PV infos arrive per iteration
+
+/* Lock-free single-producer single-consumer ring: only the engine thread pushes, only the UI thread pops, and
+   search threads are started and joined by the UI thread so there is never more than one producer. Each index
+   is written by one side only; storing it publishes the slot to the other side (SDL atomics are full barriers).
+   The two sit on their own cache lines so pushing and popping don't fight over one. */
+typedef struct {
+    EngineEvent events[ENGINE_EVENT_QUEUE];
+    SDL_AtomicInt tail;   // next slot to push, engine thread
+    Uint8 pad[64 - sizeof(SDL_AtomicInt)];
+    SDL_AtomicInt head;   // next slot to pop, UI thread
+} EngineChannel;
+
+typedef void (*EngineEventCallback)(const EngineEvent* event, void* userData);
+
+/* A bump allocator: one block taken up front and handed out front to back, then given back all at once
+   (arenaRewind, arenaReset) when the work it served is done, so what lives and dies with a request costs no
+   malloc or free and leaves the heap no holes. */
+typedef struct {
+    Uint8* base;
+    size_t size, used;
+} Arena;
+bool arenaCreate(Arena* arena, size_t size);
+void arenaDestroy(Arena* arena);
+void* arenaAlloc(Arena* arena, size_t size); // zeroed and 64-byte aligned; NULL once the arena is full
+static inline void arenaRewind(Arena* arena, size_t mark) { arena->used = mark; } // back to an earlier arena->used
+static inline void arenaReset(Arena* arena) { arena->used = 0; }
+
+typedef struct OpeningBook OpeningBook; // a Polyglot-format book file or an explorer index, mapped; see bookOpen
+typedef struct EngineRequest EngineRequest; // a search queued by engineSubmit
+typedef struct SearchContext SearchContext; // a thread's search state, engine.c's own
+
+#define INTERLEAVE_MAX 16 // Engine.interleave's most
+#define ENGINE_RESULTS 1024 // Engine.results' slots, a power of two
+
+// a finished search's answer, kept by position for Engine.reuseResults
+typedef struct {
+    Uint64 key;  // the position's, 0 = empty
+    Move move;
+    int score;
+    int depth;
+} EngineResult;
+#define PONDER_REPLIES_MAX 4 // Engine.ponderReplies' most
+
+typedef struct {
+    NodeCounter nodeCounters[MAX_POOL_THREADS + 1]; // [0] the engine thread, then one per pool worker
+    SDL_Thread* thread;
+    ChessState position;     // the one being searched, copied in by engineStartSearch
+    EngineChannel channel;   // engine thread -> UI thread, unless there is a callback
+    EngineEventCallback onEvent; // NULL = queue the events for enginePollEvents, else called on the engine thread
+    EngineEventCallback onQueued; // with onEvent NULL: called on the engine thread once an event is queued, to wake the UI
+    void* userData;          // passed to onEvent and onQueued
+    SDL_AtomicInt stop;      // 1 = abandon the search: hard deadline, "move now", a ponder miss or quit
+    Uint64 startNS;          // per-search time budget, 0 = no limit
+    Uint64 softTimeNS;
+    Uint64 hardTimeNS;
+    SearchOptions options;   // all off when zeroed
+    bool ponder;             // think about the expected reply while the user is on move
+    int ponderReplies;       // ... and the likeliest others, up to PONDER_REPLIES_MAX in all; < 2 = the expected one alone
+    SDL_AtomicInt pondering; // 1 = searching the position after ponderMove, the clock doesn't stop it
+    Move ponderMove;         // the reply being pondered on, MOVE_NONE for a normal search
+    int multiPv;             // lines to search and report, 1 = just the best move
+    const OpeningBook* book; // answer from it without searching while the position is in it, NULL = none
+    Uint64 bookRandom;       // SDL_rand_r state for choosing among book moves by weight
+    TransTable* tt;          // shared by all the threads of a search, owned by the engine (engineSetHash)
+    size_t hashMB;           // the size last asked of engineSetHash; the table can be smaller under memoryLimit
+    size_t memoryLimit;      // bytes the whole engine is to keep within by shrinking its hash table, 0 = no limit
+    char hashShareName[64];  // the shared-memory segment the table lives in (engineShareHash), empty for its own
+    bool borrowedHash;       // tt is another engine's (engineBorrowHash), not this one's to free or clear
+    bool poolJob;            // the search itself is running on a pool worker, so it must not queue work for the pool
+    SearchContext* contexts[MAX_POOL_THREADS + 1]; // by searchThreadSlot, made on first use and kept until engineDestroy
+    Uint32 searchId;         // counts the searches, so a context can tell when it comes to a new one
+    Uint32 logSearch;        // the search's number in the search log, while one is open
+    Uint32 treeSearch;       // and among the search tree samples, in a SEARCH_TREE build
+    Uint64 nodeLimit;        // stop after this many nodes (exactly on one thread), 0 = no limit
+    int depthLimit;          // iterations to run, 0 = up to MOVE_DEPTH
+    bool infinite;           // hold the answer back until the stop flag, even once the search has ended (UCI)
+    bool reuseResults;       // answer a position searched before this game from results at once (engineStartSearch)
+    EngineResult results[ENGINE_RESULTS]; // by key, the deepest kept; engineNewGame empties it
+    // the last search's line two plies on, for the next one's easy-move test (runEngineSearch)
+    Uint64 expectedKey;      // the position after its move and the reply it expected, 0 = none
+    Move expectedMove;       // the move it meant to play there
+    int expectedScore;
+    bool expectedRecapture;  // that move takes back on the square the reply captured on
+    // UI thread only, kept up to date from the channel (enginePollEvents)
+    bool searching;          // a search is under way and hasn't answered yet
+    bool hasMove;            // resultMove is to be played
+    Move resultMove;
+    bool ponderDone;         // the ponder search ended before the user moved; its move waits in resultMove
+    EngineEvent info;        // the latest ENGINE_EVENT_INFO for the best line
+    PvLine lines[MAX_MULTI_PV]; // the best lines of the last completed iteration, best first
+    int lineCount;
+    // engineSubmit's queue, searched first in, first out on the request thread; all of it under requestLock
+    SDL_Mutex* requestLock;
+    SDL_Condition* requestSignal;  // a request queued, answered or cancelled, or the thread told to quit
+    SDL_Thread* requestThread;     // started by the first engineSubmit
+    EngineRequest* requestHead;    // the next to search, linked through their next pointers
+    EngineRequest* requestTail;
+    EngineRequest* requestCurrent; // being searched, NULL in between
+    bool requestQuit;
+    int interleave;                // small requests searched side by side on the request thread, up to INTERLEAVE_MAX; < 2 = one at a time
+    int batchThreads;              // the most threads a batch request searches with, 0 = all of them
+    int threadLimit;               // the search's, from batchThreads; 0 = no limit
+    Uint64 preemptions;            // batch searches stopped for an interactive request, under requestLock
+    Arena interleaveArena;         // request thread: the interleaved searches' state, taken the first time and reset each batch
+#if defined(SEARCH_STATS)
+    SearchStats stats[MAX_POOL_THREADS + 1]; // indexed like the node counters
+#endif
+} Engine;
+/* Root move list kept across iterative deepening iterations: each iteration is ordered by the scores of the
+   one before, and the first move is searched with an aspiration window around the previous best score. */
+typedef struct {
+    Move moves[256];
+    int scores[256];  // root side's point of view, from the last completed iteration (upper bounds for most)
+    int count;
+    int lastScore;    // best score of the last completed iteration
+    int depthDone;    // 0 until one iteration has finished
+} RootMoves;
+
+// when a search is to end; zeroed = no limit at all, until engineStopSearch
+typedef struct {
+    int depth;         // iterations to run, 0 = up to MOVE_DEPTH
+    Uint64 nodes;      // stop after this many nodes, exactly when one thread searches; 0 = no limit
+    Uint64 softTimeNS; // no iteration is started after this, 0 = no limit
+    Uint64 hardTimeNS; // the iteration under way is abandoned here, 0 = no limit
+    bool infinite;     // hold the best move back until engineStopSearch, even once the search has ended
+    Move ponderMove;   // search the position after this reply to it instead, MOVE_NONE for a normal search
+    bool batch;        // engineSubmit: bulk work, queued behind the interactive requests and preempted by them
+} SearchLimits;
+
+/* Training records: a position, the score a search gave it and the game's result in TRAINING_RECORD_SIZE bytes,
+   for self-play data. Little-endian:
+     0  Uint64 occupied squares (bit = row * 8 + col)
+     8  16 bytes of 4-bit pieces, one per occupied square in square order, low nibble first: 1-6 white pawn to king,
+        7-12 black
+    24  Sint16 score in centipawns, side to move's point of view
+    26  Uint16 ply of the game (from the fullmove number)
+    28  Uint8 bit 0 black to move, bits 1-4 castling rights K, Q, k, q
+    29  Uint8 en passant file + 1, 0 for none
+    30  Sint8 result for white: 1 won, 0 drawn, -1 lost
+    31  Uint8 halfmove clock, at most 255 */
+#define TRAINING_RECORD_SIZE 32
+
+static inline int squareIndex(int r, int c) { return r * 8 + c; }
+static inline PieceType pieceAt(const ChessState* chess, int r, int c) { return (PieceType)chess->board[squareIndex(r, c)]; }
+static inline bool isWhite(PieceType p) { return p != EMPTY && !(p & PIECE_BLACK); }
+static inline bool isBlack(PieceType p) { return (p & PIECE_BLACK) != 0; }
+
+// how the search pool's idle workers waited for their jobs: spinning (engineSetThreadSpin), then asleep
+typedef struct {
+    Uint64 jobs;      // jobs the workers took
+    Uint64 spunJobs;  // of those, the ones a worker saw while it was still spinning, with no wake-up
+    Uint64 latencyNS; // from submit to a worker taking the job, over all of them
+    Uint64 spinNS;    // time the workers spent spinning with nothing to do, CPU the idle pool used
+    Uint64 parks;     // times a worker gave up spinning and slept
+} ThreadWakeups;
+
+// a file mapped read-only, or read into memory where it can't be mapped
+typedef struct {
+    const char* data; // not NUL-terminated
+    size_t size;
+    bool mapped;
+#if defined(_WIN32)
+    void* file;    // HANDLEs
+    void* mapping;
+#endif
+} MappedFile;
+
+// process-wide set-up: the attack, key and evaluation tables (once is enough) and the search threads
+void engineInitTables(void);
+void engineBuildTablebases(void);
+bool engineProbeTablebases(const ChessState* chess, int* score); // the score for the side to move, if covered
+int engineSetSyzygyPath(const char* paths); // the Syzygy tables in these directories, how many; not while searching
+bool engineStartThreads(int threadCount, bool pinned);
+bool engineSetThreads(int threadCount);
+void engineSetThreadPriority(SDL_ThreadPriority priority);
+void engineSetThreadSpin(int microseconds);
+void engineStopThreads(void);
+int engineThreadActivity(Uint64 busyNS[MAX_POOL_THREADS], Uint64* waitNS);
+void engineThreadWakeups(ThreadWakeups* wakeups);
+int engineRunOnThreads(SDL_ThreadFunction func, void* data);
+void engineBuildInfo(EngineBuild* build);
+bool nnueLoad(const char* path);
+bool nnueSave(const char* path); // the loaded network in the layout that's mapped as it is, shared between processes
+
+/* The hand-written evaluation of count positions into scores, white's point of view: what the search's static
+   evaluation gives each with no window and the network off. Worked EVAL_BATCH_LANES positions at a time across
+   vector lanes, for scoring a data set; it keeps no tables, so any number of threads can call it at once. */
+#define EVAL_BATCH_LANES 8
+void evaluateBatch(const ChessState* positions, int count, int* scores);
+bool nnueEvaluateBatch(const ChessState* positions, int count, int* scores); // the same with the network; false with none
+
+/* The hand-written evaluation as a sum linear in its weights, for `main tune` (Texel's method): material, plus each
+   piece's piece-square entries tapered by the phase, plus each term's count times its weight, the king shield
+   tapered as a middlegame term. To within rounding it's evaluateBatch's score, except in the endings that have an
+   evaluation of their own, which evalFeatures marks not linear. */
+enum { EVAL_TERM_MOBILITY, EVAL_TERM_CENTER, EVAL_TERM_DOUBLED, EVAL_TERM_ISOLATED, EVAL_TERM_PASSED, // PASSED: its ranks from home
+       EVAL_TERM_BACKWARD, EVAL_TERM_CANDIDATE, EVAL_TERM_BISHOP_PAIR, EVAL_TERM_SHIELD, EVAL_TERM_COUNT };
+#define EVAL_TABLE_PARAMS (2 * 6 * 64) // [phase][white PieceType - 1][square as white], phase 0 the middlegame
+#define EVAL_PARAM_COUNT (EVAL_TABLE_PARAMS + EVAL_TERM_COUNT) // the tables, then the term weights
+
+typedef struct {
+    bool linear;                   // false in one of the endings, or with more than 32 pieces
+    Uint8 pieceCount;
+    Uint16 weight;                 // the middlegame's share of the taper, out of 256
+    Sint16 material;               // piece values, white minus black; not tuned, the search uses them too
+    Sint16 pieces[32];             // each piece's (kind - 1) * 64 + square as its side sees it, ~that for black's
+    Sint16 terms[EVAL_TERM_COUNT]; // counts, white minus black
+} EvalFeatures;
+void evalFeatures(const ChessState* positions, int count, EvalFeatures* features);
+void evalParams(int params[EVAL_PARAM_COUNT]); // the ones the engine is built with
+
+/* The loaded network evaluated on the GPU through SDL's GPU API, GPU_EVAL_BATCH positions a batch, for scoring
+   data sets. shaderPath: shaders/nnue_eval.comp compiled to SPIR-V (the build does it with -DCHESS_GPU_EVAL=ON,
+   and gpucheck.c checks its scores against nnueEvaluateBatch).
+   NULL, logged, with no network loaded, no shader or no device that runs it: evaluate on the CPU instead.
+   Double-buffered: gpuEvalSubmit queues a batch and returns straight away (false when two are in flight
+   already, or on an error), gpuEvalCollect waits for the oldest and gives its scores, white's point of view
+   like nnueEvaluateBatch, and their count: 0 with nothing in flight, -1 if the batch failed. One thread at a
+   time per evaluator. */
+#define GPU_EVAL_BATCH 512
+typedef struct GpuEvaluator GpuEvaluator;
+GpuEvaluator* gpuEvalCreate(const char* shaderPath);
+void gpuEvalDestroy(GpuEvaluator* gpu);
+bool gpuEvalSubmit(GpuEvaluator* gpu, const ChessState* const positions[], int count);
+int gpuEvalCollect(GpuEvaluator* gpu, int* scores);
+bool mapFile(MappedFile* mf, const char* path);
+void unmapFile(MappedFile* mf);
+
+/* A mate-in-N question for solveMate: a mate within maxMoves moves of the side to move, looking at checking
+   moves only for the attacker unless checksOnly is off (slower, but it finds the mates with a quiet move in them). */
+#define MATE_MAX_MOVES 32
+#define MATE_HASH_MB 64
+
+typedef struct {
+    int maxMoves;     // 1 to MATE_MAX_MOVES
+    bool checksOnly;
+    Uint64 nodeLimit; // 0 = none
+    size_t hashMB;    // the solver's own table, 0 = MATE_HASH_MB
+} MateQuery;
+
+typedef struct {
+    int mateIn;       // moves to the mate, 0 = none found
+    bool complete;    // false: the node limit was reached, so no mate is no answer
+    Move pv[2 * MATE_MAX_MOVES]; // the mating line, the defender holding out longest
+    int pvLength;
+    Uint64 nodes;
+} MateResult;
+
+bool solveMate(const ChessState* position, const MateQuery* query, MateResult* result); // false: no memory
+
+// opening books; read-only once open, so any number of engines and threads may share one
+OpeningBook* bookOpen(const char* path);
+void bookClose(OpeningBook* book);
+Uint64 bookKey(const ChessState* chess);
+Uint16 bookEncodeMove(Move move);
+Move bookProbe(const OpeningBook* book, ChessState* chess, Uint64* random);
+
+typedef struct {
+    Move move;
+    Uint32 games;                      // a Polyglot book's weight
+    Uint32 whiteWins, draws, blackWins; // an explorer index's; the rest of the games had no result
+} BookMoveStats;
+
+int bookStats(const OpeningBook* book, ChessState* chess, BookMoveStats* stats, int max);
+
+/* Packed shards: training records compressed about tenfold, for `selfplay ... packed` and the readers of shards
+   (format in engine.c). A writer takes records in order and writes as it goes; close writes the index and frees
+   it, false if anything failed (SDL_GetError), the stream left open. A reader works over the whole file in
+   memory (mapFile), decoding a block at a time as it streams records out: read returns how many it gave, 0 at
+   the end, -1 on damaged data; seek goes to any record through the index. One thread at a time per reader. */
+#define SHARD_MAGIC "CHSHARD1" // a packed shard's first eight bytes
+typedef struct ShardWriter ShardWriter;
+typedef struct ShardReader ShardReader;
+ShardWriter* shardWriterOpen(SDL_IOStream* out); // NULL without the memory, or if the header can't be written
+bool shardWriterAdd(ShardWriter* writer, const Uint8 record[TRAINING_RECORD_SIZE]);
+bool shardWriterClose(ShardWriter* writer);
+ShardReader* shardReaderOpen(const void* data, size_t size); // NULL, SDL_GetError saying why, for no packed shard
+void shardReaderClose(ShardReader* reader);
+Uint64 shardReaderRecords(const ShardReader* reader);
+bool shardReaderSeek(ShardReader* reader, Uint64 record);
+int shardReaderRead(ShardReader* reader, Uint8* records, int max);
+
+/* Position filters: a Bloom filter of Zobrist keys that any number of threads add to at once without a lock, for
+   the data generators to drop positions already written. Its memory is fixed when it's made; the fuller it gets,
+   the more often a new position is taken for one it has seen (the false-positive rate). A seen one is only taken
+   for new when two threads add it at the same moment. */
+typedef struct PositionFilter PositionFilter;
+PositionFilter* positionFilterCreate(size_t bytes); // rounded down to a power of two, at least 64; NULL without the memory
+void positionFilterDestroy(PositionFilter* filter);
+bool positionFilterAdd(PositionFilter* filter, Uint64 key); // false: seen before (or, rarely, a false positive)
+size_t positionFilterBytes(const PositionFilter* filter);
+double positionFilterFalsePositiveRate(const PositionFilter* filter); // a new key's chance of being taken as seen, now
+
+// positions and moves
+ChessState initChessState(void);
+bool loadFen(ChessState* chess, const char* fen);
+int writeFen(const ChessState* chess, char* out, size_t size);
+void getAllMoves(ChessState* chess, MoveList* moves);
+int countLegalMoves(ChessState* chess); // getAllMoves's count, without the list
+bool hasLegalMove(ChessState* chess);   // stops at the first legal move
+GameStatus getGameStatus(ChessState* chess);
+void makeMove(ChessState* chess, Move move, void* _undo);
+void unmakeMove(ChessState* chess, Move move, void* _undo);
+Move buildMove(const ChessState* chess, int from, int to);
+bool isLegalMove(const ChessState* chess, int fr, int fc, int tr, int tc);
+Bitboard moveOrigins(const ChessState* chess, PieceType piece, int to); // the squares piece can legally reach to from
+bool isKingInCheck(const ChessState* chess, bool whiteKing);
+char* move2chars(Move move, char out[MOVE_TEXT_MAX]);
+int moveToCoordinates(Move move, char out[6]);
+int moveToSan(ChessState* chess, Move move, char out[MOVE_SAN_MAX]);
+int formatPv(const ChessState* position, const Move* moves, int count, bool san, char* out, size_t size);
+void trainingRecordPack(const ChessState* chess, int score, int result, Uint8 record[TRAINING_RECORD_SIZE]);
+bool trainingRecordUnpack(const Uint8 record[TRAINING_RECORD_SIZE], ChessState* chess, int* score, int* result);
+
+// engines: each has its own options, hash table and event channel; all of them share the search threads
+Engine* engineCreate(void);
+void engineDestroy(Engine* engine);
+bool engineSetHash(Engine* engine, size_t megabytes);
+bool engineShareHash(Engine* engine, const char* name);
+bool engineBorrowHash(Engine* engine, Engine* owner);
+bool engineSaveHash(Engine* engine, const char* path);
+bool engineLoadHash(Engine* engine, const char* path);
+void engineWarmHash(Engine* engine, Uint64 key, Move move, int score, int depth);
+void engineNewGame(Engine* engine);
+bool engineStartSearch(Engine* engine, const ChessState* position, const SearchLimits* limits);
+void engineStopSearch(Engine* engine);
+void engineMoveNow(Engine* engine);
+bool enginePonderHit(Engine* engine, Move move);
+void enginePollEvents(Engine* engine);
+Move engineExpectedReply(Engine* engine, ChessState* chess);
+int engineLine(Engine* engine, const ChessState* position, Move first, Move pv[MAX_PV_LENGTH]);
+Uint64 engineNodeCount(Engine* engine);
+void engineCounters(Engine* engine, EngineCounters* counters); // any time, from any thread; only reads
+int engineSelDepth(Engine* engine);
+int engineThreadNodes(Engine* engine, Uint64 nodes[MAX_POOL_THREADS + 1]);
+int engineHashfull(const Engine* engine);
+Move engineSearch(Engine* engine, ChessState* position, const SearchLimits* limits, RootMoves* root);
+EngineRequest* engineSubmit(Engine* engine, const ChessState* position, const SearchLimits* limits,
+                            EngineEventCallback onEvent, void* userData, Arena* arena);
+bool engineRequestPoll(EngineRequest* request, EngineEvent* progress);
+Move engineRequestWait(EngineRequest* request);
+void engineRequestCancel(EngineRequest* request);
+void engineRequestFree(EngineRequest* request);
+void engineClearEvalCache(void);
+void engineEvalCacheStats(Uint64* probes, Uint64* hits);
+bool engineEvalProfile(EvalProfile* profile); // false (and zeros) when not built with EVAL_PROFILE
+bool engineSearchStats(Engine* engine, SearchStats* stats);
+void engineAddSearchStats(SearchStats* total, const SearchStats* stats);
+bool engineTraceWrite(const char* path);
+bool engineSearchLogOpen(const char* path); // false with SDL_GetError() set, or when one is open already
+void engineSearchLogClose(void);            // whatever the rings still hold goes to the file first
+// SEARCH_TREE builds only (false otherwise); both to be called while nothing is searching
+bool engineSearchTreeSample(double fraction); // forgets the samples so far
+bool engineSearchTreeWrite(const char* path);
+void engineMemoryUsage(Engine* engine, EngineMemory* memory);
+bool engineSetMemoryLimit(Engine* engine, size_t megabytes);
+
+#endif // ENGINE_H
@@ -4,17 +4,180 @@
 #include <SDL3_ttf/SDL_ttf.h>
 #include <SDL3_image/SDL_image.h>
 
+/* Text cache: a TTF_Text, and its size, for each (font, size, string) drawn or measured lately, so a label that
+ * doesn't change costs a lookup per frame rather than a layout and glyph upload. Set-associative, the least
+ * recently used of its set making way for a new string. Each size gets a copy of its font, since resizing a font
+ * would send every text made with it back to be laid out again. */
+#define CLAY_SDL3_TEXT_SETS 64
+#define CLAY_SDL3_TEXT_WAYS 8
+#define CLAY_SDL3_SIZED_FONTS 8
+
+typedef struct {
+    Uint64 hash;
+    TTF_Text *text; // NULL = empty
+    Uint64 lastUsed;
+    int width, height;
+} Clay_SDL3CachedText;
+
+typedef struct {
+    Uint16 fontId, fontSize;
+    TTF_Font *font;
+} Clay_SDL3SizedFont;
+
+typedef struct {
+    Clay_SDL3CachedText texts[CLAY_SDL3_TEXT_SETS][CLAY_SDL3_TEXT_WAYS];
+    Clay_SDL3SizedFont fonts[CLAY_SDL3_SIZED_FONTS];
+    int fontCount;
+    Uint64 clock;
+} Clay_SDL3TextCache;
+
+/* Custom elements (.custom.customData) are batches of triangles laid out in the element's own unit square, (0, 0)
+ * its top left corner and (1, 1) its bottom right, drawn with one SDL_RenderGeometry call wherever the layout
+ * puts the element: a whole board of squares and pieces costs one draw call. The SDL_GPU renderer
+ * (clay_renderer_SDL3_gpu.c) takes a batch as quads instead, four vertices each, and ignores the indices. */
+typedef struct {
+    SDL_Texture *texture;       // NULL for plain colours
+    SDL_GPUTexture *gpuTexture; // the same on the SDL_GPU renderer
+    SDL_Vertex *vertices;       // in the unit square
+    SDL_Vertex *screen;         // room for as many again, where the renderer places them
+    int vertexCount;
+    const int *indices;
+    int indexCount;
+} Clay_SDL3Batch;
+
+/* The frame's untextured rectangles, plain and rounded, and border edges, collected into one vertex and index
+ * buffer and drawn with one SDL_RenderGeometry call instead of a fill call each. It is flushed before anything
+ * drawn some other way (text, images, custom batches, arcs) and before the clip rect changes, so the painting
+ * order is kept. The buffers grow as needed and are kept from frame to frame. */
+typedef struct {
+    SDL_Vertex *vertices;
+    int *indices;
+    int vertexCount, indexCount;
+    int vertexCapacity, indexCapacity;
+} Clay_SDL3Geometry;
+
+typedef struct Clay_SDL3Gpu Clay_SDL3Gpu; // clay_renderer_SDL3_gpu.c
+
 typedef struct {
     SDL_Renderer *renderer;
+    Clay_SDL3Gpu *gpu;             // drawing instead of renderer (clay_renderer_SDL3_gpu.c), or NULL
     TTF_TextEngine *textEngine;
     TTF_Font **fonts;
+    Clay_SDL3TextCache *textCache; // made on first use, freed by SDL_Clay_DestroyTextCache
+    Clay_SDL3Geometry geometry;    // freed by SDL_Clay_DestroyGeometry
 } Clay_SDL3RendererData;
 
+static void SDL_Clay_FlushGeometry(Clay_SDL3RendererData *rendererData)
+{
+    Clay_SDL3Geometry *g = &rendererData->geometry;
+    if (g->indexCount == 0) return;
+    SDL_SetRenderDrawBlendMode(rendererData->renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(rendererData->renderer, NULL, g->vertices, g->vertexCount, g->indices, g->indexCount);
+    g->vertexCount = g->indexCount = 0;
+}
+
+// adds triangles to the batch, their indices relative to the first of their vertices; dropped if there's no memory
+static void SDL_Clay_AddGeometry(Clay_SDL3RendererData *rendererData, const SDL_Vertex *vertices, int vertexCount,
+                                 const int *indices, int indexCount)
+{
+    Clay_SDL3Geometry *g = &rendererData->geometry;
+    if (g->vertexCount + vertexCount > g->vertexCapacity) {
+        int capacity = SDL_max(g->vertexCapacity * 2, SDL_max(g->vertexCount + vertexCount, 1024));
+        SDL_Vertex *grown = SDL_realloc(g->vertices, (size_t)capacity * sizeof(SDL_Vertex));
+        if (!grown) return;
+        g->vertices = grown;
+        g->vertexCapacity = capacity;
+    }
+    if (g->indexCount + indexCount > g->indexCapacity) {
+        int capacity = SDL_max(g->indexCapacity * 2, SDL_max(g->indexCount + indexCount, 1536));
+        int *grown = SDL_realloc(g->indices, (size_t)capacity * sizeof(int));
+        if (!grown) return;
+        g->indices = grown;
+        g->indexCapacity = capacity;
+    }
+    SDL_memcpy(g->vertices + g->vertexCount, vertices, (size_t)vertexCount * sizeof(SDL_Vertex));
+    for (int i = 0; i < indexCount; i++) g->indices[g->indexCount++] = g->vertexCount + indices[i];
+    g->vertexCount += vertexCount;
+}
+
+static void SDL_Clay_AddRect(Clay_SDL3RendererData *rendererData, const SDL_FRect rect, const Clay_Color _color)
+{
+    const SDL_FColor color = { _color.r/255, _color.g/255, _color.b/255, _color.a/255 };
+    const SDL_Vertex vertices[4] = {
+        { {rect.x, rect.y}, color, {0, 0} }, { {rect.x + rect.w, rect.y}, color, {0, 0} },
+        { {rect.x + rect.w, rect.y + rect.h}, color, {0, 0} }, { {rect.x, rect.y + rect.h}, color, {0, 0} },
+    };
+    static const int indices[6] = { 0, 1, 2, 0, 2, 3 };
+    SDL_Clay_AddGeometry(rendererData, vertices, 4, indices, 6);
+}
+
+static void SDL_Clay_DestroyGeometry(Clay_SDL3RendererData *rendererData)
+{
+    SDL_free(rendererData->geometry.vertices);
+    SDL_free(rendererData->geometry.indices);
+    rendererData->geometry = (Clay_SDL3Geometry){ 0 };
+}
+
+static TTF_Font *SDL_Clay_SizedFont(Clay_SDL3TextCache *cache, TTF_Font **fonts, Uint16 fontId, Uint16 fontSize)
+{
+    for (int i = 0; i < cache->fontCount; i++)
+        if (cache->fonts[i].fontId == fontId && cache->fonts[i].fontSize == fontSize) return cache->fonts[i].font;
+    TTF_Font *font = cache->fontCount < CLAY_SDL3_SIZED_FONTS ? TTF_CopyFont(fonts[fontId]) : NULL;
+    if (!font) { // out of copies: the shared font, resized, still draws right
+        TTF_SetFontSize(fonts[fontId], fontSize);
+        return fonts[fontId];
+    }
+    TTF_SetFontSize(font, fontSize);
+    cache->fonts[cache->fontCount++] = (Clay_SDL3SizedFont){ fontId, fontSize, font };
+    return font;
+}
+
+// the text for the string in the font at the size, made if it isn't cached; NULL if it can't be made
+static Clay_SDL3CachedText *SDL_Clay_CachedText(Clay_SDL3RendererData *rendererData, Uint16 fontId, Uint16 fontSize,
+                                               const char *chars, int length)
+{
+    if (!rendererData->textCache) rendererData->textCache = SDL_calloc(1, sizeof(Clay_SDL3TextCache));
+    Clay_SDL3TextCache *cache = rendererData->textCache;
+    if (!cache) return NULL;
+    Uint64 hash = 0xCBF29CE484222325ULL ^ ((Uint64)fontId << 16 | fontSize); // FNV-1a
+    for (int i = 0; i < length; i++) hash = (hash ^ (Uint8)chars[i]) * 0x100000001B3ULL;
+    Clay_SDL3CachedText *set = cache->texts[hash % CLAY_SDL3_TEXT_SETS], *victim = &set[0];
+    for (int way = 0; way < CLAY_SDL3_TEXT_WAYS; way++) {
+        Clay_SDL3CachedText *entry = &set[way];
+        if (entry->text && entry->hash == hash && SDL_strlen(entry->text->text) == (size_t)length
+            && SDL_memcmp(entry->text->text, chars, (size_t)length) == 0) {
+            entry->lastUsed = ++cache->clock;
+            return entry;
+        }
+        if (!entry->text || (victim->text && entry->lastUsed < victim->lastUsed)) victim = entry;
+    }
+    TTF_Font *font = SDL_Clay_SizedFont(cache, rendererData->fonts, fontId, fontSize);
+    TTF_Text *text = TTF_CreateText(rendererData->textEngine, font, chars, (size_t)length);
+    if (!text) return NULL;
+    if (victim->text) TTF_DestroyText(victim->text);
+    *victim = (Clay_SDL3CachedText){ .hash = hash, .text = text, .lastUsed = ++cache->clock };
+    TTF_GetTextSize(text, &victim->width, &victim->height);
+    return victim;
+}
+
+// before the text engine and the fonts go
+static void SDL_Clay_DestroyTextCache(Clay_SDL3RendererData *rendererData)
+{
+    Clay_SDL3TextCache *cache = rendererData->textCache;
+    if (!cache) return;
+    for (int s = 0; s < CLAY_SDL3_TEXT_SETS; s++)
+        for (int way = 0; way < CLAY_SDL3_TEXT_WAYS; way++)
+            if (cache->texts[s][way].text) TTF_DestroyText(cache->texts[s][way].text);
+    for (int i = 0; i < cache->fontCount; i++) TTF_CloseFont(cache->fonts[i].font);
+    SDL_free(cache);
+    rendererData->textCache = NULL;
+}
+
 /* Global for convenience. Even in 4K this is enough for smooth curves (low radius or rect size coupled with
  * no AA or low resolution might make it appear as jagged curves) */
 static int NUM_CIRCLE_SEGMENTS = 16;
 
-//all rendering is performed by a single SDL call, avoiding multiple RenderRect + plumbing choice for circles.
+//added to the frame's geometry batch, avoiding multiple RenderRect + plumbing choice for circles.
 static void SDL_Clay_RenderFillRoundedRect(Clay_SDL3RendererData *rendererData, const SDL_FRect rect, const float cornerRadius, const Clay_Color _color) {
     const SDL_FColor color = { _color.r/255, _color.g/255, _color.b/255, _color.a/255 };
 
@@ -112,11 +275,12 @@ static void SDL_Clay_RenderFillRoundedRect(Clay_SDL3RendererData *rendererData,
     indices[indexCount++] = 3;
     indices[indexCount++] = vertexCount - 1; //LT
 
-    // Render everything
-    SDL_RenderGeometry(rendererData->renderer, NULL, vertices, vertexCount, indices, indexCount);
+    // Queue everything
+    SDL_Clay_AddGeometry(rendererData, vertices, vertexCount, indices, indexCount);
 }
 
 static void SDL_Clay_RenderArc(Clay_SDL3RendererData *rendererData, const SDL_FPoint center, const float radius, const float startAngle, const float endAngle, const float thickness, const Clay_Color color) {
+    SDL_Clay_FlushGeometry(rendererData); // drawn with lines, not the batch
     SDL_SetRenderDrawColor(rendererData->renderer, color.r, color.g, color.b, color.a);
 
     const float radStart = startAngle * (SDL_PI_F / 180.0f);
@@ -153,22 +317,20 @@ static void SDL_Clay_RenderClayCommands(Clay_SDL3RendererData *rendererData, Cla
         switch (rcmd->commandType) {
             case CLAY_RENDER_COMMAND_TYPE_RECTANGLE: {
                 Clay_RectangleRenderData *config = &rcmd->renderData.rectangle;
-                SDL_SetRenderDrawBlendMode(rendererData->renderer, SDL_BLENDMODE_BLEND);
-                SDL_SetRenderDrawColor(rendererData->renderer, config->backgroundColor.r, config->backgroundColor.g, config->backgroundColor.b, config->backgroundColor.a);
                 if (config->cornerRadius.topLeft > 0) {
                     SDL_Clay_RenderFillRoundedRect(rendererData, rect, config->cornerRadius.topLeft, config->backgroundColor);
                 } else {
-                    SDL_RenderFillRect(rendererData->renderer, &rect);
+                    SDL_Clay_AddRect(rendererData, rect, config->backgroundColor);
                 }
             } break;
             case CLAY_RENDER_COMMAND_TYPE_TEXT: {
                 Clay_TextRenderData *config = &rcmd->renderData.text;
-                TTF_Font *font = rendererData->fonts[config->fontId];
-                TTF_SetFontSize(font, config->fontSize);
-                TTF_Text *text = TTF_CreateText(rendererData->textEngine, font, config->stringContents.chars, config->stringContents.length);
-                TTF_SetTextColor(text, config->textColor.r, config->textColor.g, config->textColor.b, config->textColor.a);
-                TTF_DrawRendererText(text, rect.x, rect.y);
-                TTF_DestroyText(text);
+                SDL_Clay_FlushGeometry(rendererData);
+                Clay_SDL3CachedText *cached = SDL_Clay_CachedText(rendererData, config->fontId, config->fontSize,
+                                                                  config->stringContents.chars, config->stringContents.length);
+                if (!cached) break;
+                TTF_SetTextColor(cached->text, config->textColor.r, config->textColor.g, config->textColor.b, config->textColor.a);
+                TTF_DrawRendererText(cached->text, rect.x, rect.y);
             } break;
             case CLAY_RENDER_COMMAND_TYPE_BORDER: {
                 Clay_BorderRenderData *config = &rcmd->renderData.border;
@@ -181,33 +343,31 @@ static void SDL_Clay_RenderClayCommands(Clay_SDL3RendererData *rendererData, Cla
                     .bottomRight = SDL_min(config->cornerRadius.bottomRight, minRadius)
                 };
                 //edges
-                SDL_SetRenderDrawColor(rendererData->renderer, config->color.r, config->color.g, config->color.b, config->color.a);
                 if (config->width.left > 0) {
                     const float starting_y = rect.y + clampedRadii.topLeft;
                     const float length = rect.h - clampedRadii.topLeft - clampedRadii.bottomLeft;
                     SDL_FRect line = { rect.x - 1, starting_y, config->width.left, length };
-                    SDL_RenderFillRect(rendererData->renderer, &line);
+                    SDL_Clay_AddRect(rendererData, line, config->color);
                 }
                 if (config->width.right > 0) {
                     const float starting_x = rect.x + rect.w - (float)config->width.right + 1;
                     const float starting_y = rect.y + clampedRadii.topRight;
                     const float length = rect.h - clampedRadii.topRight - clampedRadii.bottomRight;
                     SDL_FRect line = { starting_x, starting_y, config->width.right, length };
-                    SDL_RenderFillRect(rendererData->renderer, &line);
+                    SDL_Clay_AddRect(rendererData, line, config->color);
                 }
                 if (config->width.top > 0) {
                     const float starting_x = rect.x + clampedRadii.topLeft;
                     const float length = rect.w - clampedRadii.topLeft - clampedRadii.topRight;
                     SDL_FRect line = { starting_x, rect.y - 1, length, config->width.top };
-                    SDL_RenderFillRect(rendererData->renderer, &line);
+                    SDL_Clay_AddRect(rendererData, line, config->color);
                 }
                 if (config->width.bottom > 0) {
                     const float starting_x = rect.x + clampedRadii.bottomLeft;
                     const float starting_y = rect.y + rect.h - (float)config->width.bottom + 1;
                     const float length = rect.w - clampedRadii.bottomLeft - clampedRadii.bottomRight;
                     SDL_FRect line = { starting_x, starting_y, length, config->width.bottom };
-                    SDL_SetRenderDrawColor(rendererData->renderer, config->color.r, config->color.g, config->color.b, config->color.a);
-                    SDL_RenderFillRect(rendererData->renderer, &line);
+                    SDL_Clay_AddRect(rendererData, line, config->color);
                 }
                 //corners
                 if (config->cornerRadius.topLeft > 0) {
@@ -237,6 +397,7 @@ static void SDL_Clay_RenderClayCommands(Clay_SDL3RendererData *rendererData, Cla
 
             } break;
             case CLAY_RENDER_COMMAND_TYPE_SCISSOR_START: {
+                SDL_Clay_FlushGeometry(rendererData);
                 Clay_BoundingBox boundingBox = rcmd->boundingBox;
                 currentClippingRectangle = (SDL_Rect) {
                         .x = boundingBox.x,
@@ -248,11 +409,25 @@ static void SDL_Clay_RenderClayCommands(Clay_SDL3RendererData *rendererData, Cla
                 break;
             }
             case CLAY_RENDER_COMMAND_TYPE_SCISSOR_END: {
+                SDL_Clay_FlushGeometry(rendererData);
                 SDL_SetRenderClipRect(rendererData->renderer, NULL);
                 break;
             }
+            case CLAY_RENDER_COMMAND_TYPE_CUSTOM: {
+                Clay_SDL3Batch *batch = (Clay_SDL3Batch *)rcmd->renderData.custom.customData;
+                if (!batch || batch->indexCount == 0) break;
+                SDL_Clay_FlushGeometry(rendererData);
+                for (int v = 0; v < batch->vertexCount; v++) {
+                    batch->screen[v] = batch->vertices[v];
+                    batch->screen[v].position.x = bounding_box.x + batch->vertices[v].position.x * bounding_box.width;
+                    batch->screen[v].position.y = bounding_box.y + batch->vertices[v].position.y * bounding_box.height;
+                }
+                SDL_RenderGeometry(rendererData->renderer, batch->texture, batch->screen, batch->vertexCount,
+                                   batch->indices, batch->indexCount);
+            } break;
             case CLAY_RENDER_COMMAND_TYPE_IMAGE: {
                 SDL_Texture *texture = (SDL_Texture *)rcmd->renderData.image.imageData;
+                SDL_Clay_FlushGeometry(rendererData);
                 const SDL_FRect dest = { rect.x, rect.y, rect.w, rect.h };
                 SDL_RenderTexture(rendererData->renderer, texture, NULL, &dest);
                 break;
@@ -261,4 +436,5 @@ static void SDL_Clay_RenderClayCommands(Clay_SDL3RendererData *rendererData, Cla
                 SDL_Log("Unknown render command type: %d", rcmd->commandType);
         }
     }
+    SDL_Clay_FlushGeometry(rendererData);
 }
@@ -0,0 +1,457 @@
+/* The Clay renderer on SDL's GPU API instead of SDL_Renderer, built with CHESS_GPU_RENDERER and picked with
+ * `--renderer sdlgpu`. Every rectangle, rounded rectangle, border, glyph and custom-batch quad of a frame is
+ * one instance (Clay_SDL3GpuInstance), collected in painting order into one array; SDL_Clay_GpuPresent uploads the
+ * lot in one transfer to one vertex buffer and draws it with one call a run of instances that share a texture and a
+ * clip rect. The shaders (shaders/clay_quad.vert and .frag, SPIR-V built into this file) lay each instance out as a
+ * quad and cut rounded corners and borders by their distance from the edge, so nothing is tessellated on the CPU.
+ * Needs a device that takes SPIR-V (Vulkan); with none the caller keeps to SDL_Renderer. Text goes through
+ * SDL_ttf's GPU text engine and the same text cache as clay_renderer_SDL3.c, which has to be included first. There
+ * are no image elements: the GUI makes none, its pieces go through the board's custom batch. */
+
+static const Uint32 CLAY_SDL3_GPU_QUAD_VERT[] =
+#include "clay_quad.vert.inc"
+;
+static const Uint32 CLAY_SDL3_GPU_QUAD_FRAG[] =
+#include "clay_quad.frag.inc"
+;
+
+#define CLAY_SDL3_GPU_MIN_INSTANCES 1024
+
+// one quad, the vertex shader's per-instance input; in the layout's units, y down
+typedef struct {
+    float rect[4];   // x, y, width, height
+    float uv[4];     // the texture's top left and bottom right
+    float color[4];
+    float radii[4];  // top left, top right, bottom right, bottom left
+    float border[4]; // left, right, top, bottom; all 0 for a filled shape
+} Clay_SDL3GpuInstance;
+
+// instances drawn with one call
+typedef struct {
+    SDL_GPUTexture *texture;
+    SDL_Rect clip;
+    bool clipped;
+    Uint32 first, count;
+} Clay_SDL3GpuRun;
+
+struct Clay_SDL3Gpu {
+    SDL_GPUDevice *device;
+    SDL_Window *window;
+    SDL_GPUGraphicsPipeline *pipeline;
+    SDL_GPUSampler *sampler;
+    SDL_GPUTexture *white;            // one texel, for the shapes without a texture
+    SDL_GPUBuffer *instanceBuffer;    // the frame's instances, and the transfer buffer they go up through,
+    SDL_GPUTransferBuffer *upload;    // both room for bufferCapacity; grown as needed and kept
+    Uint32 bufferCapacity;
+    Clay_SDL3GpuInstance *instances;  // the frame so far
+    int instanceCount, instanceCapacity;
+    Clay_SDL3GpuRun *runs;
+    int runCount, runCapacity;
+    SDL_Rect clip;                    // between a scissor start and its end
+    bool clipped;
+};
+
+// room for count + 1 elements of size in *array; false if there's no memory, the array as it was
+static bool SDL_Clay_GpuReserve(void **array, int *capacity, int count, size_t size)
+{
+    if (count < *capacity) return true;
+    int grown = SDL_max(*capacity * 2, CLAY_SDL3_GPU_MIN_INSTANCES);
+    void *memory = SDL_realloc(*array, (size_t)grown * size);
+    if (!memory) return false;
+    *array = memory;
+    *capacity = grown;
+    return true;
+}
+
+// appended to the frame, in a new run when the texture or the clip rect changes; dropped if there's no memory
+static void SDL_Clay_GpuAdd(Clay_SDL3Gpu *gpu, SDL_GPUTexture *texture, const Clay_SDL3GpuInstance *instance)
+{
+    if (!texture) texture = gpu->white;
+    Clay_SDL3GpuRun *run = gpu->runCount ? &gpu->runs[gpu->runCount - 1] : NULL;
+    if (!run || run->texture != texture || run->clipped != gpu->clipped
+        || (gpu->clipped && SDL_memcmp(&run->clip, &gpu->clip, sizeof(SDL_Rect)) != 0)) {
+        if (!SDL_Clay_GpuReserve((void **)&gpu->runs, &gpu->runCapacity, gpu->runCount, sizeof(Clay_SDL3GpuRun))) return;
+        run = &gpu->runs[gpu->runCount++];
+        *run = (Clay_SDL3GpuRun){ texture, gpu->clip, gpu->clipped, (Uint32)gpu->instanceCount, 0 };
+    }
+    if (!SDL_Clay_GpuReserve((void **)&gpu->instances, &gpu->instanceCapacity, gpu->instanceCount,
+                             sizeof(Clay_SDL3GpuInstance))) return;
+    gpu->instances[gpu->instanceCount++] = *instance;
+    run->count++;
+}
+
+static void SDL_Clay_GpuAddShape(Clay_SDL3Gpu *gpu, const SDL_FRect rect, const Clay_Color color,
+                                 const Clay_CornerRadius radius, const float border[4])
+{
+    Clay_SDL3GpuInstance instance = {
+        .rect = { rect.x, rect.y, rect.w, rect.h }, .uv = { 0, 0, 1, 1 },
+        .color = { color.r / 255, color.g / 255, color.b / 255, color.a / 255 },
+        .radii = { radius.topLeft, radius.topRight, radius.bottomRight, radius.bottomLeft },
+    };
+    if (border) SDL_memcpy(instance.border, border, sizeof(instance.border));
+    SDL_Clay_GpuAdd(gpu, NULL, &instance);
+}
+
+/* A glyph: four of the text engine's vertices, relative to the text's top left with y up. The texture coordinates
+ * are taken from the corners they're on, whichever order the engine wrote them in. */
+static void SDL_Clay_GpuAddGlyph(Clay_SDL3Gpu *gpu, const TTF_GPUAtlasDrawSequence *sequence, int first,
+                                 float x, float y, const float color[4])
+{
+    const SDL_FPoint *xy = sequence->xy + first, *uv = sequence->uv + first;
+    float minX = xy[0].x, maxX = xy[0].x, minY = xy[0].y, maxY = xy[0].y;
+    for (int k = 1; k < 4; k++) {
+        minX = SDL_min(minX, xy[k].x), maxX = SDL_max(maxX, xy[k].x);
+        minY = SDL_min(minY, xy[k].y), maxY = SDL_max(maxY, xy[k].y);
+    }
+    SDL_FPoint topLeft = uv[0], bottomRight = uv[2];
+    for (int k = 0; k < 4; k++) {
+        if (xy[k].x == minX && xy[k].y == maxY) topLeft = uv[k];
+        if (xy[k].x == maxX && xy[k].y == minY) bottomRight = uv[k];
+    }
+    Clay_SDL3GpuInstance instance = {
+        .rect = { x + minX, y - maxY, maxX - minX, maxY - minY },
+        .uv = { topLeft.x, topLeft.y, bottomRight.x, bottomRight.y },
+    };
+    SDL_memcpy(instance.color, color, sizeof(instance.color));
+    SDL_Clay_GpuAdd(gpu, sequence->atlas_texture, &instance);
+}
+
+// a texture the instances can sample, from any surface; NULL (SDL_GetError) if it can't be made
+static SDL_GPUTexture *SDL_Clay_GpuCreateTexture(Clay_SDL3Gpu *gpu, SDL_Surface *surface)
+{
+    SDL_Surface *rgba = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+    if (!rgba) return NULL;
+    const Uint32 bytes = (Uint32)(rgba->pitch * rgba->h);
+    SDL_GPUTexture *texture = SDL_CreateGPUTexture(gpu->device, &(SDL_GPUTextureCreateInfo){
+        .type = SDL_GPU_TEXTURETYPE_2D, .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER, .width = (Uint32)rgba->w, .height = (Uint32)rgba->h,
+        .layer_count_or_depth = 1, .num_levels = 1 });
+    SDL_GPUTransferBuffer *transfer = texture ? SDL_CreateGPUTransferBuffer(gpu->device,
+        &(SDL_GPUTransferBufferCreateInfo){ .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, .size = bytes }) : NULL;
+    void *mapped = transfer ? SDL_MapGPUTransferBuffer(gpu->device, transfer, false) : NULL;
+    SDL_GPUCommandBuffer *cmd = mapped ? SDL_AcquireGPUCommandBuffer(gpu->device) : NULL;
+    if (mapped) {
+        SDL_memcpy(mapped, rgba->pixels, bytes);
+        SDL_UnmapGPUTransferBuffer(gpu->device, transfer);
+    }
+    if (cmd) {
+        SDL_GPUCopyPass *copy = SDL_BeginGPUCopyPass(cmd);
+        SDL_UploadToGPUTexture(copy,
+            &(SDL_GPUTextureTransferInfo){ .transfer_buffer = transfer, .pixels_per_row = (Uint32)(rgba->pitch / 4) },
+            &(SDL_GPUTextureRegion){ .texture = texture, .w = (Uint32)rgba->w, .h = (Uint32)rgba->h, .d = 1 }, false);
+        SDL_EndGPUCopyPass(copy);
+    }
+    if (!cmd || !SDL_SubmitGPUCommandBuffer(cmd)) {
+        SDL_ReleaseGPUTexture(gpu->device, texture); // NULL is fine
+        texture = NULL;
+    }
+    SDL_ReleaseGPUTransferBuffer(gpu->device, transfer);
+    SDL_DestroySurface(rgba);
+    return texture;
+}
+
+static void SDL_Clay_GpuDestroyTexture(Clay_SDL3Gpu *gpu, SDL_GPUTexture *texture)
+{
+    if (gpu && texture) SDL_ReleaseGPUTexture(gpu->device, texture);
+}
+
+static void SDL_Clay_GpuDestroy(Clay_SDL3Gpu *gpu)
+{
+    if (!gpu) return;
+    if (gpu->device) {
+        SDL_ReleaseGPUBuffer(gpu->device, gpu->instanceBuffer);
+        SDL_ReleaseGPUTransferBuffer(gpu->device, gpu->upload);
+        SDL_ReleaseGPUTexture(gpu->device, gpu->white);
+        SDL_ReleaseGPUSampler(gpu->device, gpu->sampler);
+        SDL_ReleaseGPUGraphicsPipeline(gpu->device, gpu->pipeline);
+        if (gpu->window) SDL_ReleaseWindowFromGPUDevice(gpu->device, gpu->window);
+        SDL_DestroyGPUDevice(gpu->device);
+    }
+    SDL_free(gpu->instances);
+    SDL_free(gpu->runs);
+    SDL_free(gpu);
+}
+
+static SDL_GPUShader *SDL_Clay_GpuShader(SDL_GPUDevice *device, const Uint32 *code, size_t size,
+                                         SDL_GPUShaderStage stage)
+{
+    return SDL_CreateGPUShader(device, &(SDL_GPUShaderCreateInfo){
+        .code_size = size, .code = (const Uint8 *)code, .entrypoint = "main", .format = SDL_GPU_SHADERFORMAT_SPIRV,
+        .stage = stage, .num_samplers = stage == SDL_GPU_SHADERSTAGE_FRAGMENT ? 1 : 0,
+        .num_uniform_buffers = stage == SDL_GPU_SHADERSTAGE_VERTEX ? 1 : 0 });
+}
+
+// a device that draws into the window, and its one pipeline; NULL (SDL_GetError) when there's none that takes SPIR-V
+static Clay_SDL3Gpu *SDL_Clay_GpuCreate(SDL_Window *window)
+{
+    Clay_SDL3Gpu *gpu = SDL_calloc(1, sizeof(Clay_SDL3Gpu));
+    if (!gpu) return NULL;
+    gpu->device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, false, NULL);
+    if (!gpu->device || !SDL_ClaimWindowForGPUDevice(gpu->device, window)) {
+        SDL_Clay_GpuDestroy(gpu);
+        return NULL;
+    }
+    gpu->window = window;
+
+    SDL_GPUShader *vertex = SDL_Clay_GpuShader(gpu->device, CLAY_SDL3_GPU_QUAD_VERT, sizeof(CLAY_SDL3_GPU_QUAD_VERT),
+                                               SDL_GPU_SHADERSTAGE_VERTEX);
+    SDL_GPUShader *fragment = SDL_Clay_GpuShader(gpu->device, CLAY_SDL3_GPU_QUAD_FRAG, sizeof(CLAY_SDL3_GPU_QUAD_FRAG),
+                                                 SDL_GPU_SHADERSTAGE_FRAGMENT);
+    SDL_GPUVertexAttribute attributes[5];
+    for (Uint32 a = 0; a < 5; a++)
+        attributes[a] = (SDL_GPUVertexAttribute){ .location = a, .buffer_slot = 0,
+                                                  .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4, .offset = a * 4 * sizeof(float) };
+    const SDL_GPUColorTargetDescription target = {
+        .format = SDL_GetGPUSwapchainTextureFormat(gpu->device, window),
+        .blend_state = { // SDL_BLENDMODE_BLEND, as the renderer draws
+            .src_color_blendfactor = SDL_GPU_BLENDFACTOR_SRC_ALPHA, .dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+            .color_blend_op = SDL_GPU_BLENDOP_ADD,
+            .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE, .dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+            .alpha_blend_op = SDL_GPU_BLENDOP_ADD, .enable_blend = true },
+    };
+    if (vertex && fragment) {
+        gpu->pipeline = SDL_CreateGPUGraphicsPipeline(gpu->device, &(SDL_GPUGraphicsPipelineCreateInfo){
+            .vertex_shader = vertex, .fragment_shader = fragment,
+            .vertex_input_state = {
+                .vertex_buffer_descriptions = &(SDL_GPUVertexBufferDescription){
+                    .slot = 0, .pitch = sizeof(Clay_SDL3GpuInstance), .input_rate = SDL_GPU_VERTEXINPUTRATE_INSTANCE },
+                .num_vertex_buffers = 1, .vertex_attributes = attributes, .num_vertex_attributes = 5 },
+            .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
+            .rasterizer_state = { .fill_mode = SDL_GPU_FILLMODE_FILL, .cull_mode = SDL_GPU_CULLMODE_NONE },
+            .target_info = { .color_target_descriptions = &target, .num_color_targets = 1 } });
+    }
+    if (vertex) SDL_ReleaseGPUShader(gpu->device, vertex);
+    if (fragment) SDL_ReleaseGPUShader(gpu->device, fragment);
+    gpu->sampler = SDL_CreateGPUSampler(gpu->device, &(SDL_GPUSamplerCreateInfo){
+        .min_filter = SDL_GPU_FILTER_LINEAR, .mag_filter = SDL_GPU_FILTER_LINEAR,
+        .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST, .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE,
+        .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE, .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_CLAMP_TO_EDGE });
+    SDL_Surface *white = SDL_CreateSurface(1, 1, SDL_PIXELFORMAT_RGBA32);
+    if (white) {
+        SDL_FillSurfaceRect(white, NULL, SDL_MapSurfaceRGBA(white, 255, 255, 255, 255));
+        gpu->white = SDL_Clay_GpuCreateTexture(gpu, white);
+        SDL_DestroySurface(white);
+    }
+    if (!gpu->pipeline || !gpu->sampler || !gpu->white) {
+        SDL_Clay_GpuDestroy(gpu);
+        return NULL;
+    }
+    return gpu;
+}
+
+// the frame's instances, to go up with SDL_Clay_GpuPresent; the same commands clay_renderer_SDL3.c takes
+static void SDL_Clay_GpuRenderClayCommands(Clay_SDL3RendererData *rendererData, Clay_RenderCommandArray *rcommands)
+{
+    Clay_SDL3Gpu *gpu = rendererData->gpu;
+    for (size_t i = 0; i < rcommands->length; i++) {
+        Clay_RenderCommand *rcmd = Clay_RenderCommandArray_Get(rcommands, i);
+        const Clay_BoundingBox bounding_box = rcmd->boundingBox;
+        const SDL_FRect rect = { (int)bounding_box.x, (int)bounding_box.y, (int)bounding_box.width, (int)bounding_box.height };
+
+        switch (rcmd->commandType) {
+            case CLAY_RENDER_COMMAND_TYPE_RECTANGLE: {
+                Clay_RectangleRenderData *config = &rcmd->renderData.rectangle;
+                SDL_Clay_GpuAddShape(gpu, rect, config->backgroundColor, config->cornerRadius, NULL);
+            } break;
+            case CLAY_RENDER_COMMAND_TYPE_TEXT: {
+                Clay_TextRenderData *config = &rcmd->renderData.text;
+                Clay_SDL3CachedText *cached = SDL_Clay_CachedText(rendererData, config->fontId, config->fontSize,
+                                                                  config->stringContents.chars, config->stringContents.length);
+                if (!cached) break;
+                const float color[4] = { config->textColor.r / 255, config->textColor.g / 255,
+                                         config->textColor.b / 255, config->textColor.a / 255 };
+                for (TTF_GPUAtlasDrawSequence *sequence = TTF_GetGPUTextDrawData(cached->text); sequence; sequence = sequence->next)
+                    for (int v = 0; v + 4 <= sequence->num_vertices; v += 4) // a quad a glyph
+                        SDL_Clay_GpuAddGlyph(gpu, sequence, v, rect.x, rect.y, color);
+            } break;
+            case CLAY_RENDER_COMMAND_TYPE_BORDER: {
+                Clay_BorderRenderData *config = &rcmd->renderData.border;
+                const float border[4] = { config->width.left, config->width.right, config->width.top, config->width.bottom };
+                if (border[0] + border[1] + border[2] + border[3] > 0)
+                    SDL_Clay_GpuAddShape(gpu, rect, config->color, config->cornerRadius, border);
+            } break;
+            case CLAY_RENDER_COMMAND_TYPE_SCISSOR_START: {
+                gpu->clip = (SDL_Rect){ (int)bounding_box.x, (int)bounding_box.y, (int)bounding_box.width, (int)bounding_box.height };
+                gpu->clipped = true;
+            } break;
+            case CLAY_RENDER_COMMAND_TYPE_SCISSOR_END: {
+                gpu->clipped = false;
+            } break;
+            case CLAY_RENDER_COMMAND_TYPE_CUSTOM: {
+                // a quad every four vertices, corners in addBoardQuad's order: top left, top right, bottom right, bottom left
+                Clay_SDL3Batch *batch = (Clay_SDL3Batch *)rcmd->renderData.custom.customData;
+                if (!batch) break;
+                for (int v = 0; v + 4 <= batch->vertexCount; v += 4) {
+                    const SDL_Vertex *topLeft = &batch->vertices[v], *bottomRight = &batch->vertices[v + 2];
+                    Clay_SDL3GpuInstance instance = {
+                        .rect = { bounding_box.x + topLeft->position.x * bounding_box.width,
+                                  bounding_box.y + topLeft->position.y * bounding_box.height,
+                                  (bottomRight->position.x - topLeft->position.x) * bounding_box.width,
+                                  (bottomRight->position.y - topLeft->position.y) * bounding_box.height },
+                        .uv = { topLeft->tex_coord.x, topLeft->tex_coord.y, bottomRight->tex_coord.x, bottomRight->tex_coord.y },
+                        .color = { topLeft->color.r, topLeft->color.g, topLeft->color.b, topLeft->color.a },
+                    };
+                    SDL_Clay_GpuAdd(gpu, batch->gpuTexture, &instance);
+                }
+            } break;
+            default:
+                SDL_Log("Unknown render command type: %d", rcmd->commandType);
+        }
+    }
+}
+
+// the surface format with a swapchain format's bytes, SDL_PIXELFORMAT_UNKNOWN for one a capture can't take
+static SDL_PixelFormat SDL_Clay_GpuPixelFormat(SDL_GPUTextureFormat format)
+{
+    switch (format) {
+        case SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM:
+        case SDL_GPU_TEXTUREFORMAT_B8G8R8A8_UNORM_SRGB: return SDL_PIXELFORMAT_BGRA32;
+        case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM:
+        case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB: return SDL_PIXELFORMAT_RGBA32;
+        default: return SDL_PIXELFORMAT_UNKNOWN;
+    }
+}
+
+/* The frame drawn into a texture of its own rather than the swapchain's, so it can be read back: blitted to the
+ * swapchain and downloaded, the command buffer waited on and the pixels copied into a new surface. */
+typedef struct {
+    SDL_GPUTexture *target;
+    SDL_GPUTransferBuffer *download;
+    SDL_PixelFormat format;
+} Clay_SDL3GpuCapture;
+
+static bool SDL_Clay_GpuStartCapture(Clay_SDL3Gpu *gpu, Uint32 width, Uint32 height, Clay_SDL3GpuCapture *capture)
+{
+    const SDL_GPUTextureFormat format = SDL_GetGPUSwapchainTextureFormat(gpu->device, gpu->window);
+    capture->format = SDL_Clay_GpuPixelFormat(format);
+    if (capture->format == SDL_PIXELFORMAT_UNKNOWN) return SDL_SetError("can't read back swapchain format %d", (int)format);
+    capture->target = SDL_CreateGPUTexture(gpu->device, &(SDL_GPUTextureCreateInfo){
+        .type = SDL_GPU_TEXTURETYPE_2D, .format = format,
+        .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER, .width = width, .height = height,
+        .layer_count_or_depth = 1, .num_levels = 1 });
+    capture->download = capture->target ? SDL_CreateGPUTransferBuffer(gpu->device,
+        &(SDL_GPUTransferBufferCreateInfo){ .usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD, .size = width * height * 4 }) : NULL;
+    return capture->download != NULL;
+}
+
+static void SDL_Clay_GpuEndCapture(Clay_SDL3Gpu *gpu, Clay_SDL3GpuCapture *capture)
+{
+    SDL_ReleaseGPUTransferBuffer(gpu->device, capture->download); // NULL is fine
+    SDL_ReleaseGPUTexture(gpu->device, capture->target);
+    SDL_zerop(capture);
+}
+
+// the capture's pixels, once the command buffer that downloaded them is done; NULL (SDL_GetError) if they aren't there
+static SDL_Surface *SDL_Clay_GpuCapturedSurface(Clay_SDL3Gpu *gpu, SDL_GPUFence *fence, Uint32 width, Uint32 height,
+                                               const Clay_SDL3GpuCapture *capture)
+{
+    if (!fence) return NULL;
+    bool done = SDL_WaitForGPUFences(gpu->device, true, &fence, 1);
+    SDL_ReleaseGPUFence(gpu->device, fence);
+    SDL_Surface *surface = done ? SDL_CreateSurface((int)width, (int)height, capture->format) : NULL;
+    const Uint8 *pixels = surface ? SDL_MapGPUTransferBuffer(gpu->device, capture->download, false) : NULL;
+    if (!pixels) {
+        SDL_DestroySurface(surface);
+        return NULL;
+    }
+    for (Uint32 y = 0; y < height; y++)
+        SDL_memcpy((Uint8 *)surface->pixels + y * surface->pitch, pixels + y * width * 4, width * 4);
+    SDL_UnmapGPUTransferBuffer(gpu->device, capture->download);
+    return surface;
+}
+
+/* The frame collected since the last one: its instances uploaded, drawn over the clear colour a run at a time, and
+ * presented once the window has a swapchain image to give (vsync waits here). Nothing is drawn while the window is
+ * minimised. With capture, the frame is also read back into a new surface there, the caller's to free; NULL if it
+ * couldn't be (or the window is minimised). false (SDL_GetError) if the GPU failed; the frame is dropped either way. */
+static bool SDL_Clay_GpuPresent(Clay_SDL3Gpu *gpu, SDL_FColor clearColor, SDL_Surface **capture)
+{
+    if (capture) *capture = NULL;
+    const int instanceCount = gpu->instanceCount, runCount = gpu->runCount;
+    gpu->instanceCount = gpu->runCount = 0;
+    gpu->clipped = false;
+    SDL_GPUCommandBuffer *cmd = SDL_AcquireGPUCommandBuffer(gpu->device);
+    if (!cmd) return false;
+    SDL_GPUTexture *swapchain = NULL;
+    Uint32 width = 0, height = 0;
+    if (!SDL_WaitAndAcquireGPUSwapchainTexture(cmd, gpu->window, &swapchain, &width, &height)) {
+        SDL_CancelGPUCommandBuffer(cmd);
+        return false;
+    }
+    if (!swapchain) return SDL_SubmitGPUCommandBuffer(cmd);
+    Clay_SDL3GpuCapture readback = { 0 };
+    if (capture && !SDL_Clay_GpuStartCapture(gpu, width, height, &readback)) {
+        SDL_Log("SDL_GPU: can't capture the frame: %s", SDL_GetError());
+        SDL_Clay_GpuEndCapture(gpu, &readback);
+    }
+    SDL_GPUTexture *target = readback.download ? readback.target : swapchain;
+
+    if ((Uint32)instanceCount > gpu->bufferCapacity) { // the old ones go once the frames using them are done
+        SDL_ReleaseGPUBuffer(gpu->device, gpu->instanceBuffer);
+        SDL_ReleaseGPUTransferBuffer(gpu->device, gpu->upload);
+        gpu->bufferCapacity = SDL_max((Uint32)instanceCount, SDL_max(gpu->bufferCapacity * 2, CLAY_SDL3_GPU_MIN_INSTANCES));
+        const Uint32 bytes = gpu->bufferCapacity * (Uint32)sizeof(Clay_SDL3GpuInstance);
+        gpu->instanceBuffer = SDL_CreateGPUBuffer(gpu->device,
+            &(SDL_GPUBufferCreateInfo){ .usage = SDL_GPU_BUFFERUSAGE_VERTEX, .size = bytes });
+        gpu->upload = SDL_CreateGPUTransferBuffer(gpu->device,
+            &(SDL_GPUTransferBufferCreateInfo){ .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD, .size = bytes });
+        if (!gpu->instanceBuffer || !gpu->upload) gpu->bufferCapacity = 0;
+    }
+    bool draw = instanceCount > 0 && gpu->bufferCapacity > 0;
+    if (draw) { // cycled, so the frame before can still be drawing from the last upload
+        const Uint32 bytes = (Uint32)instanceCount * (Uint32)sizeof(Clay_SDL3GpuInstance);
+        void *mapped = SDL_MapGPUTransferBuffer(gpu->device, gpu->upload, true);
+        if (mapped) {
+            SDL_memcpy(mapped, gpu->instances, bytes);
+            SDL_UnmapGPUTransferBuffer(gpu->device, gpu->upload);
+            SDL_GPUCopyPass *copy = SDL_BeginGPUCopyPass(cmd);
+            SDL_UploadToGPUBuffer(copy, &(SDL_GPUTransferBufferLocation){ gpu->upload, 0 },
+                                  &(SDL_GPUBufferRegion){ gpu->instanceBuffer, 0, bytes }, true);
+            SDL_EndGPUCopyPass(copy);
+        }
+        draw = mapped != NULL;
+    }
+
+    SDL_GPURenderPass *pass = SDL_BeginGPURenderPass(cmd, &(SDL_GPUColorTargetInfo){
+        .texture = target, .clear_color = clearColor, .load_op = SDL_GPU_LOADOP_CLEAR,
+        .store_op = SDL_GPU_STOREOP_STORE }, 1, NULL);
+    if (pass && draw) {
+        int windowW = 0, windowH = 0;
+        SDL_GetWindowSize(gpu->window, &windowW, &windowH);
+        const float screen[2] = { (float)SDL_max(windowW, 1), (float)SDL_max(windowH, 1) };
+        const float scaleX = (float)width / screen[0], scaleY = (float)height / screen[1]; // the layout's units to pixels
+        SDL_BindGPUGraphicsPipeline(pass, gpu->pipeline);
+        SDL_PushGPUVertexUniformData(cmd, 0, screen, sizeof(screen));
+        for (int r = 0; r < runCount; r++) {
+            const Clay_SDL3GpuRun *run = &gpu->runs[r];
+            const SDL_Rect target = { 0, 0, (int)width, (int)height };
+            SDL_Rect scissor = target;
+            if (run->clipped) {
+                const SDL_Rect clip = { (int)(run->clip.x * scaleX), (int)(run->clip.y * scaleY),
+                                        (int)SDL_ceilf(run->clip.w * scaleX), (int)SDL_ceilf(run->clip.h * scaleY) };
+                if (!SDL_GetRectIntersection(&target, &clip, &scissor)) continue; // clipped away
+            }
+            SDL_SetGPUScissor(pass, &scissor);
+            SDL_BindGPUVertexBuffers(pass, 0, &(SDL_GPUBufferBinding){
+                gpu->instanceBuffer, run->first * (Uint32)sizeof(Clay_SDL3GpuInstance) }, 1);
+            SDL_BindGPUFragmentSamplers(pass, 0, &(SDL_GPUTextureSamplerBinding){ run->texture, gpu->sampler }, 1);
+            SDL_DrawGPUPrimitives(pass, 6, run->count, 0, 0);
+        }
+    }
+    if (pass) SDL_EndGPURenderPass(pass);
+    if (target == swapchain) return SDL_SubmitGPUCommandBuffer(cmd) && pass != NULL;
+
+    SDL_GPUCopyPass *copy = SDL_BeginGPUCopyPass(cmd);
+    SDL_DownloadFromGPUTexture(copy, &(SDL_GPUTextureRegion){ .texture = target, .w = width, .h = height, .d = 1 },
+                               &(SDL_GPUTextureTransferInfo){ .transfer_buffer = readback.download });
+    SDL_EndGPUCopyPass(copy);
+    SDL_BlitGPUTexture(cmd, &(SDL_GPUBlitInfo){
+        .source = { .texture = target, .w = width, .h = height },
+        .destination = { .texture = swapchain, .w = width, .h = height },
+        .load_op = SDL_GPU_LOADOP_DONT_CARE, .filter = SDL_GPU_FILTER_NEAREST });
+    SDL_GPUFence *fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+    if (pass) *capture = SDL_Clay_GpuCapturedSurface(gpu, fence, width, height, &readback);
+    else if (fence) SDL_ReleaseGPUFence(gpu->device, fence);
+    SDL_Clay_GpuEndCapture(gpu, &readback);
+    return fence != NULL && pass != NULL;
+}
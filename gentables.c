@@ -0,0 +1,127 @@
+// TABLE GENERATOR: writes tables.h, the engine's lookup tables as const data (the tables build task)
+
+/* `gentables [FILE]` builds the tables the way engineInitTables would, with the portable magic-bitboard layout
+   (PEXT, where the CPU has it, re-indexes them at startup), and prints them as C that engine.c includes when it
+   finds the file: Zobrist keys, the cuckoo tables of reversible moves, leaper attacks, the slider
+   magics and their attack tables (the rays in a CHESS_LOW_MEMORY build), BETWEEN, the piece-square values of both
+   colours, the phase weights and the KPK bitbase. The engine is compiled into this file with GENERATING_TABLES set, so it ignores any tables.h already
+   there and builds everything from scratch. */
+#define GENERATING_TABLES
+#include "engine.c"
+#include <SDL3/SDL_main.h>
+
+#define TABLES_PER_LINE 4 // values a line
+
+static bool tablesOk = true;
+
+static void emit(SDL_IOStream* out, const char* fmt, ...) SDL_PRINTF_VARARG_FUNC(2);
+static void emit(SDL_IOStream* out, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (!SDL_IOvprintf(out, fmt, ap)) tablesOk = false;
+    va_end(ap);
+}
+
+// a row of 64-bit values, wrapped; `indent` spaces before each line
+static void emitUint64s(SDL_IOStream* out, const Uint64* values, int count, int indent) {
+    for (int i = 0; i < count; i++) {
+        if (i % TABLES_PER_LINE == 0) emit(out, "%*s", indent, "");
+        emit(out, "0x%016llxULL,%s", (unsigned long long)values[i], i % TABLES_PER_LINE == TABLES_PER_LINE - 1 || i == count - 1 ? "\n" : " ");
+    }
+}
+
+static void emitInts(SDL_IOStream* out, const Sint32* values, int count, int indent) {
+    for (int i = 0; i < count; i++) {
+        if (i % 8 == 0) emit(out, "%*s", indent, "");
+        emit(out, "%d,%s", values[i], i % 8 == 7 || i == count - 1 ? "\n" : " ");
+    }
+}
+
+static void emitUint64Table(SDL_IOStream* out, const char* declaration, const Uint64* values, int count) {
+    emit(out, "TABLE Uint64 %s = {\n", declaration);
+    emitUint64s(out, values, count, 4);
+    emit(out, "};\n\n");
+}
+
+// rows of 64-bit values, one brace each
+static void emitUint64Rows(SDL_IOStream* out, const char* type, const char* declaration, const Uint64* values, int rows, int columns) {
+    emit(out, "TABLE %s %s = {\n", type, declaration);
+    for (int r = 0; r < rows; r++) {
+        emit(out, "    {\n");
+        emitUint64s(out, values + (size_t)r * columns, columns, 8);
+        emit(out, "    },\n");
+    }
+    emit(out, "};\n\n");
+}
+
+#if !defined(CHESS_LOW_MEMORY)
+static void emitMagics(SDL_IOStream* out, const char* name, const SliderMagic magics[64], const Bitboard* table, const char* tableName) {
+    emit(out, "static SliderMagic %s[64] = {\n", name);
+    for (int sq = 0; sq < 64; sq++)
+        emit(out, "    { 0x%016llxULL, 0x%016llxULL, %s + %d, %d },\n", (unsigned long long)magics[sq].mask,
+             (unsigned long long)magics[sq].magic, tableName, (int)(magics[sq].attacks - table), magics[sq].shift);
+    emit(out, "};\n\n");
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    const char* path = argc > 1 ? argv[1] : "tables.h";
+    usePext = false; // the layout every CPU can use
+    initAttackTables();
+    initZobristKeys();
+    initCuckooTables();
+    initEvalTables();
+    initKpkBitbase();
+
+    SDL_IOStream* out = SDL_IOFromFile(path, "wb");
+    if (!out) {
+        SDL_Log("gentables: can't create %s: %s", path, SDL_GetError());
+        return 1;
+    }
+    emit(out, "/* Generated by gentables.c from engine.c's table code; don't edit, rebuild it (the tables build task).\n"
+              "   Included at the end of engine.c, which declares each of these first. */\n\n");
+
+    emitUint64Rows(out, "Uint64", "ZOBRIST_PIECE[PIECE_TYPE_COUNT][64]", &ZOBRIST_PIECE[0][0], PIECE_TYPE_COUNT, 64);
+    emitUint64Table(out, "ZOBRIST_CASTLE[16]", ZOBRIST_CASTLE, 16);
+    emitUint64Table(out, "ZOBRIST_EP[8]", ZOBRIST_EP, 8);
+    emit(out, "TABLE Uint64 ZOBRIST_BLACK_TO_MOVE = 0x%016llxULL;\n\n", (unsigned long long)ZOBRIST_BLACK_TO_MOVE);
+    emitUint64Table(out, "CUCKOO_KEYS[CUCKOO_SIZE]", CUCKOO_KEYS, CUCKOO_SIZE);
+    static Sint32 cuckooMoves[CUCKOO_SIZE];
+    for (int i = 0; i < CUCKOO_SIZE; i++) cuckooMoves[i] = CUCKOO_MOVES[i];
+    emit(out, "TABLE Move CUCKOO_MOVES[CUCKOO_SIZE] = {\n");
+    emitInts(out, cuckooMoves, CUCKOO_SIZE, 4);
+    emit(out, "};\n\n");
+
+    emit(out, "TABLE PackedScore PIECE_SQUARE_VALUE[PIECE_TYPE_COUNT][64] = {\n");
+    for (int p = 0; p < PIECE_TYPE_COUNT; p++) {
+        emit(out, "    {\n");
+        emitInts(out, PIECE_SQUARE_VALUE[p], 64, 8);
+        emit(out, "    },\n");
+    }
+    emit(out, "};\n\n");
+    emit(out, "TABLE int PHASE_WEIGHT[PHASE_MAX + 1] = {\n");
+    emitInts(out, (const Sint32*)PHASE_WEIGHT, PHASE_MAX + 1, 4);
+    emit(out, "};\n\n");
+    emitUint64Table(out, "KPK_BITBASE[KPK_SIZE / 64]", KPK_BITBASE, KPK_SIZE / 64);
+
+    emitUint64Table(out, "KNIGHT_ATTACKS[64]", KNIGHT_ATTACKS, 64);
+    emitUint64Table(out, "KING_ATTACKS[64]", KING_ATTACKS, 64);
+    emitUint64Rows(out, "Bitboard", "PAWN_ATTACKS[2][64]", &PAWN_ATTACKS[0][0], 2, 64);
+    emitUint64Rows(out, "Bitboard", "BETWEEN[64][64]", &BETWEEN[0][0], 64, 64);
+
+#if defined(CHESS_LOW_MEMORY)
+    emitUint64Rows(out, "Bitboard", "RAYS[8][64]", &RAYS[0][0], 8, 64);
+#else
+    emitUint64Table(out, "rookAttackTable[102400]", rookAttackTable, (int)SDL_arraysize(rookAttackTable));
+    emitUint64Table(out, "bishopAttackTable[5248]", bishopAttackTable, (int)SDL_arraysize(bishopAttackTable));
+    emitMagics(out, "ROOK_MAGICS", ROOK_MAGICS, rookAttackTable, "rookAttackTable");
+    emitMagics(out, "BISHOP_MAGICS", BISHOP_MAGICS, bishopAttackTable, "bishopAttackTable");
+#endif
+
+    if (!SDL_CloseIO(out) || !tablesOk) {
+        SDL_Log("gentables: can't write %s: %s", path, SDL_GetError());
+        return 1;
+    }
+    SDL_Log("gentables: wrote %s", path);
+    return 0;
+}
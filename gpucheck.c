@@ -0,0 +1,118 @@
+// GPU EVALUATION CHECK: shaders/nnue_eval.comp against the CPU network, a program of its own (ctest's gpu-eval)
+
+/* `gpucheck SHADER.spv [net FILE]` scores BENCH_POSITIONS (bench.h), and every position one legal move from each of
+   them, through gpuEvalSubmit/gpuEvalCollect and through nnueEvaluateBatch, and fails on the first score that
+   differs. Without a network file it makes one up from a fixed seed, small enough that no accumulator wraps, so the
+   check needs nothing but the compiled shader. Exit status 0 when every score agrees, 1 on a mismatch or a shader
+   that can't be read, 77 (ctest's skip) when there's no GPU device to run it on. The engine is compiled into this
+   file, its static functions included. */
+#include "engine.c"
+#include "bench.h"
+#include <SDL3/SDL_main.h>
+
+#define GPUCHECK_SKIP 77
+#define GPUCHECK_SEED 0x6E6E7565ULL
+
+// a network of small random weights in nnueNet, as nnueLoad would leave a version 2 file
+static bool makeCheckNet(void) {
+    Uint8* data = SDL_aligned_alloc(64, NNUE_FILE_BYTES);
+    if (!data) return false;
+    SDL_memset(data, 0, NNUE_FILE_BYTES);
+    Uint64 seed = GPUCHECK_SEED;
+    Sint16* bias = (Sint16*)(data + NNUE_HEADER_BYTES);
+    Sint16* weights = (Sint16*)(data + NNUE_WEIGHT_OFFSET);
+    Sint8* output = (Sint8*)(data + NNUE_OUTPUT_OFFSET);
+    for (int i = 0; i < NNUE_HIDDEN; i++) bias[i] = (Sint16)(zobristRandom(&seed) % 128);
+    for (int i = 0; i < NNUE_INPUTS * NNUE_HIDDEN; i++) weights[i] = (Sint16)((int)(zobristRandom(&seed) % 17) - 8);
+    for (int i = 0; i < 2 * NNUE_HIDDEN; i++) output[i] = (Sint8)((int)(zobristRandom(&seed) % 255) - 127);
+    nnueNet.copy = data;
+    nnueNet.featureBias = bias;
+    nnueNet.featureWeights = (const Sint16(*)[NNUE_HIDDEN])weights;
+    nnueNet.outputWeights = output;
+    nnueNet.outputBias = (Sint32)(zobristRandom(&seed) % 20001) - 10000;
+    nnueNet.loaded = true;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 && !(argc == 4 && SDL_strcmp(argv[2], "net") == 0)) {
+        SDL_Log("usage: %s SHADER.spv [net FILE]", argv[0]);
+        return 1;
+    }
+    const char* shader = argv[1];
+    engineInitTables();
+    if (argc == 4 ? !nnueLoad(argv[3]) : !makeCheckNet()) {
+        SDL_Log("gpucheck: no network to check with");
+        return 1;
+    }
+    size_t shaderSize = 0;
+    void* code = SDL_LoadFile(shader, &shaderSize);
+    if (!code) {
+        SDL_Log("gpucheck: can't read %s: %s", shader, SDL_GetError());
+        return 1;
+    }
+    SDL_free(code);
+    GpuEvaluator* gpu = gpuEvalCreate(shader);
+    if (!gpu) {
+        SDL_Log("gpucheck: skipped, nothing to run %s on", shader);
+        return GPUCHECK_SKIP;
+    }
+
+    int capacity = 0, count = 0;
+    for (size_t i = 0; i < SDL_arraysize(BENCH_POSITIONS); i++) {
+        ChessState chess = initChessState();
+        loadFen(&chess, BENCH_POSITIONS[i]);
+        capacity += 1 + countLegalMoves(&chess);
+    }
+    ChessState* positions = SDL_malloc(sizeof(ChessState) * capacity);
+    int* cpu = SDL_malloc(sizeof(int) * capacity);
+    int* gpuScores = SDL_malloc(sizeof(int) * capacity);
+    if (!positions || !cpu || !gpuScores) {
+        SDL_Log("gpucheck: out of memory");
+        return 1;
+    }
+    for (size_t i = 0; i < SDL_arraysize(BENCH_POSITIONS); i++) {
+        ChessState chess = initChessState();
+        loadFen(&chess, BENCH_POSITIONS[i]);
+        positions[count++] = chess;
+        MoveList legal;
+        getAllMoves(&chess, &legal);
+        for (int m = 0; m < legal.count; m++) {
+            positions[count] = chess;
+            makeMove(&positions[count++], legal.moves[m], NULL);
+        }
+    }
+    nnueEvaluateBatch(positions, count, cpu);
+
+    // two batches in flight whenever there's more to send, the way `batch ... gpu` drives it
+    const ChessState* batch[GPU_EVAL_BATCH];
+    int sent = 0, done = 0;
+    bool ok = true;
+    while (ok && done < count) {
+        while (sent < count && sent - done < 2 * GPU_EVAL_BATCH) {
+            int n = SDL_min(GPU_EVAL_BATCH, count - sent);
+            for (int i = 0; i < n; i++) batch[i] = &positions[sent + i];
+            if (!gpuEvalSubmit(gpu, batch, n)) break;
+            sent += n;
+        }
+        int n = gpuEvalCollect(gpu, gpuScores + done);
+        if (n <= 0) {
+            SDL_Log("gpucheck: the batch at position %d failed: %s", done, SDL_GetError());
+            ok = false;
+        }
+        done += SDL_max(n, 0);
+    }
+    for (int i = 0; ok && i < count; i++) {
+        if (gpuScores[i] == cpu[i]) continue;
+        char fen[FEN_MAX];
+        writeFen(&positions[i], fen, sizeof(fen));
+        SDL_Log("gpucheck: position %d scores %d on the GPU and %d on the CPU: %s", i, gpuScores[i], cpu[i], fen);
+        ok = false;
+    }
+    if (ok) SDL_Log("gpucheck: %d positions, the GPU and the CPU agree", count);
+    gpuEvalDestroy(gpu);
+    SDL_free(positions);
+    SDL_free(cpu);
+    SDL_free(gpuScores);
+    return ok ? 0 : 1;
+}
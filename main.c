@@ -1,24 +1,47 @@
-// CHESS ENGINE
+// CHESS GUI, and the headless perft, bench, batch, UCI and server front ends; the engine itself is engine.c
+
+/* Built with CHESS_HEADLESS defined there's no window: the front ends below are all there is, without SDL's video,
+   SDL_ttf or SDL_image, and with no command given it speaks UCI. CHESS_COMMAND (a string, "bench" say) makes a
+   program of a single command, its options straight after the program name. CMakeLists.txt builds both kinds. */
 
 // standard includes
+#if defined(_WIN32)
+#include <winsock2.h> // the analysis server's sockets; link with ws2_32
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
-#include <math.h>
 //SDL (SDL3 stored in external)
 #define SDL_MAIN_USE_CALLBACKS
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
+#if !defined(CHESS_HEADLESS)
 #include <SDL3_ttf/SDL_ttf.h>
 #include <SDL3_image/SDL_image.h>
+#endif
 #include <SDL3/SDL_atomic.h>
-#define INF 1000000 // cant use INFINITY from math.h include coz it doesnt convert to integer
-#define MOVE_DEPTH 5
 
+#include "engine.h"
+#include "bench.h"
+
+#if !defined(CHESS_HEADLESS)
+#include "assets.h"
 
 #define CLAY_IMPLEMENTATION
 #include "external/clay/clay.h"
 #include "external/clay/clay_renderer_SDL3.c"
+#if defined(CHESS_GPU_RENDERER)
+#include "external/clay/clay_renderer_SDL3_gpu.c"
+#endif
 
 static const Uint32 FONT_ID = 0;
 static const Clay_Color COLOR_BG = { 235, 235, 235, 255 };
@@ -28,106 +51,130 @@ static const Clay_Color COLOR_TEXT = { 30, 30, 30, 255 };
 static const Clay_Color COLOR_SQUARE_BLACK = {100, 100, 100, 255};
 static const Clay_Color COLOR_SQUARE_WHITE = {200, 200, 200, 255};
 
-typedef enum {
-    EMPTY = 0,
-    WHITE_PAWN, WHITE_KNIGHT, WHITE_BISHOP, WHITE_ROOK, WHITE_QUEEN, WHITE_KING,
-    BLACK_PAWN, BLACK_KNIGHT, BLACK_BISHOP, BLACK_ROOK, BLACK_QUEEN, BLACK_KING
-} PieceType;
-
-// same order as PIECE TYPe
-int PIECE_VALUES[13] = { 0,
-    1, 3, 4, 5, 9, 0,
-    1, 3, 4, 5, 9, 0
-};
-
+/* Frame timing, for finding out where a slow frame went: the layout (CreateLayout), the drawing of its render
+   commands, and the present (which waits for the display). F3 shows the last frame's over the window, F4 writes a
+   histogram of the last FRAME_HISTORY frames to FRAME_DUMP_PATH; --frame-stats starts with the overlay shown.
+   Frames are otherwise only drawn when something changed (AppState.redraw), so the overlay keeps them coming. */
+#define FRAME_HISTORY 1024
+#define FRAME_BUCKETS 50 // 1 ms each, the last one for everything slower
+#define FRAME_DUMP_PATH "frametimes.txt"
+#define REDRAW_PROGRESS_NS (250 * 1000000ULL) // the engine's info lines wake the window at most this often
+#define GUI_RESERVED_CORES 1 // logical cores the search leaves to the window unless --reserve-cores says otherwise
 
 typedef struct {
-    int fromRow, fromCol;
-    int toRow, toCol;
-    PieceType captured;
-    bool isPromotion;
-    bool isEnPassant;
-    bool isCastling;
-} Move;
-
-char* move2chars(Move move) { // for printing moves
-    static char moveStr[32];
-    char fromFile = 'a' + move.fromCol;
-    char fromRank = '1' + move.fromRow;
-    char toFile = 'a' + move.toCol;
-    char toRank = '1' + move.toRow;
-    if (move.isCastling) {
-        if (move.toCol == 6) SDL_snprintf(moveStr, sizeof(moveStr), "O-O");
-        else SDL_snprintf(moveStr, sizeof(moveStr), "O-O-O");
-    } else if (move.isPromotion) {
-        SDL_snprintf(moveStr, sizeof(moveStr), "%c%c-%c%c=Q", fromFile, fromRank, toFile, toRank);
-    } else if (move.isEnPassant) {
-        SDL_snprintf(moveStr, sizeof(moveStr), "%c%c x %c%c e.p.", fromFile, fromRank, toFile, toRank);
-    } else if (move.captured != EMPTY) {
-        SDL_snprintf(moveStr, sizeof(moveStr), "%c%c x %c%c", fromFile, fromRank, toFile, toRank);
-    } else {
-        SDL_snprintf(moveStr, sizeof(moveStr), "%c%c-%c%c", fromFile, fromRank, toFile, toRank);
-    }
-    return moveStr;
-}
+    Uint64 frameNS;   // from the start of the frame before to the start of this one
+    Uint64 layoutNS, renderNS, presentNS;
+    int commandCount; // render commands the layout produced
+} FrameTiming;
 
 typedef struct {
-    Move moves[256];
-    int count;
-} MoveList;
+    FrameTiming frames[FRAME_HISTORY]; // ring buffer
+    Uint64 count;                      // frames ever timed
+    Uint64 lastStartNS;
+    bool overlay;
+} FrameStats;
 
+/* What the window needs from disk that it can start without: the piece atlas is decoded on a thread of its own
+   while the window comes up and the engine is set up, and uploaded on the main thread once it's there. Until then
+   the board shows the pieces as plain squares. */
 typedef struct {
-    PieceType board[8][8];
-    bool whiteToMove;
-    int selectedRow;
-    int selectedCol;
-    Move engineMove;
-    bool engineWhite;
-    bool enginePending;
-    bool hasCastledWhite[2];
-    bool hasCastledBlack[2];
-    int enPassantCol;
-    SDL_Texture* pieceTextures[13];
-} ChessState;
+    SDL_Thread* thread;
+    SDL_AtomicInt ready;  // atlas and cells can be read
+    SDL_Surface* atlas;   // NULL if it couldn't be made
+    SDL_FRect cells[PIECE_TYPE_COUNT];
+} AssetLoad;
 
-typedef struct {
-    //atomics let you change them during multithreading without it going tits up
-    SDL_AtomicInt nodesSearched;
-    SDL_AtomicInt depthCompleted;
-    SDL_AtomicInt searching;   // 1 = running, 0 = idle
-} EngineProgress;
+/* The game the window shows, for taking moves back, replaying them and paging through a long one: its moves, and
+   the position every TIMELINE_KEYFRAME_PLIES plies, so that any ply is a copy of the keyframe before it and at
+   most that many moves made from there (timelineSeek), however long the game. */
+#define TIMELINE_MAX_PLIES 4096
+#define TIMELINE_KEYFRAME_PLIES 16
 
 typedef struct {
-    EngineProgress progress;
-    SDL_Thread* thread;
-    SDL_Mutex* mutex;        /* SDL3 type (fixed) */
-    bool hasMove;
-    Move resultMove;
-} Engine;
+    Move moves[TIMELINE_MAX_PLIES];
+    int length;
+    ChessState* keyframes; // [i] is the position at ply i * TIMELINE_KEYFRAME_PLIES; [0] the start
+    int keyframeCount, keyframeCapacity;
+} GameTimeline;
+
+// false if the keyframe can't be kept, which leaves the timeline as it was
+static bool timelineKeep(GameTimeline* timeline, const ChessState* position) {
+    if (timeline->keyframeCount == timeline->keyframeCapacity) {
+        int capacity = SDL_max(timeline->keyframeCapacity * 2, 16);
+        ChessState* grown = SDL_realloc(timeline->keyframes, (size_t)capacity * sizeof(ChessState));
+        if (!grown) return false;
+        timeline->keyframes = grown;
+        timeline->keyframeCapacity = capacity;
+    }
+    timeline->keyframes[timeline->keyframeCount++] = *position;
+    return true;
+}
+
+// a game of no moves yet from start
+static bool timelineReset(GameTimeline* timeline, const ChessState* start) {
+    timeline->length = 0;
+    timeline->keyframeCount = 0;
+    return timelineKeep(timeline, start);
+}
+
+// the moves from ply on dropped
+static void timelineTruncate(GameTimeline* timeline, int ply) {
+    timeline->length = SDL_min(timeline->length, ply);
+    timeline->keyframeCount = SDL_min(timeline->keyframeCount, timeline->length / TIMELINE_KEYFRAME_PLIES + 1);
+}
+
+// move played from the game's last position, after which it is in position; false when the game can't be any longer
+static bool timelineAppend(GameTimeline* timeline, Move move, const ChessState* position) {
+    if (timeline->length == TIMELINE_MAX_PLIES) return false;
+    if ((timeline->length + 1) % TIMELINE_KEYFRAME_PLIES == 0 && !timelineKeep(timeline, position)) return false;
+    timeline->moves[timeline->length++] = move;
+    return true;
+}
+
+// the position at ply (0 to length)
+static void timelineSeek(const GameTimeline* timeline, int ply, ChessState* position) {
+    int keyframe = ply / TIMELINE_KEYFRAME_PLIES;
+    *position = timeline->keyframes[keyframe];
+    for (int i = keyframe * TIMELINE_KEYFRAME_PLIES; i < ply; i++) makeMove(position, timeline->moves[i], NULL);
+}
+
+static bool timelineWhiteToMove(const GameTimeline* timeline, int ply) {
+    return timeline->keyframes[0].whiteToMove != (ply & 1);
+}
 
 typedef struct {
     SDL_Window* window;
     Clay_SDL3RendererData rendererData;
     ChessState chess;
-    Engine engine;
+    GameTimeline game;       // the moves played and, past ply, the ones taken back (stepThroughGame)
+    int ply;                 // of game, the position on the board
+    Engine* engine;
+    int selectedRow;         // the square clicked on, -1 = none
+    int selectedCol;
+    Uint64 legalTargets;     // squares the selected piece can move to, by square index (selectSquare)
+    bool engineWhite;        // the side the engine plays
+    SDL_Texture* pieceAtlas;   // every piece image in one texture, and a white cell the squares are drawn with
+    SDL_GPUTexture* pieceAtlasGpu; // the same on the SDL_GPU renderer (rendererData.gpu)
+    SDL_FRect pieceCells[PIECE_TYPE_COUNT]; // where each piece is in it, by PieceType, in texture coordinates; [EMPTY] the white cell
+    SDL_FPoint pointer;        // the mouse, in window coordinates
+    SDL_FRect boardRect;       // the squares, where the last layout put them; empty before the first
+    int hoveredSquare;         // the square under the mouse (boardSquareAt), -1 for none
+    AssetLoad assets;          // the piece images being decoded in the background (startLoadingAssets)
+    OpeningBook* book;       // --book FILE, NULL for none
+    FrameStats frameStats;
+    bool redraw;             // something on screen has changed since the last frame
+    const char* screenshot;  // --screenshot FILE: the first frame with the pieces on it goes there as a PNG, then quit
+    Uint64 lastWakeNS;       // engine thread: when its last info event woke the window (wakeForEngine)
 } AppState;
 
-// so they are available later in code
-void getAllMoves(ChessState* chess, MoveList* moves);
-int evaluateMaterial(ChessState* chess);
-Move findBestMove(ChessState* chess, int depth, Engine* enginePtr);
-void makeMove(ChessState* chess, Move move, void* _undo);
-void unmakeMove(ChessState* chess, Move move, void* _undo);
-
 static inline Clay_Dimensions SDL_MeasureText(Clay_StringSlice text, Clay_TextElementConfig* config, void* userData) {
-    TTF_Font** fonts = userData;
-    TTF_Font* font = fonts[config->fontId];
-    int width = 0, height = 0;
-    TTF_SetFontSize(font, config->fontSize);
-    if (!TTF_GetStringSize(font, text.chars, text.length, &width, &height)) {
-        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "TTF_GetStringSize failed: %s", SDL_GetError());
+    // measured once and cached with the text the renderer will draw, so the strings that stay put cost nothing
+    Clay_SDL3CachedText* cached = SDL_Clay_CachedText(userData, config->fontId, config->fontSize, text.chars, text.length);
+    if (!cached) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "TTF_CreateText failed: %s", SDL_GetError());
+        return (Clay_Dimensions){ 0, 0 };
     }
-    return (Clay_Dimensions){ (float)width, (float)height };
+    return (Clay_Dimensions){ (float)cached->width, (float)cached->height };
 }
 
 static void HandleClayErrors(Clay_ErrorData errorData) {
@@ -136,751 +183,355 @@ static void HandleClayErrors(Clay_ErrorData errorData) {
     }
 }
 
-static SDL_Texture* LoadTexture(SDL_Renderer* renderer, const char* path) {
-    SDL_Surface* surf = IMG_Load(path);
-    if (!surf) {
-        SDL_Log("IMG_Load failed for %s: %s", path, SDL_GetError());
-        return NULL;
+/* The twelve piece images packed side by side into one texture, with a white cell after them, so the board and its
+   pieces can go out as a single batch of geometry (renderChessBoard). Cells are two pixels apart so that filtering
+   at a piece's edge doesn't pick up its neighbour. */
+#define ATLAS_GAP 2
+
+static SDL_Surface* decodePieceAtlas(SDL_FRect cells[PIECE_TYPE_COUNT]) {
+    static const char* const FILES[PIECE_TYPE_COUNT] = { NULL, "wp", "wn", "wb", "wr", "wq", "wk", NULL, NULL,
+                                                         "bp", "bn", "bb", "br", "bq", "bk" };
+    SDL_Surface* images[PIECE_TYPE_COUNT] = { NULL };
+    int cell = 1;
+    for (int p = WHITE_PAWN; p <= BLACK_KING; p++) {
+        if (!FILES[p]) continue; // the codes between the colours
+        char path[64];
+        SDL_snprintf(path, sizeof(path), ASSET_PIECES "%s.png", FILES[p]);
+        SDL_IOStream* io = openAsset(path);
+        images[p] = io ? IMG_Load_IO(io, true) : NULL;
+        if (!images[p]) SDL_Log("IMG_Load failed for %s: %s", path, SDL_GetError());
+        else cell = SDL_max(cell, SDL_max(images[p]->w, images[p]->h));
+    }
+    int stride = cell + ATLAS_GAP;
+    SDL_Surface* atlas = SDL_CreateSurface(stride * 13, cell, SDL_PIXELFORMAT_RGBA32);
+    if (atlas) {
+        SDL_FillSurfaceRect(atlas, NULL, SDL_MapSurfaceRGBA(atlas, 0, 0, 0, 0));
+        SDL_Rect white = { 12 * stride, 0, cell, cell };
+        SDL_FillSurfaceRect(atlas, &white, SDL_MapSurfaceRGBA(atlas, 255, 255, 255, 255));
     }
-    SDL_Texture* tex = SDL_CreateTextureFromSurface(renderer, surf);
-    SDL_DestroySurface(surf);
-    if (!tex) SDL_Log("CreateTexture failed for %s: %s", path, SDL_GetError());
-    return tex;
+    for (int p = EMPTY; p <= BLACK_KING; p++) {
+        if (p != EMPTY && !FILES[p]) continue;
+        int slot = p == EMPTY ? 12 : pieceColor(p) * 6 + pieceKind(p) - 1; // white's six, black's, then the white cell
+        cells[p] = (SDL_FRect){ (float)(slot * stride) / (stride * 13), 0, (float)cell / (stride * 13), 1 };
+        if (!images[p]) continue;
+        SDL_Rect where = { slot * stride, 0, images[p]->w, images[p]->h };
+        SDL_SetSurfaceBlendMode(images[p], SDL_BLENDMODE_NONE); // copied as it is, alpha and all
+        if (atlas) SDL_BlitSurface(images[p], NULL, atlas, &where);
+        cells[p].w *= (float)images[p]->w / cell;
+        cells[p].h = (float)images[p]->h / cell;
+        SDL_DestroySurface(images[p]);
+    }
+    cells[EMPTY] = (SDL_FRect){ // its middle only, well clear of the edges
+        (12 * stride + cell / 2.0f) / (stride * 13), 0.5f, 0, 0 };
+    return atlas;
 }
 
-static void LoadChessTextures(ChessState* chess, SDL_Renderer* renderer) {
-    memset(chess->pieceTextures, 0, sizeof(chess->pieceTextures));
-    chess->pieceTextures[WHITE_PAWN]   = LoadTexture(renderer, "external/resources/chess_pieces/wp.png");
-    chess->pieceTextures[WHITE_KNIGHT] = LoadTexture(renderer, "external/resources/chess_pieces/wn.png");
-    chess->pieceTextures[WHITE_BISHOP] = LoadTexture(renderer, "external/resources/chess_pieces/wb.png");
-    chess->pieceTextures[WHITE_ROOK]   = LoadTexture(renderer, "external/resources/chess_pieces/wr.png");
-    chess->pieceTextures[WHITE_QUEEN]  = LoadTexture(renderer, "external/resources/chess_pieces/wq.png");
-    chess->pieceTextures[WHITE_KING]   = LoadTexture(renderer, "external/resources/chess_pieces/wk.png");
-
-    chess->pieceTextures[BLACK_PAWN]   = LoadTexture(renderer, "external/resources/chess_pieces/bp.png");
-    chess->pieceTextures[BLACK_KNIGHT] = LoadTexture(renderer, "external/resources/chess_pieces/bn.png");
-    chess->pieceTextures[BLACK_BISHOP] = LoadTexture(renderer, "external/resources/chess_pieces/bb.png");
-    chess->pieceTextures[BLACK_ROOK]   = LoadTexture(renderer, "external/resources/chess_pieces/br.png");
-    chess->pieceTextures[BLACK_QUEEN]  = LoadTexture(renderer, "external/resources/chess_pieces/bq.png");
-    chess->pieceTextures[BLACK_KING]   = LoadTexture(renderer, "external/resources/chess_pieces/bk.png");
+// the loading thread: the pieces, then the endgame tablebases, which would otherwise hold up the first search to need them
+static int SDLCALL loadAssets(void* data) {
+    AssetLoad* load = data;
+    load->atlas = decodePieceAtlas(load->cells);
+    SDL_SetAtomicInt(&load->ready, 1);
+    SDL_Event wake = { .type = SDL_EVENT_USER };
+    SDL_PushEvent(&wake);
+    engineBuildTablebases();
+    return 0;
 }
 
-ChessState initChessState(void) {
-    ChessState chess;
-    memset(&chess, 0, sizeof(chess));
-    chess.board[0][0] = WHITE_ROOK;   chess.board[0][1] = WHITE_KNIGHT; chess.board[0][2] = WHITE_BISHOP; chess.board[0][3] = WHITE_QUEEN;
-    chess.board[0][4] = WHITE_KING;   chess.board[0][5] = WHITE_BISHOP; chess.board[0][6] = WHITE_KNIGHT; chess.board[0][7] = WHITE_ROOK;
-    chess.board[7][0] = BLACK_ROOK;   chess.board[7][1] = BLACK_KNIGHT; chess.board[7][2] = BLACK_BISHOP; chess.board[7][3] = BLACK_QUEEN;
-    chess.board[7][4] = BLACK_KING;   chess.board[7][5] = BLACK_BISHOP; chess.board[7][6] = BLACK_KNIGHT; chess.board[7][7] = BLACK_ROOK;
-    for (int i = 0; i < 8; ++i) { chess.board[1][i] = WHITE_PAWN; chess.board[6][i] = BLACK_PAWN; }
-    chess.whiteToMove = true;
-    chess.selectedRow = -1; chess.selectedCol = -1;
-    chess.enginePending = false;
-    chess.enPassantCol = -1;
-    chess.engineWhite = false;
-    return chess;
-}
-
-static inline bool inBounds(int r, int c) { return r >= 0 && r < 8 && c >= 0 && c < 8; }
-static inline bool isWhite(PieceType p) { return p >= WHITE_PAWN && p <= WHITE_KING; }
-static inline bool isBlack(PieceType p) { return p >= BLACK_PAWN && p <= BLACK_KING; }
-static inline bool sameColor(PieceType a, PieceType b) { return (isWhite(a) && isWhite(b)) || (isBlack(a) && isBlack(b)); }
-
-bool pathClear(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    int dr = (tr > fr) - (tr < fr); //difference row
-    int dc = (tc > fc) - (tc < fc); //difference column
-    for (int r = fr + dr, c = fc + dc; r != tr || c != tc; r += dr, c += dc) { //raycasts checking each cell is empty between
-        if (chess->board[r][c] != EMPTY) return false;
-    }
-    return true;
-}
-bool knightMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    int dr = abs(tr - fr), dc = abs(tc - fc);
-    return (dr == 2 && dc == 1) || (dr == 1 && dc == 2);
-}
-bool rookMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    if (fr != tr && fc != tc) return false;
-    return pathClear(chess, fr, fc, tr, tc);
-}
-bool bishopMove(const ChessState* chess, int fr, int fc, int tr, int tc) { // raycasts like rook but different move vector
-    if (abs(fr - tr) != abs(fc - tc)) return false;
-    return pathClear(chess, fr, fc, tr, tc);
-}
-bool queenMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    return rookMove(chess, fr, fc, tr, tc) || bishopMove(chess, fr, fc, tr, tc);
-}
-bool pawnMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    PieceType p = chess->board[fr][fc];
-    int dir = isWhite(p) ? +1 : -1;
-    int startRow = isWhite(p) ? 1 : 6;
-    if (fc == tc && tr == fr + dir && chess->board[tr][tc] == EMPTY) return true;
-    if (fc == tc && fr == startRow && tr == fr + 2*dir && chess->board[fr + dir][fc] == EMPTY && chess->board[tr][tc] == EMPTY) return true;
-    if (abs(tc - fc) == 1 && tr == fr + dir && chess->board[tr][tc] != EMPTY) return true;
-    return false;
+static void startLoadingAssets(AssetLoad* load) {
+    load->thread = SDL_CreateThread(loadAssets, "assets", load);
+    if (!load->thread) loadAssets(load); // then it's done here and now
 }
 
-
-bool canPieceAttackSquare(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    if (!inBounds(tr, tc)) return false;
-    PieceType p = chess->board[fr][fc];
-    if (p == EMPTY) return false;
-    switch (p) {
-        case WHITE_PAWN: case BLACK_PAWN: return pawnMove(chess, fr, fc, tr, tc);
-        case WHITE_KNIGHT: case BLACK_KNIGHT: return knightMove(chess, fr, fc, tr, tc);
-        case WHITE_BISHOP: case BLACK_BISHOP: return bishopMove(chess, fr, fc, tr, tc);
-        case WHITE_ROOK: case BLACK_ROOK: return rookMove(chess, fr, fc, tr, tc);
-        case WHITE_QUEEN: case BLACK_QUEEN: return queenMove(chess, fr, fc, tr, tc);
-        case WHITE_KING: case BLACK_KING: return (abs(fr - tr) <= 1 && abs(fc - tc) <= 1);
-        default: return false;
-    }
-}
-bool isSquareAttacked(const ChessState* chess, int r, int c, bool byWhite) {
-    for (int fr = 0; fr < 8; fr++) for (int fc = 0; fc < 8; fc++) {
-        PieceType p = chess->board[fr][fc];
-        if (p == EMPTY) continue;
-        if (byWhite && !isWhite(p)) continue;
-        if (!byWhite && !isBlack(p)) continue;
-        if (canPieceAttackSquare(chess, fr, fc, r, c)) return true;
-    }
-    return false;
-}
-bool isKingInCheck(const ChessState* chess, bool whiteKing) {
-    for (int r=0;r<8;r++) for (int c=0;c<8;c++){
-        PieceType p = chess->board[r][c];
-        if ((whiteKing && p == WHITE_KING) || (!whiteKing && p == BLACK_KING)) {
-            return isSquareAttacked(chess, r, c, !whiteKing);
-        }
+// main thread, once the atlas is decoded: the texture is made here, where the renderer lives
+static void uploadPieceAtlas(AppState* state) {
+    AssetLoad* load = &state->assets;
+    if (state->pieceAtlas || state->pieceAtlasGpu || !load->atlas || !SDL_GetAtomicInt(&load->ready)) return;
+#if defined(CHESS_GPU_RENDERER)
+    if (state->rendererData.gpu) {
+        state->pieceAtlasGpu = SDL_Clay_GpuCreateTexture(state->rendererData.gpu, load->atlas);
+        if (!state->pieceAtlasGpu) SDL_Log("Could not make the piece atlas: %s", SDL_GetError());
+    } else
+#endif
+    {
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(state->rendererData.renderer, load->atlas);
+        if (!texture) SDL_Log("Could not make the piece atlas: %s", SDL_GetError());
+        else SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        state->pieceAtlas = texture;
     }
-    return false;
+    SDL_memcpy(state->pieceCells, load->cells, sizeof(state->pieceCells));
+    SDL_DestroySurface(load->atlas);
+    load->atlas = NULL;
+    state->redraw = true;
 }
-bool canCastle(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    PieceType king = chess->board[fr][fc];
-    bool white = isWhite(king);
-    if (white && fr != 0) return false;
-    if (!white && fr != 7) return false;
-    if (fc != 4) return false;
-    int rookCol = (tc == 6) ? 7 : 0;
-    int step = (tc > fc) ? 1 : -1;
-    if (white && chess->hasCastledWhite[(tc == 6) ? 0 : 1]) return false;
-    if (!white && chess->hasCastledBlack[(tc == 6) ? 0 : 1]) return false;
-    if (chess->board[fr][rookCol] != (white ? WHITE_ROOK : BLACK_ROOK)) return false;
-    for (int c = fc + step; c != rookCol; c += step) if (chess->board[fr][c] != EMPTY) return false;
-    if (isKingInCheck(chess, white)) return false;
-    for (int c = fc; c != tc + step; c += step) if (isSquareAttacked(chess, fr, c, !white)) return false;
-    return true;
-}
-bool kingMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    if (abs(fr - tr) <= 1 && abs(fc - tc) <= 1) return true;
-    if (fr == tr && (tc == 6 || tc == 2)) return canCastle(chess, fr, fc, tr, tc);
-    return false;
-}
-bool isLegalMove(const ChessState* chess, int fr, int fc, int tr, int tc) {
-    if (!inBounds(tr, tc)) return false;
-    PieceType p = chess->board[fr][fc];
-    if (p == EMPTY) return false;
-    PieceType target = chess->board[tr][tc];
-    if (sameColor(p, target)) return false;
-    bool ok = false;
-    switch (p) {
-        case WHITE_PAWN: case BLACK_PAWN: ok = pawnMove(chess, fr, fc, tr, tc); break;
-        case WHITE_KNIGHT: case BLACK_KNIGHT: ok = knightMove(chess, fr, fc, tr, tc); break;
-        case WHITE_BISHOP: case BLACK_BISHOP: ok = bishopMove(chess, fr, fc, tr, tc); break;
-        case WHITE_ROOK: case BLACK_ROOK: ok = rookMove(chess, fr, fc, tr, tc); break;
-        case WHITE_QUEEN: case BLACK_QUEEN: ok = queenMove(chess, fr, fc, tr, tc); break;
-        case WHITE_KING: case BLACK_KING: ok = kingMove(chess, fr, fc, tr, tc); break;
-        default: return false;
-    }
-    if (!ok) return false;
-    ChessState copy = *chess;
-    copy.board[tr][tc] = copy.board[fr][fc];
-    copy.board[fr][fc] = EMPTY;
-    bool white = isWhite(copy.board[tr][tc]);
-    return !isKingInCheck(&copy, white);
-}
-
-void getAllMoves(ChessState* chess, MoveList* moves) {
-    moves->count = 0;
-    for (int r=0;r<8;r++){
-        for (int c=0;c<8;c++){
-            PieceType p = chess->board[r][c];
-            if (p == EMPTY) continue;
-            if (chess->whiteToMove && isBlack(p)) continue;
-            if (!chess->whiteToMove && isWhite(p)) continue;
-            for (int r2=0;r2<8;r2++){
-                for (int c2=0;c2<8;c2++){
-                    if (isLegalMove(chess, r, c, r2, c2)) {
-                        if (moves->count >= 256) continue;
-                        Move mv = { r, c, r2, c2, chess->board[r2][c2], false, false, false };
-                        if ((p == WHITE_KING || p == BLACK_KING) && c == 4 && abs(c2 - c) == 2) mv.isCastling = true;
-                        if ((p == WHITE_PAWN && r2 == 7) || (p == BLACK_PAWN && r2 == 0)) mv.isPromotion = true;
-                        if ((p == WHITE_PAWN || p == BLACK_PAWN) && c != c2 && chess->board[r2][c2] == EMPTY) {
-                            mv.isEnPassant = true;
-                            int capRow = isWhite(p) ? r2 - 1 : r2 + 1;
-                            mv.captured = chess->board[capRow][c2];
-                        }
-                        moves->moves[moves->count++] = mv;
-                    }
-                }
-            }
-        }
-    }
+/* The game's search of the current position, or with ponderMove a ponder search on that reply to it.
+   softTimeNS: no iteration is started after it; hardTimeNS: the search is abandoned there (0 = no limit). */
+static void startEngineSearch(AppState* state, Move ponderMove, Uint64 softTimeNS, Uint64 hardTimeNS) {
+    SearchLimits limits = { .softTimeNS = softTimeNS, .hardTimeNS = hardTimeNS, .ponderMove = ponderMove };
+    engineStartSearch(state->engine, &state->chess, &limits);
 }
 
+// the user has just played move: a ponder hit carries on with the ponder search, anything else starts afresh
+static void engineReplyTo(AppState* state, Move move) {
+    if (enginePonderHit(state->engine, move)) return;
+    engineStopSearch(state->engine);
+    startEngineSearch(state, MOVE_NONE, MOVE_SOFT_TIME_NS, MOVE_HARD_TIME_NS);
+}
 
-// for preferred board placements of each piece
-// https://www.reddit.com/r/ComputerChess/comments/17v6dux/piece_position_in_evaluation/
-// tweaked from https://www.chessprogramming.org/PeSTO%27s_Evaluation_Function
-static const int PAWN_TABLE[8][8] = {
-    {0,  0,  0,  0,  0,  0,  0,  0},
-    {50, 50, 50, 50, 50, 50, 50, 50},
-    {10, 10, 20, 30, 30, 20, 10, 10},
-    {5,  5, 10, 25, 25, 10,  5,  5},
-    {0,  0,  0, 20, 20,  0,  0,  0},
-    {5, -5,-10,  0,  0,-10, -5,  5},
-    {5, 10, 10,-20,-20, 10, 10,  5},
-    {0,  0,  0,  0,  0,  0,  0,  0}
-};
-
-static const int KNIGHT_TABLE[8][8] = {
-    {-50,-40,-30,-30,-30,-30,-40,-50},
-    {-40,-20,  0,  0,  0,  0,-20,-40},
-    {-30,  0, 10, 15, 15, 10,  0,-30},
-    {-30,  5, 15, 20, 20, 15,  5,-30},
-    {-30,  0, 15, 20, 20, 15,  0,-30},
-    {-30,  5, 10, 15, 15, 10,  5,-30},
-    {-40,-20,  0,  5,  5,  0,-20,-40},
-    {-50,-40,-30,-30,-30,-30,-40,-50}
-};
-
-static const int BISHOP_TABLE[8][8] = {
-    {-20,-10,-10,-10,-10,-10,-10,-20},
-    {-10,  0,  0,  0,  0,  0,  0,-10},
-    {-10,  0,  5, 10, 10,  5,  0,-10},
-    {-10,  5,  5, 10, 10,  5,  5,-10},
-    {-10,  0, 10, 10, 10, 10,  0,-10},
-    {-10, 10, 10, 10, 10, 10, 10,-10},
-    {-10,  5,  0,  0,  0,  0,  5,-10},
-    {-20,-10,-10,-10,-10,-10,-10,-20}
-};
-
-static const int ROOK_TABLE[8][8] = {
-    {0,  0,  0,  0,  0,  0,  0,  0},
-    {5, 10, 10, 10, 10, 10, 10,  5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {0,  0,  0,  5,  5,  0,  0,  0}
-};
+/* Clay render helpers */
+/* Selects the square (row -1 for none) and works out where its piece can go, once: the board reads the mask every
+   frame. Called again whenever the position changes under a selection. */
+static void selectSquare(AppState* app, int row, int col) {
+    app->selectedRow = row;
+    app->selectedCol = col;
+    app->legalTargets = 0;
+    if (row < 0) return;
+    MoveList legal;
+    getAllMoves(&app->chess, &legal);
+    int from = squareIndex(row, col);
+    for (int i = 0; i < legal.count; i++)
+        if (moveFrom(legal.moves[i]) == from) app->legalTargets |= 1ULL << moveTo(legal.moves[i]);
+}
 
-static const int QUEEN_TABLE[8][8] = {
-    {-20,-10,-10, -5, -5,-10,-10,-20},
-    {-10,  0,  0,  0,  0,  0,  0,-10},
-    {-10,  0,  5,  5,  5,  5,  0,-10},
-    {-5,  0,  5,  5,  5,  5,  0, -5},
-    {0,  0,  5,  5,  5,  5,  0, -5},
-    {-10,  5,  5,  5,  5,  5,  0,-10},
-    {-10,  0,  5,  0,  0,  0,  0,-10},
-    {-20,-10,-10, -5, -5,-10,-10,-20}
-};
+/* The squares and pieces are one custom element drawn as a single batch (Clay_SDL3Batch): a quad a square, coloured
+   through the atlas's white cell, and one a piece. Square (0, 0) of the element is the top left on screen. */
+#define BOARD_QUADS (64 + 32)
 
+typedef struct {
+    Clay_SDL3Batch batch;
+    SDL_Vertex vertices[BOARD_QUADS * 4];
+    SDL_Vertex screen[BOARD_QUADS * 4];
+    int indices[BOARD_QUADS * 6];
+} BoardBatch;
 
-static const int KING_MIDDLE_TABLE[8][8] = {
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-20,-30,-30,-40,-40,-30,-30,-20},
-    {-10,-20,-20,-20,-20,-20,-20,-10},
-    {20, 20,  0,  0,  0,  0, 20, 20},
-    {20, 30, 10,  0,  0, 10, 30, 20}
-};
-// otherwise king doesnt get used offensively in endgame
-
-static const int KING_END_TABLE[8][8] = {
-    {-50,-40,-30,-20,-20,-30,-40,-50},
-    {-30,-20,-10,  0,  0,-10,-20,-30},
-    {-30,-10, 20, 30, 30, 20,-10,-30},
-    {-30,-10, 30, 40, 40, 30,-10,-30},
-    {-30,-10, 30, 40, 40, 30,-10,-30},
-    {-30,-10, 20, 30, 30, 20,-10,-30},
-    {-30,-30,  0,  0,  0,  0,-30,-30},
-    {-50,-30,-30,-30,-30,-30,-30,-50}
-};
+static void addBoardQuad(BoardBatch* board, float x, float y, float size, SDL_FRect cell, SDL_FColor color) {
+    int n = board->batch.vertexCount;
+    SDL_FPoint corners[4] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+    for (int i = 0; i < 4; i++)
+        board->vertices[n + i] = (SDL_Vertex){ { x + corners[i].x * size, y + corners[i].y * size }, color,
+                                               { cell.x + corners[i].x * cell.w, cell.y + corners[i].y * cell.h } };
+    static const int QUAD[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int i = 0; i < 6; i++) board->indices[board->batch.indexCount++] = n + QUAD[i];
+    board->batch.vertexCount += 4;
+}
 
-// Helper to get piece-square table value
-static int getPieceSquareValue(PieceType piece, int row, int col, bool endgame) {
-    // mirror row for black pieces
-    int tableRow = isWhite(piece) ? row : (7 - row);
-    
-    switch (piece) {
-        case WHITE_PAWN:
-        case BLACK_PAWN:
-            return PAWN_TABLE[tableRow][col];
-        case WHITE_KNIGHT:
-        case BLACK_KNIGHT:
-            return KNIGHT_TABLE[tableRow][col];
-        case WHITE_BISHOP:
-        case BLACK_BISHOP:
-            return BISHOP_TABLE[tableRow][col];
-        case WHITE_ROOK:
-        case BLACK_ROOK:
-            return ROOK_TABLE[tableRow][col];
-        case WHITE_QUEEN:
-        case BLACK_QUEEN:
-            return QUEEN_TABLE[tableRow][col];
-        case WHITE_KING:
-        case BLACK_KING:
-            return endgame ? KING_END_TABLE[tableRow][col] : KING_MIDDLE_TABLE[tableRow][col];
-        default:
-            return 0;
-    }
+/* The square (squareIndex) at a point in the window, -1 when it's off the board: plain arithmetic on the board's box
+   from the last layout, so neither a click nor a mouse move needs a look-up by element id or a layout of its own. */
+static int boardSquareAt(const SDL_FRect* board, SDL_FPoint point, bool isWhiteView) {
+    if (board->w <= 0 || board->h <= 0) return -1;
+    int c = (int)SDL_floorf((point.x - board->x) * 8 / board->w);
+    int r = (int)SDL_floorf((point.y - board->y) * 8 / board->h);
+    if (r < 0 || r > 7 || c < 0 || c > 7) return -1;
+    return squareIndex(isWhiteView ? 7 - r : r, isWhiteView ? 7 - c : c);
 }
 
-// Count total material to determine game phase (amount of pieces)
-static int countTotalMaterial(ChessState* chess) {
-    int total = 0;
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            PieceType p = chess->board[r][c];
-            if (p != EMPTY && p != WHITE_KING && p != BLACK_KING) {
-                total += PIECE_VALUES[p];
-            }
-        }
-    }
-    return total;
+static SDL_FColor toFColor(Clay_Color color) {
+    return (SDL_FColor){ color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
 }
 
-int evaluatePosition(ChessState* chess) {
-    int materialScore = 0;
-    int positionalScore = 0;
-    
-    // Determine if we're in endgame (less than 13 points of material per side on average)
-    int totalMaterial = countTotalMaterial(chess);
-    bool endgame = totalMaterial < 26;
-    
-    // Material and positional evaluation
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            PieceType p = chess->board[r][c];
-            if (p == EMPTY) continue;
-            
-            int pieceValue = PIECE_VALUES[p] * 100; // Scale up material values
-            int posValue = getPieceSquareValue(p, r, c, endgame);
-            
-            if (isWhite(p)) {
-                materialScore += pieceValue;
-                positionalScore += posValue;
-            } else {
-                materialScore -= pieceValue;
-                positionalScore -= posValue;
-            }
-        }
-    }
-    
-    // Bonus for bishop pair
-    int whiteBishops = 0, blackBishops = 0;
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            if (chess->board[r][c] == WHITE_BISHOP) whiteBishops++;
-            if (chess->board[r][c] == BLACK_BISHOP) blackBishops++;
-        }
-    }
-    int bishopPairBonus = 0;
-    if (whiteBishops >= 2) bishopPairBonus += 50;
-    if (blackBishops >= 2) bishopPairBonus -= 50;
-    
-    // Bonus for controlling center squares
-    int centerControl = 0;
-    int centerSquares[4][2] = {{3,3}, {3,4}, {4,3}, {4,4}};
-    for (int i = 0; i < 4; i++) {
-        int r = centerSquares[i][0];
-        int c = centerSquares[i][1];
-        if (isSquareAttacked(chess, r, c, true)) centerControl += 10;
-        if (isSquareAttacked(chess, r, c, false)) centerControl -= 10;
-    }
-
-    int whiteMobility = 0, blackMobility = 0;
-    for (int fr = 0; fr < 8; fr++) {
-        for (int fc = 0; fc < 8; fc++) {
-            PieceType p = chess->board[fr][fc];
-            if (p == EMPTY) continue;
-            
-            for (int tr = 0; tr < 8; tr++) {
-                for (int tc = 0; tc < 8; tc++) {
-                    if (canPieceAttackSquare(chess, fr, fc, tr, tc)) {
-                        if (isWhite(p)) whiteMobility++;
-                        else blackMobility++;
-                    }
-                }
-            }
-        }
-    }
-    int mobilityScore = (whiteMobility - blackMobility) * 2;
-    
-    // Pawn structure evaluation
-    int pawnStructure = 0;
-    for (int c = 0; c < 8; c++) {
-        int whitePawns = 0, blackPawns = 0;
-        for (int r = 0; r < 8; r++) {
-            if (chess->board[r][c] == WHITE_PAWN) whitePawns++;
-            if (chess->board[r][c] == BLACK_PAWN) blackPawns++;
-        }
-        // Penalty for doubled pawns (bad)
-        if (whitePawns > 1) pawnStructure -= (whitePawns - 1) * 10;
-        if (blackPawns > 1) pawnStructure += (blackPawns - 1) * 10;
-    }
-    
-    // Check for isolated pawns (no friendly pawns on adjacent files (also bad))
+/* The board, read in place through a const pointer: nothing is copied per frame. The position only changes on
+   the main-callback thread (a click in SDL_AppEvent, the engine's move in SDL_AppIterate), the same thread that
+   lays out the frame, so a layout never sees a move half made; the search works on its own copy. */
+static void renderChessBoard(const AppState* app, bool isWhiteView) {
+    static BoardBatch board; // drawn after the layout is done, so it has to outlive it
+    const ChessState* chess = &app->chess;
+    board.batch = (Clay_SDL3Batch){ .texture = app->pieceAtlas, .gpuTexture = app->pieceAtlasGpu,
+                                    .vertices = board.vertices, .screen = board.screen, .indices = board.indices };
+    bool atlas = app->pieceAtlas || app->pieceAtlasGpu;
+    int hoveredSquare = app->hoveredSquare;
     for (int r = 0; r < 8; r++) {
         for (int c = 0; c < 8; c++) {
-            PieceType p = chess->board[r][c];
-            if (p != WHITE_PAWN && p != BLACK_PAWN) continue;
-            
-            bool hasSupport = false;
-            for (int dc = -1; dc <= 1; dc += 2) {
-                int nc = c + dc;
-                if (nc < 0 || nc >= 8) continue;
-                for (int nr = 0; nr < 8; nr++) {
-                    if ((p == WHITE_PAWN && chess->board[nr][nc] == WHITE_PAWN) ||
-                        (p == BLACK_PAWN && chess->board[nr][nc] == BLACK_PAWN)) {
-                        hasSupport = true;
-                        break;
-                    }
-                }
-                if (hasSupport) break;
+            int row = isWhiteView ? 7 - r : r, col = isWhiteView ? 7 - c : c;
+            bool light = ((col + row) % 2) == 0;
+            bool hovered = squareIndex(row, col) == hoveredSquare;
+            bool selected = (row == app->selectedRow) && (col == app->selectedCol);
+            bool moveable = (app->legalTargets >> squareIndex(row, col)) & 1;
+            int state = selected ? 1 : moveable ? 2 : hovered ? 3 : 0;
+            Clay_Color squareColor;
+            switch (state) {
+                case 1: squareColor = (Clay_Color){255,255,0,255}; break;
+                case 2: squareColor = (Clay_Color){0,0,255,255}; break;
+                case 3: squareColor = (Clay_Color){255,0,0,255}; break;
+                default: squareColor = light ? COLOR_SQUARE_WHITE : COLOR_SQUARE_BLACK; break;
             }
-            
-            if (!hasSupport) {
-                if (p == WHITE_PAWN) pawnStructure -= 15;
-                else pawnStructure += 15;
+            addBoardQuad(&board, c / 8.0f, r / 8.0f, 1 / 8.0f, app->pieceCells[EMPTY], toFColor(squareColor));
+            PieceType piece = pieceAt(chess, row, col);
+            if (piece != EMPTY && atlas)
+                addBoardQuad(&board, c / 8.0f, r / 8.0f, 1 / 8.0f, app->pieceCells[piece], (SDL_FColor){ 1, 1, 1, 1 });
+            else if (piece != EMPTY) { // still loading: a square of the piece's colour
+                float shade = isBlack(piece) ? 0.1f : 0.9f;
+                addBoardQuad(&board, (c + 0.3f) / 8.0f, (r + 0.3f) / 8.0f, 0.4f / 8.0f, app->pieceCells[EMPTY], (SDL_FColor){ shade, shade, shade, 1 });
             }
         }
     }
-    
-    // King safety in middlegame
-    int kingSafety = 0;
-    if (!endgame) {
-        // Find kings and check pawn shield
-        for (int r = 0; r < 8; r++) {
-            for (int c = 0; c < 8; c++) {
-                if (chess->board[r][c] == WHITE_KING) {
-                    // Check for pawn shield
-                    if (r < 7) {
-                        if (c > 0 && chess->board[r+1][c-1] == WHITE_PAWN) kingSafety += 15;
-                        if (chess->board[r+1][c] == WHITE_PAWN) kingSafety += 15;
-                        if (c < 7 && chess->board[r+1][c+1] == WHITE_PAWN) kingSafety += 15;
-                    }
-                }
-                if (chess->board[r][c] == BLACK_KING) {
-                    if (r > 0) {
-                        if (c > 0 && chess->board[r-1][c-1] == BLACK_PAWN) kingSafety -= 15;
-                        if (chess->board[r-1][c] == BLACK_PAWN) kingSafety -= 15;
-                        if (c < 7 && chess->board[r-1][c+1] == BLACK_PAWN) kingSafety -= 15;
-                    }
-                }
-            }
-        }
+    CLAY(CLAY_ID("Board"), { .aspectRatio = 1, .layout = { .sizing = { .width = CLAY_SIZING_GROW(60*8) }, .padding = CLAY_PADDING_ALL(24) } }) {
+        CLAY(CLAY_ID("Squares"), { .aspectRatio = 1, .layout = { .sizing = { .width = CLAY_SIZING_GROW(60*8) } }, .custom = { .customData = &board.batch } }) {}
     }
-    
-    // Combine all factors
-    return materialScore + positionalScore + bishopPairBonus + 
-           centerControl + mobilityScore + pawnStructure + kingSafety;
 }
 
-typedef struct {
-    bool hasCastledWhite[2];
-    bool hasCastledBlack[2];
-    int enPassantCol;
-    PieceType capturedPiece;
-    int capturedRow;
-    int capturedCol;
-} UndoInfo;
-
-void makeMove(ChessState* chess, Move move, void* _undo) {
-    UndoInfo undoLocal;
-    UndoInfo* undo = (UndoInfo*)_undo;
-    if (!undo) undo = &undoLocal;
-    undo->hasCastledWhite[0] = chess->hasCastledWhite[0];
-    undo->hasCastledWhite[1] = chess->hasCastledWhite[1];
-    undo->hasCastledBlack[0] = chess->hasCastledBlack[0];
-    undo->hasCastledBlack[1] = chess->hasCastledBlack[1];
-    undo->enPassantCol = chess->enPassantCol;
-    undo->capturedPiece = move.captured;
-    PieceType moving = chess->board[move.fromRow][move.fromCol];
-    if (move.isCastling) {
-        int rookFromCol = (move.toCol == 6) ? 7 : 0;
-        int rookToCol   = (move.toCol == 6) ? 5 : 3;
-        chess->board[move.fromRow][rookToCol] = chess->board[move.fromRow][rookFromCol];
-        chess->board[move.fromRow][rookFromCol] = EMPTY;
-
-        if (moving == WHITE_KING) chess->hasCastledWhite[(move.toCol == 6) ? 0 : 1] = true;
-        else chess->hasCastledBlack[(move.toCol == 6) ? 0 : 1] = true;
-    }
-
-    if (move.isEnPassant) {
-        int capturedRow = isWhite(moving) ? move.toRow - 1 : move.toRow + 1;
-        undo->capturedRow = capturedRow;
-        undo->capturedCol = move.toCol;
-        chess->board[capturedRow][move.toCol] = EMPTY;
-    }
-
-    if (move.isPromotion) moving = isWhite(moving) ? WHITE_QUEEN : BLACK_QUEEN;
-
-    chess->enPassantCol = -1;
-    if ((moving == WHITE_PAWN || moving == BLACK_PAWN) && abs(move.toRow - move.fromRow) == 2) {
-        chess->enPassantCol = move.fromCol;
-    }
-
-    if (moving == WHITE_KING) { chess->hasCastledWhite[0] = true; chess->hasCastledWhite[1] = true; }
-    else if (moving == BLACK_KING) { chess->hasCastledBlack[0] = true; chess->hasCastledBlack[1] = true; }
-    else if (moving == WHITE_ROOK) {
-        if (move.fromRow == 0 && move.fromCol == 7) chess->hasCastledWhite[0] = true;
-        if (move.fromRow == 0 && move.fromCol == 0) chess->hasCastledWhite[1] = true;
-    } else if (moving == BLACK_ROOK) {
-        if (move.fromRow == 7 && move.fromCol == 7) chess->hasCastledBlack[0] = true;
-        if (move.fromRow == 7 && move.fromCol == 0) chess->hasCastledBlack[1] = true;
-    }
-
-    chess->board[move.toRow][move.toCol] = moving;
-    chess->board[move.fromRow][move.fromCol] = EMPTY;
-    chess->whiteToMove = !chess->whiteToMove;
-}
-
-void unmakeMove(ChessState* chess, Move move, void* _undo) {
-    UndoInfo* undo = (UndoInfo*)_undo;
-    if (!undo) return;
-    chess->whiteToMove = !chess->whiteToMove;
-    PieceType moving = chess->board[move.toRow][move.toCol];
-    if (move.isPromotion) moving = isWhite(moving) ? WHITE_PAWN : BLACK_PAWN;
-    chess->board[move.fromRow][move.fromCol] = moving;
-    chess->board[move.toRow][move.toCol] = undo->capturedPiece;
-    if (move.isCastling) {
-        int rookFromCol = (move.toCol == 6) ? 7 : 0;
-        int rookToCol   = (move.toCol == 6) ? 5 : 3;
-        chess->board[move.fromRow][rookFromCol] = chess->board[move.fromRow][rookToCol];
-        chess->board[move.fromRow][rookToCol] = EMPTY;
-    }
-    if (move.isEnPassant) {
-        chess->board[undo->capturedRow][undo->capturedCol] = undo->capturedPiece;
-        chess->board[move.toRow][move.toCol] = EMPTY;
-    }
-    chess->hasCastledWhite[0] = undo->hasCastledWhite[0];
-    chess->hasCastledWhite[1] = undo->hasCastledWhite[1];
-    chess->hasCastledBlack[0] = undo->hasCastledBlack[0];
-    chess->hasCastledBlack[1] = undo->hasCastledBlack[1];
-    chess->enPassantCol = undo->enPassantCol;
-}
-
-int minimaxAB(ChessState* chess, int depth, int alpha, int beta, Engine* engine) {
-    SDL_AddAtomicInt(&engine->progress.nodesSearched, 1);
-    if (depth == 0)
-        return evaluatePosition(chess); // white-positive, black-negative
-    MoveList moves = {0};
-    getAllMoves(chess, &moves);
-    if (moves.count == 0) {
-        if (isKingInCheck(chess, chess->whiteToMove))
-            return chess->whiteToMove ? -10000 : 10000;
-        return 0; // stalemate
-    }
-    if (chess->whiteToMove) {
-        // MAX node
-        int best = -100000;
-        for (int i = 0; i < moves.count; i++) {
-            UndoInfo u;
-            makeMove(chess, moves.moves[i], &u);
-            int score = minimaxAB(chess, depth - 1, alpha, beta, engine);
-            unmakeMove(chess, moves.moves[i], &u);
-            if (score > best) best = score;
-            if (best > alpha) alpha = best;
-            if (alpha >= beta)
-                break;
-        }
-        return best;
+// "+0.35" in pawns, or "#3" / "#-2" for a mate in that many moves
+static void formatScore(char* buf, size_t size, int score) {
+    if (abs(score) >= MATE_BOUND) {
+        int plies = MATE_SCORE - abs(score);
+        SDL_snprintf(buf, size, "#%s%d", score < 0 ? "-" : "", (plies + 1) / 2);
     } else {
-        int best = 100000;
-        for (int i = 0; i < moves.count; i++) {
-            UndoInfo u;
-            makeMove(chess, moves.moves[i], &u);
-            int score = minimaxAB(chess, depth - 1, alpha, beta, engine);
-            unmakeMove(chess, moves.moves[i], &u);
-            if (score < best) best = score;
-            if (best < beta) beta = best;
-            if (alpha >= beta)
-                break;
-        }
-        return best;
+        SDL_snprintf(buf, size, "%+.2f", score / 100.0);
     }
 }
 
-typedef struct {
-    ChessState position;
-    Move move;
-    int depth;
-    int score;
-    Engine* enginePtr;
-
-    SDL_AtomicInt* sharedAlpha;
-    bool isWhiteRoot;
-} RootThread;
-
-int SDLCALL root_worker(void* data) {
-    RootThread* rt = (RootThread*)data;
-    UndoInfo u;
-    makeMove(&rt->position, rt->move, &u);
-    int shared = SDL_GetAtomicInt(rt->sharedAlpha);
-    int score;
-    if (rt->isWhiteRoot) {
-        int alpha = shared;
-        int beta  = INF;
-        score = minimaxAB(&rt->position, rt->depth - 1, alpha, beta, rt->enginePtr);
-        int old;
-        do {
-            old = SDL_GetAtomicInt(rt->sharedAlpha);
-            if (score <= old) break;
-        } while (!SDL_CompareAndSwapAtomicInt(rt->sharedAlpha, old, score));
-    } else {
-        int alpha = -INF;
-        int beta  = shared;
-        score = minimaxAB(&rt->position, rt->depth - 1, alpha, beta, rt->enginePtr);
-        int old;
-        do {
-            old = SDL_GetAtomicInt(rt->sharedAlpha);
-            if (score >= old) break;
-        } while (!SDL_CompareAndSwapAtomicInt(rt->sharedAlpha, old, score));
-    }
-    rt->score = score;
-    return 0;
-}
-
-Move findBestMove(ChessState* chess, int depth, Engine* engine) {
-    MoveList rootMoves;
-    getAllMoves(chess, &rootMoves);
-    Move bestMove = rootMoves.moves[0];
-    int bestScore = chess->whiteToMove ? -INF : INF;
-    {
-        ChessState tmp = *chess;
-        UndoInfo u;
-        makeMove(&tmp, rootMoves.moves[0], &u);
-        bestScore = minimaxAB(&tmp, depth - 1, -INF, INF, engine);
-        bestMove  = rootMoves.moves[0];
+// Multi-PV analysis lines beside the board; the text has to outlive the layout, hence static
+static void renderAnalysisLines(const Engine* engine) {
+    static char lineText[MAX_MULTI_PV][MAX_PV_LENGTH * 8 + 32];
+    int count = engine->lineCount;
+    for (int k = 0; k < count; k++) {
+        const PvLine* line = &engine->lines[k];
+        char score[16];
+        formatScore(score, sizeof(score), line->score);
+        SDL_snprintf(lineText[k], sizeof(lineText[k]), "%d. %s ", k + 1, score);
+        for (int i = 0; i < line->length; i++) {
+            char move[MOVE_TEXT_MAX];
+            SDL_strlcat(lineText[k], move2chars(line->moves[i], move), sizeof(lineText[k]));
+            SDL_strlcat(lineText[k], " ", sizeof(lineText[k]));
+        }
+    }
+    CLAY(CLAY_ID("Lines"), { .layout = { .layoutDirection = CLAY_TOP_TO_BOTTOM, .sizing = { .width = CLAY_SIZING_FIXED(320) }, .padding = CLAY_PADDING_ALL(12), .childGap = 6 } }) {
+        for (int k = 0; k < count; k++) {
+            Clay_String text = { .chars = lineText[k], .length = (int)SDL_strlen(lineText[k]) };
+            CLAY_TEXT(text, CLAY_TEXT_CONFIG({ .fontId = FONT_ID, .fontSize = 12, .textColor = COLOR_TEXT }));
+        }
     }
-    SDL_AtomicInt sharedAlpha;
-    SDL_SetAtomicInt(&sharedAlpha, bestScore);
-    int n = SDL_GetNumLogicalCPUCores();
-    int jobs = rootMoves.count - 1;
-    if (n > jobs) n = jobs;
+}
 
-    RootThread threads[256];
-    SDL_Thread* workers[256];
-    for (int i = 1; i < rootMoves.count; i++) {
-        threads[i].position = *chess;
-        threads[i].move = rootMoves.moves[i];
-        threads[i].depth = depth;
-        threads[i].enginePtr = engine;
-        threads[i].sharedAlpha = &sharedAlpha;
-        threads[i].isWhiteRoot = chess->whiteToMove;
+/* The search as it goes: the best line in SAN with its score, depth and selective depth, speed, how full the hash
+   table is, and each thread's share of the nodes. The counters are read live, but the text is only made again
+   every REDRAW_PROGRESS_NS or when an iteration reports, so frames in between cost no formatting; it has to
+   outlive the layout, hence static. */
+#define PANEL_LINES 5
 
-        workers[i] = SDL_CreateThread(root_worker, "root", &threads[i]);
+static void renderSearchPanel(const Engine* engine) {
+    static char text[PANEL_LINES][MAX_PV_LENGTH * MOVE_SAN_MAX + 64];
+    static Uint64 madeNS, madeNodes;
+    static int madeDepth = -1;
+    const EngineEvent* info = &engine->info;
+    Engine* live = (Engine*)engine; // the counters are only read
+    Uint64 now = SDL_GetTicksNS();
+    if (madeDepth < 0 || (engine->searching && now - madeNS >= REDRAW_PROGRESS_NS) || info->depth != madeDepth || info->nodes != madeNodes) {
+        madeNS = now, madeNodes = info->nodes, madeDepth = info->depth;
+        Uint64 nodes = engine->searching ? engineNodeCount(live) : info->nodes;
+        Uint64 elapsed = engine->searching ? now - engine->startNS : (Uint64)info->elapsedMs * 1000000;
+        char score[16] = "-";
+        if (info->depth > 0) formatScore(score, sizeof(score), info->line.score);
+        SDL_snprintf(text[0], sizeof(text[0]), "depth %d/%d  score %s", info->depth,
+                     engine->searching ? engineSelDepth(live) : info->selDepth, score);
+        SDL_snprintf(text[1], sizeof(text[1]), "nodes %" SDL_PRIu64 "  %" SDL_PRIu64 " kn/s", nodes,
+                     elapsed > 0 ? nodes * 1000000 / elapsed : 0);
+        SDL_snprintf(text[2], sizeof(text[2]), "hash %.1f%% full", engineHashfull(engine) / 10.0);
+        int length = SDL_snprintf(text[3], sizeof(text[3]), "pv ");
+        formatPv(&engine->position, info->line.moves, info->line.length, true, text[3] + length, sizeof(text[3]) - length);
+        Uint64 threadNodes[MAX_POOL_THREADS + 1];
+        int threads = engineThreadNodes(live, threadNodes);
+        length = SDL_snprintf(text[4], sizeof(text[4]), "threads");
+        for (int i = 0; i < threads && length < (int)sizeof(text[4]); i++)
+            length += SDL_snprintf(text[4] + length, sizeof(text[4]) - length, " %" SDL_PRIu64 "k", threadNodes[i] / 1000);
     }
-    for (int i = 1; i < rootMoves.count; i++)
-        SDL_WaitThread(workers[i], NULL);
-    for (int i = 1; i < rootMoves.count; i++) {
-        int s = threads[i].score;
-        if ((chess->whiteToMove && s > bestScore) ||
-            (!chess->whiteToMove && s < bestScore)) {
-            bestScore = s;
-            bestMove = threads[i].move;
+    CLAY(CLAY_ID("SearchPanel"), { .layout = { .layoutDirection = CLAY_TOP_TO_BOTTOM, .sizing = { .width = CLAY_SIZING_FIXED(320) }, .padding = CLAY_PADDING_ALL(12), .childGap = 6 } }) {
+        for (int k = 0; k < PANEL_LINES; k++) {
+            Clay_String string = { .chars = text[k], .length = (int)SDL_strlen(text[k]) };
+            CLAY_TEXT(string, CLAY_TEXT_CONFIG({ .fontId = FONT_ID, .fontSize = 12, .textColor = COLOR_TEXT }));
         }
     }
-    return bestMove;
 }
 
-/* Engine thread: copies chess state, searches, writes result under mutex (mutual exclusion lock for multithreading) */
-static int engine_thread_func(void* arg) {
-    AppState* state = arg;
-
-    SDL_SetAtomicInt(&state->engine.progress.nodesSearched, 0);
-    SDL_SetAtomicInt(&state->engine.progress.depthCompleted, 0);
-    SDL_SetAtomicInt(&state->engine.progress.searching, 1);
-
-    ChessState snapshot;
-    SDL_LockMutex(state->engine.mutex);
-    snapshot = state->chess;
-    SDL_UnlockMutex(state->engine.mutex);
+/* The --book file's moves for the position on the board, the most played first, with how the games went after
+   them when it's an explorer index (`main explorer`). Looked up again only when the position changes; the text
+   has to outlive the layout, hence static. */
+#define BOOK_PANEL_MOVES 8
 
-    Move best = {0};
-
-    for (int d = 1; d <= MOVE_DEPTH; d++) {
-        best = findBestMove(&snapshot, d, &state->engine);
-        SDL_SetAtomicInt(&state->engine.progress.depthCompleted, d);
+static void renderBookPanel(const OpeningBook* book, const ChessState* chess) {
+    static char text[BOOK_PANEL_MOVES][MOVE_SAN_MAX + 64];
+    static int count = -1;
+    static Uint64 madeKey;
+    if (count < 0 || chess->hashKey != madeKey) {
+        madeKey = chess->hashKey;
+        ChessState position = *chess; // bookStats generates the legal moves on it
+        BookMoveStats stats[BOOK_PANEL_MOVES];
+        count = bookStats(book, &position, stats, BOOK_PANEL_MOVES);
+        for (int i = 0; i < count; i++) {
+            const BookMoveStats* s = &stats[i];
+            int length = formatPv(chess, &s->move, 1, true, text[i], sizeof(text[i]));
+            Uint32 decided = s->whiteWins + s->draws + s->blackWins;
+            if (decided > 0)
+                SDL_snprintf(text[i] + length, sizeof(text[i]) - length, "  %u games  %.0f%% / %.0f%% / %.0f%%", s->games,
+                             s->whiteWins * 100.0 / decided, s->draws * 100.0 / decided, s->blackWins * 100.0 / decided);
+            else
+                SDL_snprintf(text[i] + length, sizeof(text[i]) - length, "  %u games", s->games);
+        }
     }
+    if (count == 0) return;
+    CLAY(CLAY_ID("BookPanel"), { .layout = { .layoutDirection = CLAY_TOP_TO_BOTTOM, .sizing = { .width = CLAY_SIZING_FIXED(320) }, .padding = CLAY_PADDING_ALL(12), .childGap = 6 } }) {
+        CLAY_TEXT(CLAY_STRING("Book  white / draw / black"), CLAY_TEXT_CONFIG({ .fontId = FONT_ID, .fontSize = 12, .textColor = COLOR_TEXT }));
+        for (int k = 0; k < count; k++) {
+            Clay_String string = { .chars = text[k], .length = (int)SDL_strlen(text[k]) };
+            CLAY_TEXT(string, CLAY_TEXT_CONFIG({ .fontId = FONT_ID, .fontSize = 12, .textColor = COLOR_TEXT }));
+        }
+    }
+}
 
-    SDL_LockMutex(state->engine.mutex);
-    state->engine.resultMove = best;
-    state->engine.hasMove = true;
-    SDL_UnlockMutex(state->engine.mutex);
-
-    SDL_SetAtomicInt(&state->engine.progress.searching, 0);
-    return 0;
+// the last frame's timings in a corner of the window; the text has to outlive the layout, hence static
+static void renderFrameStats(const FrameStats* stats) {
+    static char text[160];
+    if (stats->count == 0) return;
+    const FrameTiming* last = &stats->frames[(stats->count - 1) % FRAME_HISTORY];
+    SDL_snprintf(text, sizeof(text), "frame %.1f ms  layout %.2f ms  %d commands  render %.2f ms  present %.2f ms",
+                 last->frameNS / 1e6, last->layoutNS / 1e6, last->commandCount, last->renderNS / 1e6, last->presentNS / 1e6);
+    CLAY(CLAY_ID("FrameStats"), {
+        .floating = { .attachTo = CLAY_ATTACH_TO_ROOT, .offset = { 8, 52 }, .zIndex = 100 },
+        .layout = { .padding = CLAY_PADDING_ALL(4) },
+        .backgroundColor = (Clay_Color){ 255, 255, 224, 230 }
+    }) {
+        Clay_String string = { .chars = text, .length = (int)SDL_strlen(text) };
+        CLAY_TEXT(string, CLAY_TEXT_CONFIG({ .fontId = FONT_ID, .fontSize = 12, .textColor = COLOR_TEXT }));
+    }
 }
 
-/* Clay render helpers */
-void renderChessPiece(SDL_Texture** pieceTextures, PieceType piece, Clay_String squareIdString)
-{
-    if (piece == EMPTY) return;
-    SDL_Texture* tex = pieceTextures[piece];
-    if (!tex) return;
-    char idBuf[16];
-    char pieceChar = (char)(piece - '0');
-    int len = SDL_snprintf(idBuf, sizeof(idBuf), "%c_%.*s", pieceChar, (int)squareIdString.length, squareIdString.chars);
-    Clay_String pieceId = { .chars = idBuf, .length = len };
-    CLAY(CLAY_SID(pieceId), { .aspectRatio = 1, .layout = {.sizing={.width = CLAY_SIZING_GROW(60)}}, .image = {.imageData = tex}}) {}
-}
-
-void renderChessBoard(ChessState chess, bool isWhiteView) {
-    Clay_Sizing expand = { .width = CLAY_SIZING_GROW(0), .height = CLAY_SIZING_GROW(0) };
-    Clay_String boardId = { .chars = "Board", .length = 5 };
-    CLAY(CLAY_SID(boardId), { .aspectRatio = 1, .layout = { .sizing = { .width = CLAY_SIZING_GROW(60*8) }, .layoutDirection = CLAY_TOP_TO_BOTTOM, .padding = CLAY_PADDING_ALL(24) } }) {
-        for (char r=0;r<8;r++){
-            char row = isWhiteView ? (char)(7 - r) : r;
-            char rowStr[2] = { (char)('1' + row), '\0' };
-            Clay_String rowIdString = { .chars = rowStr, .length = 1 };
-            CLAY(CLAY_SID(rowIdString), { .aspectRatio = 1.0f/8.0f, .layout = { .sizing = { .width = CLAY_SIZING_GROW(60*8), .height = CLAY_SIZING_GROW(60) } } }) {
-                for (char c=0;c<8;c++){
-                    char col = isWhiteView ? (char)(7 - c) : c;
-                    char squareStr[3] = { (char)('A' + col), (char)('1' + row), '\0' };
-                    Clay_String squareIdString = { .chars = squareStr, .length = 2 };
-                    bool light = (((int)col + (int)row) % 2) == 0;
-                    bool hovered = Clay_PointerOver(CLAY_SID(squareIdString));
-                    bool selected = (row == chess.selectedRow) && (col == chess.selectedCol);
-                    bool moveable = isLegalMove(&chess, chess.selectedRow, chess.selectedCol, row, col);
-                    int state = selected ? 1 : moveable ? 2 : hovered ? 3 : 0;
-                    Clay_Color squareColor;
-                    switch (state) {
-                        case 1: squareColor = (Clay_Color){255,255,0,255}; break;
-                        case 2: squareColor = (Clay_Color){0,0,255,255}; break;
-                        case 3: squareColor = (Clay_Color){255,0,0,255}; break;
-                        default: squareColor = light ? COLOR_SQUARE_WHITE : COLOR_SQUARE_BLACK; break;
-                    }
-                    CLAY(CLAY_SID(squareIdString), { .aspectRatio = 1, .backgroundColor = squareColor, .layout = { .sizing = expand } }) {
-                        renderChessPiece(chess.pieceTextures, chess.board[row][col], squareIdString);
-                    };
-                }
-            };
-        }
+// F4: the frame times of the last FRAME_HISTORY frames, where they went on average, and how they spread
+static void dumpFrameStats(const FrameStats* stats, const char* path) {
+    int count = (int)SDL_min(stats->count, (Uint64)FRAME_HISTORY);
+    if (count == 0) return;
+    Uint64 buckets[FRAME_BUCKETS] = { 0 }, frame = 0, layout = 0, render = 0, present = 0, worst = 0;
+    Uint64 commands = 0;
+    for (int i = 0; i < count; i++) {
+        const FrameTiming* f = &stats->frames[i];
+        buckets[SDL_min(f->frameNS / 1000000, (Uint64)FRAME_BUCKETS - 1)]++;
+        frame += f->frameNS, layout += f->layoutNS, render += f->renderNS, present += f->presentNS;
+        commands += (Uint64)f->commandCount;
+        worst = SDL_max(worst, f->frameNS);
+    }
+    SDL_IOStream* out = SDL_IOFromFile(path, "w");
+    if (!out) { SDL_Log("Could not write %s: %s", path, SDL_GetError()); return; }
+    SDL_IOprintf(out, "%d frames: mean %.2f ms (layout %.2f, render %.2f, present %.2f), worst %.2f ms, %.0f commands\n",
+                 count, frame / 1e6 / count, layout / 1e6 / count, render / 1e6 / count, present / 1e6 / count,
+                 worst / 1e6, (double)commands / count);
+    for (int b = 0; b < FRAME_BUCKETS; b++) {
+        if (buckets[b] == 0) continue;
+        char bar[61] = "";
+        int length = (int)(buckets[b] * 60 / (Uint64)count);
+        for (int i = 0; i < SDL_max(length, 1); i++) bar[i] = '#';
+        if (b < FRAME_BUCKETS - 1) SDL_IOprintf(out, "%3d-%-3d ms %6" SDL_PRIu64 " %s\n", b, b + 1, buckets[b], bar);
+        else SDL_IOprintf(out, "%3d+    ms %6" SDL_PRIu64 " %s\n", b, buckets[b], bar);
     }
+    if (SDL_CloseIO(out)) SDL_Log("Frame times written to %s", path);
+    else SDL_Log("Could not write %s: %s", path, SDL_GetError());
 }
 
-static Clay_RenderCommandArray CreateLayout(AppState* state) {
-    int nodes     = SDL_GetAtomicInt(&state->engine.progress.nodesSearched);
-    int depth     = SDL_GetAtomicInt(&state->engine.progress.depthCompleted);
-    int searching = SDL_GetAtomicInt(&state->engine.progress.searching);
+static Clay_RenderCommandArray CreateLayout(const AppState* state) {
+    const EngineEvent* info = &state->engine->info;
+    bool searching = state->engine->searching;
+    Uint64 nodes = searching ? engineNodeCount(state->engine) : info->nodes; // the counters are readable any time
     const int barTotalW = 300;
     const int barInnerMax = (barTotalW - 8);
     float t = 0.0f;
-    if (searching && MOVE_DEPTH > 0) t = (float)depth / (float)MOVE_DEPTH;
+    int elapsedMs = searching ? (int)((SDL_GetTicksNS() - state->engine->startNS) / 1000000) : info->elapsedMs;
+    if (searching) t = (float)elapsedMs / (float)MOVE_SOFT_TIME_MS;
     if (t < 0.0f) t = 0.0f;
     if (t > 1.0f) t = 1.0f;
     int innerW = (int)(barInnerMax * t);
@@ -914,213 +565,6949 @@ static Clay_RenderCommandArray CreateLayout(AppState* state) {
                     }) {}
                 };
                 {
-                    char statusBuf[80];
-                    SDL_snprintf(statusBuf, sizeof(statusBuf), "%s  depth: %d/%d  nodes: %d",
-                                 searching ? "Searching" : "Idle",
-                                 depth, MOVE_DEPTH, nodes);
+                    char statusBuf[128], score[16] = "";
+                    if (info->depth > 0) formatScore(score, sizeof(score), info->line.score);
+                    SDL_snprintf(statusBuf, sizeof(statusBuf), "%s  depth: %d %s  nodes: %" SDL_PRIu64 "  %" SDL_PRIu64 " kn/s  %.1fs",
+                                 !searching ? "Idle" : SDL_GetAtomicInt(&state->engine->pondering) ? "Pondering" : "Searching",
+                                 info->depth, score, nodes, info->nps / 1000, elapsedMs / 1000.0);
                     Clay_String statusStr = { .chars = statusBuf, .length = (int)SDL_strlen(statusBuf) };
                     CLAY_TEXT(statusStr, CLAY_TEXT_CONFIG({ .fontId = FONT_ID, .fontSize = 12, .textColor = COLOR_TEXT }));
                 }
             }
         }
         CLAY(CLAY_ID("Content"), { .layout = { .sizing = expand, .padding = CLAY_PADDING_ALL(24), .childAlignment = { .x = CLAY_ALIGN_X_CENTER, .y = CLAY_ALIGN_Y_CENTER } } }) {
-            renderChessBoard(state->chess, true);
+            renderChessBoard(state, true);
+            CLAY(CLAY_ID("SidePanels"), { .layout = { .layoutDirection = CLAY_TOP_TO_BOTTOM } }) {
+                renderSearchPanel(state->engine);
+                if (state->engine->multiPv > 1) renderAnalysisLines(state->engine);
+                if (state->book) renderBookPanel(state->book, &state->chess);
+            }
         }
+        if (state->frameStats.overlay) renderFrameStats(&state->frameStats);
     }
 
     return Clay_EndLayout();
 }
+#endif
 
-/* SDL App lifecycle */
-SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
-    (void)argc; (void)argv;
-    if (!TTF_Init()) return SDL_APP_FAILURE;
+/* Perft: counts the leaf nodes of the legal move tree, to check getAllMoves/makeMove/unmakeMove (and at the last
+   ply countLegalMoves) against known totals and to time them. Run headless with `main perft <depth> [threads N]
+   [hash MB] [fen]`, or `main perft suite [threads N] [hash MB]`. The root moves are shared out over the worker
+   pool, and subtree counts are kept in a hash table by position and depth: a full-width tree is so full of
+   transpositions that a deep perft mostly looks up what it has already counted. `hash 0` counts every node. */
+#define PERFT_HASH_MB 64
 
-    AppState* state = SDL_calloc(1, sizeof(AppState));
-    if (!state) return SDL_APP_FAILURE;
+/* One count a slot, always replaced. check is the position's key XORed with data, so an entry torn by two threads
+   writing at once doesn't check out and is counted again instead of being believed. */
+typedef struct {
+    Uint64 check;
+    Uint64 data; // the count above the low 8 bits, the depth in them
+} PerftEntry;
 
-    if (!SDL_CreateWindowAndRenderer("SDL + Clay UI (threaded engine)", 900, 600, 0, &state->window, &state->rendererData.renderer)) {
-        SDL_free(state);
-        return SDL_APP_FAILURE;
-    }
-    SDL_SetWindowResizable(state->window, true);
-    state->rendererData.textEngine = TTF_CreateRendererTextEngine(state->rendererData.renderer);
-    state->rendererData.fonts = SDL_calloc(1, sizeof(TTF_Font*));
-    TTF_Font* font = TTF_OpenFont("external/resources/Roboto-Regular.ttf", 24);
-    if (!font) return SDL_APP_FAILURE;
-    state->rendererData.fonts[FONT_ID] = font;
+typedef struct {
+    PerftEntry* entries; // NULL: no table
+    Uint64 mask;
+} PerftTable;
 
-    uint64_t memSize = Clay_MinMemorySize();
-    Clay_Arena arena = { .memory = SDL_malloc(memSize), .capacity = memSize };
-    int w,h; SDL_GetWindowSize(state->window,&w,&h);
-    Clay_Initialize(arena, (Clay_Dimensions){ (float)w, (float)h }, (Clay_ErrorHandler){ HandleClayErrors });
-    Clay_SetMeasureTextFunction(SDL_MeasureText, state->rendererData.fonts);
+// about megabytes of entries, a power of two of them; false (and no table) without the memory
+static bool perftTableInit(PerftTable* table, size_t megabytes) {
+    table->entries = NULL;
+    table->mask = 0;
+    if (megabytes == 0) return true;
+    Uint64 count = 1;
+    while (count * 2 * sizeof(PerftEntry) <= (Uint64)megabytes << 20) count *= 2;
+    table->entries = SDL_calloc((size_t)count, sizeof(PerftEntry));
+    table->mask = count - 1;
+    return table->entries != NULL;
+}
 
-    state->chess = initChessState();
-    state->engine.mutex = SDL_CreateMutex(); /* returns SDL_Mutex* */
-    state->engine.thread = NULL;
-    state->engine.hasMove = false;
-    state->chess.enginePending = false;
+Uint64 perft(ChessState* chess, int depth, PerftTable* table) {
+    if (depth <= 1) return depth == 1 ? (Uint64)countLegalMoves(chess) : 1; // bulk count the last ply
+    PerftEntry* entry = table->entries ? &table->entries[chess->hashKey & table->mask] : NULL;
+    if (entry) {
+        Uint64 data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+        Uint64 check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+        if ((check ^ data) == chess->hashKey && (int)(data & 0xFF) == depth) return data >> 8;
+    }
+    MoveList moves;
+    getAllMoves(chess, &moves);
+    Uint64 nodes = 0;
+    for (int i = 0; i < moves.count; i++) {
+        UndoInfo undo;
+        makeMove(chess, moves.moves[i], &undo);
+        nodes += perft(chess, depth - 1, table);
+        unmakeMove(chess, moves.moves[i], &undo);
+    }
+    if (entry) {
+        Uint64 data = nodes << 8 | (Uint64)depth;
+        __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->check, chess->hashKey ^ data, __ATOMIC_RELAXED);
+    }
+    return nodes;
+}
 
-    LoadChessTextures(&state->chess, state->rendererData.renderer);
+// the root moves of a perft, taken one at a time by the pool's workers
+typedef struct {
+    const ChessState* root;
+    MoveList moves;
+    Uint64 counts[256]; // by root move
+    int depth;
+    SDL_AtomicInt next;
+    PerftTable* table;
+} PerftJob;
 
-    *appstate = state;
-    return SDL_APP_CONTINUE;
+static int SDLCALL perft_worker(void* data) {
+    PerftJob* job = data;
+    ChessState chess = *job->root; // this worker's own copy to make and unmake the moves on
+    for (int i; (i = SDL_AddAtomicInt(&job->next, 1)) < job->moves.count;) {
+        UndoInfo undo;
+        makeMove(&chess, job->moves.moves[i], &undo);
+        job->counts[i] = perft(&chess, job->depth - 1, job->table);
+        unmakeMove(&chess, job->moves.moves[i], &undo);
+    }
+    return 0;
 }
 
-bool isCheckmate(ChessState* chess) {
-    if (!isKingInCheck(chess, chess->whiteToMove)) return false;
-    MoveList moves = {0}; getAllMoves(chess,&moves);
-    return moves.count == 0;
+// perft of chess on the running pool; with divide, the count of each root move is logged too
+static Uint64 perftParallel(ChessState* chess, int depth, PerftTable* table, bool divide) {
+    PerftJob job = { .root = chess, .depth = depth, .table = table };
+    getAllMoves(chess, &job.moves);
+    SDL_SetAtomicInt(&job.next, 0);
+    if (depth <= 1) return depth == 1 ? (Uint64)job.moves.count : 1;
+    engineRunOnThreads(perft_worker, &job);
+    Uint64 total = 0;
+    for (int i = 0; i < job.moves.count; i++) {
+        char text[MOVE_TEXT_MAX];
+        if (divide) SDL_Log("  %-12s %llu", move2chars(job.moves.moves[i], text), (unsigned long long)job.counts[i]);
+        total += job.counts[i];
+    }
+    return total;
 }
-bool isStalemate(ChessState* chess) {
-    if (isKingInCheck(chess, chess->whiteToMove)) return false;
-    MoveList moves = {0}; getAllMoves(chess,&moves);
-    return moves.count == 0;
+
+static void logPerftSpeed(const char* label, int depth, Uint64 nodes, Uint64 elapsedNS) {
+    double seconds = (double)elapsedNS / 1e9;
+    SDL_Log("%s depth %d: %llu nodes in %.3f s (%.0f nodes/s)", label, depth, (unsigned long long)nodes,
+            seconds, seconds > 0 ? (double)nodes / seconds : 0.0);
 }
 
-SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
-    AppState* state = (AppState*)appstate;
-    switch (event->type) {
-        case SDL_EVENT_QUIT: return SDL_APP_SUCCESS;
-        case SDL_EVENT_WINDOW_RESIZED:
-            Clay_SetLayoutDimensions((Clay_Dimensions){ (float)event->window.data1, (float)event->window.data2 });
-            break;
-        case SDL_EVENT_MOUSE_MOTION:
-            Clay_SetPointerState((Clay_Vector2){ event->motion.x, event->motion.y }, event->motion.state & SDL_BUTTON_LMASK);
-            break;
-        case SDL_EVENT_MOUSE_BUTTON_DOWN: {
-            Clay_SetPointerState((Clay_Vector2){ event->button.x, event->button.y }, event->button.button == SDL_BUTTON_LEFT);
-            if (event->button.button == SDL_BUTTON_LEFT && state) {
-                bool found = false;
-                const bool whitePerspective = true;
+typedef struct {
+    const char* name;
+    const char* fen;
+    int depth;
+    Uint64 expected;
+} PerftCase;
 
-                if (state->chess.whiteToMove == state->chess.engineWhite) return SDL_APP_CONTINUE;
-
-                for (char r = 0; r < 8 && !found; r++) {
-                    char row = whitePerspective ? (char)(7 - r) : r;
-                    for (char c = 0; c < 8 && !found; c++) {
-                        char col = whitePerspective ? (char)(7 - c) : c;
-                        char squareStr[3] = { (char)('A' + col), (char)('1' + row), '\0' };
-                        Clay_String squareIdString = { .chars = squareStr, .length = 2 };
-                        if (Clay_PointerOver(CLAY_SID(squareIdString))) {
-                            PieceType clickedPiece = state->chess.board[row][col];
-                            int selR = state->chess.selectedRow;
-                            int selC = state->chess.selectedCol;
-                            bool hasSelection = (selR >= 0 && selC >= 0);
-
-                            if (hasSelection) {
-                                if (selR == row && selC == col) {
-                                    state->chess.selectedRow = -1; state->chess.selectedCol = -1;
-                                } else if (isLegalMove(&state->chess, selR, selC, row, col)) {
-                                    PieceType moving = state->chess.board[selR][selC];
-                                    Move move = { selR, selC, row, col, state->chess.board[row][col], false, false, false };
-                                    if ((moving == WHITE_KING || moving == BLACK_KING) && selC == 4 && abs(col - selC) == 2) move.isCastling = true;
-                                    if ((moving == WHITE_PAWN && row == 7) || (moving == BLACK_PAWN && row == 0)) move.isPromotion = true;
-                                    if ((moving == WHITE_PAWN || moving == BLACK_PAWN) && selC != col && state->chess.board[row][col] == EMPTY) {
-                                        move.isEnPassant = true;
-                                        int capRow = isWhite(moving) ? row - 1 : row + 1;
-                                        move.captured = state->chess.board[capRow][col];
-                                    }
-
-                                    UndoInfo undo;
-                                    makeMove(&state->chess, move, &undo);
-
-                                    state->chess.selectedRow = -1; state->chess.selectedCol = -1;
-
-                                    SDL_LockMutex(state->engine.mutex);
-                                    if (state->engine.thread == NULL) {
-                                        state->engine.hasMove = false;
-                                        state->engine.thread = SDL_CreateThread(engine_thread_func, "engine", state);
-                                        if (!state->engine.thread) {
-                                            SDL_Log("Failed to create engine thread: %s", SDL_GetError());
-                                        }
-                                    }
-                                    SDL_UnlockMutex(state->engine.mutex);
-
-                                    if (isCheckmate(&state->chess)) printf("CHECKMATE! %s wins!\n", state->chess.whiteToMove ? "Black" : "White");
-                                    else if (isStalemate(&state->chess)) printf("STALEMATE! Draw.\n");
-                                    else if (isKingInCheck(&state->chess, state->chess.whiteToMove)) printf("CHECK!\n");
-                                } else {
-                                    if (clickedPiece != EMPTY && ((state->chess.whiteToMove && !isBlack(clickedPiece)) || (!state->chess.whiteToMove && isBlack(clickedPiece)))) {
-                                        state->chess.selectedRow = row; state->chess.selectedCol = col;
-                                    } else {
-                                        state->chess.selectedRow = -1; state->chess.selectedCol = -1;
-                                    }
-                                }
-                            } else {
-                                if (clickedPiece != EMPTY && ((state->chess.whiteToMove && !isBlack(clickedPiece)) || (!state->chess.whiteToMove && isBlack(clickedPiece)))) {
-                                    state->chess.selectedRow = row; state->chess.selectedCol = col;
-                                }
-                            }
-                            found = true;
-                        }
-                    }
-                }
-            }
-            break;
+// https://www.chessprogramming.org/Perft_Results
+static const PerftCase PERFT_SUITE[] = {
+    { "start",     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609ULL },
+    { "kiwipete",  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603ULL },
+    { "position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624ULL },
+    { "position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333ULL },
+    { "position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487ULL },
+    { "position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594ULL },
+};
+
+// the Polyglot format's own test positions and their keys, so a book probe finds what other programs wrote
+static const struct { const char* fen; Uint64 key; } BOOK_KEY_SUITE[] = {
+    { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9cULL },
+    { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ULL },
+    { "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ULL },
+    { "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ULL },
+    { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ULL },
+    { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ULL },
+    { "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ULL },
+    { "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ULL },
+    { "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ULL },
+};
+
+// returns true when every position matches its known total, and every book key its known key
+static bool runPerftSuite(PerftTable* table) {
+    bool allPassed = true;
+    Uint64 totalNodes = 0, totalNS = 0;
+    for (size_t i = 0; i < SDL_arraysize(PERFT_SUITE); i++) {
+        const PerftCase* pc = &PERFT_SUITE[i];
+        ChessState chess = initChessState();
+        if (!loadFen(&chess, pc->fen)) { SDL_Log("%s: bad FEN", pc->name); allPassed = false; continue; }
+        if (table->entries) SDL_memset(table->entries, 0, (size_t)(table->mask + 1) * sizeof(PerftEntry)); // timed cold
+        Uint64 start = SDL_GetTicksNS();
+        Uint64 nodes = perftParallel(&chess, pc->depth, table, false);
+        Uint64 elapsed = SDL_GetTicksNS() - start;
+        logPerftSpeed(pc->name, pc->depth, nodes, elapsed);
+        if (nodes != pc->expected) {
+            SDL_Log("  FAIL: expected %llu", (unsigned long long)pc->expected);
+            allPassed = false;
         }
-        case SDL_EVENT_MOUSE_WHEEL:
-            Clay_UpdateScrollContainers(true, (Clay_Vector2){ event->wheel.x, event->wheel.y }, 0.01f);
-            break;
-        default:
-            break;
+        totalNodes += nodes; totalNS += elapsed;
     }
-    return SDL_APP_CONTINUE;
+    for (size_t i = 0; i < SDL_arraysize(BOOK_KEY_SUITE); i++) {
+        ChessState chess = initChessState();
+        Uint64 key = loadFen(&chess, BOOK_KEY_SUITE[i].fen) ? bookKey(&chess) : 0;
+        if (key != BOOK_KEY_SUITE[i].key) {
+            SDL_Log("book key %zu: FAIL: %016llx, expected %016llx", i + 1, (unsigned long long)key,
+                    (unsigned long long)BOOK_KEY_SUITE[i].key);
+            allPassed = false;
+        }
+    }
+    double seconds = (double)totalNS / 1e9;
+    SDL_Log("suite %s: %llu nodes in %.3f s (%.0f nodes/s)", allPassed ? "passed" : "FAILED",
+            (unsigned long long)totalNodes, seconds, seconds > 0 ? (double)totalNodes / seconds : 0.0);
+    return allPassed;
 }
 
-SDL_AppResult SDL_AppIterate(void* appstate) {
-    AppState* state = (AppState*)appstate;
-
-    Clay_RenderCommandArray commands = CreateLayout(state);
-    SDL_SetRenderDrawColor(state->rendererData.renderer, 20, 20, 20, 255);
-    SDL_RenderClear(state->rendererData.renderer);
-    SDL_Clay_RenderClayCommands(&state->rendererData, &commands);
-    SDL_RenderPresent(state->rendererData.renderer);
-
-    bool engineReady = false;
-    Move engineMoveLocal = {0};
+/* `perft suite [threads N] [hash MB]` or `perft <depth> [threads N] [hash MB] [fen]`; the FEN may be passed as one
+   argument or as its separate fields. Every logical core by default. */
+static SDL_AppResult runPerftCommand(int argc, char* argv[]) {
+    bool suite = argc >= 3 && SDL_strcmp(argv[2], "suite") == 0;
+    int depth = argc >= 3 ? SDL_atoi(argv[2]) : 0;
+    if (!suite && depth < 1) {
+        SDL_Log("usage: %s perft <depth> [threads N] [hash MB] [fen] | %s perft suite [threads N] [hash MB]", argv[0], argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    int threads = SDL_GetNumLogicalCPUCores();
+    size_t hashMB = PERFT_HASH_MB;
+    int i = 3;
+    for (; i + 1 < argc; i += 2) {
+        if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(argv[i + 1]), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "hash") == 0) hashMB = (size_t)SDL_max(SDL_atoi(argv[i + 1]), 0);
+        else break;
+    }
+    char fen[256] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    if (i < argc) {
+        fen[0] = '\0';
+        for (int first = i; i < argc; i++) {
+            if (i > first) SDL_strlcat(fen, " ", sizeof(fen));
+            SDL_strlcat(fen, argv[i], sizeof(fen));
+        }
+    }
+    ChessState chess = initChessState();
+    if (!suite && !loadFen(&chess, fen)) {
+        SDL_Log("bad FEN: %s", fen);
+        return SDL_APP_FAILURE;
+    }
+    engineInitTables();
+    PerftTable table;
+    if (!perftTableInit(&table, hashMB)) SDL_Log("perft: no memory for the hash table, counting without");
+    if (threads > 1 && !engineStartThreads(threads, false)) SDL_Log("perft: no worker threads, counting on this one");
+    bool passed = true;
+    if (suite) {
+        passed = runPerftSuite(&table);
+    } else {
+        Uint64 start = SDL_GetTicksNS();
+        Uint64 nodes = perftParallel(&chess, depth, &table, true);
+        logPerftSpeed("perft", depth, nodes, SDL_GetTicksNS() - start);
+    }
+    if (threads > 1) engineStopThreads();
+    SDL_free(table.entries);
+    return passed ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+}
 
-    SDL_LockMutex(state->engine.mutex);
-    if (state->engine.hasMove) {
-        engineMoveLocal = state->engine.resultMove;
-        state->engine.hasMove = false;
-        engineReady = true;
+/* `mate <moves> [nodes N] [hash MB] [quiet] [fen]`: is there a forced mate within that many moves, by solveMate.
+   Only checking moves are tried for the attacker unless `quiet` is given. */
+static SDL_AppResult runMateCommand(int argc, char* argv[]) {
+    int moves = argc >= 3 ? SDL_atoi(argv[2]) : 0;
+    if (moves < 1 || moves > MATE_MAX_MOVES) {
+        SDL_Log("usage: %s mate <moves 1-%d> [nodes N] [hash MB] [quiet] [fen]", argv[0], MATE_MAX_MOVES);
+        return SDL_APP_FAILURE;
+    }
+    MateQuery query = { .maxMoves = moves, .checksOnly = true };
+    int i = 3;
+    while (i < argc) {
+        if (SDL_strcmp(argv[i], "quiet") == 0) { query.checksOnly = false; i++; continue; }
+        if (i + 1 >= argc) break;
+        if (SDL_strcmp(argv[i], "nodes") == 0) query.nodeLimit = SDL_strtoull(argv[i + 1], NULL, 10);
+        else if (SDL_strcmp(argv[i], "hash") == 0) query.hashMB = (size_t)SDL_max(SDL_atoi(argv[i + 1]), 1);
+        else break;
+        i += 2;
+    }
+    char fen[256] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    if (i < argc) {
+        fen[0] = '\0';
+        for (int first = i; i < argc; i++) {
+            if (i > first) SDL_strlcat(fen, " ", sizeof(fen));
+            SDL_strlcat(fen, argv[i], sizeof(fen));
+        }
+    }
+    ChessState chess = initChessState();
+    if (!loadFen(&chess, fen)) {
+        SDL_Log("bad FEN: %s", fen);
+        return SDL_APP_FAILURE;
+    }
+    engineInitTables();
+    MateResult result;
+    Uint64 start = SDL_GetTicksNS();
+    if (!solveMate(&chess, &query, &result)) {
+        SDL_Log("mate: no memory for the hash table");
+        return SDL_APP_FAILURE;
+    }
+    double seconds = (double)(SDL_GetTicksNS() - start) / 1e9;
+    const char* mode = query.checksOnly ? "checks only" : "all moves";
+    if (result.mateIn) {
+        char line[2 * MATE_MAX_MOVES * MOVE_SAN_MAX];
+        formatPv(&chess, result.pv, result.pvLength, true, line, sizeof(line));
+        SDL_Log("mate in %d (%s): %s", result.mateIn, mode, line);
+    } else {
+        SDL_Log("%s mate in %d (%s)", result.complete ? "no" : "node limit reached, no", moves, mode);
     }
-    SDL_UnlockMutex(state->engine.mutex);
+    SDL_Log("%llu nodes in %.3f s (%.0f nodes/s)", (unsigned long long)result.nodes, seconds,
+            seconds > 0 ? (double)result.nodes / seconds : 0.0);
+    return SDL_APP_SUCCESS;
+}
 
-    if (engineReady) {
-        UndoInfo undo;
-        makeMove(&state->chess, engineMoveLocal, &undo);
+// search statistics (engineSearchStats, built with SEARCH_STATS) for bench and UCI
+#define STATS_LINE_MAX (MOVE_DEPTH * 12 + 600)
 
-        if (state->engine.thread) {
-            SDL_WaitThread(state->engine.thread, NULL);
-            state->engine.thread = NULL;
-        }
+static double percentOf(Uint64 part, Uint64 whole) { return whole ? 100.0 * (double)part / (double)whole : 0.0; }
 
-        printf("Engine move: %s\n", move2chars(engineMoveLocal));
+/* A search's SearchStats as one line, no newline: the rates, the effective branching factor (the last iteration's
+   nodes over the one before's) and the nodes of each iteration. */
+static void formatSearchStats(const SearchStats* stats, char text[STATS_LINE_MAX]) {
+    int d = stats->depth;
+    double ebf = d >= 2 && stats->iterationNodes[d - 1] ? (double)stats->iterationNodes[d] / (double)stats->iterationNodes[d - 1] : 0.0;
+    int length = SDL_snprintf(text, STATS_LINE_MAX,
+        "nodes %" SDL_PRIu64 " qnodes %.1f%% ebf %.2f cutoffs %" SDL_PRIu64 " first %.1f%% tt %" SDL_PRIu64 " hits %.1f%% "
+        "cutoffs %.1f%% null %" SDL_PRIu64 " cut %.1f%% lmr %" SDL_PRIu64 " re-searched %.1f%% check ext %" SDL_PRIu64
+        " singular %" SDL_PRIu64 " extended %.1f%% rfp %" SDL_PRIu64 " razor %" SDL_PRIu64 " cut %.1f%% futile %" SDL_PRIu64
+        " probcut %" SDL_PRIu64 " cut %" SDL_PRIu64 " multicut %" SDL_PRIu64 " iir %" SDL_PRIu64
+        " countermove %" SDL_PRIu64 " cycle %" SDL_PRIu64 " iterations",
+        stats->nodes, percentOf(stats->qnodes, stats->nodes), ebf, stats->betaCutoffs,
+        percentOf(stats->firstMoveCutoffs, stats->betaCutoffs), stats->ttProbes, percentOf(stats->ttHits, stats->ttProbes),
+        percentOf(stats->ttCutoffs, stats->ttProbes), stats->nullTries, percentOf(stats->nullCutoffs, stats->nullTries),
+        stats->lmrReductions, percentOf(stats->lmrResearches, stats->lmrReductions), stats->checkExtensions,
+        stats->singularTries, percentOf(stats->singularExtensions, stats->singularTries), stats->reverseFutilityCutoffs,
+        stats->razorTries, percentOf(stats->razorCutoffs, stats->razorTries), stats->futilityPrunes,
+        stats->probCutTries, stats->probCutCutoffs, stats->multiCuts, stats->iirReductions,
+        stats->counterMoveCutoffs, stats->cycleCutoffs);
+    for (int i = 1; i <= d && i <= MOVE_DEPTH && length < STATS_LINE_MAX; i++)
+        length += SDL_snprintf(text + length, STATS_LINE_MAX - length, " %" SDL_PRIu64, stats->iterationNodes[i]);
+}
 
-        if (isCheckmate(&state->chess)) printf("CHECKMATE! %s wins!\n", state->chess.whiteToMove ? "Black" : "White");
-        else if (isStalemate(&state->chess)) printf("STALEMATE! Draw.\n");
-        else if (isKingInCheck(&state->chess, state->chess.whiteToMove)) printf("CHECK!\n");
-    }
+// engineTraceWrite, with a word for whoever asked for it
+static void writeTrace(const char* path) {
+    SDL_ClearError();
+    if (engineTraceWrite(path)) SDL_Log("trace written to %s", path);
+    else SDL_Log("no trace written to %s: %s", path, SDL_GetError()[0] ? SDL_GetError() : "not built with SEARCH_TRACE");
+}
 
-    return SDL_APP_CONTINUE;
+/* Search log: `main searchlog FILE` prints a log engineSearchLogOpen wrote (`uci searchlog`, `serve searchlog`),
+   a line a record in time order, each timed from the start of its search: the limits it was given, the
+   iterations with their best moves and scores, the best move changing, the clock checks, an iteration given up
+   and why, the helper threads coming and going, and the answer. */
+static int compareSearchLogRecords(const void* a, const void* b) {
+    const SearchLogRecord* x = *(const SearchLogRecord* const*)a;
+    const SearchLogRecord* y = *(const SearchLogRecord* const*)b;
+    if (x->timeNS != y->timeNS) return x->timeNS < y->timeNS ? -1 : 1;
+    if (x->thread != y->thread) return x->thread - y->thread;
+    return x < y ? -1 : x > y; // a thread's own as they were written
 }
 
-void SDL_AppQuit(void* appstate, SDL_AppResult result) {
+static SDL_AppResult runSearchLogCommand(int argc, char* argv[]) {
+    if (argc < 3) { SDL_Log("usage: %s searchlog FILE", argv[0]); return SDL_APP_FAILURE; }
+    size_t size = 0;
+    Uint8* data = SDL_LoadFile(argv[2], &size);
+    if (!data) { SDL_Log("searchlog: can't read %s: %s", argv[2], SDL_GetError()); return SDL_APP_FAILURE; }
+    SearchLogHeader header;
+    if (size >= sizeof(header)) SDL_memcpy(&header, data, sizeof(header));
+    if (size < sizeof(header) || SDL_memcmp(header.magic, "CHESSLOG", 8) != 0 || header.version != SEARCH_LOG_VERSION ||
+        header.recordSize != sizeof(SearchLogRecord)) {
+        SDL_Log("searchlog: %s isn't a search log this program can read", argv[2]);
+        SDL_free(data);
+        return SDL_APP_FAILURE;
+    }
+    size_t count = (size - sizeof(header)) / sizeof(SearchLogRecord);
+    const SearchLogRecord* records = (const SearchLogRecord*)(data + sizeof(header));
+    Uint32 searches = 0;
+    for (size_t i = 0; i < count; i++) searches = SDL_max(searches, records[i].search);
+    const SearchLogRecord** order = SDL_malloc(SDL_max(count, 1) * sizeof(*order));
+    Uint64* starts = SDL_calloc((size_t)searches + 1, sizeof(Uint64)); // by search, its SEARCH_LOG_START's time
+    if (!order || !starts) {
+        SDL_Log("searchlog: out of memory");
+        SDL_free(order);
+        SDL_free(starts);
+        SDL_free(data);
+        return SDL_APP_FAILURE;
+    }
+    for (size_t i = 0; i < count; i++) {
+        order[i] = &records[i];
+        if (records[i].kind == SEARCH_LOG_START) starts[records[i].search] = records[i].timeNS;
+    }
+    SDL_qsort(order, count, sizeof(*order), compareSearchLogRecords);
+    static const char* const ABORTS[] = { "stopped", "out of time", "out of nodes" };
+    for (size_t i = 0; i < count; i++) {
+        const SearchLogRecord* r = order[i];
+        Uint64 start = starts[r->search] && starts[r->search] <= r->timeNS ? starts[r->search] : order[0]->timeNS;
+        char move[6] = "0000";
+        if (r->move != MOVE_NONE) moveToCoordinates(r->move, move);
+        printf("search %u %+11.3f ms thread %u ", (unsigned)r->search, (double)(r->timeNS - start) / 1e6, (unsigned)r->thread);
+        switch (r->kind) {
+        case SEARCH_LOG_START:
+            printf("start depth %d soft %d ms hard %" SDL_PRIu64 " ms\n", r->depth, (int)r->score, r->value);
+            break;
+        case SEARCH_LOG_ITERATION:
+            printf("iteration depth %d score %d best %s nodes %" SDL_PRIu64 "\n", r->depth, (int)r->score, move, r->value);
+            break;
+        case SEARCH_LOG_PV_CHANGE: {
+            char before[6] = "0000";
+            if ((Move)r->value != MOVE_NONE) moveToCoordinates((Move)r->value, before);
+            printf("pv change depth %d score %d best %s was %s\n", r->depth, (int)r->score, move, before);
+            break;
+        }
+        case SEARCH_LOG_TIME_CHECK:
+            printf("time check %.3f ms%s\n", (double)r->value / 1e6, r->score ? " out of time" : "");
+            break;
+        case SEARCH_LOG_ABORT:
+            printf("abort depth %d %s nodes %" SDL_PRIu64 "\n", r->depth,
+                   r->score >= 0 && r->score < (int)SDL_arraysize(ABORTS) ? ABORTS[r->score] : "?", r->value);
+            break;
+        case SEARCH_LOG_THREAD_START: printf("thread start\n"); break;
+        case SEARCH_LOG_THREAD_STOP: printf("thread stop nodes %" SDL_PRIu64 "\n", r->value); break;
+        case SEARCH_LOG_END:
+            printf("end depth %d score %d bestmove %s nodes %" SDL_PRIu64 "\n", r->depth, (int)r->score, move, r->value);
+            break;
+        case SEARCH_LOG_DROPPED: printf("dropped %" SDL_PRIu64 " records, the ring was full\n", r->value); break;
+        default: printf("unknown record %u\n", (unsigned)r->kind); break;
+        }
+    }
+    if (size > sizeof(header) + count * sizeof(SearchLogRecord)) SDL_Log("searchlog: %s ends part way through a record", argv[2]);
+    SDL_free(order);
+    SDL_free(starts);
+    SDL_free(data);
+    return SDL_APP_SUCCESS;
+}
+
+/* Search tree: `main searchtree FILE [records]` sums up the samples engineSearchTreeWrite wrote (`bench tree`):
+   by depth, what share of the nodes the hash table, the pruning, a cutoff or a failing low ended, how often the
+   first move cut off and what a node's subtree cost; how each kind of pruning did when tried; where the moves
+   that cut off came from in the picker, and how far down the list; and the costliest subtrees sampled, the ones
+   that blew up. `records` prints every record instead, a tab-separated line each, for other tools to plot. */
+#define SEARCH_TREE_COSTLIEST 10
+
+static const char* const SEARCH_TREE_OUTCOME_NAMES[SEARCH_TREE_OUTCOMES] = {
+    "quiescence", "draw", "tablebase", "mate distance", "hash cut", "reverse futility", "razor", "null move",
+    "probcut", "multicut", "beta cut", "fail low", "exact", "no moves" };
+static const char* const SEARCH_TREE_SOURCE_NAMES[SEARCH_TREE_SOURCES] = {
+    "hash", "capture", "killer", "counter", "quiet", "bad capture", "underpromotion", "evasion" };
+
+static int compareSearchTreeCost(const void* a, const void* b) {
+    const SearchTreeRecord* x = *(const SearchTreeRecord* const*)a;
+    const SearchTreeRecord* y = *(const SearchTreeRecord* const*)b;
+    return x->nodes != y->nodes ? (x->nodes < y->nodes ? 1 : -1) : (x < y ? -1 : x > y);
+}
+
+static SDL_AppResult runSearchTreeCommand(int argc, char* argv[]) {
+    if (argc < 3 || (argc > 3 && SDL_strcmp(argv[3], "records") != 0)) {
+        SDL_Log("usage: %s searchtree FILE [records]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    size_t size = 0;
+    Uint8* data = SDL_LoadFile(argv[2], &size);
+    if (!data) { SDL_Log("searchtree: can't read %s: %s", argv[2], SDL_GetError()); return SDL_APP_FAILURE; }
+    SearchTreeHeader header;
+    if (size >= sizeof(header)) SDL_memcpy(&header, data, sizeof(header));
+    if (size < sizeof(header) || SDL_memcmp(header.magic, "CHESSTRE", 8) != 0 || header.version != SEARCH_TREE_VERSION ||
+        header.recordSize != sizeof(SearchTreeRecord)) {
+        SDL_Log("searchtree: %s isn't a search tree sample this program can read", argv[2]);
+        SDL_free(data);
+        return SDL_APP_FAILURE;
+    }
+    size_t count = (size - sizeof(header)) / sizeof(SearchTreeRecord);
+    const SearchTreeRecord* records = (const SearchTreeRecord*)(data + sizeof(header));
+    if (argc > 3) {
+        printf("search\tthread\tply\tdepth\talpha\tbeta\tscore\toutcome\tflags\tmoves\tpruned\tcut\tsource\tnodes\n");
+        for (size_t i = 0; i < count; i++) {
+            const SearchTreeRecord* r = &records[i];
+            printf("%u\t%u\t%u\t%u\t%d\t%d\t%d\t%s\t%u\t%u\t%u\t%u\t%s\t%" SDL_PRIu64 "\n", (unsigned)r->search,
+                   (unsigned)r->thread, (unsigned)r->ply, (unsigned)r->depth, (int)r->alpha, (int)r->beta, (int)r->score,
+                   r->outcome < SEARCH_TREE_OUTCOMES ? SEARCH_TREE_OUTCOME_NAMES[r->outcome] : "?", (unsigned)r->flags,
+                   (unsigned)r->moves, (unsigned)r->pruned, (unsigned)r->cutIndex,
+                   r->outcome == SEARCH_TREE_BETA_CUT && r->cutIndex && r->cutSource < SEARCH_TREE_SOURCES
+                   ? SEARCH_TREE_SOURCE_NAMES[r->cutSource] : "-", r->nodes);
+        }
+        SDL_free(data);
+        return SDL_APP_SUCCESS;
+    }
+
+    // by depth, the outcomes grouped: hash cut, pruned before the moves, beta cut, fail low or exact, the rest
+    enum { DEPTHS = 64 };
+    Uint64 samples[DEPTHS + 1] = { 0 }, nodes[DEPTHS + 1] = { 0 }, hash[DEPTHS + 1] = { 0 }, pruned[DEPTHS + 1] = { 0 };
+    Uint64 cuts[DEPTHS + 1] = { 0 }, firstCuts[DEPTHS + 1] = { 0 }, cutIndices[DEPTHS + 1] = { 0 }, low[DEPTHS + 1] = { 0 };
+    Uint64 exact[DEPTHS + 1] = { 0 }, lowMoves[DEPTHS + 1] = { 0 };
+    Uint64 outcomes[SEARCH_TREE_OUTCOMES] = { 0 }, outcomeNodes[SEARCH_TREE_OUTCOMES] = { 0 };
+    Uint64 sources[SEARCH_TREE_SOURCES] = { 0 }, sourceIndices[SEARCH_TREE_SOURCES] = { 0 };
+    Uint64 nullTried = 0, nullCut = 0, probCutTried = 0, probCutCut = 0, tests = 0, singular = 0, multiCut = 0;
+    Uint64 reduced = 0, futile = 0, looked = 0, total = 0;
+    Uint32 searches = 0;
+    for (size_t i = 0; i < count; i++) {
+        const SearchTreeRecord* r = &records[i];
+        int d = SDL_min(r->depth, DEPTHS), outcome = SDL_min(r->outcome, SEARCH_TREE_OUTCOMES - 1);
+        searches = SDL_max(searches, r->search);
+        samples[d]++;
+        nodes[d] += r->nodes;
+        total += r->nodes;
+        outcomes[outcome]++;
+        outcomeNodes[outcome] += r->nodes;
+        if (outcome == SEARCH_TREE_HASH_CUT) hash[d]++;
+        else if (outcome >= SEARCH_TREE_REVERSE_FUTILITY && outcome <= SEARCH_TREE_MULTICUT) pruned[d]++;
+        else if (outcome == SEARCH_TREE_BETA_CUT) {
+            cuts[d]++;
+            if (r->cutIndex == 1) firstCuts[d]++;
+            cutIndices[d] += r->cutIndex;
+            if (r->cutIndex && r->cutSource < SEARCH_TREE_SOURCES) {
+                sources[r->cutSource]++;
+                sourceIndices[r->cutSource] += r->cutIndex;
+            }
+        } else if (outcome == SEARCH_TREE_FAIL_LOW) { low[d]++; lowMoves[d] += r->moves; }
+        else if (outcome == SEARCH_TREE_EXACT) exact[d]++;
+        if (r->flags & SEARCH_TREE_NULL_TRIED) { nullTried++; nullCut += outcome == SEARCH_TREE_NULL_MOVE; }
+        if (r->flags & SEARCH_TREE_PROBCUT_TRIED) { probCutTried++; probCutCut += outcome == SEARCH_TREE_PROBCUT; }
+        if (r->flags & SEARCH_TREE_EXCLUDED) tests++;
+        singular += (r->flags & SEARCH_TREE_SINGULAR) != 0;
+        multiCut += outcome == SEARCH_TREE_MULTICUT;
+        reduced += (r->flags & SEARCH_TREE_REDUCED) != 0;
+        futile += r->pruned;
+        looked += r->moves;
+    }
+    printf("%zu samples of %u searches, %.3g%% of the nodes kept (%" SDL_PRIu64 " dropped), the subtrees %" SDL_PRIu64 " nodes\n",
+           count, (unsigned)searches, header.sample * 100, header.dropped, total);
+    printf("\ndepth  samples  nodes/sample  hash%%  pruned%%  cut%%  first%%  index  low%%  moves  exact%%\n");
+    for (int d = 0; d <= DEPTHS; d++) {
+        if (!samples[d]) continue;
+        double n = (double)samples[d];
+        printf("%4d%s %8" SDL_PRIu64 " %13.1f %6.1f %8.1f %5.1f %7.1f %6.2f %5.1f %6.1f %7.1f\n", d, d == DEPTHS ? "+" : " ",
+               samples[d], nodes[d] / n, hash[d] * 100 / n, pruned[d] * 100 / n, cuts[d] * 100 / n,
+               cuts[d] ? firstCuts[d] * 100.0 / cuts[d] : 0.0, cuts[d] ? (double)cutIndices[d] / cuts[d] : 0.0,
+               low[d] * 100 / n, low[d] ? (double)lowMoves[d] / low[d] : 0.0, exact[d] * 100 / n);
+    }
+    printf("\noutcome            samples      %%   subtree nodes %%\n");
+    for (int o = 0; o < SEARCH_TREE_OUTCOMES; o++)
+        if (outcomes[o])
+            printf("%-16s %9" SDL_PRIu64 " %6.2f %8.2f\n", SEARCH_TREE_OUTCOME_NAMES[o], outcomes[o],
+                   outcomes[o] * 100.0 / (double)SDL_max(count, 1), outcomeNodes[o] * 100.0 / (double)SDL_max(total, 1));
+    printf("\npruning: null move cut %.1f%% of %" SDL_PRIu64 " tries, probcut %.1f%% of %" SDL_PRIu64 ", singular tests %"
+           SDL_PRIu64 " (extended %" SDL_PRIu64 ", multicut %" SDL_PRIu64 "), iir %" SDL_PRIu64 ", futility %.1f%% of the moves\n",
+           nullTried ? nullCut * 100.0 / nullTried : 0.0, nullTried, probCutTried ? probCutCut * 100.0 / probCutTried : 0.0,
+           probCutTried, tests, singular, multiCut, reduced, looked ? futile * 100.0 / looked : 0.0);
+    printf("\ncutoff from       cuts      %%  index\n");
+    Uint64 sourced = 0;
+    for (int s = 0; s < SEARCH_TREE_SOURCES; s++) sourced += sources[s];
+    for (int s = 0; s < SEARCH_TREE_SOURCES; s++)
+        if (sources[s])
+            printf("%-14s %8" SDL_PRIu64 " %6.2f %6.2f\n", SEARCH_TREE_SOURCE_NAMES[s], sources[s], sources[s] * 100.0 / sourced,
+                   (double)sourceIndices[s] / sources[s]);
+
+    const SearchTreeRecord** order = SDL_malloc(SDL_max(count, 1) * sizeof(*order));
+    if (order) {
+        for (size_t i = 0; i < count; i++) order[i] = &records[i];
+        SDL_qsort(order, count, sizeof(*order), compareSearchTreeCost);
+        printf("\ncostliest   nodes  search  ply  depth  window           outcome          moves  cut\n");
+        for (size_t i = 0; i < SDL_min(count, (size_t)SEARCH_TREE_COSTLIEST); i++) {
+            const SearchTreeRecord* r = order[i];
+            char window[32];
+            SDL_snprintf(window, sizeof(window), "[%d, %d]%s", (int)r->alpha, (int)r->beta, r->flags & SEARCH_TREE_PV ? " pv" : "");
+            printf("%15" SDL_PRIu64 " %7u %4u %6u  %-16s %-16s %5u %4u\n", r->nodes, (unsigned)r->search, (unsigned)r->ply,
+                   (unsigned)r->depth, window, r->outcome < SEARCH_TREE_OUTCOMES ? SEARCH_TREE_OUTCOME_NAMES[r->outcome] : "?",
+                   (unsigned)r->moves, (unsigned)r->cutIndex);
+        }
+        SDL_free(order);
+    }
+    if (size > sizeof(header) + count * sizeof(SearchTreeRecord)) SDL_Log("searchtree: %s ends part way through a record", argv[2]);
+    SDL_free(data);
+    return SDL_APP_SUCCESS;
+}
+
+/* Bench: `main bench [depth N] [hash MB] [trace FILE] [json FILE] [counters LIST] [tree FILE] [sample FRACTION]` searches BENCH_POSITIONS (bench.h) one after another on this thread, each to the same
+   depth from an empty hash table and evaluation cache, and gives the nodes, the time and the speed. The node count
+   depends on nothing but the search and evaluation code, so it's the engine's signature: a change that is only
+   meant to make it faster has to leave it as it was, and one that changes it changes how the engine plays. `json`
+   writes the speed and the signature to a benchmark record for benchcompare; `counters` gives the hardware's
+   counts over the searches, a node's share of each (HardwareCounter). An engine built with EVAL_PROFILE gives each
+   evaluation term's cycles an evaluation and the average size of what it adds where it's worked out; one built with
+   SEARCH_TREE writes the `sample` of the nodes, by default SEARCH_TREE_SAMPLE, to the `tree` file (searchtree). It's also the training run of the
+   profile-guided release build (the "release (pgo)" task), so what it searches is what the compiler optimises for. */
+#define BENCH_DEPTH 9
+#define BENCH_HASH_MB 16
+
+// the evaluation profile (EvalProfile), a line a term: its cycles over every evaluation, and its average size
+static void logEvalProfile(const EvalProfile* profile) {
+    static const char* const TERM_NAMES[EVAL_PROFILE_TERMS] = { "material+pst", "bishop pair", "mobility", "center",
+                                                                "pawns", "king safety" };
+    double calls = (double)profile->calls;
+    SDL_Log("eval profile: %llu evaluations, %.1f%% cached, %.1f%% endings, %.1f%% lazy", (unsigned long long)profile->calls,
+            profile->cacheHits * 100.0 / calls, profile->endings * 100.0 / calls, profile->lazyExits * 100.0 / calls);
+    for (int t = 0; t < EVAL_PROFILE_TERMS; t++) {
+        double evaluated = (double)SDL_max(profile->evaluated[t], 1);
+        SDL_Log("  %-13s %7.1f cycles/eval  %5.1f%% worked out  %6.1f cp average", TERM_NAMES[t],
+                (double)profile->cycles[t] / calls, profile->evaluated[t] * 100.0 / calls,
+                (double)profile->magnitude[t] / evaluated);
+    }
+}
+
+static SDL_AppResult runBenchCommand(int argc, char* argv[]) {
+    int depth = BENCH_DEPTH;
+    size_t hashMB = BENCH_HASH_MB;
+    const char* tracePath = NULL;
+    const char* jsonPath = NULL;
+    const char* counterList = NULL;
+    const char* treePath = NULL;
+    double sample = SEARCH_TREE_SAMPLE;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1]; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "depth") == 0) depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH);
+        else if (SDL_strcmp(argv[i], "hash") == 0) hashMB = (size_t)SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "trace") == 0) tracePath = value;
+        else if (SDL_strcmp(argv[i], "json") == 0) jsonPath = value;
+        else if (SDL_strcmp(argv[i], "counters") == 0) counterList = value;
+        else if (SDL_strcmp(argv[i], "tree") == 0) treePath = value;
+        else if (SDL_strcmp(argv[i], "sample") == 0) sample = SDL_atof(value);
+        else { SDL_Log("bench: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    engineInitTables();
+    Engine* engine = engineCreate();
+    if (!engine || !engineSetHash(engine, hashMB)) {
+        SDL_Log("bench: out of memory");
+        engineDestroy(engine);
+        return SDL_APP_FAILURE;
+    }
+    engine->options.deterministic = true; // the same nodes every run, whatever threads the process has
+    if (treePath && !engineSearchTreeSample(sample)) {
+        SDL_Log("bench: no search tree for %s: not built with SEARCH_TREE", treePath);
+        treePath = NULL;
+    }
+    HardwareCounters counters = { .count = 0 };
+    if (counterList && !countersOpen(&counters, counterList)) SDL_Log("bench: %s", SDL_GetError());
+    SearchLimits limits = { .depth = depth };
+    Uint64 totalNodes = 0, totalNS = 0;
+    SearchStats stats, totalStats = { 0 }; // only with SEARCH_STATS
+    for (size_t i = 0; i < SDL_arraysize(BENCH_POSITIONS); i++) {
+        ChessState chess = initChessState();
+        loadFen(&chess, BENCH_POSITIONS[i]);
+        engineNewGame(engine);
+        engineClearEvalCache();
+        RootMoves root;
+        Uint64 start = SDL_GetTicksNS();
+        countersResume(&counters);
+        Move best = engineSearch(engine, &chess, &limits, &root);
+        countersPause(&counters);
+        totalNS += SDL_GetTicksNS() - start;
+        Uint64 nodes = engineNodeCount(engine);
+        totalNodes += nodes;
+        char move[6] = "0000";
+        if (best != MOVE_NONE) moveToCoordinates(best, move);
+        SDL_Log("position %2zu: %s %10llu nodes", i + 1, move, (unsigned long long)nodes);
+        if (engineSearchStats(engine, &stats)) engineAddSearchStats(&totalStats, &stats);
+    }
+    engineDestroy(engine);
+    if (totalStats.nodes > 0) {
+        char line[STATS_LINE_MAX];
+        formatSearchStats(&totalStats, line);
+        SDL_Log("stats: %s", line);
+    }
+    EvalProfile profile;
+    if (engineEvalProfile(&profile) && profile.calls > 0) logEvalProfile(&profile);
+    if (tracePath) writeTrace(tracePath);
+    if (treePath) {
+        if (engineSearchTreeWrite(treePath)) SDL_Log("search tree samples written to %s", treePath);
+        else SDL_Log("bench: can't write %s: %s", treePath, SDL_GetError());
+    }
+    double seconds = (double)totalNS / 1e9;
+    SDL_Log("bench: %zu positions at depth %d, %llu nodes in %.3f s (%.0f nodes/s)", SDL_arraysize(BENCH_POSITIONS), depth,
+            (unsigned long long)totalNodes, seconds, seconds > 0 ? (double)totalNodes / seconds : 0.0);
+    if (counters.count > 0) {
+        CounterValues counted;
+        char line[256];
+        countersRead(&counters, &counted);
+        countersClose(&counters);
+        SDL_Log("counters a node: %s", formatCounters(&counted, totalNodes, line, sizeof(line)));
+    }
+    if (jsonPath) {
+        BenchResult speed = { .value = seconds > 0 ? (double)totalNodes / seconds : 0.0 };
+        SDL_snprintf(speed.name, sizeof(speed.name), "nps depth %d", depth); // another depth is other work
+        if (!writeBenchRecord(jsonPath, "bench", totalNodes, &speed, 1)) {
+            SDL_Log("bench: can't write %s: %s", jsonPath, SDL_GetError());
+            return SDL_APP_FAILURE;
+        }
+    }
+    return SDL_APP_SUCCESS;
+}
+
+/* Regression check: `main benchcompare <baseline.json> <new.json> [threshold PCT]` reads two benchmark records
+   (bench.h) of the same kind, and compares each result of the baseline with the new one's: a change for the worse
+   larger than the threshold, or than the two results' spreads added up if that's more, is a regression, and any
+   regression makes the command fail. A different processor, compiler or bench signature is pointed out, as the
+   numbers then don't measure the same thing. Only records as bench and microbench write them are understood. */
+#define BENCH_COMPARE_THRESHOLD 3.0 // percent
+
+typedef struct {
+    char kind[16], compiler[80], options[64], cpu[64];
+    Uint64 signature;
+    BenchResult results[BENCH_RECORD_MAX];
+    int count;
+} BenchRecord;
+
+// where key's value starts in [p, end), or NULL
+static const char* jsonValue(const char* p, const char* end, const char* key) {
+    size_t length = SDL_strlen(key);
+    for (; p + length + 2 <= end; p++) {
+        if (*p != '"' || SDL_memcmp(p + 1, key, length) != 0 || p[length + 1] != '"') continue;
+        const char* value = p + length + 2;
+        while (value < end && (*value == ' ' || *value == '\t' || *value == '\r' || *value == '\n')) value++;
+        if (value >= end || *value != ':') continue;
+        value++;
+        while (value < end && (*value == ' ' || *value == '\t' || *value == '\r' || *value == '\n')) value++;
+        return value;
+    }
+    return NULL;
+}
+
+static void jsonText(const char* value, const char* end, char* text, size_t size) {
+    size_t n = 0;
+    if (value && value < end && *value == '"') {
+        for (const char* c = value + 1; c < end && *c != '"' && n + 1 < size; c++) {
+            if (*c == '\\' && c + 1 < end) c++;
+            text[n++] = *c;
+        }
+    }
+    text[n] = '\0';
+}
+
+static double jsonNumber(const char* value, const char* end) {
+    char number[40];
+    size_t n = 0;
+    while (value && value + n < end && n + 1 < sizeof(number) && SDL_strchr("+-.0123456789eE", value[n])) n++;
+    if (n > 0) SDL_memcpy(number, value, n);
+    number[n] = '\0';
+    return SDL_strtod(number, NULL);
+}
+
+static bool readBenchRecord(const char* path, BenchRecord* record) {
+    MappedFile file;
+    if (!mapFile(&file, path)) {
+        SDL_Log("benchcompare: can't read %s: %s", path, SDL_GetError());
+        return false;
+    }
+    *record = (BenchRecord){ 0 };
+    const char* p = file.data;
+    const char* end = p + file.size;
+    const char* results = jsonValue(p, end, "results");
+    const char* header = results ? results : end; // the build fields, before the results
+    jsonText(jsonValue(p, header, "kind"), header, record->kind, sizeof(record->kind));
+    jsonText(jsonValue(p, header, "compiler"), header, record->compiler, sizeof(record->compiler));
+    jsonText(jsonValue(p, header, "options"), header, record->options, sizeof(record->options));
+    jsonText(jsonValue(p, header, "cpu"), header, record->cpu, sizeof(record->cpu));
+    const char* signature = jsonValue(p, header, "signature");
+    if (signature) record->signature = SDL_strtoull(signature, NULL, 10);
+    for (const char* object = results; object && record->count < BENCH_RECORD_MAX;) {
+        while (object < end && *object != '{' && *object != ']') object++;
+        if (object >= end || *object == ']') break;
+        const char* close = object;
+        while (close < end && *close != '}') close++;
+        BenchResult* result = &record->results[record->count];
+        jsonText(jsonValue(object, close, "name"), close, result->name, sizeof(result->name));
+        result->value = jsonNumber(jsonValue(object, close, "value"), close);
+        result->spread = jsonNumber(jsonValue(object, close, "spread"), close);
+        const char* lower = jsonValue(object, close, "lower");
+        result->lowerIsBetter = lower && *lower == 't';
+        if (result->name[0]) record->count++;
+        object = close;
+    }
+    unmapFile(&file);
+    if (!record->kind[0] || record->count == 0) {
+        SDL_Log("benchcompare: %s is not a benchmark record", path);
+        return false;
+    }
+    return true;
+}
+
+static SDL_AppResult runBenchCompareCommand(int argc, char* argv[]) {
+    double threshold = BENCH_COMPARE_THRESHOLD;
+    if (argc < 4 || (argc != 4 && (argc != 6 || SDL_strcmp(argv[4], "threshold") != 0))) {
+        SDL_Log("usage: %s benchcompare <baseline.json> <new.json> [threshold PCT]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    if (argc == 6) threshold = SDL_max(SDL_atof(argv[5]), 0.0);
+    static BenchRecord baseline, current;
+    if (!readBenchRecord(argv[2], &baseline) || !readBenchRecord(argv[3], &current)) return SDL_APP_FAILURE;
+    if (SDL_strcmp(baseline.kind, current.kind) != 0) {
+        SDL_Log("benchcompare: a %s record can't be compared with a %s one", baseline.kind, current.kind);
+        return SDL_APP_FAILURE;
+    }
+    if (SDL_strcmp(baseline.cpu, current.cpu) != 0) SDL_Log("note: the baseline ran on %s, this on %s", baseline.cpu, current.cpu);
+    if (SDL_strcmp(baseline.compiler, current.compiler) != 0 || SDL_strcmp(baseline.options, current.options) != 0)
+        SDL_Log("note: the baseline was built by %s (%s), this by %s (%s)", baseline.compiler, baseline.options,
+                current.compiler, current.options);
+    if (baseline.signature != current.signature)
+        SDL_Log("note: the bench signature changed, %" SDL_PRIu64 " to %" SDL_PRIu64 ": the search itself is different",
+                baseline.signature, current.signature);
+    int regressions = 0;
+    for (int i = 0; i < baseline.count; i++) {
+        const BenchResult* base = &baseline.results[i];
+        const BenchResult* now = NULL;
+        for (int j = 0; j < current.count && !now; j++)
+            if (SDL_strcmp(current.results[j].name, base->name) == 0) now = &current.results[j];
+        if (!now) { SDL_Log("%-16s missing from %s", base->name, argv[3]); continue; }
+        double change = base->value != 0 ? (now->value / base->value - 1) * 100 : 0.0;
+        double worse = base->lowerIsBetter ? change : -change;
+        double noise = SDL_max(threshold, base->spread + now->spread);
+        const char* verdict = worse > noise ? "  REGRESSION" : worse < -noise ? "  better" : "";
+        if (worse > noise) regressions++;
+        SDL_Log("%-16s %14.2f -> %14.2f  %+7.2f%%  (noise %.2f%%)%s", base->name, base->value, now->value, change, noise, verdict);
+    }
+    SDL_Log("benchcompare: %d regression%s beyond the noise", regressions, regressions == 1 ? "" : "s");
+    return regressions ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+}
+
+/* Parallel scaling: `main scaling [threads N] [depth N] [hash MB] [smp lazy|root|split] [spin US]` runs the bench positions
+   through the threaded search (engineSubmit, exactly as UCI and the window search) with 1, 2, 4 ... threads up to
+   N (all the logical cores by default), and compares each thread count with one thread: the speedup in time to the
+   same depth, the speedup in nodes per second, the search overhead (the extra nodes the threads searched between
+   them to get there) and the share of the time each thread sat idle (engineThreadActivity). Then how the workers
+   got their jobs (engineThreadWakeups): the time from submit to a worker starting, how many it saw while still
+   spinning rather than being woken, and the share of the workers' time spent spinning with nothing to do. `smp`
+   picks the parallel search: Lazy SMP (the default), splitting the root moves, or split points at interior nodes;
+   `spin` how long an idle worker spins before it sleeps, in microseconds (engineSetThreadSpin). */
+#define SCALING_DEPTH 8
+
+typedef struct {
+    Uint64 ns, nodes;
+    double idle[MAX_POOL_THREADS + 1]; // [0] the thread the search runs on, then the pool's workers
+    int workers;
+    ThreadWakeups wakeups;
+} ScalingRun;
+
+// the bench positions at one thread count
+static bool runScaling(int threads, int depth, size_t hashMB, const SearchOptions* options, ScalingRun* run) {
+    if (!engineStartThreads(threads, false)) return false;
+    Engine* engine = engineCreate();
+    if (!engine || !engineSetHash(engine, hashMB)) {
+        engineDestroy(engine);
+        engineStopThreads();
+        return false;
+    }
+    engine->options = *options;
+    Uint64 busyBefore[MAX_POOL_THREADS], busyAfter[MAX_POOL_THREADS], waitBefore, waitAfter;
+    int workers = engineThreadActivity(busyBefore, &waitBefore);
+    SearchLimits limits = { .depth = depth };
+    *run = (ScalingRun){ 0 };
+    bool ok = true;
+    for (size_t i = 0; i < SDL_arraysize(BENCH_POSITIONS) && ok; i++) {
+        ChessState chess = initChessState();
+        loadFen(&chess, BENCH_POSITIONS[i]);
+        engineNewGame(engine);
+        engineClearEvalCache();
+        Uint64 start = SDL_GetTicksNS();
+        EngineRequest* request = engineSubmit(engine, &chess, &limits, NULL, NULL, NULL);
+        if (!request) { ok = false; break; }
+        engineRequestWait(request);
+        engineRequestFree(request);
+        run->ns += SDL_GetTicksNS() - start;
+        run->nodes += engineNodeCount(engine);
+    }
+    engineThreadActivity(busyAfter, &waitAfter);
+    engineThreadWakeups(&run->wakeups); // a pool of its own, started above: all of it this run's
+    run->workers = workers;
+    engineDestroy(engine);
+    engineStopThreads();
+    double wall = SDL_max((double)run->ns, 1.0);
+    run->idle[0] = SDL_clamp((double)(waitAfter - waitBefore) / wall, 0.0, 1.0);
+    for (int i = 0; i < workers; i++) run->idle[i + 1] = SDL_clamp(1.0 - (double)(busyAfter[i] - busyBefore[i]) / wall, 0.0, 1.0);
+    return ok;
+}
+
+static SDL_AppResult runScalingCommand(int argc, char* argv[]) {
+    int maxThreads = SDL_min(SDL_GetNumLogicalCPUCores(), MAX_POOL_THREADS), depth = SCALING_DEPTH;
+    size_t hashMB = BENCH_HASH_MB;
+    SearchOptions options = DEFAULT_SEARCH_OPTIONS;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (SDL_strcmp(argv[i], "threads") == 0) maxThreads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "depth") == 0) depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH);
+        else if (SDL_strcmp(argv[i], "hash") == 0) hashMB = (size_t)SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "smp") == 0 && SDL_strcmp(value, "lazy") == 0) options.lazySmp = true, options.splitPoints = false;
+        else if (SDL_strcmp(argv[i], "smp") == 0 && SDL_strcmp(value, "root") == 0) options.lazySmp = false, options.splitPoints = false;
+        else if (SDL_strcmp(argv[i], "smp") == 0 && SDL_strcmp(value, "split") == 0) options.lazySmp = false, options.splitPoints = true;
+        else if (SDL_strcmp(argv[i], "spin") == 0) engineSetThreadSpin(SDL_atoi(value));
+        else {
+            SDL_Log("usage: %s scaling [threads N] [depth N] [hash MB] [smp lazy|root|split] [spin US]", argv[0]);
+            return SDL_APP_FAILURE;
+        }
+    }
+    engineInitTables();
+    ScalingRun base = { 0 };
+    for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2) {
+        ScalingRun run;
+        if (!runScaling(threads, depth, hashMB, &options, &run)) {
+            SDL_Log("scaling: can't search with %d threads: %s", threads, SDL_GetError());
+            return SDL_APP_FAILURE;
+        }
+        if (threads == 1) base = run;
+        double seconds = (double)run.ns / 1e9, nps = seconds > 0 ? (double)run.nodes / seconds : 0.0;
+        double baseNps = base.ns > 0 ? (double)base.nodes * 1e9 / (double)base.ns : 0.0;
+        char idle[MAX_POOL_THREADS * 6 + 16];
+        int length = SDL_snprintf(idle, sizeof(idle), "%.0f%% |", run.idle[0] * 100);
+        for (int i = 1; i <= threads && length < (int)sizeof(idle); i++)
+            length += SDL_snprintf(idle + length, sizeof(idle) - length, " %.0f%%", run.idle[i] * 100);
+        SDL_Log("threads %2d: %8.3f s %11llu nodes %9.0f nps  speedup %5.2f time %5.2f nps  overhead %+6.1f%%  idle %s",
+                threads, seconds, (unsigned long long)run.nodes, nps, run.ns > 0 ? (double)base.ns / (double)run.ns : 0.0,
+                baseNps > 0 ? nps / baseNps : 0.0, base.nodes > 0 ? ((double)run.nodes / (double)base.nodes - 1) * 100 : 0.0, idle);
+        const ThreadWakeups* w = &run.wakeups;
+        double jobs = (double)SDL_max(w->jobs, 1), workerNS = SDL_max((double)run.ns * run.workers, 1.0);
+        SDL_Log("            %llu jobs: start %8.1f us a job, %5.1f%% without a wake-up, %llu parks, %5.2f%% of the workers' time spinning",
+                (unsigned long long)w->jobs, (double)w->latencyNS / jobs / 1000, w->spunJobs * 100 / jobs,
+                (unsigned long long)w->parks, (double)w->spinNS * 100 / workerNS);
+        if (threads == maxThreads) break;
+    }
+    return SDL_APP_SUCCESS;
+}
+
+/* Analysis cache: `batch ... cache FILE` keeps every search's result in FILE by the position's key, and a later
+   run given the same file answers a position from it, with no search, when it was searched to at least the depth
+   asked for; re-analysing a collection that has grown since then only searches what's new. The file is a header
+   and then ANALYSIS_RECORD_SIZE-byte records, little-endian: key, nodes, score, move, depth. Results are appended
+   as the searches finish, so a run that stops part way keeps what it had done; a record for a key already there
+   replaces it when deeper, and a file with such records (or with a partial last one) is written out again when
+   next opened, one record a key. The records don't know the evaluation or settings they were searched with, so a
+   network or option change wants a cache file of its own. */
+#define ANALYSIS_MAGIC "chessac1"
+#define ANALYSIS_RECORD_SIZE 24
+
+typedef struct {
+    Uint64 key;          // 0 for an empty slot
+    Uint64 nodes;
+    int score;
+    Move move;
+    int depth;
+} AnalysisEntry;
+
+typedef struct {
+    AnalysisEntry* slots; // open addressing, linear probing, no more than half full
+    size_t mask, count;
+    SDL_IOStream* log;   // where new results go
+    SDL_Mutex* lock;     // the workers share it
+} AnalysisCache;
+
+static void analysisRecordPack(const AnalysisEntry* entry, Uint8 record[ANALYSIS_RECORD_SIZE]) {
+    for (int i = 0; i < 8; i++) record[i] = (Uint8)(entry->key >> (8 * i));
+    for (int i = 0; i < 8; i++) record[8 + i] = (Uint8)(entry->nodes >> (8 * i));
+    for (int i = 0; i < 4; i++) record[16 + i] = (Uint8)((Uint32)entry->score >> (8 * i));
+    record[20] = (Uint8)entry->move;
+    record[21] = (Uint8)(entry->move >> 8);
+    record[22] = (Uint8)entry->depth;
+    record[23] = 0;
+}
+
+static void analysisRecordUnpack(const Uint8 record[ANALYSIS_RECORD_SIZE], AnalysisEntry* entry) {
+    entry->key = entry->nodes = 0;
+    Uint32 score = 0;
+    for (int i = 0; i < 8; i++) entry->key |= (Uint64)record[i] << (8 * i);
+    for (int i = 0; i < 8; i++) entry->nodes |= (Uint64)record[8 + i] << (8 * i);
+    for (int i = 0; i < 4; i++) score |= (Uint32)record[16 + i] << (8 * i);
+    entry->score = (int)score;
+    entry->move = (Move)(record[20] | record[21] << 8);
+    entry->depth = record[22];
+}
+
+static AnalysisEntry* analysisSlot(const AnalysisCache* cache, Uint64 key) {
+    size_t i = (size_t)(key * 0x9E3779B97F4A7C15ull >> 20) & cache->mask;
+    while (cache->slots[i].key && cache->slots[i].key != key) i = (i + 1) & cache->mask;
+    return &cache->slots[i];
+}
+
+// room for one more entry, the table doubled when it would be over half full; false when there's no memory
+static bool analysisReserve(AnalysisCache* cache) {
+    if ((cache->count + 1) * 2 <= cache->mask + 1) return true;
+    size_t oldSize = cache->mask + 1;
+    AnalysisEntry* old = cache->slots;
+    AnalysisEntry* slots = SDL_calloc(oldSize * 2, sizeof(AnalysisEntry));
+    if (!slots) return false;
+    cache->slots = slots;
+    cache->mask = oldSize * 2 - 1;
+    for (size_t i = 0; i < oldSize; i++)
+        if (old[i].key) *analysisSlot(cache, old[i].key) = old[i];
+    SDL_free(old);
+    return true;
+}
+
+// the entry in the table (with room reserved), unless one as deep is there already; true when it was taken
+static bool analysisInsert(AnalysisCache* cache, const AnalysisEntry* entry) {
+    AnalysisEntry* slot = analysisSlot(cache, entry->key);
+    if (slot->key && slot->depth >= entry->depth) return false;
+    if (!slot->key) cache->count++;
+    *slot = *entry;
+    return true;
+}
+
+// the whole table, one record a key, written next to the file and renamed over it
+static bool analysisCacheRewrite(const AnalysisCache* cache, const char* path) {
+    char temporary[1024];
+    SDL_snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    SDL_IOStream* out = SDL_IOFromFile(temporary, "wb");
+    bool written = out && SDL_WriteIO(out, ANALYSIS_MAGIC, 8) == 8;
+    for (size_t i = 0; written && i <= cache->mask; i++) {
+        if (!cache->slots[i].key) continue;
+        Uint8 record[ANALYSIS_RECORD_SIZE];
+        analysisRecordPack(&cache->slots[i], record);
+        written = SDL_WriteIO(out, record, sizeof(record)) == sizeof(record);
+    }
+    if (out && !SDL_CloseIO(out)) written = false;
+    return written && SDL_RenamePath(temporary, path);
+}
+
+static void analysisCacheClose(AnalysisCache* cache) {
+    if (!cache) return;
+    if (cache->log) SDL_CloseIO(cache->log);
+    SDL_DestroyMutex(cache->lock);
+    SDL_free(cache->slots);
+    SDL_free(cache);
+}
+
+// the file read in, or started when there's none; NULL, logged, when it isn't a cache or can't be written
+static AnalysisCache* analysisCacheOpen(const char* path) {
+    AnalysisCache* cache = SDL_calloc(1, sizeof(AnalysisCache));
+    if (!cache || !(cache->lock = SDL_CreateMutex()) || !(cache->slots = SDL_calloc(1024, sizeof(AnalysisEntry)))) {
+        SDL_Log("batch: no memory for the analysis cache");
+        analysisCacheClose(cache);
+        return NULL;
+    }
+    cache->mask = 1023;
+    size_t size = 0;
+    Uint8* data = SDL_GetPathInfo(path, NULL) ? SDL_LoadFile(path, &size) : NULL;
+    if (data && (size < 8 || SDL_memcmp(data, ANALYSIS_MAGIC, 8) != 0)) {
+        SDL_Log("batch: %s isn't an analysis cache", path);
+        SDL_free(data);
+        analysisCacheClose(cache);
+        return NULL;
+    }
+    bool rewrite = data && (size - 8) % ANALYSIS_RECORD_SIZE != 0;
+    for (size_t offset = 8; data && offset + ANALYSIS_RECORD_SIZE <= size; offset += ANALYSIS_RECORD_SIZE) {
+        AnalysisEntry entry;
+        analysisRecordUnpack(data + offset, &entry);
+        if (!entry.key) continue;
+        if (!analysisReserve(cache)) {
+            SDL_Log("batch: no memory for the analysis cache");
+            SDL_free(data);
+            analysisCacheClose(cache);
+            return NULL;
+        }
+        size_t before = cache->count;
+        if (!analysisInsert(cache, &entry) || cache->count == before) rewrite = true; // a second record for the key
+    }
+    if (!data) rewrite = true; // a new file, the header written
+    SDL_free(data);
+    if (rewrite && !analysisCacheRewrite(cache, path)) {
+        SDL_Log("batch: can't write %s: %s", path, SDL_GetError());
+        analysisCacheClose(cache);
+        return NULL;
+    }
+    if (!(cache->log = SDL_IOFromFile(path, "ab"))) {
+        SDL_Log("batch: can't write %s: %s", path, SDL_GetError());
+        analysisCacheClose(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+// the position's result when one at least `depth` deep is there, with a move that's legal in it
+static bool analysisCacheFind(AnalysisCache* cache, ChessState* chess, int depth, AnalysisEntry* found) {
+    SDL_LockMutex(cache->lock);
+    const AnalysisEntry* slot = analysisSlot(cache, chess->hashKey);
+    bool hit = slot->key != 0 && slot->depth >= depth;
+    if (hit) *found = *slot;
+    SDL_UnlockMutex(cache->lock);
+    if (!hit) return false;
+    MoveList legal; // a key that isn't this position's, in all likelihood never
+    getAllMoves(chess, &legal);
+    for (int i = 0; i < legal.count; i++)
+        if (legal.moves[i] == found->move) return true;
+    return false;
+}
+
+static void analysisCacheStore(AnalysisCache* cache, const AnalysisEntry* entry) {
+    Uint8 record[ANALYSIS_RECORD_SIZE];
+    analysisRecordPack(entry, record);
+    SDL_LockMutex(cache->lock);
+    if (entry->key && analysisReserve(cache) && analysisInsert(cache, entry)) SDL_WriteIO(cache->log, record, sizeof(record));
+    SDL_UnlockMutex(cache->lock);
+}
+
+/* Output sink: the result lines of many threads onto stdout. Each thread formats into an OutputBuffer of its own
+   with the output* helpers, which write the text straight into it (no printf, no intermediate strings); the buffer
+   goes to stdout in one write under the sink's lock when it fills up, when OUTPUT_FLUSH_MS have passed since it
+   last went, or when the thread is done. So the lock is taken once every few hundred lines rather than once a
+   line, and never while a line is being formatted. A line is always written whole; lines from different threads
+   are interleaved a buffer at a time. */
+#define OUTPUT_BUFFER_SIZE 65536
+#define OUTPUT_LINE_MAX 4096 // room kept free for the next line; a longer one loses its tail
+#define OUTPUT_FLUSH_MS 200  // so a slow run still shows its results as they come
+
+typedef struct {
+    SDL_Mutex* lock;
+    bool failed; // a write came up short (a closed pipe, a full disk); under lock
+} OutputSink;
+
+typedef struct {
+    OutputSink* sink;
+    size_t length; // where the line being formatted starts plus what it has so far
+    Uint64 flushedNS;
+    char data[OUTPUT_BUFFER_SIZE];
+} OutputBuffer;
+
+static void outputFlush(OutputBuffer* out) {
+    out->flushedNS = SDL_GetTicksNS();
+    if (out->length == 0) return;
+    OutputSink* sink = out->sink;
+    SDL_LockMutex(sink->lock);
+    if (fwrite(out->data, 1, out->length, stdout) != out->length || fflush(stdout) != 0) sink->failed = true;
+    SDL_UnlockMutex(sink->lock);
+    out->length = 0;
+}
+
+static void outputText(OutputBuffer* out, const char* text, size_t length) {
+    length = SDL_min(length, sizeof(out->data) - 1 - out->length); // the last byte is kept for the newline
+    SDL_memcpy(out->data + out->length, text, length);
+    out->length += length;
+}
+static void outputString(OutputBuffer* out, const char* text) { outputText(out, text, SDL_strlen(text)); }
+
+static void outputInt(OutputBuffer* out, Sint64 value) {
+    char digits[24];
+    int n = sizeof(digits);
+    Uint64 magnitude = value < 0 ? 0 - (Uint64)value : (Uint64)value;
+    do digits[--n] = (char)('0' + magnitude % 10); while ((magnitude /= 10) > 0);
+    if (value < 0) digits[--n] = '-';
+    outputText(out, digits + n, sizeof(digits) - (size_t)n);
+}
+
+// the end of a line: the buffer goes out once there's no longer room for another, or it has waited long enough
+static void outputLine(OutputBuffer* out) {
+    out->data[out->length++] = '\n';
+    if (out->length > sizeof(out->data) - OUTPUT_LINE_MAX || SDL_GetTicksNS() - out->flushedNS >= (Uint64)OUTPUT_FLUSH_MS * 1000000)
+        outputFlush(out);
+}
+
+// a buffer for this thread, NULL when there's no memory; outputClose flushes and frees it
+static OutputBuffer* outputOpen(OutputSink* sink) {
+    OutputBuffer* out = SDL_malloc(sizeof(OutputBuffer));
+    if (!out) return NULL;
+    out->sink = sink;
+    out->length = 0;
+    out->flushedNS = SDL_GetTicksNS();
+    return out;
+}
+
+static void outputClose(OutputBuffer* out) {
+    if (!out) return;
+    outputFlush(out);
+    SDL_free(out);
+}
+
+/* Batch analysis: `main batch <file> [depth N] [nodes N] [hash MB] [threads N] [json] [noevalcache] [nnue FILE]
+   [eval] [gpu SHADER] [dedup MB] [cache FILE]`
+   searches every position of a FEN/EPD file (one per line), a PGN file (every position of every game, by the
+   .pgn extension) or a self-play shard (every record, by the .bin or .pack extension) to a fixed depth (or node count), one position per pool worker at a time. The file is mapped
+   rather than read, and a reader thread parses it straight out of the mapping into a bounded queue the workers
+   take positions from, so a file of any size starts at once and is never held in memory twice. Each search runs
+   on its worker alone with its own hash table, so the workers share nothing but the read-only attack and key
+   tables. Results are printed as the searches finish, so not in the file's order, each worker's through a buffer
+   of its own (OutputSink): EPD lines with the acd, acn,
+   ce (or dm) and pm opcodes added (other positions as EPD with an id naming game and ply, or record), or with
+   `json` one object per line that carries the line number (or game and ply, or record) and the principal
+   variation as far as the worker's hash table holds it. The summary gives the evaluation cache's hit rate;
+   `noevalcache` switches the cache off to compare against, and `nnue` evaluates with a network file instead.
+   `eval` scores each position with the static evaluation instead of searching it (evaluateBatch, the
+   hand-written evaluation a group of positions at a time, or the network with `nnue`), for labelling a data
+   set: ce only, or "eval". With a network, `gpu` hands one worker the GPU (nnue_eval.spv, which the build makes
+   with CHESS_GPU_EVAL; see gpuEvalCreate): it fills a batch while the GPU scores the last, and the other workers
+   go on with the CPU. `dedup` gives the
+   reader a position filter of that many megabytes (PositionFilter) and skips every position it has handed out
+   already, the openings a PGN file's games share above all. `cache` answers the positions an earlier run has
+   searched deep enough from an analysis cache file (AnalysisCache), and adds the others' results to it. */
+#define BATCH_DEPTH 8        // when neither a depth nor a node count is given
+#define BATCH_HASH_MB 16     // per worker, cleared before every position so each result is reproducible
+#define BATCH_QUEUE_SIZE 64  // positions the reader may get ahead of the workers
+#define BATCH_LINE_MAX 1024  // an unterminated last line is copied out to parse; longer ones lose their tail
+
+typedef struct {
+    ChessState chess;
+    const char* text;    // EPD: the line, in the file's buffer and not NUL-terminated; NULL otherwise
+    int length;
+    int number;          // EPD: line of the file; PGN: game of the file; shard: record, from 1
+    int ply;             // PGN: moves (plies) of the game played before it
+} BatchItem;
+
+typedef enum { BATCH_EPD, BATCH_PGN, BATCH_SHARD } BatchFormat;
+
+typedef struct {
+    MappedFile file;
+    BatchFormat format;
+    BatchItem* queue;    // BATCH_QUEUE_SIZE slots, a ring the reader thread fills and the workers empty
+    int head, queued;    // under queueLock
+    bool readerDone;     // the reader has put in its last position
+    SDL_Mutex* queueLock;
+    SDL_Condition* queueChanged;
+    int positions;       // handed to the workers, for the summary
+    int depth;
+    Uint64 nodeLimit;    // 0 = depth only
+    size_t hashMB;
+    bool json;
+    bool evalCache;
+    bool staticEval;     // `eval`: no search
+    GpuEvaluator* gpu;   // `gpu`, for the first worker to take it
+    SDL_AtomicInt gpuTaken;
+    PositionFilter* filter; // `dedup`, NULL for none; the reader's alone
+    int duplicates;      // positions the filter skipped
+    AnalysisCache* cache; // `cache`, NULL for none
+    SDL_AtomicInt cacheHits;
+    OutputSink output;   // the workers' result lines
+    Uint64 totalNodes;   // __atomic adds from the workers
+    Uint64 evalProbes, evalHits; // likewise, once per worker
+    SDL_AtomicInt failed;
+} BatchJob;
+
+/* Reader thread: the next free slot, to be filled in place. Only the reader adds to the ring, so the slot stays
+   out of the workers' reach until batchPublish, though the lock isn't held meanwhile. */
+static BatchItem* batchReserve(BatchJob* job) {
+    SDL_LockMutex(job->queueLock);
+    while (job->queued == BATCH_QUEUE_SIZE) SDL_WaitCondition(job->queueChanged, job->queueLock);
+    BatchItem* item = &job->queue[(job->head + job->queued) % BATCH_QUEUE_SIZE];
+    SDL_UnlockMutex(job->queueLock);
+    return item;
+}
+
+static void batchPublish(BatchJob* job, const BatchItem* item) {
+    if (job->filter && !positionFilterAdd(job->filter, item->chess.hashKey)) { // the slot is reserved for the next one
+        job->duplicates++;
+        return;
+    }
+    SDL_LockMutex(job->queueLock);
+    job->queued++;
+    job->positions++;
+    SDL_BroadcastCondition(job->queueChanged);
+    SDL_UnlockMutex(job->queueLock);
+}
+
+// workers: a copy of the oldest position waiting, false once the reader is done and there are none left
+static bool batchTake(BatchJob* job, BatchItem* item) {
+    SDL_LockMutex(job->queueLock);
+    while (job->queued == 0 && !job->readerDone) SDL_WaitCondition(job->queueChanged, job->queueLock);
+    bool have = job->queued > 0;
+    if (have) {
+        *item = job->queue[job->head];
+        job->head = (job->head + 1) % BATCH_QUEUE_SIZE;
+        job->queued--;
+        SDL_BroadcastCondition(job->queueChanged);
+    }
+    SDL_UnlockMutex(job->queueLock);
+    return have;
+}
+
+// one position per line; blank lines and # comments skipped
+static void readEpdPositions(BatchJob* job, const char* p, const char* end) {
+    for (int number = 1; p < end; number++) {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        const char* last = eol ? eol : end;
+        const char* next = eol ? eol + 1 : end;
+        while (last > p && (last[-1] == '\r' || last[-1] == ' ' || last[-1] == '\t')) last--;
+        while (p < last && (*p == ' ' || *p == '\t')) p++;
+        if (p < last && *p != '#') {
+            BatchItem* item = batchReserve(job);
+            bool ok;
+            if (eol) {
+                ok = loadFen(&item->chess, p); // stops at the newline
+            } else { // the last line, with nothing after it in the mapping to stop the parser
+                char line[BATCH_LINE_MAX];
+                SDL_strlcpy(line, p, SDL_min((size_t)(last - p) + 1, sizeof(line)));
+                ok = loadFen(&item->chess, line);
+            }
+            if (ok) {
+                item->text = p;
+                item->length = (int)(last - p);
+                item->number = number;
+                item->ply = 0;
+                batchPublish(job, item);
+            } else {
+                SDL_Log("batch: line %d: bad FEN or EPD: %.*s", number, (int)(last - p), p);
+                SDL_SetAtomicInt(&job->failed, 1);
+            }
+        }
+        p = next;
+    }
+}
+
+/* A SAN move (Nf3, exd5, exd6e.p., e8=Q, O-O-O, with any +, # or !? after it) among the legal moves of the position;
+   MOVE_NONE when no legal move, or more than one, fits. The move's origin comes from moveOrigins, the pieces of its
+   kind that reach the target square, so the move list is never generated. */
+static Move parseSanMove(ChessState* chess, const char* san, int length) {
+    while (length > 0 && (san[length - 1] == '+' || san[length - 1] == '#' || san[length - 1] == '!' || san[length - 1] == '?')) length--;
+    if (length >= 6 && SDL_strncmp(san + length - 4, "e.p.", 4) == 0) length -= 4;
+    if (length >= 3 && (san[0] == 'O' || san[0] == '0')) {
+        int king = chess->kingSquare[chess->whiteToMove ? 0 : 1], row = king >> 3, col = length >= 5 ? 2 : 6;
+        if (king < 0 || (king & 7) != 4 || !isLegalMove(chess, row, 4, row, col)) return MOVE_NONE;
+        return buildMove(chess, king, squareIndex(row, col));
+    }
+    static const char PIECE_LETTERS[] = "PNBRQK"; // in PieceType order
+    const char* letter = length > 0 && san[0] ? SDL_strchr(PIECE_LETTERS + 1, san[0]) : NULL;
+    int kind = letter ? (int)(letter - PIECE_LETTERS) : 0; // the offset from the pawn of the side to move
+    int start = letter ? 1 : 0;
+    char promotion = 0;
+    if (kind == 0 && length >= 2 && SDL_strchr("NBRQ", san[length - 1])) {
+        promotion = san[length - 1];
+        length -= san[length - 2] == '=' ? 2 : 1;
+    }
+    if (length - start < 2) return MOVE_NONE;
+    int toCol = san[length - 2] - 'a', toRow = san[length - 1] - '1';
+    if (toCol < 0 || toCol > 7 || toRow < 0 || toRow > 7) return MOVE_NONE;
+    int fromCol = -1, fromRow = -1; // the disambiguation, if any
+    for (int i = start; i < length - 2; i++) {
+        if (san[i] >= 'a' && san[i] <= 'h') fromCol = san[i] - 'a';
+        else if (san[i] >= '1' && san[i] <= '8') fromRow = san[i] - '1';
+        else if (san[i] != 'x' && san[i] != '-') return MOVE_NONE;
+    }
+    PieceType piece = (PieceType)((chess->whiteToMove ? WHITE_PAWN : BLACK_PAWN) + kind);
+    int to = squareIndex(toRow, toCol);
+    Bitboard origins = moveOrigins(chess, piece, to);
+    if (fromCol >= 0) origins &= 0x0101010101010101ULL << fromCol;
+    if (fromRow >= 0) origins &= 0xFFULL << (fromRow * 8);
+    if (origins == 0 || (origins & (origins - 1))) return MOVE_NONE; // none fits, or it's ambiguous
+    Move m = buildMove(chess, __builtin_ctzll(origins), to);
+    if (isCastlingMove(m) || isPromotionMove(m) != (promotion != 0)) return MOVE_NONE;
+    if (promotion) m = (Move)((m & ~(3 << 12)) | ((int)(SDL_strchr("NBRQ", promotion) - "NBRQ") << 12));
+    return m;
+}
+
+/* called for each position of a game with the move played from it, and with MOVE_NONE for the one it ends in;
+   result is white's, 1, 0 or -1, from the Result tag (or, for the last position, the result after the moves), or
+   PGN_NO_RESULT when there's none or the game's unfinished */
+#define PGN_NO_RESULT 2
+typedef void (*PgnVisitor)(void* context, const ChessState* position, Move move, int game, int ply, int result);
+
+// "1-0", "0-1" or "1/2-1/2" as white's result, anything else (such as "*") as PGN_NO_RESULT
+static int pgnResult(const char* text, int length) {
+    if (length == 3 && SDL_strncmp(text, "1-0", 3) == 0) return 1;
+    if (length == 3 && SDL_strncmp(text, "0-1", 3) == 0) return -1;
+    if (length == 7 && SDL_strncmp(text, "1/2-1/2", 7) == 0) return 0;
+    return PGN_NO_RESULT;
+}
+
+/* Every position of every game in PGN text: the one before each move of the main line, and the one the game ends
+   in. Comments, variations, NAGs and escape lines are skipped; a FEN tag sets the starting position. A move that
+   isn't legal ends its game there, which (like a bad FEN tag) is logged and makes this return false. */
+static bool readPgnGames(const char* p, const char* end, PgnVisitor visit, void* context) {
+    ChessState game = initChessState();
+    int number = 0, ply = 0, result = PGN_NO_RESULT;
+    bool inGame = false, skipping = false, ok = true;
+    while (p < end) {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '.') { p++; continue; }
+        const char* eol = c == '%' || c == ';' || c == '[' ? memchr(p, '\n', (size_t)(end - p)) : NULL;
+        if (!eol) eol = end;
+        if (c == '%' || c == ';') { p = eol; continue; } // escape line, rest-of-line comment
+        if (c == '{') {
+            const char* close = memchr(p, '}', (size_t)(end - p));
+            p = close ? close + 1 : end;
+            continue;
+        }
+        if (c == '(') { // variation, nested or not, with comments of their own
+            for (int depth = 0; p < end; p++) {
+                if (*p == '{') { const char* close = memchr(p, '}', (size_t)(end - p)); p = close ? close : end - 1; }
+                else if (*p == '(') depth++;
+                else if (*p == ')' && --depth == 0) { p++; break; }
+            }
+            continue;
+        }
+        if (c == '[') { // a tag: a new game's, if the last one had no result
+            if (inGame && ply > 0) {
+                if (!skipping) visit(context, &game, MOVE_NONE, number, ply, result);
+                inGame = false;
+            }
+            if (!inGame) {
+                game = initChessState();
+                number++, ply = 0, result = PGN_NO_RESULT;
+                inGame = true, skipping = false;
+            }
+            const char* value = memchr(p, '"', (size_t)(eol - p));
+            const char* close = value ? memchr(value + 1, '"', (size_t)(eol - value - 1)) : NULL;
+            if (eol - p > 5 && SDL_strncmp(p, "[FEN ", 5) == 0 && close) {
+                char fen[FEN_MAX]; // not SDL_strlcpy, which would measure the rest of the file each time
+                size_t length = SDL_min((size_t)(close - value - 1), sizeof(fen) - 1);
+                SDL_memcpy(fen, value + 1, length);
+                fen[length] = '\0';
+                if (!loadFen(&game, fen)) {
+                    SDL_Log("pgn: game %d: bad FEN tag %s", number, fen);
+                    ok = false;
+                    skipping = true;
+                }
+            } else if (eol - p > 8 && SDL_strncmp(p, "[Result ", 8) == 0 && close) {
+                result = pgnResult(value + 1, (int)(close - value - 1));
+            }
+            p = eol;
+            continue;
+        }
+        const char* token = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '{' && *p != '(' && *p != ')' && *p != ';') p++;
+        int length = (int)(p - token);
+        if (c == '$' || (length == 4 && SDL_strncmp(token, "e.p.", 4) == 0)) continue; // NAG, or "exd6 e.p."
+        if (c >= '0' && c <= '9' && !(length >= 3 && token[1] == '-' && token[2] == '0')) { // "0-0" is castling
+            const char* digits = token;
+            while (digits < p && *digits >= '0' && *digits <= '9') digits++;
+            if (digits == p || *digits == '.') continue; // move number
+        }
+        if (!inGame) {
+            game = initChessState();
+            number++, ply = 0, result = PGN_NO_RESULT;
+            inGame = true, skipping = false;
+        }
+        int ending = pgnResult(token, length);
+        if (ending != PGN_NO_RESULT || (length == 1 && c == '*')) {
+            if (!skipping) visit(context, &game, MOVE_NONE, number, ply, ending);
+            inGame = false;
+            continue;
+        }
+        if (skipping) continue;
+        Move move = parseSanMove(&game, token, length);
+        if (move == MOVE_NONE) {
+            SDL_Log("pgn: game %d: illegal move %.*s after %d plies", number, length, token, ply);
+            ok = false;
+            skipping = true;
+            continue;
+        }
+        visit(context, &game, move, number, ply, result);
+        makeMove(&game, move, NULL);
+        ply++;
+    }
+    if (inGame && !skipping && ply > 0) visit(context, &game, MOVE_NONE, number, ply, result); // no result at the end of the file
+    return ok;
+}
+
+static void publishPgnPosition(void* context, const ChessState* position, Move move, int game, int ply, int result) {
+    BatchJob* job = context;
+    (void)move, (void)result; // every position is searched, what came of it doesn't matter
+    BatchItem* item = batchReserve(job);
+    item->chess = *position;
+    item->text = NULL;
+    item->length = 0;
+    item->number = game;
+    item->ply = ply;
+    batchPublish(job, item);
+}
+
+#define SHARD_READ_RECORDS 1024 // decoded from a packed shard at a time
+
+/* Every record of a self-play shard, raw or packed (shardReaderOpen), visited in order with its number from 1;
+   false, logged under the command's name, when the file has a partial record or is damaged part way. */
+static bool forEachShardRecord(const char* command, const Uint8* data, size_t size,
+                               void (*visit)(void* context, const Uint8* record, size_t number), void* context) {
+    if (size < 8 || SDL_memcmp(data, SHARD_MAGIC, 8) != 0) { // raw records
+        for (size_t i = 0; i < size / TRAINING_RECORD_SIZE; i++) visit(context, data + i * TRAINING_RECORD_SIZE, i + 1);
+        if (size % TRAINING_RECORD_SIZE == 0) return true;
+        SDL_Log("%s: %zu bytes after the last whole record ignored", command, size % TRAINING_RECORD_SIZE);
+        return false;
+    }
+    ShardReader* reader = shardReaderOpen(data, size);
+    if (!reader) {
+        SDL_Log("%s: %s", command, SDL_GetError());
+        return false;
+    }
+    Uint8* records = SDL_malloc(SHARD_READ_RECORDS * TRAINING_RECORD_SIZE);
+    size_t number = 0;
+    int n = records ? 0 : -1;
+    while (records && (n = shardReaderRead(reader, records, SHARD_READ_RECORDS)) > 0)
+        for (int i = 0; i < n; i++) visit(context, records + (size_t)i * TRAINING_RECORD_SIZE, ++number);
+    if (n < 0) SDL_Log("%s: after record %zu: %s", command, number, records ? SDL_GetError() : "out of memory");
+    SDL_free(records);
+    shardReaderClose(reader);
+    return n == 0;
+}
+
+// self-play training records, decoded straight out of the mapping
+static void publishShardRecord(void* context, const Uint8* record, size_t number) {
+    BatchJob* job = context;
+    BatchItem* item = batchReserve(job);
+    int score, result;
+    if (!trainingRecordUnpack(record, &item->chess, &score, &result)) {
+        SDL_Log("batch: record %zu: not a position", number);
+        SDL_SetAtomicInt(&job->failed, 1);
+        return;
+    }
+    item->text = NULL;
+    item->length = 0;
+    item->number = (int)number;
+    item->ply = 0;
+    batchPublish(job, item);
+}
+
+static int SDLCALL batch_reader(void* data) {
+    BatchJob* job = data;
+    const char* text = job->file.data;
+    if (job->format == BATCH_PGN) {
+        if (!readPgnGames(text, text + job->file.size, publishPgnPosition, job)) SDL_SetAtomicInt(&job->failed, 1);
+    }
+    else if (job->format == BATCH_SHARD) {
+        if (!forEachShardRecord("batch", (const Uint8*)text, job->file.size, publishShardRecord, job)) SDL_SetAtomicInt(&job->failed, 1);
+    }
+    else readEpdPositions(job, text, text + job->file.size);
+    SDL_LockMutex(job->queueLock);
+    job->readerDone = true;
+    SDL_BroadcastCondition(job->queueChanged);
+    SDL_UnlockMutex(job->queueLock);
+    return 0;
+}
+
+// the four position fields of a FEN or EPD line, and the EPD operations after them (FEN move counters skipped)
+static size_t epdPositionFields(const char* line, const char* end, const char** operations) {
+    const char* p = line;
+    for (int field = 0; field < 4 && p < end; field++) {
+        while (p < end && *p == ' ') p++;
+        while (p < end && *p != ' ') p++;
+    }
+    size_t length = (size_t)(p - line);
+    for (int counter = 0; counter < 2; counter++) {
+        const char* q = p;
+        while (q < end && *q == ' ') q++;
+        if (q == end || *q < '0' || *q > '9') break;
+        while (q < end && *q >= '0' && *q <= '9') q++;
+        if (q < end && *q != ' ') break;
+        p = q;
+    }
+    while (p < end && *p == ' ') p++;
+    *operations = p;
+    return length;
+}
+
+// full moves to the mate a mate score stands for, negative when it is the side to move being mated
+static int mateInMoves(int score) {
+    return (MATE_SCORE - abs(score) + 1) / 2 * (score < 0 ? -1 : 1);
+}
+
+// the item's id: the JSON fields that open its object, or the EPD id opcode that ends its line (none for an EPD line)
+static void outputBatchId(BatchJob* job, OutputBuffer* out, const BatchItem* item) {
+    if (job->json) {
+        outputString(out, job->format == BATCH_EPD ? "{\"line\":" : job->format == BATCH_PGN ? "{\"game\":" : "{\"record\":");
+        outputInt(out, item->number);
+        if (job->format == BATCH_PGN) outputString(out, ",\"ply\":"), outputInt(out, item->ply);
+    } else if (job->format != BATCH_EPD) {
+        outputString(out, job->format == BATCH_PGN ? " id \"game " : " id \"record ");
+        outputInt(out, item->number);
+        if (job->format == BATCH_PGN) outputString(out, " ply "), outputInt(out, item->ply);
+        outputString(out, "\";");
+    }
+}
+
+static void printBatchResult(BatchJob* job, OutputBuffer* out, Engine* engine, const BatchItem* item, const RootMoves* root,
+                             Uint64 nodes, Uint64 elapsedNS) {
+    char fen[FEN_MAX];
+    const char* line = item->text;
+    int lineLength = item->length;
+    if (!line) {
+        lineLength = writeFen(&item->chess, fen, sizeof(fen));
+        line = fen;
+    }
+    const char* operations;
+    int fieldsLength = (int)epdPositionFields(line, line + lineLength, &operations);
+    int operationsLength = item->text ? (int)(line + lineLength - operations) : 0; // a written FEN has none
+    char move[6] = "";
+    if (root->count > 0) moveToCoordinates(root->moves[0], move);
+    int score = root->lastScore;
+    bool mate = abs(score) >= MATE_BOUND;
+    int mateMoves = mateInMoves(score);
+    if (job->json) {
+        outputBatchId(job, out, item);
+        outputString(out, ",\"fen\":\"");
+        outputText(out, line, (size_t)fieldsLength);
+        outputString(out, "\",\"bestmove\":");
+        if (root->count > 0) outputString(out, "\""), outputString(out, move), outputString(out, "\"");
+        else outputString(out, "null");
+        if (root->depthDone > 0) outputString(out, mate ? ",\"mate\":" : ",\"cp\":"), outputInt(out, mate ? mateMoves : score);
+        outputString(out, ",\"pv\":\"");
+        Move pv[MAX_PV_LENGTH]; // formatted in place, up to the room the line has left
+        int pvLength = engineLine(engine, &item->chess, root->count > 0 ? root->moves[0] : MOVE_NONE, pv);
+        out->length += (size_t)formatPv(NULL, pv, pvLength, false, out->data + out->length, sizeof(out->data) - 1 - out->length);
+        outputString(out, "\",\"depth\":");
+        outputInt(out, root->depthDone);
+        outputString(out, ",\"nodes\":");
+        outputInt(out, (Sint64)nodes);
+        outputString(out, ",\"ms\":");
+        outputInt(out, (Sint64)(elapsedNS / 1000000));
+        outputString(out, "}");
+    } else {
+        outputText(out, line, (size_t)fieldsLength);
+        if (operationsLength > 0) outputString(out, " "), outputText(out, operations, (size_t)operationsLength);
+        outputString(out, " acd ");
+        outputInt(out, root->depthDone);
+        outputString(out, "; acn ");
+        outputInt(out, (Sint64)nodes);
+        outputString(out, ";");
+        if (root->depthDone > 0) outputString(out, mate ? " dm " : " ce "), outputInt(out, mate ? mateMoves : score), outputString(out, ";");
+        if (root->count > 0) outputString(out, " pm "), outputString(out, move), outputString(out, ";");
+        outputBatchId(job, out, item);
+    }
+    outputLine(out);
+}
+
+// `eval`: the static evaluation, side to move's point of view like ce
+static void printBatchEval(BatchJob* job, OutputBuffer* out, const BatchItem* item, int score) {
+    char fen[FEN_MAX];
+    const char* line = item->text;
+    int lineLength = item->length;
+    if (!line) {
+        lineLength = writeFen(&item->chess, fen, sizeof(fen));
+        line = fen;
+    }
+    const char* operations;
+    int fieldsLength = (int)epdPositionFields(line, line + lineLength, &operations);
+    int operationsLength = item->text ? (int)(line + lineLength - operations) : 0;
+    if (job->json) {
+        outputBatchId(job, out, item);
+        outputString(out, ",\"fen\":\"");
+        outputText(out, line, (size_t)fieldsLength);
+        outputString(out, "\",\"eval\":");
+        outputInt(out, score);
+        outputString(out, "}");
+    } else {
+        outputText(out, line, (size_t)fieldsLength);
+        if (operationsLength > 0) outputString(out, " "), outputText(out, operations, (size_t)operationsLength);
+        outputString(out, " ce ");
+        outputInt(out, score);
+        outputString(out, ";");
+        outputBatchId(job, out, item);
+    }
+    outputLine(out);
+}
+
+// up to max positions off the queue; fewer only once the reader is done
+static int batchTakeGroup(BatchJob* job, BatchItem* items, int max) {
+    int count = 0;
+    while (count < max && batchTake(job, &items[count])) count++;
+    return count;
+}
+
+// `eval` workers: EVAL_BATCH_LANES positions at a time off the queue, evaluated together
+static void batchEvaluate(BatchJob* job, OutputBuffer* out) {
+    BatchItem* items = SDL_malloc(sizeof(BatchItem) * EVAL_BATCH_LANES);
+    ChessState* positions = SDL_malloc(sizeof(ChessState) * EVAL_BATCH_LANES);
+    if (!items || !positions) { SDL_free(items); SDL_free(positions); return; }
+    int scores[EVAL_BATCH_LANES], count;
+    do {
+        count = batchTakeGroup(job, items, EVAL_BATCH_LANES);
+        for (int i = 0; i < count; i++) positions[i] = items[i].chess;
+        if (!nnueEvaluateBatch(positions, count, scores)) evaluateBatch(positions, count, scores);
+        for (int i = 0; i < count; i++) printBatchEval(job, out, &items[i], positions[i].whiteToMove ? scores[i] : -scores[i]);
+    } while (count == EVAL_BATCH_LANES);
+    SDL_free(positions);
+    SDL_free(items);
+}
+
+// a GPU batch's scores printed, or worked out on the CPU when the batch failed
+static void printGpuBatch(BatchJob* job, OutputBuffer* out, BatchItem* items, int count, const int* scores) {
+    for (int i = 0; i < count; i++) {
+        int score;
+        if (scores) score = scores[i];
+        else nnueEvaluateBatch(&items[i].chess, 1, &score);
+        printBatchEval(job, out, &items[i], items[i].chess.whiteToMove ? score : -score);
+    }
+}
+
+// `gpu`: two batches of positions, one filled while the GPU scores the other
+static void batchEvaluateGpu(BatchJob* job, OutputBuffer* out, GpuEvaluator* gpu) {
+    BatchItem* items = SDL_malloc(sizeof(BatchItem) * 2 * GPU_EVAL_BATCH);
+    const ChessState** positions = SDL_malloc(sizeof(ChessState*) * GPU_EVAL_BATCH);
+    int* scores = SDL_malloc(sizeof(int) * GPU_EVAL_BATCH);
+    if (!items || !positions || !scores) { SDL_free(items); SDL_free(positions); SDL_free(scores); batchEvaluate(job, out); return; }
+    int counts[2] = { 0, 0 }, pending = -1; // pending: the batch in flight before this one
+    for (int slot = 0;; slot ^= 1) {
+        BatchItem* batch = items + slot * GPU_EVAL_BATCH;
+        int count = counts[slot] = batchTakeGroup(job, batch, GPU_EVAL_BATCH);
+        for (int i = 0; i < count; i++) positions[i] = &batch[i].chess;
+        bool submitted = count > 0 && gpuEvalSubmit(gpu, positions, count);
+        if (pending >= 0) {
+            bool ok = gpuEvalCollect(gpu, scores) == counts[pending];
+            printGpuBatch(job, out, items + pending * GPU_EVAL_BATCH, counts[pending], ok ? scores : NULL);
+        }
+        if (count > 0 && !submitted) printGpuBatch(job, out, batch, count, NULL);
+        pending = submitted ? slot : -1;
+        if (count < GPU_EVAL_BATCH) break;
+    }
+    if (pending >= 0) {
+        bool ok = gpuEvalCollect(gpu, scores) == counts[pending];
+        printGpuBatch(job, out, items + pending * GPU_EVAL_BATCH, counts[pending], ok ? scores : NULL);
+    }
+    SDL_free(scores);
+    SDL_free(positions);
+    SDL_free(items);
+}
+
+// one per search thread: takes positions until there are none left
+static int SDLCALL batch_worker(void* data) {
+    BatchJob* job = data;
+    OutputBuffer* out = outputOpen(&job->output);
+    if (!out) return 0;
+    if (job->staticEval) {
+        if (job->gpu && SDL_CompareAndSwapAtomicInt(&job->gpuTaken, 0, 1)) batchEvaluateGpu(job, out, job->gpu);
+        else batchEvaluate(job, out);
+        outputClose(out);
+        return 0;
+    }
+    Engine* engine = engineCreate(); // its hash table is allocated here so it is local to this worker's node
+    BatchItem* item = SDL_malloc(sizeof(BatchItem));
+    if (!engine || !item) { engineDestroy(engine); SDL_free(item); outputClose(out); return 0; }
+    if (job->hashMB > 0 && !engineSetHash(engine, job->hashMB)) SDL_Log("batch: no memory for a hash table, searching without");
+    engine->options.evalCache = job->evalCache;
+    SearchLimits limits = { .depth = job->depth, .nodes = job->nodeLimit };
+    Uint64 probesBefore, hitsBefore, probes, hits;
+    engineEvalCacheStats(&probesBefore, &hitsBefore);
+
+    while (batchTake(job, item)) {
+        AnalysisEntry cached;
+        if (job->cache && analysisCacheFind(job->cache, &item->chess, job->depth, &cached)) {
+            RootMoves root = { .count = 1, .lastScore = cached.score, .depthDone = cached.depth };
+            root.moves[0] = cached.move;
+            SDL_AddAtomicInt(&job->cacheHits, 1);
+            printBatchResult(job, out, engine, item, &root, cached.nodes, 0);
+            continue;
+        }
+        engineNewGame(engine);
+        engineClearEvalCache(); // as with the hash table, so results don't depend on order
+        Uint64 start = SDL_GetTicksNS();
+        RootMoves root;
+        engineSearch(engine, &item->chess, &limits, &root);
+        Uint64 nodes = engineNodeCount(engine);
+        __atomic_fetch_add(&job->totalNodes, nodes, __ATOMIC_RELAXED);
+        printBatchResult(job, out, engine, item, &root, nodes, SDL_GetTicksNS() - start);
+        if (job->cache && root.count > 0 && root.depthDone > 0) {
+            AnalysisEntry result = { item->chess.hashKey, nodes, root.lastScore, root.moves[0], root.depthDone };
+            analysisCacheStore(job->cache, &result);
+        }
+    }
+    engineEvalCacheStats(&probes, &hits);
+    __atomic_fetch_add(&job->evalProbes, probes - probesBefore, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&job->evalHits, hits - hitsBefore, __ATOMIC_RELAXED);
+    SDL_free(item);
+    engineDestroy(engine);
+    outputClose(out);
+    return 0;
+}
+
+static SDL_AppResult runBatchCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s batch <file> [depth N] [nodes N] [hash MB] [threads N] [json] [noevalcache] [nnue FILE] [eval] [gpu SHADER] "
+                "[dedup MB] [cache FILE]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    BatchJob job;
+    SDL_memset(&job, 0, sizeof(job));
+    job.hashMB = BATCH_HASH_MB;
+    job.evalCache = DEFAULT_SEARCH_OPTIONS.evalCache;
+    int threads = SDL_GetNumLogicalCPUCores();
+    bool pinThreads = false;
+    const char* network = NULL;
+    const char* shader = NULL;
+    const char* cachePath = NULL;
+    size_t dedupMB = 0;
+    for (int i = 3; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "json") == 0) job.json = true;
+        else if (SDL_strcmp(argv[i], "noevalcache") == 0) job.evalCache = false;
+        else if (SDL_strcmp(argv[i], "eval") == 0) job.staticEval = true;
+        else if (SDL_strcmp(argv[i], "--pin-threads") == 0) pinThreads = true;
+        else if (value && SDL_strcmp(argv[i], "depth") == 0) job.depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH), i++;
+        else if (value && SDL_strcmp(argv[i], "nodes") == 0) job.nodeLimit = SDL_strtoull(value, NULL, 10), i++;
+        else if (value && SDL_strcmp(argv[i], "hash") == 0) job.hashMB = (size_t)SDL_max(SDL_atoi(value), 0), i++;
+        else if (value && SDL_strcmp(argv[i], "nnue") == 0) network = value, i++;
+        else if (value && SDL_strcmp(argv[i], "gpu") == 0) shader = value, i++;
+        else if (value && SDL_strcmp(argv[i], "dedup") == 0) dedupMB = (size_t)SDL_max(SDL_atoi(value), 1), i++;
+        else if (value && SDL_strcmp(argv[i], "cache") == 0) cachePath = value, i++;
+        else if (value && SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS), i++;
+        else { SDL_Log("batch: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    if (job.depth == 0) job.depth = job.nodeLimit ? MOVE_DEPTH : BATCH_DEPTH;
+
+    if (!mapFile(&job.file, argv[2])) {
+        SDL_Log("batch: can't read %s: %s", argv[2], SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    size_t nameLength = SDL_strlen(argv[2]);
+    const char* extension = nameLength >= 4 ? argv[2] + nameLength - 4 : "";
+    bool packed = nameLength >= 5 && SDL_strcasecmp(argv[2] + nameLength - 5, ".pack") == 0;
+    job.format = SDL_strcasecmp(extension, ".pgn") == 0 ? BATCH_PGN : SDL_strcasecmp(extension, ".bin") == 0 || packed ? BATCH_SHARD : BATCH_EPD;
+    job.queue = SDL_malloc(sizeof(BatchItem) * BATCH_QUEUE_SIZE);
+    job.queueLock = SDL_CreateMutex();
+    job.queueChanged = SDL_CreateCondition();
+    job.output.lock = SDL_CreateMutex();
+    SDL_AppResult result = SDL_APP_FAILURE;
+    engineInitTables();
+    if (!job.queue || !job.queueLock || !job.queueChanged || !job.output.lock || (network && !nnueLoad(network))) goto done;
+    if (dedupMB > 0 && !(job.filter = positionFilterCreate(dedupMB << 20))) {
+        SDL_Log("batch: no memory for a %zu MB position filter", dedupMB);
+        goto done;
+    }
+    if (cachePath && job.staticEval) SDL_Log("batch: the cache is for searches, evaluating every position");
+    else if (cachePath && !(job.cache = analysisCacheOpen(cachePath))) goto done;
+    if (shader && !job.staticEval) SDL_Log("batch: gpu is for eval, searching on the CPU");
+    else if (shader && !(job.gpu = gpuEvalCreate(shader))) SDL_Log("batch: evaluating on the CPU");
+
+    if (!engineStartThreads(threads, pinThreads)) SDL_Log("batch: no worker threads, searching on this one");
+    Uint64 start = SDL_GetTicksNS();
+    SDL_Thread* reader = SDL_CreateThread(batch_reader, "batch reader", &job);
+    if (!reader) {
+        SDL_Log("batch: can't start the reader: %s", SDL_GetError());
+        engineStopThreads();
+        goto done;
+    }
+    int workers = engineRunOnThreads(batch_worker, &job);
+    SDL_WaitThread(reader, NULL);
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+    engineStopThreads();
+
+    double seconds = (double)elapsed / 1e9;
+    if (job.staticEval)
+        SDL_Log("batch: %d positions evaluated in %.3f s (%.0f positions/s, %d threads)", job.positions, seconds,
+                seconds > 0 ? job.positions / seconds : 0.0, workers);
+    else SDL_Log("batch: %d positions, %" SDL_PRIu64 " nodes in %.3f s (%.0f nodes/s, %d threads)", job.positions,
+                 job.totalNodes, seconds, seconds > 0 ? (double)job.totalNodes / seconds : 0.0, workers);
+    if (job.evalProbes > 0)
+        SDL_Log("batch: eval cache %" SDL_PRIu64 " of %" SDL_PRIu64 " probes hit (%.1f%%)", job.evalHits,
+                job.evalProbes, 100.0 * (double)job.evalHits / (double)job.evalProbes);
+    if (job.cache)
+        SDL_Log("batch: %d of %d positions answered from the cache, %zu in it", SDL_GetAtomicInt(&job.cacheHits),
+                job.positions, job.cache->count);
+    if (job.filter)
+        SDL_Log("batch: %d duplicate positions skipped (%zu MB filter, false-positive rate %.4f%%)", job.duplicates,
+                positionFilterBytes(job.filter) >> 20, 100.0 * positionFilterFalsePositiveRate(job.filter));
+    if (job.output.failed) SDL_Log("batch: results lost, stdout wouldn't take them");
+    result = SDL_GetAtomicInt(&job.failed) || job.output.failed ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+done:
+    analysisCacheClose(job.cache);
+    positionFilterDestroy(job.filter);
+    gpuEvalDestroy(job.gpu);
+    SDL_DestroyMutex(job.output.lock);
+    SDL_DestroyCondition(job.queueChanged);
+    SDL_DestroyMutex(job.queueLock);
+    SDL_free(job.queue);
+    unmapFile(&job.file);
+    return result;
+}
+
+/* Test suites: `main suite <file.epd> [movetime MS] [threads N] [hash MB] [json FILE]` searches every position of
+   a tactical EPD suite (WAC, ECM, STS and the like) for up to movetime and checks the move against the line's bm
+   operation, one of the best moves, or its am, none of the moves to avoid. The positions are searched on the
+   pool's workers side by side, each worker an engine with a hash table of its own, cleared before every position.
+   A position's time to solution is when the search settled on a right move for good: the iteration from which
+   every best line (engineSearch's info events) starts with a right move to the end of the search. Each position
+   is printed in the file's order with that time and depth, or the move it played instead; then the solved count
+   and the total of the times, an unsolved position counting as the whole movetime. `json` writes the two to a
+   benchmark record for `main benchcompare`, all a search change needs to show it finds more or finds it sooner.
+   STS's c0 points for the second-best moves aren't read: a position is solved or it isn't. */
+#define SUITE_MOVETIME_MS 1000
+#define SUITE_HASH_MB 16   // per worker
+#define SUITE_MOVES 8      // of a bm or am operation
+#define SUITE_ID_MAX 32
+
+typedef struct {
+    ChessState chess;
+    int number;                 // line of the file
+    char id[SUITE_ID_MAX];      // the id operation, or empty
+    Move moves[SUITE_MOVES];    // bm's, or am's when avoid
+    int moveCount;
+    bool avoid;
+    Move played;                // the results, from the worker that searched it
+    int solvedMs;               // -1: not solved
+    int solvedDepth, depth;
+} SuitePosition;
+
+typedef struct {
+    SuitePosition* positions;
+    int count;
+    SearchLimits limits;
+    size_t hashMB;
+    SDL_AtomicInt next;         // positions handed out
+    SDL_AtomicInt failed;
+} SuiteJob;
+
+// the operands of an EPD operation, a quoted string's without its quotes; false when the line has no such opcode
+static bool epdOperation(const char* p, const char* end, const char* opcode, const char** operands, int* length) {
+    size_t opcodeLength = SDL_strlen(opcode);
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ';')) p++;
+        const char* word = p;
+        while (p < end && *p != ' ' && *p != ';') p++;
+        bool match = (size_t)(p - word) == opcodeLength && SDL_strncmp(word, opcode, opcodeLength) == 0;
+        while (p < end && *p == ' ') p++;
+        const char* start = p;
+        bool quoted = false;
+        while (p < end && (quoted || *p != ';')) quoted ^= *p++ == '"';
+        const char* stop = p;
+        while (stop > start && stop[-1] == ' ') stop--;
+        if (stop - start >= 2 && *start == '"' && stop[-1] == '"') start++, stop--;
+        if (match) {
+            *operands = start, *length = (int)(stop - start);
+            return true;
+        }
+    }
+    return false;
+}
+
+// a line's position and its bm or am moves; false, logged, for a line that has neither or a move that isn't legal
+static bool readSuitePosition(SuitePosition* s, const char* line, int number) {
+    SDL_memset(s, 0, sizeof(*s));
+    s->chess = initChessState();
+    s->number = number;
+    if (!loadFen(&s->chess, line)) {
+        SDL_Log("suite: line %d: bad EPD: %s", number, line);
+        return false;
+    }
+    const char* end = line + SDL_strlen(line);
+    const char* operations;
+    epdPositionFields(line, end, &operations);
+    const char* operands;
+    int length;
+    if (epdOperation(operations, end, "id", &operands, &length))
+        SDL_strlcpy(s->id, operands, (size_t)SDL_min(length + 1, SUITE_ID_MAX));
+    s->avoid = !epdOperation(operations, end, "bm", &operands, &length);
+    if (s->avoid && !epdOperation(operations, end, "am", &operands, &length)) {
+        SDL_Log("suite: line %d: no bm or am", number);
+        return false;
+    }
+    for (const char* p = operands, *stop = operands + length; p < stop && s->moveCount < SUITE_MOVES;) {
+        while (p < stop && (*p == ' ' || *p == ',')) p++;
+        const char* san = p;
+        while (p < stop && *p != ' ' && *p != ',') p++;
+        if (p == san) break;
+        Move move = parseSanMove(&s->chess, san, (int)(p - san));
+        if (move == MOVE_NONE) {
+            SDL_Log("suite: line %d: %.*s isn't a legal move", number, (int)(p - san), san);
+            return false;
+        }
+        s->moves[s->moveCount++] = move;
+    }
+    return s->moveCount > 0;
+}
+
+static bool suiteMoveRight(const SuitePosition* s, Move move) {
+    bool listed = false;
+    for (int i = 0; i < s->moveCount; i++) listed |= s->moves[i] == move;
+    return listed != s->avoid;
+}
+
+// each iteration's best line: a wrong first move starts the time to solution over
+static void suiteEngineEvent(const EngineEvent* event, void* userData) {
+    SuitePosition* s = userData;
+    if (event->type != ENGINE_EVENT_INFO || event->lineIndex != 0 || event->line.length == 0) return;
+    s->depth = event->depth;
+    if (!suiteMoveRight(s, event->line.moves[0])) s->solvedMs = -1;
+    else if (s->solvedMs < 0) s->solvedMs = event->elapsedMs, s->solvedDepth = event->depth;
+}
+
+static int SDLCALL suite_worker(void* data) {
+    SuiteJob* job = data;
+    Engine* engine = engineCreate();
+    if (!engine || !engineSetHash(engine, job->hashMB)) {
+        SDL_Log("suite: can't make an engine for a worker: %s", SDL_GetError());
+        SDL_SetAtomicInt(&job->failed, 1);
+        engineDestroy(engine);
+        return 0;
+    }
+    engine->onEvent = suiteEngineEvent;
+    for (int i; (i = SDL_AddAtomicInt(&job->next, 1)) < job->count;) {
+        SuitePosition* s = &job->positions[i];
+        engineNewGame(engine);
+        engine->userData = s;
+        s->solvedMs = -1;
+        ChessState chess = s->chess;
+        RootMoves root;
+        s->played = engineSearch(engine, &chess, &job->limits, &root);
+        if (!suiteMoveRight(s, s->played)) s->solvedMs = -1; // answered without an iteration, or the last one cut short
+    }
+    engineDestroy(engine);
+    return 0;
+}
+
+static SDL_AppResult runSuiteCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s suite <file.epd> [movetime MS] [threads N] [hash MB] [json FILE]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    SuiteJob job;
+    SDL_memset(&job, 0, sizeof(job));
+    int movetime = SUITE_MOVETIME_MS;
+    int threads = SDL_GetNumLogicalCPUCores();
+    job.hashMB = SUITE_HASH_MB;
+    const char* jsonPath = NULL;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1]; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "movetime") == 0) movetime = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "hash") == 0) job.hashMB = (size_t)SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "json") == 0) jsonPath = value;
+        else { SDL_Log("suite: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    job.limits.depth = MOVE_DEPTH;
+    job.limits.softTimeNS = job.limits.hardTimeNS = (Uint64)movetime * 1000000;
+    engineInitTables();
+    MappedFile file;
+    if (!mapFile(&file, argv[2])) {
+        SDL_Log("suite: can't read %s: %s", argv[2], SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    SDL_AppResult result = SDL_APP_FAILURE;
+    int capacity = 0, skipped = 0;
+    const char* p = file.data;
+    const char* end = file.data + file.size;
+    for (int number = 1; p < end; number++) { // one position per line; blank lines and # comments skipped
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        const char* last = eol ? eol : end;
+        const char* next = eol ? eol + 1 : end;
+        while (last > p && (last[-1] == '\r' || last[-1] == ' ' || last[-1] == '\t')) last--;
+        while (p < last && (*p == ' ' || *p == '\t')) p++;
+        if (p < last && *p != '#') {
+            if (job.count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                SuitePosition* positions = SDL_realloc(job.positions, sizeof(SuitePosition) * (size_t)capacity);
+                if (!positions) {
+                    SDL_Log("suite: out of memory");
+                    goto done;
+                }
+                job.positions = positions;
+            }
+            char line[BATCH_LINE_MAX];
+            SDL_strlcpy(line, p, SDL_min((size_t)(last - p) + 1, sizeof(line)));
+            if (readSuitePosition(&job.positions[job.count], line, number)) job.count++;
+            else skipped++;
+        }
+        p = next;
+    }
+    if (job.count == 0) {
+        SDL_Log("suite: no positions with a bm or am in %s", argv[2]);
+        goto done;
+    }
+
+    Uint64 start = SDL_GetTicksNS();
+    if (!engineStartThreads(SDL_min(threads, job.count), false)) SDL_Log("suite: no worker threads, searching on this one");
+    int workers = engineRunOnThreads(suite_worker, &job);
+    engineStopThreads();
+    if (SDL_GetAtomicInt(&job.failed)) goto done;
+    double wall = (double)(SDL_GetTicksNS() - start) / 1e9;
+
+    int solved = 0;
+    Uint64 totalMs = 0;
+    for (int i = 0; i < job.count; i++) {
+        SuitePosition* s = &job.positions[i];
+        char played[MOVE_SAN_MAX], wanted[SUITE_MOVES * (MOVE_SAN_MAX + 1)] = "";
+        char name[SUITE_ID_MAX + 16];
+        if (s->id[0]) SDL_strlcpy(name, s->id, sizeof(name));
+        else SDL_snprintf(name, sizeof(name), "line %d", s->number);
+        if (s->played != MOVE_NONE) moveToSan(&s->chess, s->played, played);
+        else SDL_strlcpy(played, "-", sizeof(played));
+        if (s->solvedMs >= 0) {
+            solved++;
+            totalMs += (Uint64)s->solvedMs;
+            SDL_Log("%-16s %-8s solved in %6d ms at depth %2d", name, played, s->solvedMs, s->solvedDepth);
+            continue;
+        }
+        totalMs += (Uint64)movetime;
+        for (int k = 0; k < s->moveCount; k++) {
+            char san[MOVE_SAN_MAX];
+            moveToSan(&s->chess, s->moves[k], san);
+            if (k > 0) SDL_strlcat(wanted, " ", sizeof(wanted));
+            SDL_strlcat(wanted, san, sizeof(wanted));
+        }
+        SDL_Log("%-16s %-8s not solved, depth %2d (%s %s)", name, played, s->depth, s->avoid ? "am" : "bm", wanted);
+    }
+    SDL_Log("suite: %d of %d solved (%.1f%%) at %d ms a position, %.3f s to the solutions, %.3f s in all (%d threads)",
+            solved, job.count, 100.0 * solved / job.count, movetime, (double)totalMs / 1000, wall, workers);
+    if (skipped) SDL_Log("suite: %d line%s of %s skipped", skipped, skipped == 1 ? "" : "s", argv[2]);
+    if (jsonPath) {
+        BenchResult results[] = {
+            { .name = "solved", .value = solved, .lowerIsBetter = false },
+            { .name = "time to solution", .value = (double)totalMs / 1000, .lowerIsBetter = true },
+        };
+        if (!writeBenchRecord(jsonPath, "suite", 0, results, (int)SDL_arraysize(results))) {
+            SDL_Log("suite: can't write %s: %s", jsonPath, SDL_GetError());
+            goto done;
+        }
+    }
+    result = SDL_APP_SUCCESS;
+done:
+    SDL_free(job.positions);
+    unmapFile(&file);
+    return result;
+}
+
+/* Game annotation: `main annotate <games.pgn> [game N] [depth N] [movetime MS] [hash MB] [threads N] [out FILE]`
+   analyses every position of one game of the file (the first, or game N) and writes the game back as PGN with the
+   analysis in it: after each move its score for white and the depth, and where the move lost ANNOTATE_DUBIOUS_CP
+   or more against the engine's choice a ?!, ? or ?? (ANNOTATE_MISTAKE_CP, ANNOTATE_BLUNDER_CP) and the line it
+   preferred as a variation. The positions are searched on the pool's workers side by side, one each, every
+   worker's engine searching with one shared hash table (engineBorrowHash); they're handed out from the end of the
+   game back, so the later positions, searched first, have left their results in the table for the earlier ones
+   that lead to them. A game takes about as long as its slowest position, given as many threads as positions. */
+#define ANNOTATE_DEPTH 14
+#define ANNOTATE_HASH_MB 256
+#define ANNOTATE_DUBIOUS_CP 50
+#define ANNOTATE_MISTAKE_CP 100
+#define ANNOTATE_BLUNDER_CP 200
+#define ANNOTATE_SCORE_CAP 1500  // scores past this (mates among them) count as this much when a move's loss is worked out
+#define ANNOTATE_LINE_PLIES 8    // of the preferred line
+#define ANNOTATE_MOVE_TEXT 256   // room in the PGN for one move, its comment and its variation
+
+typedef struct {
+    int score;       // for the side to move
+    int depth;       // 0: not searched, the game is over
+    Move pv[ANNOTATE_LINE_PLIES];
+    int pvLength;
+} AnnotatedPosition;
+
+typedef struct {
+    int wanted;                 // the game of the file, from 1
+    ChessState* positions;      // before each move, then the one the game ends in
+    Move* moves;
+    int count, capacity;        // moves; positions has one more
+    int result;                 // white's, or PGN_NO_RESULT
+    bool found, outOfMemory;
+} AnnotateGame;
+
+typedef struct {
+    const AnnotateGame* game;
+    AnnotatedPosition* results; // by position
+    Engine* owner;              // keeps the hash table the workers' engines share
+    SearchLimits limits;
+    SDL_AtomicInt next;         // positions handed out, the last first
+    SDL_AtomicInt failed;
+} AnnotateJob;
+
+static void addAnnotatePosition(void* context, const ChessState* position, Move move, int game, int ply, int result) {
+    AnnotateGame* g = context;
+    (void)ply;
+    if (game != g->wanted || g->outOfMemory) return;
+    g->found = true;
+    if (g->count + 1 >= g->capacity) {
+        int capacity = g->capacity ? g->capacity * 2 : 128;
+        ChessState* positions = SDL_realloc(g->positions, sizeof(ChessState) * (size_t)capacity);
+        if (positions) g->positions = positions;
+        Move* moves = SDL_realloc(g->moves, sizeof(Move) * (size_t)capacity);
+        if (moves) g->moves = moves;
+        if (!positions || !moves) { g->outOfMemory = true; return; }
+        g->capacity = capacity;
+    }
+    g->positions[g->count] = *position;
+    if (move == MOVE_NONE) g->result = result; // the position it ends in
+    else g->moves[g->count++] = move;
+}
+
+static int SDLCALL annotate_worker(void* data) {
+    AnnotateJob* job = data;
+    Engine* engine = engineCreate();
+    if (!engine || !engineBorrowHash(engine, job->owner)) {
+        SDL_Log("annotate: can't make an engine for a worker: %s", SDL_GetError());
+        SDL_SetAtomicInt(&job->failed, 1);
+        engineDestroy(engine);
+        return 0;
+    }
+    for (int i; (i = SDL_AddAtomicInt(&job->next, 1)) <= job->game->count;) {
+        int index = job->game->count - i;
+        ChessState chess = job->game->positions[index];
+        AnnotatedPosition* result = &job->results[index];
+        MoveList legal;
+        getAllMoves(&chess, &legal);
+        if (legal.count == 0) { // mate or stalemate: nothing to search
+            result->score = isKingInCheck(&chess, chess.whiteToMove) ? -MATE_SCORE : DRAW_SCORE;
+            continue;
+        }
+        RootMoves root;
+        Move best = engineSearch(engine, &chess, &job->limits, &root);
+        Move pv[MAX_PV_LENGTH];
+        int length = engineLine(engine, &chess, best, pv);
+        result->score = root.lastScore;
+        result->depth = root.depthDone;
+        result->pvLength = SDL_min(length, ANNOTATE_LINE_PLIES);
+        SDL_memcpy(result->pv, pv, sizeof(Move) * (size_t)result->pvLength);
+    }
+    engineDestroy(engine);
+    return 0;
+}
+
+// white's score as "+0.35/14", or "#3/14" and "#-2/14" for a mate in that many moves
+static int formatAnnotateScore(char* out, size_t size, int whiteScore, int depth) {
+    if (abs(whiteScore) >= MATE_BOUND) return SDL_snprintf(out, size, "#%d/%d", mateInMoves(whiteScore), depth);
+    return SDL_snprintf(out, size, "%+.2f/%d", whiteScore / 100.0, depth);
+}
+
+// the words of the PGN wrapped at 79 columns, as writeMatchPgn has them
+static void annotateWord(char* text, size_t size, size_t* n, int* column, const char* word) {
+    size_t length = SDL_strlen(word);
+    if (*n + length + 2 >= size) return;
+    if (*column > 0 && *column + 1 + (int)length > 79) text[(*n)++] = '\n', *column = 0;
+    else if (*column > 0) text[(*n)++] = ' ', (*column)++;
+    SDL_memcpy(text + *n, word, length);
+    *n += length, *column += (int)length;
+    text[*n] = '\0';
+}
+
+// the move in SAN, with its number when white plays it or it opens a line
+static void annotateMoveText(ChessState* chess, Move move, bool numbered, char word[MOVE_SAN_MAX + 16]) {
+    char san[MOVE_SAN_MAX];
+    moveToSan(chess, move, san);
+    if (chess->whiteToMove || numbered)
+        SDL_snprintf(word, MOVE_SAN_MAX + 16, "%d%s %s", chess->fullmoveNumber, chess->whiteToMove ? "." : "...", san);
+    else SDL_strlcpy(word, san, MOVE_SAN_MAX + 16);
+}
+
+// the tag section of game number `wanted`, by the same count of games as readPgnGames
+static void pgnGameTags(const char* p, const char* end, int wanted, const char** tags, size_t* length) {
+    int number = 0;
+    bool inTags = false;
+    *tags = NULL, *length = 0;
+    while (p < end) {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        const char* next = eol ? eol + 1 : end;
+        if (*p == '[') {
+            if (!inTags) number++, inTags = true;
+            if (number == wanted && !*tags) *tags = p;
+            if (number == wanted) *length = (size_t)(next - *tags);
+        } else if (*p != '\n' && *p != '\r') {
+            inTags = false;
+        }
+        if (number > wanted) break;
+        p = next;
+    }
+}
+
+static SDL_AppResult runAnnotateCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s annotate <games.pgn> [game N] [depth N] [movetime MS] [hash MB] [threads N] [out FILE]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    AnnotateGame game = { .wanted = 1, .result = PGN_NO_RESULT };
+    AnnotateJob job;
+    SDL_memset(&job, 0, sizeof(job));
+    job.game = &game;
+    int threads = SDL_GetNumLogicalCPUCores();
+    size_t hashMB = ANNOTATE_HASH_MB;
+    const char* outPath = NULL;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1]; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "game") == 0) game.wanted = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "depth") == 0) job.limits.depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH);
+        else if (SDL_strcmp(argv[i], "movetime") == 0) job.limits.softTimeNS = job.limits.hardTimeNS = SDL_strtoull(value, NULL, 10) * 1000000;
+        else if (SDL_strcmp(argv[i], "hash") == 0) hashMB = (size_t)SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "out") == 0) outPath = value;
+        else { SDL_Log("annotate: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    if (job.limits.depth == 0) job.limits.depth = job.limits.hardTimeNS ? MOVE_DEPTH : ANNOTATE_DEPTH;
+    engineInitTables();
+    MappedFile file;
+    if (!mapFile(&file, argv[2])) {
+        SDL_Log("annotate: can't read %s: %s", argv[2], SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    SDL_AppResult result = SDL_APP_FAILURE;
+    char* text = NULL;
+    readPgnGames(file.data, file.data + file.size, addAnnotatePosition, &game); // a bad game is logged, and ends there
+    if (game.outOfMemory || !game.found) {
+        SDL_Log(game.found ? "annotate: out of memory" : "annotate: no game %d in %s", game.wanted, argv[2]);
+        goto done;
+    }
+    job.results = SDL_calloc((size_t)game.count + 1, sizeof(AnnotatedPosition));
+    job.owner = engineCreate();
+    if (!job.results || !job.owner || !engineSetHash(job.owner, hashMB)) {
+        SDL_Log("annotate: out of memory");
+        goto done;
+    }
+
+    Uint64 start = SDL_GetTicksNS();
+    if (!engineStartThreads(SDL_min(threads, game.count + 1), false)) SDL_Log("annotate: no worker threads, searching on this one");
+    int workers = engineRunOnThreads(annotate_worker, &job);
+    engineStopThreads();
+    if (SDL_GetAtomicInt(&job.failed)) goto done;
+
+    const char* tags;
+    size_t tagsLength;
+    pgnGameTags(file.data, file.data + file.size, game.wanted, &tags, &tagsLength);
+    size_t size = tagsLength + (size_t)(game.count + 2) * ANNOTATE_MOVE_TEXT + 256, n = 0;
+    text = SDL_malloc(size);
+    if (!text) {
+        SDL_Log("annotate: out of memory");
+        goto done;
+    }
+    n = (size_t)SDL_snprintf(text, size, "%.*s[Annotator \"main annotate, depth %d\"]\n\n", (int)tagsLength, tags ? tags : "",
+                             job.limits.depth);
+    int column = 0, marked = 0;
+    for (int i = 0; i < game.count; i++) {
+        ChessState chess = game.positions[i];
+        const AnnotatedPosition* before = &job.results[i];
+        const AnnotatedPosition* after = &job.results[i + 1];
+        char word[MOVE_SAN_MAX + 16], comment[64];
+        annotateMoveText(&chess, game.moves[i], i == 0, word);
+        // what the move cost the side that played it, against the engine's own choice
+        int loss = SDL_clamp(before->score, -ANNOTATE_SCORE_CAP, ANNOTATE_SCORE_CAP) + SDL_clamp(after->score, -ANNOTATE_SCORE_CAP, ANNOTATE_SCORE_CAP);
+        bool preferred = before->pvLength > 0 && before->pv[0] != game.moves[i];
+        const char* mark = !preferred || loss < ANNOTATE_DUBIOUS_CP ? "" : loss < ANNOTATE_MISTAKE_CP ? "?!" : loss < ANNOTATE_BLUNDER_CP ? "?" : "??";
+        SDL_strlcat(word, mark, sizeof(word));
+        annotateWord(text, size, &n, &column, word);
+        int whiteAfter = chess.whiteToMove ? -after->score : after->score; // after is scored for the other side
+        if (after->depth > 0) {
+            SDL_strlcpy(comment, "{", sizeof(comment));
+            formatAnnotateScore(comment + 1, sizeof(comment) - 2, whiteAfter, after->depth);
+            SDL_strlcat(comment, "}", sizeof(comment));
+            annotateWord(text, size, &n, &column, comment);
+        }
+        if (*mark) { // the line the engine would have played instead
+            marked++;
+            ChessState line = chess;
+            for (int k = 0; k < before->pvLength; k++) {
+                annotateMoveText(&line, before->pv[k], k == 0, word);
+                if (k == 0) SDL_memmove(word + 1, word, SDL_strlen(word) + 1), word[0] = '(';
+                if (k == before->pvLength - 1) SDL_strlcat(word, ")", sizeof(word));
+                annotateWord(text, size, &n, &column, word);
+                makeMove(&line, before->pv[k], NULL);
+            }
+        }
+    }
+    static const char* RESULTS[] = { "0-1", "1/2-1/2", "1-0" }; // by white's result + 1
+    annotateWord(text, size, &n, &column, game.result == PGN_NO_RESULT ? "*" : RESULTS[game.result + 1]);
+    n += (size_t)SDL_snprintf(text + n, size - n, "\n\n");
+    if (outPath) {
+        SDL_IOStream* out = SDL_IOFromFile(outPath, "w");
+        bool written = out && SDL_WriteIO(out, text, n) == n;
+        if (out && !SDL_CloseIO(out)) written = false;
+        if (!written) {
+            SDL_Log("annotate: can't write %s: %s", outPath, SDL_GetError());
+            goto done;
+        }
+    } else {
+        fwrite(text, 1, n, stdout);
+        fflush(stdout);
+    }
+    SDL_Log("annotate: %d moves of game %d analysed to depth %d in %.3f s (%d threads), %d marked", game.count,
+            game.wanted, job.limits.depth, (double)(SDL_GetTicksNS() - start) / 1e9, workers, marked);
+    result = SDL_APP_SUCCESS;
+done:
+    SDL_free(text);
+    engineDestroy(job.owner);
+    SDL_free(job.results);
+    SDL_free(game.positions);
+    SDL_free(game.moves);
+    unmapFile(&file);
+    return result;
+}
+
+/* Self-play: `main selfplay <prefix> [games N] [depth N] [nodes N] [hash MB] [threads N] [random N] [seed N]
+   [packed] [dedup MB] [adjudicate RULES]` plays the engine against itself for evaluation tuning and network training data, one game per pool
+   worker at a time. Every position it searches goes out as a training record (see engine.h) once the game's
+   result is in, each worker writing a shard of its own, <prefix>-<worker>.bin, a buffer at a time, so no worker
+   waits on another or on a shared file; with `packed` the shards are compressed, <prefix>-<worker>.pack
+   (ShardWriter). The first `random` plies of each game are picked at random so the games differ; a game's moves
+   depend only on the seed and its number, not on the thread that played it. `dedup` shares a position filter of
+   that many megabytes (PositionFilter) between the workers and drops every record of a position some game has
+   written already, so the common openings aren't in the data over and over; which game's copy is kept then
+   depends on the threads' timing. `adjudicate` ends games early by the rules below (Adjudication); the records
+   of such a game get the result it was called at. `main batch` and `main tune` read the shards back. */
+#define SELFPLAY_DEPTH 6
+#define SELFPLAY_RANDOM_PLIES 8
+#define SELFPLAY_MAX_PLY 400          // a game still going then is called a draw
+#define SELFPLAY_BUFFER_RECORDS 4096  // per worker; at least SELFPLAY_MAX_PLY, a game never straddles two writes
+#define SELFPLAY_ONGOING 2            // not a result
+
+/* Adjudication, for selfplay, match and spsa (`adjudicate RULES`, a comma-separated list): games are called once
+   the result is clear rather than played out. `resign=CP` gives the game to a side every search has scored at
+   least CP for over the last `resignmoves` moves of both sides; `draw=CP` calls it drawn once every score has
+   stayed within CP of level as long (`drawmoves`), from ply `drawply` on; `tb` takes the tablebases' (and the KPK
+   bitbase's) verdict as soon as few enough men are left. A bare resign or draw takes the default margin. */
+#define ADJUDICATE_RESIGN_CP 1000
+#define ADJUDICATE_RESIGN_MOVES 4
+#define ADJUDICATE_DRAW_CP 10
+#define ADJUDICATE_DRAW_MOVES 8
+#define ADJUDICATE_DRAW_PLY 80
+
+typedef struct {
+    int resignScore, resignMoves; // resignScore 0: no resigning
+    int drawScore, drawMoves, drawFromPly; // drawScore -1: no draws called
+    bool tablebases;
+} Adjudication;
+
+#define NO_ADJUDICATION ((Adjudication){ 0, ADJUDICATE_RESIGN_MOVES, -1, ADJUDICATE_DRAW_MOVES, ADJUDICATE_DRAW_PLY, false })
+
+typedef struct {
+    int decided, decidedFor; // searches in a row scored beyond the resign margin, and for which side (1 white)
+    int level;               // searches in a row within the draw margin
+} AdjudicationRun;
+
+// false at the first rule it doesn't know
+static bool parseAdjudication(Adjudication* rules, const char* list) {
+    static const char* const NAMES[] = { "resign", "resignmoves", "draw", "drawmoves", "drawply", "tb" };
+    while (*list) {
+        const char* end = SDL_strchr(list, ',');
+        size_t length = end ? (size_t)(end - list) : SDL_strlen(list);
+        const char* equals = memchr(list, '=', length);
+        size_t nameLength = equals ? (size_t)(equals - list) : length;
+        int rule = -1;
+        for (int i = 0; i < (int)SDL_arraysize(NAMES); i++)
+            if (SDL_strlen(NAMES[i]) == nameLength && SDL_strncasecmp(NAMES[i], list, nameLength) == 0) rule = i;
+        int value = equals ? SDL_max(SDL_atoi(equals + 1), 0) : -1;
+        switch (rule) {
+        case 0: rules->resignScore = value > 0 ? value : ADJUDICATE_RESIGN_CP; break;
+        case 1: rules->resignMoves = SDL_max(value, 1); break;
+        case 2: rules->drawScore = value >= 0 ? value : ADJUDICATE_DRAW_CP; break;
+        case 3: rules->drawMoves = SDL_max(value, 1); break;
+        case 4: rules->drawFromPly = SDL_max(value, 0); break;
+        case 5: rules->tablebases = value != 0; break;
+        default: return false;
+        }
+        list += length;
+        if (*list == ',') list++;
+    }
+    return true;
+}
+
+// before the position is searched: white's result from the tablebases, when they have it, else SELFPLAY_ONGOING
+static int adjudicateEnding(const Adjudication* rules, const ChessState* chess) {
+    int score;
+    if (!rules->tablebases || !engineProbeTablebases(chess, &score)) return SELFPLAY_ONGOING;
+    int result = score > 0 ? 1 : score < 0 ? -1 : 0;
+    return chess->whiteToMove ? result : -result;
+}
+
+// after the search at ply, which scored the position for the side to move: white's result once it's called
+static int adjudicateScore(const Adjudication* rules, AdjudicationRun* run, const ChessState* chess, int ply, int score) {
+    int white = chess->whiteToMove ? score : -score;
+    int side = white > 0 ? 1 : -1;
+    if (rules->resignScore > 0 && abs(white) >= rules->resignScore) {
+        run->decided = run->decidedFor == side ? run->decided + 1 : 1;
+        run->decidedFor = side;
+        if (run->decided >= 2 * rules->resignMoves) return side;
+    } else {
+        run->decided = 0;
+    }
+    run->level = rules->drawScore >= 0 && abs(white) <= rules->drawScore ? run->level + 1 : 0;
+    if (run->level >= 2 * rules->drawMoves && ply >= rules->drawFromPly) return 0;
+    return SELFPLAY_ONGOING;
+}
+
+typedef struct {
+    const char* prefix;
+    int games;
+    SDL_AtomicInt nextGame;   // the next game for a worker to play
+    SDL_AtomicInt nextShard;  // names each worker's file
+    int depth;
+    Uint64 nodeLimit;         // 0 = depth only
+    size_t hashMB;
+    int randomPlies;
+    Uint64 seed;
+    bool packed;              // ShardWriter's format rather than raw records
+    PositionFilter* filter;   // `dedup`, NULL for none
+    Adjudication adjudication;
+    SDL_AtomicInt positions, whiteWins, draws, blackWins;
+    SDL_AtomicInt duplicates; // records the filter dropped
+    SDL_AtomicInt adjudicated;
+    SDL_AtomicInt failed;
+} SelfPlayJob;
+
+// 1, 0 or -1 for white once the game is over (mate, stalemate, fifty moves, threefold, bare kings), else SELFPLAY_ONGOING
+static int selfPlayResult(const ChessState* chess, const MoveList* legal) {
+    if (legal->count == 0) return isKingInCheck(chess, chess->whiteToMove) ? (chess->whiteToMove ? -1 : 1) : 0;
+    if (chess->halfmoveClock >= 100 || __builtin_popcountll(chess->occupied) == 2) return 0;
+    int repeats = 0, oldest = SDL_max(chess->keyCount - SDL_min(chess->halfmoveClock, KEY_HISTORY_SIZE), 0);
+    for (int i = chess->keyCount - 2; i >= oldest; i -= 2)
+        if (chess->keyHistory[i & (KEY_HISTORY_SIZE - 1)] == chess->hashKey && ++repeats == 2) return 0;
+    return SELFPLAY_ONGOING;
+}
+
+static bool flushShard(SelfPlayJob* job, SDL_IOStream* out, ShardWriter* writer, const Uint8* buffer, int records, const char* path) {
+    size_t bytes = (size_t)records * TRAINING_RECORD_SIZE;
+    bool written = true;
+    if (writer)
+        for (int i = 0; i < records && written; i++) written = shardWriterAdd(writer, buffer + (size_t)i * TRAINING_RECORD_SIZE);
+    else written = bytes == 0 || SDL_WriteIO(out, buffer, bytes) == bytes;
+    if (written) return true;
+    SDL_Log("selfplay: can't write %s: %s", path, SDL_GetError());
+    SDL_SetAtomicInt(&job->failed, 1);
+    return false;
+}
+
+// one per search thread: plays games until there are none left
+static int SDLCALL selfplay_worker(void* data) {
+    SelfPlayJob* job = data;
+    char path[1024];
+    SDL_snprintf(path, sizeof(path), "%s-%d.%s", job->prefix, SDL_AddAtomicInt(&job->nextShard, 1), job->packed ? "pack" : "bin");
+    Engine* engine = engineCreate();
+    Uint8* buffer = SDL_malloc((size_t)SELFPLAY_BUFFER_RECORDS * TRAINING_RECORD_SIZE);
+    SDL_IOStream* out = engine && buffer ? SDL_IOFromFile(path, "wb") : NULL;
+    ShardWriter* writer = out && job->packed ? shardWriterOpen(out) : NULL;
+    if (!out || (job->packed && !writer)) {
+        SDL_Log("selfplay: can't create %s: %s", path, SDL_GetError());
+        SDL_SetAtomicInt(&job->failed, 1);
+        if (out) SDL_CloseIO(out);
+        engineDestroy(engine);
+        SDL_free(buffer);
+        return 0;
+    }
+    if (job->hashMB > 0 && !engineSetHash(engine, job->hashMB)) SDL_Log("selfplay: no memory for a hash table, searching without");
+    SearchLimits limits = { .depth = job->depth, .nodes = job->nodeLimit };
+    int used = 0; // records in the buffer
+
+    for (int game; !SDL_GetAtomicInt(&job->failed) && (game = SDL_AddAtomicInt(&job->nextGame, 1)) < job->games;) {
+        if (used + SELFPLAY_MAX_PLY > SELFPLAY_BUFFER_RECORDS) {
+            if (!flushShard(job, out, writer, buffer, used, path)) break;
+            used = 0;
+        }
+        Uint64 random = job->seed ^ ((Uint64)(game + 1) * 0x9E3779B97F4A7C15ull);
+        ChessState chess = initChessState();
+        engineNewGame(engine);
+        engineClearEvalCache(); // so the game doesn't depend on the ones played before it on this thread
+        int first = used, result;
+        AdjudicationRun run = { 0 };
+        bool adjudicated = false;
+        for (int ply = 0;; ply++) {
+            MoveList legal;
+            getAllMoves(&chess, &legal);
+            result = selfPlayResult(&chess, &legal);
+            if (result != SELFPLAY_ONGOING) break;
+            if (ply == SELFPLAY_MAX_PLY) { result = 0; break; }
+            Move move;
+            if (ply < job->randomPlies) {
+                move = legal.moves[SDL_rand_r(&random, legal.count)];
+            } else {
+                if ((result = adjudicateEnding(&job->adjudication, &chess)) != SELFPLAY_ONGOING) { adjudicated = true; break; }
+                RootMoves root;
+                move = engineSearch(engine, &chess, &limits, &root); // searched all the same, for the move to play
+                if (job->filter && !positionFilterAdd(job->filter, chess.hashKey)) SDL_AddAtomicInt(&job->duplicates, 1);
+                else trainingRecordPack(&chess, root.lastScore, 0, buffer + (size_t)used++ * TRAINING_RECORD_SIZE);
+                if ((result = adjudicateScore(&job->adjudication, &run, &chess, ply, root.lastScore)) != SELFPLAY_ONGOING) { adjudicated = true; break; }
+            }
+            makeMove(&chess, move, NULL);
+        }
+        if (adjudicated) SDL_AddAtomicInt(&job->adjudicated, 1);
+        for (int i = first; i < used; i++) buffer[(size_t)i * TRAINING_RECORD_SIZE + 30] = (Uint8)(Sint8)result; // the result byte
+        SDL_AddAtomicInt(&job->positions, used - first);
+        SDL_AddAtomicInt(result > 0 ? &job->whiteWins : result < 0 ? &job->blackWins : &job->draws, 1);
+    }
+    flushShard(job, out, writer, buffer, used, path);
+    bool closed = !writer || shardWriterClose(writer); // the index and footer, before the file is closed
+    if (!SDL_CloseIO(out)) closed = false;
+    if (!closed) {
+        SDL_Log("selfplay: can't write %s: %s", path, SDL_GetError());
+        SDL_SetAtomicInt(&job->failed, 1);
+    }
+    SDL_free(buffer);
+    engineDestroy(engine);
+    return 0;
+}
+
+static SDL_AppResult runSelfPlayCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s selfplay <prefix> [games N] [depth N] [nodes N] [hash MB] [threads N] [random N] [seed N] [packed] "
+                "[dedup MB] [adjudicate RULES]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    SelfPlayJob job;
+    SDL_memset(&job, 0, sizeof(job));
+    job.prefix = argv[2];
+    job.games = 1;
+    job.adjudication = NO_ADJUDICATION;
+    job.hashMB = BATCH_HASH_MB;
+    job.randomPlies = SELFPLAY_RANDOM_PLIES;
+    int threads = SDL_GetNumLogicalCPUCores();
+    bool pinThreads = false;
+    size_t dedupMB = 0;
+    for (int i = 3; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "--pin-threads") == 0) pinThreads = true;
+        else if (SDL_strcmp(argv[i], "packed") == 0) job.packed = true;
+        else if (value && SDL_strcmp(argv[i], "dedup") == 0) dedupMB = (size_t)SDL_max(SDL_atoi(value), 1), i++;
+        else if (value && SDL_strcmp(argv[i], "games") == 0) job.games = SDL_max(SDL_atoi(value), 0), i++;
+        else if (value && SDL_strcmp(argv[i], "depth") == 0) job.depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH), i++;
+        else if (value && SDL_strcmp(argv[i], "nodes") == 0) job.nodeLimit = SDL_strtoull(value, NULL, 10), i++;
+        else if (value && SDL_strcmp(argv[i], "hash") == 0) job.hashMB = (size_t)SDL_max(SDL_atoi(value), 0), i++;
+        else if (value && SDL_strcmp(argv[i], "random") == 0) job.randomPlies = SDL_clamp(SDL_atoi(value), 0, SELFPLAY_MAX_PLY), i++;
+        else if (value && SDL_strcmp(argv[i], "seed") == 0) job.seed = SDL_strtoull(value, NULL, 10), i++;
+        else if (value && SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS), i++;
+        else if (value && SDL_strcmp(argv[i], "adjudicate") == 0 && parseAdjudication(&job.adjudication, value)) i++;
+        else { SDL_Log("selfplay: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    if (job.depth == 0) job.depth = job.nodeLimit ? MOVE_DEPTH : SELFPLAY_DEPTH;
+    if (dedupMB > 0 && !(job.filter = positionFilterCreate(dedupMB << 20))) {
+        SDL_Log("selfplay: no memory for a %zu MB position filter", dedupMB);
+        return SDL_APP_FAILURE;
+    }
+
+    engineInitTables();
+    if (!engineStartThreads(SDL_min(threads, SDL_max(job.games, 1)), pinThreads)) SDL_Log("selfplay: no worker threads, playing on this one");
+    Uint64 start = SDL_GetTicksNS();
+    int workers = engineRunOnThreads(selfplay_worker, &job);
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+    engineStopThreads();
+
+    double seconds = (double)elapsed / 1e9;
+    int positions = SDL_GetAtomicInt(&job.positions);
+    int whiteWins = SDL_GetAtomicInt(&job.whiteWins), draws = SDL_GetAtomicInt(&job.draws), blackWins = SDL_GetAtomicInt(&job.blackWins);
+    SDL_Log("selfplay: %d games (+%d =%d -%d for white, %d adjudicated), %d positions in %.3f s (%.0f positions/s, %d threads)",
+            whiteWins + draws + blackWins, whiteWins, draws, blackWins, SDL_GetAtomicInt(&job.adjudicated), positions, seconds,
+            seconds > 0 ? positions / seconds : 0.0, workers);
+    if (job.filter) {
+        SDL_Log("selfplay: %d duplicate positions dropped (%zu MB filter, false-positive rate %.4f%%)",
+                SDL_GetAtomicInt(&job.duplicates), positionFilterBytes(job.filter) >> 20,
+                100.0 * positionFilterFalsePositiveRate(job.filter));
+        positionFilterDestroy(job.filter);
+    }
+    return SDL_GetAtomicInt(&job.failed) ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+}
+
+/* Match: `main match [games N] [openings FILE] [random N] [depth N] [nodes N] [movetime MS] [hash MB] [threads N]
+   [a OPTIONS] [b OPTIONS] [pgn FILE] [sprt ELO0 ELO1] [seed N] [adjudicate RULES]` plays engine A against engine B, as many games at
+   once as there are threads, each game with an Engine (and hash table) per side. The two differ by their search
+   options, given as comma-separated name=value lists (`b nullmove=0,lmrmindepth=4`, names as in
+   SEARCH_OPTION_NAMES). Games come in pairs that start from the same opening with the colours swapped: the next
+   line of the FEN/EPD openings file, or `random` random plies from the start; `adjudicate` calls a game whose
+   result is clear (Adjudication) without playing it out. Every game goes to the PGN file if there is one. The summary gives A's score, the Elo difference with its 95% interval and, with `sprt`, the
+   log-likelihood ratio of elo1 against elo0; the match stops early once that crosses a bound (5% error each way). */
+#define MATCH_LINE_MAX 512   // an opening line is copied out of the mapping to parse
+#define MATCH_PGN_MAX 8192   // one game's PGN; SELFPLAY_MAX_PLY moves fit easily
+#define SPRT_BOUND 2.944     // log(0.95 / 0.05): alpha = beta = 0.05
+
+// the SearchOptions a match can set, by the name used on the command line
+static const struct { const char* name; size_t offset; bool isBool; } SEARCH_OPTION_NAMES[] = {
+    { "nullmove", offsetof(SearchOptions, nullMove), true },
+    { "nullmovereduction", offsetof(SearchOptions, nullMoveReduction), false },
+    { "nullmovemindepth", offsetof(SearchOptions, nullMoveMinDepth), false },
+    { "lmr", offsetof(SearchOptions, lateMoveReductions), true },
+    { "lmrmindepth", offsetof(SearchOptions, lmrMinDepth), false },
+    { "lmrminmoves", offsetof(SearchOptions, lmrMinMoves), false },
+    { "checkext", offsetof(SearchOptions, checkExtensions), true },
+    { "singularext", offsetof(SearchOptions, singularExtensions), true },
+    { "singularmindepth", offsetof(SearchOptions, singularMinDepth), false },
+    { "rfp", offsetof(SearchOptions, reverseFutility), true },
+    { "rfpdepth", offsetof(SearchOptions, reverseFutilityDepth), false },
+    { "rfpmargin", offsetof(SearchOptions, reverseFutilityMargin), false },
+    { "razoring", offsetof(SearchOptions, razoring), true },
+    { "razordepth", offsetof(SearchOptions, razorDepth), false },
+    { "razormargin", offsetof(SearchOptions, razorMargin), false },
+    { "futility", offsetof(SearchOptions, futilityPruning), true },
+    { "futilitydepth", offsetof(SearchOptions, futilityDepth), false },
+    { "futilitymargin", offsetof(SearchOptions, futilityMargin), false },
+    { "probcut", offsetof(SearchOptions, probCut), true },
+    { "probcutmindepth", offsetof(SearchOptions, probCutMinDepth), false },
+    { "probcutmargin", offsetof(SearchOptions, probCutMargin), false },
+    { "multicut", offsetof(SearchOptions, multiCut), true },
+    { "iir", offsetof(SearchOptions, internalReductions), true },
+    { "iirmindepth", offsetof(SearchOptions, iirMinDepth), false },
+    { "countermoves", offsetof(SearchOptions, counterMoves), true },
+    { "conthistory", offsetof(SearchOptions, continuationHistory), true },
+    { "aspiration", offsetof(SearchOptions, aspirationWindow), false },
+    { "paraspiration", offsetof(SearchOptions, parallelAspiration), true },
+    { "prefetchahead", offsetof(SearchOptions, prefetchAhead), false },
+    { "evalcache", offsetof(SearchOptions, evalCache), true },
+    { "nnue", offsetof(SearchOptions, nnue), true },
+    { "tablebases", offsetof(SearchOptions, tablebases), true },
+    { "cuckoo", offsetof(SearchOptions, upcomingRepetition), true },
+    { "deterministic", offsetof(SearchOptions, deterministic), true },
+    { "mcts", offsetof(SearchOptions, mcts), true },
+};
+
+// "name=value,name=value"; false at the first name it doesn't know
+static bool parseSearchOptions(SearchOptions* options, const char* list) {
+    while (*list) {
+        const char* end = SDL_strchr(list, ',');
+        size_t length = end ? (size_t)(end - list) : SDL_strlen(list);
+        const char* equals = memchr(list, '=', length);
+        size_t nameLength = equals ? (size_t)(equals - list) : length;
+        int value = equals ? SDL_atoi(equals + 1) : 1; // a bare name switches a feature on
+        bool found = false;
+        for (size_t i = 0; i < SDL_arraysize(SEARCH_OPTION_NAMES) && !found; i++) {
+            if (SDL_strlen(SEARCH_OPTION_NAMES[i].name) != nameLength || SDL_strncasecmp(SEARCH_OPTION_NAMES[i].name, list, nameLength) != 0) continue;
+            void* field = (char*)options + SEARCH_OPTION_NAMES[i].offset;
+            if (SEARCH_OPTION_NAMES[i].isBool) *(bool*)field = value != 0;
+            else *(int*)field = value;
+            found = true;
+        }
+        if (!found) return false;
+        list += length;
+        if (*list == ',') list++;
+    }
+    return true;
+}
+
+typedef struct {
+    SearchOptions options[2];  // engine A, engine B
+    int games;
+    SDL_AtomicInt nextGame;
+    const char** openings;     // lines of the openings file, in its buffer; NULL for random openings
+    const char* openingsEnd;   // the end of that buffer
+    int openingCount;
+    int randomPlies;
+    Uint64 seed;
+    int pairOffset;            // added to each game's pair for its opening, so a run of matches needn't repeat them
+    int depth;
+    Uint64 nodeLimit;          // 0 = none
+    Uint64 moveTimeNS;         // 0 = none
+    size_t hashMB;
+    SDL_IOStream* pgn;         // NULL for none
+    Adjudication adjudication;
+    bool sprt;
+    double elo0, elo1;
+    SDL_Mutex* lock;           // the counts, the PGN file and stopping
+    int wins, draws, losses;   // for A
+    int adjudicated;
+    bool stopped;              // the SPRT has decided
+    SDL_AtomicInt failed;
+} MatchJob;
+
+static double eloToScore(double elo) { return 1.0 / (1.0 + SDL_pow(10.0, -elo / 400.0)); }
+static double scoreToElo(double score) { return -400.0 * SDL_log10(1.0 / score - 1.0); }
+
+// A's mean score per game and its variance, false until there is some spread to measure
+static bool matchScore(const MatchJob* job, double* mean, double* variance) {
+    int n = job->wins + job->draws + job->losses;
+    if (n == 0) return false;
+    double p = (job->wins + 0.5 * job->draws) / n;
+    *mean = p;
+    *variance = (job->wins * (1 - p) * (1 - p) + job->draws * (0.5 - p) * (0.5 - p) + job->losses * p * p) / n;
+    return *variance > 0;
+}
+
+// normal approximation of the trinomial likelihood ratio, as fishtest's "GSPRT"
+static double sprtLlr(const MatchJob* job) {
+    double p, variance;
+    if (!matchScore(job, &p, &variance)) return 0.0;
+    double s0 = eloToScore(job->elo0), s1 = eloToScore(job->elo1);
+    int n = job->wins + job->draws + job->losses;
+    return n * (s1 - s0) * (2 * p - s0 - s1) / (2 * variance);
+}
+
+// the game's starting position: pairs share an opening, the opening file's lines taken in turn
+static bool matchOpening(MatchJob* job, int pair, ChessState* chess) {
+    *chess = initChessState();
+    if (job->openings) {
+        const char* line = job->openings[pair % job->openingCount];
+        char copy[MATCH_LINE_MAX];
+        size_t length = 0;
+        while (line + length < job->openingsEnd && line[length] != '\n' && length + 1 < sizeof(copy)) length++;
+        SDL_strlcpy(copy, line, length + 1);
+        return loadFen(chess, copy); // checked as the file was read, so only fails on a change underneath
+    }
+    Uint64 random = job->seed ^ ((Uint64)(pair + 1) * 0x9E3779B97F4A7C15ull);
+    for (int ply = 0; ply < job->randomPlies; ply++) {
+        MoveList legal;
+        getAllMoves(chess, &legal);
+        if (selfPlayResult(chess, &legal) != SELFPLAY_ONGOING) { // a random walk that ended the game: start again
+            *chess = initChessState();
+            ply = -1;
+            continue;
+        }
+        makeMove(chess, legal.moves[SDL_rand_r(&random, legal.count)], NULL);
+    }
+    chess->halfmoveClock = 0;
+    chess->keyCount = 0; // the opening's repetitions aren't the game's
+    return true;
+}
+
+static void writeMatchPgn(MatchJob* job, int game, bool aWhite, const ChessState* start, const Move* moves, int count, int result,
+                          bool adjudicated) {
+    static const char* RESULTS[] = { "0-1", "1/2-1/2", "1-0" }; // by white's result + 1
+    char text[MATCH_PGN_MAX], fen[FEN_MAX];
+    int n = SDL_snprintf(text, sizeof(text), "[Event \"match\"]\n[Round \"%d\"]\n[White \"%s\"]\n[Black \"%s\"]\n[Result \"%s\"]\n",
+                         game + 1, aWhite ? "A" : "B", aWhite ? "B" : "A", RESULTS[result + 1]);
+    writeFen(start, fen, sizeof(fen));
+    if (SDL_strcmp(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") != 0)
+        n += SDL_snprintf(text + n, sizeof(text) - n, "[FEN \"%s\"]\n[SetUp \"1\"]\n", fen);
+    if (adjudicated) n += SDL_snprintf(text + n, sizeof(text) - n, "[Termination \"adjudication\"]\n");
+    text[n++] = '\n';
+    ChessState chess = *start;
+    int column = 0;
+    for (int i = 0; i < count && n < (int)sizeof(text) - 32; i++) {
+        char san[MOVE_SAN_MAX], word[24];
+        moveToSan(&chess, moves[i], san);
+        int length = chess.whiteToMove || i == 0 ? SDL_snprintf(word, sizeof(word), "%d%s %s", chess.fullmoveNumber, chess.whiteToMove ? "." : "...", san)
+                                                 : SDL_snprintf(word, sizeof(word), "%s", san);
+        if (column > 0 && column + 1 + length > 79) text[n++] = '\n', column = 0;
+        else if (column > 0) text[n++] = ' ', column++;
+        SDL_memcpy(text + n, word, (size_t)length);
+        n += length, column += length;
+        makeMove(&chess, moves[i], NULL);
+    }
+    n += SDL_snprintf(text + n, sizeof(text) - n, "%s%s\n\n", column > 0 ? " " : "", RESULTS[result + 1]);
+    if (SDL_WriteIO(job->pgn, text, (size_t)n) != (size_t)n) {
+        SDL_Log("match: can't write the PGN: %s", SDL_GetError());
+        SDL_SetAtomicInt(&job->failed, 1);
+    }
+}
+
+// one per search thread: plays games until there are none left or the SPRT has decided
+static int SDLCALL match_worker(void* data) {
+    MatchJob* job = data;
+    Engine* engines[2] = { engineCreate(), engineCreate() };
+    Move* moves = SDL_malloc(sizeof(Move) * SELFPLAY_MAX_PLY);
+    if (!engines[0] || !engines[1] || !moves) {
+        SDL_SetAtomicInt(&job->failed, 1);
+        engineDestroy(engines[0]); engineDestroy(engines[1]); SDL_free(moves);
+        return 0;
+    }
+    for (int side = 0; side < 2; side++) {
+        if (job->hashMB > 0 && !engineSetHash(engines[side], job->hashMB)) SDL_Log("match: no memory for a hash table, searching without");
+        engines[side]->options = job->options[side];
+    }
+    // the threads' evaluation cache is shared by both engines, which only works if they evaluate alike
+    bool sameEval = job->options[0].nnue == job->options[1].nnue;
+    SearchLimits limits = { .depth = job->depth, .nodes = job->nodeLimit, .softTimeNS = job->moveTimeNS / 2, .hardTimeNS = job->moveTimeNS };
+
+    for (;;) {
+        SDL_LockMutex(job->lock);
+        bool stopped = job->stopped;
+        SDL_UnlockMutex(job->lock);
+        int game = stopped || SDL_GetAtomicInt(&job->failed) ? job->games : SDL_AddAtomicInt(&job->nextGame, 1);
+        if (game >= job->games) break;
+        bool aWhite = game % 2 == 0;
+        ChessState start, chess;
+        if (!matchOpening(job, job->pairOffset + game / 2, &start)) {
+            SDL_SetAtomicInt(&job->failed, 1);
+            break;
+        }
+        chess = start;
+        engineNewGame(engines[0]);
+        engineNewGame(engines[1]);
+        engineClearEvalCache();
+        int count = 0, result;
+        AdjudicationRun run = { 0 };
+        bool adjudicated = false;
+        for (;;) {
+            MoveList legal;
+            getAllMoves(&chess, &legal);
+            result = selfPlayResult(&chess, &legal);
+            if (result != SELFPLAY_ONGOING) break;
+            if (count == SELFPLAY_MAX_PLY) { result = 0; break; }
+            if ((result = adjudicateEnding(&job->adjudication, &chess)) != SELFPLAY_ONGOING) { adjudicated = true; break; }
+            Engine* engine = engines[chess.whiteToMove == aWhite ? 0 : 1];
+            if (!sameEval) engineClearEvalCache();
+            RootMoves root;
+            Move move = engineSearch(engine, &chess, &limits, &root);
+            if ((result = adjudicateScore(&job->adjudication, &run, &chess, count, root.lastScore)) != SELFPLAY_ONGOING) { adjudicated = true; break; }
+            moves[count++] = move;
+            makeMove(&chess, move, NULL);
+        }
+        int aResult = aWhite ? result : -result;
+        SDL_LockMutex(job->lock);
+        if (aResult > 0) job->wins++;
+        else if (aResult < 0) job->losses++;
+        else job->draws++;
+        job->adjudicated += adjudicated;
+        if (job->pgn) writeMatchPgn(job, game, aWhite, &start, moves, count, result, adjudicated);
+        if (job->sprt && SDL_fabs(sprtLlr(job)) >= SPRT_BOUND) job->stopped = true;
+        SDL_UnlockMutex(job->lock);
+    }
+    SDL_free(moves);
+    engineDestroy(engines[0]);
+    engineDestroy(engines[1]);
+    return 0;
+}
+
+// every line of the openings file that holds a position; false (with the reason logged) if there are none
+static bool loadMatchOpenings(MatchJob* job, const MappedFile* file) {
+    const char* p = file->data;
+    const char* end = p + file->size;
+    job->openingsEnd = end;
+    int capacity = 0;
+    for (const char* q = p; q < end; q++) if (*q == '\n') capacity++;
+    job->openings = SDL_malloc(sizeof(const char*) * (size_t)(capacity + 1));
+    if (!job->openings) return false;
+    for (int number = 1; p < end; number++) {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        const char* next = eol ? eol + 1 : end;
+        while (p < next && (*p == ' ' || *p == '\t')) p++;
+        char copy[MATCH_LINE_MAX];
+        SDL_strlcpy(copy, p, SDL_min((size_t)(next - p) + 1, sizeof(copy)));
+        ChessState chess;
+        if (p < next && *p != '#' && *p != '\n' && *p != '\r') {
+            if (loadFen(&chess, copy)) job->openings[job->openingCount++] = p;
+            else SDL_Log("match: openings line %d: bad FEN or EPD, skipped", number);
+        }
+        p = next;
+    }
+    if (job->openingCount == 0) SDL_Log("match: no openings in the file");
+    return job->openingCount > 0;
+}
+
+static SDL_AppResult runMatchCommand(int argc, char* argv[]) {
+    MatchJob job;
+    SDL_memset(&job, 0, sizeof(job));
+    job.options[0] = job.options[1] = DEFAULT_SEARCH_OPTIONS;
+    job.adjudication = NO_ADJUDICATION;
+    job.games = 2;
+    job.randomPlies = SELFPLAY_RANDOM_PLIES;
+    job.hashMB = BATCH_HASH_MB;
+    int threads = SDL_GetNumLogicalCPUCores();
+    bool pinThreads = false;
+    const char* openings = NULL;
+    const char* pgn = NULL;
+    for (int i = 2; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "--pin-threads") == 0) pinThreads = true;
+        else if (value && SDL_strcmp(argv[i], "games") == 0) job.games = SDL_max(SDL_atoi(value), 0), i++;
+        else if (value && SDL_strcmp(argv[i], "openings") == 0) openings = value, i++;
+        else if (value && SDL_strcmp(argv[i], "random") == 0) job.randomPlies = SDL_clamp(SDL_atoi(value), 0, SELFPLAY_MAX_PLY), i++;
+        else if (value && SDL_strcmp(argv[i], "seed") == 0) job.seed = SDL_strtoull(value, NULL, 10), i++;
+        else if (value && SDL_strcmp(argv[i], "depth") == 0) job.depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH), i++;
+        else if (value && SDL_strcmp(argv[i], "nodes") == 0) job.nodeLimit = SDL_strtoull(value, NULL, 10), i++;
+        else if (value && SDL_strcmp(argv[i], "movetime") == 0) job.moveTimeNS = SDL_strtoull(value, NULL, 10) * 1000000, i++;
+        else if (value && SDL_strcmp(argv[i], "hash") == 0) job.hashMB = (size_t)SDL_max(SDL_atoi(value), 0), i++;
+        else if (value && SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS), i++;
+        else if (value && SDL_strcmp(argv[i], "pgn") == 0) pgn = value, i++;
+        else if (value && SDL_strcmp(argv[i], "adjudicate") == 0 && parseAdjudication(&job.adjudication, value)) i++;
+        else if (value && (SDL_strcmp(argv[i], "a") == 0 || SDL_strcmp(argv[i], "b") == 0)) {
+            if (!parseSearchOptions(&job.options[argv[i][0] == 'b'], value)) {
+                SDL_Log("match: unknown search option in %s", value);
+                return SDL_APP_FAILURE;
+            }
+            i++;
+        } else if (i + 2 < argc && SDL_strcmp(argv[i], "sprt") == 0) {
+            job.sprt = true;
+            job.elo0 = SDL_atof(argv[i + 1]);
+            job.elo1 = SDL_atof(argv[i + 2]);
+            i += 2;
+        } else {
+            SDL_Log("usage: %s match [games N] [openings FILE] [random N] [depth N] [nodes N] [movetime MS] [hash MB] "
+                    "[threads N] [a OPTIONS] [b OPTIONS] [pgn FILE] [sprt ELO0 ELO1] [seed N] [adjudicate RULES]", argv[0]);
+            return SDL_APP_FAILURE;
+        }
+    }
+    if (job.depth == 0) job.depth = job.nodeLimit || job.moveTimeNS ? MOVE_DEPTH : SELFPLAY_DEPTH;
+
+    MappedFile book = { 0 };
+    SDL_AppResult result = SDL_APP_FAILURE;
+    job.lock = SDL_CreateMutex();
+    if (!job.lock) return SDL_APP_FAILURE;
+    if (openings && !mapFile(&book, openings)) {
+        SDL_Log("match: can't read %s: %s", openings, SDL_GetError());
+        goto done;
+    }
+    if (openings && !loadMatchOpenings(&job, &book)) goto done;
+    if (pgn && !(job.pgn = SDL_IOFromFile(pgn, "w"))) {
+        SDL_Log("match: can't create %s: %s", pgn, SDL_GetError());
+        goto done;
+    }
+
+    engineInitTables();
+    if (!engineStartThreads(SDL_min(threads, SDL_max(job.games, 1)), pinThreads)) SDL_Log("match: no worker threads, playing on this one");
+    Uint64 start = SDL_GetTicksNS();
+    int workers = engineRunOnThreads(match_worker, &job);
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+    engineStopThreads();
+
+    int played = job.wins + job.draws + job.losses;
+    double seconds = (double)elapsed / 1e9, p, variance;
+    SDL_Log("match: %d games in %.1f s (%.0f games/hour, %d threads, %d adjudicated): A +%d =%d -%d", played, seconds,
+            seconds > 0 ? played * 3600.0 / seconds : 0.0, workers, job.adjudicated, job.wins, job.draws, job.losses);
+    if (matchScore(&job, &p, &variance) && p > 0 && p < 1) {
+        double margin = 1.96 * SDL_sqrt(variance / played);
+        double low = SDL_max(p - margin, 1e-6), high = SDL_min(p + margin, 1 - 1e-6);
+        SDL_Log("match: score %.1f%%, Elo %+.1f (95%%: %+.1f to %+.1f)", 100 * p, scoreToElo(p), scoreToElo(low), scoreToElo(high));
+    }
+    if (job.sprt) {
+        double llr = sprtLlr(&job);
+        SDL_Log("match: SPRT elo0 %.1f elo1 %.1f: LLR %.2f (bounds %.2f, %.2f), %s", job.elo0, job.elo1, llr, -SPRT_BOUND, SPRT_BOUND,
+                llr >= SPRT_BOUND ? "H1 accepted" : llr <= -SPRT_BOUND ? "H0 accepted" : "undecided");
+    }
+    result = SDL_GetAtomicInt(&job.failed) ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+done:
+    if (job.pgn && !SDL_CloseIO(job.pgn)) {
+        SDL_Log("match: can't write %s: %s", pgn, SDL_GetError());
+        result = SDL_APP_FAILURE;
+    }
+    SDL_free(job.openings);
+    unmapFile(&book);
+    SDL_DestroyMutex(job.lock);
+    return result;
+}
+
+/* SPSA tuning: `main spsa <state> [iterations N] [pairs N] [params NAMES] [rate R] [openings FILE] [random N]
+   [depth N] [nodes N] [movetime MS] [hash MB] [threads N] [seed N] [adjudicate RULES]` tunes integer search options (SPSA_PARAMS,
+   or the comma-separated NAMES of them) by simultaneous perturbation stochastic approximation, as fishtest does.
+   Each iteration nudges every parameter by c_k, up or down at random, plays `pairs` game pairs of the nudged-up
+   engine against the nudged-down one on the match runner, and moves the parameters along the result. The schedule
+   is fishtest's: c_k = c / k^0.101, a_k = a / (A + k)^0.602 with A a tenth of the iterations, c and a set so that
+   the last iteration has each parameter's c_end and a rate of `rate` (R_end) times c_end^2. After every iteration
+   the values and the iteration go to `state`, which a run started again with it picks up from; what the values
+   had come to is logged every SPSA_LOG_EVERY iterations, as options for `match b`. `adjudicate` is match's. The game pairs are all played
+   on this machine's threads: the self-play runner has no remote workers to farm them out to. */
+#define SPSA_ITERATIONS 1000
+#define SPSA_PAIRS 4       // game pairs per iteration
+#define SPSA_RATE 0.002    // R_end
+#define SPSA_LOG_EVERY 10
+#define SPSA_STATE_MAX 4096
+
+// the options worth tuning, their bounds and their perturbation at the end of a run
+static const struct { const char* name; double low, high, cEnd; } SPSA_PARAMS[] = {
+    { "nullmovereduction", 1, 5, 1 },
+    { "lmrmindepth", 1, 6, 1 },
+    { "lmrminmoves", 1, 10, 1 },
+    { "rfpmargin", 30, 400, 10 },
+    { "razormargin", 100, 800, 20 },
+    { "futilitymargin", 30, 400, 10 },
+    { "probcutmargin", 50, 500, 15 },
+    { "aspiration", 10, 200, 5 },
+};
+
+typedef struct {
+    int index;       // into SPSA_PARAMS
+    size_t offset;   // the int in SearchOptions
+    double value;
+} SpsaParam;
+
+// whether the comma-separated list has name in it
+static bool listHasName(const char* list, const char* name) {
+    size_t length = SDL_strlen(name);
+    for (const char* p = list; *p;) {
+        const char* comma = SDL_strchr(p, ',');
+        size_t n = comma ? (size_t)(comma - p) : SDL_strlen(p);
+        if (n == length && SDL_strncmp(p, name, n) == 0) return true;
+        p += comma ? n + 1 : n;
+    }
+    return false;
+}
+
+// the values an earlier run left in the state file, and the iterations it had done; false with no file
+static bool readSpsaState(const char* path, SpsaParam* params, int count, int* iteration) {
+    size_t size;
+    char* text = SDL_LoadFile(path, &size);
+    if (!text) return false;
+    for (char* line = text; *line;) {
+        char* eol = SDL_strchr(line, '\n');
+        if (eol) *eol = '\0';
+        char* value = SDL_strchr(line, ' ');
+        if (line[0] != '#' && value) {
+            *value++ = '\0';
+            if (SDL_strcmp(line, "iteration") == 0) *iteration = SDL_atoi(value);
+            for (int p = 0; p < count; p++)
+                if (SDL_strcmp(line, SPSA_PARAMS[params[p].index].name) == 0) params[p].value = SDL_strtod(value, NULL);
+        }
+        line = eol ? eol + 1 : line + SDL_strlen(line);
+    }
+    SDL_free(text);
+    return true;
+}
+
+// written next to the state file and renamed over it, so stopping part way never leaves half a file
+static bool writeSpsaState(const char* path, const SpsaParam* params, int count, int iteration) {
+    char text[SPSA_STATE_MAX], temporary[1024];
+    int n = SDL_snprintf(text, sizeof(text), "# main spsa state: iterations done, then each parameter's value\niteration %d\n", iteration);
+    for (int p = 0; p < count; p++)
+        n += SDL_snprintf(text + n, sizeof(text) - (size_t)n, "%s %.4f\n", SPSA_PARAMS[params[p].index].name, params[p].value);
+    SDL_snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    SDL_IOStream* out = SDL_IOFromFile(temporary, "w");
+    bool written = out && SDL_WriteIO(out, text, (size_t)n) == (size_t)n;
+    if (out && !SDL_CloseIO(out)) written = false;
+    return written && SDL_RenamePath(temporary, path);
+}
+
+// the parameters as a match option list, rounded
+static void formatSpsaParams(const SpsaParam* params, int count, char* out, size_t size) {
+    size_t n = 0;
+    out[0] = '\0';
+    for (int p = 0; p < count && n < size; p++)
+        n += (size_t)SDL_snprintf(out + n, size - n, "%s%s=%ld", p ? "," : "", SPSA_PARAMS[params[p].index].name, SDL_lround(params[p].value));
+}
+
+static SDL_AppResult runSpsaCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s spsa <state> [iterations N] [pairs N] [params NAMES] [rate R] [openings FILE] [random N] "
+                "[depth N] [nodes N] [movetime MS] [hash MB] [threads N] [seed N] [adjudicate RULES]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    const char* statePath = argv[2];
+    MatchJob job;
+    SDL_memset(&job, 0, sizeof(job));
+    job.randomPlies = SELFPLAY_RANDOM_PLIES;
+    job.hashMB = BATCH_HASH_MB;
+    job.adjudication = NO_ADJUDICATION;
+    int iterations = SPSA_ITERATIONS, pairs = SPSA_PAIRS, threads = SDL_GetNumLogicalCPUCores();
+    double rate = SPSA_RATE;
+    const char* openings = NULL;
+    const char* names = NULL;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (SDL_strcmp(argv[i], "iterations") == 0) iterations = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "pairs") == 0) pairs = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "params") == 0) names = value;
+        else if (SDL_strcmp(argv[i], "rate") == 0) rate = SDL_strtod(value, NULL);
+        else if (SDL_strcmp(argv[i], "openings") == 0) openings = value;
+        else if (SDL_strcmp(argv[i], "random") == 0) job.randomPlies = SDL_clamp(SDL_atoi(value), 0, SELFPLAY_MAX_PLY);
+        else if (SDL_strcmp(argv[i], "depth") == 0) job.depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH);
+        else if (SDL_strcmp(argv[i], "nodes") == 0) job.nodeLimit = SDL_strtoull(value, NULL, 10);
+        else if (SDL_strcmp(argv[i], "movetime") == 0) job.moveTimeNS = SDL_strtoull(value, NULL, 10) * 1000000;
+        else if (SDL_strcmp(argv[i], "hash") == 0) job.hashMB = (size_t)SDL_max(SDL_atoi(value), 0);
+        else if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "seed") == 0) job.seed = SDL_strtoull(value, NULL, 10);
+        else if (SDL_strcmp(argv[i], "adjudicate") != 0 || !parseAdjudication(&job.adjudication, value)) {
+            SDL_Log("spsa: unknown option %s", argv[i]);
+            return SDL_APP_FAILURE;
+        }
+    }
+    if (job.depth == 0) job.depth = job.nodeLimit || job.moveTimeNS ? MOVE_DEPTH : SELFPLAY_DEPTH;
+    job.games = 2 * pairs;
+
+    SpsaParam params[SDL_arraysize(SPSA_PARAMS)];
+    int count = 0, named = 1;
+    for (const char* c = names; c && *c; c++) named += *c == ',';
+    for (int p = 0; p < (int)SDL_arraysize(SPSA_PARAMS); p++) {
+        if (names && !listHasName(names, SPSA_PARAMS[p].name)) continue;
+        SpsaParam* param = &params[count++];
+        param->index = p;
+        for (size_t o = 0; o < SDL_arraysize(SEARCH_OPTION_NAMES); o++)
+            if (SDL_strcmp(SEARCH_OPTION_NAMES[o].name, SPSA_PARAMS[p].name) == 0) param->offset = SEARCH_OPTION_NAMES[o].offset;
+        param->value = *(const int*)((const char*)&DEFAULT_SEARCH_OPTIONS + param->offset);
+    }
+    if (names && count != named) {
+        char list[512] = "";
+        for (size_t p = 0; p < SDL_arraysize(SPSA_PARAMS); p++)
+            SDL_snprintf(list + SDL_strlen(list), sizeof(list) - SDL_strlen(list), "%s%s", p ? "," : "", SPSA_PARAMS[p].name);
+        SDL_Log("spsa: params are some of %s", list);
+        return SDL_APP_FAILURE;
+    }
+    int done = 0;
+    if (readSpsaState(statePath, params, count, &done)) SDL_Log("spsa: carrying on from %s after %d iterations", statePath, done);
+
+    MappedFile book = { 0 };
+    SDL_AppResult result = SDL_APP_FAILURE;
+    job.lock = SDL_CreateMutex();
+    if (!job.lock) return SDL_APP_FAILURE;
+    if (openings && !mapFile(&book, openings)) {
+        SDL_Log("spsa: can't read %s: %s", openings, SDL_GetError());
+        goto done;
+    }
+    if (openings && !loadMatchOpenings(&job, &book)) goto done;
+    engineInitTables();
+    if (!engineStartThreads(SDL_min(threads, job.games), false)) SDL_Log("spsa: no worker threads, playing on this one");
+
+    const double alpha = 0.602, gamma = 0.101, stability = 0.1 * iterations; // A
+    Uint64 random = job.seed ^ 0x5D588B656C078965ull;
+    int wins = 0, draws = 0, losses = 0;
+    Uint64 start = SDL_GetTicksNS();
+    for (int k = done + 1; k <= iterations; k++) {
+        job.options[0] = job.options[1] = DEFAULT_SEARCH_OPTIONS;
+        double c[SDL_arraysize(SPSA_PARAMS)];
+        int delta[SDL_arraysize(SPSA_PARAMS)];
+        Uint64 stream = random ^ (Uint64)k * 0x9E3779B97F4A7C15ull; // the iteration's own, so a resumed run nudges the same way
+        for (int p = 0; p < count; p++) {
+            double cEnd = SPSA_PARAMS[params[p].index].cEnd;
+            c[p] = cEnd * SDL_pow((double)iterations, gamma) / SDL_pow((double)k, gamma);
+            delta[p] = SDL_rand_r(&stream, 2) ? 1 : -1;
+            double low = SPSA_PARAMS[params[p].index].low, high = SPSA_PARAMS[params[p].index].high;
+            *(int*)((char*)&job.options[0] + params[p].offset) = (int)SDL_lround(SDL_clamp(params[p].value + c[p] * delta[p], low, high));
+            *(int*)((char*)&job.options[1] + params[p].offset) = (int)SDL_lround(SDL_clamp(params[p].value - c[p] * delta[p], low, high));
+        }
+        job.wins = job.draws = job.losses = 0;
+        job.pairOffset = (k - 1) * pairs; // every iteration on fresh openings
+        SDL_SetAtomicInt(&job.nextGame, 0);
+        engineRunOnThreads(match_worker, &job);
+        if (SDL_GetAtomicInt(&job.failed)) break;
+        wins += job.wins, draws += job.draws, losses += job.losses;
+
+        int score = job.wins - job.losses; // for the nudged-up engine
+        for (int p = 0; p < count; p++) {
+            const double cEnd = SPSA_PARAMS[params[p].index].cEnd;
+            double a = rate * cEnd * cEnd * SDL_pow(stability + iterations, alpha);
+            double step = a / SDL_pow(stability + k, alpha) * score / (c[p] * delta[p]);
+            params[p].value = SDL_clamp(params[p].value + step, SPSA_PARAMS[params[p].index].low, SPSA_PARAMS[params[p].index].high);
+        }
+        if (!writeSpsaState(statePath, params, count, k)) {
+            SDL_Log("spsa: can't write %s: %s", statePath, SDL_GetError());
+            SDL_SetAtomicInt(&job.failed, 1);
+            break;
+        }
+        if (k % SPSA_LOG_EVERY == 0 || k == iterations) {
+            char list[512];
+            formatSpsaParams(params, count, list, sizeof(list));
+            double seconds = (double)(SDL_GetTicksNS() - start) / 1e9;
+            SDL_Log("spsa: iteration %d of %d, +%d =%d -%d for the nudged-up side (%.0f games/hour): %s", k, iterations, wins,
+                    draws, losses, seconds > 0 ? (wins + draws + losses) * 3600.0 / seconds : 0.0, list);
+        }
+    }
+    engineStopThreads();
+    result = SDL_GetAtomicInt(&job.failed) ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+done:
+    SDL_free(job.openings);
+    unmapFile(&book);
+    SDL_DestroyMutex(job.lock);
+    return result;
+}
+
+/* Book building: `main book <games.pgn> <book.bin> [plies N] [min N] [threads N]` turns the first plies of every
+   game into a Polyglot-format opening book (see bookOpen) for --book and the UCI BookFile option. A move's weight
+   is the number of games that played it in the position; moves played in fewer than `min` games are left out.
+
+   Opening explorer: `main explorer <games.pgn> <index.bin> [plies N] [min N] [threads N]` indexes the games the
+   same way, keeping for each position and move the games that played it and how many of them white won, drew and
+   lost (by the Result tags). The index is a Polyglot book with the counts after each entry and a header in front,
+   so bookOpen reads it too: --book and BookFile play from it, and bookStats looks a position up with a binary
+   search of the mapping. The window shows a book's statistics beside the board, and the analysis server answers
+   `explore` from its `explorer` index.
+
+   The games file is mapped and cut at game boundaries into pieces, which the pool's threads take one at a time;
+   each thread counts what its games play in a hash map of its own by position and move (GameIndexMap), so a move
+   is one probe with no lock however many threads there are. Once the games are read every map is sorted by key,
+   and the maps are merged as the file is written, the moves of each position most played first. */
+#define BOOK_BUILD_PLIES 16
+#define EXPLORER_PLIES 30
+#define GAME_INDEX_PIECES_PER_THREAD 4 // so a thread with a piece of long games doesn't hold the rest up
+#define GAME_INDEX_MAP_MIN 65536
+
+typedef struct {
+    Uint64 key;
+    Uint16 move;
+    Uint32 games, whiteWins, draws, blackWins; // games 0: an empty slot
+} GameIndexEntry;
+
+typedef struct {
+    GameIndexEntry* slots; // open addressing, a power of two of them; sorted and packed once the games are read
+    size_t count, capacity;
+    bool outOfMemory;
+} GameIndexMap;
+
+typedef struct {
+    const char* data;
+    size_t* starts;            // where each piece begins, and the end of the file after the last
+    int pieceCount, plies;
+    SDL_AtomicInt nextPiece;   // the next piece for a thread to take
+    SDL_AtomicInt nextMap;     // the next thread's map
+    SDL_AtomicInt badGames;    // pieces with a game that isn't legal, logged as they're read
+    GameIndexMap maps[MAX_POOL_THREADS + 1];
+} GameIndexJob;
+
+typedef struct {
+    GameIndexMap* map;
+    int plies;
+} GameIndexReader;
+
+static size_t gameIndexSlot(const GameIndexMap* map, Uint64 key, Uint16 move) {
+    return (size_t)((key ^ (Uint64)move * 0x9E3779B97F4A7C15ull) & (map->capacity - 1));
+}
+
+static bool gameIndexGrow(GameIndexMap* map) {
+    size_t capacity = map->capacity ? map->capacity * 2 : GAME_INDEX_MAP_MIN;
+    GameIndexEntry* slots = SDL_calloc(capacity, sizeof(GameIndexEntry));
+    if (!slots) return false;
+    GameIndexMap grown = { slots, map->count, capacity, false };
+    for (size_t i = 0; i < map->capacity; i++) {
+        const GameIndexEntry* e = &map->slots[i];
+        if (e->games == 0) continue;
+        size_t s = gameIndexSlot(&grown, e->key, e->move);
+        while (slots[s].games != 0) s = (s + 1) & (capacity - 1);
+        slots[s] = *e;
+    }
+    SDL_free(map->slots);
+    *map = grown;
+    return true;
+}
+
+static void addGameIndexPosition(void* context, const ChessState* position, Move move, int game, int ply, int result) {
+    GameIndexReader* reader = context;
+    GameIndexMap* map = reader->map;
+    (void)game;
+    if (move == MOVE_NONE || ply >= reader->plies || map->outOfMemory) return;
+    if ((map->count + 1) * 4 > map->capacity * 3 && !gameIndexGrow(map)) { map->outOfMemory = true; return; }
+    Uint64 key = bookKey(position);
+    Uint16 encoded = bookEncodeMove(move);
+    size_t s = gameIndexSlot(map, key, encoded);
+    GameIndexEntry* e = &map->slots[s];
+    while (e->games != 0 && (e->key != key || e->move != encoded)) s = (s + 1) & (map->capacity - 1), e = &map->slots[s];
+    if (e->games == 0) *e = (GameIndexEntry){ .key = key, .move = encoded }, map->count++;
+    e->games++;
+    e->whiteWins += result == 1, e->draws += result == 0, e->blackWins += result == -1;
+}
+
+static int SDLCALL compareGameIndexMoves(const void* a, const void* b) { // by key, then move
+    const GameIndexEntry* x = a;
+    const GameIndexEntry* y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+static int SDLCALL compareGameIndexGames(const void* a, const void* b) { // the most played first
+    const GameIndexEntry* x = a;
+    const GameIndexEntry* y = b;
+    return x->games > y->games ? -1 : x->games < y->games ? 1 : (int)x->move - (int)y->move;
+}
+
+static int SDLCALL game_index_worker(void* data) {
+    GameIndexJob* job = data;
+    GameIndexReader reader = { &job->maps[SDL_AddAtomicInt(&job->nextMap, 1)], job->plies };
+    for (int i; (i = SDL_AddAtomicInt(&job->nextPiece, 1)) < job->pieceCount;)
+        if (!readPgnGames(job->data + job->starts[i], job->data + job->starts[i + 1], addGameIndexPosition, &reader))
+            SDL_AddAtomicInt(&job->badGames, 1);
+    GameIndexMap* map = reader.map; // packed to the front and sorted, for the merge
+    size_t kept = 0;
+    for (size_t s = 0; s < map->capacity; s++)
+        if (map->slots[s].games != 0) map->slots[kept++] = map->slots[s];
+    SDL_qsort(map->slots, kept, sizeof(GameIndexEntry), compareGameIndexMoves);
+    return 0;
+}
+
+// the first game to start at or after offset: a tag at the start of a line after a blank one; the size if none
+static size_t gameIndexPieceStart(const char* data, size_t size, size_t offset) {
+    for (const char* p = memchr(data + offset, '\n', size - offset); p; p = memchr(p + 1, '\n', size - (size_t)(p + 1 - data))) {
+        const char* q = p + 1;
+        if (q < data + size && *q == '\r') q++;
+        if (q < data + size && *q == '\n' && q + 1 < data + size && q[1] == '[') return (size_t)(q + 1 - data);
+        if (q + 1 >= data + size) break;
+    }
+    return size;
+}
+
+// a Polyglot entry (big-endian key, move, weight, learn left at 0), the explorer's counts after it
+static bool writeGameIndexEntry(SDL_IOStream* out, const GameIndexEntry* entry, bool explorer) {
+    Uint8 bytes[32] = { 0 };
+    for (int b = 0; b < 8; b++) bytes[b] = (Uint8)(entry->key >> (56 - 8 * b));
+    Uint16 weight = (Uint16)SDL_min(entry->games, 65535);
+    bytes[8] = (Uint8)(entry->move >> 8); bytes[9] = (Uint8)entry->move;
+    bytes[10] = (Uint8)(weight >> 8); bytes[11] = (Uint8)weight;
+    const Uint32 counts[4] = { entry->games, entry->whiteWins, entry->draws, entry->blackWins };
+    for (int c = 0; c < 4; c++)
+        for (int b = 0; b < 4; b++) bytes[16 + 4 * c + b] = (Uint8)(counts[c] >> (24 - 8 * b));
+    size_t size = explorer ? 32 : 16;
+    return SDL_WriteIO(out, bytes, size) == size;
+}
+
+/* The threads' maps merged into the file: the lowest key left in any of them each time, its moves from every map
+   added together; `kept` counts the entries written. */
+static bool writeGameIndex(SDL_IOStream* out, const GameIndexMap* maps, int count, Uint32 minGames, bool explorer, size_t* kept) {
+    bool written = !explorer || SDL_WriteIO(out, "chessexp\0\0\0\0\0\0\0\0", 16) == 16; // bookOpen's BOOK_EXPLORER_MAGIC
+    size_t next[MAX_POOL_THREADS + 1] = { 0 };
+    GameIndexEntry moves[256];
+    *kept = 0;
+    while (written) {
+        Uint64 key = 0;
+        bool any = false;
+        for (int i = 0; i < count; i++)
+            if (next[i] < maps[i].count && (!any || maps[i].slots[next[i]].key < key)) key = maps[i].slots[next[i]].key, any = true;
+        if (!any) break;
+        int moveCount = 0;
+        for (int i = 0; i < count; i++) {
+            for (; next[i] < maps[i].count && maps[i].slots[next[i]].key == key; next[i]++) {
+                const GameIndexEntry* e = &maps[i].slots[next[i]];
+                int m = 0;
+                while (m < moveCount && moves[m].move != e->move) m++;
+                if (m == moveCount && moveCount == (int)SDL_arraysize(moves)) continue; // more than any position has
+                if (m == moveCount) moves[moveCount++] = (GameIndexEntry){ .key = key, .move = e->move };
+                moves[m].games += e->games, moves[m].whiteWins += e->whiteWins, moves[m].draws += e->draws, moves[m].blackWins += e->blackWins;
+            }
+        }
+        SDL_qsort(moves, (size_t)moveCount, sizeof(GameIndexEntry), compareGameIndexGames);
+        for (int m = 0; m < moveCount && written; m++)
+            if (moves[m].games >= minGames) written = writeGameIndexEntry(out, &moves[m], explorer), ++*kept;
+    }
+    return written;
+}
+
+// `main book` and `main explorer`, which differ only in what they write
+static SDL_AppResult runGameIndexCommand(int argc, char* argv[], bool explorer) {
+    const char* name = argv[1];
+    if (argc < 4) {
+        SDL_Log("usage: %s %s <games.pgn> <%s> [plies N] [min N] [threads N]", argv[0], name, explorer ? "index.bin" : "book.bin");
+        return SDL_APP_FAILURE;
+    }
+    int plies = explorer ? EXPLORER_PLIES : BOOK_BUILD_PLIES, threads = SDL_GetNumLogicalCPUCores();
+    Uint32 minGames = 1;
+    for (int i = 4; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1]; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "plies") == 0) plies = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "min") == 0) minGames = (Uint32)SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS);
+        else { SDL_Log("%s: unknown option %s", name, argv[i]); return SDL_APP_FAILURE; }
+    }
+    engineInitTables();
+    MappedFile games;
+    if (!mapFile(&games, argv[2])) {
+        SDL_Log("%s: can't read %s: %s", name, argv[2], SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    GameIndexJob* job = SDL_calloc(1, sizeof(GameIndexJob));
+    SDL_AppResult result = SDL_APP_FAILURE;
+    if (job) {
+        job->data = games.data;
+        job->plies = plies;
+        job->pieceCount = threads * GAME_INDEX_PIECES_PER_THREAD;
+        job->starts = SDL_malloc(sizeof(size_t) * (size_t)(job->pieceCount + 1));
+    }
+    if (!job || !job->starts) {
+        SDL_Log("%s: out of memory", name);
+        goto done;
+    }
+    job->starts[0] = 0;
+    for (int i = 1; i < job->pieceCount; i++)
+        job->starts[i] = SDL_max(job->starts[i - 1], gameIndexPieceStart(games.data, games.size, games.size / (size_t)job->pieceCount * (size_t)i));
+    job->starts[job->pieceCount] = games.size;
+
+    Uint64 start = SDL_GetTicksNS();
+    if (!engineStartThreads(threads, false)) SDL_Log("%s: no worker threads, reading on this one", name);
+    engineRunOnThreads(game_index_worker, job);
+    engineStopThreads();
+    int workers = SDL_GetAtomicInt(&job->nextMap); // the maps in use
+    size_t counted = 0;
+    for (int i = 0; i < workers; i++) {
+        if (job->maps[i].outOfMemory) {
+            SDL_Log("%s: out of memory", name);
+            goto done;
+        }
+        counted += job->maps[i].count;
+    }
+    SDL_IOStream* out = SDL_IOFromFile(argv[3], "wb");
+    if (!out) {
+        SDL_Log("%s: can't create %s: %s", name, argv[3], SDL_GetError());
+        goto done;
+    }
+    size_t kept = 0;
+    bool written = writeGameIndex(out, job->maps, workers, minGames, explorer, &kept);
+    if (!SDL_CloseIO(out)) written = false;
+    if (!written) {
+        SDL_Log("%s: can't write %s: %s", name, argv[3], SDL_GetError());
+        goto done;
+    }
+    SDL_Log("%s: %zu moves written to %s in %.3f s (%d threads, %zu moves counted before their maps were merged)", name,
+            kept, argv[3], (double)(SDL_GetTicksNS() - start) / 1e9, workers, counted);
+    result = SDL_GetAtomicInt(&job->badGames) ? SDL_APP_FAILURE : SDL_APP_SUCCESS; // the bad games are logged
+done:
+    if (job) {
+        for (int i = 0; i <= MAX_POOL_THREADS; i++) SDL_free(job->maps[i].slots);
+        SDL_free(job->starts);
+    }
+    SDL_free(job);
+    unmapFile(&games);
+    return result;
+}
+
+static SDL_AppResult runBookCommand(int argc, char* argv[]) {
+    return runGameIndexCommand(argc, argv, false);
+}
+
+static SDL_AppResult runExplorerCommand(int argc, char* argv[]) {
+    return runGameIndexCommand(argc, argv, true);
+}
+
+/* Texel tuning: `main tune <positions> [iterations N] [threads N] [rate R] [out FILE]` fits the hand-written
+   evaluation's piece-square tables and term weights (evalParams) to the results of the games the positions are
+   from. They're self-play shards (.bin, or packed as .pack) or EPD lines with the result as a c9 operation or a
+   bare 1-0, 0-1 or 1/2-1/2 (1.0, 0.5 and 0.0 in brackets too). Each position's features (evalFeatures) are worked
+   out once, so the evaluation is a sum linear in the weights; it predicts white's score as
+   1 / (1 + 10^(-K * eval / 400)), with K scanned first for the lowest loss under the engine's own weights. Then
+   Adam steps down the mean squared error, the pool's threads summing the gradient over slices of the positions;
+   the endings with their own evaluation play no part. The tables and weights at the end are written as C to FILE (tuned.c), to paste over engine.c's. */
+#define TUNE_ITERATIONS 500
+#define TUNE_RATE 1.0       // Adam's step, in centipawns
+#define TUNE_LOG_EVERY 50   // iterations between loss lines
+#define TUNE_SLICES 64      // partial sums, taken by the workers one at a time, so any thread count adds up the same
+#define TUNE_CHUNK 64       // positions read before evalFeatures is called on them
+#define TUNE_OUT "tuned.c"  // where out FILE is, not given
+
+typedef struct {
+    Uint32 first;      // its pieces in TuneSet.pieces, evalFeatures' entries
+    Uint8 pieceCount;
+    Uint8 result;      // for white, in half points
+    Uint16 weight;
+    Sint16 material;
+    Sint16 terms[EVAL_TERM_COUNT];
+} TuneSample;
+
+typedef struct {
+    TuneSample* samples;
+    Sint16* pieces;
+    size_t count, capacity, pieceCount, pieceCapacity;
+    ChessState* chunk; // TUNE_CHUNK of them waiting for their features
+    Uint8 chunkResults[TUNE_CHUNK];
+    int chunkCount;
+    size_t skipped; // not linear
+    size_t badRecords;
+    bool outOfMemory;
+} TuneSet;
+
+static void tuneFlush(TuneSet* set) {
+    EvalFeatures features[TUNE_CHUNK];
+    evalFeatures(set->chunk, set->chunkCount, features);
+    for (int i = 0; i < set->chunkCount && !set->outOfMemory; i++) {
+        const EvalFeatures* f = &features[i];
+        if (!f->linear) { set->skipped++; continue; }
+        if (set->count == set->capacity) {
+            size_t capacity = set->capacity ? set->capacity * 2 : 65536;
+            TuneSample* samples = SDL_realloc(set->samples, capacity * sizeof(TuneSample));
+            if (!samples) { set->outOfMemory = true; break; }
+            set->samples = samples;
+            set->capacity = capacity;
+        }
+        if (set->pieceCount + f->pieceCount > set->pieceCapacity) {
+            size_t capacity = set->pieceCapacity ? set->pieceCapacity * 2 : 65536 * 32;
+            Sint16* pieces = SDL_realloc(set->pieces, capacity * sizeof(Sint16));
+            if (!pieces) { set->outOfMemory = true; break; }
+            set->pieces = pieces;
+            set->pieceCapacity = capacity;
+        }
+        TuneSample* sample = &set->samples[set->count++];
+        *sample = (TuneSample){ .first = (Uint32)set->pieceCount, .pieceCount = f->pieceCount, .result = set->chunkResults[i],
+                                .weight = f->weight, .material = f->material, .terms = { 0 } }; // the terms copied next
+        SDL_memcpy(sample->terms, f->terms, sizeof(sample->terms));
+        SDL_memcpy(set->pieces + set->pieceCount, f->pieces, f->pieceCount * sizeof(Sint16));
+        set->pieceCount += f->pieceCount;
+    }
+    set->chunkCount = 0;
+}
+
+// the position the reader decoded into the chunk's next slot kept, with its result
+static void tuneKeep(TuneSet* set, int halfPoints) {
+    set->chunkResults[set->chunkCount++] = (Uint8)halfPoints;
+    if (set->chunkCount == TUNE_CHUNK) tuneFlush(set);
+}
+
+// white's result among an EPD line's operations, in half points; -1 when it doesn't give one
+static int epdResult(const char* p, const char* end) {
+    static const struct { const char* text; int halfPoints; } RESULTS[] = {
+        { "1/2-1/2", 1 }, { "1-0", 2 }, { "0-1", 0 }, { "[0.5]", 1 }, { "[1.0]", 2 }, { "[0.0]", 0 },
+    };
+    for (; p < end; p++)
+        for (size_t r = 0; r < SDL_arraysize(RESULTS); r++) {
+            size_t length = SDL_strlen(RESULTS[r].text);
+            if ((size_t)(end - p) >= length && SDL_strncmp(p, RESULTS[r].text, length) == 0) return RESULTS[r].halfPoints;
+        }
+    return -1;
+}
+
+static bool readTuneEpd(TuneSet* set, const char* p, const char* end) {
+    bool clean = true;
+    for (int number = 1; p < end && !set->outOfMemory; number++) {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        const char* last = eol ? eol : end;
+        const char* next = eol ? eol + 1 : end;
+        while (last > p && (last[-1] == '\r' || last[-1] == ' ' || last[-1] == '\t')) last--;
+        while (p < last && (*p == ' ' || *p == '\t')) p++;
+        if (p < last && *p != '#') {
+            char line[BATCH_LINE_MAX];
+            SDL_strlcpy(line, p, SDL_min((size_t)(last - p) + 1, sizeof(line)));
+            const char* operations;
+            epdPositionFields(line, line + SDL_strlen(line), &operations);
+            int result = epdResult(operations, line + SDL_strlen(line));
+            set->chunk[set->chunkCount] = initChessState();
+            if (result >= 0 && loadFen(&set->chunk[set->chunkCount], line)) tuneKeep(set, result);
+            else {
+                SDL_Log("tune: line %d: %s: %.*s", number, result < 0 ? "no result" : "bad FEN or EPD", (int)(last - p), p);
+                clean = false;
+            }
+        }
+        p = next;
+    }
+    return clean;
+}
+
+static void addTuneRecord(void* context, const Uint8* record, size_t number) {
+    TuneSet* set = context;
+    int score, result;
+    if (set->outOfMemory) return;
+    if (!trainingRecordUnpack(record, &set->chunk[set->chunkCount], &score, &result)) {
+        SDL_Log("tune: record %zu: not a position", number);
+        set->badRecords++;
+        return;
+    }
+    tuneKeep(set, result + 1);
+}
+
+static bool readTuneShard(TuneSet* set, const Uint8* records, size_t size) {
+    return forEachShardRecord("tune", records, size, addTuneRecord, set) && set->badRecords == 0;
+}
+
+// the linear evaluation of a sample under params, white's point of view
+static inline double tuneEvaluate(const double* params, const TuneSample* sample, const Sint16* pieces) {
+    double w = sample->weight / 256.0, table = 0;
+    for (int i = 0; i < sample->pieceCount; i++) {
+        int entry = pieces[i];
+        if (entry >= 0) table += params[entry] * w + params[6 * 64 + entry] * (1 - w);
+        else table -= params[~entry] * w + params[6 * 64 + ~entry] * (1 - w);
+    }
+    double terms = 0;
+    for (int t = 0; t < EVAL_TERM_SHIELD; t++) terms += params[EVAL_TABLE_PARAMS + t] * sample->terms[t];
+    terms += params[EVAL_TABLE_PARAMS + EVAL_TERM_SHIELD] * sample->terms[EVAL_TERM_SHIELD] * w;
+    return sample->material + table + terms;
+}
+
+typedef struct {
+    const TuneSet* set;
+    const double* params;
+    double scale;                           // K * ln 10 / 400, the sigmoid's slope
+    bool gradient;                          // the loss only, without
+    double loss[TUNE_SLICES];
+    double (*gradients)[EVAL_PARAM_COUNT]; // [TUNE_SLICES]
+    SDL_AtomicInt next;
+} TuneJob;
+
+static int SDLCALL tune_worker(void* data) {
+    TuneJob* job = data;
+    const TuneSet* set = job->set;
+    for (int slice; (slice = SDL_AddAtomicInt(&job->next, 1)) < TUNE_SLICES;) {
+        size_t first = set->count * (size_t)slice / TUNE_SLICES, last = set->count * (size_t)(slice + 1) / TUNE_SLICES;
+        double loss = 0;
+        double* gradient = job->gradient ? job->gradients[slice] : NULL;
+        if (gradient) SDL_memset(gradient, 0, sizeof(double) * EVAL_PARAM_COUNT);
+        for (size_t s = first; s < last; s++) {
+            const TuneSample* sample = &set->samples[s];
+            const Sint16* pieces = set->pieces + sample->first;
+            double predicted = 1 / (1 + SDL_exp(-job->scale * tuneEvaluate(job->params, sample, pieces)));
+            double error = predicted - sample->result * 0.5;
+            loss += error * error;
+            if (!gradient) continue;
+            double g = error * predicted * (1 - predicted) * job->scale; // half the loss's derivative in the eval
+            double w = sample->weight / 256.0;
+            for (int i = 0; i < sample->pieceCount; i++) {
+                int entry = pieces[i] >= 0 ? pieces[i] : ~pieces[i];
+                double share = pieces[i] >= 0 ? g : -g; // black's entries count against white
+                gradient[entry] += share * w;
+                gradient[6 * 64 + entry] += share * (1 - w);
+            }
+            for (int t = 0; t < EVAL_TERM_SHIELD; t++) gradient[EVAL_TABLE_PARAMS + t] += g * sample->terms[t];
+            gradient[EVAL_TABLE_PARAMS + EVAL_TERM_SHIELD] += g * sample->terms[EVAL_TERM_SHIELD] * w;
+        }
+        job->loss[slice] = loss;
+    }
+    return 0;
+}
+
+// the mean squared error under params, and with gradient its gradient (mean too) into it
+static double tuneLoss(TuneJob* job, const double* params, double k, double* gradient) {
+    job->params = params;
+    job->scale = k * 2.302585092994046 / 400;
+    job->gradient = gradient != NULL;
+    SDL_SetAtomicInt(&job->next, 0);
+    engineRunOnThreads(tune_worker, job);
+    double loss = 0;
+    for (int s = 0; s < TUNE_SLICES; s++) loss += job->loss[s];
+    if (gradient) {
+        SDL_memset(gradient, 0, sizeof(double) * EVAL_PARAM_COUNT);
+        for (int s = 0; s < TUNE_SLICES; s++)
+            for (int p = 0; p < EVAL_PARAM_COUNT; p++) gradient[p] += job->gradients[s][p];
+        for (int p = 0; p < EVAL_PARAM_COUNT; p++) gradient[p] /= (double)job->set->count;
+    }
+    return loss / (double)job->set->count;
+}
+
+// K by the lowest loss under params, in ever finer steps
+static double tuneScale(TuneJob* job, const double* params) {
+    double best = 1, bestLoss = tuneLoss(job, params, best, NULL), step = 0.5;
+    for (int round = 0; round < 4; round++, step /= 5) {
+        double centre = best;
+        for (int i = -5; i <= 5; i++) {
+            double k = centre + i * step;
+            if (k <= 0 || i == 0) continue;
+            double loss = tuneLoss(job, params, k, NULL);
+            if (loss < bestLoss) best = k, bestLoss = loss;
+        }
+    }
+    return best;
+}
+
+// the tables and weights as engine.c declares them
+static bool writeTunedParams(SDL_IOStream* out, const double* params, double k, double loss) {
+    static const char* const NAMES[6] = { "PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING" };
+    static const char* const PHASES[2] = { "MIDDLE", "END" };
+    bool ok = SDL_IOprintf(out, "// tuned: K %.4f, loss %.6f\n", k, loss) > 0;
+    for (int kind = 0; kind < 6; kind++)
+        for (int phase = 0; phase < 2; phase++) {
+            ok &= SDL_IOprintf(out, "static const int %s_%s_TABLE[64] = { // a1 = 0, h8 = 63 for white; black's are mirrored\n",
+                               NAMES[kind], PHASES[phase]) > 0;
+            for (int sq = 0; sq < 64; sq++)
+                ok &= SDL_IOprintf(out, "%s%4ld%s", sq % 8 == 0 ? "   " : "", SDL_lround(params[phase * 6 * 64 + kind * 64 + sq]),
+                                   sq == 63 ? "\n};\n" : sq % 8 == 7 ? ",\n" : ",") > 0;
+        }
+    ok &= SDL_IOprintf(out, "\nstatic const int* const PIECE_TABLES[2][7] = {\n") > 0;
+    for (int phase = 0; phase < 2; phase++) {
+        ok &= SDL_IOprintf(out, "    { NULL") > 0;
+        for (int kind = 0; kind < 6; kind++) ok &= SDL_IOprintf(out, ", %s_%s_TABLE", NAMES[kind], PHASES[phase]) > 0;
+        ok &= SDL_IOprintf(out, " }%s\n", phase == 0 ? "," : "") > 0;
+    }
+    ok &= SDL_IOprintf(out, "};\n\nstatic const int EVAL_TERM_WEIGHTS[EVAL_TERM_COUNT] = {") > 0;
+    for (int t = 0; t < EVAL_TERM_COUNT; t++)
+        ok &= SDL_IOprintf(out, "%s %ld", t ? "," : "", SDL_lround(params[EVAL_TABLE_PARAMS + t])) > 0;
+    ok &= SDL_IOprintf(out, " };\n") > 0;
+    return ok;
+}
+
+static SDL_AppResult runTuneCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s tune <positions.epd|shard.bin> [iterations N] [threads N] [rate R] [out FILE]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    int iterations = TUNE_ITERATIONS, threads = SDL_GetNumLogicalCPUCores();
+    double rate = TUNE_RATE;
+    const char* outPath = TUNE_OUT;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (SDL_strcmp(argv[i], "iterations") == 0) iterations = SDL_max(SDL_atoi(argv[i + 1]), 0);
+        else if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(argv[i + 1]), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "rate") == 0) rate = SDL_strtod(argv[i + 1], NULL);
+        else if (SDL_strcmp(argv[i], "out") == 0) outPath = argv[i + 1];
+        else { SDL_Log("tune: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    engineInitTables();
+    MappedFile file;
+    if (!mapFile(&file, argv[2])) {
+        SDL_Log("tune: can't read %s: %s", argv[2], SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    TuneSet set = { .chunk = SDL_malloc(TUNE_CHUNK * sizeof(ChessState)) };
+    TuneJob job = { .set = &set, .gradients = SDL_malloc(TUNE_SLICES * sizeof(*job.gradients)) };
+    double* params = SDL_malloc(4 * EVAL_PARAM_COUNT * sizeof(double)); // then the gradient and Adam's two moments
+    SDL_AppResult result = SDL_APP_FAILURE;
+    if (!set.chunk || !job.gradients || !params) {
+        SDL_Log("tune: out of memory");
+        goto done;
+    }
+    size_t nameLength = SDL_strlen(argv[2]);
+    bool shard = (nameLength >= 4 && SDL_strcasecmp(argv[2] + nameLength - 4, ".bin") == 0)
+              || (nameLength >= 5 && SDL_strcasecmp(argv[2] + nameLength - 5, ".pack") == 0);
+    bool clean = shard ? readTuneShard(&set, (const Uint8*)file.data, file.size) : readTuneEpd(&set, file.data, file.data + file.size);
+    if (set.chunkCount > 0 && !set.outOfMemory) tuneFlush(&set);
+    if (set.outOfMemory) {
+        SDL_Log("tune: out of memory");
+        goto done;
+    }
+    if (set.count == 0) {
+        SDL_Log("tune: no positions to tune on in %s", argv[2]);
+        goto done;
+    }
+    SDL_Log("tune: %zu positions, %zu left out for their endings", set.count, set.skipped);
+
+    int engineParams[EVAL_PARAM_COUNT];
+    evalParams(engineParams);
+    double* gradient = params + EVAL_PARAM_COUNT;
+    double* moment = params + 2 * EVAL_PARAM_COUNT;
+    double* squares = params + 3 * EVAL_PARAM_COUNT;
+    for (int p = 0; p < EVAL_PARAM_COUNT; p++) params[p] = engineParams[p], moment[p] = squares[p] = 0;
+    if (!engineStartThreads(threads, false)) SDL_Log("tune: no worker threads, tuning on this one");
+    double k = tuneScale(&job, params);
+    double loss = tuneLoss(&job, params, k, NULL);
+    SDL_Log("tune: K %.4f, loss %.6f with the engine's weights", k, loss);
+    Uint64 start = SDL_GetTicksNS();
+    double decay1 = 1, decay2 = 1; // Adam's bias corrections, beta1 0.9 and beta2 0.999
+    for (int iteration = 1; iteration <= iterations; iteration++) {
+        loss = tuneLoss(&job, params, k, gradient);
+        decay1 *= 0.9, decay2 *= 0.999;
+        for (int p = 0; p < EVAL_PARAM_COUNT; p++) {
+            moment[p] = 0.9 * moment[p] + 0.1 * gradient[p];
+            squares[p] = 0.999 * squares[p] + 0.001 * gradient[p] * gradient[p];
+            params[p] -= rate * moment[p] / (1 - decay1) / (SDL_sqrt(squares[p] / (1 - decay2)) + 1e-12);
+        }
+        if (iteration % TUNE_LOG_EVERY == 0 || iteration == iterations)
+            SDL_Log("tune: iteration %d, loss %.6f (%.1f s)", iteration, loss, (double)(SDL_GetTicksNS() - start) / 1e9);
+    }
+    loss = tuneLoss(&job, params, k, NULL);
+    engineStopThreads();
+
+    SDL_IOStream* out = SDL_IOFromFile(outPath, "w");
+    bool written = out && writeTunedParams(out, params, k, loss);
+    if (out && !SDL_CloseIO(out)) written = false;
+    if (written) SDL_Log("tune: loss %.6f, weights written to %s", loss, outPath);
+    else SDL_Log("tune: can't write %s: %s", outPath, SDL_GetError());
+    result = written && clean ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+done:
+    unmapFile(&file);
+    SDL_free(params);
+    SDL_free(job.gradients);
+    SDL_free(set.chunk);
+    SDL_free(set.samples);
+    SDL_free(set.pieces);
+    return result;
+}
+
+/* Network conversion: `main net <network> <out>` writes a network file in the layout nnueLoad maps and uses where
+   it lies (version 2, see engine.c), so engines loading it start at once and share its pages with each other. */
+static SDL_AppResult runNetCommand(int argc, char* argv[]) {
+    if (argc != 4) {
+        SDL_Log("usage: %s net <network> <out>", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    if (!nnueLoad(argv[2])) return SDL_APP_FAILURE;
+    if (!nnueSave(argv[3])) {
+        SDL_Log("net: can't write %s: %s", argv[3], SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    SDL_Log("net: wrote %s", argv[3]);
+    return SDL_APP_SUCCESS;
+}
+
+/* UCI front end: `main uci [trace FILE] [searchlog FILE]` speaks the UCI protocol on stdin and stdout with no window, for tournament
+   managers and headless servers. The main thread reads commands straight off stdin; the engine's event callback
+   writes info and bestmove lines from the engine thread as the search goes, so the two share stdout under a lock.
+   An engine built with SEARCH_TRACE writes its trace (engineTraceWrite) to FILE on quit; `searchlog` logs every
+   search to its FILE (engineSearchLogOpen), for `main searchlog` after a lost game. Besides UCI, `memory`
+   tells where the engine's memory goes; the MemoryLimit option (MB, 0 = none) shrinks the hash to keep within it, and
+   SpinWait (microseconds) is how long an idle search thread spins before it sleeps (engineSetThreadSpin).
+   `savehash FILE` and `loadhash FILE` keep the hash table between sessions (engineSaveHash). */
+#define UCI_LINE_MAX 16384      // a `position ... moves` line for a very long game still fits
+#define UCI_HASH_MB 16          // the Hash option's default
+#define UCI_MOVE_OVERHEAD_MS 30 // kept back from each move's time for the GUI and the pipe
+
+typedef struct {
+    Engine* engine;
+    ChessState chess;  // the position of the last `position` command
+    SDL_Mutex* output; // one line at a time on stdout
+    PvLine best;       // engine thread: the best line of the last iteration, for the ponder move
+    OpeningBook* book; // the BookFile option's, NULL for none
+} UciState;
+
+// a whole line (or lines) onto stdout without the other thread's output cutting in
+static void uciPrint(UciState* uci, const char* text) {
+    SDL_LockMutex(uci->output);
+    fputs(text, stdout);
+    fflush(stdout);
+    SDL_UnlockMutex(uci->output);
+}
+
+// the legal move written as text (e2e4, e7e8q), MOVE_NONE if there is none
+static Move parseCoordinateMove(ChessState* chess, const char* text) {
+    MoveList legal;
+    getAllMoves(chess, &legal);
+    for (int i = 0; i < legal.count; i++) {
+        char move[6];
+        moveToCoordinates(legal.moves[i], move);
+        if (SDL_strcmp(move, text) == 0) return legal.moves[i];
+    }
+    return MOVE_NONE;
+}
+
+#define INFO_LINE_MAX (MAX_PV_LENGTH * 6 + 160)
+
+// an ENGINE_EVENT_INFO as a UCI info line, newline included
+static void formatInfoLine(const EngineEvent* event, char text[INFO_LINE_MAX]) {
+    const PvLine* line = &event->line;
+    int length = SDL_snprintf(text, INFO_LINE_MAX, "info depth %d seldepth %d multipv %d score ", event->depth,
+                              event->selDepth, event->lineIndex + 1);
+    if (abs(line->score) >= MATE_BOUND) length += SDL_snprintf(text + length, INFO_LINE_MAX - length, "mate %d", mateInMoves(line->score));
+    else length += SDL_snprintf(text + length, INFO_LINE_MAX - length, "cp %d", line->score);
+    length += SDL_snprintf(text + length, INFO_LINE_MAX - length, " nodes %" SDL_PRIu64 " nps %" SDL_PRIu64 " hashfull %d time %d pv",
+                           event->nodes, event->nps, event->hashfull, event->elapsedMs);
+    if (line->length > 0) text[length++] = ' ';
+    length += formatPv(NULL, line->moves, line->length, false, text + length, INFO_LINE_MAX - 1 - length);
+    text[length++] = '\n';
+    text[length] = '\0';
+}
+
+// engine thread: each event as an info or bestmove line
+static void uciEngineEvent(const EngineEvent* event, void* userData) {
+    UciState* uci = userData;
+    char text[INFO_LINE_MAX];
+    if (event->type == ENGINE_EVENT_INFO) {
+        if (event->lineIndex == 0) uci->best = event->line;
+        formatInfoLine(event, text);
+    } else {
+        SearchStats stats; // the search is over, its helpers with it
+        if (engineSearchStats(uci->engine, &stats)) {
+            char line[STATS_LINE_MAX + 32];
+            formatSearchStats(&stats, line + SDL_snprintf(line, sizeof(line), "info string stats "));
+            SDL_strlcat(line, "\n", sizeof(line));
+            uciPrint(uci, line);
+        }
+        char move[6] = "0000", ponder[6];
+        if (event->move != MOVE_NONE) moveToCoordinates(event->move, move);
+        int length = SDL_snprintf(text, sizeof(text), "bestmove %s", move);
+        if (uci->best.length > 1 && uci->best.moves[0] == event->move) {
+            moveToCoordinates(uci->best.moves[1], ponder);
+            SDL_snprintf(text + length, sizeof(text) - length, " ponder %s", ponder);
+        }
+        SDL_strlcat(text, "\n", sizeof(text));
+    }
+    uciPrint(uci, text);
+}
+
+/* [startpos | fen <fen>] [moves <move>...], as UCI's position command has it. False with the reason in error if
+   something is wrong: *out is left alone for a bad FEN, and holds the position up to an illegal move. */
+static bool readPosition(char* args, ChessState* out, char* error, size_t errorSize) {
+    char* moves = SDL_strstr(args, "moves");
+    if (moves) *moves = '\0', moves += 5;
+    ChessState chess = initChessState();
+    while (*args == ' ') args++;
+    if (SDL_strncmp(args, "fen", 3) == 0) {
+        const char* fen = args + 3;
+        while (*fen == ' ') fen++;
+        if (!loadFen(&chess, fen)) {
+            SDL_snprintf(error, errorSize, "bad FEN %s", fen);
+            return false;
+        }
+    }
+    bool ok = true;
+    char* save = NULL;
+    for (char* token = moves ? SDL_strtok_r(moves, " \t", &save) : NULL; token; token = SDL_strtok_r(NULL, " \t", &save)) {
+        Move move = parseCoordinateMove(&chess, token);
+        if (move == MOVE_NONE) {
+            SDL_snprintf(error, errorSize, "illegal move %s", token);
+            ok = false;
+            break;
+        }
+        makeMove(&chess, move, NULL); // the keys it pushes are the history the search checks repetitions against
+    }
+    *out = chess;
+    return ok;
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+static void uciPosition(UciState* uci, char* args) {
+    char error[256];
+    if (!readPosition(args, &uci->chess, error, sizeof(error))) printf("info string %s\n", error);
+}
+
+// go [depth N] [nodes N] [movetime MS] [wtime MS btime MS [winc MS binc MS] [movestogo N]] [infinite]
+static void uciGo(UciState* uci, char* args) {
+    SearchLimits limits = { 0 };
+    Sint64 time[2] = { -1, -1 }, inc[2] = { 0, 0 }, moveTime = -1;
+    int movesToGo = 0;
+    char* save = NULL;
+    for (char* token = SDL_strtok_r(args, " \t", &save); token; token = SDL_strtok_r(NULL, " \t", &save)) {
+        if (SDL_strcmp(token, "infinite") == 0) { limits.infinite = true; continue; }
+        char* value = SDL_strtok_r(NULL, " \t", &save);
+        if (!value) break;
+        Sint64 n = SDL_strtoll(value, NULL, 10);
+        if (SDL_strcmp(token, "depth") == 0) limits.depth = (int)SDL_clamp(n, 1, MOVE_DEPTH);
+        else if (SDL_strcmp(token, "nodes") == 0) limits.nodes = (Uint64)SDL_max(n, 1);
+        else if (SDL_strcmp(token, "movetime") == 0) moveTime = n;
+        else if (SDL_strcmp(token, "wtime") == 0) time[0] = n;
+        else if (SDL_strcmp(token, "btime") == 0) time[1] = n;
+        else if (SDL_strcmp(token, "winc") == 0) inc[0] = n;
+        else if (SDL_strcmp(token, "binc") == 0) inc[1] = n;
+        else if (SDL_strcmp(token, "movestogo") == 0) movesToGo = (int)n;
+    }
+    // a share of the clock plus most of the increment; the hard limit allows a few times that, never the lot
+    int side = uci->chess.whiteToMove ? 0 : 1;
+    if (limits.infinite) {
+        // no clock at all
+    } else if (moveTime >= 0) {
+        limits.softTimeNS = limits.hardTimeNS = (Uint64)SDL_max(moveTime - UCI_MOVE_OVERHEAD_MS, 1) * 1000000;
+    } else if (time[side] >= 0) {
+        Sint64 left = SDL_max(time[side] - UCI_MOVE_OVERHEAD_MS, 1);
+        Sint64 budget = time[side] / (movesToGo > 0 ? movesToGo : 30) + inc[side] * 3 / 4;
+        Sint64 softMs = SDL_clamp(budget, 1, left);
+        limits.softTimeNS = (Uint64)softMs * 1000000;
+        limits.hardTimeNS = (Uint64)SDL_min(budget * 3, SDL_max(left / 2, softMs)) * 1000000;
+    }
+    uci->best.length = 0;
+    engineStartSearch(uci->engine, &uci->chess, &limits);
+}
+
+// setoption name <Hash | Threads | MultiPV | MemoryLimit | SpinWait> value N, name <Deterministic | MCTS> value <true | false>, name
+// BookFile value <path> (empty for no book), name SyzygyPath value <directories> (engineSetSyzygyPath; empty for none),
+// name SharedHash value <segment> (empty for a table of its own), name
+// Clear Hash (a button, no value), or name <a search option> value N (true or false for a switch), by the names
+// `match` takes
+static void uciSetOption(UciState* uci, char* args) {
+    char* name = SDL_strstr(args, "name");
+    char* value = SDL_strstr(args, "value");
+    if (!name) return;
+    name += 4;
+    while (*name == ' ') name++;
+    if (!value && SDL_strncasecmp(name, "Clear Hash", 10) == 0) {
+        engineNewGame(uci->engine); // the table otherwise only ages from move to move, see ttNewSearch
+        return;
+    }
+    if (!value) return;
+    int n = SDL_atoi(value + 5);
+    if (SDL_strncasecmp(name, "Hash", 4) == 0) {
+        if (!engineSetHash(uci->engine, (size_t)SDL_clamp(n, 1, 65536))) printf("info string no memory for %d MB of hash\n", n);
+    } else if (SDL_strncasecmp(name, "Threads", 7) == 0) {
+        if (!engineSetThreads(SDL_clamp(n, 1, MAX_POOL_THREADS)))
+            printf("info string no search threads, searching on the engine thread only\n");
+        if (uci->engine->memoryLimit > 0) engineSetMemoryLimit(uci->engine, uci->engine->memoryLimit / (1024 * 1024)); // the hash gets what the threads leave
+    } else if (SDL_strncasecmp(name, "Deterministic", 13) == 0) {
+        uci->engine->options.deterministic = SDL_strncasecmp(value + 5, " true", 5) == 0;
+    } else if (SDL_strncasecmp(name, "MCTS", 4) == 0) {
+        uci->engine->options.mcts = SDL_strncasecmp(value + 5, " true", 5) == 0;
+    } else if (SDL_strncasecmp(name, "MemoryLimit", 11) == 0) {
+        if (!engineSetMemoryLimit(uci->engine, (size_t)SDL_max(n, 0))) printf("info string no memory for the hash table\n");
+    } else if (SDL_strncasecmp(name, "SpinWait", 8) == 0) {
+        engineSetThreadSpin(SDL_clamp(n, 0, 100000)); // microseconds
+    } else if (SDL_strncasecmp(name, "MultiPV", 7) == 0) {
+        uci->engine->multiPv = SDL_clamp(n, 1, MAX_MULTI_PV);
+    } else if (SDL_strncasecmp(name, "BookFile", 8) == 0) {
+        const char* path = value + 5;
+        while (*path == ' ') path++;
+        bool none = *path == '\0' || SDL_strcmp(path, "<empty>") == 0;
+        bookClose(uci->book);
+        uci->book = none ? NULL : bookOpen(path);
+        if (!none && !uci->book) printf("info string can't open the book %s\n", path);
+        uci->engine->book = uci->book;
+    } else if (SDL_strncasecmp(name, "SyzygyPath", 10) == 0) {
+        const char* paths = value + 5;
+        while (*paths == ' ') paths++;
+        int tables = engineSetSyzygyPath(paths);
+        if (tables > 0) printf("info string found %d Syzygy tables\n", tables);
+        else if (*paths && SDL_strcmp(paths, "<empty>") != 0) printf("info string no Syzygy tables in %s\n", paths);
+    } else if (SDL_strncasecmp(name, "SharedHash", 10) == 0) {
+        const char* segment = value + 5;
+        while (*segment == ' ') segment++;
+        if (SDL_strcmp(segment, "<empty>") == 0) segment = "";
+        if (!engineShareHash(uci->engine, segment)) printf("info string can't share the hash as %s: %s\n", segment, SDL_GetError());
+    } else { // any search option by its match name (rfpmargin, lmr ...), for tuners driving the engine over UCI
+        char setting[128];
+        int length = (int)(value - name);
+        while (length > 0 && name[length - 1] == ' ') length--;
+        bool on = SDL_strncasecmp(value + 5, " true", 5) == 0;
+        SDL_snprintf(setting, sizeof(setting), "%.*s=%d", SDL_min(length, 64), name, on ? 1 : n);
+        if (!parseSearchOptions(&uci->engine->options, setting)) printf("info string unknown option %.*s\n", SDL_min(length, 64), name);
+    }
+}
+
+// `memory`, not UCI: where the engine's memory goes (engineMemoryUsage), in MB
+static void uciMemory(UciState* uci) {
+    EngineMemory m;
+    engineMemoryUsage(uci->engine, &m);
+    char text[320], limit[32] = "none";
+    if (uci->engine->memoryLimit > 0) SDL_snprintf(limit, sizeof(limit), "%.1f", uci->engine->memoryLimit / 1048576.0);
+    SDL_snprintf(text, sizeof(text), "info string memory total %.1f limit %s hash %.1f pawntables %.1f evalcaches %.1f "
+                 "contexts %.1f rootsplit %.1f stacks %.1f tables %.1f\n", m.total / 1048576.0, limit, m.hash / 1048576.0,
+                 m.pawnTables / 1048576.0, m.evalCaches / 1048576.0, m.searchContexts / 1048576.0, m.rootSplit / 1048576.0,
+                 m.threadStacks / 1048576.0, m.tables / 1048576.0);
+    uciPrint(uci, text);
+}
+
+static SDL_AppResult runUciCommand(int argc, char* argv[]) {
+    const char* tracePath = NULL;
+    const char* searchLogPath = NULL;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (SDL_strcmp(argv[i], "trace") == 0) tracePath = argv[i + 1];
+        else if (SDL_strcmp(argv[i], "searchlog") == 0) searchLogPath = argv[i + 1];
+    }
+    engineInitTables();
+    UciState uci = { .engine = engineCreate(), .output = SDL_CreateMutex() };
+    if (!uci.engine || !uci.output) {
+        SDL_Log("uci: can't start: %s", SDL_GetError());
+        engineDestroy(uci.engine);
+        return SDL_APP_FAILURE;
+    }
+    if (!engineSetHash(uci.engine, UCI_HASH_MB)) SDL_Log("uci: no memory for the hash table, searching without it");
+    if (!engineStartThreads(1, false)) SDL_Log("uci: no search threads, searching on the engine thread only");
+    if (searchLogPath && !engineSearchLogOpen(searchLogPath))
+        SDL_Log("uci: can't open the search log %s: %s", searchLogPath, SDL_GetError());
+    uci.engine->onEvent = uciEngineEvent;
+    uci.engine->userData = &uci;
+    uci.chess = initChessState();
+
+    static char line[UCI_LINE_MAX];
+    while (fgets(line, sizeof(line), stdin)) {
+        char* end = SDL_strpbrk(line, "\r\n");
+        if (end) *end = '\0';
+        char* args = line;
+        while (*args == ' ' || *args == '\t') args++;
+        char* command = args;
+        while (*args && *args != ' ' && *args != '\t') args++;
+        if (*args) *args++ = '\0';
+
+        // commands that change anything end the search under way first, letting its bestmove out as UCI expects;
+        // after that stdout is this thread's, only uci, isready and unknown commands can meet an info line
+        if (SDL_strcmp(command, "uci") == 0) {
+            char text[768];
+            SDL_snprintf(text, sizeof(text), "id name SDL Clay Chess\nid author the SDL Clay Chess authors\n"
+                         "option name Hash type spin default %d min 1 max 65536\n"
+                         "option name Threads type spin default 1 min 1 max %d\n"
+                         "option name MultiPV type spin default 1 min 1 max %d\n"
+                         "option name BookFile type string default <empty>\n"
+                         "option name SyzygyPath type string default <empty>\n"
+                         "option name SharedHash type string default <empty>\n"
+                         "option name MemoryLimit type spin default %d min 0 max 1048576\n"
+                         "option name SpinWait type spin default %d min 0 max 100000\n"
+                         "option name Deterministic type check default false\n"
+                         "option name MCTS type check default false\n"
+                         "option name Clear Hash type button\n"
+                         "uciok\n", UCI_HASH_MB, MAX_POOL_THREADS, MAX_MULTI_PV, MEMORY_CEILING_MB, POOL_SPIN_US);
+            uciPrint(&uci, text);
+        } else if (SDL_strcmp(command, "isready") == 0) {
+            uciPrint(&uci, "readyok\n");
+        } else if (SDL_strcmp(command, "ucinewgame") == 0) {
+            engineStopSearch(uci.engine);
+            engineNewGame(uci.engine);
+        } else if (SDL_strcmp(command, "position") == 0) {
+            engineStopSearch(uci.engine);
+            uciPosition(&uci, args);
+        } else if (SDL_strcmp(command, "go") == 0) {
+            engineStopSearch(uci.engine);
+            uciGo(&uci, args);
+        } else if (SDL_strcmp(command, "stop") == 0) {
+            engineStopSearch(uci.engine);
+        } else if (SDL_strcmp(command, "setoption") == 0) {
+            engineStopSearch(uci.engine);
+            uciSetOption(&uci, args);
+        } else if (SDL_strcmp(command, "memory") == 0) {
+            uciMemory(&uci);
+        } else if (SDL_strcmp(command, "savehash") == 0 || SDL_strcmp(command, "loadhash") == 0) {
+            bool save = command[0] == 's';
+            if (!save) engineStopSearch(uci.engine);
+            char text[320];
+            if (save ? engineSaveHash(uci.engine, args) : engineLoadHash(uci.engine, args))
+                SDL_snprintf(text, sizeof(text), "info string hash %s %s\n", save ? "saved to" : "loaded from", args);
+            else SDL_snprintf(text, sizeof(text), "info string can't %s the hash: %s\n", save ? "save" : "load", SDL_GetError());
+            uciPrint(&uci, text);
+        } else if (SDL_strcmp(command, "quit") == 0) {
+            break;
+        } else if (*command) {
+            char text[128];
+            SDL_snprintf(text, sizeof(text), "info string unknown command %.64s\n", command);
+            uciPrint(&uci, text);
+        }
+        fflush(stdout);
+    }
+
+    engineDestroy(uci.engine); // stops the search, and its bestmove goes out
+    engineStopThreads();
+    engineSearchLogClose();
+    if (tracePath) writeTrace(tracePath);
+    bookClose(uci.book);
+    SDL_DestroyMutex(uci.output);
+    return SDL_APP_SUCCESS;
+}
+
+/* Position store, the analysis server's `db`: position key to best move, score, depth and principal variation,
+   kept on disk between runs. Two files: FILE holds STORE_RECORD_SIZE-byte records, appended to as results come
+   in, and FILE.idx a sorted index of keys, each with the number of its record. Both are mapped. Compaction, at
+   open and whenever STORE_COMPACT_RECORDS records have come in since the last, writes the deepest record of each
+   key out in key order with a new index beside it, so the records the index covers are FILE's first ones and
+   those after them are the ones appended since, held in a small table in memory too. A lookup tries that table,
+   then the index: keys are hashes, spread evenly, so interpolation finds a key's place in a probe or two, against
+   twenty-odd for a binary search of a million. Files are only ever replaced whole (written as FILE.tmp and
+   renamed over), each pair tagged with a generation both headers carry, so a reader never sees half a
+   compaction: a store opened read-only (`dbread`) maps what's there and reopens it when the index changes, while
+   one server writes. */
+#define STORE_MAGIC "chessdb1"
+#define STORE_INDEX_MAGIC "chessix1"
+#define STORE_HEADER 16         // magic, generation
+#define STORE_INDEX_HEADER 24   // magic, generation, entries
+#define STORE_RECORD_SIZE 64    // key, score, depth, PV length, PV
+#define STORE_INDEX_ENTRY 16    // key, record
+#define STORE_COMPACT_RECORDS 65536
+#define STORE_RELOAD_MS 10000   // how often a reader looks for a new index
+
+typedef struct {
+    Uint64 key;
+    int score;                  // side to move's
+    int depth;
+    int pvLength;               // 1 at least, the best move first
+    Move pv[MAX_PV_LENGTH];
+} StoredAnalysis;
+
+typedef struct {
+    char path[1024];
+    MappedFile data, index;     // as of the last compaction, and what's been appended to the data since
+    size_t indexCount;
+    StoredAnalysis* recent;     // records after the index's, open addressing; NULL while there are none
+    size_t recentMask, recentCount;
+    SDL_IOStream* log;          // the writer's, where records go; NULL for a reader
+    Uint64 generation;
+    SDL_Time indexTime;         // a reader's: the index file's modification time when mapped
+} PositionStore;
+
+static Uint64 storeRead64(const char* p) {
+    Uint64 value;
+    SDL_memcpy(&value, p, 8);
+    return SDL_Swap64LE(value);
+}
+
+static void storeRecordPack(const StoredAnalysis* analysis, Uint8 record[STORE_RECORD_SIZE]) {
+    SDL_memset(record, 0, STORE_RECORD_SIZE);
+    for (int i = 0; i < 8; i++) record[i] = (Uint8)(analysis->key >> (8 * i));
+    for (int i = 0; i < 4; i++) record[8 + i] = (Uint8)((Uint32)analysis->score >> (8 * i));
+    record[12] = (Uint8)analysis->depth;
+    record[13] = (Uint8)analysis->pvLength;
+    for (int i = 0; i < analysis->pvLength; i++) {
+        record[16 + 2 * i] = (Uint8)analysis->pv[i];
+        record[17 + 2 * i] = (Uint8)(analysis->pv[i] >> 8);
+    }
+}
+
+static void storeRecordUnpack(const Uint8* record, StoredAnalysis* analysis) {
+    Uint32 score = 0;
+    for (int i = 0; i < 4; i++) score |= (Uint32)record[8 + i] << (8 * i);
+    analysis->key = storeRead64((const char*)record);
+    analysis->score = (int)score;
+    analysis->depth = record[12];
+    analysis->pvLength = SDL_clamp(record[13], 1, MAX_PV_LENGTH);
+    for (int i = 0; i < analysis->pvLength; i++) analysis->pv[i] = (Move)(record[16 + 2 * i] | record[17 + 2 * i] << 8);
+}
+
+static StoredAnalysis* storeRecentSlot(const PositionStore* store, Uint64 key) {
+    size_t i = (size_t)(key * 0x9E3779B97F4A7C15ull >> 20) & store->recentMask;
+    while (store->recent[i].key && store->recent[i].key != key) i = (i + 1) & store->recentMask;
+    return &store->recent[i];
+}
+
+// into the in-memory table, unless it holds the key as deep already; false when there's no memory
+static bool storeRecentAdd(PositionStore* store, const StoredAnalysis* analysis) {
+    if ((store->recentCount + 1) * 2 > (store->recent ? store->recentMask + 1 : 0)) {
+        size_t oldSize = store->recent ? store->recentMask + 1 : 0, size = SDL_max(oldSize * 2, 1024);
+        StoredAnalysis* old = store->recent;
+        if (!(store->recent = SDL_calloc(size, sizeof(StoredAnalysis)))) {
+            store->recent = old;
+            return false;
+        }
+        store->recentMask = size - 1;
+        for (size_t i = 0; i < oldSize; i++)
+            if (old[i].key) *storeRecentSlot(store, old[i].key) = old[i];
+        SDL_free(old);
+    }
+    StoredAnalysis* slot = storeRecentSlot(store, analysis->key);
+    if (slot->key && slot->depth >= analysis->depth) return true;
+    if (!slot->key) store->recentCount++;
+    *slot = *analysis;
+    return true;
+}
+
+// the index entry for the key, by interpolation between the keys at the ends of the range left; -1 when absent
+static Sint64 storeIndexFind(const PositionStore* store, Uint64 key) {
+    const char* entries = store->index.data + STORE_INDEX_HEADER;
+    Sint64 low = 0, high = (Sint64)store->indexCount - 1;
+    while (low <= high) {
+        Uint64 lowKey = storeRead64(entries + low * STORE_INDEX_ENTRY), highKey = storeRead64(entries + high * STORE_INDEX_ENTRY);
+        if (key < lowKey || key > highKey) return -1;
+        Sint64 probe = highKey == lowKey ? low : low + (Sint64)((double)(key - lowKey) / (double)(highKey - lowKey) * (double)(high - low));
+        Uint64 probeKey = storeRead64(entries + probe * STORE_INDEX_ENTRY);
+        if (probeKey == key) return probe;
+        if (probeKey < key) low = probe + 1;
+        else high = probe - 1;
+    }
+    return -1;
+}
+
+// what the store has for the position's key, the newest first
+static bool positionStoreFind(const PositionStore* store, Uint64 key, StoredAnalysis* found) {
+    if (!key) return false;
+    if (store->recentCount > 0) {
+        const StoredAnalysis* slot = storeRecentSlot(store, key);
+        if (slot->key) { *found = *slot; return true; }
+    }
+    Sint64 entry = storeIndexFind(store, key);
+    if (entry < 0) return false;
+    Uint64 record = storeRead64(store->index.data + STORE_INDEX_HEADER + entry * STORE_INDEX_ENTRY + 8);
+    size_t offset = STORE_HEADER + (size_t)record * STORE_RECORD_SIZE;
+    if (offset + STORE_RECORD_SIZE > store->data.size) return false;
+    storeRecordUnpack((const Uint8*)store->data.data + offset, found);
+    return found->key == key; // a data file and index from different compactions never get this far, but still
+}
+
+static int compareStoredKeys(const void* a, const void* b) {
+    Uint64 x = ((const StoredAnalysis*)a)->key, y = ((const StoredAnalysis*)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+static bool storeWriteHeader(SDL_IOStream* out, const char* magic, Uint64 generation) {
+    Uint8 bytes[8];
+    for (int i = 0; i < 8; i++) bytes[i] = (Uint8)(generation >> (8 * i));
+    return SDL_WriteIO(out, magic, 8) == 8 && SDL_WriteIO(out, bytes, 8) == 8;
+}
+
+/* The index's records and the recent ones merged, in key order, the deeper of two with one key kept: a new data
+   file and index written beside the old, then renamed over them (after the old are unmapped, which Windows wants)
+   and mapped in their place. */
+static bool storeCompact(PositionStore* store) {
+    StoredAnalysis* recent = NULL;
+    size_t recentCount = 0;
+    if (store->recentCount > 0) {
+        if (!(recent = SDL_malloc(store->recentCount * sizeof(StoredAnalysis)))) return false;
+        for (size_t i = 0; i <= store->recentMask; i++)
+            if (store->recent[i].key) recent[recentCount++] = store->recent[i];
+        SDL_qsort(recent, recentCount, sizeof(StoredAnalysis), compareStoredKeys);
+    }
+    char dataTemporary[1040], indexTemporary[1040], indexPath[1040];
+    SDL_snprintf(dataTemporary, sizeof(dataTemporary), "%s.tmp", store->path);
+    SDL_snprintf(indexPath, sizeof(indexPath), "%s.idx", store->path);
+    SDL_snprintf(indexTemporary, sizeof(indexTemporary), "%s.tmp", indexPath);
+    Uint64 generation = store->generation + 1;
+    Uint64 count = 0;
+    SDL_IOStream* data = SDL_IOFromFile(dataTemporary, "wb");
+    SDL_IOStream* index = SDL_IOFromFile(indexTemporary, "wb");
+    Uint8 zeros[8] = { 0 };
+    bool written = data && index && storeWriteHeader(data, STORE_MAGIC, generation) &&
+                   storeWriteHeader(index, STORE_INDEX_MAGIC, generation) && SDL_WriteIO(index, zeros, 8) == 8;
+    for (size_t old = 0, fresh = 0; written && (old < store->indexCount || fresh < recentCount);) {
+        StoredAnalysis from = { 0 }, *next;
+        Uint64 oldKey = old < store->indexCount ? storeRead64(store->index.data + STORE_INDEX_HEADER + old * STORE_INDEX_ENTRY) : 0;
+        bool takeOld = old < store->indexCount && (fresh == recentCount || oldKey <= recent[fresh].key);
+        bool takeFresh = fresh < recentCount && (old == store->indexCount || recent[fresh].key <= oldKey);
+        if (takeOld) {
+            Uint64 record = storeRead64(store->index.data + STORE_INDEX_HEADER + old * STORE_INDEX_ENTRY + 8);
+            storeRecordUnpack((const Uint8*)store->data.data + STORE_HEADER + record * STORE_RECORD_SIZE, &from);
+            old++;
+        }
+        next = takeFresh && (!takeOld || recent[fresh].depth >= from.depth) ? &recent[fresh] : &from;
+        if (takeFresh) fresh++;
+        Uint8 record[STORE_RECORD_SIZE], entry[STORE_INDEX_ENTRY];
+        storeRecordPack(next, record);
+        for (int i = 0; i < 8; i++) entry[i] = (Uint8)(next->key >> (8 * i)), entry[8 + i] = (Uint8)(count >> (8 * i));
+        written = SDL_WriteIO(data, record, sizeof(record)) == sizeof(record) && SDL_WriteIO(index, entry, sizeof(entry)) == sizeof(entry);
+        count++;
+    }
+    Uint8 counted[8];
+    for (int i = 0; i < 8; i++) counted[i] = (Uint8)(count >> (8 * i));
+    written = written && SDL_SeekIO(index, 16, SDL_IO_SEEK_SET) == 16 && SDL_WriteIO(index, counted, 8) == 8;
+    if (data && !SDL_CloseIO(data)) written = false;
+    if (index && !SDL_CloseIO(index)) written = false;
+    SDL_free(recent);
+    if (!written) return false;
+    if (store->log) SDL_CloseIO(store->log);
+    store->log = NULL;
+    unmapFile(&store->data);
+    unmapFile(&store->index);
+    bool renamed = SDL_RenamePath(dataTemporary, store->path) && SDL_RenamePath(indexTemporary, indexPath);
+    if (!renamed || !mapFile(&store->data, store->path) || !mapFile(&store->index, indexPath)) return false;
+    store->indexCount = (size_t)count;
+    store->generation = generation;
+    SDL_free(store->recent);
+    store->recent = NULL;
+    store->recentMask = store->recentCount = 0;
+    return (store->log = SDL_IOFromFile(store->path, "ab")) != NULL;
+}
+
+static void positionStoreClose(PositionStore* store) {
+    if (!store) return;
+    if (store->log) SDL_CloseIO(store->log);
+    unmapFile(&store->data);
+    unmapFile(&store->index);
+    SDL_free(store->recent);
+    SDL_free(store);
+}
+
+/* Maps the store at path, started empty when a writer finds none. The index is trusted when its generation is
+   the data's; the records it doesn't cover go in the in-memory table, and a writer then compacts them in. */
+static PositionStore* positionStoreOpen(const char* path, bool writable) {
+    PositionStore* store = SDL_calloc(1, sizeof(PositionStore));
+    if (!store) return NULL;
+    SDL_strlcpy(store->path, path, sizeof(store->path));
+    char indexPath[1040];
+    SDL_snprintf(indexPath, sizeof(indexPath), "%s.idx", path);
+    store->data.data = store->index.data = "";
+    if (writable && !SDL_GetPathInfo(path, NULL)) { // a new store: a data file with nothing in it
+        SDL_IOStream* out = SDL_IOFromFile(path, "wb");
+        bool written = out && storeWriteHeader(out, STORE_MAGIC, 0);
+        if (out && !SDL_CloseIO(out)) written = false;
+        if (!written) { positionStoreClose(store); return NULL; }
+    }
+    if (!mapFile(&store->data, path)) { positionStoreClose(store); return NULL; }
+    if (store->data.size < STORE_HEADER || SDL_memcmp(store->data.data, STORE_MAGIC, 8) != 0) {
+        SDL_SetError("%s isn't a position store", path);
+        positionStoreClose(store);
+        return NULL;
+    }
+    store->generation = storeRead64(store->data.data + 8);
+    SDL_PathInfo info;
+    if (SDL_GetPathInfo(indexPath, &info) && mapFile(&store->index, indexPath)) {
+        store->indexTime = info.modify_time;
+        bool matches = store->index.size >= STORE_INDEX_HEADER && SDL_memcmp(store->index.data, STORE_INDEX_MAGIC, 8) == 0 &&
+                       storeRead64(store->index.data + 8) == store->generation;
+        Uint64 count = matches ? storeRead64(store->index.data + 16) : 0;
+        if (count * STORE_INDEX_ENTRY <= store->index.size - STORE_INDEX_HEADER &&
+            STORE_HEADER + count * STORE_RECORD_SIZE <= store->data.size) store->indexCount = (size_t)count;
+    }
+    size_t records = (store->data.size - STORE_HEADER) / STORE_RECORD_SIZE;
+    for (size_t r = store->indexCount; r < records; r++) {
+        StoredAnalysis analysis;
+        storeRecordUnpack((const Uint8*)store->data.data + STORE_HEADER + r * STORE_RECORD_SIZE, &analysis);
+        if (analysis.key && !storeRecentAdd(store, &analysis)) { positionStoreClose(store); return NULL; }
+    }
+    bool partial = (store->data.size - STORE_HEADER) % STORE_RECORD_SIZE != 0; // appending after it would go astray
+    if (writable && (store->recentCount > 0 || partial || store->index.size == 0) && !storeCompact(store)) {
+        positionStoreClose(store);
+        return NULL;
+    }
+    if (writable && !store->log && !(store->log = SDL_IOFromFile(path, "ab"))) {
+        positionStoreClose(store);
+        return NULL;
+    }
+    return store;
+}
+
+// the writer: a new result, kept unless the store has the key as deep already
+static bool positionStoreAdd(PositionStore* store, const StoredAnalysis* analysis) {
+    StoredAnalysis have;
+    if (!store->log || !analysis->key || (positionStoreFind(store, analysis->key, &have) && have.depth >= analysis->depth))
+        return true;
+    Uint8 record[STORE_RECORD_SIZE];
+    storeRecordPack(analysis, record);
+    if (SDL_WriteIO(store->log, record, sizeof(record)) != sizeof(record) || !SDL_FlushIO(store->log)) return false;
+    if (!storeRecentAdd(store, analysis)) return false;
+    return store->recentCount < STORE_COMPACT_RECORDS || storeCompact(store);
+}
+
+// a reader: the store opened again when the writer has compacted it since; the store to go on with
+static PositionStore* positionStoreRefresh(PositionStore* store) {
+    char indexPath[1040];
+    SDL_snprintf(indexPath, sizeof(indexPath), "%s.idx", store->path);
+    SDL_PathInfo info;
+    if (store->log || !SDL_GetPathInfo(indexPath, &info) || info.modify_time == store->indexTime) return store;
+    PositionStore* fresh = positionStoreOpen(store->path, false);
+    if (!fresh) return store;
+    positionStoreClose(store);
+    return fresh;
+}
+
+/* Simultaneous play: `main simul [boards N] [movetime MS] [depth N] [hash MB] [threads N] [colors white|black|alternate]
+   [interleave N]` hosts N games against the engine in one process, for an exhibition or a training room: the
+   opponents' moves come in on stdin and the engine's go out on stdout, a line each, for whatever front end shows
+   the boards (numbered from 1):
+     <board> <move>     the opponent's move on a board (e2e4), answered by <board> <move> once the engine has its own
+     <board> new        the game on the board started over
+     <board> fen        <board> fen <fen>, the board's position
+     status             boards N playing P searching S, the games still going and the searches asked for
+     quit
+   with <board> result 1-0 (or 0-1, 1/2-1/2) when a game ends and "error <reason>" for anything it can't do. Every
+   board's search is a request to the one engine (engineSubmit), so the boards share its pool of threads and its
+   hash table, set up once, rather than each having an engine, a thread and tables of its own; the requests are
+   searched in the order the moves came, each with all the threads, and with `interleave` shallow ones side by
+   side (Engine.interleave). The engine plays white on every board unless `colors` says otherwise, and its first
+   moves are asked for as soon as the boards are set up. */
+#define SIMUL_BOARDS 20
+#define SIMUL_MOVETIME_MS 2000
+#define SIMUL_HASH_MB 256
+
+typedef struct SimulState SimulState;
+
+typedef struct {
+    SimulState* simul;
+    int number;              // from 1
+    ChessState chess;
+    bool engineWhite;
+    bool over;
+    bool searching;          // the engine's move is asked for and not yet in
+    bool discard;            // its answer is for a game started over since
+    EngineRequest* request;  // the last search, answered or not; NULL for none
+} SimulBoard;
+
+struct SimulState {
+    Engine* engine;
+    SimulBoard* boards;
+    int count;
+    SearchLimits limits;
+    SDL_Mutex* lock;         // the boards and stdout, shared with the request thread's answers
+};
+
+static void simulPrint(const char* text) { // with the lock held
+    fputs(text, stdout);
+    fflush(stdout);
+}
+
+// with the lock held: the board's result, if the move just made has ended its game
+static void simulCheckResult(SimulBoard* board) {
+    MoveList legal;
+    getAllMoves(&board->chess, &legal);
+    int result = selfPlayResult(&board->chess, &legal);
+    if (result == SELFPLAY_ONGOING) return;
+    static const char* RESULTS[] = { "0-1", "1/2-1/2", "1-0" }; // by white's result + 1
+    char text[64];
+    SDL_snprintf(text, sizeof(text), "%d result %s\n", board->number, RESULTS[result + 1]);
+    simulPrint(text);
+    board->over = true;
+}
+
+// request thread: the engine's move, played on its board
+static void simulEngineEvent(const EngineEvent* event, void* userData) {
+    SimulBoard* board = userData;
+    if (event->type != ENGINE_EVENT_BEST_MOVE) return;
+    SDL_LockMutex(board->simul->lock);
+    if (!board->discard) {
+        board->searching = false;
+        char move[6], text[32];
+        if (event->move != MOVE_NONE) {
+            moveToCoordinates(event->move, move);
+            makeMove(&board->chess, event->move, NULL);
+            SDL_snprintf(text, sizeof(text), "%d %s\n", board->number, move);
+            simulPrint(text);
+            simulCheckResult(board);
+        }
+    }
+    SDL_UnlockMutex(board->simul->lock);
+}
+
+// the last request out of the way, with no lock held: its answer may be waiting for the lock
+static void simulForget(SimulState* simul, SimulBoard* board) {
+    if (!board->request) return;
+    SDL_LockMutex(simul->lock);
+    board->discard = board->searching;
+    SDL_UnlockMutex(simul->lock);
+    engineRequestFree(board->request);
+    board->request = NULL;
+    board->discard = board->searching = false;
+}
+
+// the engine's move asked for, if it's the engine's turn on the board
+static void simulAsk(SimulState* simul, SimulBoard* board) {
+    if (board->over || board->chess.whiteToMove != board->engineWhite) return;
+    simulForget(simul, board);
+    SDL_LockMutex(simul->lock);
+    board->searching = true;
+    SDL_UnlockMutex(simul->lock);
+    board->request = engineSubmit(simul->engine, &board->chess, &simul->limits, simulEngineEvent, board, NULL);
+    if (board->request) return;
+    SDL_LockMutex(simul->lock);
+    board->searching = false;
+    char text[64];
+    SDL_snprintf(text, sizeof(text), "error %d can't search now\n", board->number);
+    simulPrint(text);
+    SDL_UnlockMutex(simul->lock);
+}
+
+static void simulNewGame(SimulState* simul, SimulBoard* board) {
+    simulForget(simul, board);
+    board->chess = initChessState();
+    board->over = false;
+    simulAsk(simul, board);
+}
+
+static void simulCommand(SimulState* simul, char* line) {
+    char text[FEN_MAX + 32];
+    char* save = NULL;
+    char* first = SDL_strtok_r(line, " \t", &save);
+    char* second = first ? SDL_strtok_r(NULL, " \t", &save) : NULL;
+    if (!first) return;
+    if (SDL_strcmp(first, "status") == 0) {
+        int playing = 0, searching = 0;
+        SDL_LockMutex(simul->lock);
+        for (int i = 0; i < simul->count; i++) playing += !simul->boards[i].over, searching += simul->boards[i].searching;
+        SDL_snprintf(text, sizeof(text), "boards %d playing %d searching %d\n", simul->count, playing, searching);
+        simulPrint(text);
+        SDL_UnlockMutex(simul->lock);
+        return;
+    }
+    int number = SDL_atoi(first);
+    SimulBoard* board = number >= 1 && number <= simul->count ? &simul->boards[number - 1] : NULL;
+    if (!board || !second) {
+        if (board) SDL_snprintf(text, sizeof(text), "error %d what?\n", number);
+        else SDL_snprintf(text, sizeof(text), "error no board %.16s\n", first);
+        SDL_LockMutex(simul->lock);
+        simulPrint(text);
+        SDL_UnlockMutex(simul->lock);
+        return;
+    }
+    if (SDL_strcmp(second, "new") == 0) {
+        simulNewGame(simul, board);
+        return;
+    }
+    SDL_LockMutex(simul->lock);
+    if (SDL_strcmp(second, "fen") == 0) {
+        int n = SDL_snprintf(text, sizeof(text), "%d fen ", number);
+        writeFen(&board->chess, text + n, sizeof(text) - (size_t)n - 1);
+        SDL_strlcat(text, "\n", sizeof(text));
+        simulPrint(text);
+        SDL_UnlockMutex(simul->lock);
+        return;
+    }
+    const char* refusal = board->over ? "the game is over" : board->chess.whiteToMove == board->engineWhite ? "not your move" : NULL;
+    Move move = refusal ? MOVE_NONE : parseCoordinateMove(&board->chess, second);
+    if (!refusal && move == MOVE_NONE) refusal = "illegal move";
+    if (refusal) {
+        SDL_snprintf(text, sizeof(text), "error %d %s %.16s\n", number, refusal, second);
+        simulPrint(text);
+        SDL_UnlockMutex(simul->lock);
+        return;
+    }
+    makeMove(&board->chess, move, NULL);
+    simulCheckResult(board);
+    SDL_UnlockMutex(simul->lock);
+    simulAsk(simul, board);
+}
+
+static SDL_AppResult runSimulCommand(int argc, char* argv[]) {
+    SimulState simul = { .count = SIMUL_BOARDS };
+    int threads = SDL_GetNumLogicalCPUCores(), movetime = SIMUL_MOVETIME_MS, interleave = 0;
+    size_t hashMB = SIMUL_HASH_MB;
+    const char* colors = "white";
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1]; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "boards") == 0) simul.count = SDL_clamp(SDL_atoi(value), 1, 1000);
+        else if (SDL_strcmp(argv[i], "movetime") == 0) movetime = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "depth") == 0) simul.limits.depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH);
+        else if (SDL_strcmp(argv[i], "hash") == 0) hashMB = (size_t)SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "colors") == 0) colors = value;
+        else if (SDL_strcmp(argv[i], "interleave") == 0) interleave = SDL_clamp(SDL_atoi(value), 0, INTERLEAVE_MAX);
+        else { SDL_Log("simul: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    if (SDL_strcmp(colors, "white") != 0 && SDL_strcmp(colors, "black") != 0 && SDL_strcmp(colors, "alternate") != 0) {
+        SDL_Log("simul: colors is white, black or alternate, not %s", colors);
+        return SDL_APP_FAILURE;
+    }
+    simul.limits.softTimeNS = simul.limits.hardTimeNS = (Uint64)movetime * 1000000;
+    engineInitTables();
+    simul.engine = engineCreate();
+    simul.boards = SDL_calloc((size_t)simul.count, sizeof(SimulBoard));
+    simul.lock = SDL_CreateMutex();
+    if (!simul.engine || !simul.boards || !simul.lock) {
+        SDL_Log("simul: out of memory");
+        engineDestroy(simul.engine);
+        SDL_free(simul.boards);
+        SDL_DestroyMutex(simul.lock);
+        return SDL_APP_FAILURE;
+    }
+    simul.engine->interleave = interleave;
+    if (!engineSetHash(simul.engine, hashMB)) SDL_Log("simul: no memory for %zu MB of hash, searching without it", hashMB);
+    if (!engineStartThreads(threads, false)) SDL_Log("simul: no search threads, searching on the engine thread only");
+    SDL_Log("simul: %d boards, %d ms a move, %d threads", simul.count, movetime, threads);
+    for (int i = 0; i < simul.count; i++) {
+        SimulBoard* board = &simul.boards[i];
+        board->simul = &simul;
+        board->number = i + 1;
+        board->engineWhite = colors[0] == 'w' || (colors[0] == 'a' && i % 2 == 0);
+        simulNewGame(&simul, board);
+    }
+    static char line[UCI_LINE_MAX];
+    while (fgets(line, sizeof(line), stdin)) {
+        char* end = SDL_strpbrk(line, "\r\n");
+        if (end) *end = '\0';
+        if (SDL_strcmp(line, "quit") == 0) break;
+        simulCommand(&simul, line);
+    }
+    for (int i = 0; i < simul.count; i++) simulForget(&simul, &simul.boards[i]);
+    engineDestroy(simul.engine);
+    engineStopThreads();
+    SDL_DestroyMutex(simul.lock);
+    SDL_free(simul.boards);
+    return SDL_APP_SUCCESS;
+}
+
+/* Analysis server: `main serve [port N] [address A] [sessions N] [queue N] [maxtime MS] [hash MB] [threads N]
+   [hashfile FILE] [sharedhash NAME] [interleave N] [db FILE] [dbread FILE] [explorer FILE] [standby N]
+   [batchqueue N] [batchthreads N] [searchlog FILE] [record FILE] [warm N]`
+   listens on TCP, on 127.0.0.1 unless given an address, and analyses for any number of clients at once. Every
+   connection is a session with a position of its own, and all of them share one engine, whose hash table lasts as
+   long as the server does: a position analysed before comes back almost at once. Sessions speak a line protocol
+   much like UCI:
+     position [startpos | fen <fen>] [moves <move>...]
+     go [depth N] [nodes N] [movetime MS] [priority interactive|batch]
+                                            info lines as the search deepens, then bestmove <move>
+     stop                                   answer now with the best move so far
+     explore                                move <move> games N white W draws D black B a line for each
+                                            move the explorer index has for the position, then end
+     stats                                  the metrics below, then end
+     isready                                readyok
+     quit
+   and are told "error <reason>" for anything they can't have. The metrics are in Prometheus's text format, and a
+   plain HTTP `GET /metrics` on the same port has them too, so the server can be scraped as it is: the engine's
+   lifetime counters (nodes, hash table probes and hits, tablebase hits; engineCounters, each thread's own
+   counts added up only when asked, so the search is never held up), the hash table's fill, the pool's threads
+   and the time each has spent searching, where the memory goes, the sessions, the queues, and each priority
+   class's search latency (from the go to the bestmove) as a histogram to take percentiles from. One thread looks
+   after every socket with select() and polls the sessions' searches (engineSubmit), which the engine runs one at a
+   time in the order they came;
+   with one search per session in the queue, no session gets a second turn before the others have had theirs.
+   A go is interactive unless it says `priority batch`: batch searches have the engine only when no interactive
+   one is waiting, an interactive go stops the batch search under way at once (it's run again afterwards), and
+   `batchthreads` caps the threads a batch search takes, so bulk analysis fills the spare time without adding to
+   anyone's wait. Admission control: clients past `sessions` are turned away, a go with `queue` interactive
+   searches already waiting (or `batchqueue` batch ones) is refused, and no search runs longer than `maxtime`. The server runs until it is killed; with a `hashfile`, the
+   table is loaded from it at startup (when it exists) and written back to it every SERVE_HASH_SAVE_MS that saw a
+   search, so a restart loses little of what it had learnt. With `sharedhash`, servers on one host share a table in
+   the shared-memory segment NAME (engineShareHash). With `interleave`, up to N queued searches with a shallow
+   depth limit are searched side by side on one thread (Engine.interleave), which answers more of them a second.
+   With `db`, every search's result goes into a position store (PositionStore), and a go with a depth the store
+   has already reached for the position is answered from it at once, without a search; `dbread` answers from a
+   store another server writes. With `explorer`, the position's games come from an index `main explorer` made.
+   A session is one block taken when the client connects (Arena): the session first, then whatever its requests
+   need, which goes back in one step when the answer is in, so serving a search never touches the heap and a
+   server up for weeks doesn't fragment it. `standby` sessions (SERVE_STANDBY) are made and faulted in at startup,
+   and a closed session goes back among them, reset, rather than to the heap: a client connecting takes one ready
+   to go. The engine, warm from its first search, is the one every session shares, so there's no engine to set
+   up for a session either. With `searchlog`, every search is logged to FILE (engineSearchLogOpen) for `main
+   searchlog` to read back; the log is written out every SEARCH_LOG_FLUSH_MS, so killing the server loses little of it.
+   With `record`, every go is written to FILE as it comes, a line each (serveRecord), for `main loadtest` to play
+   back against a server. With `warm`, the hash table is filled from the store in the background as the server
+   starts (WarmJob), the explorer index's most played positions first when there is one.
+
+   A client whose first byte is SERVE_BINARY_MAGIC speaks a binary protocol instead, for traffic of many small
+   searches where writing and parsing FENs and info lines would cost more than the search: frames each way of a
+   4-byte header (the magic, the frame's type and a Uint16 body length), all little-endian, read in place from the
+   receive buffer. A search frame's body is
+     0  Uint32 tag, echoed in the answer
+     4  the position in 32 bytes, laid out as a training record (engine.h), its score and result bytes unused
+    36  Uint8 depth (0: none), 37 Uint8 flags (bit 0: batch priority), 38 Uint16 movetime in ms (0: maxtime),
+    40  Uint32 nodes (0: none), 44 Uint8 moves played from the position, then each as a Uint16 Move (engine.h)
+   and it's answered, when the search is over, by one result frame of SERVE_BINARY_RESULT_SIZE bytes:
+     0  Uint32 tag, 4 Uint16 best move (MOVE_NONE when there's none), 6 Sint16 score for the side to move,
+     8  Uint8 depth, 9 Uint8 seldepth, 10 Uint8 moves of the line, 11 Uint8 flags (bit 0: from the position store),
+    12  Uint32 nodes, 16 Uint32 microseconds from the request to the answer, 20 the line, SERVE_BINARY_PV Uint16s
+   or by an error frame, the Uint32 tag and a ServeBinaryError. A stop frame, with no body, is the text stop. There
+   are no info frames: a client that wants the search as it deepens speaks the text protocol. */
+#define SERVE_PORT 7878
+#define SERVE_SESSIONS 32
+#define SERVE_QUEUE 16
+#define SERVE_BATCH_QUEUE 64
+#define SERVE_MAX_TIME_MS 10000
+#define SERVE_HASH_MB 256
+#define SERVE_POLL_MS 5 // how often the searches are looked at when no socket has anything to read
+#define SERVE_HASH_SAVE_MS (10 * 60 * 1000)
+#define SERVE_REQUEST_ARENA (16 * 1024) // a session's room for its request, past the session itself
+#define SERVE_STANDBY 8 // sessions kept ready for the next clients
+#define SERVE_METRICS_MAX 16384
+#define SERVE_LATENCY_BUCKETS 10
+#define SERVE_BINARY_MAGIC 0xB1 // no text command starts with it
+#define SERVE_BINARY_SEARCH_SIZE 45 // a search frame's body, before its moves
+#define SERVE_BINARY_PV 14
+#define SERVE_BINARY_RESULT_SIZE (20 + 2 * SERVE_BINARY_PV)
+static const double SERVE_LATENCY_BOUNDS[SERVE_LATENCY_BUCKETS] = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30 }; // seconds
+
+#if defined(_WIN32)
+typedef SOCKET ServeSocket;
+#define SERVE_NO_SOCKET INVALID_SOCKET
+#define closeSocket closesocket
+#else
+typedef int ServeSocket;
+#define SERVE_NO_SOCKET (-1)
+#define closeSocket close
+#endif
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0 // elsewhere a client hanging up doesn't raise SIGPIPE to begin with
+#endif
+
+typedef enum { SERVE_FRAME_SEARCH = 1, SERVE_FRAME_STOP = 2, SERVE_FRAME_RESULT = 0x81, SERVE_FRAME_ERROR = 0x82 } ServeFrameType;
+
+typedef enum {
+    SERVE_ERROR_BUSY = 1,       // the queue is full, try again later
+    SERVE_ERROR_SEARCHING,      // the session's last search isn't answered yet
+    SERVE_ERROR_POSITION,       // no position packs to those 32 bytes, or the side not to move is in check
+    SERVE_ERROR_MOVE,           // a move isn't legal where it's played
+    SERVE_ERROR_ENGINE,         // the search couldn't be started
+} ServeBinaryError;
+
+typedef struct {
+    ServeSocket socket;     // SERVE_NO_SOCKET once the client has gone; the session stays until its search is answered
+    char input[UCI_LINE_MAX]; // read, but not yet a whole line
+    size_t inputLength;
+    ChessState chess;       // the position of the last `position` command
+    EngineRequest* request; // the search under way or queued, NULL if none, in arena
+    int infoDepth;          // the deepest iteration already sent
+    bool batch;             // the request is a batch one
+    Uint64 submittedNS;     // when its go came
+    bool http;              // a GET: the header lines are skipped, the blank line after them answered
+    bool httpMetrics;       // ... and it asked for /metrics
+    bool started, binary;   // the first byte is in, and it was SERVE_BINARY_MAGIC
+    Uint32 tag;             // binary: the search frame's, for its answer
+    Uint64 number;          // the connection's, counting from 1, for the record
+    Arena arena;            // the session's block, this session at its start
+    size_t requestMark;     // where the request memory starts, past the session
+} ServeSession;
+
+typedef struct {
+    Engine* engine;
+    ServeSession** sessions;
+    int sessionCount, maxSessions;
+    int queued, maxQueued;  // interactive searches submitted and not yet answered
+    int batchQueued, maxBatchQueued; // and batch ones
+    Uint64 maxTimeNS;
+    const char* hashFile;   // where the table is kept between runs, NULL for nowhere
+    Uint64 hashSavedNS;     // when it was last written
+    bool hashChanged;       // a search has finished since
+    PositionStore* store;   // `db` or `dbread`, NULL for none
+    Uint64 storeCheckedNS;  // dbread: when it was last looked at for a compaction
+    OpeningBook* explorer;  // for explore, NULL for none
+    SDL_IOStream* record;   // `record`: every go, for `main loadtest`; NULL for none
+    ServeSession** standby; // closed or not yet used, ready for a client
+    int standbyCount, maxStandby;
+    // for stats, [0] interactive and [1] batch
+    Uint64 startNS;
+    Uint64 connections, refused, storeAnswers;
+    Uint64 searches[2];
+    Uint64 latency[2][SERVE_LATENCY_BUCKETS + 1]; // answers by their latency bucket, the last past every bound
+    double latencySum[2];   // seconds
+} ServeState;
+
+// a session's block, faulted in now rather than on its first search; NULL without the memory
+static ServeSession* serveSessionCreate(void) {
+    Arena arena = { 0 };
+    if (!arenaCreate(&arena, sizeof(ServeSession) + SERVE_REQUEST_ARENA)) return NULL;
+    SDL_memset(arena.base, 0, arena.size);
+    ServeSession* session = arenaAlloc(&arena, sizeof(ServeSession));
+    session->arena = arena;
+    session->requestMark = arena.used;
+    return session;
+}
+
+// a session ready for a client's socket, off the standby list or made now; NULL without the memory
+static ServeSession* serveSessionTake(ServeState* server) {
+    ServeSession* session = server->standbyCount > 0 ? server->standby[--server->standbyCount] : serveSessionCreate();
+    if (!session) return NULL;
+    session->socket = SERVE_NO_SOCKET;
+    session->http = session->httpMetrics = false;
+    session->started = session->binary = false;
+    session->inputLength = 0;
+    session->chess = initChessState();
+    session->request = NULL;
+    session->infoDepth = 0;
+    return session;
+}
+
+// a closed session, answered, back on the standby list; freed when that's full
+static void serveSessionGive(ServeState* server, ServeSession* session) {
+    arenaRewind(&session->arena, session->requestMark);
+    if (server->standbyCount < server->maxStandby) {
+        server->standby[server->standbyCount++] = session;
+        return;
+    }
+    Arena arena = session->arena; // the session is in it
+    arenaDestroy(&arena);
+}
+
+// the session's search is cancelled, it's freed once that arrives
+static void serveHangUp(ServeSession* session) {
+    if (session->socket == SERVE_NO_SOCKET) return;
+    closeSocket(session->socket);
+    session->socket = SERVE_NO_SOCKET;
+    if (session->request) engineRequestCancel(session->request);
+}
+
+static void serveSendBytes(ServeSession* session, const void* data, size_t length) {
+    const char* bytes = data;
+    while (length > 0 && session->socket != SERVE_NO_SOCKET) {
+        int sent = (int)send(session->socket, bytes, (int)length, MSG_NOSIGNAL);
+        if (sent <= 0) { serveHangUp(session); return; }
+        bytes += sent;
+        length -= (size_t)sent;
+    }
+}
+
+static void serveSend(ServeSession* session, const char* text) {
+    serveSendBytes(session, text, SDL_strlen(text));
+}
+
+static Uint32 readLe16(const Uint8* p) { return (Uint32)p[0] | (Uint32)p[1] << 8; }
+static Uint32 readLe32(const Uint8* p) { return readLe16(p) | readLe16(p + 2) << 16; }
+static void writeLe16(Uint8* p, Uint32 v) { p[0] = (Uint8)v, p[1] = (Uint8)(v >> 8); }
+static void writeLe32(Uint8* p, Uint32 v) { writeLe16(p, v), writeLe16(p + 2, v >> 16); }
+
+static void serveSendFrame(ServeSession* session, ServeFrameType type, Uint8* frame, size_t bodyLength) {
+    frame[0] = SERVE_BINARY_MAGIC, frame[1] = (Uint8)type;
+    writeLe16(frame + 2, (Uint32)bodyLength);
+    serveSendBytes(session, frame, 4 + bodyLength);
+}
+
+static void serveSendError(ServeSession* session, Uint32 tag, ServeBinaryError error) {
+    Uint8 frame[4 + 5];
+    writeLe32(frame + 4, tag);
+    frame[8] = (Uint8)error;
+    serveSendFrame(session, SERVE_FRAME_ERROR, frame, 5);
+}
+
+// a binary session's answer: the search's last iteration (its line, when that starts with the move) and the move
+static void serveSendResult(ServeSession* session, const EngineEvent* last, Move best, bool stored, Uint64 elapsedNS) {
+    Uint8 frame[4 + SERVE_BINARY_RESULT_SIZE] = { 0 };
+    Uint8* body = frame + 4;
+    bool line = last->line.length > 0 && last->line.moves[0] == best;
+    int length = line ? SDL_min(last->line.length, SERVE_BINARY_PV) : 0;
+    writeLe32(body, session->tag);
+    writeLe16(body + 4, best);
+    writeLe16(body + 6, (Uint16)(Sint16)SDL_clamp(last->line.score, -32767, 32767));
+    body[8] = (Uint8)SDL_clamp(last->depth, 0, 255);
+    body[9] = (Uint8)SDL_clamp(last->selDepth, 0, 255);
+    body[10] = (Uint8)length;
+    body[11] = stored ? 1 : 0;
+    writeLe32(body + 12, (Uint32)SDL_min(last->nodes, 0xFFFFFFFFu));
+    writeLe32(body + 16, (Uint32)SDL_min(elapsedNS / 1000, 0xFFFFFFFFu));
+    for (int i = 0; i < length; i++) writeLe16(body + 20 + 2 * i, last->line.moves[i]);
+    serveSendFrame(session, SERVE_FRAME_RESULT, frame, SERVE_BINARY_RESULT_SIZE);
+}
+
+// a go the store can answer: its line as the last iteration's info, then the move, when that's legal here
+static bool serveStoredAnswer(ServeSession* session, const StoredAnalysis* stored) {
+    MoveList legal;
+    getAllMoves(&session->chess, &legal);
+    bool found = false;
+    for (int i = 0; i < legal.count && !found; i++) found = legal.moves[i] == stored->pv[0];
+    if (!found) return false;
+    EngineEvent event = { .type = ENGINE_EVENT_INFO, .depth = stored->depth, .selDepth = stored->depth, .lineCount = 1 };
+    event.line.length = stored->pvLength;
+    event.line.score = stored->score;
+    SDL_memcpy(event.line.moves, stored->pv, sizeof(Move) * (size_t)stored->pvLength);
+    if (session->binary) {
+        serveSendResult(session, &event, stored->pv[0], true, 0);
+        return true;
+    }
+    char text[INFO_LINE_MAX], move[6];
+    formatInfoLine(&event, text);
+    serveSend(session, text);
+    moveToCoordinates(stored->pv[0], move);
+    SDL_snprintf(text, sizeof(text), "bestmove %s\n", move);
+    serveSend(session, text);
+    return true;
+}
+
+// either protocol's search, once its limits are known: refused, answered from the store, or queued
+static void serveSubmit(ServeState* server, ServeSession* session, const SearchLimits* request) {
+    SearchLimits limits = *request;
+    if (limits.batch ? server->batchQueued >= server->maxBatchQueued : server->queued >= server->maxQueued) {
+        server->refused++;
+        if (session->binary) serveSendError(session, session->tag, SERVE_ERROR_BUSY);
+        else serveSend(session, "error busy, try again later\n");
+        return;
+    }
+    StoredAnalysis stored;
+    if (server->store && limits.depth > 0 && positionStoreFind(server->store, session->chess.hashKey, &stored) &&
+        stored.depth >= limits.depth && serveStoredAnswer(session, &stored)) {
+        server->storeAnswers++;
+        return;
+    }
+    session->request = engineSubmit(server->engine, &session->chess, &limits, NULL, NULL, &session->arena);
+    if (!session->request) {
+        if (session->binary) serveSendError(session, session->tag, SERVE_ERROR_ENGINE);
+        else serveSend(session, "error can't search now\n");
+        return;
+    }
+    session->infoDepth = 0;
+    session->batch = limits.batch;
+    session->submittedNS = SDL_GetTicksNS();
+    if (limits.batch) server->batchQueued++;
+    else server->queued++;
+}
+
+// a go as it came, onto the record: ms since the start, the connection, the position and the go's arguments
+static void serveRecord(ServeState* server, const ServeSession* session, const char* args) {
+    char fen[FEN_MAX];
+    writeFen(&session->chess, fen, sizeof(fen));
+    if (SDL_IOprintf(server->record, "%" SDL_PRIu64 " %" SDL_PRIu64 " %s\t%s\n", (SDL_GetTicksNS() - server->startNS) / 1000000,
+                     session->number, fen, args) == 0 || !SDL_FlushIO(server->record)) {
+        SDL_Log("serve: can't write the record, recording no more: %s", SDL_GetError());
+        SDL_CloseIO(server->record);
+        server->record = NULL;
+    }
+}
+
+// go [depth N] [nodes N] [movetime MS] [priority interactive|batch], within maxtime
+static void serveGo(ServeState* server, ServeSession* session, char* args) {
+    if (server->record) serveRecord(server, session, args);
+    SearchLimits limits = { .softTimeNS = server->maxTimeNS, .hardTimeNS = server->maxTimeNS };
+    char* save = NULL;
+    for (char* token = SDL_strtok_r(args, " \t", &save); token; token = SDL_strtok_r(NULL, " \t", &save)) {
+        char* value = SDL_strtok_r(NULL, " \t", &save);
+        if (!value) break;
+        Sint64 n = SDL_strtoll(value, NULL, 10);
+        if (SDL_strcmp(token, "depth") == 0) limits.depth = (int)SDL_clamp(n, 1, MOVE_DEPTH);
+        else if (SDL_strcmp(token, "nodes") == 0) limits.nodes = (Uint64)SDL_max(n, 1);
+        else if (SDL_strcmp(token, "movetime") == 0) limits.softTimeNS = limits.hardTimeNS = SDL_min((Uint64)SDL_max(n, 1) * 1000000, server->maxTimeNS);
+        else if (SDL_strcmp(token, "priority") == 0) limits.batch = SDL_strcmp(value, "batch") == 0;
+    }
+    serveSubmit(server, session, &limits);
+}
+
+// a search frame: its position, the moves after it and the limits, read where they lie in the receive buffer
+static void serveBinarySearch(ServeState* server, ServeSession* session, const Uint8* body) {
+    Uint32 tag = readLe32(body);
+    if (session->request) { serveSendError(session, tag, SERVE_ERROR_SEARCHING); return; }
+    ChessState chess = initChessState();
+    int score, result;
+    if (!trainingRecordUnpack(body + 4, &chess, &score, &result) || isKingInCheck(&chess, !chess.whiteToMove)) {
+        serveSendError(session, tag, SERVE_ERROR_POSITION);
+        return;
+    }
+    for (int i = 0; i < body[44]; i++) {
+        Move move = (Move)readLe16(body + SERVE_BINARY_SEARCH_SIZE + 2 * i);
+        MoveList legal;
+        getAllMoves(&chess, &legal);
+        bool found = false;
+        for (int k = 0; k < legal.count && !found; k++) found = legal.moves[k] == move;
+        if (!found) { serveSendError(session, tag, SERVE_ERROR_MOVE); return; }
+        makeMove(&chess, move, NULL); // the repetition history, as for a text position's moves
+    }
+    session->chess = chess;
+    session->tag = tag;
+    Uint32 movetime = readLe16(body + 38), nodes = readLe32(body + 40);
+    SearchLimits limits = { .depth = SDL_min(body[36], MOVE_DEPTH), .nodes = nodes, .batch = (body[37] & 1) != 0 };
+    limits.softTimeNS = limits.hardTimeNS = movetime ? SDL_min((Uint64)movetime * 1000000, server->maxTimeNS) : server->maxTimeNS;
+    if (server->record) { // as the go it stands for, so loadtest can play it back
+        char args[96] = "";
+        size_t n = 0;
+        if (limits.depth) n += (size_t)SDL_snprintf(args + n, sizeof(args) - n, "depth %d ", limits.depth);
+        if (nodes) n += (size_t)SDL_snprintf(args + n, sizeof(args) - n, "nodes %u ", nodes);
+        if (movetime) n += (size_t)SDL_snprintf(args + n, sizeof(args) - n, "movetime %u ", movetime);
+        SDL_snprintf(args + n, sizeof(args) - n, "priority %s", limits.batch ? "batch" : "interactive");
+        serveRecord(server, session, args);
+    }
+    serveSubmit(server, session, &limits);
+}
+
+static void serveMetric(char* text, size_t size, size_t* n, SDL_PRINTF_FORMAT_STRING const char* format, ...) SDL_PRINTF_VARARG_FUNC(4);
+static void serveMetric(char* text, size_t size, size_t* n, const char* format, ...) {
+    if (*n >= size) return;
+    va_list args;
+    va_start(args, format);
+    int length = SDL_vsnprintf(text + *n, size - *n, format, args);
+    va_end(args);
+    *n = length < 0 ? size : SDL_min(*n + (size_t)length, size);
+}
+
+// every metric, in Prometheus's text exposition format; returns the length
+static size_t serveMetrics(ServeState* server, char* text, size_t size) {
+    size_t n = 0;
+    EngineCounters counters;
+    engineCounters(server->engine, &counters);
+    serveMetric(text, size, &n, "# TYPE chess_nodes_total counter\nchess_nodes_total %" SDL_PRIu64 "\n", counters.nodes);
+    serveMetric(text, size, &n, "# TYPE chess_tt_probes_total counter\nchess_tt_probes_total %" SDL_PRIu64 "\n", counters.ttProbes);
+    serveMetric(text, size, &n, "# TYPE chess_tt_hits_total counter\nchess_tt_hits_total %" SDL_PRIu64 "\n", counters.ttHits);
+    serveMetric(text, size, &n, "# TYPE chess_tablebase_hits_total counter\nchess_tablebase_hits_total %" SDL_PRIu64 "\n", counters.tbHits);
+    serveMetric(text, size, &n, "# HELP chess_hashfull_permille the hash table's entries written by the current or last search\n"
+                "# TYPE chess_hashfull_permille gauge\nchess_hashfull_permille %d\n", engineHashfull(server->engine));
+    Uint64 busyNS[MAX_POOL_THREADS], waitNS;
+    int workers = engineThreadActivity(busyNS, &waitNS);
+    serveMetric(text, size, &n, "# TYPE chess_threads gauge\nchess_threads %d\n", workers + 1); // and the request thread
+    serveMetric(text, size, &n, "# TYPE chess_thread_busy_seconds_total counter\n");
+    for (int i = 0; i < workers; i++)
+        serveMetric(text, size, &n, "chess_thread_busy_seconds_total{thread=\"%d\"} %.6f\n", i + 1, (double)busyNS[i] / 1e9);
+    EngineMemory memory;
+    engineMemoryUsage(server->engine, &memory);
+    static const char* const MEMORY[] = { "hash", "pawn_tables", "eval_caches", "search_contexts", "root_split", "thread_stacks", "tables" };
+    const size_t bytes[] = { memory.hash, memory.pawnTables, memory.evalCaches, memory.searchContexts, memory.rootSplit,
+                             memory.threadStacks, memory.tables };
+    serveMetric(text, size, &n, "# TYPE chess_memory_bytes gauge\n");
+    for (size_t i = 0; i < SDL_arraysize(MEMORY); i++) serveMetric(text, size, &n, "chess_memory_bytes{kind=\"%s\"} %zu\n", MEMORY[i], bytes[i]);
+
+    serveMetric(text, size, &n, "# TYPE chess_serve_uptime_seconds gauge\nchess_serve_uptime_seconds %.3f\n",
+                (double)(SDL_GetTicksNS() - server->startNS) / 1e9);
+    serveMetric(text, size, &n, "# TYPE chess_serve_sessions gauge\nchess_serve_sessions %d\n", server->sessionCount);
+    serveMetric(text, size, &n, "# TYPE chess_serve_connections_total counter\nchess_serve_connections_total %" SDL_PRIu64 "\n", server->connections);
+    serveMetric(text, size, &n, "# TYPE chess_serve_queue_depth gauge\nchess_serve_queue_depth{class=\"interactive\"} %d\n"
+                "chess_serve_queue_depth{class=\"batch\"} %d\n", server->queued, server->batchQueued);
+    serveMetric(text, size, &n, "# TYPE chess_serve_refused_total counter\nchess_serve_refused_total %" SDL_PRIu64 "\n", server->refused);
+    serveMetric(text, size, &n, "# TYPE chess_serve_preemptions_total counter\nchess_serve_preemptions_total %" SDL_PRIu64 "\n",
+                __atomic_load_n(&server->engine->preemptions, __ATOMIC_RELAXED));
+    serveMetric(text, size, &n, "# TYPE chess_serve_store_answers_total counter\nchess_serve_store_answers_total %" SDL_PRIu64 "\n",
+                server->storeAnswers);
+    serveMetric(text, size, &n, "# TYPE chess_serve_search_latency_seconds histogram\n");
+    static const char* const CLASSES[] = { "interactive", "batch" };
+    for (int c = 0; c < 2; c++) {
+        Uint64 cumulative = 0;
+        for (int b = 0; b < SERVE_LATENCY_BUCKETS; b++) {
+            cumulative += server->latency[c][b];
+            serveMetric(text, size, &n, "chess_serve_search_latency_seconds_bucket{class=\"%s\",le=\"%g\"} %" SDL_PRIu64 "\n",
+                        CLASSES[c], SERVE_LATENCY_BOUNDS[b], cumulative);
+        }
+        serveMetric(text, size, &n, "chess_serve_search_latency_seconds_bucket{class=\"%s\",le=\"+Inf\"} %" SDL_PRIu64 "\n"
+                    "chess_serve_search_latency_seconds_sum{class=\"%s\"} %.6f\n"
+                    "chess_serve_search_latency_seconds_count{class=\"%s\"} %" SDL_PRIu64 "\n",
+                    CLASSES[c], server->searches[c], CLASSES[c], server->latencySum[c], CLASSES[c], server->searches[c]);
+    }
+    return n;
+}
+
+// the end of an HTTP request's header: the metrics, or a 404 for any other path, and the connection closed
+static void serveHttpAnswer(ServeState* server, ServeSession* session) {
+    char body[SERVE_METRICS_MAX], header[160];
+    size_t length = session->httpMetrics ? serveMetrics(server, body, sizeof(body)) : 0;
+    if (!session->httpMetrics) length = (size_t)SDL_snprintf(body, sizeof(body), "not found\n");
+    SDL_snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n"
+                 "Connection: close\r\n\r\n", session->httpMetrics ? "200 OK" : "404 Not Found", length);
+    serveSend(session, header);
+    serveSend(session, body);
+    serveHangUp(session);
+}
+
+static void serveCommand(ServeState* server, ServeSession* session, char* line) {
+    if (session->http) {
+        if (!*line) serveHttpAnswer(server, session);
+        return;
+    }
+    char* args = line;
+    while (*args == ' ' || *args == '\t') args++;
+    char* command = args;
+    while (*args && *args != ' ' && *args != '\t') args++;
+    if (*args) *args++ = '\0';
+    char text[320];
+    if (SDL_strcmp(command, "position") == 0 || SDL_strcmp(command, "go") == 0) {
+        if (session->request) serveSend(session, "error a search is under way\n");
+        else if (command[0] == 'g') serveGo(server, session, args);
+        else if (!readPosition(args, &session->chess, text + 6, sizeof(text) - 8)) {
+            SDL_memcpy(text, "error ", 6);
+            SDL_strlcat(text, "\n", sizeof(text));
+            serveSend(session, text);
+        }
+    } else if (SDL_strcmp(command, "explore") == 0) {
+        if (!server->explorer) { serveSend(session, "error no explorer index\n"); return; }
+        BookMoveStats stats[256];
+        int count = bookStats(server->explorer, &session->chess, stats, (int)SDL_arraysize(stats));
+        for (int i = 0; i < count && session->socket != SERVE_NO_SOCKET; i++) {
+            char move[6];
+            moveToCoordinates(stats[i].move, move);
+            SDL_snprintf(text, sizeof(text), "move %s games %u white %u draws %u black %u\n", move, stats[i].games,
+                         stats[i].whiteWins, stats[i].draws, stats[i].blackWins);
+            serveSend(session, text);
+        }
+        serveSend(session, "end\n");
+    } else if (SDL_strcmp(command, "stop") == 0) {
+        if (session->request) engineRequestCancel(session->request);
+    } else if (SDL_strcmp(command, "stats") == 0) {
+        char metrics[SERVE_METRICS_MAX];
+        serveMetrics(server, metrics, sizeof(metrics));
+        serveSend(session, metrics);
+        serveSend(session, "end\n");
+    } else if (SDL_strcmp(command, "GET") == 0) {
+        session->http = true;
+        session->httpMetrics = SDL_strncmp(args, "/metrics", 8) == 0 && (args[8] == ' ' || args[8] == '\0' || args[8] == '?');
+    } else if (SDL_strcmp(command, "isready") == 0) {
+        serveSend(session, "readyok\n");
+    } else if (SDL_strcmp(command, "quit") == 0) {
+        serveHangUp(session);
+    } else if (*command) {
+        SDL_snprintf(text, sizeof(text), "error unknown command %.64s\n", command);
+        serveSend(session, text);
+    }
+}
+
+// a whole binary frame, its body still in the receive buffer; false for one that makes no sense
+static bool serveFrame(ServeState* server, ServeSession* session, int type, const Uint8* body, size_t length) {
+    if (type == SERVE_FRAME_SEARCH && length >= SERVE_BINARY_SEARCH_SIZE && length == SERVE_BINARY_SEARCH_SIZE + 2 * (size_t)body[44])
+        serveBinarySearch(server, session, body);
+    else if (type == SERVE_FRAME_STOP && length == 0) {
+        if (session->request) engineRequestCancel(session->request);
+    } else return false;
+    return true;
+}
+
+// whatever the client has sent; each whole line is a command, or each whole frame for a binary session
+static void serveRead(ServeState* server, ServeSession* session) {
+    size_t room = sizeof(session->input) - session->inputLength;
+    int received = (int)recv(session->socket, session->input + session->inputLength, (int)room, 0);
+    if (received <= 0) { serveHangUp(session); return; }
+    if (!session->started) session->started = true, session->binary = (Uint8)session->input[0] == SERVE_BINARY_MAGIC;
+    session->inputLength += (size_t)received;
+    char* start = session->input;
+    char* end = session->input + session->inputLength;
+    while (session->binary && session->socket != SERVE_NO_SOCKET && end - start >= 4) {
+        const Uint8* frame = (const Uint8*)start;
+        size_t length = readLe16(frame + 2);
+        if (frame[0] != SERVE_BINARY_MAGIC || 4 + length > sizeof(session->input)) { serveHangUp(session); return; }
+        if ((size_t)(end - start) < 4 + length) break;
+        if (!serveFrame(server, session, frame[1], frame + 4, length)) { serveHangUp(session); return; }
+        start += 4 + length;
+    }
+    for (char* newline; !session->binary && session->socket != SERVE_NO_SOCKET && (newline = memchr(start, '\n', (size_t)(end - start)));) {
+        *newline = '\0';
+        if (newline > start && newline[-1] == '\r') newline[-1] = '\0';
+        serveCommand(server, session, start);
+        start = newline + 1;
+    }
+    session->inputLength = (size_t)(end - start);
+    SDL_memmove(session->input, start, session->inputLength);
+    if (session->inputLength == sizeof(session->input)) {
+        serveSend(session, "error line too long\n");
+        serveHangUp(session);
+    }
+}
+
+// a new iteration as an info line, and the answer once it's in
+static void serveProgress(ServeState* server, ServeSession* session) {
+    EngineEvent progress;
+    bool done = engineRequestPoll(session->request, &progress);
+    char text[INFO_LINE_MAX];
+    if (progress.depth > session->infoDepth && !session->binary) {
+        session->infoDepth = progress.depth;
+        formatInfoLine(&progress, text);
+        serveSend(session, text);
+    }
+    if (!done) return;
+    Move best = engineRequestWait(session->request); // answered already, no wait
+    if (session->binary) {
+        serveSendResult(session, &progress, best, false, SDL_GetTicksNS() - session->submittedNS);
+    } else {
+        char move[6] = "0000";
+        if (best != MOVE_NONE) moveToCoordinates(best, move);
+        SDL_snprintf(text, sizeof(text), "bestmove %s\n", move);
+        serveSend(session, text);
+    }
+    if (server->store && best != MOVE_NONE && progress.depth > 0) {
+        StoredAnalysis result = { .key = session->chess.hashKey, .score = progress.line.score, .depth = progress.depth, .pvLength = 1 };
+        result.pv[0] = best;
+        if (progress.line.length > 0 && progress.line.moves[0] == best) {
+            result.pvLength = progress.line.length;
+            SDL_memcpy(result.pv, progress.line.moves, sizeof(Move) * (size_t)progress.line.length);
+        }
+        if (!positionStoreAdd(server->store, &result)) SDL_Log("serve: can't add to the position store: %s", SDL_GetError());
+    }
+    engineRequestFree(session->request);
+    session->request = NULL;
+    arenaRewind(&session->arena, session->requestMark);
+    double seconds = (double)(SDL_GetTicksNS() - session->submittedNS) / 1e9;
+    int bucket = 0;
+    while (bucket < SERVE_LATENCY_BUCKETS && seconds > SERVE_LATENCY_BOUNDS[bucket]) bucket++;
+    server->latency[session->batch][bucket]++;
+    server->latencySum[session->batch] += seconds;
+    server->searches[session->batch]++;
+    if (session->batch) server->batchQueued--;
+    else server->queued--;
+    server->hashChanged = true;
+}
+
+static void serveAccept(ServeState* server, ServeSocket listener) {
+    ServeSocket client = accept(listener, NULL, NULL);
+    if (client == SERVE_NO_SOCKET) return;
+    bool full = server->sessionCount >= server->maxSessions;
+#if !defined(_WIN32)
+    full = full || client >= FD_SETSIZE; // select() can't watch it
+#endif
+    ServeSession* session = full ? NULL : serveSessionTake(server);
+    if (!session) {
+        static const char refusal[] = "error server full\n";
+        send(client, refusal, (int)sizeof(refusal) - 1, MSG_NOSIGNAL);
+        closeSocket(client);
+        return;
+    }
+    int noDelay = 1; // an info line and the bestmove straight after it go out at once, not an ACK apart
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    session->socket = client;
+    server->sessions[server->sessionCount++] = session;
+    session->number = ++server->connections;
+}
+
+/* Warm start (`warm N`): on a thread of its own, while the server takes its first clients, the position store's
+   results go into the hash table (engineWarmHash), so the searches of those positions and of the ones leading to
+   them start from a deep result rather than cold. With an explorer index the positions are the openings', the
+   most played first, followed down the index for SERVE_WARM_PLIES plies at most, and N of them are looked up;
+   without one, N of the store's records go in as they come. The thread has a read-only view of the store of its
+   own, as a `dbread` server would, so the server's is never touched from two threads. */
+#define SERVE_WARM_PLIES 24
+#define SERVE_WARM_FRONTIER 8 // positions waiting to be looked at, per position to look at
+
+typedef struct {
+    Uint32 games;               // the explorer's, for the move that reaches it
+    int length;
+    Move moves[SERVE_WARM_PLIES]; // from the start position
+} WarmPosition;
+
+typedef struct {
+    Engine* engine;
+    const OpeningBook* explorer; // NULL: the store's records in file order
+    char storePath[1024];
+    int limit;
+} WarmJob;
+
+// the positions waiting, a heap with the most played on top
+static void warmPush(WarmPosition* heap, int* count, const WarmPosition* position) {
+    int i = (*count)++;
+    for (; i > 0 && heap[(i - 1) / 2].games < position->games; i = (i - 1) / 2) heap[i] = heap[(i - 1) / 2];
+    heap[i] = *position;
+}
+
+static void warmPop(WarmPosition* heap, int* count, WarmPosition* top) {
+    *top = heap[0];
+    WarmPosition last = heap[--(*count)];
+    int i = 0;
+    for (int child; (child = 2 * i + 1) < *count; i = child) {
+        if (child + 1 < *count && heap[child + 1].games > heap[child].games) child++;
+        if (heap[child].games <= last.games) break;
+        heap[i] = heap[child];
+    }
+    heap[i] = last;
+}
+
+// the explorer's positions, best first; returns how many results went in, *looked the positions looked up
+static int warmFromExplorer(const WarmJob* job, const PositionStore* store, int* looked) {
+    int capacity = job->limit * SERVE_WARM_FRONTIER + 64, count = 0, warmed = 0;
+    size_t seenMask = 1;
+    while (seenMask < (size_t)job->limit * 2) seenMask <<= 1;
+    WarmPosition* heap = SDL_malloc(sizeof(WarmPosition) * (size_t)capacity);
+    Uint64* seen = SDL_calloc(seenMask--, sizeof(Uint64)); // transpositions are looked at once
+    if (!heap || !seen) {
+        SDL_free(heap);
+        SDL_free(seen);
+        return 0;
+    }
+    warmPush(heap, &count, &(WarmPosition){ .games = SDL_MAX_UINT32 });
+    while (count > 0 && *looked < job->limit) {
+        WarmPosition position;
+        warmPop(heap, &count, &position);
+        ChessState chess = initChessState();
+        for (int i = 0; i < position.length; i++) makeMove(&chess, position.moves[i], NULL);
+        size_t slot = (size_t)(chess.hashKey * 0x9E3779B97F4A7C15ull >> 20) & seenMask;
+        while (seen[slot] && seen[slot] != chess.hashKey) slot = (slot + 1) & seenMask;
+        if (seen[slot]) continue;
+        seen[slot] = chess.hashKey;
+        (*looked)++;
+        StoredAnalysis found;
+        if (positionStoreFind(store, chess.hashKey, &found)) {
+            engineWarmHash(job->engine, found.key, found.pv[0], found.score, found.depth);
+            warmed++;
+        }
+        if (position.length == SERVE_WARM_PLIES) continue;
+        BookMoveStats stats[64];
+        int moves = bookStats(job->explorer, &chess, stats, (int)SDL_arraysize(stats));
+        for (int i = 0; i < moves && count < capacity; i++) {
+            WarmPosition next = position;
+            next.games = stats[i].games;
+            next.moves[next.length++] = stats[i].move;
+            warmPush(heap, &count, &next);
+        }
+    }
+    SDL_free(heap);
+    SDL_free(seen);
+    return warmed;
+}
+
+static int SDLCALL warm_thread(void* data) {
+    WarmJob* job = data;
+    Uint64 start = SDL_GetTicksNS();
+    PositionStore* store = positionStoreOpen(job->storePath, false);
+    if (!store) {
+        SDL_Log("serve: no warm start, can't read the position store: %s", SDL_GetError());
+        SDL_free(job);
+        return 0;
+    }
+    int warmed = 0, looked = 0;
+    if (job->explorer) {
+        warmed = warmFromExplorer(job, store, &looked);
+    } else {
+        size_t records = (store->data.size - STORE_HEADER) / STORE_RECORD_SIZE;
+        for (size_t r = 0; r < records && warmed < job->limit; r++) {
+            StoredAnalysis found;
+            storeRecordUnpack((const Uint8*)store->data.data + STORE_HEADER + r * STORE_RECORD_SIZE, &found);
+            if (!found.key) continue;
+            engineWarmHash(job->engine, found.key, found.pv[0], found.score, found.depth);
+            warmed++;
+        }
+    }
+    SDL_Log("serve: warm start, %d stored results in the hash table in %.3f s (%d explorer positions looked up)",
+            warmed, (double)(SDL_GetTicksNS() - start) / 1e9, looked);
+    positionStoreClose(store);
+    SDL_free(job);
+    return 0;
+}
+
+static SDL_AppResult runServeCommand(int argc, char* argv[]) {
+    int port = SERVE_PORT, threads = SDL_GetNumLogicalCPUCores();
+    const char* address = "127.0.0.1";
+    size_t hashMB = SERVE_HASH_MB;
+    const char* shareName = NULL;
+    int interleave = 0;
+    const char* storePath = NULL;
+    bool storeWritable = false;
+    const char* explorerPath = NULL;
+    ServeState server = { .maxSessions = SERVE_SESSIONS, .maxQueued = SERVE_QUEUE, .maxTimeNS = (Uint64)SERVE_MAX_TIME_MS * 1000000,
+                          .maxBatchQueued = SERVE_BATCH_QUEUE, .maxStandby = SERVE_STANDBY };
+    int batchThreads = 0;
+    const char* searchLogPath = NULL;
+    const char* recordPath = NULL;
+    int warm = 0;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1]; // SDL_clamp evaluates its argument more than once
+        if (SDL_strcmp(argv[i], "port") == 0) port = SDL_clamp(SDL_atoi(value), 1, 65535);
+        else if (SDL_strcmp(argv[i], "address") == 0) address = value;
+        else if (SDL_strcmp(argv[i], "sessions") == 0) server.maxSessions = SDL_clamp(SDL_atoi(value), 1, FD_SETSIZE - 1);
+        else if (SDL_strcmp(argv[i], "queue") == 0) server.maxQueued = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "maxtime") == 0) server.maxTimeNS = (Uint64)SDL_max(SDL_atoi(value), 1) * 1000000;
+        else if (SDL_strcmp(argv[i], "hash") == 0) hashMB = (size_t)SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS);
+        else if (SDL_strcmp(argv[i], "hashfile") == 0) server.hashFile = value;
+        else if (SDL_strcmp(argv[i], "sharedhash") == 0) shareName = value;
+        else if (SDL_strcmp(argv[i], "interleave") == 0) interleave = SDL_clamp(SDL_atoi(value), 0, INTERLEAVE_MAX);
+        else if (SDL_strcmp(argv[i], "db") == 0) storePath = value, storeWritable = true;
+        else if (SDL_strcmp(argv[i], "dbread") == 0) storePath = value, storeWritable = false;
+        else if (SDL_strcmp(argv[i], "explorer") == 0) explorerPath = value;
+        else if (SDL_strcmp(argv[i], "standby") == 0) server.maxStandby = SDL_max(SDL_atoi(value), 0);
+        else if (SDL_strcmp(argv[i], "batchqueue") == 0) server.maxBatchQueued = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "batchthreads") == 0) batchThreads = SDL_max(SDL_atoi(value), 0);
+        else if (SDL_strcmp(argv[i], "searchlog") == 0) searchLogPath = value;
+        else if (SDL_strcmp(argv[i], "record") == 0) recordPath = value;
+        else if (SDL_strcmp(argv[i], "warm") == 0) warm = SDL_max(SDL_atoi(value), 0);
+        else { SDL_Log("serve: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) { SDL_Log("serve: no sockets"); return SDL_APP_FAILURE; }
+#endif
+    struct sockaddr_in bound;
+    SDL_memset(&bound, 0, sizeof(bound));
+    bound.sin_family = AF_INET;
+    bound.sin_port = htons((Uint16)port);
+    bound.sin_addr.s_addr = inet_addr(address);
+    ServeSocket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int reuse = 1; // restarting the server doesn't have to wait for the old one's connections to time out
+    if (listener != SERVE_NO_SOCKET) setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    if (listener == SERVE_NO_SOCKET || bound.sin_addr.s_addr == INADDR_NONE ||
+        bind(listener, (struct sockaddr*)&bound, sizeof(bound)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        SDL_Log("serve: can't listen on %s port %d", address, port);
+        if (listener != SERVE_NO_SOCKET) closeSocket(listener);
+        return SDL_APP_FAILURE;
+    }
+
+    engineInitTables();
+    server.engine = engineCreate();
+    server.sessions = SDL_calloc((size_t)server.maxSessions, sizeof(ServeSession*));
+    server.maxStandby = SDL_min(server.maxStandby, server.maxSessions);
+    server.standby = SDL_calloc((size_t)server.maxSessions, sizeof(ServeSession*));
+    if (!server.engine || !server.sessions || !server.standby) {
+        SDL_Log("serve: out of memory");
+        engineDestroy(server.engine);
+        SDL_free(server.sessions);
+        SDL_free(server.standby);
+        closeSocket(listener);
+        return SDL_APP_FAILURE;
+    }
+    server.engine->interleave = interleave;
+    server.engine->batchThreads = batchThreads;
+    if (searchLogPath && !engineSearchLogOpen(searchLogPath))
+        SDL_Log("serve: can't open the search log %s, searching without it: %s", searchLogPath, SDL_GetError());
+    if (recordPath && (!(server.record = SDL_IOFromFile(recordPath, "w")) ||
+                       SDL_IOprintf(server.record, "# serve record: ms connection fen<tab>go\n") == 0)) {
+        SDL_Log("serve: can't record to %s, serving without: %s", recordPath, SDL_GetError());
+        if (server.record) SDL_CloseIO(server.record);
+        server.record = NULL;
+    }
+    if (shareName) SDL_strlcpy(server.engine->hashShareName, shareName, sizeof(server.engine->hashShareName));
+    if (!engineSetHash(server.engine, hashMB)) SDL_Log("serve: no memory for %zu MB of hash, searching without it", hashMB);
+    if (server.hashFile && SDL_GetPathInfo(server.hashFile, NULL)) {
+        if (engineLoadHash(server.engine, server.hashFile)) SDL_Log("serve: hash table loaded from %s", server.hashFile);
+        else SDL_Log("serve: can't load the hash from %s, starting empty: %s", server.hashFile, SDL_GetError());
+    }
+    server.hashSavedNS = server.startNS = SDL_GetTicksNS();
+    if (storePath && !(server.store = positionStoreOpen(storePath, storeWritable)))
+        SDL_Log("serve: can't open the position store %s, searching everything: %s", storePath, SDL_GetError());
+    else if (server.store)
+        SDL_Log("serve: position store %s, %zu positions indexed%s", storePath, server.store->indexCount, storeWritable ? "" : ", read-only");
+    if (explorerPath && !(server.explorer = bookOpen(explorerPath)))
+        SDL_Log("serve: no explorer index, explore is refused"); // bookOpen has said why
+    WarmJob* warmJob = warm > 0 && server.store ? SDL_calloc(1, sizeof(WarmJob)) : NULL;
+    if (warmJob) {
+        *warmJob = (WarmJob){ .engine = server.engine, .explorer = server.explorer, .limit = warm };
+        SDL_strlcpy(warmJob->storePath, storePath, sizeof(warmJob->storePath));
+        SDL_Thread* thread = SDL_CreateThread(warm_thread, "warm start", warmJob);
+        if (thread) {
+            SDL_DetachThread(thread); // the server runs until it's killed, so nothing waits for it
+        } else {
+            SDL_Log("serve: no warm start, no thread for it: %s", SDL_GetError());
+            SDL_free(warmJob);
+        }
+    } else if (warm > 0) {
+        SDL_Log("serve: no warm start without a position store (db or dbread)");
+    }
+    while (server.standbyCount < server.maxStandby && (server.standby[server.standbyCount] = serveSessionCreate())) server.standbyCount++;
+    if (!engineStartThreads(threads, false)) SDL_Log("serve: no search threads, searching on the engine thread only");
+    ChessState start = initChessState(); // the request thread and the search contexts made now, not for the first client
+    EngineRequest* warmup = engineSubmit(server.engine, &start, &(SearchLimits){ .depth = 1 }, NULL, NULL, NULL);
+    engineRequestFree(warmup);
+    SDL_Log("serve: listening on %s port %d (%d sessions, %d on standby, %d queued searches, %" SDL_PRIu64 " ms a search)",
+            address, port, server.maxSessions, server.standbyCount, server.maxQueued, server.maxTimeNS / 1000000);
+
+    for (;;) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        ServeSocket highest = listener;
+        for (int i = 0; i < server.sessionCount; i++) {
+            ServeSocket s = server.sessions[i]->socket;
+            if (s == SERVE_NO_SOCKET) continue;
+            FD_SET(s, &readable);
+            if (s > highest) highest = s;
+        }
+        struct timeval wait = { 0, SERVE_POLL_MS * 1000 };
+        if (select((int)highest + 1, &readable, NULL, NULL, &wait) < 0) FD_ZERO(&readable); // interrupted: just poll
+        if (FD_ISSET(listener, &readable)) serveAccept(&server, listener);
+        for (int i = 0; i < server.sessionCount; i++) {
+            ServeSession* session = server.sessions[i];
+            if (session->socket != SERVE_NO_SOCKET && FD_ISSET(session->socket, &readable)) serveRead(&server, session);
+            if (session->request) serveProgress(&server, session);
+            if (session->socket == SERVE_NO_SOCKET && !session->request) {
+                serveSessionGive(&server, session);
+                server.sessions[i--] = server.sessions[--server.sessionCount];
+            }
+        }
+        if (server.hashFile && server.hashChanged && SDL_GetTicksNS() - server.hashSavedNS >= (Uint64)SERVE_HASH_SAVE_MS * 1000000) {
+            if (!engineSaveHash(server.engine, server.hashFile)) SDL_Log("serve: can't save the hash to %s: %s", server.hashFile, SDL_GetError());
+            server.hashSavedNS = SDL_GetTicksNS();
+            server.hashChanged = false;
+        }
+        if (server.store && !storeWritable && SDL_GetTicksNS() - server.storeCheckedNS >= (Uint64)STORE_RELOAD_MS * 1000000) {
+            server.store = positionStoreRefresh(server.store);
+            server.storeCheckedNS = SDL_GetTicksNS();
+        }
+    }
+}
+
+/* Cluster analysis: `main cluster <address:port>[,<address:port>...] [depth N] [fen]` searches one position on
+   `serve` servers running on other machines, this process keeping only the root. It deepens one iteration at a
+   time; in each one every root move is a search of the position after it to a ply less, on whichever node is free
+   (position fen <root> moves <move>, go depth N), and the root's score is the best of the negated answers. The
+   moves go out best first, the last iteration's order, and each to the node that searched it last time when that
+   one is free: a server's hash table outlasts its searches, so a node comes to hold the earlier iterations of its
+   own moves, and the nodes' tables together cover the tree rather than each repeating the others'. A node that
+   goes away gives its move back to the others; one that's busy ("error busy") has it tried again later. Each
+   iteration ends in an info line much like UCI's, the last in a bestmove. Addresses, as for serve, are IPv4. */
+#define CLUSTER_NODES_MAX 64
+#define CLUSTER_DEPTH 12
+#define CLUSTER_RETRY_MS 100 // before a busy node is given work again
+
+typedef struct {
+    ServeSocket socket;     // SERVE_NO_SOCKET once it's gone
+    char name[32];
+    char input[UCI_LINE_MAX];
+    size_t inputLength;
+    int task;               // the root move it's searching, by index, -1 for none
+    int score;              // the task's last info line, for the side to move after it
+    Uint64 nodes;
+    Uint64 busyUntilNS;     // refused a search: none before this
+} ClusterNode;
+
+typedef struct {
+    Move move;
+    int score;              // the root's side's, this iteration once done, else the last
+    int node;               // searched by, the last time; -1 for none yet
+    bool assigned, done;
+    bool final;             // mate or stalemate: scored here, never sent
+    Uint64 nodes;
+} ClusterMove;
+
+// info and bestmove lines from a host scores come from the position after the move, so they're turned round here
+static int clusterScore(const char* info) {
+    const char* cp = SDL_strstr(info, " score cp ");
+    const char* mate = SDL_strstr(info, " score mate ");
+    if (cp) return SDL_atoi(cp + 10);
+    if (!mate) return 0;
+    int moves = SDL_atoi(mate + 12); // as mateInMoves wrote it
+    return moves > 0 ? MATE_SCORE - (2 * moves - 1) : -(MATE_SCORE + 2 * moves);
+}
+
+static int clusterRootScore(int childScore) {
+    int score = -childScore;
+    if (score >= MATE_BOUND) score--; // a ply further off, from the root
+    else if (score <= -MATE_BOUND) score++;
+    return score;
+}
+
+static ClusterNode* clusterConnect(const char* address, int port) {
+    struct sockaddr_in host;
+    SDL_memset(&host, 0, sizeof(host));
+    host.sin_family = AF_INET;
+    host.sin_port = htons((Uint16)port);
+    host.sin_addr.s_addr = inet_addr(address);
+    ServeSocket s = host.sin_addr.s_addr == INADDR_NONE ? SERVE_NO_SOCKET : socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == SERVE_NO_SOCKET || connect(s, (struct sockaddr*)&host, sizeof(host)) != 0) {
+        SDL_Log("cluster: can't reach %s port %d", address, port);
+        if (s != SERVE_NO_SOCKET) closeSocket(s);
+        return NULL;
+    }
+    ClusterNode* node = SDL_calloc(1, sizeof(ClusterNode));
+    if (!node) { closeSocket(s); return NULL; }
+#if !defined(_WIN32)
+    if (s >= FD_SETSIZE) { closeSocket(s); SDL_free(node); return NULL; } // select() can't watch it
+#endif
+    node->socket = s;
+    node->task = -1;
+    SDL_snprintf(node->name, sizeof(node->name), "%s:%d", address, port);
+    return node;
+}
+
+// every node of a comma-separated list that answers, up to CLUSTER_NODES_MAX; the port is SERVE_PORT when not given
+static int clusterConnectAll(const char* list, ClusterNode** nodes) {
+    int count = 0;
+    char* hosts = SDL_strdup(list);
+    char* save = NULL;
+    for (char* host = hosts ? SDL_strtok_r(hosts, ",", &save) : NULL; host && count < CLUSTER_NODES_MAX;
+         host = SDL_strtok_r(NULL, ",", &save)) {
+        char* colon = SDL_strrchr(host, ':');
+        int port = colon ? SDL_atoi(colon + 1) : SERVE_PORT;
+        if (colon) *colon = '\0';
+        ClusterNode* node = clusterConnect(host, SDL_clamp(port, 1, 65535));
+        if (node) nodes[count++] = node;
+    }
+    SDL_free(hosts);
+    return count;
+}
+
+static void clusterHangUp(ClusterNode* node, const char* command) {
+    SDL_Log("%s: lost %s", command, node->name);
+    closeSocket(node->socket);
+    node->socket = SERVE_NO_SOCKET;
+}
+
+static void clusterDrop(ClusterNode* node, ClusterMove* moves) {
+    clusterHangUp(node, "cluster");
+    if (node->task >= 0) moves[node->task].assigned = false;
+    node->task = -1;
+}
+
+static bool clusterSend(ClusterNode* node, const char* text) {
+    for (size_t length = SDL_strlen(text); length > 0;) {
+        int sent = (int)send(node->socket, text, (int)length, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        text += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+// the next move for a free node: one of its own from the last iteration, else the first nobody has
+static int clusterNextTask(const ClusterMove* moves, int count, int nodeIndex) {
+    int any = -1;
+    for (int i = 0; i < count; i++) {
+        if (moves[i].assigned || moves[i].done) continue;
+        if (moves[i].node == nodeIndex) return i;
+        if (any < 0) any = i;
+    }
+    return any;
+}
+
+// one line from a node: an iteration of its task, the answer to it, or a refusal
+static void clusterLine(void* context, ClusterNode* node, char* line) {
+    ClusterMove* moves = context;
+    if (node->task < 0) return;
+    ClusterMove* task = &moves[node->task];
+    if (SDL_strncmp(line, "info ", 5) == 0) {
+        node->score = clusterScore(line);
+        const char* nodes = SDL_strstr(line, " nodes ");
+        if (nodes) node->nodes = SDL_strtoull(nodes + 7, NULL, 10);
+    } else if (SDL_strncmp(line, "bestmove", 8) == 0) {
+        task->score = clusterRootScore(node->score);
+        task->nodes = node->nodes;
+        task->done = true;
+        node->task = -1;
+    } else if (SDL_strncmp(line, "error", 5) == 0) { // busy, most likely: someone else can have it
+        if (SDL_strstr(line, "busy")) node->busyUntilNS = SDL_GetTicksNS() + (Uint64)CLUSTER_RETRY_MS * 1000000;
+        else SDL_Log("cluster: %s: %s", node->name, line);
+        task->assigned = false;
+        node->task = -1;
+    }
+}
+
+// what a node has sent, each whole line to `line`; false once it has hung up
+static bool clusterRead(ClusterNode* node, void (*line)(void* context, ClusterNode* node, char* text), void* context) {
+    size_t room = sizeof(node->input) - node->inputLength;
+    int received = (int)recv(node->socket, node->input + node->inputLength, (int)room, 0);
+    if (received <= 0) return false;
+    node->inputLength += (size_t)received;
+    char* start = node->input;
+    char* end = node->input + node->inputLength;
+    for (char* newline; (newline = memchr(start, '\n', (size_t)(end - start)));) {
+        *newline = '\0';
+        if (newline > start && newline[-1] == '\r') newline[-1] = '\0';
+        line(context, node, start);
+        start = newline + 1;
+    }
+    node->inputLength = (size_t)(end - start);
+    SDL_memmove(node->input, start, node->inputLength);
+    if (node->inputLength == sizeof(node->input)) node->inputLength = 0; // a line too long to be one of ours
+    return true;
+}
+
+// the nodes still there with something to read, after waiting up to SERVE_POLL_MS for one
+static void clusterPoll(ClusterNode** nodes, int count, fd_set* readable) {
+    FD_ZERO(readable);
+    ServeSocket highest = 0;
+    for (int n = 0; n < count; n++) {
+        if (nodes[n]->socket == SERVE_NO_SOCKET) continue;
+        FD_SET(nodes[n]->socket, readable);
+        if (nodes[n]->socket > highest) highest = nodes[n]->socket;
+    }
+    struct timeval wait = { 0, SERVE_POLL_MS * 1000 };
+    if (select((int)highest + 1, readable, NULL, NULL, &wait) < 0) FD_ZERO(readable);
+}
+
+static void clusterQuit(ClusterNode** nodes, int count) {
+    for (int n = 0; n < count; n++) {
+        if (nodes[n]->socket != SERVE_NO_SOCKET) {
+            clusterSend(nodes[n], "quit\n");
+            closeSocket(nodes[n]->socket);
+        }
+        SDL_free(nodes[n]);
+    }
+}
+
+// every move of the iteration onto the nodes and back; false once there are no nodes left
+static bool clusterIteration(ClusterNode** nodes, int nodeCount, ClusterMove* moves, int count, const char* fen, int depth) {
+    for (int i = 0; i < count; i++) {
+        moves[i].assigned = false;
+        moves[i].done = moves[i].final;
+    }
+    for (int finished = 0; finished < count;) {
+        int alive = 0;
+        Uint64 now = SDL_GetTicksNS();
+        for (int n = 0; n < nodeCount; n++) {
+            ClusterNode* node = nodes[n];
+            if (node->socket == SERVE_NO_SOCKET) continue;
+            alive++;
+            if (node->task >= 0 || now < node->busyUntilNS) continue;
+            int task = clusterNextTask(moves, count, n);
+            if (task < 0) continue;
+            char move[6], text[FEN_MAX + 64];
+            moveToCoordinates(moves[task].move, move);
+            SDL_snprintf(text, sizeof(text), "position fen %s moves %s\ngo depth %d\n", fen, move, SDL_max(depth - 1, 1));
+            node->task = task;
+            node->score = 0;
+            node->nodes = 0;
+            moves[task].assigned = true;
+            moves[task].node = n;
+            if (!clusterSend(node, text)) clusterDrop(node, moves);
+        }
+        if (alive == 0) return false;
+        fd_set readable;
+        clusterPoll(nodes, nodeCount, &readable);
+        for (int n = 0; n < nodeCount; n++)
+            if (nodes[n]->socket != SERVE_NO_SOCKET && FD_ISSET(nodes[n]->socket, &readable) &&
+                !clusterRead(nodes[n], clusterLine, moves))
+                clusterDrop(nodes[n], moves);
+        finished = 0;
+        for (int i = 0; i < count; i++) finished += moves[i].done;
+    }
+    return true;
+}
+
+static SDL_AppResult runClusterCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s cluster <address:port>[,<address:port>...] [depth N] [fen]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    int depth = CLUSTER_DEPTH, i = 3;
+    for (; i + 1 < argc && SDL_strcmp(argv[i], "depth") == 0; i += 2) depth = SDL_clamp(SDL_atoi(argv[i + 1]), 1, MOVE_DEPTH);
+    char fen[FEN_MAX] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    if (i < argc) {
+        fen[0] = '\0';
+        for (int first = i; i < argc; i++) {
+            if (i > first) SDL_strlcat(fen, " ", sizeof(fen));
+            SDL_strlcat(fen, argv[i], sizeof(fen));
+        }
+    }
+    engineInitTables();
+    ChessState chess = initChessState();
+    if (!loadFen(&chess, fen)) {
+        SDL_Log("cluster: bad FEN: %s", fen);
+        return SDL_APP_FAILURE;
+    }
+    MoveList legal;
+    getAllMoves(&chess, &legal);
+    if (legal.count == 0) {
+        SDL_Log("cluster: no legal moves in %s", fen);
+        return SDL_APP_FAILURE;
+    }
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) { SDL_Log("cluster: no sockets"); return SDL_APP_FAILURE; }
+#endif
+    ClusterNode* nodes[CLUSTER_NODES_MAX];
+    int nodeCount = clusterConnectAll(argv[2], nodes);
+    if (nodeCount == 0) {
+        SDL_Log("cluster: no nodes to search on");
+        return SDL_APP_FAILURE;
+    }
+    SDL_Log("cluster: %d nodes, %d root moves, depth %d", nodeCount, legal.count, depth);
+    writeFen(&chess, fen, sizeof(fen)); // as the nodes are to read it
+
+    ClusterMove moves[SDL_arraysize(legal.moves)];
+    for (int m = 0; m < legal.count; m++) {
+        moves[m] = (ClusterMove){ .move = legal.moves[m], .node = -1 };
+        UndoInfo undo;
+        makeMove(&chess, legal.moves[m], &undo);
+        if (countLegalMoves(&chess) == 0) {
+            moves[m].final = true;
+            moves[m].score = isKingInCheck(&chess, chess.whiteToMove) ? MATE_SCORE - 1 : 0;
+        }
+        unmakeMove(&chess, legal.moves[m], &undo);
+    }
+    Uint64 start = SDL_GetTicksNS(), totalNodes = 0;
+    int done = 0;
+    for (int d = 1; d <= depth; d++) {
+        if (!clusterIteration(nodes, nodeCount, moves, legal.count, fen, d)) {
+            SDL_Log("cluster: every node has gone, stopping at depth %d", done);
+            break;
+        }
+        for (int a = 1; a < legal.count; a++) // best first, equal scores kept in the order they had
+            for (int b = a; b > 0 && moves[b].score > moves[b - 1].score; b--) {
+                ClusterMove swap = moves[b];
+                moves[b] = moves[b - 1];
+                moves[b - 1] = swap;
+            }
+        for (int m = 0; m < legal.count; m++) totalNodes += moves[m].nodes;
+        done = d;
+        Uint64 ms = (SDL_GetTicksNS() - start) / 1000000;
+        char move[6];
+        moveToCoordinates(moves[0].move, move);
+        int score = moves[0].score;
+        if (abs(score) >= MATE_BOUND) printf("info depth %d score mate %d", d, mateInMoves(score));
+        else printf("info depth %d score cp %d", d, score);
+        printf(" nodes %" SDL_PRIu64 " nps %" SDL_PRIu64 " time %" SDL_PRIu64 " pv %s\n", totalNodes,
+               ms > 0 ? totalNodes * 1000 / ms : 0, ms, move);
+        fflush(stdout);
+        int mateDistance = MATE_SCORE - abs(score);
+        if (abs(score) >= MATE_BOUND && mateDistance <= d) break; // found within full depth, nothing shorter left
+    }
+    char move[6] = "0000";
+    if (done > 0) moveToCoordinates(moves[0].move, move);
+    printf("bestmove %s\n", move);
+    clusterQuit(nodes, nodeCount);
+    return done > 0 ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+}
+
+/* Distributed batch analysis: `main farm <file> <address:port>[,<address:port>...] out FILE [checkpoint FILE]
+   [unit N] [depth N] [nodes N]` analyses a FEN/EPD or PGN file as `main batch` does, but on `serve` servers on
+   other machines. The positions are cut into work units of `unit` each, and a node is handed a unit at a time,
+   its positions searched one after another; a server takes any number of connections, so naming a host twice
+   keeps its queue fed. A finished unit's results go to the end of the output, in the input's order within the
+   unit, and then its number to the checkpoint file (FILE.done by default); a run given the same output and
+   checkpoint again skips the units it lists, so a coordinator that dies loses no finished work and a node that
+   does loses only the unit it had, which goes to the next node free. Result lines are batch's EPD: acd, acn, ce
+   (or dm) and pm added, and PGN positions given an id naming game and ply. The servers keep their hash tables
+   from one search to the next, so unlike batch's the results depend a little on which node had which unit. */
+#define FARM_UNIT 64
+#define FARM_PROGRESS_MS 10000
+
+typedef struct {
+    char** lines;           // the positions, as EPD lines
+    int count, capacity;
+    bool failed;            // a line that isn't a position, or an illegal move in a game: logged and left out
+    bool outOfMemory;
+} FarmInput;
+
+typedef struct {
+    int position;           // the unit's position being searched, from its first
+    bool searching;         // sent, and not yet answered
+    int depth;              // the search's last info line
+    char* results;          // the unit's result lines so far
+    size_t resultsLength, resultsCapacity;
+} FarmWorker;
+
+static bool farmAddLine(FarmInput* input, const char* text, size_t length) {
+    if (input->count == input->capacity) {
+        int capacity = input->capacity ? input->capacity * 2 : 1024;
+        char** lines = SDL_realloc(input->lines, sizeof(char*) * (size_t)capacity);
+        if (!lines) return false;
+        input->lines = lines;
+        input->capacity = capacity;
+    }
+    char* line = SDL_malloc(length + 1);
+    if (!line) return false;
+    SDL_memcpy(line, text, length);
+    line[length] = '\0';
+    input->lines[input->count++] = line;
+    return true;
+}
+
+static void farmPgnPosition(void* context, const ChessState* position, Move move, int game, int ply, int result) {
+    FarmInput* input = context;
+    (void)move, (void)result;
+    char line[FEN_MAX + 48];
+    int length = writeFen(position, line, sizeof(line));
+    length += SDL_snprintf(line + length, sizeof(line) - (size_t)length, " id \"game %d ply %d\";", game, ply);
+    if (!farmAddLine(input, line, (size_t)length)) input->outOfMemory = true;
+}
+
+// every position of the file, EPD or (by the extension) PGN, as a line to send and to write the result after;
+// false when it can't be read
+static bool farmReadInput(const char* path, FarmInput* input) {
+    MappedFile file;
+    if (!mapFile(&file, path)) {
+        SDL_Log("farm: can't read %s: %s", path, SDL_GetError());
+        return false;
+    }
+    const char* p = file.data;
+    const char* end = p + file.size;
+    size_t nameLength = SDL_strlen(path);
+    if (nameLength >= 4 && SDL_strcasecmp(path + nameLength - 4, ".pgn") == 0) {
+        if (!readPgnGames(p, end, farmPgnPosition, input)) input->failed = true;
+    } else {
+        for (int number = 1; p < end; number++) {
+            const char* eol = memchr(p, '\n', (size_t)(end - p));
+            const char* last = eol ? eol : end;
+            const char* next = eol ? eol + 1 : end;
+            while (last > p && (last[-1] == '\r' || last[-1] == ' ' || last[-1] == '\t')) last--;
+            while (p < last && (*p == ' ' || *p == '\t')) p++;
+            if (p < last && *p != '#') {
+                char line[BATCH_LINE_MAX];
+                SDL_strlcpy(line, p, SDL_min((size_t)(last - p) + 1, sizeof(line)));
+                ChessState chess = initChessState();
+                if (!loadFen(&chess, line)) {
+                    SDL_Log("farm: line %d: bad FEN or EPD: %s", number, line);
+                    input->failed = true;
+                } else if (!farmAddLine(input, line, SDL_strlen(line))) {
+                    input->outOfMemory = true;
+                    break;
+                }
+            }
+            p = next;
+        }
+    }
+    unmapFile(&file);
+    if (input->outOfMemory) SDL_Log("farm: out of memory after %d positions", input->count);
+    return !input->outOfMemory;
+}
+
+// the units the checkpoint says are done, marked in `done`; false when it was written for another input or unit size
+static bool farmReadCheckpoint(const char* path, int positions, int unit, Uint8* done, int* doneCount) {
+    size_t size;
+    char* text = SDL_LoadFile(path, &size);
+    if (!text) return true; // a new run
+    int checkedPositions = -1, checkedUnit = -1;
+    bool ok = SDL_sscanf(text, "farm positions %d unit %d", &checkedPositions, &checkedUnit) == 2 &&
+              checkedPositions == positions && checkedUnit == unit;
+    if (!ok) SDL_Log("farm: %s isn't a checkpoint of %d positions in units of %d", path, positions, unit);
+    int units = (positions + unit - 1) / unit;
+    for (char* line = SDL_strchr(text, '\n'); ok && line; line = SDL_strchr(line + 1, '\n')) {
+        int number;
+        if (SDL_sscanf(line + 1, "unit %d", &number) == 1 && number >= 0 && number < units && !done[number]) {
+            done[number] = 1;
+            ++*doneCount;
+        }
+    }
+    SDL_free(text);
+    return ok;
+}
+
+static bool farmAppend(FarmWorker* worker, const char* text, size_t length) {
+    if (worker->resultsLength + length > worker->resultsCapacity) {
+        size_t capacity = SDL_max(worker->resultsCapacity * 2, worker->resultsLength + length + 4096);
+        char* results = SDL_realloc(worker->results, capacity);
+        if (!results) return false;
+        worker->results = results;
+        worker->resultsCapacity = capacity;
+    }
+    SDL_memcpy(worker->results + worker->resultsLength, text, length);
+    worker->resultsLength += length;
+    return true;
+}
+
+typedef struct {
+    FarmInput* input;
+    FarmWorker* workers;    // by node
+    ClusterNode** nodes;
+    int unit;
+    Uint8* units;           // 0 waiting, 1 handed out, 2 done
+    bool failed;
+} FarmState;
+
+// a node's search answered: the result line after the position's own
+static void farmResult(FarmState* farm, ClusterNode* node, FarmWorker* worker, const char* bestmove) {
+    const char* line = farm->input->lines[node->task * farm->unit + worker->position];
+    const char* operations;
+    size_t fieldsLength = epdPositionFields(line, line + SDL_strlen(line), &operations);
+    char text[BATCH_LINE_MAX + 96];
+    int length = SDL_snprintf(text, sizeof(text), "%.*s%s%s acd %d; acn %" SDL_PRIu64 ";", (int)fieldsLength, line,
+                              *operations ? " " : "", operations, worker->depth, node->nodes);
+    int score = node->score;
+    if (worker->depth > 0)
+        length += SDL_snprintf(text + length, sizeof(text) - (size_t)length, abs(score) >= MATE_BOUND ? " dm %d;" : " ce %d;",
+                               abs(score) >= MATE_BOUND ? mateInMoves(score) : score);
+    if (SDL_strcmp(bestmove, "0000") != 0) length += SDL_snprintf(text + length, sizeof(text) - (size_t)length, " pm %s;", bestmove);
+    length = SDL_min(length, (int)sizeof(text) - 2);
+    text[length++] = '\n';
+    if (!farmAppend(worker, text, (size_t)length)) farm->failed = true;
+    worker->position++;
+    worker->searching = false;
+}
+
+// one line from a node: an iteration of the position it's searching, the answer, or a refusal
+static void farmLine(void* context, ClusterNode* node, char* line) {
+    FarmState* farm = context;
+    int n = 0;
+    while (farm->nodes[n] != node) n++;
+    FarmWorker* worker = &farm->workers[n];
+    if (node->task < 0 || !worker->searching) return;
+    if (SDL_strncmp(line, "info ", 5) == 0) {
+        worker->depth = SDL_atoi(line + 11); // "info depth "
+        node->score = clusterScore(line);
+        const char* nodes = SDL_strstr(line, " nodes ");
+        if (nodes) node->nodes = SDL_strtoull(nodes + 7, NULL, 10);
+    } else if (SDL_strncmp(line, "bestmove ", 9) == 0) {
+        farmResult(farm, node, worker, line + 9);
+    } else if (SDL_strstr(line, "error") == line && SDL_strstr(line, "busy")) { // the same position again later
+        node->busyUntilNS = SDL_GetTicksNS() + (Uint64)CLUSTER_RETRY_MS * 1000000;
+        worker->searching = false;
+    } else if (SDL_strncmp(line, "error", 5) == 0) { // not a server to trust with the rest of the unit
+        SDL_Log("farm: %s: %s", node->name, line);
+        clusterHangUp(node, "farm");
+    }
+}
+
+// the node's unit, half done or not, back to the others
+static void farmDrop(FarmState* farm, ClusterNode* node, FarmWorker* worker) {
+    if (node->socket != SERVE_NO_SOCKET) clusterHangUp(node, "farm");
+    if (node->task >= 0) farm->units[node->task] = 0;
+    node->task = -1;
+    worker->searching = false;
+    worker->resultsLength = 0;
+}
+
+static SDL_AppResult runFarmCommand(int argc, char* argv[]) {
+    if (argc < 4) {
+        SDL_Log("usage: %s farm <file> <address:port>[,<address:port>...] out FILE [checkpoint FILE] [unit N] [depth N] "
+                "[nodes N]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    const char* outPath = NULL;
+    const char* checkpointPath = NULL;
+    int unit = FARM_UNIT, depth = 0;
+    Uint64 nodeLimit = 0;
+    for (int i = 4; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (SDL_strcmp(argv[i], "out") == 0) outPath = value;
+        else if (SDL_strcmp(argv[i], "checkpoint") == 0) checkpointPath = value;
+        else if (SDL_strcmp(argv[i], "unit") == 0) unit = SDL_max(SDL_atoi(value), 1);
+        else if (SDL_strcmp(argv[i], "depth") == 0) depth = SDL_clamp(SDL_atoi(value), 1, MOVE_DEPTH);
+        else if (SDL_strcmp(argv[i], "nodes") == 0) nodeLimit = SDL_strtoull(value, NULL, 10);
+        else { SDL_Log("farm: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    if (!outPath) {
+        SDL_Log("farm: no output file (out FILE)");
+        return SDL_APP_FAILURE;
+    }
+    char defaultCheckpoint[1024];
+    if (!checkpointPath) {
+        SDL_snprintf(defaultCheckpoint, sizeof(defaultCheckpoint), "%s.done", outPath);
+        checkpointPath = defaultCheckpoint;
+    }
+    char go[64] = "go";
+    if (nodeLimit > 0) SDL_snprintf(go + 2, sizeof(go) - 2, " nodes %" SDL_PRIu64, nodeLimit);
+    if (depth > 0 || nodeLimit == 0) SDL_snprintf(go + SDL_strlen(go), sizeof(go) - SDL_strlen(go), " depth %d", depth ? depth : BATCH_DEPTH);
+    SDL_strlcat(go, "\n", sizeof(go));
+
+    engineInitTables();
+    FarmInput input = { 0 };
+    ClusterNode* nodes[CLUSTER_NODES_MAX];
+    FarmWorker workers[CLUSTER_NODES_MAX] = { 0 };
+    FarmState farm = { .input = &input, .workers = workers, .nodes = nodes, .unit = unit };
+    SDL_IOStream* out = NULL;
+    SDL_IOStream* checkpoint = NULL;
+    int nodeCount = 0, doneCount = 0;
+    SDL_AppResult result = SDL_APP_FAILURE;
+    if (!farmReadInput(argv[2], &input)) goto done;
+    int units = (input.count + unit - 1) / unit;
+    farm.units = SDL_calloc((size_t)SDL_max(units, 1), 1);
+    if (!farm.units || !farmReadCheckpoint(checkpointPath, input.count, unit, farm.units, &doneCount)) goto done;
+    bool resumed = SDL_GetPathInfo(checkpointPath, NULL);
+    out = SDL_IOFromFile(outPath, resumed ? "ab" : "wb");
+    checkpoint = SDL_IOFromFile(checkpointPath, "ab");
+    if (!out || !checkpoint) {
+        SDL_Log("farm: can't write %s: %s", !out ? outPath : checkpointPath, SDL_GetError());
+        goto done;
+    }
+    if (!resumed) SDL_IOprintf(checkpoint, "farm positions %d unit %d\n", input.count, unit);
+    SDL_FlushIO(checkpoint);
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) { SDL_Log("farm: no sockets"); goto done; }
+#endif
+    nodeCount = clusterConnectAll(argv[3], nodes);
+    if (nodeCount == 0) {
+        SDL_Log("farm: no nodes to search on");
+        goto done;
+    }
+    SDL_Log("farm: %d positions in %d units, %d done already, on %d nodes", input.count, units, doneCount, nodeCount);
+
+    Uint64 start = SDL_GetTicksNS(), reported = start;
+    int startDone = doneCount, nextUnit = 0;
+    while (doneCount < units && !farm.failed) {
+        int alive = 0;
+        Uint64 now = SDL_GetTicksNS();
+        for (int n = 0; n < nodeCount; n++) {
+            ClusterNode* node = nodes[n];
+            FarmWorker* worker = &workers[n];
+            if (node->socket == SERVE_NO_SOCKET) {
+                if (node->task >= 0) farmDrop(&farm, node, worker);
+                continue;
+            }
+            alive++;
+            if (node->task >= 0 && worker->position == SDL_min(unit, input.count - node->task * unit)) {
+                // the unit's done: its results out, then its number, so a crash between the two only repeats it
+                bool written = SDL_WriteIO(out, worker->results, worker->resultsLength) == worker->resultsLength &&
+                               SDL_FlushIO(out) && SDL_IOprintf(checkpoint, "unit %d\n", node->task) > 0 && SDL_FlushIO(checkpoint);
+                if (!written) {
+                    SDL_Log("farm: can't write the results: %s", SDL_GetError());
+                    farm.failed = true;
+                    break;
+                }
+                farm.units[node->task] = 2;
+                doneCount++;
+                node->task = -1;
+            }
+            if (node->task < 0) { // the next unit nobody has
+                for (int tried = 0; tried < units && node->task < 0; tried++, nextUnit = (nextUnit + 1) % units)
+                    if (farm.units[nextUnit] == 0) node->task = nextUnit;
+                if (node->task < 0) continue;
+                farm.units[node->task] = 1;
+                worker->position = 0;
+                worker->resultsLength = 0;
+            }
+            if (worker->searching || now < node->busyUntilNS) continue;
+            ChessState chess = initChessState();
+            char fen[FEN_MAX], text[FEN_MAX + 96];
+            loadFen(&chess, input.lines[node->task * unit + worker->position]);
+            writeFen(&chess, fen, sizeof(fen));
+            SDL_snprintf(text, sizeof(text), "position fen %s\n%s", fen, go);
+            worker->searching = true;
+            worker->depth = 0;
+            node->score = 0;
+            node->nodes = 0;
+            if (!clusterSend(node, text)) farmDrop(&farm, node, worker);
+        }
+        if (alive == 0) {
+            SDL_Log("farm: every node has gone; %d of %d units done, run again to go on", doneCount, units);
+            break;
+        }
+        fd_set readable;
+        clusterPoll(nodes, nodeCount, &readable);
+        for (int n = 0; n < nodeCount; n++)
+            if (nodes[n]->socket != SERVE_NO_SOCKET && FD_ISSET(nodes[n]->socket, &readable) &&
+                !clusterRead(nodes[n], farmLine, &farm))
+                farmDrop(&farm, nodes[n], &workers[n]);
+        if (SDL_GetTicksNS() - reported >= (Uint64)FARM_PROGRESS_MS * 1000000) {
+            reported = SDL_GetTicksNS();
+            double seconds = (double)(reported - start) / 1e9;
+            SDL_Log("farm: %d of %d units done (%.1f units/s)", doneCount, units, (doneCount - startDone) / seconds);
+        }
+    }
+    if (doneCount == units) {
+        SDL_Log("farm: all %d positions done in %.3f s", input.count, (double)(SDL_GetTicksNS() - start) / 1e9);
+        result = input.failed ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+    }
+done:
+    clusterQuit(nodes, nodeCount);
+    for (int n = 0; n < nodeCount; n++) SDL_free(workers[n].results);
+    if (checkpoint) SDL_CloseIO(checkpoint);
+    if (out) SDL_CloseIO(out);
+    SDL_free(farm.units);
+    for (int i = 0; i < input.count; i++) SDL_free(input.lines[i]);
+    SDL_free(input.lines);
+    return result;
+}
+
+/* Load test: `main loadtest <file> [address A] [port N] [clients N] [speed X]` plays a record `serve record` made
+   back against a server (the one on this machine's SERVE_PORT unless told otherwise), over `clients` connections
+   (LOADTEST_CLIENTS) at once. Each go is sent when its time in the record comes round, the record's pace times
+   `speed`; speed 0 sends each as soon as a connection is free, which finds the most a server can answer. A go
+   goes on the connection its own was (by number, modulo the clients) when that one is free, else on any free
+   one, and waits when none is. Its latency is from when it was due to its bestmove, so the time spent waiting
+   for a connection counts, as it would for a client; at the end come the throughput and the latency percentiles,
+   and the gos refused as busy or lost with a connection. Positions go as FENs, so the server sees no game before
+   them, and its hash table is warm from whatever it searched last. */
+#define LOADTEST_CLIENTS 8
+#define LOADTEST_PROGRESS_MS 5000
+
+typedef struct {
+    Uint64 atMS;            // into the recording
+    Uint64 connection;
+    const char* fen;
+    const char* go;         // the go's arguments
+} LoadRequest;
+
+typedef struct {
+    LoadRequest* requests;
+    int count;
+    Uint64* dueNS;          // by request, once sent
+    double* latencies;      // ms, of the answered
+    int answered, refused, failed;
+} LoadTest;
+
+static void loadTestLine(void* context, ClusterNode* node, char* line) {
+    LoadTest* test = context;
+    if (node->task < 0) return;
+    if (SDL_strncmp(line, "bestmove", 8) == 0) {
+        test->latencies[test->answered++] = (double)(SDL_GetTicksNS() - test->dueNS[node->task]) / 1e6;
+        node->task = -1;
+    } else if (SDL_strncmp(line, "error", 5) == 0) {
+        if (SDL_strstr(line, "busy")) test->refused++;
+        else test->failed++;
+        node->task = -1;
+    }
+}
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// the record's lines, in place in text; false on a line that isn't one
+static bool loadTestParse(char* text, LoadTest* test) {
+    int lines = 1;
+    for (const char* p = text; *p; p++) lines += *p == '\n';
+    test->requests = SDL_calloc((size_t)lines, sizeof(LoadRequest));
+    if (!test->requests) return false;
+    char* save = NULL;
+    for (char* line = SDL_strtok_r(text, "\r\n", &save); line; line = SDL_strtok_r(NULL, "\r\n", &save)) {
+        if (line[0] == '#') continue;
+        LoadRequest* r = &test->requests[test->count];
+        char* end;
+        r->atMS = SDL_strtoull(line, &end, 10);
+        r->connection = SDL_strtoull(end, &end, 10);
+        char* tab = SDL_strchr(end, '\t');
+        if (end == line || !tab) { SDL_Log("loadtest: not a recorded go: %.80s", line); return false; }
+        *tab = '\0';
+        while (*end == ' ') end++;
+        r->fen = end;
+        r->go = tab + 1;
+        test->count++;
+    }
+    return true;
+}
+
+static SDL_AppResult runLoadTestCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        SDL_Log("usage: %s loadtest FILE [address A] [port N] [clients N] [speed X]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    const char* address = "127.0.0.1";
+    int port = SERVE_PORT, clients = LOADTEST_CLIENTS;
+    double speed = 1;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const char* value = argv[i + 1];
+        if (SDL_strcmp(argv[i], "address") == 0) address = value;
+        else if (SDL_strcmp(argv[i], "port") == 0) port = SDL_clamp(SDL_atoi(value), 1, 65535);
+        else if (SDL_strcmp(argv[i], "clients") == 0) clients = SDL_clamp(SDL_atoi(value), 1, CLUSTER_NODES_MAX);
+        else if (SDL_strcmp(argv[i], "speed") == 0) speed = SDL_max(SDL_atof(value), 0.0);
+        else { SDL_Log("loadtest: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    char* text = SDL_LoadFile(argv[2], NULL);
+    if (!text) { SDL_Log("loadtest: can't read %s: %s", argv[2], SDL_GetError()); return SDL_APP_FAILURE; }
+    LoadTest test = { 0 };
+    SDL_AppResult result = SDL_APP_FAILURE;
+    ClusterNode* nodes[CLUSTER_NODES_MAX];
+    int nodeCount = 0;
+    if (!loadTestParse(text, &test)) goto done;
+    test.dueNS = SDL_calloc((size_t)test.count + 1, sizeof(Uint64));
+    test.latencies = SDL_calloc((size_t)test.count + 1, sizeof(double));
+    if (!test.dueNS || !test.latencies) { SDL_Log("loadtest: out of memory"); goto done; }
+#if defined(_WIN32)
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) { SDL_Log("loadtest: no sockets"); goto done; }
+#endif
+    while (nodeCount < clients && (nodes[nodeCount] = clusterConnect(address, port))) {
+        int noDelay = 1;
+        setsockopt(nodes[nodeCount]->socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+        nodeCount++;
+    }
+    if (nodeCount < clients) {
+        SDL_Log("loadtest: %d of %d connections to %s port %d", nodeCount, clients, address, port);
+        if (nodeCount == 0) goto done;
+    }
+    SDL_Log("loadtest: %d searches over %d connections at %g times the recorded pace", test.count, nodeCount, speed);
+
+    Uint64 start = SDL_GetTicksNS(), reported = start, firstMS = test.count > 0 ? test.requests[0].atMS : 0;
+    int next = 0, connected = nodeCount;
+    for (;;) {
+        Uint64 now = SDL_GetTicksNS();
+        bool waiting = false;
+        for (int n = 0; n < nodeCount; n++) waiting = waiting || (nodes[n]->socket != SERVE_NO_SOCKET && nodes[n]->task >= 0);
+        if ((next == test.count && !waiting) || connected == 0) break;
+        while (next < test.count) {
+            const LoadRequest* r = &test.requests[next];
+            Uint64 due = speed > 0 ? start + (Uint64)((double)(r->atMS - SDL_min(r->atMS, firstMS)) * 1e6 / speed) : now;
+            if (due > now) break;
+            ClusterNode* node = nodes[r->connection % (Uint64)nodeCount];
+            for (int n = 0; n < nodeCount && (node->socket == SERVE_NO_SOCKET || node->task >= 0); n++) node = nodes[n];
+            if (node->socket == SERVE_NO_SOCKET || node->task >= 0) break; // every connection busy
+            char line[UCI_LINE_MAX];
+            SDL_snprintf(line, sizeof(line), "position fen %s\ngo %s\n", r->fen, r->go);
+            test.dueNS[next] = due;
+            if (!clusterSend(node, line)) {
+                clusterHangUp(node, "loadtest");
+                connected--;
+                continue; // tried on another
+            }
+            node->task = next++;
+        }
+        fd_set readable;
+        clusterPoll(nodes, nodeCount, &readable);
+        for (int n = 0; n < nodeCount; n++)
+            if (nodes[n]->socket != SERVE_NO_SOCKET && FD_ISSET(nodes[n]->socket, &readable) &&
+                !clusterRead(nodes[n], loadTestLine, &test)) {
+                clusterHangUp(nodes[n], "loadtest");
+                connected--;
+                if (nodes[n]->task >= 0) test.failed++;
+                nodes[n]->task = -1;
+            }
+        if (SDL_GetTicksNS() - reported >= (Uint64)LOADTEST_PROGRESS_MS * 1000000) {
+            reported = SDL_GetTicksNS();
+            SDL_Log("loadtest: %d of %d sent, %d answered", next, test.count, test.answered);
+        }
+    }
+    double seconds = (double)(SDL_GetTicksNS() - start) / 1e9;
+    if (next < test.count) SDL_Log("loadtest: every connection has gone, %d searches never sent", test.count - next);
+    SDL_Log("loadtest: %d answered in %.3f s, %.1f a second; %d refused as busy, %d lost", test.answered, seconds,
+            seconds > 0 ? test.answered / seconds : 0.0, test.refused, test.failed);
+    if (test.answered > 0) {
+        SDL_qsort(test.latencies, (size_t)test.answered, sizeof(double), compareDoubles);
+        double sum = 0;
+        for (int i = 0; i < test.answered; i++) sum += test.latencies[i];
+#define LOADTEST_PERCENTILE(p) test.latencies[(int)((double)(test.answered - 1) * (p) / 100 + 0.5)]
+        SDL_Log("loadtest: latency ms mean %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f", sum / test.answered,
+                LOADTEST_PERCENTILE(50), LOADTEST_PERCENTILE(90), LOADTEST_PERCENTILE(99), LOADTEST_PERCENTILE(99.9),
+                test.latencies[test.answered - 1]);
+#undef LOADTEST_PERCENTILE
+    }
+    result = next == test.count && test.failed == 0 ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+done:
+    clusterQuit(nodes, nodeCount);
+    SDL_free(test.requests);
+    SDL_free(test.dueNS);
+    SDL_free(test.latencies);
+    SDL_free(text);
+    return result;
+}
+
+#if !defined(CHESS_HEADLESS)
+/* Board diagrams: `main diagrams <file> <dir> [size N] [threads N] [flip]` writes a PNG of every position in the file,
+   a FEN or EPD a line (LINE.png) or, for a .pgn, each position of every game (GAME-PLY.png), into dir. No window is
+   shown: the boards are drawn the way the window draws its own (the piece atlas, addBoardQuad) into a target
+   texture a sheet of DIAGRAM_GRID by DIAGRAM_GRID at a time, on a hidden window's renderer or, where there's no
+   display, SDL's software one. A sheet is read back in one go and cut up, and worker threads encode the PNGs
+   while the next is drawn. `flip` draws them from black's side. */
+#define DIAGRAM_SIZE 320    // pixels a side, rounded down to a multiple of 8
+#define DIAGRAM_GRID 8      // boards a side of the sheet, fewer when the renderer's textures can't be that big
+#define DIAGRAM_QUEUE 256   // images waiting to be encoded; past that the drawing waits for the workers
+
+typedef struct {
+    SDL_Surface* image;
+    char* path;
+} DiagramImage;
+
+typedef struct {
+    SDL_Renderer* renderer;
+    SDL_Texture* atlas;
+    SDL_FRect cells[PIECE_TYPE_COUNT]; // as AppState.pieceCells
+    int size, grid;
+    bool whiteView;
+    const char* directory;
+    char (*names)[32];       // of the boards on the sheet so far, grid * grid of them
+    int drawn;
+    int written;             // images queued, for the summary
+    DiagramImage* queue;     // DIAGRAM_QUEUE slots, a ring the workers empty
+    int head, queued;        // under lock
+    bool done;               // the last sheet is queued
+    SDL_Mutex* lock;
+    SDL_Condition* changed;  // an image queued or taken, or done
+    SDL_AtomicInt failed;
+} DiagramJob;
+
+static int SDLCALL diagramWorker(void* data) {
+    DiagramJob* job = data;
+    for (;;) {
+        SDL_LockMutex(job->lock);
+        while (job->queued == 0 && !job->done) SDL_WaitCondition(job->changed, job->lock);
+        if (job->queued == 0) {
+            SDL_UnlockMutex(job->lock);
+            return 0;
+        }
+        DiagramImage image = job->queue[job->head];
+        job->head = (job->head + 1) % DIAGRAM_QUEUE;
+        job->queued--;
+        SDL_BroadcastCondition(job->changed);
+        SDL_UnlockMutex(job->lock);
+        if (!IMG_SavePNG(image.image, image.path)) {
+            SDL_Log("diagrams: can't write %s: %s", image.path, SDL_GetError());
+            SDL_SetAtomicInt(&job->failed, 1);
+        }
+        SDL_DestroySurface(image.image);
+        SDL_free(image.path);
+    }
+}
+
+// the sheet drawn so far, read back and cut into its boards for the workers
+static void flushDiagrams(DiagramJob* job) {
+    if (job->drawn == 0) return;
+    SDL_Surface* sheet = SDL_RenderReadPixels(job->renderer, NULL);
+    if (!sheet) {
+        SDL_Log("diagrams: can't read the boards back: %s", SDL_GetError());
+        SDL_SetAtomicInt(&job->failed, 1);
+        job->drawn = 0;
+        return;
+    }
+    SDL_SetSurfaceBlendMode(sheet, SDL_BLENDMODE_NONE);
+    for (int i = 0; i < job->drawn; i++) {
+        SDL_Rect from = { i % job->grid * job->size, i / job->grid * job->size, job->size, job->size };
+        SDL_Surface* image = SDL_CreateSurface(job->size, job->size, sheet->format);
+        char* path = NULL;
+        if (!image || !SDL_BlitSurface(sheet, &from, image, NULL) || SDL_asprintf(&path, "%s/%s", job->directory, job->names[i]) < 0) {
+            SDL_Log("diagrams: can't make %s: %s", job->names[i], SDL_GetError());
+            SDL_SetAtomicInt(&job->failed, 1);
+            SDL_DestroySurface(image);
+            continue;
+        }
+        SDL_LockMutex(job->lock);
+        while (job->queued == DIAGRAM_QUEUE) SDL_WaitCondition(job->changed, job->lock);
+        job->queue[(job->head + job->queued++) % DIAGRAM_QUEUE] = (DiagramImage){ image, path };
+        SDL_BroadcastCondition(job->changed);
+        SDL_UnlockMutex(job->lock);
+        job->written++;
+    }
+    SDL_DestroySurface(sheet);
+    job->drawn = 0;
+}
+
+// one board into the next free place on the sheet, as renderChessBoard draws it but in the sheet's pixels
+static void drawDiagram(DiagramJob* job, const ChessState* chess, const char* name) {
+    static BoardBatch board; // only its vertices and indices; the sheet's drawn on this thread alone
+    board.batch = (Clay_SDL3Batch){ 0 };
+    float square = job->size / 8.0f;
+    float left = (float)(job->drawn % job->grid * job->size), top = (float)(job->drawn / job->grid * job->size);
+    for (int r = 0; r < 8; r++) {
+        for (int c = 0; c < 8; c++) {
+            int row = job->whiteView ? 7 - r : r, col = job->whiteView ? 7 - c : c;
+            bool light = ((col + row) % 2) == 0;
+            float x = left + c * square, y = top + r * square;
+            addBoardQuad(&board, x, y, square, job->cells[EMPTY], toFColor(light ? COLOR_SQUARE_WHITE : COLOR_SQUARE_BLACK));
+            PieceType piece = pieceAt(chess, row, col);
+            if (piece != EMPTY) addBoardQuad(&board, x, y, square, job->cells[piece], (SDL_FColor){ 1, 1, 1, 1 });
+        }
+    }
+    if (!SDL_RenderGeometry(job->renderer, job->atlas, board.vertices, board.batch.vertexCount, board.indices, board.batch.indexCount)) {
+        SDL_Log("diagrams: can't draw %s: %s", name, SDL_GetError());
+        SDL_SetAtomicInt(&job->failed, 1);
+        return;
+    }
+    SDL_strlcpy(job->names[job->drawn++], name, sizeof(job->names[0]));
+    if (job->drawn == job->grid * job->grid) flushDiagrams(job);
+}
+
+// every position of every game, for readPgnGames
+static void drawPgnDiagram(void* context, const ChessState* position, Move move, int game, int ply, int result) {
+    (void)move;
+    (void)result;
+    char name[32];
+    SDL_snprintf(name, sizeof(name), "%05d-%03d.png", game, ply);
+    drawDiagram(context, position, name);
+}
+
+// one position per line, as readEpdPositions reads them
+static void drawEpdDiagrams(DiagramJob* job, const char* p, const char* end) {
+    ChessState chess = initChessState();
+    for (int number = 1; p < end; number++) {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        const char* last = eol ? eol : end;
+        const char* next = eol ? eol + 1 : end;
+        while (last > p && (last[-1] == '\r' || last[-1] == ' ' || last[-1] == '\t')) last--;
+        while (p < last && (*p == ' ' || *p == '\t')) p++;
+        if (p < last && *p != '#') {
+            char line[BATCH_LINE_MAX];
+            SDL_strlcpy(line, p, SDL_min((size_t)(last - p) + 1, sizeof(line)));
+            char name[32];
+            SDL_snprintf(name, sizeof(name), "%06d.png", number);
+            if (loadFen(&chess, line)) drawDiagram(job, &chess, name);
+            else {
+                SDL_Log("diagrams: line %d: bad FEN or EPD: %.*s", number, (int)(last - p), p);
+                SDL_SetAtomicInt(&job->failed, 1);
+            }
+        }
+        p = next;
+    }
+}
+
+static SDL_AppResult runDiagramsCommand(int argc, char* argv[]) {
+    if (argc < 4) {
+        SDL_Log("usage: %s diagrams <file> <dir> [size N] [threads N] [flip]", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    DiagramJob job;
+    SDL_memset(&job, 0, sizeof(job));
+    job.size = DIAGRAM_SIZE;
+    job.whiteView = true;
+    job.directory = argv[3];
+    int threads = SDL_GetNumLogicalCPUCores();
+    for (int i = 4; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (SDL_strcmp(argv[i], "flip") == 0) job.whiteView = false;
+        else if (value && SDL_strcmp(argv[i], "size") == 0) job.size = SDL_clamp(SDL_atoi(value), 64, 2048) / 8 * 8, i++;
+        else if (value && SDL_strcmp(argv[i], "threads") == 0) threads = SDL_clamp(SDL_atoi(value), 1, MAX_POOL_THREADS), i++;
+        else { SDL_Log("diagrams: unknown option %s", argv[i]); return SDL_APP_FAILURE; }
+    }
+    MappedFile file;
+    if (!mapFile(&file, argv[2])) {
+        SDL_Log("diagrams: can't read %s: %s", argv[2], SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    size_t nameLength = SDL_strlen(argv[2]);
+    bool pgn = nameLength >= 4 && SDL_strcasecmp(argv[2] + nameLength - 4, ".pgn") == 0;
+    SDL_AppResult result = SDL_APP_FAILURE;
+    SDL_Window* window = NULL;
+    SDL_Surface* target = NULL; // the software renderer's, which is never drawn to
+    SDL_Texture* sheet = NULL;
+    SDL_Thread* workers[MAX_POOL_THREADS] = { NULL };
+    SDL_Surface* pieces = decodePieceAtlas(job.cells);
+    job.queue = SDL_malloc(sizeof(DiagramImage) * DIAGRAM_QUEUE);
+    job.names = SDL_malloc(sizeof(job.names[0]) * DIAGRAM_GRID * DIAGRAM_GRID);
+    job.lock = SDL_CreateMutex();
+    job.changed = SDL_CreateCondition();
+    if (!pieces || !job.queue || !job.names || !job.lock || !job.changed) goto done;
+    if (!SDL_CreateDirectory(job.directory)) {
+        SDL_Log("diagrams: can't make %s: %s", job.directory, SDL_GetError());
+        goto done;
+    }
+    if (!SDL_CreateWindowAndRenderer("diagrams", 1, 1, SDL_WINDOW_HIDDEN, &window, &job.renderer)) {
+        SDL_Log("diagrams: no hidden window (%s), drawing in software", SDL_GetError());
+        target = SDL_CreateSurface(1, 1, SDL_PIXELFORMAT_RGBA32);
+        job.renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    }
+    if (!job.renderer) {
+        SDL_Log("diagrams: no renderer: %s", SDL_GetError());
+        goto done;
+    }
+    Sint64 maxTexture = SDL_GetNumberProperty(SDL_GetRendererProperties(job.renderer), SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 0);
+    job.grid = maxTexture > 0 ? (int)SDL_clamp(maxTexture / job.size, 1, DIAGRAM_GRID) : DIAGRAM_GRID;
+    job.atlas = SDL_CreateTextureFromSurface(job.renderer, pieces);
+    sheet = SDL_CreateTexture(job.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, job.grid * job.size, job.grid * job.size);
+    if (!job.atlas || !sheet || !SDL_SetRenderTarget(job.renderer, sheet)) {
+        SDL_Log("diagrams: can't make the textures: %s", SDL_GetError());
+        goto done;
+    }
+    SDL_SetTextureBlendMode(job.atlas, SDL_BLENDMODE_BLEND);
+    engineInitTables();
+    for (int t = 0; t < threads; t++)
+        if (!(workers[t] = SDL_CreateThread(diagramWorker, "diagrams", &job))) threads = t;
+    if (threads == 0) {
+        SDL_Log("diagrams: can't start a worker: %s", SDL_GetError());
+        goto done;
+    }
+
+    Uint64 start = SDL_GetTicksNS();
+    if (pgn && !readPgnGames(file.data, file.data + file.size, drawPgnDiagram, &job)) SDL_SetAtomicInt(&job.failed, 1);
+    else if (!pgn) drawEpdDiagrams(&job, file.data, file.data + file.size);
+    flushDiagrams(&job);
+    SDL_LockMutex(job.lock);
+    job.done = true;
+    SDL_BroadcastCondition(job.changed);
+    SDL_UnlockMutex(job.lock);
+    for (int t = 0; t < threads; t++) SDL_WaitThread(workers[t], NULL);
+    double seconds = (double)(SDL_GetTicksNS() - start) / 1e9;
+    SDL_Log("diagrams: %d written to %s in %.3f s, %.0f a second (%s, %d threads)", job.written, job.directory, seconds,
+            seconds > 0 ? job.written / seconds : 0.0, SDL_GetRendererName(job.renderer), threads);
+    result = SDL_GetAtomicInt(&job.failed) ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+done:
+    if (sheet) SDL_DestroyTexture(sheet);
+    if (job.atlas) SDL_DestroyTexture(job.atlas);
+    if (job.renderer) SDL_DestroyRenderer(job.renderer);
+    if (window) SDL_DestroyWindow(window);
+    SDL_DestroySurface(target);
+    SDL_DestroySurface(pieces);
+    SDL_DestroyCondition(job.changed);
+    SDL_DestroyMutex(job.lock);
+    SDL_free(job.names);
+    SDL_free(job.queue);
+    unmapFile(&file);
+    return result;
+}
+#endif
+
+// the headless front ends, by the first argument
+static const struct { const char* name; SDL_AppResult (*run)(int argc, char* argv[]); } HEADLESS_COMMANDS[] = {
+    { "perft", runPerftCommand },
+    { "mate", runMateCommand },
+    { "bench", runBenchCommand },
+    { "benchcompare", runBenchCompareCommand },
+    { "scaling", runScalingCommand },
+    { "batch", runBatchCommand },
+    { "suite", runSuiteCommand },
+    { "annotate", runAnnotateCommand },
+    { "selfplay", runSelfPlayCommand },
+    { "match", runMatchCommand },
+    { "simul", runSimulCommand },
+    { "spsa", runSpsaCommand },
+    { "book", runBookCommand },
+    { "explorer", runExplorerCommand },
+    { "tune", runTuneCommand },
+    { "net", runNetCommand },
+    { "uci", runUciCommand },
+    { "serve", runServeCommand },
+    { "cluster", runClusterCommand },
+    { "farm", runFarmCommand },
+    { "searchlog", runSearchLogCommand },
+    { "searchtree", runSearchTreeCommand },
+    { "loadtest", runLoadTestCommand },
+#if !defined(CHESS_HEADLESS)
+    { "diagrams", runDiagramsCommand }, // offscreen, so no window either, but it needs SDL_image
+#endif
+};
+
+// SDL_APP_CONTINUE when argv[1] isn't one of them
+static SDL_AppResult runHeadlessCommand(int argc, char* argv[]) {
+    for (size_t i = 0; argc >= 2 && i < SDL_arraysize(HEADLESS_COMMANDS); i++)
+        if (SDL_strcmp(argv[1], HEADLESS_COMMANDS[i].name) == 0) return HEADLESS_COMMANDS[i].run(argc, argv);
+    return SDL_APP_CONTINUE;
+}
+
+#if defined(CHESS_HEADLESS)
+/* SDL App lifecycle: a command runs to the end in SDL_AppInit, so there's never an iteration */
+SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    (void)appstate;
+#if defined(CHESS_COMMAND)
+    char** args = SDL_malloc((size_t)(argc + 2) * sizeof(char*)); // the command's name put back in after the program's
+    if (!args) return SDL_APP_FAILURE;
+    args[0] = argv[0];
+    args[1] = CHESS_COMMAND;
+    for (int i = 1; i <= argc; i++) args[i + 1] = argv[i]; // argv[argc], the NULL, too
+    SDL_AppResult result = runHeadlessCommand(argc + 1, args);
+    SDL_free(args);
+    return result;
+#else
+    if (argc < 2) {
+        char* args[] = { argv[0], "uci", NULL };
+        return runUciCommand(2, args);
+    }
+    SDL_AppResult result = runHeadlessCommand(argc, argv);
+    if (result == SDL_APP_CONTINUE) {
+        SDL_Log("usage: %s [perft|mate|bench|benchcompare|scaling|batch|suite|annotate|selfplay|match|simul|spsa|book|explorer|tune|net|uci|serve|cluster|farm] ...", argv[0]);
+        return SDL_APP_FAILURE;
+    }
+    return result;
+#endif
+}
+
+SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) { (void)appstate; (void)event; return SDL_APP_CONTINUE; }
+SDL_AppResult SDL_AppIterate(void* appstate) { (void)appstate; return SDL_APP_SUCCESS; }
+void SDL_AppQuit(void* appstate, SDL_AppResult result) { (void)appstate; (void)result; }
+#else
+/* Engine thread, for each event queued for enginePollEvents. The window waits on its own events between frames
+   (SDL_HINT_MAIN_CALLBACK_RATE "waitevent"), so this posts one to wake it: always for the move, at most every
+   REDRAW_PROGRESS_NS for the search's progress. An info event left unwoken is shown with the next. */
+static void wakeForEngine(const EngineEvent* event, void* userData) {
+    AppState* state = userData;
+    Uint64 now = SDL_GetTicksNS();
+    if (event->type == ENGINE_EVENT_INFO && now - state->lastWakeNS < REDRAW_PROGRESS_NS) return;
+    state->lastWakeNS = now;
+    SDL_Event wake = { .type = SDL_EVENT_USER };
+    SDL_PushEvent(&wake);
+}
+
+// continuous frames only while the frame-time overlay is up; otherwise one after every batch of events
+static void setFrameRate(const FrameStats* stats) {
+    SDL_SetHint(SDL_HINT_MAIN_CALLBACK_RATE, stats->overlay ? "0" : "waitevent");
+}
+
+/* Makes the move on the board and in the game record. Another move than the one taken back there drops the moves
+   after it; the same one keeps them to replay. Past TIMELINE_MAX_PLIES it's only played, not kept. */
+static void playMove(AppState* state, Move move) {
+    GameTimeline* game = &state->game;
+    makeMove(&state->chess, move, NULL);
+    if (state->ply < game->length && game->moves[state->ply] == move) {
+        state->ply++;
+        return;
+    }
+    timelineTruncate(game, state->ply);
+    if (timelineAppend(game, move, &state->chess)) state->ply++;
+}
+
+/* The board at the game's ply, from the keyframe before it. The search under way is dropped, and one started there
+   if the engine is to move: a position it has searched before is answered at once (Engine.reuseResults). */
+static void seekGame(AppState* state, int ply) {
+    engineStopSearch(state->engine);
+    state->ply = SDL_clamp(ply, 0, state->game.length);
+    timelineSeek(&state->game, state->ply, &state->chess);
+    selectSquare(state, -1, -1);
+    printf("Ply %d of %d\n", state->ply, state->game.length);
+    GameStatus status = getGameStatus(&state->chess);
+    if (state->chess.whiteToMove == state->engineWhite && status != GAME_CHECKMATE && status != GAME_STALEMATE)
+        startEngineSearch(state, MOVE_NONE, MOVE_SOFT_TIME_NS, MOVE_HARD_TIME_NS);
+}
+
+/* Left (step -1) takes the game back to the user's previous move, the engine's reply with it; right (+1) replays
+   to the user's next one. */
+static void stepThroughGame(AppState* state, int step) {
+    int ply = state->ply;
+    if (step < 0 ? ply == 0 : ply >= state->game.length) return;
+    do ply += step;
+    while ((step < 0 ? ply > 0 : ply < state->game.length) && timelineWhiteToMove(&state->game, ply) == state->engineWhite);
+    seekGame(state, ply);
+}
+
+// --pgn FILE: the first game's main line, for readPgnGames
+static void loadPgnMove(void* context, const ChessState* position, Move move, int game, int ply, int result) {
+    GameTimeline* timeline = context;
+    (void)result;
+    if (game != 1) return;
+    if (ply == 0 && !timelineReset(timeline, position)) return;
+    if (move == MOVE_NONE || timeline->length != ply) return; // the end, or a ply past what can be kept
+    ChessState after = *position;
+    makeMove(&after, move, NULL);
+    timelineAppend(timeline, move, &after);
+}
+
+/* SDL App lifecycle */
+SDL_AppResult SDL_AppInit(void** appstate, int argc, char* argv[]) {
+    SDL_AppResult headless = runHeadlessCommand(argc, argv); // no window
+    if (headless != SDL_APP_CONTINUE) return headless;
+    if (!TTF_Init()) return SDL_APP_FAILURE;
+
+    AppState* state = SDL_calloc(1, sizeof(AppState));
+    if (!state) return SDL_APP_FAILURE;
+
+    /* --renderer NAME: SDL's render driver, "gpu" for the one on the GPU API; or, built with CHESS_GPU_RENDERER,
+       "sdlgpu" for the Clay renderer on the GPU API itself (clay_renderer_SDL3_gpu.c), SDL's renderer if it can't */
+    const char* rendererName = NULL;
+    for (int i = 1; i + 1 < argc; i++)
+        if (SDL_strcmp(argv[i], "--renderer") == 0) rendererName = argv[i + 1];
+    state->window = SDL_CreateWindow("SDL + Clay UI (threaded engine)", 900, 600, SDL_WINDOW_RESIZABLE);
+    if (!state->window) {
+        SDL_free(state);
+        return SDL_APP_FAILURE;
+    }
+#if defined(CHESS_GPU_RENDERER)
+    if (rendererName && SDL_strcmp(rendererName, "sdlgpu") == 0) {
+        Clay_SDL3Gpu* gpu = state->rendererData.gpu = SDL_Clay_GpuCreate(state->window);
+        if (gpu) {
+            SDL_Log("Renderer: SDL_GPU, %s", SDL_GetGPUDeviceDriver(gpu->device));
+            state->rendererData.textEngine = TTF_CreateGPUTextEngine(gpu->device);
+        } else {
+            SDL_Log("Renderer: no SDL_GPU device for the window (%s)", SDL_GetError());
+        }
+        rendererName = NULL;
+    }
+#endif
+    if (!state->rendererData.gpu) {
+        if (rendererName) SDL_SetHint(SDL_HINT_RENDER_DRIVER, rendererName);
+        state->rendererData.renderer = SDL_CreateRenderer(state->window, NULL);
+        if (!state->rendererData.renderer) {
+            SDL_DestroyWindow(state->window);
+            SDL_free(state);
+            return SDL_APP_FAILURE;
+        }
+        SDL_Log("Renderer: %s", SDL_GetRendererName(state->rendererData.renderer));
+        state->rendererData.textEngine = TTF_CreateRendererTextEngine(state->rendererData.renderer);
+    }
+    state->rendererData.fonts = SDL_calloc(1, sizeof(TTF_Font*));
+    SDL_IOStream* fontFile = openAsset(ASSET_FONT);
+    TTF_Font* font = fontFile ? TTF_OpenFontIO(fontFile, true, 24) : NULL;
+    if (!font) {
+        SDL_Log("Could not open %s: %s", ASSET_FONT, SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    state->rendererData.fonts[FONT_ID] = font;
+
+    uint64_t memSize = Clay_MinMemorySize();
+    Clay_Arena arena = { .memory = SDL_malloc(memSize), .capacity = memSize };
+    int w,h; SDL_GetWindowSize(state->window,&w,&h);
+    Clay_Initialize(arena, (Clay_Dimensions){ (float)w, (float)h }, (Clay_ErrorHandler){ HandleClayErrors });
+    Clay_SetMeasureTextFunction(SDL_MeasureText, &state->rendererData);
+
+    startLoadingAssets(&state->assets); // decodes while the engine is set up; uploadPieceAtlas takes it from there
+    engineInitTables();
+    for (int i = 1; i + 1 < argc; i++) // --nnue FILE: evaluate with that network, before any position is set up
+        if (SDL_strcmp(argv[i], "--nnue") == 0) nnueLoad(argv[i + 1]);
+    bool pinThreads = false; // --pin-threads: one core per search thread, for big multi-socket machines
+    for (int i = 1; i < argc; i++) if (SDL_strcmp(argv[i], "--pin-threads") == 0) pinThreads = true;
+    int reserved = GUI_RESERVED_CORES; // --reserve-cores N: left to the window and the rest of the machine
+    for (int i = 1; i + 1 < argc; i++)
+        if (SDL_strcmp(argv[i], "--reserve-cores") == 0) reserved = SDL_max(SDL_atoi(argv[i + 1]), 0);
+    // the engine thread searches too, so the pool gets one core fewer than are left
+    int workers = SDL_GetNumLogicalCPUCores() - reserved - 1;
+    engineSetThreadPriority(SDL_THREAD_PRIORITY_LOW); // the window's thread comes first
+    if (workers > 0 && !engineStartThreads(workers, pinThreads))
+        SDL_Log("Could not start the search threads, searching on the engine thread only");
+    state->engine = engineCreate();
+    if (!state->engine) return SDL_APP_FAILURE;
+    if (!engineSetHash(state->engine, TT_SIZE_MB)) SDL_Log("Could not allocate the %d MB transposition table, searching without it", TT_SIZE_MB);
+    else engineNewGame(state->engine); // first touch from the search threads, see engineNewGame
+    state->engine->ponder = true;
+    state->engine->ponderReplies = 3; // the expected reply and the two likeliest others
+    state->engine->reuseResults = true; // so a takeback's replayed positions are answered at once
+    for (int i = 1; i + 1 < argc; i++) // --book FILE: play from a Polyglot-format book while the game is in it
+        if (SDL_strcmp(argv[i], "--book") == 0 && !state->book) state->engine->book = state->book = bookOpen(argv[i + 1]);
+    for (int i = 1; i + 1 < argc; i++) // --syzygy DIRS: the Syzygy endgame tables, mapped as the search needs them
+        if (SDL_strcmp(argv[i], "--syzygy") == 0) SDL_Log("%d Syzygy tables in %s", engineSetSyzygyPath(argv[i + 1]), argv[i + 1]);
+    for (int i = 1; i + 1 < argc; i++) // --multipv N: analyse the N best moves instead of just the one
+        if (SDL_strcmp(argv[i], "--multipv") == 0) state->engine->multiPv = SDL_clamp(SDL_atoi(argv[i + 1]), 1, MAX_MULTI_PV);
+    for (int i = 1; i < argc; i++) if (SDL_strcmp(argv[i], "--frame-stats") == 0) state->frameStats.overlay = true;
+    for (int i = 1; i + 1 < argc; i++) if (SDL_strcmp(argv[i], "--screenshot") == 0) state->screenshot = argv[i + 1];
+    state->chess = initChessState();
+    if (!timelineReset(&state->game, &state->chess)) return SDL_APP_FAILURE;
+    const char* pgnPath = NULL; // --pgn FILE: review its first game, from the end
+    for (int i = 1; i + 1 < argc; i++) if (SDL_strcmp(argv[i], "--pgn") == 0) pgnPath = argv[i + 1];
+    MappedFile games;
+    if (pgnPath && !mapFile(&games, pgnPath)) SDL_Log("Could not read %s: %s", pgnPath, SDL_GetError());
+    else if (pgnPath) {
+        readPgnGames(games.data, games.data + games.size, loadPgnMove, &state->game); // bad moves are logged
+        unmapFile(&games);
+    }
+    selectSquare(state, -1, -1);
+    state->hoveredSquare = -1;
+    state->engineWhite = false;
+    state->engine->onQueued = wakeForEngine;
+    state->engine->userData = state;
+    state->redraw = true;
+    setFrameRate(&state->frameStats);
+    if (state->game.length > 0) seekGame(state, state->game.length); // the engine takes up a game left on its move
+
+    *appstate = state;
+    return SDL_APP_CONTINUE;
+}
+
+// what the move just made did to the game, on the console
+static void printGameStatus(ChessState* chess) {
+    switch (getGameStatus(chess)) {
+        case GAME_CHECKMATE: printf("CHECKMATE! %s wins!\n", chess->whiteToMove ? "Black" : "White"); break;
+        case GAME_STALEMATE: printf("STALEMATE! Draw.\n"); break;
+        case GAME_CHECK: printf("CHECK!\n"); break;
+        default: break;
+    }
+}
+
+SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
+    AppState* state = (AppState*)appstate;
+    // input, the window's own events, or wakeForEngine's; a mouse move only when it takes the highlight to another square
+    if (state && event->type != SDL_EVENT_MOUSE_MOTION) state->redraw = true;
+    switch (event->type) {
+        case SDL_EVENT_QUIT: return SDL_APP_SUCCESS;
+        case SDL_EVENT_WINDOW_RESIZED:
+            Clay_SetLayoutDimensions((Clay_Dimensions){ (float)event->window.data1, (float)event->window.data2 });
+            break;
+        case SDL_EVENT_MOUSE_MOTION:
+            Clay_SetPointerState((Clay_Vector2){ event->motion.x, event->motion.y }, event->motion.state & SDL_BUTTON_LMASK);
+            if (state) {
+                state->pointer = (SDL_FPoint){ event->motion.x, event->motion.y };
+                int square = boardSquareAt(&state->boardRect, state->pointer, true);
+                if (square != state->hoveredSquare) state->hoveredSquare = square, state->redraw = true;
+            }
+            break;
+        case SDL_EVENT_MOUSE_BUTTON_DOWN: {
+            Clay_SetPointerState((Clay_Vector2){ event->button.x, event->button.y }, event->button.button == SDL_BUTTON_LEFT);
+            if (state) state->pointer = (SDL_FPoint){ event->button.x, event->button.y };
+            if (event->button.button == SDL_BUTTON_LEFT && state) {
+                const bool whitePerspective = true;
+
+                if (state->chess.whiteToMove == state->engineWhite) return SDL_APP_CONTINUE;
+
+                int square = boardSquareAt(&state->boardRect, state->pointer, whitePerspective);
+                if (square >= 0) {
+                    int row = square / 8, col = square % 8;
+                    PieceType clickedPiece = pieceAt(&state->chess, row, col);
+                    int selR = state->selectedRow;
+                    int selC = state->selectedCol;
+                    bool hasSelection = (selR >= 0 && selC >= 0);
+
+                    if (hasSelection) {
+                        if (selR == row && selC == col) {
+                            selectSquare(state, -1, -1);
+                        } else if ((state->legalTargets >> squareIndex(row, col)) & 1) {
+                            Move move = buildMove(&state->chess, squareIndex(selR, selC), squareIndex(row, col));
+
+                            playMove(state, move);
+
+                            selectSquare(state, -1, -1);
+
+                            engineReplyTo(state, move);
+
+                            printGameStatus(&state->chess);
+                        } else {
+                            if (clickedPiece != EMPTY && ((state->chess.whiteToMove && !isBlack(clickedPiece)) || (!state->chess.whiteToMove && isBlack(clickedPiece)))) {
+                                selectSquare(state, row, col);
+                            } else {
+                                selectSquare(state, -1, -1);
+                            }
+                        }
+                    } else {
+                        if (clickedPiece != EMPTY && ((state->chess.whiteToMove && !isBlack(clickedPiece)) || (!state->chess.whiteToMove && isBlack(clickedPiece)))) {
+                            selectSquare(state, row, col);
+                        }
+                    }
+                }
+            }
+            break;
+        }
+        case SDL_EVENT_KEY_DOWN:
+            // space: move now, with the best move found so far
+            if (state && event->key.key == SDLK_SPACE && state->engine->searching && !SDL_GetAtomicInt(&state->engine->pondering))
+                engineMoveNow(state->engine);
+            if (state && event->key.key == SDLK_F3) {
+                state->frameStats.overlay = !state->frameStats.overlay;
+                setFrameRate(&state->frameStats);
+            }
+            if (state && event->key.key == SDLK_F4) dumpFrameStats(&state->frameStats, FRAME_DUMP_PATH);
+            // left and right: take the last pair of moves back, or replay it; home and end: the game's start and end
+            if (state && event->key.key == SDLK_LEFT) stepThroughGame(state, -1);
+            if (state && event->key.key == SDLK_RIGHT) stepThroughGame(state, +1);
+            if (state && event->key.key == SDLK_HOME) seekGame(state, 0);
+            if (state && event->key.key == SDLK_END) seekGame(state, state->game.length);
+            break;
+        case SDL_EVENT_MOUSE_WHEEL:
+            Clay_UpdateScrollContainers(true, (Clay_Vector2){ event->wheel.x, event->wheel.y }, 0.01f);
+            break;
+        default:
+            break;
+    }
+    return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult SDL_AppIterate(void* appstate) {
+    AppState* state = (AppState*)appstate;
+
+    // the engine first: what it sent is what may need drawing
+    bool engineReady = false;
+    Move engineMoveLocal = MOVE_NONE;
+
+    uploadPieceAtlas(state);
+    enginePollEvents(state->engine); // never waits on the engine thread
+    if (state->engine->hasMove) {
+        engineMoveLocal = state->engine->resultMove;
+        state->engine->hasMove = false;
+        engineReady = true;
+    }
+
+    if (engineReady) {
+        playMove(state, engineMoveLocal);
+        if (state->selectedRow >= 0) selectSquare(state, state->selectedRow, state->selectedCol);
+
+        char moveText[MOVE_TEXT_MAX];
+        printf("Engine move: %s\n", move2chars(engineMoveLocal, moveText));
+
+        if (state->engine->ponder) {
+            Move reply = engineExpectedReply(state->engine, &state->chess);
+            if (reply != MOVE_NONE) startEngineSearch(state, reply, MOVE_SOFT_TIME_NS, MOVE_HARD_TIME_NS);
+        }
+
+        printGameStatus(&state->chess);
+    }
+
+    if (!state->redraw && !state->frameStats.overlay) return SDL_APP_CONTINUE;
+    state->redraw = false;
+    FrameStats* stats = &state->frameStats;
+    FrameTiming timing = { 0 };
+    Uint64 start = SDL_GetTicksNS();
+    timing.frameNS = stats->lastStartNS ? start - stats->lastStartNS : 0;
+    stats->lastStartNS = start;
+    Clay_RenderCommandArray commands = CreateLayout(state);
+    Clay_BoundingBox board = Clay_GetElementData(CLAY_ID("Squares")).boundingBox; // zeroes when it isn't there
+    state->boardRect = (SDL_FRect){ board.x, board.y, board.width, board.height };
+    int hovered = boardSquareAt(&state->boardRect, state->pointer, true);
+    if (hovered != state->hoveredSquare) state->hoveredSquare = hovered, state->redraw = true; // the board moved under the mouse
+    Uint64 laidOut = SDL_GetTicksNS(), rendered;
+    // the same frame from either renderer, to hold one against the other
+    bool capture = state->screenshot && (state->pieceAtlas || state->pieceAtlasGpu);
+    SDL_Surface* shot = NULL;
+#if defined(CHESS_GPU_RENDERER)
+    if (state->rendererData.gpu) { // the instances are collected here, uploaded and drawn at the present
+        SDL_Clay_GpuRenderClayCommands(&state->rendererData, &commands);
+        rendered = SDL_GetTicksNS();
+        if (!SDL_Clay_GpuPresent(state->rendererData.gpu, (SDL_FColor){ 20 / 255.0f, 20 / 255.0f, 20 / 255.0f, 1 },
+                                 capture ? &shot : NULL))
+            SDL_Log("SDL_GPU frame failed: %s", SDL_GetError());
+    } else
+#endif
+    {
+        SDL_SetRenderDrawColor(state->rendererData.renderer, 20, 20, 20, 255);
+        SDL_RenderClear(state->rendererData.renderer);
+        SDL_Clay_RenderClayCommands(&state->rendererData, &commands);
+        rendered = SDL_GetTicksNS();
+        if (capture) shot = SDL_RenderReadPixels(state->rendererData.renderer, NULL);
+        SDL_RenderPresent(state->rendererData.renderer);
+    }
+    if (capture) {
+        bool saved = shot && IMG_SavePNG(shot, state->screenshot);
+        if (!saved) SDL_Log("Could not write the screenshot %s: %s", state->screenshot, SDL_GetError());
+        else SDL_Log("Screenshot: %s, %dx%d", state->screenshot, shot->w, shot->h);
+        SDL_DestroySurface(shot);
+        return saved ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+    timing.layoutNS = laidOut - start;
+    timing.renderNS = rendered - laidOut;
+    timing.presentNS = SDL_GetTicksNS() - rendered;
+    timing.commandCount = commands.length;
+    if (timing.frameNS > 0) stats->frames[stats->count++ % FRAME_HISTORY] = timing; // the first frame has no frame before it
+    return SDL_APP_CONTINUE;
+}
+
+void SDL_AppQuit(void* appstate, SDL_AppResult result) {
     (void)result;
     AppState* state = appstate;
     if (!state) return;
 
-    if (state->engine.thread) SDL_WaitThread(state->engine.thread, NULL);
-    if (state->engine.mutex) SDL_DestroyMutex(state->engine.mutex);
+    engineDestroy(state->engine); // stops the search rather than sitting out the rest of its time budget
+    engineStopThreads();
+    SDL_WaitThread(state->assets.thread, NULL);
+    SDL_DestroySurface(state->assets.atlas);
+    bookClose(state->book);
+    SDL_free(state->game.keyframes);
 
+    SDL_Clay_DestroyTextCache(&state->rendererData);
+    SDL_Clay_DestroyGeometry(&state->rendererData);
+    SDL_DestroyTexture(state->pieceAtlas);
     TTF_CloseFont(state->rendererData.fonts[FONT_ID]);
     SDL_free(state->rendererData.fonts);
-    TTF_DestroyRendererTextEngine(state->rendererData.textEngine);
-    SDL_DestroyRenderer(state->rendererData.renderer);
+#if defined(CHESS_GPU_RENDERER)
+    if (state->rendererData.gpu) {
+        SDL_Clay_GpuDestroyTexture(state->rendererData.gpu, state->pieceAtlasGpu);
+        TTF_DestroyGPUTextEngine(state->rendererData.textEngine);
+        SDL_Clay_GpuDestroy(state->rendererData.gpu);
+    } else
+#endif
+    {
+        TTF_DestroyRendererTextEngine(state->rendererData.textEngine);
+        SDL_DestroyRenderer(state->rendererData.renderer);
+    }
     SDL_DestroyWindow(state->window);
     SDL_free(state);
     TTF_Quit();
-}
\ No newline at end of file
+}
+#endif
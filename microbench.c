@@ -0,0 +1,205 @@
+// MICRO-BENCHMARKS: the engine's hot functions timed one at a time, a program of its own (the microbench build task)
+
+/* `microbench [reps N] [ms N] [only KERNEL] [json FILE] [counters LIST] [spin US]` times each kernel over every position of BENCH_POSITIONS (bench.h):
+   move generation, a make/unmake of every legal move (and a copy-make), isSquareAttacked on every square for both sides,
+   isKingInCheck for both kings and evaluatePosition; and, a call a position, an empty job handed to a search
+   worker and waited for, the latency every search start pays, with the worker spinning for `spin` microseconds
+   before it sleeps (engineSetThreadSpin; 0 to time the wake-up from sleep). A kernel first runs for a while to warm the caches and
+   settle the clock, and to find how many passes over the positions take about `ms` milliseconds; then it is timed
+   `reps` times for that many passes. Each one gets its nanoseconds per call, mean, spread (standard deviation)
+   and the best of the repetitions, so a regression can be pinned on the function that lost the time rather than
+   on the search as a whole; `json` writes the means and spreads to a benchmark record (bench.h) as well, for
+   `main benchcompare`. `counters` gives the hardware's counts over a kernel's repetitions as well, a call's share
+   of each (HardwareCounter, bench.h). The engine is compiled into this file, its static functions included. */
+#include "engine.c"
+#include "bench.h"
+#include <SDL3/SDL_main.h>
+
+#define MICROBENCH_REPS 10
+#define MICROBENCH_MS 100    // a repetition's target length
+#define MICROBENCH_WARMUP_MS 200
+
+#define BENCH_COUNT ((int)SDL_arraysize(BENCH_POSITIONS))
+
+// the positions, and their legal moves worked out once up front
+typedef struct {
+    ChessState positions[BENCH_COUNT];
+    MoveList moves[BENCH_COUNT];
+} BenchCorpus;
+
+typedef Uint64 (*BenchKernel)(BenchCorpus* corpus); // one pass over the positions; returns how many calls it made
+
+static volatile Uint64 benchSink; // results go here, so the compiler can't drop the calls
+
+static Uint64 benchMoveGeneration(BenchCorpus* corpus) {
+    Uint64 sum = 0;
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        MoveList moves;
+        getAllMoves(&corpus->positions[i], &moves);
+        sum += (Uint64)moves.count;
+    }
+    benchSink += sum;
+    return BENCH_COUNT;
+}
+
+// a make and its unmake is one call
+static Uint64 benchMakeUnmake(BenchCorpus* corpus) {
+    Uint64 calls = 0, sum = 0;
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        ChessState* chess = &corpus->positions[i];
+        const MoveList* moves = &corpus->moves[i];
+        for (int m = 0; m < moves->count; m++) {
+            UndoInfo undo;
+            makeMove(chess, moves->moves[m], &undo);
+            sum += chess->hashKey;
+            unmakeMove(chess, moves->moves[m], &undo);
+        }
+        calls += (Uint64)moves->count;
+    }
+    benchSink += sum;
+    return calls;
+}
+
+// the same with copy-make, the other way the search can take its moves back (COPY_MAKE)
+static Uint64 benchCopyMake(BenchCorpus* corpus) {
+    Uint64 calls = 0, sum = 0;
+    Uint8 saved[COPY_MAKE_MAX_BYTES];
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        ChessState* chess = &corpus->positions[i];
+        const MoveList* moves = &corpus->moves[i];
+        for (int m = 0; m < moves->count; m++) {
+            copyMake(chess, moves->moves[m], saved);
+            sum += chess->hashKey;
+            copyUnmake(chess, saved);
+        }
+        calls += (Uint64)moves->count;
+    }
+    benchSink += sum;
+    return calls;
+}
+
+static Uint64 benchSquareAttacked(BenchCorpus* corpus) {
+    Uint64 sum = 0;
+    for (int i = 0; i < BENCH_COUNT; i++)
+        for (int sq = 0; sq < 64; sq++)
+            sum += isSquareAttacked(&corpus->positions[i], sq >> 3, sq & 7, true) + isSquareAttacked(&corpus->positions[i], sq >> 3, sq & 7, false);
+    benchSink += sum;
+    return BENCH_COUNT * 128;
+}
+
+static Uint64 benchKingInCheck(BenchCorpus* corpus) {
+    Uint64 sum = 0;
+    for (int i = 0; i < BENCH_COUNT; i++) sum += isKingInCheck(&corpus->positions[i], true) + isKingInCheck(&corpus->positions[i], false);
+    benchSink += sum;
+    return BENCH_COUNT * 2;
+}
+
+static Uint64 benchEvaluate(BenchCorpus* corpus) {
+    Uint64 sum = 0;
+    for (int i = 0; i < BENCH_COUNT; i++) // the whole evaluation: no lazy cut, no evaluation cache
+        sum += (Uint64)evaluatePosition(&corpus->positions[i], &pawnTables[0], NULL, -INF, INF);
+    benchSink += sum;
+    return BENCH_COUNT;
+}
+
+static int SDLCALL emptyJob(void* data) {
+    (void)data;
+    return 0;
+}
+
+// submit to finish on one worker, started the first time; with spinning the worker never sleeps between the calls
+static Uint64 benchWakeup(BenchCorpus* corpus) {
+    (void)corpus;
+    if (!searchPool.mutex && !engineStartThreads(1, false)) SDL_Log("microbench: no worker thread, the jobs run here");
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        threadPoolSubmit(&searchPool, emptyJob, NULL);
+        threadPoolWait(&searchPool);
+    }
+    return BENCH_COUNT;
+}
+
+static const struct { const char* name; BenchKernel run; } BENCH_KERNELS[] = {
+    { "movegen", benchMoveGeneration },
+    { "makeunmake", benchMakeUnmake },
+    { "copymake", benchCopyMake },
+    { "attacked", benchSquareAttacked },
+    { "incheck", benchKingInCheck },
+    { "eval", benchEvaluate },
+    { "wakeup", benchWakeup },
+};
+
+// one kernel: warm up and calibrate, then time the repetitions
+static void runKernel(const char* name, BenchKernel run, BenchCorpus* corpus, int reps, int ms, HardwareCounters* counters,
+                      BenchResult* result) {
+    Uint64 passes = 0, start = SDL_GetTicksNS();
+    do { run(corpus); passes++; } while (SDL_GetTicksNS() - start < (Uint64)MICROBENCH_WARMUP_MS * 1000000);
+    passes = SDL_max(passes * (Uint64)ms / MICROBENCH_WARMUP_MS, 1);
+
+    double sum = 0, sumSquares = 0, best = 0;
+    Uint64 calls = 0, allCalls = 0;
+    countersReset(counters);
+    for (int r = 0; r < reps; r++) {
+        calls = 0;
+        countersResume(counters);
+        Uint64 repStart = SDL_GetPerformanceCounter();
+        for (Uint64 p = 0; p < passes; p++) calls += run(corpus);
+        Uint64 repEnd = SDL_GetPerformanceCounter();
+        countersPause(counters);
+        allCalls += calls;
+        double ns = (double)(repEnd - repStart) * 1e9 / (double)SDL_GetPerformanceFrequency() / (double)calls;
+        sum += ns;
+        sumSquares += ns * ns;
+        if (r == 0 || ns < best) best = ns;
+    }
+    double mean = sum / reps;
+    double spread = SDL_sqrt(SDL_max(sumSquares / reps - mean * mean, 0.0));
+    *result = (BenchResult){ .value = mean, .spread = mean > 0 ? spread * 100 / mean : 0.0, .lowerIsBetter = true };
+    SDL_strlcpy(result->name, name, sizeof(result->name));
+    SDL_Log("%-10s %9.2f ns/call  +/- %5.2f%%  best %9.2f  (%d reps of %llu calls)", name, mean, result->spread, best,
+            reps, (unsigned long long)calls);
+    if (counters->count > 0) {
+        CounterValues counted;
+        char line[256];
+        countersRead(counters, &counted);
+        SDL_Log("%-10s %s", "", formatCounters(&counted, allCalls, line, sizeof(line)));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int reps = MICROBENCH_REPS, ms = MICROBENCH_MS;
+    const char* only = NULL;
+    const char* jsonPath = NULL;
+    const char* counterList = NULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (SDL_strcmp(argv[i], "reps") == 0) reps = SDL_max(SDL_atoi(argv[i + 1]), 1);
+        else if (SDL_strcmp(argv[i], "ms") == 0) ms = SDL_max(SDL_atoi(argv[i + 1]), 1);
+        else if (SDL_strcmp(argv[i], "only") == 0) only = argv[i + 1];
+        else if (SDL_strcmp(argv[i], "json") == 0) jsonPath = argv[i + 1];
+        else if (SDL_strcmp(argv[i], "counters") == 0) counterList = argv[i + 1];
+        else if (SDL_strcmp(argv[i], "spin") == 0) engineSetThreadSpin(SDL_atoi(argv[i + 1]));
+        else { SDL_Log("usage: %s [reps N] [ms N] [only KERNEL] [json FILE] [counters LIST] [spin US]", argv[0]); return 1; }
+    }
+    HardwareCounters counters = { .count = 0 };
+    if (counterList && !countersOpen(&counters, counterList)) SDL_Log("microbench: %s", SDL_GetError());
+    engineInitTables();
+    static BenchCorpus corpus; // 8 KB of key history a position, too much for the stack
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        corpus.positions[i] = initChessState();
+        loadFen(&corpus.positions[i], BENCH_POSITIONS[i]);
+        getAllMoves(&corpus.positions[i], &corpus.moves[i]);
+    }
+    BenchResult results[SDL_arraysize(BENCH_KERNELS)];
+    int found = 0;
+    for (size_t k = 0; k < SDL_arraysize(BENCH_KERNELS); k++) {
+        if (only && SDL_strcmp(only, BENCH_KERNELS[k].name) != 0) continue;
+        runKernel(BENCH_KERNELS[k].name, BENCH_KERNELS[k].run, &corpus, reps, ms, &counters, &results[found++]);
+    }
+    countersClose(&counters);
+    engineStopThreads();
+    if (!found) SDL_Log("microbench: no kernel called %s", only);
+    if (found && jsonPath && !writeBenchRecord(jsonPath, "microbench", 0, results, found)) {
+        SDL_Log("microbench: can't write %s: %s", jsonPath, SDL_GetError());
+        return 1;
+    }
+    return found ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+// MOVE GENERATION FUZZER: random games checked against the reference code at every ply, a program of its own (the movefuzz build task)
+
+/* `movefuzz [games N] [plies N] [seed N] [net FILE]` plays random legal games from each of FUZZ_STARTS in turn,
+   and at every ply checks what the search runs on against the plain code it has to agree with, which
+   stays as the oracle whatever replaces the fast paths:
+     - the move picker and its staged generators (evasions in check), given a random hash move and stale killers,
+       against getAllMoves: every legal move once and nothing else legal, in the same order when peekMoves looks ahead;
+     - isLegalMove on every from and to square, isPseudoLegalMove and moveOrigins against the same list;
+     - givesCheck and surelyLegal against making the move and looking;
+     - makeMove/unmakeMove and copyMake/copyUnmake, each move, against the position before it, and keyAfterMove
+       against the key makeMove leaves;
+     - the keys, bitboards, piece-square sum and phase makeMove keeps up (and the NNUE accumulators, with a net)
+       against refreshBitboards rebuilding them from the mailbox, the AVX2 board sum against the scalar one, and
+       the position against itself through writeFen and loadFen;
+     - evaluatePosition with the pawn and material tables warm against evaluating with none.
+   The first disagreement stops the run with the game's start, its moves and what didn't match, so it can be
+   replayed; the same seed plays the same games. The engine is compiled into this file, its static functions included. */
+#include "engine.c"
+#include <SDL3/SDL_main.h>
+
+#define MOVEFUZZ_GAMES 200
+#define MOVEFUZZ_PLIES 400 // a game's longest; past it the next one starts
+
+// perft's positions (main.c), full of castling, en passant, promotions and pins, and the start
+static const char* const FUZZ_STARTS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+static char failure[256]; // what disagreed, once a check has returned false
+
+static bool fail(SDL_PRINTF_FORMAT_STRING const char* format, ...) SDL_PRINTF_VARARG_FUNC(1);
+static bool fail(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    SDL_vsnprintf(failure, sizeof(failure), format, args);
+    va_end(args);
+    return false;
+}
+
+static const char* moveText(Move move) {
+    static char text[4][6]; // a few to a message
+    static int next;
+    char* out = text[next++ & 3];
+    moveToCoordinates(move, out);
+    return out;
+}
+
+static int indexOf(const MoveList* list, Move move) {
+    for (int i = 0; i < list->count; i++) if (list->moves[i] == move) return i;
+    return -1;
+}
+
+/* The first field that differs between two positions, NULL for none. The repetition ring isn't compared, only
+   its count, and not even that when history is false (a position loaded from FEN starts a new one). */
+static const char* positionDifference(const ChessState* a, const ChessState* b, bool history) {
+    if (SDL_memcmp(a->board, b->board, sizeof(a->board)) != 0) return "mailbox";
+    if (SDL_memcmp(a->pieceBB, b->pieceBB, sizeof(a->pieceBB)) != 0) return "piece bitboards";
+    if (SDL_memcmp(a->colorBB, b->colorBB, sizeof(a->colorBB)) != 0) return "colour bitboards";
+    if (a->occupied != b->occupied) return "occupancy";
+    if (a->hashKey != b->hashKey) return "hash key";
+    if (a->pawnKey != b->pawnKey) return "pawn key";
+    if (a->psq != b->psq) return "piece-square sum";
+    if (a->phase != b->phase) return "phase";
+    if (a->kingSquare[0] != b->kingSquare[0] || a->kingSquare[1] != b->kingSquare[1]) return "king squares";
+    if (a->halfmoveClock != b->halfmoveClock) return "halfmove clock";
+    if (a->enPassantCol != b->enPassantCol) return "en passant file";
+    if (a->whiteToMove != b->whiteToMove) return "side to move";
+    if (a->castlingRights != b->castlingRights) return "castling rights";
+    if (a->fullmoveNumber != b->fullmoveNumber) return "move number";
+    if (history && a->keyCount != b->keyCount) return "key count";
+    if (nnueNet.loaded && SDL_memcmp(a->accumulator, b->accumulator, sizeof(a->accumulator)) != 0) return "NNUE accumulators";
+    return NULL;
+}
+
+// what makeMove kept up, against the same rebuilt from the mailbox and from the position's FEN
+static bool checkFromScratch(const ChessState* chess) {
+    ChessState rebuilt = *chess;
+    refreshBitboards(&rebuilt);
+    const char* different = positionDifference(chess, &rebuilt, true);
+    if (different) return fail("the %s makeMove kept isn't what refreshBitboards makes", different);
+#if defined(__x86_64__)
+    if (useAvx2BoardSum) {
+        int scalarPhase, avx2Phase;
+        PackedScore scalar = boardSumScalar(chess, &scalarPhase), avx2 = boardSumAvx2(chess, &avx2Phase);
+        if (scalar != avx2 || scalarPhase != avx2Phase) return fail("the AVX2 board sum isn't the scalar one");
+    }
+#endif
+    char fen[FEN_MAX];
+    writeFen(chess, fen, sizeof(fen));
+    ChessState loaded = initChessState();
+    if (!loadFen(&loaded, fen)) return fail("loadFen won't take writeFen's %s", fen);
+    different = positionDifference(chess, &loaded, false);
+    if (different) return fail("the %s differs after writeFen and loadFen", different);
+    int warm = evaluatePosition((ChessState*)chess, &pawnTables[0], NULL, -INF, INF);
+    int cold = evaluatePosition(&rebuilt, NULL, NULL, -INF, INF);
+    if (warm != cold) return fail("evaluatePosition gives %d with the pawn and material tables, %d without", warm, cold);
+    return true;
+}
+
+/* The move picker over the position with a hash move that may be one of the legal moves and killers left over
+   from the ply before, as the search hands it: everything it gives has to be pseudo-legal, and once the ones that
+   leave the king in check are dropped, getAllMoves' list, each move once. A second picker peeking a random number
+   of moves ahead before each one has to give them in the same order. */
+static bool checkPicker(ChessState* chess, const MoveList* legal, const Move stale[3], Uint64* random) {
+    static MovePicker picker, peeking; // 2 KB of moves and scores each
+    bool white = chess->whiteToMove;
+    Move hash = legal->count && SDL_rand_r(random, 4) ? legal->moves[SDL_rand_r(random, legal->count)] : stale[2];
+    initMovePicker(&picker, chess, hash, stale, stale[2], NULL, NULL);
+    initMovePicker(&peeking, chess, hash, stale, stale[2], NULL, NULL);
+    Uint8 seen[256] = { 0 };
+    Move move, ahead[PREFETCH_AHEAD_MAX], peeked;
+    while (nextMove(&picker, &move)) {
+        peekMoves(&peeking, ahead, SDL_rand_r(random, PREFETCH_AHEAD_MAX + 1));
+        if (!nextMove(&peeking, &peeked) || peeked != move)
+            return fail("peekMoves changes the move picker's order at %s", moveText(move));
+        if (!isPseudoLegalMove(chess, move)) return fail("the move picker gave %s, which isn't pseudo-legal", moveText(move));
+        UndoInfo undo;
+        makeMove(chess, move, &undo);
+        bool isLegal = !isKingInCheck(chess, white);
+        unmakeMove(chess, move, &undo);
+        int at = indexOf(legal, move);
+        if (isLegal && at < 0) return fail("the move picker gave %s, legal but not in getAllMoves' list", moveText(move));
+        if (at >= 0 && seen[at]++) return fail("the move picker gave %s twice", moveText(move));
+    }
+    for (int i = 0; i < legal->count; i++)
+        if (!seen[i]) return fail("the move picker never gave %s", moveText(legal->moves[i]));
+    return true;
+}
+
+// the square-pair and by-target questions, against the list
+static bool checkLegality(const ChessState* chess, const MoveList* legal) {
+    Bitboard reachable[64] = { 0 }; // [from]: the squares a legal move goes to
+    Bitboard origins[PIECE_TYPE_COUNT][64] = { { 0 } }; // [piece][to]: where its legal moves come from, castling aside
+    for (int i = 0; i < legal->count; i++) {
+        Move m = legal->moves[i];
+        reachable[moveFrom(m)] |= squareBB(moveTo(m));
+        if (!isCastlingMove(m)) origins[chess->board[moveFrom(m)]][moveTo(m)] |= squareBB(moveFrom(m));
+    }
+    for (int from = 0; from < 64; from++) // the side to move's pieces, isLegalMove doesn't ask whose turn it is
+        for (int to = 0; to < 64 && (chess->colorBB[chess->whiteToMove ? 0 : 1] & squareBB(from)); to++)
+            if (isLegalMove(chess, from >> 3, from & 7, to >> 3, to & 7) != ((reachable[from] & squareBB(to)) != 0))
+                return fail("isLegalMove says %s for %s", (reachable[from] & squareBB(to)) ? "no" : "yes",
+                            moveText(packMove(from, to, MOVE_QUIET)));
+    for (PieceType kind = WHITE_PAWN; kind <= WHITE_KING; kind++) {
+        PieceType piece = SIDE_PIECE(chess->whiteToMove ? 0 : 1, kind);
+        for (int to = 0; to < 64; to++)
+            if (moveOrigins(chess, piece, to) != origins[piece][to])
+                return fail("moveOrigins for piece %d to square %d isn't the list's", (int)piece, to);
+    }
+    return true;
+}
+
+// every legal move made and taken back both ways, the position after each checked from scratch
+static bool checkMoves(ChessState* chess, const MoveList* legal) {
+    bool white = chess->whiteToMove, inCheck = isKingInCheck(chess, white);
+    CheckInfo checks;
+    initCheckInfo(chess, &checks);
+    ChessState before = *chess, after;
+    static Uint8 saved[COPY_MAKE_MAX_BYTES];
+    for (int i = 0; i < legal->count; i++) {
+        Move m = legal->moves[i];
+        bool predicted = givesCheck(chess, &checks, m);
+        Uint64 key = keyAfterMove(chess, m);
+        UndoInfo undo;
+        makeMove(chess, m, &undo);
+        if (key != chess->hashKey) return fail("keyAfterMove of %s isn't the key makeMove leaves", moveText(m));
+        if (predicted != isKingInCheck(chess, !white))
+            return fail("givesCheck says %s for %s", predicted ? "check" : "no check", moveText(m));
+        if (!checkFromScratch(chess)) {
+            SDL_strlcat(failure, " after ", sizeof(failure));
+            SDL_strlcat(failure, moveText(m), sizeof(failure));
+            return false;
+        }
+        after = *chess;
+        unmakeMove(chess, m, &undo);
+        const char* different = positionDifference(chess, &before, true);
+        if (different) return fail("unmakeMove of %s doesn't put the %s back", moveText(m), different);
+        copyMake(chess, m, saved);
+        different = positionDifference(chess, &after, true);
+        if (different) return fail("copyMake of %s leaves the %s unlike makeMove's", moveText(m), different);
+        copyUnmake(chess, saved);
+        different = positionDifference(chess, &before, true);
+        if (different) return fail("copyUnmake of %s doesn't put the %s back", moveText(m), different);
+    }
+    // surelyLegal on the moves getAllMoves left out: none of them may be called legal
+    MoveList pseudo;
+    if (!inCheck) {
+        generateCaptures(chess, &pseudo);
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < pseudo.count; i++)
+                if (indexOf(legal, pseudo.moves[i]) < 0 && surelyLegal(chess, &checks, pseudo.moves[i]))
+                    return fail("surelyLegal passes %s, which leaves the king in check", moveText(pseudo.moves[i]));
+            generateQuiets(chess, &pseudo);
+        }
+    }
+    return true;
+}
+
+static bool checkPosition(ChessState* chess, const MoveList* legal, const Move stale[3], Uint64* random) {
+    return checkPicker(chess, legal, stale, random) && checkLegality(chess, legal) && checkMoves(chess, legal);
+}
+
+int main(int argc, char* argv[]) {
+    int games = MOVEFUZZ_GAMES, maxPlies = MOVEFUZZ_PLIES;
+    Uint64 seed = SDL_GetPerformanceCounter();
+    const char* netPath = NULL;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (SDL_strcmp(argv[i], "games") == 0) games = SDL_max(SDL_atoi(argv[i + 1]), 1);
+        else if (SDL_strcmp(argv[i], "plies") == 0) maxPlies = SDL_clamp(SDL_atoi(argv[i + 1]), 1, MOVEFUZZ_PLIES);
+        else if (SDL_strcmp(argv[i], "seed") == 0) seed = SDL_strtoull(argv[i + 1], NULL, 10);
+        else if (SDL_strcmp(argv[i], "net") == 0) netPath = argv[i + 1];
+        else { SDL_Log("usage: %s [games N] [plies N] [seed N] [net FILE]", argv[0]); return 1; }
+    }
+    engineInitTables();
+    if (netPath && !nnueLoad(netPath)) { SDL_Log("movefuzz: can't load %s: %s", netPath, SDL_GetError()); return 1; }
+    SDL_Log("movefuzz: %d games of up to %d plies, seed %" SDL_PRIu64 "%s", games, maxPlies, seed, netPath ? ", with the net" : "");
+    Uint64 random = seed, positions = 0, moves = 0, start = SDL_GetTicksNS();
+    for (int g = 0; g < games; g++) {
+        const char* fen = FUZZ_STARTS[g % (int)SDL_arraysize(FUZZ_STARTS)];
+        ChessState chess = initChessState();
+        loadFen(&chess, fen);
+        Move played[MOVEFUZZ_PLIES], stale[3] = { MOVE_NONE, MOVE_NONE, MOVE_NONE };
+        for (int ply = 0; ply <= maxPlies; ply++) {
+            MoveList legal;
+            getAllMoves(&chess, &legal);
+            positions++;
+            moves += (Uint64)legal.count;
+            if (!checkPosition(&chess, &legal, stale, &random)) {
+                char line[FEN_MAX];
+                SDL_Log("movefuzz: game %d, ply %d: %s", g + 1, ply, failure);
+                SDL_Log("  from %s", fen);
+                char text[MOVEFUZZ_PLIES * 6 + 1] = "";
+                for (int i = 0; i < ply; i++) {
+                    SDL_strlcat(text, moveText(played[i]), sizeof(text));
+                    if (i + 1 < ply) SDL_strlcat(text, " ", sizeof(text));
+                }
+                SDL_Log("  moves %s", ply ? text : "(none)");
+                writeFen(&chess, line, sizeof(line));
+                SDL_Log("  at %s", line);
+                return 1;
+            }
+            if (legal.count == 0 || chess.halfmoveClock >= 100 || ply == maxPlies) break;
+            for (int k = 0; k < 3; k++) stale[k] = legal.moves[SDL_rand_r(&random, legal.count)];
+            played[ply] = legal.moves[SDL_rand_r(&random, legal.count)];
+            makeMove(&chess, played[ply], NULL);
+        }
+    }
+    double seconds = (double)(SDL_GetTicksNS() - start) / 1e9;
+    SDL_Log("movefuzz: all agreed over %d games, %" SDL_PRIu64 " positions and %" SDL_PRIu64 " moves in %.1f s", games,
+            positions, moves, seconds);
+    return 0;
+}
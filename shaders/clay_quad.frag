@@ -0,0 +1,39 @@
+// The SDL_GPU renderer's one fragment shader (external/clay/clay_renderer_SDL3_gpu.c): the texture times the colour,
+// cut to a rounded rectangle, or to the ring inside it a border makes, by its distance from the edge, so corners
+// need no triangle fans and come out antialiased. Untextured shapes sample a white texel.
+// Compiled with -DCHESS_GPU_RENDERER=ON: glslc -mfmt=c clay_quad.frag -o clay_quad.frag.inc
+#version 450
+
+layout(location = 0) in vec2 inUv;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inLocal;
+layout(location = 3) flat in vec2 inHalfSize;
+layout(location = 4) flat in vec4 inRadii;
+layout(location = 5) flat in vec4 inBorder;
+
+// SDL's GPU API: a fragment shader's samplers are in set 2
+layout(set = 2, binding = 0) uniform sampler2D source;
+
+layout(location = 0) out vec4 outColor;
+
+// signed distance from a rectangle centred on the origin with these corner radii, negative inside
+float roundedBox(vec2 p, vec2 halfSize, vec4 radii) {
+    float r = p.y < 0.0 ? (p.x < 0.0 ? radii.x : radii.y) : (p.x < 0.0 ? radii.w : radii.z);
+    r = min(r, min(halfSize.x, halfSize.y));
+    vec2 q = abs(p) - halfSize + r;
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;
+}
+
+void main() {
+    float coverage = clamp(0.5 - roundedBox(inLocal, inHalfSize, inRadii), 0.0, 1.0);
+    if (any(greaterThan(inBorder, vec4(0.0)))) {
+        // the inside edge: the rectangle less the widths, its corners shrunk by the widths beside them
+        vec2 innerHalf = max(inHalfSize - vec2(inBorder.x + inBorder.y, inBorder.z + inBorder.w) * 0.5, 0.0);
+        vec2 innerCentre = vec2(inBorder.x - inBorder.y, inBorder.z - inBorder.w) * 0.5;
+        vec4 innerRadii = max(inRadii - vec4(max(inBorder.x, inBorder.z), max(inBorder.y, inBorder.z),
+                                             max(inBorder.y, inBorder.w), max(inBorder.x, inBorder.w)), 0.0);
+        coverage *= clamp(0.5 + roundedBox(inLocal - innerCentre, innerHalf, innerRadii), 0.0, 1.0);
+    }
+    outColor = texture(source, inUv) * inColor;
+    outColor.a *= coverage;
+}
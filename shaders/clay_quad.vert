@@ -0,0 +1,36 @@
+// The SDL_GPU renderer's one vertex shader (external/clay/clay_renderer_SDL3_gpu.c): an instance a rectangle, six
+// vertices each, laid out from the instance's rectangle in window units. Compiled with -DCHESS_GPU_RENDERER=ON
+// into the renderer itself: glslc -mfmt=c clay_quad.vert -o clay_quad.vert.inc
+#version 450
+
+// Clay_SDL3GpuInstance
+layout(location = 0) in vec4 inRect;   // x, y, width, height
+layout(location = 1) in vec4 inUv;     // top left and bottom right in the texture
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec4 inRadii;  // corners: top left, top right, bottom right, bottom left
+layout(location = 4) in vec4 inBorder; // widths: left, right, top, bottom; all 0 to fill
+
+// SDL's GPU API: a vertex shader's uniform buffers are in set 1
+layout(set = 1, binding = 0) uniform Screen { vec2 screenSize; }; // the window, in the layout's units
+
+layout(location = 0) out vec2 outUv;
+layout(location = 1) out vec4 outColor;
+layout(location = 2) out vec2 outLocal; // from the rectangle's centre
+layout(location = 3) flat out vec2 outHalfSize;
+layout(location = 4) flat out vec4 outRadii;
+layout(location = 5) flat out vec4 outBorder;
+
+const vec2 CORNERS[6] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 0), vec2(1, 1), vec2(0, 1));
+
+void main() {
+    vec2 corner = CORNERS[gl_VertexIndex];
+    vec2 position = inRect.xy + corner * inRect.zw;
+    vec2 ndc = position / screenSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0); // normalised y is up, the layout's is down
+    outUv = mix(inUv.xy, inUv.zw, corner);
+    outColor = inColor;
+    outHalfSize = inRect.zw * 0.5;
+    outLocal = (corner - 0.5) * inRect.zw;
+    outRadii = inRadii;
+    outBorder = inBorder;
+}
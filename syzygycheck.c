@@ -0,0 +1,237 @@
+// SYZYGY CHECK: the Syzygy probing code against real table files, a program of its own (ctest's syzygy)
+
+/* `syzygycheck DIR...` loads the Syzygy tables in the directories (as engineSetSyzygyPath, the separator between
+   them put back where CMake's list split them) and probes every legal KRvK, KQvK and KPvK position, either colour
+   strong and either side to move, against the built-in tables, which are exact:
+     - syzygyProbeWdl: win, draw or loss, every position;
+     - syzygyProbeDtz for KRvK and KQvK with their .rtbz files, where the distance to mate is the DTZ (the strong
+       side has nothing to zero with, and the one zeroing move the other side has, taking the piece, draws): every
+       position with a move, one ply long allowed where a table counts in moves;
+     - syzygyRankRootMoves on every ROOT_SAMPLE-th won root (KPvK's with the tables its promotions make): the
+       winning moves kept, nothing else; and a root whose quickest win would repeat it a third time, which is
+       ranked a draw and goes.
+   Exit status 0 when everything agrees, 1 on the first disagreement, 77 (ctest's skip) with no directories or no
+   tables for these endings in them: there are none in the tree. The engine is compiled into this file, its static
+   functions included. */
+#include "engine.c"
+#include <SDL3/SDL_main.h>
+
+#define SYZYGYCHECK_SKIP 77
+#define ROOT_SAMPLE 61 // roots ranked, one position in so many
+
+typedef struct {
+    const char* name;
+    PieceType strong; // with the two kings
+    bool dtzIsDtm;    // so the built-in tables have the DTZ too
+} Ending;
+
+static const Ending ENDINGS[] = { { "KRvK", WHITE_ROOK, true }, { "KQvK", WHITE_QUEEN, true }, { "KPvK", WHITE_PAWN, false } };
+
+// the roots for the repetition check: a won KRvK and KQvK, each with a quickest win that can be played back
+static const char* const REPETITION_ROOTS[] = { "8/8/8/2k5/8/8/4R3/7K w - - 0 1", "8/8/3k4/8/8/8/8/K6Q w - - 0 1" };
+
+// the position with the men on these squares, false if it isn't one: men on top of each other, a pawn on the
+// first or last rank, the side not to move in check
+static bool setUp(ChessState* chess, const PieceType men[3], const int squares[3], bool whiteToMove) {
+    if (squares[0] == squares[1] || squares[0] == squares[2] || squares[1] == squares[2]) return false;
+    *chess = initChessState();
+    SDL_memset(chess->board, EMPTY, sizeof(chess->board));
+    for (int i = 0; i < 3; i++) {
+        if (pieceKind(men[i]) == WHITE_PAWN && (squares[i] < 8 || squares[i] >= 56)) return false;
+        chess->board[squares[i]] = men[i];
+    }
+    chess->whiteToMove = whiteToMove;
+    chess->castlingRights = 0;
+    refreshBitboards(chess);
+    return !isKingInCheck(chess, !whiteToMove);
+}
+
+// WDL (-2, 0 or 2) and DTZ (plies to mate, -1 mated, 0 drawn) from the built-in tables, the move count left out
+static int exactDtz(const ChessState* chess, int* wdl) {
+    ChessState fresh = *chess;
+    fresh.halfmoveClock = 0;
+    int score;
+    if (!probeTablebases(&fresh, 0, &score)) score = 0; // only an illegal position, which setUp leaves out
+    *wdl = score > 0 ? WDL_WIN : score < 0 ? WDL_LOSS : WDL_DRAW;
+    return score > 0 ? MATE_SCORE - score : score < 0 ? -SDL_max(MATE_SCORE + score, 1) : 0;
+}
+
+// a root move's DTZ counted from the root, as syzygyRankRootMoves works it out
+static int rootMoveDtz(ChessState* chess, Move move) {
+    UndoInfo undo;
+    makeMove(chess, move, &undo);
+    int wdl, dtz;
+    if (chess->halfmoveClock == 0) {
+        exactDtz(chess, &wdl);
+        dtz = dtzBeforeZeroing(-wdl);
+    } else {
+        dtz = -exactDtz(chess, &wdl);
+        dtz += signOf(dtz);
+    }
+    unmakeMove(chess, move, &undo);
+    return dtz;
+}
+
+static bool rootKept(const RootMoves* root, Move move) {
+    for (int i = 0; i < root->count; i++) if (root->moves[i] == move) return true;
+    return false;
+}
+
+// the root's winning moves and nothing else kept, or (repeats set) only wins and not that move
+static bool checkRoot(ChessState* chess, const TransTable* tt, Move repeats) {
+    RootMoves root;
+    initRootMoves(chess, &root, tt);
+    Move moves[256];
+    int count = root.count, dtz[256];
+    for (int i = 0; i < count; i++) {
+        moves[i] = root.moves[i];
+        dtz[i] = moves[i] == repeats ? 0 : rootMoveDtz(chess, moves[i]);
+    }
+    syzygyRankRootMoves(chess, &root);
+    for (int i = 0; i < count; i++) {
+        bool kept = rootKept(&root, moves[i]);
+        if (kept == (dtz[i] > 0) || (!kept && repeats)) continue;
+        char fen[FEN_MAX], text[6];
+        writeFen(chess, fen, sizeof(fen));
+        moveToCoordinates(moves[i], text);
+        SDL_Log("syzygycheck: %s %s %s, its DTZ %d", fen, kept ? "keeps" : "drops", text, dtz[i]);
+        return false;
+    }
+    return root.count > 0;
+}
+
+// the legal move from one square to another, MOVE_NONE if there isn't one
+static Move findMove(ChessState* chess, int from, int to) {
+    MoveList legal;
+    getAllMoves(chess, &legal);
+    for (int i = 0; i < legal.count; i++)
+        if (moveFrom(legal.moves[i]) == from && moveTo(legal.moves[i]) == to) return legal.moves[i];
+    return MOVE_NONE;
+}
+
+// the quickest win played, a king move and both back, twice: the third time round, it's a draw
+static bool checkRepetition(const char* fen, const TransTable* tt) {
+    ChessState chess = initChessState();
+    loadFen(&chess, fen);
+    MoveList legal;
+    getAllMoves(&chess, &legal);
+    Move best = MOVE_NONE;
+    int bestDtz = SDL_MAX_SINT32;
+    for (int i = 0; i < legal.count; i++) {
+        int dtz = rootMoveDtz(&chess, legal.moves[i]);
+        if (dtz > 0 && dtz < bestDtz) { bestDtz = dtz; best = legal.moves[i]; }
+    }
+    ChessState after = chess;
+    makeMove(&after, best, NULL);
+    MoveList replies;
+    getAllMoves(&after, &replies);
+    for (int i = 0; i < replies.count; i++) {
+        const int cycle[4][2] = { { moveFrom(best), moveTo(best) }, { moveFrom(replies.moves[i]), moveTo(replies.moves[i]) },
+                                  { moveTo(best), moveFrom(best) }, { moveTo(replies.moves[i]), moveFrom(replies.moves[i]) } };
+        ChessState game = chess;
+        bool played = true;
+        for (int m = 0; m < 8 && played; m++) {
+            Move move = findMove(&game, cycle[m & 3][0], cycle[m & 3][1]);
+            if ((played = move != MOVE_NONE)) makeMove(&game, move, NULL);
+        }
+        if (!played) continue;
+        if (!checkRoot(&game, tt, best)) return false;
+        SDL_Log("syzygycheck: %s, the quickest win a third time round, dropped", fen);
+        return true;
+    }
+    SDL_Log("syzygycheck: no way round and back from %s", fen);
+    return false;
+}
+
+static bool checkEnding(const Ending* ending, bool byDtz, bool ranked, const TransTable* tt, long* probed) {
+    long wdlCount = 0, dtzCount = 0, roots = 0;
+    for (int colour = 0; colour < 2; colour++) {
+        PieceType flip = colour ? PIECE_BLACK : 0;
+        const PieceType men[3] = { WHITE_KING ^ flip, ending->strong ^ flip, BLACK_KING ^ flip };
+        for (int code = 0; code < 64 * 64 * 64; code++) {
+            const int squares[3] = { code & 63, (code >> 6) & 63, code >> 12 };
+            for (int side = 0; side < 2; side++) {
+                ChessState chess;
+                if (!setUp(&chess, men, squares, side == 0)) continue;
+                int wdl, dtz = exactDtz(&chess, &wdl);
+                char fen[FEN_MAX];
+                SyzygyResult result;
+                int got = syzygyProbeWdl(&chess, &result);
+                if (result == SYZYGY_FAIL || got != wdl) {
+                    writeFen(&chess, fen, sizeof(fen));
+                    SDL_Log("syzygycheck: %s: WDL %d, not %d%s", fen, got, wdl, result == SYZYGY_FAIL ? " (the probe failed)" : "");
+                    return false;
+                }
+                wdlCount++;
+                bool strongToMove = (colour == 0) == (side == 0);
+                if (ranked && wdl == WDL_WIN && strongToMove && (wdlCount % ROOT_SAMPLE) == 0) {
+                    if (!checkRoot(&chess, tt, MOVE_NONE)) return false;
+                    roots++;
+                }
+                if (!byDtz || !hasLegalMove(&chess)) continue;
+                got = syzygyProbeDtz(&chess, &result);
+                if (result == SYZYGY_FAIL || (got != dtz && got != dtz + signOf(dtz))) {
+                    writeFen(&chess, fen, sizeof(fen));
+                    SDL_Log("syzygycheck: %s: DTZ %d, not %d%s", fen, got, dtz, result == SYZYGY_FAIL ? " (the probe failed)" : "");
+                    return false;
+                }
+                dtzCount++;
+            }
+        }
+    }
+    SDL_Log("syzygycheck: %s: %ld positions by WDL, %ld by DTZ, %ld roots ranked", ending->name, wdlCount, dtzCount, roots);
+    *probed += wdlCount;
+    return true;
+}
+
+// the table's there and its WDL file maps
+static SyzygyTable* tableFor(const char* name) {
+    SyzygyTable t, *table;
+    char file[16];
+    SDL_snprintf(file, sizeof(file), "%s.rtbw", name);
+    return syzygyParseName(file, &t) && (table = syzygyFind(t.key)) && syzygyReady(table, SYZYGY_WDL) ? table : NULL;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        SDL_Log("syzygycheck: skipped, no table directories given (usage: %s DIR...)", argv[0]);
+        return SYZYGYCHECK_SKIP;
+    }
+    char paths[4096] = "";
+    for (int i = 1; i < argc; i++) {
+        size_t length = SDL_strlen(paths);
+        SDL_snprintf(paths + length, sizeof(paths) - length, "%s%s", i > 1 ? (char[]){ SYZYGY_PATH_SEPARATOR, 0 } : "", argv[i]);
+    }
+    engineInitTables();
+    int found = engineSetSyzygyPath(paths);
+    SDL_Log("syzygycheck: %d tables in %s", found, paths);
+    Engine* engine = engineCreate();
+    bool ok = true;
+    long probed = 0;
+    int checked = 0;
+    bool pawnless = true; // KRvK and KQvK are there, for the repetition check
+    for (size_t i = 0; ok && i < SDL_arraysize(ENDINGS); i++) {
+        SyzygyTable* table = tableFor(ENDINGS[i].name);
+        if (!table) {
+            SDL_Log("syzygycheck: no %s.rtbw, skipping it", ENDINGS[i].name);
+            pawnless = pawnless && !ENDINGS[i].dtzIsDtm;
+            continue;
+        }
+        bool byDtz = ENDINGS[i].dtzIsDtm && syzygyReady(table, SYZYGY_DTZ);
+        if (ENDINGS[i].dtzIsDtm && !byDtz) SDL_Log("syzygycheck: no %s.rtbz, %s by WDL only", ENDINGS[i].name, ENDINGS[i].name);
+        // a pawn's root moves include every promotion, which the ranking needs the tables for
+        bool ranked = ENDINGS[i].strong != WHITE_PAWN || (tableFor("KQvK") && tableFor("KRvK") && tableFor("KBvK") && tableFor("KNvK"));
+        ok = checkEnding(&ENDINGS[i], byDtz, ranked, engine->tt, &probed);
+        checked++;
+    }
+    for (size_t i = 0; ok && pawnless && i < SDL_arraysize(REPETITION_ROOTS); i++)
+        ok = checkRepetition(REPETITION_ROOTS[i], engine->tt);
+    engineDestroy(engine);
+    engineSetSyzygyPath(NULL);
+    if (ok && !checked) {
+        SDL_Log("syzygycheck: skipped, none of the endings it checks are there");
+        return SYZYGYCHECK_SKIP;
+    }
+    if (ok) SDL_Log("syzygycheck: %ld positions, the tables and the built-in ones agree", probed);
+    return ok ? 0 : 1;
+}